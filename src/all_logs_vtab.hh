@@ -30,6 +30,11 @@
 #ifndef LNAV_ALL_LOGS_VTAB_HH
 #define LNAV_ALL_LOGS_VTAB_HH
 
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "log_vtab_impl.hh"
 #include "data_parser.hh"
 
@@ -53,43 +58,53 @@ public:
                  shared_buffer_ref &line,
                  std::vector<logline_value> &values) {
         log_format *format = lf->get_format();
-        values.emplace_back(this->alv_value_name, format->get_name(), 0);
+        message_info mi;
 
-        std::vector<logline_value> sub_values;
-        struct line_range body;
-        string_attrs_t sa;
-
-        format->annotate(line_number, line, sa, sub_values, false);
+        values.emplace_back(this->alv_value_name, format->get_name(), 0);
+        if (!this->lookup(*lf, line_number, line, mi)) {
+            std::vector<logline_value> sub_values;
+            string_attrs_t sa;
 
-        body = find_string_attr_range(sa, &textview_curses::SA_BODY);
-        if (body.lr_start == -1) {
-            body.lr_start = 0;
-            body.lr_end = line.length();
+            format->annotate(line_number, line, sa, sub_values, false);
+            this->parse_body(line, sa, mi);
+            this->store(*lf, line_number, mi);
         }
+        this->append_values(mi, values);
+    }
 
-        data_scanner ds(line, body.lr_start, body.lr_end);
-        data_parser dp(&ds);
+    bool can_extract_concurrently(const logfile &lf) const {
+        auto elf = dynamic_cast<const external_log_format *>(
+            lf.get_format());
 
-        std::string str;
-        dp.dp_msg_format = &str;
-        dp.parse();
+        return elf != nullptr &&
+               elf->elf_type == external_log_format::ELF_TYPE_TEXT;
+    };
 
-        tmp_shared_buffer tsb(str.c_str());
+    void extract_concurrent(const logfile &lf,
+                            uint64_t line_number,
+                            shared_buffer_ref &line,
+                            const std::vector<bool> *columns,
+                            string_attrs_t &sa,
+                            std::vector<logline_value> &values) const {
+        auto elf = dynamic_cast<const external_log_format *>(
+            lf.get_format());
+        message_info mi;
 
-        values.emplace_back(this->alv_msg_name, tsb.tsb_ref, 1);
+        values.emplace_back(this->alv_value_name, elf->get_name(), 0);
+        if (!this->lookup(lf, line_number, line, mi)) {
+            std::vector<logline_value> sub_values;
 
-        this->alv_schema_manager.invalidate_refs();
-        dp.dp_schema_id.to_string(this->alv_schema_buffer);
-        shared_buffer_ref schema_ref;
-        schema_ref.share(this->alv_schema_manager,
-                         this->alv_schema_buffer,
-                         data_parser::schema_id_t::STRING_SIZE - 1);
-        values.emplace_back(this->alv_schema_name, schema_ref, 2);
-    }
+            elf->annotate_columns(line_number, line, sa, sub_values, false,
+                                  nullptr);
+            this->parse_body(line, sa, mi);
+            this->store(lf, line_number, mi);
+        }
+        this->append_values(mi, values);
+    };
 
     bool is_valid(log_cursor &lc, logfile_sub_source &lss) {
-        content_line_t    cl(lss.at(lc.lc_curr_line));
-        std::shared_ptr<logfile> lf = lss.find(cl);
+        content_line_t    cl(lc.line_at(lc.lc_curr_line));
+        logfile *lf = lss.find_file_ptr(cl);
         auto lf_iter = lf->begin() + cl;
 
         if (lf_iter->is_continued()) {
@@ -107,8 +122,8 @@ public:
             return true;
         }
 
-        content_line_t    cl(lss.at(lc.lc_curr_line));
-        std::shared_ptr<logfile> lf = lss.find(cl);
+        content_line_t    cl(lc.line_at(lc.lc_curr_line));
+        logfile *lf = lss.find_file_ptr(cl);
         auto lf_iter = lf->begin() + cl;
 
         if (lf_iter->is_continued()) {
@@ -119,11 +134,159 @@ public:
     };
 
 private:
+    /**
+     * The number of lines whose results are kept before the cache is
+     * emptied and started over.
+     */
+    static const size_t MAX_CACHED_LINES = 8 * 1024 * 1024;
+
+    struct message_info {
+        uint32_t mi_hash{0};
+        uint32_t mi_length{0};
+        std::string mi_format;
+        data_parser::schema_id_t mi_schema;
+    };
+
+    /**
+     * The results for a line, the message format is an index into
+     * alv_formats starting at one so that zero can mark lines that have
+     * not been seen.  The hash and length of the message are checked to
+     * make sure the line has not changed since.
+     */
+    struct cached_line {
+        uint32_t cl_format{0};
+        uint32_t cl_hash{0};
+        uint32_t cl_length{0};
+        data_parser::schema_id_t cl_schema;
+    };
+
+    static uint32_t hash_message(const shared_buffer_ref &line) {
+        return SpookyHash::Hash32(line.get_data(), line.length(), 0);
+    };
+
+    void parse_body(shared_buffer_ref &line,
+                    const string_attrs_t &sa,
+                    message_info &mi) const {
+        struct line_range body;
+
+        body = find_string_attr_range(sa, &textview_curses::SA_BODY);
+        if (body.lr_start == -1) {
+            body.lr_start = 0;
+            body.lr_end = line.length();
+        }
+
+        data_scanner ds(line, body.lr_start, body.lr_end);
+        data_parser dp(&ds);
+
+        dp.dp_msg_format = &mi.mi_format;
+        dp.parse();
+        mi.mi_schema = dp.dp_schema_id;
+    };
+
+    bool lookup(const logfile &lf,
+                uint64_t line_number,
+                shared_buffer_ref &line,
+                message_info &mi) const {
+        std::lock_guard<std::mutex> lg(this->alv_cache_mutex);
+
+        mi.mi_hash = hash_message(line);
+        mi.mi_length = line.length();
+
+        auto iter = this->alv_cache.find(&lf);
+
+        if (iter == this->alv_cache.end() ||
+            line_number >= iter->second.size()) {
+            return false;
+        }
+
+        const auto &cl = iter->second[line_number];
+
+        if (cl.cl_format == 0 ||
+            cl.cl_hash != mi.mi_hash ||
+            cl.cl_length != mi.mi_length) {
+            return false;
+        }
+
+        mi.mi_format = this->alv_formats[cl.cl_format - 1];
+        mi.mi_schema = cl.cl_schema;
+        return true;
+    };
+
+    void store(const logfile &lf,
+               uint64_t line_number,
+               const message_info &mi) const {
+        std::lock_guard<std::mutex> lg(this->alv_cache_mutex);
+
+        if (this->alv_cached_lines >= MAX_CACHED_LINES) {
+            this->alv_cache.clear();
+            this->alv_cached_lines = 0;
+        }
+
+        auto &lines = this->alv_cache[&lf];
+
+        if (line_number >= lines.size()) {
+            size_t new_size = std::max((size_t) line_number + 1, lf.size());
+
+            this->alv_cached_lines += new_size - lines.size();
+            lines.resize(new_size);
+        }
+
+        auto format_iter = this->alv_format_ids.find(mi.mi_format);
+        uint32_t format_id;
+
+        if (format_iter == this->alv_format_ids.end()) {
+            this->alv_formats.push_back(mi.mi_format);
+            format_id = this->alv_formats.size();
+            this->alv_format_ids[mi.mi_format] = format_id;
+        } else {
+            format_id = format_iter->second;
+        }
+
+        auto &cl = lines[line_number];
+
+        cl.cl_format = format_id;
+        cl.cl_hash = mi.mi_hash;
+        cl.cl_length = mi.mi_length;
+        cl.cl_schema = mi.mi_schema;
+    };
+
+    void append_values(const message_info &mi,
+                       std::vector<logline_value> &values) const {
+        char schema_buffer[data_parser::schema_id_t::STRING_SIZE];
+
+        // The temporary buffers are copied into the values when they go
+        // out of scope.
+        {
+            tmp_shared_buffer tsb(mi.mi_format.c_str());
+
+            values.emplace_back(this->alv_msg_name, tsb.tsb_ref, 1);
+        }
+
+        mi.mi_schema.to_string(schema_buffer);
+        {
+            tmp_shared_buffer tsb(schema_buffer,
+                                  data_parser::schema_id_t::STRING_SIZE - 1);
+
+            values.emplace_back(this->alv_schema_name, tsb.tsb_ref, 2);
+        }
+    };
+
     intern_string_t alv_value_name;
     intern_string_t alv_msg_name;
     intern_string_t alv_schema_name;
-    shared_buffer alv_schema_manager;
-    char alv_schema_buffer[data_parser::schema_id_t::STRING_SIZE];
+
+    /**
+     * The message formats and schemas of lines that were seen before, so
+     * that later queries do not need to parse the lines again.  The cache
+     * is filled from the prefetcher's worker threads as well, so it is
+     * guarded by alv_cache_mutex.
+     */
+    mutable std::mutex alv_cache_mutex;
+    mutable std::unordered_map<const logfile *, std::vector<cached_line>>
+        alv_cache;
+    mutable size_t alv_cached_lines{0};
+    mutable std::vector<std::string> alv_formats;
+    mutable std::unordered_map<std::string, uint32_t> alv_format_ids;
 };
 
 #endif //LNAV_ALL_LOGS_VTAB_HH
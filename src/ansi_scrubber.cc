@@ -31,43 +31,119 @@
 
 #include "config.h"
 
+#include <string.h>
+
+#include <algorithm>
 #include <vector>
 
 #include "view_curses.hh"
-#include "pcrepp/pcrepp.hh"
 #include "ansi_scrubber.hh"
 
 using namespace std;
 
-static pcrepp &ansi_regex()
+static inline bool is_param_char(char ch)
+{
+    return ('0' <= ch && ch <= '9') || ch == '=' || ch == ';';
+}
+
+static inline bool is_command_char(char ch)
+{
+    return ('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z');
+}
+
+/**
+ * Find the next escape sequence that looks like "ESC [ [0-9=;]* [a-zA-Z]".
+ *
+ * @param str The string to search.
+ * @param start The offset to start searching at.
+ * @param begin_out The offset of the ESC character.
+ * @param cmd_out The offset of the letter that ends the sequence.
+ * @return True if a sequence was found.
+ */
+static bool find_ansi_sequence(const string &str,
+                               size_t start,
+                               size_t &begin_out,
+                               size_t &cmd_out)
+{
+    const char *data = str.data();
+    size_t len = str.length();
+
+    while (start < len) {
+        auto esc = (const char *) memchr(&data[start], '\x1b', len - start);
+
+        if (esc == nullptr) {
+            return false;
+        }
+
+        size_t lpc = esc - data;
+
+        start = lpc + 1;
+        if (lpc + 1 >= len || data[lpc + 1] != '[') {
+            continue;
+        }
+        for (lpc += 2; lpc < len && is_param_char(data[lpc]); lpc++) {
+        }
+        if (lpc < len && is_command_char(data[lpc])) {
+            begin_out = esc - data;
+            cmd_out = lpc;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @return The offset where a sequence could start now that the characters
+ *   from the given offset onwards have changed.
+ */
+static size_t rescan_start(const string &str, size_t offset)
 {
-    static pcrepp retval("\x1b\\[([\\d=;]*)([a-zA-Z])");
+    size_t retval = offset;
+
+    while (retval > 0 && is_param_char(str[retval - 1])) {
+        retval -= 1;
+    }
+    if (retval > 0 && str[retval - 1] == '[') {
+        retval -= 1;
+    }
+    if (retval > 0 && str[retval - 1] == '\x1b') {
+        return retval - 1;
+    }
 
-    return retval;
+    return offset;
 }
 
 void scrub_ansi_string(std::string &str, string_attrs_t &sa)
 {
-    view_colors &vc = view_colors::singleton();
+    // Most lines have neither NULs nor escapes, so check for those with
+    // memchr() before doing anything else.
+    bool has_nul = memchr(str.data(), '\0', str.length()) != nullptr;
+    size_t seq_begin, seq_cmd;
 
-    pcre_context_static<60> context;
-    pcrepp &   regex = ansi_regex();
-    pcre_input pi(str);
+    if (has_nul) {
+        replace(str.begin(), str.end(), '\0', ' ');
+    }
+    if (!find_ansi_sequence(str, 0, seq_begin, seq_cmd)) {
+        return;
+    }
 
-    replace(str.begin(), str.end(), '\0', ' ');
-    while (regex.match(context, pi)) {
-        pcre_context::capture_t *caps = context.all();
+    view_colors &vc = view_colors::singleton();
+
+    do {
         struct line_range        lr;
         bool has_attrs = false;
         attr_t attrs   = 0;
         int bg         = 0;
         int fg         = 0;
+        size_t params_begin = seq_begin + 2;
+        size_t seq_end = seq_cmd + 1;
         size_t lpc;
 
-        switch (pi.get_substr_start(&caps[2])[0]) {
+        switch (str[seq_cmd]) {
             case 'm':
-                for (lpc = caps[1].c_begin;
-                     lpc != string::npos && lpc < (size_t) caps[1].c_end;) {
+                for (lpc = params_begin;
+                     lpc != string::npos && lpc < seq_cmd;) {
                     int ansi_code = 0;
 
                     if (sscanf(&(str[lpc]), "%d", &ansi_code) == 1) {
@@ -113,9 +189,9 @@ void scrub_ansi_string(std::string &str, string_attrs_t &sa)
             case 'C': {
                 unsigned int spaces = 0;
 
-                if (sscanf(&(str[caps[1].c_begin]), "%u", &spaces) == 1 &&
+                if (sscanf(&(str[params_begin]), "%u", &spaces) == 1 &&
                     spaces > 0) {
-                    str.insert((unsigned long) caps[0].c_end, spaces, ' ');
+                    str.insert((unsigned long) seq_end, spaces, ' ');
                 }
                 break;
             }
@@ -123,7 +199,7 @@ void scrub_ansi_string(std::string &str, string_attrs_t &sa)
             case 'O': {
                 int role_int;
 
-                if (sscanf(&(str[caps[1].c_begin]), "%d", &role_int) == 1) {
+                if (sscanf(&(str[params_begin]), "%d", &role_int) == 1) {
                     if (role_int >= 0 && role_int < view_colors::VCR__MAX) {
                         attrs = vc.attrs_for_role(
                             (view_colors::role_t) role_int);
@@ -133,20 +209,18 @@ void scrub_ansi_string(std::string &str, string_attrs_t &sa)
                 break;
             }
         }
-        str.erase(str.begin() + caps[0].c_begin,
-                  str.begin() + caps[0].c_end);
+        str.erase(str.begin() + seq_begin, str.begin() + seq_end);
 
         if (has_attrs) {
             if (!sa.empty()) {
-                sa.back().sa_range.lr_end = caps[0].c_begin;
+                sa.back().sa_range.lr_end = seq_begin;
             }
-            lr.lr_start = caps[0].c_begin;
+            lr.lr_start = seq_begin;
             lr.lr_end   = -1;
             sa.push_back(string_attr(lr, &view_curses::VC_STYLE, attrs));
         }
-
-        pi.reset(str);
-    }
+    } while (find_ansi_sequence(str, rescan_start(str, seq_begin),
+                                seq_begin, seq_cmd));
 }
 
 void add_ansi_vars(std::map<std::string, std::string> &vars)
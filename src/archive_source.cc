@@ -0,0 +1,311 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file archive_source.cc
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <functional>
+
+#include "auto_fd.hh"
+#include "base/lnav_log.hh"
+#include "fmt/format.h"
+#include "archive_source.hh"
+
+using namespace std;
+
+static const size_t TAR_BLOCK_SIZE = 512;
+
+/** Long names and extended headers that are bigger than this are skipped. */
+static const uint64_t MAX_EXT_HEADER_SIZE = 64 * 1024;
+
+/**
+ * Parse a numeric field of a tar header, which is either octal text or, for
+ * values that do not fit, a big-endian binary number flagged by the high
+ * bit of the first byte.
+ */
+static bool parse_tar_number(const char *field, size_t len, uint64_t &out)
+{
+    out = 0;
+    if (field[0] & 0x80) {
+        for (size_t lpc = 0; lpc < len; lpc++) {
+            unsigned char ch = field[lpc];
+
+            if (lpc == 0) {
+                ch &= 0x7f;
+            }
+            out = (out << 8) | ch;
+        }
+        return true;
+    }
+
+    size_t lpc = 0;
+
+    while (lpc < len && field[lpc] == ' ') {
+        lpc += 1;
+    }
+    for (; lpc < len && field[lpc] != '\0' && field[lpc] != ' '; lpc++) {
+        if (field[lpc] < '0' || field[lpc] > '7') {
+            return false;
+        }
+        out = (out << 3) | (field[lpc] - '0');
+    }
+
+    return true;
+}
+
+/** @return True if the checksum in the header matches its contents. */
+static bool tar_checksum_ok(const unsigned char *hdr)
+{
+    uint64_t expected;
+    uint64_t sum = 0;
+
+    if (!parse_tar_number((const char *) &hdr[148], 8, expected)) {
+        return false;
+    }
+    for (size_t lpc = 0; lpc < TAR_BLOCK_SIZE; lpc++) {
+        // The checksum field itself is summed as if it were all spaces.
+        if (lpc >= 148 && lpc < 156) {
+            sum += ' ';
+        } else {
+            sum += hdr[lpc];
+        }
+    }
+
+    return sum == expected;
+}
+
+static string tar_string(const unsigned char *field, size_t len)
+{
+    return string((const char *) field,
+                  strnlen((const char *) field, len));
+}
+
+/**
+ * Find the "path" record in a pax extended header, each record looks like
+ * "<length> <key>=<value>\n".
+ */
+static string pax_path(const string &data)
+{
+    size_t off = 0;
+
+    while (off < data.size()) {
+        size_t space = data.find(' ', off);
+
+        if (space == string::npos) {
+            break;
+        }
+
+        size_t rec_len = strtoul(data.c_str() + off, nullptr, 10);
+
+        if (rec_len == 0 || off + rec_len > data.size()) {
+            break;
+        }
+
+        string rec = data.substr(space + 1, off + rec_len - space - 2);
+
+        if (rec.compare(0, 5, "path=") == 0) {
+            return rec.substr(5);
+        }
+        off += rec_len;
+    }
+
+    return "";
+}
+
+vector<line_buffer::gz_indexed::indexDict> archive_index::syncpoints_for(
+    const archive_member &am) const
+{
+    vector<line_buffer::gz_indexed::indexDict> retval;
+    const auto &sps = this->ai_syncpoints;
+
+    for (size_t lpc = 0; lpc < sps.size(); lpc++) {
+        if (sps[lpc].out > am.am_range.next_offset()) {
+            break;
+        }
+        if (lpc + 1 < sps.size() && sps[lpc + 1].out <= am.am_range.fr_offset) {
+            continue;
+        }
+        retval.push_back(sps[lpc]);
+    }
+
+    return retval;
+}
+
+Result<archive_index, string> index_tar_archive(const string &path)
+{
+    auto_fd fd(open(path.c_str(), O_RDONLY));
+    unsigned char gz_id[2];
+    archive_index retval;
+
+    if (fd == -1) {
+        return Err(string("unable to open archive -- ") + strerror(errno));
+    }
+    fd.close_on_exec();
+
+    line_buffer::gz_indexed gz;
+    function<ssize_t(void *, off_t, size_t)> read_at;
+
+    if (pread(fd, gz_id, sizeof(gz_id), 0) == sizeof(gz_id) &&
+        gz_id[0] == 0x1f && gz_id[1] == 0x8b) {
+        retval.ai_gzipped = true;
+        gz.open(fd.release());
+        read_at = [&gz](void *buf, off_t off, size_t len) -> ssize_t {
+            size_t total = 0;
+
+            // The reader can return less than was asked for, so keep going
+            // until the end of the data.
+            while (total < len) {
+                int rc = gz.read((char *) buf + total, off + total,
+                                 len - total);
+
+                if (rc <= 0) {
+                    break;
+                }
+                total += rc;
+            }
+            return total;
+        };
+    } else {
+        read_at = [&fd](void *buf, off_t off, size_t len) -> ssize_t {
+            return pread(fd, buf, len, off);
+        };
+    }
+
+    unsigned char hdr[TAR_BLOCK_SIZE];
+    string ext_name;
+    off_t off = 0;
+
+    try {
+        while (read_at(hdr, off, sizeof(hdr)) == sizeof(hdr)) {
+            bool all_zero = true;
+
+            for (auto ch : hdr) {
+                if (ch != 0) {
+                    all_zero = false;
+                    break;
+                }
+            }
+            if (all_zero) {
+                break;
+            }
+
+            if (!tar_checksum_ok(hdr)) {
+                if (off == 0) {
+                    return Err(string("not a tar archive"));
+                }
+                log_error("%s: bad tar header checksum at %lld",
+                          path.c_str(), (long long) off);
+                break;
+            }
+
+            uint64_t size, mtime;
+
+            if (!parse_tar_number((const char *) &hdr[124], 12, size) ||
+                !parse_tar_number((const char *) &hdr[136], 12, mtime)) {
+                log_error("%s: bad tar header at %lld",
+                          path.c_str(), (long long) off);
+                break;
+            }
+
+            off_t data_off = off + TAR_BLOCK_SIZE;
+            char type = hdr[156];
+
+            switch (type) {
+                case 'L':
+                case 'x':
+                    // The name of the next file is too long for the header.
+                    if (size <= MAX_EXT_HEADER_SIZE) {
+                        string data(size, '\0');
+
+                        if (read_at(&data[0], data_off, size) !=
+                            (ssize_t) size) {
+                            break;
+                        }
+                        if (type == 'L') {
+                            ext_name = data.substr(0, strnlen(data.c_str(),
+                                                              size));
+                        } else {
+                            ext_name = pax_path(data);
+                        }
+                    }
+                    break;
+                case '\0':
+                case '0':
+                case '7': {
+                    archive_member am;
+
+                    if (!ext_name.empty()) {
+                        am.am_name = ext_name;
+                    } else {
+                        auto prefix = memcmp(&hdr[257], "ustar", 5) == 0 ?
+                                      tar_string(&hdr[345], 155) : "";
+
+                        am.am_name = tar_string(&hdr[0], 100);
+                        if (!prefix.empty()) {
+                            am.am_name = prefix + "/" + am.am_name;
+                        }
+                    }
+                    am.am_range.fr_offset = data_off;
+                    am.am_range.fr_size = size;
+                    am.am_mtime = mtime;
+                    if (size > 0) {
+                        retval.ai_members.emplace_back(std::move(am));
+                    }
+                    ext_name.clear();
+                    break;
+                }
+                default:
+                    // Directories, links, and devices have nothing to read.
+                    ext_name.clear();
+                    break;
+            }
+
+            off = data_off +
+                  (size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+        }
+    } catch (const line_buffer::error &e) {
+        // The code is from zlib, not an errno.
+        return Err(fmt::format("unable to inflate archive -- {}", e.e_err));
+    }
+
+    if (retval.ai_gzipped) {
+        retval.ai_syncpoints = gz.get_syncpoints();
+    }
+
+    log_info("%s: found %d members in the tar archive",
+             path.c_str(), retval.ai_members.size());
+
+    return Ok(std::move(retval));
+}
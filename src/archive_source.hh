@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file archive_source.hh
+ */
+
+#ifndef lnav_archive_source_hh
+#define lnav_archive_source_hh
+
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include "base/file_range.hh"
+#include "base/result.h"
+#include "line_buffer.hh"
+
+/**
+ * A regular file stored in an archive.
+ */
+struct archive_member {
+    /** The path of the file in the archive. */
+    std::string am_name;
+    /**
+     * The range of the file's data in the archive.  For a gzipped archive,
+     * this is a range of the decompressed data.
+     */
+    file_range am_range;
+    time_t am_mtime{0};
+};
+
+/**
+ * The files in a tar archive, which lets each one be read straight out of
+ * the archive, instead of extracting them to disk first.
+ */
+struct archive_index {
+    bool ai_gzipped{false};
+    std::vector<archive_member> ai_members;
+    /**
+     * For a gzipped archive, the syncpoints that were found while the
+     * headers were read.
+     */
+    std::vector<line_buffer::gz_indexed::indexDict> ai_syncpoints;
+
+    /**
+     * @param am A member of this archive.
+     * @return The syncpoints needed to read the member without inflating
+     *   the data before it: the closest one before the member and the ones
+     *   inside of it.
+     */
+    std::vector<line_buffer::gz_indexed::indexDict> syncpoints_for(
+        const archive_member &am) const;
+};
+
+/**
+ * Read the headers of a tar archive, which can be gzipped, to find the
+ * regular files in it.  A gzipped archive has to be inflated once to find
+ * the headers, the syncpoints that are found along the way are kept so the
+ * members can be read quickly afterward.
+ *
+ * @param path The path to the archive.
+ * @return The members of the archive or an error message.
+ */
+Result<archive_index, std::string> index_tar_archive(const std::string &path);
+
+#endif
@@ -0,0 +1,327 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file chunked_vector.hh
+ */
+
+#ifndef lnav_chunked_vector_hh
+#define lnav_chunked_vector_hh
+
+#include <stddef.h>
+
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * A sequence that keeps its elements in fixed-size chunks instead of one
+ * contiguous array.  Growing the sequence only allocates a new chunk, so
+ * there is never more than one partially-filled chunk of slack and the
+ * elements are not copied to a bigger array, which would need the memory
+ * for both the old and new copies at the same time.  References to the
+ * elements stay valid until the element is removed.
+ *
+ * Only the operations needed for an append-mostly index are supported:
+ * elements are added and removed at the end.
+ *
+ * @tparam T The type of element.
+ * @tparam ChunkBits The log2 of the number of elements in a chunk.
+ */
+template<typename T, size_t ChunkBits = 12>
+class chunked_vector {
+    struct chunk_t;
+
+public:
+    static const size_t CHUNK_SIZE = 1UL << ChunkBits;
+
+    using value_type = T;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using reference = T &;
+    using const_reference = const T &;
+
+    template<bool Const>
+    class iter_base {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = ptrdiff_t;
+        using pointer = typename std::conditional<Const, const T *, T *>::type;
+        using reference =
+            typename std::conditional<Const, const T &, T &>::type;
+        using container_t = typename std::conditional<
+            Const, const chunked_vector, chunked_vector>::type;
+
+        iter_base() = default;
+
+        iter_base(container_t *cv, size_t index)
+            : i_vec(cv), i_index(index) {
+        };
+
+        /** Iterators can be converted to const_iterators. */
+        template<bool C = Const, typename = typename std::enable_if<C>::type>
+        iter_base(const iter_base<false> &other)
+            : i_vec(other.i_vec), i_index(other.i_index) {
+        };
+
+        reference operator*() const {
+            return (*this->i_vec)[this->i_index];
+        };
+
+        pointer operator->() const {
+            return &(*this->i_vec)[this->i_index];
+        };
+
+        reference operator[](difference_type n) const {
+            return (*this->i_vec)[this->i_index + n];
+        };
+
+        iter_base &operator++() {
+            this->i_index += 1;
+            return *this;
+        };
+
+        iter_base operator++(int) {
+            iter_base retval = *this;
+
+            this->i_index += 1;
+            return retval;
+        };
+
+        iter_base &operator--() {
+            this->i_index -= 1;
+            return *this;
+        };
+
+        iter_base operator--(int) {
+            iter_base retval = *this;
+
+            this->i_index -= 1;
+            return retval;
+        };
+
+        iter_base &operator+=(difference_type n) {
+            this->i_index += n;
+            return *this;
+        };
+
+        iter_base &operator-=(difference_type n) {
+            this->i_index -= n;
+            return *this;
+        };
+
+        iter_base operator+(difference_type n) const {
+            return iter_base(this->i_vec, this->i_index + n);
+        };
+
+        iter_base operator-(difference_type n) const {
+            return iter_base(this->i_vec, this->i_index - n);
+        };
+
+        friend iter_base operator+(difference_type n, const iter_base &iter) {
+            return iter + n;
+        };
+
+        friend difference_type operator-(const iter_base &lhs,
+                                         const iter_base &rhs) {
+            return (difference_type) lhs.i_index -
+                   (difference_type) rhs.i_index;
+        };
+
+        friend bool operator==(const iter_base &lhs, const iter_base &rhs) {
+            return lhs.i_index == rhs.i_index;
+        };
+
+        friend bool operator!=(const iter_base &lhs, const iter_base &rhs) {
+            return lhs.i_index != rhs.i_index;
+        };
+
+        friend bool operator<(const iter_base &lhs, const iter_base &rhs) {
+            return lhs.i_index < rhs.i_index;
+        };
+
+        friend bool operator>(const iter_base &lhs, const iter_base &rhs) {
+            return lhs.i_index > rhs.i_index;
+        };
+
+        friend bool operator<=(const iter_base &lhs, const iter_base &rhs) {
+            return lhs.i_index <= rhs.i_index;
+        };
+
+        friend bool operator>=(const iter_base &lhs, const iter_base &rhs) {
+            return lhs.i_index >= rhs.i_index;
+        };
+
+    private:
+        template<bool> friend class iter_base;
+
+        container_t *i_vec{nullptr};
+        size_t i_index{0};
+    };
+
+    using iterator = iter_base<false>;
+    using const_iterator = iter_base<true>;
+
+    chunked_vector() = default;
+
+    template<typename InputIt>
+    chunked_vector(InputIt first, InputIt last) {
+        this->append(first, last);
+    };
+
+    chunked_vector(chunked_vector &&other) noexcept
+        : cv_chunks(std::move(other.cv_chunks)), cv_size(other.cv_size) {
+        other.cv_size = 0;
+    };
+
+    chunked_vector(const chunked_vector &) = delete;
+
+    chunked_vector &operator=(chunked_vector &&other) noexcept {
+        this->clear();
+        this->swap(other);
+        return *this;
+    };
+
+    chunked_vector &operator=(const chunked_vector &) = delete;
+
+    ~chunked_vector() {
+        this->clear();
+    };
+
+    size_t size() const { return this->cv_size; };
+
+    bool empty() const { return this->cv_size == 0; };
+
+    /** @return The number of elements that fit in the allocated chunks. */
+    size_t capacity() const { return this->cv_chunks.size() * CHUNK_SIZE; };
+
+    /** @return The number of bytes allocated for the elements. */
+    size_t get_memory_usage() const {
+        return this->capacity() * sizeof(T) +
+               this->cv_chunks.capacity() * sizeof(std::unique_ptr<chunk_t>);
+    };
+
+    T &operator[](size_t index) { return *this->slot(index); };
+
+    const T &operator[](size_t index) const { return *this->slot(index); };
+
+    T &front() { return *this->slot(0); };
+
+    const T &front() const { return *this->slot(0); };
+
+    T &back() { return *this->slot(this->cv_size - 1); };
+
+    const T &back() const { return *this->slot(this->cv_size - 1); };
+
+    iterator begin() { return iterator(this, 0); };
+
+    iterator end() { return iterator(this, this->cv_size); };
+
+    const_iterator begin() const { return const_iterator(this, 0); };
+
+    const_iterator end() const { return const_iterator(this, this->cv_size); };
+
+    const_iterator cbegin() const { return this->begin(); };
+
+    const_iterator cend() const { return this->end(); };
+
+    template<typename... Args>
+    T &emplace_back(Args&&... args) {
+        if (this->cv_size == this->capacity()) {
+            this->cv_chunks.emplace_back(new chunk_t);
+        }
+
+        T *retval = new (this->slot(this->cv_size))
+            T(std::forward<Args>(args)...);
+
+        this->cv_size += 1;
+        return *retval;
+    };
+
+    void push_back(const T &value) {
+        this->emplace_back(value);
+    };
+
+    template<typename InputIt>
+    void append(InputIt first, InputIt last) {
+        for (; first != last; ++first) {
+            this->emplace_back(*first);
+        }
+    };
+
+    /**
+     * Remove the last element.  The chunk it was in is kept for the next
+     * element that is added, call shrink_to_fit() to release it.
+     */
+    void pop_back() {
+        this->cv_size -= 1;
+        this->slot(this->cv_size)->~T();
+    };
+
+    void clear() {
+        if (!std::is_trivially_destructible<T>::value) {
+            for (size_t lpc = 0; lpc < this->cv_size; lpc++) {
+                this->slot(lpc)->~T();
+            }
+        }
+        this->cv_size = 0;
+        this->cv_chunks.clear();
+    };
+
+    /** Release the chunks that do not hold any elements. */
+    void shrink_to_fit() {
+        this->cv_chunks.resize((this->cv_size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+        this->cv_chunks.shrink_to_fit();
+    };
+
+    void swap(chunked_vector &other) noexcept {
+        this->cv_chunks.swap(other.cv_chunks);
+        std::swap(this->cv_size, other.cv_size);
+    };
+
+private:
+    static const size_t CHUNK_MASK = CHUNK_SIZE - 1;
+
+    struct chunk_t {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type
+            c_elems[CHUNK_SIZE];
+    };
+
+    T *slot(size_t index) const {
+        return reinterpret_cast<T *>(
+            &this->cv_chunks[index >> ChunkBits]->c_elems[index & CHUNK_MASK]);
+    };
+
+    std::vector<std::unique_ptr<chunk_t>> cv_chunks;
+    size_t cv_size{0};
+};
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file index_snapshot.hh
+ */
+
+#ifndef lnav_index_snapshot_hh
+#define lnav_index_snapshot_hh
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+/**
+ * An immutable copy of an index that can be handed to other threads while
+ * the original keeps changing.  The elements are kept in fixed-size chunks
+ * that are shared through reference counts, so publishing a new version of
+ * an index that has only been appended to copies the new elements and
+ * reuses the chunks from the previous version.
+ */
+template<typename T>
+class index_snapshot {
+public:
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    using chunk_t = std::vector<T>;
+
+    /**
+     * Create a new version of an index.
+     *
+     * @param prev The previous version or nullptr.
+     * @param stable The number of elements at the start of the index that
+     *   have not changed since the previous version was created.
+     * @param size The number of elements in the index.
+     * @param version The version number of the new snapshot.
+     * @param elem_at A function that returns the element at a position in
+     *   the index.
+     */
+    template<typename F>
+    static std::shared_ptr<const index_snapshot> create(
+        const index_snapshot *prev,
+        size_t stable,
+        size_t size,
+        size_t version,
+        F elem_at) {
+        auto retval = std::make_shared<index_snapshot>();
+        size_t reuse = 0;
+
+        if (prev != nullptr) {
+            reuse = std::min(stable, prev->size()) / CHUNK_SIZE;
+            reuse = std::min(reuse, size / CHUNK_SIZE);
+        }
+
+        retval->is_chunks.reserve((size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+        for (size_t lpc = 0; lpc < reuse; lpc++) {
+            retval->is_chunks.push_back(prev->is_chunks[lpc]);
+        }
+        for (size_t start = reuse * CHUNK_SIZE;
+             start < size;
+             start += CHUNK_SIZE) {
+            auto chunk = std::make_shared<chunk_t>();
+            size_t end = std::min(start + CHUNK_SIZE, size);
+
+            chunk->reserve(end - start);
+            for (size_t pos = start; pos < end; pos++) {
+                chunk->push_back(elem_at(pos));
+            }
+            retval->is_chunks.push_back(std::move(chunk));
+        }
+        retval->is_size = size;
+        retval->is_version = version;
+
+        return retval;
+    };
+
+    size_t size() const {
+        return this->is_size;
+    };
+
+    bool empty() const {
+        return this->is_size == 0;
+    };
+
+    /** @return The version number given when the snapshot was created. */
+    size_t get_version() const {
+        return this->is_version;
+    };
+
+    const T &operator[](size_t index) const {
+        return (*this->is_chunks[index / CHUNK_SIZE])[index % CHUNK_SIZE];
+    };
+
+    /** @return True if the given chunk is shared with the other snapshot. */
+    bool shares_chunk(const index_snapshot &other, size_t chunk_index) const {
+        return chunk_index < this->is_chunks.size() &&
+               chunk_index < other.is_chunks.size() &&
+               this->is_chunks[chunk_index] == other.is_chunks[chunk_index];
+    };
+
+private:
+    std::vector<std::shared_ptr<const chunk_t>> is_chunks;
+    size_t is_size{0};
+    size_t is_version{0};
+};
+
+#endif
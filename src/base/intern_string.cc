@@ -33,10 +33,74 @@
 
 #include <string.h>
 
+#include <atomic>
+#include <new>
+
 #include "intern_string.hh"
+#include "pthreadpp.hh"
+
+/**
+ * The table is split into shards that each have their own lock and arena.
+ * The lock is only taken when a string needs to be added, lookups of
+ * strings that are already in the table walk the chains without locking.
+ * Entries are never removed and the "is_next" link of an entry does not
+ * change after it is published, so a reader will always see a consistent
+ * chain.
+ */
+const static size_t SHARD_COUNT = 16;
+const static size_t BUCKETS_PER_SHARD = 1024;
+
+/** The size of the blocks that the strings are allocated from. */
+const static size_t ARENA_BLOCK_SIZE = 64 * 1024;
+
+struct intern_shard {
+    pthread_mutex_t is_mutex = PTHREAD_MUTEX_INITIALIZER;
+    std::atomic<intern_string *> is_buckets[BUCKETS_PER_SHARD];
+    char *is_block{nullptr};
+    size_t is_block_remaining{0};
+
+    /**
+     * Allocate memory from the arena, the shard's lock must be held.
+     */
+    void *allocate(size_t size) {
+        const size_t align = alignof(intern_string);
+
+        size = (size + align - 1) & ~(align - 1);
+        if (size > ARENA_BLOCK_SIZE / 4) {
+            return new char[size];
+        }
+        if (size > this->is_block_remaining) {
+            this->is_block = new char[ARENA_BLOCK_SIZE];
+            this->is_block_remaining = ARENA_BLOCK_SIZE;
+        }
 
-const static int TABLE_SIZE = 4095;
-static intern_string *TABLE[TABLE_SIZE];
+        void *retval = this->is_block;
+
+        this->is_block += size;
+        this->is_block_remaining -= size;
+
+        return retval;
+    };
+};
+
+static intern_shard *get_shards()
+{
+    // The shards are leaked on purpose since interned strings can be used
+    // by static destructors.
+    static intern_shard *retval = []() {
+        auto shards = new intern_shard[SHARD_COUNT];
+
+        for (size_t lpc = 0; lpc < SHARD_COUNT; lpc++) {
+            for (auto &bucket : shards[lpc].is_buckets) {
+                bucket.store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        return shards;
+    }();
+
+    return retval;
+}
 
 unsigned long
 hash_str(const char *str, size_t len)
@@ -51,30 +115,58 @@ hash_str(const char *str, size_t len)
     return retval;
 }
 
-const intern_string *intern_string::lookup(const char *str, ssize_t len)
+const intern_string *intern_string::find_in_chain(const intern_string *curr,
+                                                  const intern_string *stop,
+                                                  const char *str,
+                                                  ssize_t len)
 {
-    unsigned long h;
-    intern_string *curr;
+    while (curr != stop) {
+        if (curr->is_len == len && memcmp(curr->is_str, str, len) == 0) {
+            return curr;
+        }
+        curr = curr->is_next;
+    }
 
+    return nullptr;
+}
+
+const intern_string *intern_string::lookup(const char *str, ssize_t len)
+{
     if (len == -1) {
         len = strlen(str);
     }
-    h = hash_str(str, len) % TABLE_SIZE;
 
-    curr = TABLE[h];
-    while (curr != NULL) {
-        if (curr->is_len == len && strncmp(curr->is_str, str, len) == 0) {
-            return curr;
-        }
-        curr = curr->is_next;
+    unsigned long h = hash_str(str, len);
+    auto &shard = get_shards()[h % SHARD_COUNT];
+    auto &bucket = shard.is_buckets[(h / SHARD_COUNT) % BUCKETS_PER_SHARD];
+    auto head = bucket.load(std::memory_order_acquire);
+    auto retval = find_in_chain(head, nullptr, str, len);
+
+    if (retval != nullptr) {
+        return retval;
+    }
+
+    mutex_guard mg(shard.is_mutex);
+
+    // Only the entries that were added since the chain was walked above
+    // need to be checked.
+    auto new_head = bucket.load(std::memory_order_relaxed);
+
+    retval = find_in_chain(new_head, head, str, len);
+    if (retval != nullptr) {
+        return retval;
     }
 
-    char *strcp = new char[len + 1];
+    auto mem = (char *) shard.allocate(sizeof(intern_string) + len + 1);
+    auto strcp = mem + sizeof(intern_string);
+
     memcpy(strcp, str, len);
     strcp[len] = '\0';
-    curr = new intern_string(strcp, len);
-    curr->is_next = TABLE[h];
-    TABLE[h] = curr;
+
+    auto curr = new (mem) intern_string(strcp, len);
+
+    curr->is_next = new_head;
+    bucket.store(curr, std::memory_order_release);
 
     return curr;
 }
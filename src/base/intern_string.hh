@@ -181,6 +181,15 @@ public:
     }
 
 private:
+    /**
+     * Search a chain in the table up to, but not including, the given stop
+     * entry.
+     */
+    static const intern_string *find_in_chain(const intern_string *curr,
+                                              const intern_string *stop,
+                                              const char *str,
+                                              ssize_t len);
+
     intern_string(const char *str, ssize_t len)
             : is_next(nullptr), is_str(str), is_len(len) {
 
@@ -27,8 +27,59 @@
 
 #include "config.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #include "is_utf8.hh"
 
+/*
+  Skip over a run of ASCII bytes that does not contain a line feed, sixteen
+  bytes at a time.  Since ASCII bytes are always valid and complete
+  characters, the scan is still on a character boundary when it stops.
+
+  Returns the offset of the first byte that needs to be looked at by the
+  byte-wise loop, either a line feed, a non-ASCII byte, or one of the last
+  few bytes in the buffer.
+*/
+static inline size_t skip_plain_ascii(const unsigned char *str, size_t i, size_t len)
+{
+#if defined(__SSE2__)
+    const __m128i lf = _mm_set1_epi8('\n');
+
+    while (i + 16 <= len) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) &str[i]);
+        // The high bit is set for non-ASCII bytes and, after the OR, for
+        // the line feeds.
+        int mask = _mm_movemask_epi8(
+            _mm_or_si128(chunk, _mm_cmpeq_epi8(chunk, lf)));
+
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+        i += 16;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t lf = vdupq_n_u8('\n');
+    const uint8x16_t high = vdupq_n_u8(0x80);
+
+    while (i + 16 <= len) {
+        uint8x16_t chunk = vld1q_u8(&str[i]);
+        uint8x16_t stop = vorrq_u8(vcgeq_u8(chunk, high),
+                                   vceqq_u8(chunk, lf));
+
+        if (vmaxvq_u8(stop) != 0) {
+            break;
+        }
+        i += 16;
+    }
+#endif
+
+    return i;
+}
+
 /*
   Check if the given unsigned char * is a valid utf-8 sequence.
 
@@ -73,7 +124,7 @@ ssize_t is_utf8(unsigned char *str, size_t len, const char **message, int *fault
 
         if (str[i] <= 0x7F) /* 00..7F */
         {
-            i += 1;
+            i = skip_plain_ascii(str, i + 1, len);
         }
         else if (str[i] >= 0xC2 && str[i] <= 0xDF) /* C2..DF 80..BF */
         {
@@ -0,0 +1,142 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file lru_cache.hh
+ */
+
+#ifndef lnav_lru_cache_hh
+#define lnav_lru_cache_hh
+
+#include <stddef.h>
+
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * Map with a fixed number of entries that evicts the least-recently used
+ * entry when a new one is inserted into a full cache.  The cache is not
+ * thread-safe.
+ *
+ * @tparam K The type of key.
+ * @tparam V The type of value, entries are copied out of the cache.
+ */
+template<typename K, typename V, typename Hash = std::hash<K>>
+class lru_cache {
+public:
+    explicit lru_cache(size_t max_size) : lc_max_size(max_size) {
+    };
+
+    /**
+     * Look up a value and make it the most-recently used entry.
+     *
+     * @return A pointer to the value, valid until the next insert(), or
+     *   nullptr if the key is not in the cache.
+     */
+    V *find(const K &key) {
+        auto iter = this->lc_index.find(key);
+
+        if (iter == this->lc_index.end()) {
+            this->lc_misses += 1;
+            return nullptr;
+        }
+
+        this->lc_hits += 1;
+        this->lc_entries.splice(this->lc_entries.begin(),
+                                this->lc_entries,
+                                iter->second);
+        return &iter->second->second;
+    };
+
+    void insert(const K &key, V value) {
+        auto iter = this->lc_index.find(key);
+
+        if (iter != this->lc_index.end()) {
+            iter->second->second = std::move(value);
+            this->lc_entries.splice(this->lc_entries.begin(),
+                                    this->lc_entries,
+                                    iter->second);
+            return;
+        }
+
+        this->lc_entries.emplace_front(key, std::move(value));
+        this->lc_index[key] = this->lc_entries.begin();
+        while (this->lc_entries.size() > this->lc_max_size) {
+            this->lc_index.erase(this->lc_entries.back().first);
+            this->lc_entries.pop_back();
+            this->lc_evictions += 1;
+        }
+    };
+
+    void erase(const K &key) {
+        auto iter = this->lc_index.find(key);
+
+        if (iter != this->lc_index.end()) {
+            this->lc_entries.erase(iter->second);
+            this->lc_index.erase(iter);
+        }
+    };
+
+    void clear() {
+        this->lc_entries.clear();
+        this->lc_index.clear();
+    };
+
+    size_t size() const {
+        return this->lc_entries.size();
+    };
+
+    /**
+     * Call a function with each key and value, from the most to the least
+     * recently used, without changing the order.
+     */
+    template<typename F>
+    void for_each(F func) const {
+        for (const auto &entry : this->lc_entries) {
+            func(entry.first, entry.second);
+        }
+    };
+
+    size_t get_hits() const { return this->lc_hits; };
+
+    size_t get_misses() const { return this->lc_misses; };
+
+    size_t get_evictions() const { return this->lc_evictions; };
+
+private:
+    typedef std::list<std::pair<K, V>> entry_list;
+
+    size_t lc_max_size;
+    entry_list lc_entries;
+    std::unordered_map<K, typename entry_list::iterator, Hash> lc_index;
+    size_t lc_hits{0};
+    size_t lc_misses{0};
+    size_t lc_evictions{0};
+};
+
+#endif
@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file multi_literal.cc
+ */
+
+#include "config.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#include "lnav_log.hh"
+#include "multi_literal.hh"
+
+multi_literal_matcher::multi_literal_matcher()
+{
+    this->clear();
+}
+
+void multi_literal_matcher::clear()
+{
+    memset(this->mlm_classes, 0, sizeof(this->mlm_classes));
+    this->mlm_class_count = 1;
+    this->mlm_trie.clear();
+    this->mlm_trie.emplace_back();
+    this->mlm_ids.clear();
+    this->compile();
+}
+
+int32_t multi_literal_matcher::child(int32_t state, unsigned char cls) const
+{
+    for (const auto &iter : this->mlm_trie[state].n_children) {
+        if (iter.first == cls) {
+            return iter.second;
+        }
+    }
+
+    return -1;
+}
+
+void multi_literal_matcher::add(const std::string &literal, size_t id)
+{
+    require(!literal.empty());
+
+    int32_t state = 0;
+
+    for (auto ch : literal) {
+        unsigned char lower = tolower((unsigned char) ch);
+        unsigned char upper = toupper((unsigned char) ch);
+
+        if (this->mlm_classes[lower] == 0) {
+            require(this->mlm_class_count < 256);
+
+            this->mlm_classes[lower] = this->mlm_class_count;
+            this->mlm_classes[upper] = this->mlm_class_count;
+            this->mlm_class_count += 1;
+        }
+
+        unsigned char cls = this->mlm_classes[lower];
+        int32_t next = this->child(state, cls);
+
+        if (next == -1) {
+            next = this->mlm_trie.size();
+            this->mlm_trie[state].n_children.emplace_back(cls, next);
+            this->mlm_trie.emplace_back();
+        }
+        state = next;
+    }
+    this->mlm_trie[state].n_ids.push_back(id);
+    this->mlm_ids.push_back(id);
+}
+
+void multi_literal_matcher::compile()
+{
+    size_t width = this->mlm_class_count;
+    size_t node_count = this->mlm_trie.size();
+    std::vector<int32_t> fail(node_count, 0);
+    std::vector<std::vector<size_t>> outputs(node_count);
+    std::vector<int32_t> queue;
+
+    this->mlm_table.assign(node_count * width, 0);
+    for (const auto &iter : this->mlm_trie[0].n_children) {
+        this->mlm_table[iter.first] = iter.second;
+        queue.push_back(iter.second);
+    }
+
+    for (size_t head = 0; head < queue.size(); head++) {
+        int32_t state = queue[head];
+        int32_t *row = &this->mlm_table[state * width];
+        const int32_t *fail_row = &this->mlm_table[fail[state] * width];
+
+        outputs[state] = this->mlm_trie[state].n_ids;
+        outputs[state].insert(outputs[state].end(),
+                              outputs[fail[state]].begin(),
+                              outputs[fail[state]].end());
+
+        for (size_t cls = 0; cls < width; cls++) {
+            row[cls] = fail_row[cls];
+        }
+        for (const auto &iter : this->mlm_trie[state].n_children) {
+            fail[iter.second] = fail_row[iter.first];
+            row[iter.first] = iter.second;
+            queue.push_back(iter.second);
+        }
+    }
+
+    this->mlm_output_start.clear();
+    this->mlm_outputs.clear();
+    for (const auto &out : outputs) {
+        this->mlm_output_start.push_back(this->mlm_outputs.size());
+        this->mlm_outputs.insert(this->mlm_outputs.end(),
+                                 out.begin(), out.end());
+    }
+    this->mlm_output_start.push_back(this->mlm_outputs.size());
+}
@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file multi_literal.hh
+ */
+
+#ifndef lnav_multi_literal_hh
+#define lnav_multi_literal_hh
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+/**
+ * Aho-Corasick matcher that finds which of a set of literal strings occur in
+ * a piece of text with a single pass over the text.  Matching ignores the
+ * case of ASCII letters.
+ */
+class multi_literal_matcher {
+public:
+    multi_literal_matcher();
+
+    /**
+     * Add a literal to the set.  The matcher must be compiled again before
+     * the next scan.
+     *
+     * @param literal The string to search for, must not be empty.
+     * @param id The value passed to the scan callback when found.
+     */
+    void add(const std::string &literal, size_t id);
+
+    /**
+     * Build the failure links and the transition table.
+     */
+    void compile();
+
+    bool empty() const {
+        return this->mlm_ids.empty();
+    };
+
+    void clear();
+
+    /**
+     * Scan the given text and call the callback with the ID of each literal
+     * that was found.  An ID can be reported more than once.
+     */
+    template<typename F>
+    void scan(const char *data, size_t len, F callback) const {
+        const int32_t *table = this->mlm_table.data();
+        int32_t state = 0;
+
+        for (size_t lpc = 0; lpc < len; lpc++) {
+            auto cls = this->mlm_classes[(unsigned char) data[lpc]];
+
+            state = table[state * this->mlm_class_count + cls];
+            if (this->mlm_output_start[state] !=
+                this->mlm_output_start[state + 1]) {
+                for (auto index = this->mlm_output_start[state];
+                     index < this->mlm_output_start[state + 1];
+                     index++) {
+                    callback(this->mlm_outputs[index]);
+                }
+            }
+        }
+    };
+
+private:
+    struct node {
+        std::vector<std::pair<unsigned char, int32_t>> n_children;
+        std::vector<size_t> n_ids;
+    };
+
+    int32_t child(int32_t state, unsigned char cls) const;
+
+    std::vector<node> mlm_trie;
+    std::vector<size_t> mlm_ids;
+    unsigned char mlm_classes[256];
+    size_t mlm_class_count{1};
+    std::vector<int32_t> mlm_table;
+    std::vector<uint32_t> mlm_output_start;
+    std::vector<size_t> mlm_outputs;
+};
+
+#endif
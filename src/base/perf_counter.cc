@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file perf_counter.cc
+ */
+
+#include "config.h"
+
+#include <algorithm>
+
+#include "enum_util.hh"
+#include "lnav_log.hh"
+#include "perf_counter.hh"
+
+static const char *STAGE_NAMES[] = {
+    "read",
+    "scan",
+    "filter",
+    "merge",
+    "search",
+    "render",
+};
+
+const char *perf_stage_name(perf_stage_t stage)
+{
+    require(stage < perf_stage_t::MAX);
+
+    return STAGE_NAMES[to_underlying(stage)];
+}
+
+perf_counter::perf_counter()
+{
+    for (auto &bucket : this->pc_histogram) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void perf_counter::record(uint64_t ns, uint64_t lines, uint64_t bytes)
+{
+    size_t bucket = 0;
+
+    for (auto value = ns >> 1;
+         value != 0 && bucket < HISTOGRAM_BUCKETS - 1;
+         value >>= 1) {
+        bucket += 1;
+    }
+
+    this->pc_calls.fetch_add(1, std::memory_order_relaxed);
+    this->pc_lines.fetch_add(lines, std::memory_order_relaxed);
+    this->pc_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    this->pc_total_ns.fetch_add(ns, std::memory_order_relaxed);
+    this->pc_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    auto max_ns = this->pc_max_ns.load(std::memory_order_relaxed);
+    while (ns > max_ns &&
+           !this->pc_max_ns.compare_exchange_weak(
+               max_ns, ns, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t perf_counter::get_percentile_ns(double fraction) const
+{
+    uint64_t calls = this->get_calls();
+    uint64_t wanted = fraction * calls;
+    uint64_t seen = 0;
+
+    if (calls == 0) {
+        return 0;
+    }
+
+    for (size_t lpc = 0; lpc < HISTOGRAM_BUCKETS; lpc++) {
+        seen += this->pc_histogram[lpc].load(std::memory_order_relaxed);
+        if (seen > 0 && seen >= wanted) {
+            uint64_t upper = 2ULL << lpc;
+
+            return std::min(upper, this->get_max_ns());
+        }
+    }
+
+    return this->get_max_ns();
+}
+
+perf_counter &perf_counter_for(perf_stage_t stage)
+{
+    static perf_counter COUNTERS[to_underlying(perf_stage_t::MAX)];
+
+    require(stage < perf_stage_t::MAX);
+
+    return COUNTERS[to_underlying(stage)];
+}
+
+void perf_record(perf_stage_t stage,
+                 perf_counter *detail,
+                 std::chrono::steady_clock::duration elapsed,
+                 uint64_t lines,
+                 uint64_t bytes)
+{
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        elapsed).count();
+
+    perf_counter_for(stage).record(ns, lines, bytes);
+    if (detail != nullptr) {
+        detail->record(ns, lines, bytes);
+    }
+}
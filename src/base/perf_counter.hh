@@ -0,0 +1,178 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file perf_counter.hh
+ */
+
+#ifndef lnav_perf_counter_hh
+#define lnav_perf_counter_hh
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+
+/**
+ * The stages of processing that are timed.
+ */
+enum class perf_stage_t : int {
+    READ,
+    SCAN,
+    FILTER,
+    MERGE,
+    SEARCH,
+    RENDER,
+
+    MAX
+};
+
+const char *perf_stage_name(perf_stage_t stage);
+
+/**
+ * Counts the calls to a stage and keeps a histogram of their latency.  The
+ * counters can be updated from more than one thread.
+ */
+class perf_counter {
+public:
+    /** Bucket N holds the calls that took less than 2^(N + 1) nanoseconds. */
+    static const size_t HISTOGRAM_BUCKETS = 40;
+
+    perf_counter();
+
+    perf_counter(const perf_counter &) = delete;
+
+    perf_counter &operator=(const perf_counter &) = delete;
+
+    /**
+     * Record a single call.
+     *
+     * @param ns The time taken by the call.
+     * @param lines The number of lines that were processed.
+     * @param bytes The number of bytes that were processed.
+     */
+    void record(uint64_t ns, uint64_t lines = 0, uint64_t bytes = 0);
+
+    uint64_t get_calls() const {
+        return this->pc_calls.load(std::memory_order_relaxed);
+    };
+
+    uint64_t get_lines() const {
+        return this->pc_lines.load(std::memory_order_relaxed);
+    };
+
+    uint64_t get_bytes() const {
+        return this->pc_bytes.load(std::memory_order_relaxed);
+    };
+
+    uint64_t get_total_ns() const {
+        return this->pc_total_ns.load(std::memory_order_relaxed);
+    };
+
+    uint64_t get_max_ns() const {
+        return this->pc_max_ns.load(std::memory_order_relaxed);
+    };
+
+    /**
+     * @param fraction The percentile to compute, between zero and one.
+     * @return An upper bound on the latency of the given fraction of calls.
+     */
+    uint64_t get_percentile_ns(double fraction) const;
+
+private:
+    std::atomic<uint64_t> pc_calls{0};
+    std::atomic<uint64_t> pc_lines{0};
+    std::atomic<uint64_t> pc_bytes{0};
+    std::atomic<uint64_t> pc_total_ns{0};
+    std::atomic<uint64_t> pc_max_ns{0};
+    std::atomic<uint64_t> pc_histogram[HISTOGRAM_BUCKETS];
+};
+
+/**
+ * @return The counter with the totals for the given stage across the whole
+ * process.
+ */
+perf_counter &perf_counter_for(perf_stage_t stage);
+
+/**
+ * Record a call in the counter for a stage and in the detail counter, if
+ * one is given.
+ */
+void perf_record(perf_stage_t stage,
+                 perf_counter *detail,
+                 std::chrono::steady_clock::duration elapsed,
+                 uint64_t lines = 0,
+                 uint64_t bytes = 0);
+
+/**
+ * Times a scope and records it in the counter for a stage and, optionally,
+ * a more specific counter, like one for a particular file.
+ */
+class perf_timer {
+public:
+    explicit perf_timer(perf_stage_t stage, perf_counter *detail = nullptr)
+        : pt_stage(stage),
+          pt_detail(detail),
+          pt_start(std::chrono::steady_clock::now()) {
+    };
+
+    perf_timer(const perf_timer &) = delete;
+
+    ~perf_timer() {
+        this->stop();
+    };
+
+    void add(uint64_t lines, uint64_t bytes = 0) {
+        this->pt_lines += lines;
+        this->pt_bytes += bytes;
+    };
+
+    /**
+     * Record the time taken so far, nothing more is recorded after this
+     * is called.
+     */
+    void stop() {
+        if (!this->pt_stopped) {
+            this->pt_stopped = true;
+            perf_record(this->pt_stage,
+                        this->pt_detail,
+                        std::chrono::steady_clock::now() - this->pt_start,
+                        this->pt_lines,
+                        this->pt_bytes);
+        }
+    };
+
+private:
+    perf_stage_t pt_stage;
+    perf_counter *pt_detail;
+    std::chrono::steady_clock::time_point pt_start;
+    uint64_t pt_lines{0};
+    uint64_t pt_bytes{0};
+    bool pt_stopped{false};
+};
+
+#endif
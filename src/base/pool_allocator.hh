@@ -0,0 +1,141 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file pool_allocator.hh
+ */
+
+#ifndef lnav_pool_allocator_hh
+#define lnav_pool_allocator_hh
+
+#include <stddef.h>
+
+#include <new>
+
+/**
+ * Free lists of fixed-size blocks, one for each block size and thread.
+ * Blocks are carved out of larger chunks that are never returned to the
+ * system, so allocating a block that was freed earlier only takes a couple
+ * of pointer moves.  This suits containers that are built up and torn down
+ * repeatedly, like the element lists made for each parsed line.
+ *
+ * @tparam Size The size of a block.
+ */
+template<size_t Size>
+class node_pool {
+public:
+    static void *allocate() {
+        free_block *&head = get_head();
+
+        if (head == nullptr) {
+            refill(head);
+        }
+
+        free_block *retval = head;
+
+        head = retval->fb_next;
+        return retval;
+    };
+
+    static void deallocate(void *ptr) {
+        free_block *&head = get_head();
+        auto fb = static_cast<free_block *>(ptr);
+
+        fb->fb_next = head;
+        head = fb;
+    };
+
+private:
+    union free_block {
+        free_block *fb_next;
+        max_align_t fb_align;
+        char fb_data[Size];
+    };
+
+    static const size_t BLOCKS_PER_CHUNK = 256;
+
+    static free_block *&get_head() {
+        static thread_local free_block *retval = nullptr;
+
+        return retval;
+    };
+
+    static void refill(free_block *&head) {
+        auto chunk = static_cast<free_block *>(
+            ::operator new(sizeof(free_block) * BLOCKS_PER_CHUNK));
+
+        for (size_t lpc = 0; lpc < BLOCKS_PER_CHUNK; lpc++) {
+            chunk[lpc].fb_next = head;
+            head = &chunk[lpc];
+        }
+    };
+};
+
+/**
+ * Allocator for node-based containers that hands out single objects from a
+ * node_pool.  The allocator has no state, so any two instances are equal
+ * and nodes can be spliced between containers.
+ */
+template<typename T>
+class pool_allocator {
+public:
+    typedef T value_type;
+
+    pool_allocator() = default;
+
+    template<typename U>
+    pool_allocator(const pool_allocator<U> &other) { };
+
+    T *allocate(size_t n) {
+        if (n != 1) {
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+        }
+
+        return static_cast<T *>(node_pool<sizeof(T)>::allocate());
+    };
+
+    void deallocate(T *ptr, size_t n) {
+        if (n != 1) {
+            ::operator delete(ptr);
+            return;
+        }
+
+        node_pool<sizeof(T)>::deallocate(ptr);
+    };
+
+    template<typename U>
+    bool operator==(const pool_allocator<U> &other) const {
+        return true;
+    };
+
+    template<typename U>
+    bool operator!=(const pool_allocator<U> &other) const {
+        return false;
+    };
+};
+
+#endif
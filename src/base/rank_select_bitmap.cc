@@ -0,0 +1,225 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file rank_select_bitmap.cc
+ */
+
+#include "config.h"
+
+#include <algorithm>
+
+#include "lnav_log.hh"
+#include "rank_select_bitmap.hh"
+
+void rank_select_bitmap::clear()
+{
+    this->rs_words.clear();
+    this->rs_block_ranks.clear();
+    this->rs_bit_count = 0;
+    this->rs_ones = 0;
+    this->rs_generation += 1;
+}
+
+void rank_select_bitmap::reserve(size_t bits)
+{
+    this->rs_words.reserve((bits + WORD_BITS - 1) / WORD_BITS);
+}
+
+void rank_select_bitmap::push_back(size_t pos)
+{
+    require(pos >= this->rs_bit_count);
+
+    size_t word_index = pos / WORD_BITS;
+
+    if (word_index >= this->rs_words.size()) {
+        this->rs_words.resize(word_index + 1, 0);
+    }
+    // The counts are for the bits before each block, so the blocks that are
+    // added start with all of the existing bits and none of the ones that
+    // are already there include the new bit.
+    while (this->rs_block_ranks.size() * BLOCK_WORDS <= word_index) {
+        this->rs_block_ranks.push_back(this->rs_ones);
+    }
+    this->rs_words[word_index] |= 1ULL << (pos % WORD_BITS);
+    this->rs_bit_count = pos + 1;
+    this->rs_ones += 1;
+}
+
+void rank_select_bitmap::update_ranks(size_t block)
+{
+    size_t block_count =
+        (this->rs_words.size() + BLOCK_WORDS - 1) / BLOCK_WORDS;
+
+    this->rs_block_ranks.resize(block_count);
+    for (size_t curr = std::max(block, (size_t) 1);
+         curr < block_count;
+         curr++) {
+        uint64_t count = this->rs_block_ranks[curr - 1];
+        size_t word_end = curr * BLOCK_WORDS;
+
+        for (size_t word_index = word_end - BLOCK_WORDS;
+             word_index < word_end;
+             word_index++) {
+            count += __builtin_popcountll(this->rs_words[word_index]);
+        }
+        this->rs_block_ranks[curr] = count;
+    }
+    if (block_count > 0) {
+        this->rs_block_ranks[0] = 0;
+    }
+}
+
+size_t rank_select_bitmap::rank(size_t pos) const
+{
+    if (pos >= this->rs_bit_count) {
+        return this->rs_ones;
+    }
+
+    size_t word_index = pos / WORD_BITS;
+    size_t block = word_index / BLOCK_WORDS;
+    size_t retval = this->rs_block_ranks[block];
+
+    for (size_t curr = block * BLOCK_WORDS; curr < word_index; curr++) {
+        retval += __builtin_popcountll(this->rs_words[curr]);
+    }
+
+    uint64_t mask = (1ULL << (pos % WORD_BITS)) - 1;
+
+    retval += __builtin_popcountll(this->rs_words[word_index] & mask);
+
+    return retval;
+}
+
+size_t rank_select_bitmap::next_set(size_t pos) const
+{
+    size_t word_index = pos / WORD_BITS;
+
+    if (word_index >= this->rs_words.size()) {
+        return this->rs_bit_count;
+    }
+
+    uint64_t bits = this->rs_words[word_index] & (~0ULL << (pos % WORD_BITS));
+
+    while (bits == 0) {
+        word_index += 1;
+        if (word_index >= this->rs_words.size()) {
+            return this->rs_bit_count;
+        }
+        bits = this->rs_words[word_index];
+    }
+
+    return word_index * WORD_BITS + __builtin_ctzll(bits);
+}
+
+size_t rank_select_bitmap::prev_set(size_t pos) const
+{
+    size_t word_index = pos / WORD_BITS;
+    size_t bit = pos % WORD_BITS;
+    uint64_t bits = this->rs_words[word_index] &
+                    (bit == WORD_BITS - 1 ? ~0ULL : (2ULL << bit) - 1);
+
+    while (bits == 0) {
+        require(word_index > 0);
+
+        word_index -= 1;
+        bits = this->rs_words[word_index];
+    }
+
+    return word_index * WORD_BITS + (WORD_BITS - 1 - __builtin_clzll(bits));
+}
+
+size_t rank_select_bitmap::select(size_t n, select_hint &hint) const
+{
+    require(n < this->rs_ones);
+
+    if (hint.sh_rank != SIZE_MAX &&
+        hint.sh_generation == this->rs_generation) {
+        if (n == hint.sh_rank) {
+            return hint.sh_pos;
+        }
+        if (n == hint.sh_rank + 1) {
+            hint.sh_rank = n;
+            hint.sh_pos = this->next_set(hint.sh_pos + 1);
+            return hint.sh_pos;
+        }
+        if (n + 1 == hint.sh_rank) {
+            hint.sh_rank = n;
+            hint.sh_pos = this->prev_set(hint.sh_pos - 1);
+            return hint.sh_pos;
+        }
+    }
+
+    auto ub = std::upper_bound(this->rs_block_ranks.begin(),
+                               this->rs_block_ranks.end(),
+                               (uint64_t) n);
+    size_t block = (ub - this->rs_block_ranks.begin()) - 1;
+    size_t remaining = n - this->rs_block_ranks[block];
+    size_t word_index = block * BLOCK_WORDS;
+    uint64_t bits;
+
+    for (;; word_index++) {
+        bits = this->rs_words[word_index];
+
+        size_t count = __builtin_popcountll(bits);
+
+        if (remaining < count) {
+            break;
+        }
+        remaining -= count;
+    }
+    for (; remaining > 0; remaining--) {
+        bits &= bits - 1;
+    }
+
+    hint.sh_rank = n;
+    hint.sh_pos = word_index * WORD_BITS + __builtin_ctzll(bits);
+    hint.sh_generation = this->rs_generation;
+
+    return hint.sh_pos;
+}
+
+void rank_select_bitmap::truncate(size_t pos)
+{
+    if (pos >= this->rs_bit_count) {
+        return;
+    }
+
+    this->rs_ones = this->rank(pos);
+    this->rs_bit_count = pos;
+    this->rs_words.resize((pos + WORD_BITS - 1) / WORD_BITS);
+    if (pos % WORD_BITS) {
+        this->rs_words.back() &= (1ULL << (pos % WORD_BITS)) - 1;
+    }
+
+    size_t block_count =
+        (this->rs_words.size() + BLOCK_WORDS - 1) / BLOCK_WORDS;
+
+    // The counts for the blocks that are left only cover bits before pos.
+    this->rs_block_ranks.resize(block_count);
+    this->rs_generation += 1;
+}
@@ -0,0 +1,295 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file rank_select_bitmap.hh
+ */
+
+#ifndef lnav_rank_select_bitmap_hh
+#define lnav_rank_select_bitmap_hh
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <iterator>
+#include <vector>
+
+/**
+ * A sorted set of positions stored as a bitmap with one bit per position
+ * and a table with the number of set bits before every block of bits.  The
+ * set is meant to stand in for a sorted vector of positions, so size()
+ * is the number of positions in the set and operator[] returns the N-th
+ * position.  Positions can only be appended at the end, removed in bulk
+ * with remove_if(), or truncated.
+ *
+ * The rank table is kept up-to-date by the methods that change the set, so
+ * the const methods do not modify anything and the set can be read from
+ * several threads at once while nothing is changing it.  Readers that step
+ * through consecutive positions can pass their own select_hint to select()
+ * to avoid searching the rank table for each one.
+ */
+class rank_select_bitmap {
+public:
+    /**
+     * The last position found by a reader, so the next or previous one can
+     * be found from it.  Each reader has to use its own hint.  A hint is
+     * ignored if positions were removed from the set since it was filled.
+     */
+    struct select_hint {
+        size_t sh_rank{SIZE_MAX};
+        size_t sh_pos{0};
+        size_t sh_generation{0};
+    };
+
+    /**
+     * Iterates over the positions in the set in ascending order.  Stepping
+     * to the next position is cheap, jumping around costs a select().
+     */
+    class const_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = size_t;
+        using difference_type = ptrdiff_t;
+        using pointer = const size_t *;
+        using reference = size_t;
+
+        const_iterator(const rank_select_bitmap *rsb = nullptr,
+                       size_t index = 0)
+            : ci_bitmap(rsb), ci_index(index) {
+        };
+
+        size_t operator*() const {
+            return this->ci_bitmap->select(this->ci_index, this->ci_hint);
+        };
+
+        size_t operator[](difference_type n) const {
+            return this->ci_bitmap->select(this->ci_index + n);
+        };
+
+        const_iterator &operator++() {
+            this->ci_index += 1;
+            return *this;
+        };
+
+        const_iterator operator++(int) {
+            const_iterator retval = *this;
+
+            this->ci_index += 1;
+            return retval;
+        };
+
+        const_iterator &operator--() {
+            this->ci_index -= 1;
+            return *this;
+        };
+
+        const_iterator operator--(int) {
+            const_iterator retval = *this;
+
+            this->ci_index -= 1;
+            return retval;
+        };
+
+        const_iterator &operator+=(difference_type n) {
+            this->ci_index += n;
+            return *this;
+        };
+
+        const_iterator &operator-=(difference_type n) {
+            this->ci_index -= n;
+            return *this;
+        };
+
+        const_iterator operator+(difference_type n) const {
+            return const_iterator(this->ci_bitmap, this->ci_index + n);
+        };
+
+        const_iterator operator-(difference_type n) const {
+            return const_iterator(this->ci_bitmap, this->ci_index - n);
+        };
+
+        difference_type operator-(const const_iterator &other) const {
+            return (difference_type) this->ci_index -
+                   (difference_type) other.ci_index;
+        };
+
+        bool operator==(const const_iterator &other) const {
+            return this->ci_index == other.ci_index;
+        };
+
+        bool operator!=(const const_iterator &other) const {
+            return this->ci_index != other.ci_index;
+        };
+
+        bool operator<(const const_iterator &other) const {
+            return this->ci_index < other.ci_index;
+        };
+
+    private:
+        const rank_select_bitmap *ci_bitmap;
+        size_t ci_index;
+        mutable select_hint ci_hint;
+    };
+
+    /** @return The number of positions in the set. */
+    size_t size() const {
+        return this->rs_ones;
+    };
+
+    bool empty() const {
+        return this->rs_ones == 0;
+    };
+
+    /** @return One past the highest position that has been appended. */
+    size_t bit_count() const {
+        return this->rs_bit_count;
+    };
+
+    /** @return The number of bytes used by the bitmap and its ranks. */
+    size_t get_memory_usage() const {
+        return (this->rs_words.capacity() + this->rs_block_ranks.capacity()) *
+               sizeof(uint64_t);
+    };
+
+    void clear();
+
+    /** Reserve space for the given number of bits. */
+    void reserve(size_t bits);
+
+    /**
+     * Add a position to the end of the set.
+     *
+     * @param pos The position, which must be after all of the others.
+     */
+    void push_back(size_t pos);
+
+    bool test(size_t pos) const {
+        if (pos >= this->rs_bit_count) {
+            return false;
+        }
+
+        return (this->rs_words[pos / WORD_BITS] >> (pos % WORD_BITS)) & 1ULL;
+    };
+
+    /** @return The number of positions in the set that are before pos. */
+    size_t rank(size_t pos) const;
+
+    /** @return The N-th position in the set, counting from zero. */
+    size_t select(size_t n) const {
+        select_hint hint;
+
+        return this->select(n, hint);
+    };
+
+    /**
+     * @return The N-th position in the set, counting from zero.
+     * @param hint The reader's last position, which is updated.
+     */
+    size_t select(size_t n, select_hint &hint) const;
+
+    size_t operator[](size_t n) const {
+        return this->select(n);
+    };
+
+    /** Remove the positions at or after pos. */
+    void truncate(size_t pos);
+
+    /**
+     * Remove the positions for which the predicate returns true.  The
+     * predicate is called for each position in ascending order.
+     */
+    template<typename F>
+    void remove_if(F pred) {
+        size_t first_changed = this->rs_words.size();
+
+        for (size_t word_index = 0;
+             word_index < this->rs_words.size();
+             word_index++) {
+            uint64_t bits = this->rs_words[word_index];
+
+            while (bits != 0) {
+                int bit = __builtin_ctzll(bits);
+                uint64_t mask = 1ULL << bit;
+
+                bits &= ~mask;
+                if (pred(word_index * WORD_BITS + bit)) {
+                    this->rs_words[word_index] &= ~mask;
+                    this->rs_ones -= 1;
+                    if (word_index < first_changed) {
+                        first_changed = word_index;
+                    }
+                }
+            }
+        }
+
+        if (first_changed < this->rs_words.size()) {
+            this->update_ranks(first_changed / BLOCK_WORDS + 1);
+            this->rs_generation += 1;
+        }
+    };
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    };
+
+    const_iterator end() const {
+        return const_iterator(this, this->rs_ones);
+    };
+
+private:
+    static const size_t WORD_BITS = 64;
+    static const size_t BLOCK_WORDS = 8;
+    static const size_t BLOCK_BITS = WORD_BITS * BLOCK_WORDS;
+
+    /** Recompute the counts for the blocks starting at 'block'. */
+    void update_ranks(size_t block);
+
+    /** @return The position of the first set bit at or after pos. */
+    size_t next_set(size_t pos) const;
+
+    /**
+     * @return The position of the last set bit at or before pos, there must
+     *   be one.
+     */
+    size_t prev_set(size_t pos) const;
+
+    std::vector<uint64_t> rs_words;
+    /**
+     * The number of set bits before each block of words, there is an entry
+     * for every block in rs_words.
+     */
+    std::vector<uint64_t> rs_block_ranks;
+    size_t rs_bit_count{0};
+    size_t rs_ones{0};
+    /**
+     * Incremented when positions are removed, appending does not move the
+     * positions that are already there so the hints stay valid.
+     */
+    size_t rs_generation{0};
+};
+
+#endif
@@ -0,0 +1,295 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file sketches.cc
+ */
+
+#include "config.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "sketches.hh"
+
+quantile_sketch::quantile_sketch(double relative_accuracy, size_t max_buckets)
+    : qs_gamma((1.0 + relative_accuracy) / (1.0 - relative_accuracy)),
+      qs_log_gamma(log(this->qs_gamma)),
+      qs_min_value(1e-9),
+      qs_max_buckets(max_buckets)
+{
+}
+
+int32_t quantile_sketch::key_for(double magnitude) const
+{
+    return (int32_t) ceil(log(magnitude) / this->qs_log_gamma);
+}
+
+double quantile_sketch::value_for(int32_t key) const
+{
+    return 2.0 * pow(this->qs_gamma, key) / (this->qs_gamma + 1.0);
+}
+
+void quantile_sketch::collapse(std::map<int32_t, uint64_t> &buckets)
+{
+    // Merge the buckets with the smallest magnitudes, since the error for
+    // the larger values is usually what matters.
+    while (buckets.size() > this->qs_max_buckets) {
+        auto first = buckets.begin();
+        auto second = std::next(first);
+
+        second->second += first->second;
+        buckets.erase(first);
+    }
+}
+
+void quantile_sketch::add(double value, uint64_t count)
+{
+    if (isnan(value) || count == 0) {
+        return;
+    }
+
+    if (fabs(value) < this->qs_min_value) {
+        this->qs_zero_count += count;
+    } else if (value > 0) {
+        this->qs_positive[this->key_for(value)] += count;
+        this->collapse(this->qs_positive);
+    } else {
+        this->qs_negative[this->key_for(-value)] += count;
+        this->collapse(this->qs_negative);
+    }
+    this->qs_count += count;
+}
+
+void quantile_sketch::merge(const quantile_sketch &other)
+{
+    for (const auto &bucket : other.qs_positive) {
+        this->qs_positive[bucket.first] += bucket.second;
+    }
+    for (const auto &bucket : other.qs_negative) {
+        this->qs_negative[bucket.first] += bucket.second;
+    }
+    this->collapse(this->qs_positive);
+    this->collapse(this->qs_negative);
+    this->qs_zero_count += other.qs_zero_count;
+    this->qs_count += other.qs_count;
+}
+
+double quantile_sketch::quantile(double fraction) const
+{
+    if (this->qs_count == 0) {
+        return NAN;
+    }
+
+    fraction = std::min(1.0, std::max(0.0, fraction));
+
+    auto rank = (uint64_t) (fraction * (this->qs_count - 1));
+    uint64_t seen = 0;
+
+    for (auto iter = this->qs_negative.rbegin();
+         iter != this->qs_negative.rend();
+         ++iter) {
+        seen += iter->second;
+        if (seen > rank) {
+            return -this->value_for(iter->first);
+        }
+    }
+
+    seen += this->qs_zero_count;
+    if (seen > rank) {
+        return 0.0;
+    }
+
+    for (const auto &bucket : this->qs_positive) {
+        seen += bucket.second;
+        if (seen > rank) {
+            return this->value_for(bucket.first);
+        }
+    }
+
+    return this->value_for(this->qs_positive.rbegin()->first);
+}
+
+distinct_sketch::distinct_sketch(uint8_t precision)
+    : ds_precision(precision), ds_registers(1U << precision, 0)
+{
+}
+
+void distinct_sketch::add_hash(uint64_t hash)
+{
+    auto index = hash >> (64 - this->ds_precision);
+    uint64_t rest = hash << this->ds_precision;
+    uint8_t max_rank = 64 - this->ds_precision + 1;
+    uint8_t rank = rest == 0 ? max_rank :
+                   std::min((uint8_t) (__builtin_clzll(rest) + 1), max_rank);
+
+    if (rank > this->ds_registers[index]) {
+        this->ds_registers[index] = rank;
+    }
+}
+
+void distinct_sketch::merge(const distinct_sketch &other)
+{
+    for (size_t lpc = 0; lpc < this->ds_registers.size(); lpc++) {
+        this->ds_registers[lpc] = std::max(this->ds_registers[lpc],
+                                           other.ds_registers[lpc]);
+    }
+}
+
+uint64_t distinct_sketch::estimate() const
+{
+    double m = this->ds_registers.size();
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double sum = 0.0;
+    size_t zeros = 0;
+
+    for (auto reg : this->ds_registers) {
+        sum += ldexp(1.0, -reg);
+        if (reg == 0) {
+            zeros += 1;
+        }
+    }
+
+    double retval = alpha * m * m / sum;
+
+    if (retval <= 2.5 * m && zeros > 0) {
+        // Linear counting is more accurate for small sets.
+        retval = m * log(m / zeros);
+    }
+
+    return llround(retval);
+}
+
+top_k_sketch::top_k_sketch(size_t capacity)
+    : tk_capacity(std::max((size_t) 1, capacity))
+{
+    this->tk_heap.reserve(this->tk_capacity);
+}
+
+void top_k_sketch::swap_items(size_t lhs, size_t rhs)
+{
+    std::swap(this->tk_heap[lhs], this->tk_heap[rhs]);
+    this->tk_index[this->tk_heap[lhs].i_value] = lhs;
+    this->tk_index[this->tk_heap[rhs].i_value] = rhs;
+}
+
+void top_k_sketch::sift_up(size_t index)
+{
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+
+        if (this->tk_heap[parent].i_count <= this->tk_heap[index].i_count) {
+            break;
+        }
+        this->swap_items(parent, index);
+        index = parent;
+    }
+}
+
+void top_k_sketch::sift_down(size_t index)
+{
+    while (true) {
+        size_t left = index * 2 + 1, right = left + 1, smallest = index;
+
+        if (left < this->tk_heap.size() &&
+            this->tk_heap[left].i_count < this->tk_heap[smallest].i_count) {
+            smallest = left;
+        }
+        if (right < this->tk_heap.size() &&
+            this->tk_heap[right].i_count < this->tk_heap[smallest].i_count) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        this->swap_items(smallest, index);
+        index = smallest;
+    }
+}
+
+void top_k_sketch::add_counted(const std::string &value,
+                               uint64_t count,
+                               uint64_t error)
+{
+    auto iter = this->tk_index.find(value);
+
+    if (iter != this->tk_index.end()) {
+        auto &it = this->tk_heap[iter->second];
+
+        it.i_count += count;
+        it.i_error += error;
+        this->sift_down(iter->second);
+        return;
+    }
+
+    if (this->tk_heap.size() < this->tk_capacity) {
+        this->tk_heap.push_back({value, count, error});
+        this->tk_index[value] = this->tk_heap.size() - 1;
+        this->sift_up(this->tk_heap.size() - 1);
+        return;
+    }
+
+    // Take over the counter with the lowest count, the new value could
+    // have been counted by it all along.
+    auto &min_item = this->tk_heap.front();
+    uint64_t min_count = min_item.i_count;
+
+    this->tk_index.erase(min_item.i_value);
+    min_item = {value, min_count + count, min_count + error};
+    this->tk_index[value] = 0;
+    this->sift_down(0);
+}
+
+void top_k_sketch::add(const std::string &value, uint64_t count)
+{
+    this->add_counted(value, count, 0);
+}
+
+void top_k_sketch::merge(const top_k_sketch &other)
+{
+    for (const auto &it : other.tk_heap) {
+        this->add_counted(it.i_value, it.i_count, it.i_error);
+    }
+}
+
+std::vector<top_k_sketch::item> top_k_sketch::top(size_t k) const
+{
+    std::vector<item> retval = this->tk_heap;
+
+    std::sort(retval.begin(), retval.end(), [](const item &lhs, const item &rhs) {
+        if (lhs.i_count != rhs.i_count) {
+            return lhs.i_count > rhs.i_count;
+        }
+        return lhs.i_value < rhs.i_value;
+    });
+    if (retval.size() > k) {
+        retval.resize(k);
+    }
+
+    return retval;
+}
@@ -0,0 +1,153 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file sketches.hh
+ */
+
+#ifndef lnav_sketches_hh
+#define lnav_sketches_hh
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * A quantile sketch with a bounded relative error, based on DDSketch.
+ * Values are counted in buckets whose bounds grow geometrically, so the
+ * memory used only depends on the range of the values and not on how many
+ * there are.
+ */
+class quantile_sketch {
+public:
+    /**
+     * @param relative_accuracy The largest relative error of a quantile.
+     * @param max_buckets The number of buckets to keep for each sign, the
+     *   buckets for the smallest magnitudes are merged past this.
+     */
+    explicit quantile_sketch(double relative_accuracy = 0.01,
+                             size_t max_buckets = 2048);
+
+    void add(double value, uint64_t count = 1);
+
+    /** Add the values counted by another sketch with the same accuracy. */
+    void merge(const quantile_sketch &other);
+
+    /**
+     * @param fraction The quantile to compute, between zero and one.
+     * @return The approximate value at the quantile.
+     */
+    double quantile(double fraction) const;
+
+    uint64_t count() const {
+        return this->qs_count;
+    };
+
+private:
+    int32_t key_for(double magnitude) const;
+
+    double value_for(int32_t key) const;
+
+    void collapse(std::map<int32_t, uint64_t> &buckets);
+
+    double qs_gamma;
+    double qs_log_gamma;
+    /** Magnitudes below this are counted as zero. */
+    double qs_min_value;
+    size_t qs_max_buckets;
+    std::map<int32_t, uint64_t> qs_positive;
+    std::map<int32_t, uint64_t> qs_negative;
+    uint64_t qs_zero_count{0};
+    uint64_t qs_count{0};
+};
+
+/**
+ * Estimates the number of distinct values using HyperLogLog.  The values
+ * are given as 64-bit hashes.
+ */
+class distinct_sketch {
+public:
+    /** @param precision The number of bits used to pick a register. */
+    explicit distinct_sketch(uint8_t precision = 14);
+
+    void add_hash(uint64_t hash);
+
+    /** Combine with another sketch with the same precision. */
+    void merge(const distinct_sketch &other);
+
+    uint64_t estimate() const;
+
+private:
+    uint8_t ds_precision;
+    std::vector<uint8_t> ds_registers;
+};
+
+/**
+ * Finds the most frequent values using the Space-Saving algorithm.  A fixed
+ * number of counters are kept and, when a value without a counter is seen,
+ * the counter with the lowest count is taken over.
+ */
+class top_k_sketch {
+public:
+    struct item {
+        std::string i_value;
+        uint64_t i_count;
+        /** The most that the count could be overestimated by. */
+        uint64_t i_error;
+    };
+
+    /** @param capacity The number of counters to keep. */
+    explicit top_k_sketch(size_t capacity);
+
+    void add(const std::string &value, uint64_t count = 1);
+
+    /** Add the counts from another sketch. */
+    void merge(const top_k_sketch &other);
+
+    /** @return Up to 'k' of the items with the highest counts. */
+    std::vector<item> top(size_t k) const;
+
+private:
+    void add_counted(const std::string &value, uint64_t count, uint64_t error);
+
+    void sift_up(size_t index);
+
+    void sift_down(size_t index);
+
+    void swap_items(size_t lhs, size_t rhs);
+
+    size_t tk_capacity;
+    /** A min-heap ordered by count. */
+    std::vector<item> tk_heap;
+    std::unordered_map<std::string, size_t> tk_index;
+};
+
+#endif
@@ -29,6 +29,14 @@
 
 #include "config.h"
 
+#include <ctype.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #include "is_utf8.hh"
 #include "string_util.hh"
 
@@ -49,3 +57,92 @@ void scrub_to_utf8(char *buffer, size_t length)
         }
     }
 }
+
+static inline bool equal_caseless(const char *lhs, const char *rhs, size_t len)
+{
+    for (size_t lpc = 0; lpc < len; lpc++) {
+        if (tolower((unsigned char) lhs[lpc]) !=
+            tolower((unsigned char) rhs[lpc])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const char *find_caseless(const char *haystack, size_t haystack_len,
+                          const char *needle, size_t needle_len)
+{
+    if (needle_len > haystack_len) {
+        return nullptr;
+    }
+
+    size_t last_start = haystack_len - needle_len;
+    unsigned char first = tolower((unsigned char) needle[0]);
+    unsigned char last = tolower((unsigned char) needle[needle_len - 1]);
+    size_t i = 0;
+
+    /*
+     * Look for the first and last bytes of the needle at the same time,
+     * sixteen possible starting positions at a time, and only compare the
+     * whole needle at the positions where both are found.  Setting the 0x20
+     * bit folds ASCII letters to lowercase, it is only done when the needle
+     * byte is a letter.  Other bytes can fold onto the letter too, but those
+     * are weeded out by the full comparison.
+     */
+#if defined(__SSE2__)
+    const __m128i first_fold = _mm_set1_epi8(isalpha(first) ? 0x20 : 0);
+    const __m128i last_fold = _mm_set1_epi8(isalpha(last) ? 0x20 : 0);
+    const __m128i first_vec = _mm_set1_epi8(first);
+    const __m128i last_vec = _mm_set1_epi8(last);
+
+    while (i + 16 <= last_start + 1) {
+        __m128i block_first = _mm_loadu_si128(
+            (const __m128i *) &haystack[i]);
+        __m128i block_last = _mm_loadu_si128(
+            (const __m128i *) &haystack[i + needle_len - 1]);
+        int mask = _mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(_mm_or_si128(block_first, first_fold), first_vec),
+            _mm_cmpeq_epi8(_mm_or_si128(block_last, last_fold), last_vec)));
+
+        while (mask != 0) {
+            int bit = __builtin_ctz(mask);
+
+            if (equal_caseless(&haystack[i + bit], needle, needle_len)) {
+                return &haystack[i + bit];
+            }
+            mask &= mask - 1;
+        }
+        i += 16;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t first_fold = vdupq_n_u8(isalpha(first) ? 0x20 : 0);
+    const uint8x16_t last_fold = vdupq_n_u8(isalpha(last) ? 0x20 : 0);
+    const uint8x16_t first_vec = vdupq_n_u8(first);
+    const uint8x16_t last_vec = vdupq_n_u8(last);
+
+    while (i + 16 <= last_start + 1) {
+        uint8x16_t block_first = vld1q_u8(
+            (const uint8_t *) &haystack[i]);
+        uint8x16_t block_last = vld1q_u8(
+            (const uint8_t *) &haystack[i + needle_len - 1]);
+        uint8x16_t hits = vandq_u8(
+            vceqq_u8(vorrq_u8(block_first, first_fold), first_vec),
+            vceqq_u8(vorrq_u8(block_last, last_fold), last_vec));
+
+        if (vmaxvq_u8(hits) != 0) {
+            break;
+        }
+        i += 16;
+    }
+#endif
+
+    for (; i <= last_start; i++) {
+        if (tolower((unsigned char) haystack[i]) == first &&
+            equal_caseless(&haystack[i], needle, needle_len)) {
+            return &haystack[i];
+        }
+    }
+
+    return nullptr;
+}
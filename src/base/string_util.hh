@@ -30,8 +30,23 @@
 #ifndef lnav_string_util_hh
 #define lnav_string_util_hh
 
+#include <sys/types.h>
+
 void scrub_to_utf8(char *buffer, size_t length);
 
+/**
+ * Find the first occurrence of a string in a buffer, ignoring the case of
+ * ASCII letters.
+ *
+ * @param haystack The buffer to search.
+ * @param haystack_len The length of the buffer.
+ * @param needle The string to search for.
+ * @param needle_len The length of the needle, must not be zero.
+ * @return A pointer to the start of the match or nullptr if there was none.
+ */
+const char *find_caseless(const char *haystack, size_t haystack_len,
+                          const char *needle, size_t needle_len);
+
 inline bool is_line_ending(char ch) {
     return ch == '\r' || ch == '\n';
 }
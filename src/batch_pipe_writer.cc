@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file batch_pipe_writer.cc
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "base/lnav_log.hh"
+#include "batch_pipe_writer.hh"
+
+using namespace std;
+
+batch_pipe_writer::batch_pipe_writer(auto_fd &fd)
+    : bpw_state(make_shared<state>())
+{
+    this->bpw_batch.reserve(BATCH_SIZE);
+
+    thread(writer_loop, this->bpw_state, std::move(fd)).detach();
+}
+
+batch_pipe_writer::~batch_pipe_writer()
+{
+    this->finish();
+}
+
+bool batch_pipe_writer::append(const char *data, size_t len)
+{
+    if (this->get_errno() != 0) {
+        return false;
+    }
+
+    this->bpw_batch.append(data, len);
+    if (this->bpw_batch.size() >= BATCH_SIZE) {
+        this->queue_batch();
+    }
+
+    return true;
+}
+
+void batch_pipe_writer::finish()
+{
+    if (this->bpw_finished) {
+        return;
+    }
+
+    this->bpw_finished = true;
+    this->queue_batch();
+
+    lock_guard<mutex> lg(this->bpw_state->s_mutex);
+
+    this->bpw_state->s_finished = true;
+    this->bpw_state->s_cond.notify_all();
+}
+
+int batch_pipe_writer::get_errno() const
+{
+    lock_guard<mutex> lg(this->bpw_state->s_mutex);
+
+    return this->bpw_state->s_errno;
+}
+
+void batch_pipe_writer::queue_batch()
+{
+    if (this->bpw_batch.empty()) {
+        return;
+    }
+
+    auto &st = *this->bpw_state;
+    unique_lock<mutex> lk(st.s_mutex);
+
+    st.s_cond.wait(lk, [&st]() {
+        return st.s_batches.size() < MAX_QUEUED_BATCHES || st.s_errno != 0;
+    });
+    if (st.s_errno == 0) {
+        st.s_batches.emplace_back(std::move(this->bpw_batch));
+        st.s_cond.notify_all();
+    }
+    this->bpw_batch.clear();
+    this->bpw_batch.reserve(BATCH_SIZE);
+}
+
+void batch_pipe_writer::writer_loop(shared_ptr<state> st, auto_fd fd)
+{
+    while (true) {
+        string batch;
+
+        {
+            unique_lock<mutex> lk(st->s_mutex);
+
+            st->s_cond.wait(lk, [&st]() {
+                return !st->s_batches.empty() || st->s_finished;
+            });
+            if (st->s_batches.empty()) {
+                break;
+            }
+            batch = std::move(st->s_batches.front());
+            st->s_batches.pop_front();
+            st->s_cond.notify_all();
+        }
+
+        for (size_t off = 0; off < batch.size(); ) {
+            ssize_t rc = write(fd, &batch[off], batch.size() - off);
+
+            if (rc == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                lock_guard<mutex> lg(st->s_mutex);
+
+                log_error("unable to write to pipe -- %s", strerror(errno));
+                st->s_errno = errno;
+                st->s_batches.clear();
+                st->s_cond.notify_all();
+                return;
+            }
+            off += rc;
+        }
+    }
+}
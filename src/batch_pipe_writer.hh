@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file batch_pipe_writer.hh
+ */
+
+#ifndef lnav_batch_pipe_writer_hh
+#define lnav_batch_pipe_writer_hh
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "auto_fd.hh"
+
+/**
+ * Writes data to a pipe from a background thread, so that a slow reader on
+ * the other end does not block the caller.  The data is collected into
+ * large batches that are handed to the thread, the caller only waits if
+ * too many batches are queued up.
+ */
+class batch_pipe_writer {
+public:
+    static const size_t BATCH_SIZE = 1024 * 1024;
+    static const size_t MAX_QUEUED_BATCHES = 64;
+
+    explicit batch_pipe_writer(auto_fd &fd);
+
+    batch_pipe_writer(const batch_pipe_writer &) = delete;
+
+    /** Calls finish() if it has not been called already. */
+    ~batch_pipe_writer();
+
+    /**
+     * Add data to the current batch.
+     *
+     * @return False if an earlier write to the pipe failed.
+     */
+    bool append(const char *data, size_t len);
+
+    bool append(const std::string &str) {
+        return this->append(str.data(), str.size());
+    };
+
+    /**
+     * Queue the last batch.  The pipe is closed by the thread once
+     * everything has been written and the thread exits on its own, so this
+     * returns without waiting for the reader.
+     */
+    void finish();
+
+    /** @return The error from the last failed write or zero. */
+    int get_errno() const;
+
+private:
+    struct state {
+        std::mutex s_mutex;
+        std::condition_variable s_cond;
+        std::deque<std::string> s_batches;
+        bool s_finished{false};
+        int s_errno{0};
+    };
+
+    static void writer_loop(std::shared_ptr<state> st, auto_fd fd);
+
+    void queue_batch();
+
+    std::shared_ptr<state> bpw_state;
+    std::string bpw_batch;
+    bool bpw_finished{false};
+};
+
+#endif
@@ -32,8 +32,11 @@
 #ifndef _big_array_hh
 #define _big_array_hh
 
+#include <string.h>
+#include <unistd.h>
 #include <sys/mman.h>
 
+#include "auto_fd.hh"
 #include "lnav_util.hh"
 
 template<typename T>
@@ -44,30 +47,52 @@ struct big_array {
 
     };
 
+    /**
+     * Make sure there is room for the given number of elements.  The
+     * capacity at least doubles each time so that a steadily growing array
+     * is only moved a few times, and the existing elements are kept.
+     *
+     * @param size The number of elements needed.
+     * @return True if the array had to be moved to a new mapping.
+     */
     bool reserve(size_t size) {
         if (size < this->ba_capacity) {
             return false;
         }
 
-        if (this->ba_ptr) {
-            munmap(this->ba_ptr,
-                   roundup_size(this->ba_capacity * sizeof(T), getpagesize()));
-        }
+        size_t new_capacity = std::max(size + DEFAULT_INCREMENT,
+                                       this->ba_capacity * 2);
 
-        this->ba_capacity = size + DEFAULT_INCREMENT;
-        void *result = mmap(nullptr,
-                            roundup_size(this->ba_capacity * sizeof(T),
-                                         getpagesize()),
-                            PROT_READ|PROT_WRITE,
-                            MAP_ANONYMOUS|MAP_PRIVATE,
-                            -1,
-                            0);
+        this->remap(new_capacity);
 
-        ensure(result != MAP_FAILED);
+        return true;
+    };
 
-        this->ba_ptr = (T *) result;
+    /**
+     * Keep the elements in a file instead of anonymous memory, so that the
+     * kernel can write the pages that have not been used in a while back to
+     * the file when memory is tight, rather than to swap.  The file is
+     * grown sparsely along with the array.  The existing elements are
+     * moved into the file.
+     *
+     * @param fd The file to use, it should be empty and already unlinked.
+     * @return True if the array is now backed by the file.
+     */
+    bool set_backing_file(auto_fd fd) {
+        if (fd == -1) {
+            return false;
+        }
 
-        return true;
+        this->ba_backing_fd.reset(fd.release());
+        if (this->ba_ptr != nullptr) {
+            this->remap(this->ba_capacity);
+        }
+
+        return this->is_file_backed();
+    };
+
+    bool is_file_backed() const {
+        return this->ba_backing_fd != -1;
     };
 
     void clear() {
@@ -78,6 +103,14 @@ struct big_array {
         return this->ba_size;
     };
 
+    /**
+     * @return The number of bytes in the pages of the mapping that have
+     *   been written to, the rest of the reserved capacity is not resident.
+     */
+    size_t get_memory_usage() const {
+        return roundup_size(this->ba_size * sizeof(T), getpagesize());
+    };
+
     bool empty() const {
         return this->ba_size == 0;
     };
@@ -95,6 +128,12 @@ struct big_array {
         return this->ba_ptr[this->ba_size - 1];
     }
 
+    void truncate(size_t size) {
+        require(size <= this->ba_size);
+
+        this->ba_size = size;
+    };
+
     typedef T *iterator;
 
     iterator begin() {
@@ -108,6 +147,109 @@ struct big_array {
     T *ba_ptr;
     size_t ba_size;
     size_t ba_capacity;
+    /** The file that holds the elements, if set_backing_file() was used. */
+    auto_fd ba_backing_fd;
+
+private:
+    /**
+     * Move the elements to a mapping that can hold the given number of
+     * elements, either by growing the current one or by making a new one.
+     */
+    void remap(size_t new_capacity) {
+        size_t old_bytes = roundup_size(this->ba_capacity * sizeof(T),
+                                        getpagesize());
+        size_t new_bytes = roundup_size(new_capacity * sizeof(T),
+                                        getpagesize());
+        void *result = MAP_FAILED;
+
+        if (this->is_file_backed()) {
+            if (ftruncate(this->ba_backing_fd, new_bytes) == 0) {
+                bool copy = this->ba_ptr != nullptr &&
+                            !this->ba_file_mapped;
+
+#ifdef MREMAP_MAYMOVE
+                if (this->ba_ptr != nullptr && this->ba_file_mapped) {
+                    result = mremap(this->ba_ptr, old_bytes, new_bytes,
+                                    MREMAP_MAYMOVE);
+                }
+#endif
+                if (result == MAP_FAILED) {
+                    result = mmap(nullptr,
+                                  new_bytes,
+                                  PROT_READ|PROT_WRITE,
+                                  MAP_SHARED,
+                                  this->ba_backing_fd,
+                                  0);
+                    if (result != MAP_FAILED && this->ba_ptr != nullptr) {
+                        // The elements are already in the file if the old
+                        // mapping was of the file too.
+                        if (copy) {
+                            memcpy(result,
+                                   this->ba_ptr,
+                                   this->ba_size * sizeof(T));
+                        }
+                        munmap(this->ba_ptr, old_bytes);
+                    }
+                }
+            }
+            if (result == MAP_FAILED) {
+                // Out of space for the file, keep going in memory.
+                if (this->ba_file_mapped) {
+                    void *anon = mmap(nullptr,
+                                      new_bytes,
+                                      PROT_READ|PROT_WRITE,
+                                      MAP_ANONYMOUS|MAP_PRIVATE,
+                                      -1,
+                                      0);
+
+                    ensure(anon != MAP_FAILED);
+
+                    memcpy(anon, this->ba_ptr, this->ba_size * sizeof(T));
+                    munmap(this->ba_ptr, old_bytes);
+                    this->ba_ptr = nullptr;
+                    result = anon;
+                }
+                this->ba_backing_fd.reset();
+                this->ba_file_mapped = false;
+            } else {
+                this->ba_file_mapped = true;
+            }
+        }
+
+#ifdef MREMAP_MAYMOVE
+        if (result == MAP_FAILED && this->ba_ptr) {
+            result = mremap(this->ba_ptr, old_bytes, new_bytes, MREMAP_MAYMOVE);
+        }
+#endif
+        if (result == MAP_FAILED) {
+            result = mmap(nullptr,
+                          new_bytes,
+                          PROT_READ|PROT_WRITE,
+                          MAP_ANONYMOUS|MAP_PRIVATE,
+                          -1,
+                          0);
+
+            ensure(result != MAP_FAILED);
+
+            if (this->ba_ptr) {
+                memcpy(result, this->ba_ptr, this->ba_size * sizeof(T));
+                munmap(this->ba_ptr, old_bytes);
+            }
+        }
+
+#ifdef MADV_HUGEPAGE
+        // Large indexes are scanned from end to end, fewer TLB entries help.
+        if (!this->ba_file_mapped) {
+            madvise(result, new_bytes, MADV_HUGEPAGE);
+        }
+#endif
+
+        this->ba_ptr = (T *) result;
+        this->ba_capacity = new_capacity;
+    };
+
+    /** True if ba_ptr is a mapping of ba_backing_fd. */
+    bool ba_file_mapped{false};
 };
 
 #endif
@@ -116,6 +116,11 @@ public:
 
         require(vl >= 0);
 
+        if (this->empty() || this->back() < vl) {
+            this->push_back(vl);
+            return this->end();
+        }
+
         lb = std::lower_bound(this->begin(), this->end(), vl);
         if (lb == this->end() || *lb != vl) {
             this->insert(lb, vl);
@@ -128,6 +133,67 @@ public:
         return retval;
     };
 
+    /**
+     * Insert a group of bookmarks at once.  Inserting the lines one at a
+     * time with insert_once() has to shift the tail of the vector for each
+     * line that is not at the end, so large groups, like the hits for a
+     * search, are appended and merged in a single pass instead.
+     *
+     * @param lines The lines to bookmark, the vector is sorted and any
+     *   duplicates are removed.
+     */
+    void insert_batch(std::vector<LineType> &lines)
+    {
+        if (lines.empty()) {
+            return;
+        }
+
+        if (!std::is_sorted(lines.begin(), lines.end())) {
+            std::sort(lines.begin(), lines.end());
+        }
+        lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+
+        require(lines.front() >= 0);
+
+        auto orig_size = this->size();
+        bool needs_merge = !this->empty() && !(this->back() < lines.front());
+
+        this->insert(this->end(), lines.begin(), lines.end());
+        if (needs_merge) {
+            std::inplace_merge(this->begin(),
+                               this->begin() + orig_size,
+                               this->end());
+            this->erase(std::unique(this->begin(), this->end()), this->end());
+        }
+    };
+
+    /**
+     * Remove the bookmarks in a range with a single erase.
+     *
+     * @see equal_range
+     */
+    void erase_range(LineType start, LineType stop) {
+        auto range = this->equal_range(start, stop);
+
+        this->erase(range.first, range.second);
+    };
+
+    /**
+     * @return The number of bookmarks in a range.
+     * @see equal_range
+     */
+    size_type count_range(LineType start, LineType stop) const {
+        auto lb = std::lower_bound(this->cbegin(), this->cend(), start);
+
+        if (stop == LineType(-1)) {
+            return std::distance(lb, this->cend());
+        }
+
+        auto ub = std::upper_bound(lb, this->cend(), stop);
+
+        return std::distance(lb, ub);
+    };
+
     std::pair<iterator, iterator> equal_range(LineType start, LineType stop) {
         auto lb = std::lower_bound(this->begin(), this->end(), start);
 
@@ -122,14 +122,27 @@ void bottom_status_source::update_marks(listview_curses *lc)
 
         if (!bv.empty() || !tc->get_last_search().empty()) {
             bookmark_vector<vis_line_t>::iterator lb;
+            std::pair<size_t, size_t> hidden{0, 0};
+            char others[64] = "";
+
+            if (tc->get_sub_source() != nullptr) {
+                hidden = tc->get_sub_source()->text_hidden_search_hits();
+            }
+            if (hidden.first > 0) {
+                snprintf(others, sizeof(others),
+                         " (+%'zu in %'zu other files)",
+                         hidden.first, hidden.second);
+            }
 
             lb = std::lower_bound(bv.begin(), bv.end(), tc->get_top());
             if (lb != bv.end() && *lb == tc->get_top()) {
                 sf.set_value(
-                    "  Hit %'d of %'d for ",
-                    std::distance(bv.begin(), lb) + 1, tc->get_match_count());
+                    "  Hit %'d of %'d%s for ",
+                    std::distance(bv.begin(), lb) + 1, tc->get_match_count(),
+                    others);
             } else {
-                sf.set_value("  %'d hits for ", tc->get_match_count());
+                sf.set_value("  %'d hits%s for ", tc->get_match_count(),
+                             others);
             }
         } else {
             sf.clear();
@@ -189,3 +202,25 @@ void bottom_status_source::update_loading(off_t off, size_t total)
         }
     }
 }
+
+void bottom_status_source::update_query_progress(off_t off,
+                                                 size_t total,
+                                                 double lines_per_sec)
+{
+    status_field &sf = this->bss_fields[BSF_LOADING];
+    int pct = total == 0 ? 0 : (int)(((double)off / (double)total) * 100.0);
+    char rate[32];
+
+    if (lines_per_sec >= 1000000.0) {
+        snprintf(rate, sizeof(rate), "%.1fM", lines_per_sec / 1000000.0);
+    } else if (lines_per_sec >= 1000.0) {
+        snprintf(rate, sizeof(rate), "%.1fK", lines_per_sec / 1000.0);
+    } else {
+        snprintf(rate, sizeof(rate), "%d", (int) lines_per_sec);
+    }
+
+    this->bss_load_percent = -1;
+    sf.set_cylon(true);
+    sf.set_role(view_colors::VCR_ACTIVE_STATUS2);
+    sf.set_value(" %2d%% %s/s ", std::min(pct, 99), rate);
+}
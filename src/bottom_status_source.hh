@@ -115,6 +115,16 @@ public:
 
     void update_loading(off_t off, size_t total);
 
+    /**
+     * Show the progress of a running query in place of the loading
+     * indicator.
+     *
+     * @param off The line the query is currently scanning.
+     * @param total The number of lines in the log view.
+     * @param lines_per_sec The rate at which lines are being scanned.
+     */
+    void update_query_progress(off_t off, size_t total, double lines_per_sec);
+
 private:
     status_field bss_prompt;
     status_field bss_error;
@@ -36,25 +36,13 @@
 
 bool column_namer::existing_name(const std::string &in_name) const
 {
-    if (std::binary_search(std::begin(sql_keywords),
-                           std::end(sql_keywords),
-                           toupper(in_name))) {
+    if (this->cn_used_names.count(in_name) > 0) {
         return true;
     }
 
-    if (find(this->cn_builtin_names.begin(),
-             this->cn_builtin_names.end(),
-             in_name) != this->cn_builtin_names.end()) {
-        return true;
-    }
-
-    if (find(this->cn_names.begin(),
-             this->cn_names.end(),
-             in_name) != this->cn_names.end()) {
-        return true;
-    }
-
-    return false;
+    return std::binary_search(std::begin(sql_keywords),
+                              std::end(sql_keywords),
+                              toupper(in_name));
 }
 
 std::string column_namer::add_column(const std::string &in_name)
@@ -91,6 +79,7 @@ std::string column_namer::add_column(const std::string &in_name)
     }
 
     this->cn_names.push_back(retval);
+    this->cn_used_names.insert(retval);
 
     return retval;
 }
@@ -37,6 +37,7 @@
 #include <vector>
 #include <algorithm>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "sql_util.hh"
 #include "lnav_util.hh"
@@ -45,15 +46,26 @@ class column_namer {
 public:
     column_namer()
     {
-        this->cn_builtin_names.emplace_back("col");
+        this->add_builtin_name("col");
     };
 
     bool existing_name(const std::string &in_name) const;
 
+    /** Reserve a name that add_column() should not return. */
+    void add_builtin_name(const std::string &name) {
+        this->cn_builtin_names.emplace_back(name);
+        this->cn_used_names.insert(name);
+    };
+
     std::string add_column(const std::string &in_name);
 
     std::vector<std::string> cn_builtin_names;
     std::vector<std::string> cn_names;
+    /**
+     * The builtin names and the names that were added, so a name can be
+     * checked without searching through both lists.
+     */
+    std::unordered_set<std::string> cn_used_names;
     std::unordered_map<std::string, int> cn_name_counters;
 };
 
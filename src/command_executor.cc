@@ -55,10 +55,16 @@ static const string MSG_FORMAT_STMT =
 int sql_progress(const struct log_cursor &lc)
 {
     static sig_atomic_t sql_counter = 0;
+    static off_t last_off = 0;
+    static struct timeval last_tv;
 
     size_t total = lnav_data.ld_log_source.text_line_count();
     off_t  off   = lc.lc_curr_line;
 
+    if (lnav_data.ld_sql_interrupted) {
+        return 1;
+    }
+
     if (lnav_data.ld_window == NULL) {
         return 0;
     }
@@ -68,7 +74,22 @@ int sql_progress(const struct log_cursor &lc)
     }
 
     if (ui_periodic_timer::singleton().time_to_update(sql_counter)) {
-        lnav_data.ld_bottom_source.update_loading(off, total);
+        struct timeval now, diff;
+        double rate = 0.0;
+
+        gettimeofday(&now, nullptr);
+        timersub(&now, &last_tv, &diff);
+        if (off >= last_off && diff.tv_sec < 2) {
+            double secs = diff.tv_sec + diff.tv_usec / 1000000.0;
+
+            if (secs > 0.0) {
+                rate = (off - last_off) / secs;
+            }
+        }
+        last_off = off;
+        last_tv = now;
+
+        lnav_data.ld_bottom_source.update_query_progress(off, total, rate);
         lnav_data.ld_top_source.update_time();
         lnav_data.ld_status[LNS_TOP].do_update();
         lnav_data.ld_status[LNS_BOTTOM].do_update();
@@ -78,6 +99,156 @@ int sql_progress(const struct log_cursor &lc)
     return 0;
 }
 
+struct materialized_view {
+    string mv_query;
+    /** The number of lines in the log view that have been included. */
+    size_t mv_line_count{0};
+    /** The last line that was included, to detect a rebuilt view. */
+    content_line_t mv_last_line{content_line_t(-1)};
+    size_t mv_generation{0};
+};
+
+static map<string, materialized_view> MATERIALIZED_VIEWS;
+
+static string run_view_query(const string &sql, size_t start_line)
+{
+    shared_ptr<sqlite3_stmt> stmt;
+    string retval;
+    int retcode;
+
+    retcode = lnav_data.ld_stmt_cache.prepare(lnav_data.ld_db.in(),
+                                              sql,
+                                              stmt);
+    if (retcode != SQLITE_OK) {
+        return sqlite3_errmsg(lnav_data.ld_db);
+    }
+    if (stmt == nullptr) {
+        return "";
+    }
+
+    int param_count = sqlite3_bind_parameter_count(stmt.get());
+
+    for (int lpc = 1; lpc <= param_count; lpc++) {
+        const char *name = sqlite3_bind_parameter_name(stmt.get(), lpc);
+
+        if (name != nullptr && strcmp(&name[1], "log_line_start") == 0) {
+            sqlite3_bind_int64(stmt.get(), lpc, start_line);
+        }
+    }
+
+    do {
+        retcode = sqlite3_step(stmt.get());
+    } while (retcode == SQLITE_ROW);
+
+    if (retcode != SQLITE_DONE) {
+        retval = sqlite3_errmsg(lnav_data.ld_db);
+    }
+
+    lnav_data.ld_stmt_cache.release(sql, std::move(stmt));
+
+    return retval;
+}
+
+static string refresh_materialized_view(const string &name,
+                                        materialized_view &mv)
+{
+    logfile_sub_source &lss = lnav_data.ld_log_source;
+    size_t line_count = lss.text_line_count();
+    bool incremental = mv.mv_generation == lss.get_index_generation() &&
+                       line_count >= mv.mv_line_count &&
+                       (mv.mv_line_count == 0 ||
+                        lss.at(vis_line_t(mv.mv_line_count - 1)) ==
+                        mv.mv_last_line);
+    string errmsg;
+
+    if (incremental && line_count == mv.mv_line_count) {
+        return "";
+    }
+
+    auto_mem<char, sqlite3_free> quoted_name;
+
+    quoted_name = sqlite3_mprintf("\"%w\"", name.c_str());
+    if (!incremental) {
+        log_info("rebuilding materialized view -- %s", name.c_str());
+        errmsg = run_view_query(string("DELETE FROM ") + quoted_name.in(), 0);
+        mv.mv_line_count = 0;
+    }
+    if (errmsg.empty()) {
+        errmsg = run_view_query(
+            string("INSERT INTO ") + quoted_name.in() + " " + mv.mv_query,
+            mv.mv_line_count);
+    }
+    if (!errmsg.empty()) {
+        log_error("unable to refresh materialized view %s -- %s",
+                  name.c_str(), errmsg.c_str());
+        return errmsg;
+    }
+
+    mv.mv_line_count = line_count;
+    if (line_count > 0) {
+        mv.mv_last_line = lss.at(vis_line_t(line_count - 1));
+    }
+    mv.mv_generation = lss.get_index_generation();
+
+    return "";
+}
+
+string create_materialized_view(const string &name, const string &query)
+{
+    logfile_sub_source &lss = lnav_data.ld_log_source;
+
+    if (MATERIALIZED_VIEWS.find(name) != MATERIALIZED_VIEWS.end()) {
+        return "materialized view already exists -- " + name;
+    }
+
+    auto_mem<char, sqlite3_free> quoted_name;
+
+    quoted_name = sqlite3_mprintf("\"%w\"", name.c_str());
+
+    string errmsg = run_view_query(
+        string("CREATE TABLE ") + quoted_name.in() + " AS " + query, 0);
+
+    if (!errmsg.empty()) {
+        return errmsg;
+    }
+
+    materialized_view &mv = MATERIALIZED_VIEWS[name];
+    size_t line_count = lss.text_line_count();
+
+    mv.mv_query = query;
+    mv.mv_line_count = line_count;
+    if (line_count > 0) {
+        mv.mv_last_line = lss.at(vis_line_t(line_count - 1));
+    }
+    mv.mv_generation = lss.get_index_generation();
+
+    return "";
+}
+
+string delete_materialized_view(const string &name)
+{
+    auto iter = MATERIALIZED_VIEWS.find(name);
+
+    if (iter == MATERIALIZED_VIEWS.end()) {
+        return "unknown materialized view -- " + name;
+    }
+
+    MATERIALIZED_VIEWS.erase(iter);
+
+    auto_mem<char, sqlite3_free> quoted_name;
+
+    quoted_name = sqlite3_mprintf("\"%w\"", name.c_str());
+
+    return run_view_query(string("DROP TABLE ") + quoted_name.in(), 0);
+}
+
+void refresh_materialized_views()
+{
+    for (auto &iter : MATERIALIZED_VIEWS) {
+        refresh_materialized_view(iter.first, iter.second);
+    }
+}
+
 string execute_from_file(exec_context &ec, const filesystem::path &path, int line_number, char mode, const string &cmdline);
 
 string execute_command(exec_context &ec, const string &cmdline)
@@ -107,11 +278,14 @@ string execute_command(exec_context &ec, const string &cmdline)
 string execute_sql(exec_context &ec, const string &sql, string &alt_msg)
 {
     db_label_source &dls = lnav_data.ld_db_row_source;
-    auto_mem<sqlite3_stmt> stmt(sqlite3_finalize);
+    shared_ptr<sqlite3_stmt> stmt;
     struct timeval start_tv, end_tv;
     string stmt_str = trim(sql);
     string retval;
     int retcode;
+#ifdef HAVE_SQLITE3_STMT_READONLY
+    bool readonly = false;
+#endif
 
     log_info("Executing SQL: %s", sql.c_str());
 
@@ -135,12 +309,12 @@ string execute_sql(exec_context &ec, const string &sql, string &alt_msg)
     sql_progress_guard progress_guard(sql_progress,
                                       source.first,
                                       source.second);
+
+    refresh_materialized_views();
     gettimeofday(&start_tv, NULL);
-    retcode = sqlite3_prepare_v2(lnav_data.ld_db.in(),
-       stmt_str.c_str(),
-       -1,
-       stmt.out(),
-       NULL);
+    retcode = lnav_data.ld_stmt_cache.prepare(lnav_data.ld_db.in(),
+                                              stmt_str,
+                                              stmt);
     if (retcode != SQLITE_OK) {
         const char *errmsg = sqlite3_errmsg(lnav_data.ld_db);
 
@@ -155,15 +329,20 @@ string execute_sql(exec_context &ec, const string &sql, string &alt_msg)
         bool done = false;
         int param_count;
 
-        param_count = sqlite3_bind_parameter_count(stmt.in());
+#ifdef HAVE_SQLITE3_STMT_READONLY
+        // The statement is handed back to the cache before the results are
+        // reported, so check it now.
+        readonly = sqlite3_stmt_readonly(stmt.get());
+#endif
+        param_count = sqlite3_bind_parameter_count(stmt.get());
         for (int lpc = 0; lpc < param_count; lpc++) {
             map<string, string>::iterator ov_iter;
             const char *name;
 
-            name = sqlite3_bind_parameter_name(stmt.in(), lpc + 1);
+            name = sqlite3_bind_parameter_name(stmt.get(), lpc + 1);
             ov_iter = ec.ec_override.find(name);
             if (ov_iter != ec.ec_override.end()) {
-                sqlite3_bind_text(stmt.in(),
+                sqlite3_bind_text(stmt.get(),
                                   lpc,
                                   ov_iter->second.c_str(),
                                   ov_iter->second.length(),
@@ -176,17 +355,17 @@ string execute_sql(exec_context &ec, const string &sql, string &alt_msg)
                 const char *env_value;
 
                 if ((local_var = lvars.find(&name[1])) != lvars.end()) {
-                    sqlite3_bind_text(stmt.in(), lpc + 1,
+                    sqlite3_bind_text(stmt.get(), lpc + 1,
                                       local_var->second.c_str(), -1,
                                       SQLITE_TRANSIENT);
                 }
                 else if ((global_var = gvars.find(&name[1])) != gvars.end()) {
-                    sqlite3_bind_text(stmt.in(), lpc + 1,
+                    sqlite3_bind_text(stmt.get(), lpc + 1,
                                       global_var->second.c_str(), -1,
                                       SQLITE_TRANSIENT);
                 }
                 else if ((env_value = getenv(&name[1])) != NULL) {
-                    sqlite3_bind_text(stmt.in(), lpc + 1, env_value, -1, SQLITE_STATIC);
+                    sqlite3_bind_text(stmt.get(), lpc + 1, env_value, -1, SQLITE_STATIC);
                 }
             }
             else if (name[0] == ':' && ec.ec_line_values != NULL) {
@@ -199,19 +378,19 @@ string execute_sql(exec_context &ec, const string &sql, string &alt_msg)
                     }
                     switch (iter->lv_kind) {
                         case logline_value::VALUE_BOOLEAN:
-                            sqlite3_bind_int64(stmt.in(), lpc + 1, iter->lv_value.i);
+                            sqlite3_bind_int64(stmt.get(), lpc + 1, iter->lv_value.i);
                             break;
                         case logline_value::VALUE_FLOAT:
-                            sqlite3_bind_double(stmt.in(), lpc + 1, iter->lv_value.d);
+                            sqlite3_bind_double(stmt.get(), lpc + 1, iter->lv_value.d);
                             break;
                         case logline_value::VALUE_INTEGER:
-                            sqlite3_bind_int64(stmt.in(), lpc + 1, iter->lv_value.i);
+                            sqlite3_bind_int64(stmt.get(), lpc + 1, iter->lv_value.i);
                             break;
                         case logline_value::VALUE_NULL:
-                            sqlite3_bind_null(stmt.in(), lpc + 1);
+                            sqlite3_bind_null(stmt.get(), lpc + 1);
                             break;
                         default:
-                            sqlite3_bind_text(stmt.in(),
+                            sqlite3_bind_text(stmt.get(),
                                               lpc + 1,
                                               iter->text_value(),
                                               iter->text_length(),
@@ -221,18 +400,21 @@ string execute_sql(exec_context &ec, const string &sql, string &alt_msg)
                 }
             }
             else {
-                sqlite3_bind_null(stmt.in(), lpc + 1);
+                sqlite3_bind_null(stmt.get(), lpc + 1);
                 log_warning("Could not bind variable: %s", name);
             }
         }
 
         if (lnav_data.ld_rl_view != NULL) {
-            lnav_data.ld_rl_view->set_value("Executing query: " + sql + " ...");
+            lnav_data.ld_rl_view->set_value(
+                "Executing query: " + sql + " ... (press CTRL+C to cancel)");
         }
 
-        ec.ec_sql_callback(ec, stmt.in());
+        lnav_data.ld_sql_interrupted = false;
+        lnav_data.ld_sql_running = true;
+        ec.ec_sql_callback(ec, stmt.get());
         while (!done) {
-            retcode = sqlite3_step(stmt.in());
+            retcode = sqlite3_step(stmt.get());
 
             switch (retcode) {
             case SQLITE_OK:
@@ -241,20 +423,28 @@ string execute_sql(exec_context &ec, const string &sql, string &alt_msg)
                 break;
 
             case SQLITE_ROW:
-                ec.ec_sql_callback(ec, stmt.in());
+                ec.ec_sql_callback(ec, stmt.get());
                 break;
 
             default: {
                 const char *errmsg;
 
                 log_error("sqlite3_step error code: %d", retcode);
-                errmsg = sqlite3_errmsg(lnav_data.ld_db);
-                retval = ec.get_error_prefix() + string(errmsg);
+                if (retcode == SQLITE_INTERRUPT &&
+                    lnav_data.ld_sql_interrupted) {
+                    retval = ec.get_error_prefix() + "query cancelled";
+                } else {
+                    errmsg = sqlite3_errmsg(lnav_data.ld_db);
+                    retval = ec.get_error_prefix() + string(errmsg);
+                }
                 done = true;
             }
                 break;
             }
         }
+        lnav_data.ld_sql_running = false;
+        lnav_data.ld_sql_interrupted = false;
+        lnav_data.ld_bottom_source.update_loading(0, 0);
 
         if (!dls.dls_rows.empty() && !ec.ec_local_vars.empty() &&
             !ec.ec_dry_run) {
@@ -274,6 +464,8 @@ string execute_sql(exec_context &ec, const string &sql, string &alt_msg)
         if (lnav_data.ld_rl_view != nullptr) {
             lnav_data.ld_rl_view->set_value("");
         }
+
+        lnav_data.ld_stmt_cache.release(stmt_str, std::move(stmt));
     }
 
     gettimeofday(&end_tv, NULL);
@@ -340,7 +532,7 @@ string execute_sql(exec_context &ec, const string &sql, string &alt_msg)
             }
         }
 #ifdef HAVE_SQLITE3_STMT_READONLY
-        else if (sqlite3_stmt_readonly(stmt.in())) {
+        else if (readonly) {
             retval = "No rows matched";
             alt_msg = "";
 
@@ -685,11 +877,9 @@ int sql_callback(exec_context &ec, sqlite3_stmt *stmt)
     stacked_bar_chart<std::string> &chart = dls.dls_chart;
     view_colors &vc = view_colors::singleton();
     int ncols = sqlite3_column_count(stmt);
-    int row_number;
     int lpc, retval = 0;
 
-    row_number = dls.dls_rows.size();
-    dls.dls_rows.resize(row_number + 1);
+    dls.dls_rows.start_row();
     if (dls.dls_headers.empty()) {
         for (lpc = 0; lpc < ncols; lpc++) {
             int    type    = sqlite3_column_type(stmt, lpc);
@@ -712,7 +902,7 @@ int sql_callback(exec_context &ec, sqlite3_stmt *stmt)
         const char *value = (const char *)sqlite3_column_text(stmt, lpc);
         db_label_source::header_meta &hm = dls.dls_headers[lpc];
 
-        dls.push_column(value);
+        dls.push_column(sqlite3_column_value(stmt, lpc));
         if ((hm.hm_column_type == SQLITE_TEXT ||
              hm.hm_column_type == SQLITE_NULL) && hm.hm_sub_type == 0) {
             sqlite3_value *raw_value = sqlite3_column_value(stmt, lpc);
@@ -736,6 +926,25 @@ int sql_callback(exec_context &ec, sqlite3_stmt *stmt)
         }
     }
 
+    // Show the rows that have arrived so far while a query from the prompt
+    // is still running, instead of waiting for the whole result.
+    static sig_atomic_t db_counter = 0;
+
+    if (lnav_data.ld_mode == LNM_SQL &&
+        lnav_data.ld_window != nullptr &&
+        lnav_data.ld_looping &&
+        !(lnav_data.ld_flags & LNF_HEADLESS) &&
+        dls.dls_rows.size() > 1 &&
+        ui_periodic_timer::singleton().time_to_update(db_counter)) {
+        textview_curses &db_tc = lnav_data.ld_views[LNV_DB];
+
+        ensure_view(&db_tc);
+        db_tc.reload_data();
+        db_tc.do_update();
+        lnav_data.ld_status[LNS_BOTTOM].do_update();
+        refresh();
+    }
+
     return retval;
 }
 
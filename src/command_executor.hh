@@ -114,6 +114,29 @@ std::future<std::string> pipe_callback(
 
 int sql_progress(const struct log_cursor &lc);
 
+/**
+ * Create a table that holds the results of the given query and that is kept
+ * up-to-date as lines are added to the log view.  The "$log_line_start"
+ * parameter in the query is bound to the first log line that has not been
+ * seen yet, so the rows for the new lines are appended to the table.
+ *
+ * @return An empty string on success, otherwise the error message.
+ */
+std::string create_materialized_view(const std::string &name,
+                                     const std::string &query);
+
+/**
+ * @return An empty string on success, otherwise the error message.
+ */
+std::string delete_materialized_view(const std::string &name);
+
+/**
+ * Run the queries for the materialized views over the new lines in the log
+ * view.  If the log view was changed in some other way, the views are
+ * rebuilt from scratch.
+ */
+void refresh_materialized_views();
+
 void add_global_vars(exec_context &ec);
 
 extern bookmark_type_t BM_QUERY;
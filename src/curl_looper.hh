@@ -76,6 +76,17 @@ public:
         curl_easy_setopt(this->cr_handle, CURLOPT_DEBUGFUNCTION, debug_cb);
         curl_easy_setopt(this->cr_handle, CURLOPT_DEBUGDATA, this);
         curl_easy_setopt(this->cr_handle, CURLOPT_VERBOSE, 1);
+#if LIBCURL_VERSION_NUM >= 0x072f00
+        // Use HTTP/2 for HTTPS so that requests to the same host can share
+        // a connection.
+        curl_easy_setopt(this->cr_handle, CURLOPT_HTTP_VERSION,
+                         CURL_HTTP_VERSION_2TLS);
+#endif
+#ifdef CURLPIPE_MULTIPLEX
+        // Wait for an existing connection to a host instead of opening
+        // another one, so that the requests are multiplexed.
+        curl_easy_setopt(this->cr_handle, CURLOPT_PIPEWAIT, 1L);
+#endif
         if (getenv("SSH_AUTH_SOCK") != NULL) {
             curl_easy_setopt(this->cr_handle, CURLOPT_SSH_AUTH_TYPES,
 #ifdef CURLSSH_AUTH_AGENT
@@ -145,6 +156,10 @@ public:
               cl_looping(true),
               cl_curl_multi(curl_multi_cleanup) {
         this->cl_curl_multi.reset(curl_multi_init());
+#ifdef CURLPIPE_MULTIPLEX
+        curl_multi_setopt(this->cl_curl_multi, CURLMOPT_PIPELINING,
+                          CURLPIPE_MULTIPLEX);
+#endif
         pthread_mutex_init(&this->cl_mutex, NULL);
         pthread_cond_init(&this->cl_cond, NULL);
     };
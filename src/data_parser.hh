@@ -41,6 +41,7 @@
 #include <algorithm>
 
 #include "base/lnav_log.hh"
+#include "base/pool_allocator.hh"
 #include "lnav_util.hh"
 #include "pcrepp/pcrepp.hh"
 #include "byte_array.hh"
@@ -226,9 +227,13 @@ public:
     typedef byte_array<2, uint64> schema_id_t;
 
     struct element;
-    /* typedef std::list<element> element_list_t; */
+    /**
+     * The nodes of the element lists come out of a pool since the lists
+     * are rebuilt for every line that is parsed.
+     */
+    typedef std::list<element, pool_allocator<element>> element_list_base_t;
 
-    class element_list_t : public std::list<element> {
+    class element_list_t : public element_list_base_t {
 public:
         element_list_t(const char *varname, const char *fn, int line, int group_depth = -1)
         {
@@ -245,7 +250,7 @@ public:
             LIST_INIT_TRACE;
         };
 
-        element_list_t(const element_list_t &other) : std::list<element>(other) {
+        element_list_t(const element_list_t &other) : element_list_base_t(other) {
             this->el_format = other.el_format;
         }
 
@@ -261,41 +266,41 @@ public:
         {
             ELEMENT_TRACE;
 
-            this->std::list<element>::push_front(elem);
+            this->element_list_base_t::push_front(elem);
         };
 
         void push_back(const element &elem, const char *fn, int line)
         {
             ELEMENT_TRACE;
 
-            this->std::list<element>::push_back(elem);
+            this->element_list_base_t::push_back(elem);
         };
 
         void pop_front(const char *fn, int line)
         {
             LIST_TRACE;
 
-            this->std::list<element>::pop_front();
+            this->element_list_base_t::pop_front();
         };
 
         void pop_back(const char *fn, int line)
         {
             LIST_TRACE;
 
-            this->std::list<element>::pop_back();
+            this->element_list_base_t::pop_back();
         };
 
         void clear2(const char *fn, int line)
         {
             LIST_TRACE;
 
-            this->std::list<element>::clear();
+            this->element_list_base_t::clear();
         };
 
         void swap(element_list_t &other, const char *fn, int line) {
             SWAP_TRACE(other);
 
-            this->std::list<element>::swap(other);
+            this->element_list_base_t::swap(other);
         }
 
         void splice(iterator pos,
@@ -307,9 +312,24 @@ public:
         {
             SPLICE_TRACE;
 
-            this->std::list<element>::splice(pos, other, first, last);
+            this->element_list_base_t::splice(pos, other, first, last);
         }
 
+        static void *operator new(size_t size) {
+            if (size != sizeof(element_list_t)) {
+                return ::operator new(size);
+            }
+            return node_pool<sizeof(element_list_t)>::allocate();
+        };
+
+        static void operator delete(void *ptr, size_t size) {
+            if (size != sizeof(element_list_t)) {
+                ::operator delete(ptr);
+                return;
+            }
+            node_pool<sizeof(element_list_t)>::deallocate(ptr);
+        };
+
         data_format el_format;
     };
 
@@ -33,6 +33,10 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "pcrepp/pcrepp.hh"
 #include "data_scanner.hh"
 
@@ -350,3 +354,144 @@ bool data_scanner::tokenize(pcre_context &pc, data_token_t &token_out)
 
     return true;
 }
+
+enum plain_class_t : unsigned char {
+    PC_OTHER,
+    PC_SPACE,
+    PC_UPPER,
+    PC_LOWER,
+    PC_TERM,
+};
+
+static struct plain_class_table {
+    plain_class_table() {
+        memset(this->pct_class, PC_OTHER, sizeof(this->pct_class));
+        for (int ch = 'a'; ch <= 'z'; ch++) {
+            this->pct_class[ch] = PC_LOWER;
+        }
+        for (int ch = 'A'; ch <= 'Z'; ch++) {
+            this->pct_class[ch] = PC_UPPER;
+        }
+        for (const char *term = "\n()!*;\"?,"; *term; term++) {
+            this->pct_class[(unsigned char) *term] = PC_TERM;
+        }
+        this->pct_class[(unsigned char) ' '] = PC_SPACE;
+        this->pct_class[(unsigned char) '\t'] = PC_SPACE;
+        this->pct_class[(unsigned char) '\r'] = PC_SPACE;
+    };
+
+    unsigned char pct_class[256];
+} PLAIN_CLASSES;
+
+/**
+ * @return The number of lowercase ASCII letters at the start of the string.
+ */
+static size_t lower_run(const unsigned char *str, size_t len)
+{
+    size_t retval = 0;
+
+#if defined(__SSE2__)
+    const __m128i before_a = _mm_set1_epi8('a' - 1);
+    const __m128i after_z = _mm_set1_epi8('z' + 1);
+
+    while (retval + 16 <= len) {
+        __m128i block = _mm_loadu_si128((const __m128i *) &str[retval]);
+        int mask = _mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpgt_epi8(block, before_a),
+            _mm_cmplt_epi8(block, after_z)));
+
+        if (mask != 0xffff) {
+            return retval + __builtin_ctz(~mask);
+        }
+        retval += 16;
+    }
+#endif
+
+    while (retval < len && PLAIN_CLASSES.pct_class[str[retval]] == PC_LOWER) {
+        retval += 1;
+    }
+
+    return retval;
+}
+
+/*
+ * The common tokens in log messages are plain words and the white space
+ * between them.  Recognizing those here with a character class table saves
+ * a trip through the DFA in tokenize2().  The checks below are limited to
+ * cases where none of the other rules in the DFA could produce a longer or
+ * higher-priority match, anything else is left to the DFA.
+ */
+bool data_scanner::tokenize_plain(pcre_context &pc, data_token_t &token_out)
+{
+    static const char *CONSTANTS[] = {
+        "true", "True", "false", "False", "None", "null",
+    };
+
+    pcre_input &pi = this->ds_pcre_input;
+    auto str = (const unsigned char *) pi.get_string();
+    size_t start = pi.pi_next_offset;
+    size_t limit = pi.pi_length;
+
+    if (start + 1 >= limit) {
+        return false;
+    }
+
+    size_t end;
+
+    switch (PLAIN_CLASSES.pct_class[str[start]]) {
+        case PC_SPACE: {
+            end = start + 1;
+            while (end < limit && PLAIN_CLASSES.pct_class[str[end]] == PC_SPACE) {
+                end += 1;
+            }
+            if (end == start + 1) {
+                // A single space before a number or colon could be part of a
+                // time and a carriage return could be part of a line ending.
+                if (isdigit(str[end]) || str[end] == ':' ||
+                    (str[start] == '\r' && str[end] == '\n')) {
+                    return false;
+                }
+            }
+            token_out = DT_WHITE;
+            break;
+        }
+        case PC_UPPER:
+        case PC_LOWER: {
+            end = start + 1 + lower_run(&str[start + 1], limit - start - 1);
+            if (end - start < 2) {
+                return false;
+            }
+            if (end < limit && str[end] != '\0') {
+                auto term_class = PLAIN_CLASSES.pct_class[str[end]];
+
+                if (term_class == PC_SPACE || term_class == PC_TERM) {
+                }
+                else if (str[end] == '.' && end + 1 < limit &&
+                         PLAIN_CLASSES.pct_class[str[end + 1]] == PC_SPACE) {
+                }
+                else {
+                    return false;
+                }
+            }
+            for (const auto constant : CONSTANTS) {
+                if (strlen(constant) == end - start &&
+                    strncmp(constant, (const char *) &str[start], end - start) == 0) {
+                    return false;
+                }
+            }
+            token_out = DT_WORD;
+            break;
+        }
+        default:
+            return false;
+    }
+
+    pcre_context::capture_t *cap = pc.all();
+
+    pc.set_count(2);
+    cap[0].c_begin = cap[1].c_begin = start;
+    cap[0].c_end = cap[1].c_end = end;
+    pi.pi_next_offset = end;
+
+    return true;
+}
@@ -139,6 +139,14 @@ public:
     };
 
 private:
+    /**
+     * Quickly tokenize white space and plain words, which make up most of
+     * a typical message, without running the DFA.
+     *
+     * @return True if a token was found, false if the DFA needs to be used.
+     */
+    bool tokenize_plain(pcre_context &pc, data_token_t &token_out);
+
     std::string ds_line;
     shared_buffer_ref ds_sbr;
     pcre_input ds_pcre_input;
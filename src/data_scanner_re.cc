@@ -50,6 +50,10 @@ bool data_scanner::tokenize2(pcre_context &pc, data_token_t &token_out)
         CAPTURE(tok); \
         return true; \
     }
+    if (this->tokenize_plain(pc, token_out)) {
+        return true;
+    }
+
     static const unsigned char *EMPTY = (const unsigned char *) "";
     pcre_input &pi = this->ds_pcre_input;
     struct _YYCURSOR {
@@ -105,7 +109,7 @@ bool data_scanner::tokenize2(pcre_context &pc, data_token_t &token_out)
     cap[1].c_begin = pi.pi_next_offset;
 
     
-#line 109 "../../lnav/src/data_scanner_re.cc"
+#line 113 "../../lnav/src/data_scanner_re.cc"
 {
 	YYCTYPE yych;
 	unsigned int yyaccept = 0;
@@ -332,9 +336,9 @@ yy2:
 	}
 yy3:
 	++YYCURSOR;
-#line 132 "../../lnav/src/data_scanner_re.re"
+#line 136 "../../lnav/src/data_scanner_re.re"
 	{ return false; }
-#line 338 "../../lnav/src/data_scanner_re.cc"
+#line 342 "../../lnav/src/data_scanner_re.cc"
 yy5:
 	yyaccept = 0;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -492,11 +496,11 @@ yy6:
 	default:	goto yy7;
 	}
 yy7:
-#line 226 "../../lnav/src/data_scanner_re.re"
+#line 230 "../../lnav/src/data_scanner_re.re"
 	{
            RET(DT_SYMBOL);
        }
-#line 500 "../../lnav/src/data_scanner_re.cc"
+#line 504 "../../lnav/src/data_scanner_re.cc"
 yy8:
 	yyaccept = 1;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -515,14 +519,14 @@ yy8:
 	default:	goto yy73;
 	}
 yy9:
-#line 231 "../../lnav/src/data_scanner_re.re"
+#line 235 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_WHITE); }
-#line 521 "../../lnav/src/data_scanner_re.cc"
+#line 525 "../../lnav/src/data_scanner_re.cc"
 yy10:
 	++YYCURSOR;
-#line 230 "../../lnav/src/data_scanner_re.re"
+#line 234 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_LINE); }
-#line 526 "../../lnav/src/data_scanner_re.cc"
+#line 530 "../../lnav/src/data_scanner_re.cc"
 yy12:
 	yyaccept = 1;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -544,9 +548,9 @@ yy12:
 yy13:
 	++YYCURSOR;
 yy14:
-#line 233 "../../lnav/src/data_scanner_re.re"
+#line 237 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_GARBAGE); }
-#line 550 "../../lnav/src/data_scanner_re.cc"
+#line 554 "../../lnav/src/data_scanner_re.cc"
 yy15:
 	yyaccept = 2;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -996,19 +1000,19 @@ yy18:
 	default:	goto yy19;
 	}
 yy19:
-#line 198 "../../lnav/src/data_scanner_re.re"
+#line 202 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_LPAREN); }
-#line 1002 "../../lnav/src/data_scanner_re.cc"
+#line 1006 "../../lnav/src/data_scanner_re.cc"
 yy20:
 	++YYCURSOR;
-#line 199 "../../lnav/src/data_scanner_re.re"
+#line 203 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_RPAREN); }
-#line 1007 "../../lnav/src/data_scanner_re.cc"
+#line 1011 "../../lnav/src/data_scanner_re.cc"
 yy22:
 	++YYCURSOR;
-#line 191 "../../lnav/src/data_scanner_re.re"
+#line 195 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_COMMA); }
-#line 1012 "../../lnav/src/data_scanner_re.cc"
+#line 1016 "../../lnav/src/data_scanner_re.cc"
 yy24:
 	yyaccept = 0;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -1323,9 +1327,9 @@ yy26:
 	default:	goto yy28;
 	}
 yy28:
-#line 162 "../../lnav/src/data_scanner_re.re"
+#line 166 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_PATH); }
-#line 1329 "../../lnav/src/data_scanner_re.cc"
+#line 1333 "../../lnav/src/data_scanner_re.cc"
 yy29:
 	yyaccept = 4;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -1485,9 +1489,9 @@ yy29:
 	default:	goto yy30;
 	}
 yy30:
-#line 217 "../../lnav/src/data_scanner_re.re"
+#line 221 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_NUMBER); }
-#line 1491 "../../lnav/src/data_scanner_re.cc"
+#line 1495 "../../lnav/src/data_scanner_re.cc"
 yy31:
 	yyaccept = 4;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -1970,14 +1974,14 @@ yy34:
 	default:	goto yy35;
 	}
 yy35:
-#line 189 "../../lnav/src/data_scanner_re.re"
+#line 193 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_COLON); }
-#line 1976 "../../lnav/src/data_scanner_re.cc"
+#line 1980 "../../lnav/src/data_scanner_re.cc"
 yy36:
 	++YYCURSOR;
-#line 192 "../../lnav/src/data_scanner_re.re"
+#line 196 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_SEMI); }
-#line 1981 "../../lnav/src/data_scanner_re.cc"
+#line 1985 "../../lnav/src/data_scanner_re.cc"
 yy38:
 	yyaccept = 6;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -2051,19 +2055,19 @@ yy38:
 	default:	goto yy39;
 	}
 yy39:
-#line 200 "../../lnav/src/data_scanner_re.re"
+#line 204 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_LANGLE); }
-#line 2057 "../../lnav/src/data_scanner_re.cc"
+#line 2061 "../../lnav/src/data_scanner_re.cc"
 yy40:
 	++YYCURSOR;
-#line 190 "../../lnav/src/data_scanner_re.re"
+#line 194 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_EQUALS); }
-#line 2062 "../../lnav/src/data_scanner_re.cc"
+#line 2066 "../../lnav/src/data_scanner_re.cc"
 yy42:
 	++YYCURSOR;
-#line 201 "../../lnav/src/data_scanner_re.re"
+#line 205 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_RANGLE); }
-#line 2067 "../../lnav/src/data_scanner_re.cc"
+#line 2071 "../../lnav/src/data_scanner_re.cc"
 yy44:
 	yyaccept = 0;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -2527,14 +2531,14 @@ yy50:
 	default:	goto yy51;
 	}
 yy51:
-#line 196 "../../lnav/src/data_scanner_re.re"
+#line 200 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_LSQUARE); }
-#line 2533 "../../lnav/src/data_scanner_re.cc"
+#line 2537 "../../lnav/src/data_scanner_re.cc"
 yy52:
 	++YYCURSOR;
-#line 197 "../../lnav/src/data_scanner_re.re"
+#line 201 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_RSQUARE); }
-#line 2538 "../../lnav/src/data_scanner_re.cc"
+#line 2542 "../../lnav/src/data_scanner_re.cc"
 yy54:
 	yyaccept = 0;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -3081,14 +3085,14 @@ yy61:
 	default:	goto yy62;
 	}
 yy62:
-#line 194 "../../lnav/src/data_scanner_re.re"
+#line 198 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_LCURLY); }
-#line 3087 "../../lnav/src/data_scanner_re.cc"
+#line 3091 "../../lnav/src/data_scanner_re.cc"
 yy63:
 	++YYCURSOR;
-#line 195 "../../lnav/src/data_scanner_re.re"
+#line 199 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_RCURLY); }
-#line 3092 "../../lnav/src/data_scanner_re.cc"
+#line 3096 "../../lnav/src/data_scanner_re.cc"
 yy65:
 	yych = *++YYCURSOR;
 	switch (yych) {
@@ -3635,7 +3639,7 @@ yy78:
 	default:	goto yy79;
 	}
 yy79:
-#line 134 "../../lnav/src/data_scanner_re.re"
+#line 138 "../../lnav/src/data_scanner_re.re"
 	{
            CAPTURE(DT_QUOTED_STRING);
            switch (pi.get_string()[cap[1].c_begin]) {
@@ -3648,7 +3652,7 @@ yy79:
            cap[1].c_end -= 1;
            return true;
        }
-#line 3652 "../../lnav/src/data_scanner_re.cc"
+#line 3656 "../../lnav/src/data_scanner_re.cc"
 yy80:
 	yych = *++YYCURSOR;
 	switch (yych) {
@@ -5117,9 +5121,9 @@ yy101:
 	}
 yy102:
 	++YYCURSOR;
-#line 193 "../../lnav/src/data_scanner_re.re"
+#line 197 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_EMPTY_CONTAINER); }
-#line 5123 "../../lnav/src/data_scanner_re.cc"
+#line 5127 "../../lnav/src/data_scanner_re.cc"
 yy104:
 	yyaccept = 4;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -5745,9 +5749,9 @@ yy113:
 	default:	goto yy114;
 	}
 yy114:
-#line 216 "../../lnav/src/data_scanner_re.re"
+#line 220 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_PERCENTAGE); }
-#line 5751 "../../lnav/src/data_scanner_re.cc"
+#line 5755 "../../lnav/src/data_scanner_re.cc"
 yy115:
 	yyaccept = 0;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -5981,9 +5985,9 @@ yy116:
 	default:	goto yy117;
 	}
 yy117:
-#line 215 "../../lnav/src/data_scanner_re.re"
+#line 219 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_OCTAL_NUMBER); }
-#line 5987 "../../lnav/src/data_scanner_re.cc"
+#line 5991 "../../lnav/src/data_scanner_re.cc"
 yy118:
 	yyaccept = 4;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -6329,9 +6333,9 @@ yy120:
 	default:	goto yy121;
 	}
 yy121:
-#line 218 "../../lnav/src/data_scanner_re.re"
+#line 222 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_HEX_NUMBER); }
-#line 6335 "../../lnav/src/data_scanner_re.cc"
+#line 6339 "../../lnav/src/data_scanner_re.cc"
 yy122:
 	yyaccept = 10;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -7451,11 +7455,11 @@ yy132:
 	default:	goto yy133;
 	}
 yy133:
-#line 146 "../../lnav/src/data_scanner_re.re"
+#line 150 "../../lnav/src/data_scanner_re.re"
 	{
            CAPTURE(DT_WORD);
        }
-#line 7459 "../../lnav/src/data_scanner_re.cc"
+#line 7463 "../../lnav/src/data_scanner_re.cc"
 yy134:
 	yyaccept = 0;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -9258,7 +9262,7 @@ yy159:
 	yyt1 = yyt2;
 yy160:
 	YYCURSOR = yyt1;
-#line 149 "../../lnav/src/data_scanner_re.re"
+#line 153 "../../lnav/src/data_scanner_re.re"
 	{
            CAPTURE(DT_QUOTED_STRING);
            switch (pi.get_string()[cap[1].c_begin]) {
@@ -9271,7 +9275,7 @@ yy160:
            cap[1].c_end -= 1;
            return true;
        }
-#line 9275 "../../lnav/src/data_scanner_re.cc"
+#line 9279 "../../lnav/src/data_scanner_re.cc"
 yy161:
 	yyaccept = 12;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -12720,9 +12724,9 @@ yy199:
 	++YYCURSOR;
 yy200:
 	YYCURSOR = yyt2;
-#line 175 "../../lnav/src/data_scanner_re.re"
+#line 179 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_IPV6_ADDRESS); }
-#line 12726 "../../lnav/src/data_scanner_re.cc"
+#line 12730 "../../lnav/src/data_scanner_re.cc"
 yy201:
 	yych = *++YYCURSOR;
 	switch (yych) {
@@ -14070,11 +14074,11 @@ yy217:
 yy219:
 	++YYCURSOR;
 yy220:
-#line 181 "../../lnav/src/data_scanner_re.re"
+#line 185 "../../lnav/src/data_scanner_re.re"
 	{
            RET(DT_XML_OPEN_TAG);
        }
-#line 14078 "../../lnav/src/data_scanner_re.cc"
+#line 14082 "../../lnav/src/data_scanner_re.cc"
 yy221:
 	yych = *++YYCURSOR;
 	switch (yych) {
@@ -14149,9 +14153,9 @@ yy222:
 	yyt3 = yyt4;
 yy223:
 	YYCURSOR = yyt3;
-#line 224 "../../lnav/src/data_scanner_re.re"
+#line 228 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_WORD); }
-#line 14155 "../../lnav/src/data_scanner_re.cc"
+#line 14159 "../../lnav/src/data_scanner_re.cc"
 yy224:
 	yych = *++YYCURSOR;
 	switch (yych) {
@@ -21331,11 +21335,11 @@ yy305:
 	}
 yy307:
 	++YYCURSOR;
-#line 185 "../../lnav/src/data_scanner_re.re"
+#line 189 "../../lnav/src/data_scanner_re.re"
 	{
            RET(DT_XML_CLOSE_TAG);
        }
-#line 21339 "../../lnav/src/data_scanner_re.cc"
+#line 21343 "../../lnav/src/data_scanner_re.cc"
 yy309:
 	yych = *++YYCURSOR;
 	switch (yych) {
@@ -21412,11 +21416,11 @@ yy309:
 yy311:
 	++YYCURSOR;
 yy312:
-#line 177 "../../lnav/src/data_scanner_re.re"
+#line 181 "../../lnav/src/data_scanner_re.re"
 	{
            RET(DT_XML_EMPTY_TAG);
        }
-#line 21420 "../../lnav/src/data_scanner_re.cc"
+#line 21424 "../../lnav/src/data_scanner_re.cc"
 yy313:
 	yych = *++YYCURSOR;
 	switch (yych) {
@@ -22837,9 +22841,9 @@ yy331:
 	default:	goto yy333;
 	}
 yy333:
-#line 220 "../../lnav/src/data_scanner_re.re"
+#line 224 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_EMAIL); }
-#line 22843 "../../lnav/src/data_scanner_re.cc"
+#line 22847 "../../lnav/src/data_scanner_re.cc"
 yy334:
 	yyaccept = 0;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -23227,11 +23231,11 @@ yy337:
 	default:	goto yy339;
 	}
 yy339:
-#line 211 "../../lnav/src/data_scanner_re.re"
+#line 215 "../../lnav/src/data_scanner_re.re"
 	{
            RET(DT_VERSION_NUMBER);
        }
-#line 23235 "../../lnav/src/data_scanner_re.cc"
+#line 23239 "../../lnav/src/data_scanner_re.cc"
 yy340:
 	yyaccept = 18;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -25665,7 +25669,7 @@ yy361:
 	default:	goto yy362;
 	}
 yy362:
-#line 165 "../../lnav/src/data_scanner_re.re"
+#line 169 "../../lnav/src/data_scanner_re.re"
 	{
            if ((YYCURSOR - (const unsigned char *) pi.get_string()) == 17) {
                RET(DT_MAC_ADDRESS);
@@ -25673,7 +25677,7 @@ yy362:
                RET(DT_HEX_DUMP);
            }
        }
-#line 25677 "../../lnav/src/data_scanner_re.cc"
+#line 25681 "../../lnav/src/data_scanner_re.cc"
 yy363:
 	yyaccept = 19;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -29707,9 +29711,9 @@ yy413:
 	++YYCURSOR;
 yy414:
 	YYCURSOR = yyt1;
-#line 222 "../../lnav/src/data_scanner_re.re"
+#line 226 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_CONSTANT); }
-#line 29713 "../../lnav/src/data_scanner_re.cc"
+#line 29717 "../../lnav/src/data_scanner_re.cc"
 yy415:
 	yych = *++YYCURSOR;
 	switch (yych) {
@@ -30038,9 +30042,9 @@ yy421:
 	++YYCURSOR;
 yy422:
 	YYCURSOR = yyt1;
-#line 163 "../../lnav/src/data_scanner_re.re"
+#line 167 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_TIME); }
-#line 30044 "../../lnav/src/data_scanner_re.cc"
+#line 30048 "../../lnav/src/data_scanner_re.cc"
 yy423:
 	yych = *++YYCURSOR;
 	switch (yych) {
@@ -30994,9 +30998,9 @@ yy435:
 	default:	goto yy437;
 	}
 yy437:
-#line 209 "../../lnav/src/data_scanner_re.re"
+#line 213 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_NUMBER); }
-#line 31000 "../../lnav/src/data_scanner_re.cc"
+#line 31004 "../../lnav/src/data_scanner_re.cc"
 yy438:
 	yyaccept = 21;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -32406,9 +32410,9 @@ yy452:
 	default:	goto yy454;
 	}
 yy454:
-#line 161 "../../lnav/src/data_scanner_re.re"
+#line 165 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_URL); }
-#line 32412 "../../lnav/src/data_scanner_re.cc"
+#line 32416 "../../lnav/src/data_scanner_re.cc"
 yy455:
 	yych = *++YYCURSOR;
 	switch (yych) {
@@ -46891,9 +46895,9 @@ yy624:
 	yyt1 = yyt2;
 yy625:
 	YYCURSOR = yyt1;
-#line 164 "../../lnav/src/data_scanner_re.re"
+#line 168 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_TIME); }
-#line 46897 "../../lnav/src/data_scanner_re.cc"
+#line 46901 "../../lnav/src/data_scanner_re.cc"
 yy626:
 	yyaccept = 26;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -47233,11 +47237,11 @@ yy633:
 	++YYCURSOR;
 yy634:
 	YYCURSOR = yyt1;
-#line 203 "../../lnav/src/data_scanner_re.re"
+#line 207 "../../lnav/src/data_scanner_re.re"
 	{
            RET(DT_IPV4_ADDRESS);
        }
-#line 47241 "../../lnav/src/data_scanner_re.cc"
+#line 47245 "../../lnav/src/data_scanner_re.cc"
 yy635:
 	yyaccept = 27;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -49018,11 +49022,11 @@ yy651:
 	default:	goto yy652;
 	}
 yy652:
-#line 172 "../../lnav/src/data_scanner_re.re"
+#line 176 "../../lnav/src/data_scanner_re.re"
 	{
            RET(DT_DATE);
        }
-#line 49026 "../../lnav/src/data_scanner_re.cc"
+#line 49030 "../../lnav/src/data_scanner_re.cc"
 yy653:
 	yyaccept = 28;
 	yych = *(YYMARKER = ++YYCURSOR);
@@ -82885,10 +82889,10 @@ yy989:
 	default:	goto yy990;
 	}
 yy990:
-#line 207 "../../lnav/src/data_scanner_re.re"
+#line 211 "../../lnav/src/data_scanner_re.re"
 	{ RET(DT_UUID); }
-#line 82891 "../../lnav/src/data_scanner_re.cc"
+#line 82895 "../../lnav/src/data_scanner_re.cc"
 }
-#line 235 "../../lnav/src/data_scanner_re.re"
+#line 239 "../../lnav/src/data_scanner_re.re"
 
 }
@@ -0,0 +1,308 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file db_row_store.cc
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "base/lnav_log.hh"
+#include "lnav_util.hh"
+#include "db_row_store.hh"
+
+/*
+ * A page is written out as a sequence of rows.  Each row is the number of
+ * cells followed by the cells, which are a length, or UINT32_MAX for NULL,
+ * and the value with a NUL terminator so it can be used in place once it is
+ * read back.
+ */
+static const uint32_t NULL_CELL = UINT32_MAX;
+
+static void append_u32(std::vector<char> &buf, uint32_t value)
+{
+    const char *bytes = (const char *) &value;
+
+    buf.insert(buf.end(), bytes, bytes + sizeof(value));
+}
+
+void db_row_store::start_row()
+{
+    if (this->drs_size == 1) {
+        this->drs_width = this->drs_tail_rows.front().size();
+    }
+    if (!this->drs_spill_failed &&
+        (this->drs_tail_rows.size() >= PAGE_ROWS ||
+         this->drs_tail_bytes >= PAGE_BYTES)) {
+        if (!this->flush_tail()) {
+            this->drs_spill_failed = true;
+        }
+    }
+
+    this->drs_tail_rows.emplace_back();
+    this->drs_tail_rows.back().reserve(this->drs_width);
+    this->drs_size += 1;
+}
+
+const char *db_row_store::push_cell(const char *str, size_t len)
+{
+    const char *retval;
+
+    if (str == nullptr) {
+        retval = this->drs_null_str;
+        len = 0;
+    }
+    else {
+        retval = this->store_cell(str, len);
+    }
+    this->drs_tail_rows.back().push_back(retval);
+    this->drs_tail_bytes += sizeof(uint32_t) + len + 1;
+
+    return retval;
+}
+
+const char *db_row_store::store_cell(const char *str, size_t len)
+{
+    char *retval;
+
+    if (len + 1 > CELL_CHUNK_SIZE / 4) {
+        // Large values get a chunk of their own, placed before the current
+        // chunk so that the rest of it can still be used.
+        std::unique_ptr<char[]> big(new char[len + 1]);
+
+        retval = big.get();
+        if (this->drs_tail_chunks.empty()) {
+            this->drs_tail_chunks.push_back(std::move(big));
+        } else {
+            this->drs_tail_chunks.insert(this->drs_tail_chunks.end() - 1,
+                                         std::move(big));
+        }
+    } else {
+        if (this->drs_tail_chunk_used + len + 1 > CELL_CHUNK_SIZE) {
+            this->drs_tail_chunks.emplace_back(new char[CELL_CHUNK_SIZE]);
+            this->drs_tail_chunk_used = 0;
+        }
+        retval = &this->drs_tail_chunks.back()[this->drs_tail_chunk_used];
+        this->drs_tail_chunk_used += len + 1;
+    }
+
+    memcpy(retval, str, len);
+    retval[len] = '\0';
+
+    return retval;
+}
+
+bool db_row_store::flush_tail()
+{
+    if (this->drs_fd == -1) {
+        auto open_res = open_temp_file(system_tmpdir() / "lnav.db.XXXXXX");
+
+        if (open_res.isErr()) {
+            log_error("unable to create a file for query results -- %s",
+                      open_res.unwrapErr().c_str());
+            return false;
+        }
+
+        auto tmp_pair = open_res.unwrap();
+
+        this->drs_fd = tmp_pair.second;
+        tmp_pair.first.remove_file();
+    }
+
+    std::vector<char> buf;
+
+    buf.reserve(this->drs_tail_bytes +
+                this->drs_tail_rows.size() * sizeof(uint32_t));
+    for (const auto &row : this->drs_tail_rows) {
+        append_u32(buf, row.size());
+        for (const auto cell : row) {
+            if (cell == this->drs_null_str) {
+                append_u32(buf, NULL_CELL);
+                continue;
+            }
+
+            size_t len = strlen(cell);
+
+            append_u32(buf, len);
+            buf.insert(buf.end(), cell, cell + len + 1);
+        }
+    }
+
+    size_t written = 0;
+
+    while (written < buf.size()) {
+        ssize_t rc = pwrite(this->drs_fd,
+                            buf.data() + written,
+                            buf.size() - written,
+                            this->drs_file_size + written);
+
+        if (rc == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_error("unable to write query results -- %s",
+                      strerror(errno));
+            return false;
+        }
+        written += rc;
+    }
+
+    this->drs_pages.push_back({
+        this->drs_tail_first_row, this->drs_file_size, buf.size()
+    });
+    this->drs_file_size += buf.size();
+
+    this->drs_tail_first_row += this->drs_tail_rows.size();
+    this->drs_tail_rows.clear();
+    this->drs_tail_chunks.clear();
+    this->drs_tail_chunk_used = CELL_CHUNK_SIZE;
+    this->drs_tail_bytes = 0;
+
+    return true;
+}
+
+const db_row_store::resident_page *db_row_store::load_page(size_t index) const
+{
+    for (auto iter = this->drs_resident.begin();
+         iter != this->drs_resident.end();
+         ++iter) {
+        if (iter->rp_index == index) {
+            this->drs_resident.splice(this->drs_resident.begin(),
+                                      this->drs_resident,
+                                      iter);
+            return &this->drs_resident.front();
+        }
+    }
+
+    const page &pg = this->drs_pages[index];
+    std::unique_ptr<char[]> data(new char[pg.p_length]);
+    size_t got = 0;
+
+    while (got < pg.p_length) {
+        ssize_t rc = pread(this->drs_fd,
+                           data.get() + got,
+                           pg.p_length - got,
+                           pg.p_offset + got);
+
+        if (rc == -1 && errno == EINTR) {
+            continue;
+        }
+        if (rc <= 0) {
+            log_error("unable to read query results -- %s",
+                      rc == 0 ? "unexpected end of file" : strerror(errno));
+            return nullptr;
+        }
+        got += rc;
+    }
+
+    if (this->drs_resident.size() >= RESIDENT_PAGES) {
+        this->drs_resident.pop_back();
+    }
+    this->drs_resident.emplace_front();
+
+    resident_page &rp = this->drs_resident.front();
+    size_t row_count = (index + 1 < this->drs_pages.size() ?
+                        this->drs_pages[index + 1].p_first_row :
+                        this->drs_tail_first_row) - pg.p_first_row;
+    size_t off = 0;
+
+    rp.rp_index = index;
+    rp.rp_data = std::move(data);
+    rp.rp_rows.resize(row_count);
+    for (auto &row : rp.rp_rows) {
+        uint32_t cells;
+
+        memcpy(&cells, &rp.rp_data[off], sizeof(cells));
+        off += sizeof(cells);
+        row.reserve(cells);
+        for (uint32_t lpc = 0; lpc < cells; lpc++) {
+            uint32_t len;
+
+            memcpy(&len, &rp.rp_data[off], sizeof(len));
+            off += sizeof(len);
+            if (len == NULL_CELL) {
+                row.push_back(this->drs_null_str);
+            }
+            else {
+                row.push_back(&rp.rp_data[off]);
+                off += len + 1;
+            }
+        }
+    }
+
+    return &rp;
+}
+
+const db_row_store::row_t &db_row_store::operator[](size_t row) const
+{
+    require(row < this->drs_size);
+
+    if (row >= this->drs_tail_first_row) {
+        return this->drs_tail_rows[row - this->drs_tail_first_row];
+    }
+
+    auto iter = std::upper_bound(this->drs_pages.begin(),
+                                 this->drs_pages.end(),
+                                 row,
+                                 [](size_t lhs, const page &rhs) {
+                                     return lhs < rhs.p_first_row;
+                                 });
+    size_t index = std::distance(this->drs_pages.begin(), iter) - 1;
+    const resident_page *rp = this->load_page(index);
+
+    if (rp == nullptr) {
+        // Keep the callers from indexing past the end of the row.
+        this->drs_missing_row.assign(this->drs_width, this->drs_null_str);
+        return this->drs_missing_row;
+    }
+
+    return rp->rp_rows[row - this->drs_pages[index].p_first_row];
+}
+
+void db_row_store::clear()
+{
+    this->drs_size = 0;
+    this->drs_width = 0;
+    this->drs_pages.clear();
+    this->drs_fd.reset();
+    this->drs_file_size = 0;
+    this->drs_spill_failed = false;
+    this->drs_tail_first_row = 0;
+    this->drs_tail_bytes = 0;
+    this->drs_tail_rows.clear();
+    this->drs_tail_chunks.clear();
+    this->drs_tail_chunk_used = CELL_CHUNK_SIZE;
+    this->drs_resident.clear();
+}
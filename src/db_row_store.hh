@@ -0,0 +1,148 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file db_row_store.hh
+ */
+
+#ifndef lnav_db_row_store_hh
+#define lnav_db_row_store_hh
+
+#include <sys/types.h>
+
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "auto_fd.hh"
+
+/**
+ * The cells of a query result, stored so that only a few pages of rows are
+ * resident no matter how many rows the query returns.  Rows are appended to
+ * a tail page in memory.  Once the tail is full, it is written out to an
+ * unlinked temporary file and only read back, a page at a time, when one of
+ * its rows is looked at again.  The most recently used pages are kept in
+ * memory, so a row that was just returned stays valid until a few other
+ * pages have been read in.
+ */
+class db_row_store {
+public:
+    typedef std::vector<const char *> row_t;
+
+    /** The most rows that are kept in a single page. */
+    static const size_t PAGE_ROWS = 1024;
+    /** The size of the cells after which a page is considered full. */
+    static const size_t PAGE_BYTES = 1024 * 1024;
+    /** The number of pages read back from the file that are kept. */
+    static const size_t RESIDENT_PAGES = 4;
+
+    /**
+     * @param null_str The string returned for NULL cells.  Callers can
+     *   compare a cell against this pointer to check for NULL.
+     */
+    explicit db_row_store(const char *null_str) : drs_null_str(null_str) {
+    };
+
+    size_t size() const {
+        return this->drs_size;
+    };
+
+    bool empty() const {
+        return this->drs_size == 0;
+    };
+
+    /**
+     * Start a new row at the end of the store.  The previous rows are
+     * written out if they fill the tail page.
+     */
+    void start_row();
+
+    /**
+     * Append a cell to the row that was last started.
+     *
+     * @param str The value of the cell or nullptr if it is NULL.
+     * @param len The length of the value.
+     * @return The stored copy of the value.
+     */
+    const char *push_cell(const char *str, size_t len);
+
+    /** @return The row that was last started. */
+    const row_t &back() const {
+        return this->drs_tail_rows.back();
+    };
+
+    const row_t &operator[](size_t row) const;
+
+    void clear();
+
+private:
+    struct page {
+        size_t p_first_row;
+        off_t p_offset;
+        size_t p_length;
+    };
+
+    struct resident_page {
+        size_t rp_index;
+        std::unique_ptr<char[]> rp_data;
+        std::vector<row_t> rp_rows;
+    };
+
+    /** Copy a cell value into the chunks that belong to the tail page. */
+    const char *store_cell(const char *str, size_t len);
+
+    /** Write the tail page out to the temporary file. */
+    bool flush_tail();
+
+    /** @return The page, read back from the file if needed, or nullptr. */
+    const resident_page *load_page(size_t index) const;
+
+    static const size_t CELL_CHUNK_SIZE = 64 * 1024;
+
+    const char *drs_null_str;
+    size_t drs_size{0};
+    size_t drs_width{0};
+
+    std::vector<page> drs_pages;
+    auto_fd drs_fd;
+    off_t drs_file_size{0};
+    /** Set when the temporary file could not be used. */
+    bool drs_spill_failed{false};
+
+    size_t drs_tail_first_row{0};
+    size_t drs_tail_bytes{0};
+    std::vector<row_t> drs_tail_rows;
+    std::vector<std::unique_ptr<char[]>> drs_tail_chunks;
+    size_t drs_tail_chunk_used{CELL_CHUNK_SIZE};
+
+    /** The pages read back from the file, the most recently used first. */
+    mutable std::list<resident_page> drs_resident;
+    mutable row_t drs_missing_row;
+};
+
+#endif
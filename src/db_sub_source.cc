@@ -47,15 +47,18 @@ void db_label_source::text_value_for_line(textview_curses &tc, int row,
     if (row >= (int)this->dls_rows.size()) {
         return;
     }
-    for (int lpc = 0; lpc < (int)this->dls_rows[row].size(); lpc++) {
+
+    const auto &cells = this->dls_rows[row];
+
+    for (int lpc = 0; lpc < (int)cells.size(); lpc++) {
         int padding = (this->dls_headers[lpc].hm_column_size -
-                       strlen(this->dls_rows[row][lpc]) -
+                       strlen(cells[lpc]) -
                        1);
 
         if (this->dls_headers[lpc].hm_column_type != SQLITE3_TEXT) {
             label_out.append(padding, ' ');
         }
-        label_out.append(this->dls_rows[row][lpc]);
+        label_out.append(cells[lpc]);
         if (this->dls_headers[lpc].hm_column_type == SQLITE3_TEXT) {
             label_out.append(padding, ' ');
         }
@@ -82,25 +85,24 @@ void db_label_source::text_attrs_for_line(textview_curses &tc, int row,
         lr.lr_start += 1;
     }
 
+    const auto &cells = this->dls_rows[row];
     int left = 0;
+
     for (size_t lpc = 0; lpc < this->dls_headers.size(); lpc++) {
-        const char *row_value = this->dls_rows[row][lpc];
+        const char *row_value = cells[lpc];
         size_t row_len = strlen(row_value);
 
-        if (this->dls_headers[lpc].hm_graphable) {
-            double num_value;
-
-            if (sscanf(row_value, "%lf", &num_value) == 1) {
-                this->dls_chart.chart_attrs_for_value(tc, left, this->dls_headers[lpc].hm_name, num_value, sa);
-            }
+        if (this->dls_headers[lpc].hm_graphable && row_value != NULL_STR) {
+            this->dls_chart.chart_attrs_for_value(
+                tc, left, this->dls_headers[lpc].hm_name,
+                this->number_for_cell(row, lpc), sa);
         }
         if (row_len > 2 &&
             ((row_value[0] == '{' && row_value[row_len - 1] == '}') ||
              (row_value[0] == '[' && row_value[row_len - 1] == ']'))) {
             json_ptr_walk jpw;
 
-            if (jpw.parse(row_value, row_len) == yajl_status_ok &&
-                jpw.complete_parse() == yajl_status_ok) {
+            if (jpw.parse_complete(row_value, row_len) == yajl_status_ok) {
                 for (auto &jpw_value : jpw.jpw_values) {
                     double num_value;
 
@@ -130,28 +132,16 @@ void db_label_source::push_header(const std::string &colstr, int type,
     }
 }
 
-void db_label_source::push_column(const char *colstr)
+void db_label_source::push_column(sqlite3_value *sv)
 {
     view_colors &vc = view_colors::singleton();
     int index = this->dls_rows.back().size();
+    const char *colstr = (const char *) sqlite3_value_text(sv);
     double num_value = 0.0;
     size_t value_len;
 
-    if (colstr == nullptr) {
-        value_len = 0;
-    }
-    else {
-        value_len = strlen(colstr);
-    }
-    if (colstr == nullptr) {
-        colstr = NULL_STR;
-    }
-    else {
-        colstr = strdup(colstr);
-        if (colstr == nullptr) {
-            throw "out of memory";
-        }
-    }
+    value_len = colstr == nullptr ? 0 : sqlite3_value_bytes(sv);
+    colstr = this->dls_rows.push_cell(colstr, value_len);
 
     if (index == this->dls_time_column_index) {
         date_time_scanner dts;
@@ -170,23 +160,37 @@ void db_label_source::push_column(const char *colstr)
         }
     }
 
-    this->dls_rows.back().push_back(colstr);
-    this->dls_headers[index].hm_column_size =
-        std::max(this->dls_headers[index].hm_column_size, strlen(colstr) + 1);
-
-    if (colstr != nullptr && this->dls_headers[index].hm_graphable) {
-        if (sscanf(colstr, "%lf", &num_value) != 1) {
-            num_value = 0.0;
+    auto &hm = this->dls_headers[index];
+
+    hm.hm_column_size = std::max(hm.hm_column_size,
+                                 (colstr == NULL_STR ?
+                                  strlen(NULL_STR) : value_len) + 1);
+
+    if (hm.hm_graphable) {
+        switch (sqlite3_value_type(sv)) {
+            case SQLITE_INTEGER:
+                num_value = sqlite3_value_int64(sv);
+                break;
+            case SQLITE_FLOAT:
+                num_value = sqlite3_value_double(sv);
+                break;
+            case SQLITE_NULL:
+                break;
+            default:
+                if (sscanf(colstr, "%lf", &num_value) != 1) {
+                    num_value = 0.0;
+                }
+                break;
         }
-        this->dls_chart.add_value(this->dls_headers[index].hm_name, num_value);
+        hm.hm_values.push_back(num_value);
+        this->dls_chart.add_value(hm.hm_name, num_value);
     }
     else if (value_len > 2 &&
              ((colstr[0] == '{' && colstr[value_len - 1] == '}') ||
               (colstr[0] == '[' && colstr[value_len - 1] == ']'))) {
         json_ptr_walk jpw;
 
-        if (jpw.parse(colstr, value_len) == yajl_status_ok &&
-            jpw.complete_parse() == yajl_status_ok) {
+        if (jpw.parse_complete(colstr, value_len) == yajl_status_ok) {
             for (auto &jpw_value : jpw.jpw_values) {
                 if (jpw_value.wt_type == yajl_t_number &&
                     sscanf(jpw_value.wt_value.c_str(), "%lf", &num_value) == 1) {
@@ -203,13 +207,6 @@ void db_label_source::clear()
 {
     this->dls_chart.clear();
     this->dls_headers.clear();
-    for (size_t row = 0; row < this->dls_rows.size(); row++) {
-        for (size_t col = 0; col < this->dls_rows[row].size(); col++) {
-            if (this->dls_rows[row][col] != NULL_STR) {
-                free((void *)this->dls_rows[row][col]);
-            }
-        }
-    }
     this->dls_rows.clear();
     this->dls_time_column.clear();
 }
@@ -226,7 +223,7 @@ size_t db_overlay_source::list_overlay_count(const listview_curses &lv)
 
     view_colors &vc = view_colors::singleton();
     vis_line_t top = lv.get_top();
-    const std::vector<const char *> &cols = this->dos_labels->dls_rows[top];
+    const db_row_store::row_t &cols = this->dos_labels->dls_rows[top];
     unsigned long width;
     vis_line_t height;
 
@@ -245,8 +242,7 @@ size_t db_overlay_source::list_overlay_count(const listview_curses &lv)
 
         json_ptr_walk jpw;
 
-        if (jpw.parse(col_value, col_len) == yajl_status_ok &&
-            jpw.complete_parse() == yajl_status_ok) {
+        if (jpw.parse_complete(col_value, col_len) == yajl_status_ok) {
 
             {
                 const std::string &header = this->dos_labels->dls_headers[col].hm_name;
@@ -32,6 +32,7 @@
 #ifndef __db_sub_source_hh
 #define __db_sub_source_hh
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <iterator>
@@ -41,10 +42,11 @@
 
 #include "textview_curses.hh"
 #include "hist_source.hh"
+#include "db_row_store.hh"
 
 class db_label_source : public text_sub_source, public text_time_translator {
 public:
-    db_label_source() : dls_time_column_index(-1) {
+    db_label_source() : dls_rows(NULL_STR), dls_time_column_index(-1) {
 
     };
 
@@ -82,7 +84,14 @@ public:
 
     /* TODO: add support for left and right justification... numbers should */
     /* be right justified and strings should be left. */
-    void push_column(const char *colstr);
+    void push_column(sqlite3_value *sv);
+
+    /**
+     * @return The numeric value of a cell in a graphable column.
+     */
+    double number_for_cell(int row, int col) const {
+        return this->dls_headers[col].hm_values[row];
+    };
 
     void clear();
 
@@ -139,11 +148,17 @@ public:
         bool hm_graphable;
         bool hm_log_time;
         size_t hm_column_size;
+        /** The values of the rows, if the column is graphable. */
+        std::vector<double> hm_values;
     };
 
     stacked_bar_chart<std::string> dls_chart;
     std::vector<header_meta> dls_headers;
-    std::vector<std::vector<const char *> > dls_rows;
+    /**
+     * The cells of each row.  Only a few pages of rows are kept in memory,
+     * so a row should be used before looking up rows that are far away.
+     */
+    db_row_store dls_rows;
     std::vector<struct timeval> dls_time_column;
     int dls_time_column_index;
 
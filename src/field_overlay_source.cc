@@ -201,6 +201,8 @@ void field_overlay_source::build_field_lines(const listview_curses &lv)
 
     if (lss.text_line_count() == 0) {
         this->fos_log_helper.clear();
+        this->fos_parsed_line = content_line_t(-1);
+        this->fos_field_lines = nonstd::nullopt;
 
         return;
     }
@@ -224,8 +226,19 @@ void field_overlay_source::build_field_lines(const listview_curses &lv)
         return;
     }
 
-    if (!this->fos_log_helper.parse_line(lv.get_top())) {
-        return;
+    auto msg_size = file->get_file_range(ll).fr_size;
+
+    if (cl != this->fos_parsed_line ||
+        lss.get_index_generation() != this->fos_parsed_generation ||
+        msg_size != this->fos_parsed_size) {
+        this->fos_parsed_line = content_line_t(-1);
+        this->fos_field_lines = nonstd::nullopt;
+        if (!this->fos_log_helper.parse_line(lv.get_top())) {
+            return;
+        }
+        this->fos_parsed_line = cl;
+        this->fos_parsed_generation = lss.get_index_generation();
+        this->fos_parsed_size = msg_size;
     }
 
     char old_timestamp[64], curr_timestamp[64], orig_timestamp[64];
@@ -329,6 +342,15 @@ void field_overlay_source::build_field_lines(const listview_curses &lv)
         return;
     }
 
+    if (this->fos_field_lines) {
+        this->fos_lines.insert(this->fos_lines.end(),
+                               this->fos_field_lines->begin(),
+                               this->fos_field_lines->end());
+        return;
+    }
+
+    size_t field_lines_start = this->fos_lines.size();
+
     this->fos_known_key_size = 0;
     this->fos_unknown_key_size = 0;
 
@@ -478,6 +500,9 @@ void field_overlay_source::build_field_lines(const listview_curses &lv)
         this->add_key_line_attrs(this->fos_unknown_key_size,
                                  lpc == (this->fos_log_helper.ldh_parser->dp_pairs.size() - 1));
     }
+
+    this->fos_field_lines = std::vector<attr_line_t>(
+        this->fos_lines.begin() + field_lines_start, this->fos_lines.end());
 }
 
 void field_overlay_source::build_meta_line(const listview_curses &lv,
@@ -102,6 +102,16 @@ public:
     std::vector<attr_line_t> fos_lines;
     std::vector<attr_line_t> fos_summary_lines;
     std::vector<attr_line_t> fos_meta_lines;
+
+    /**
+     * The line that fos_log_helper last parsed, the helper is only asked to
+     * parse the line again when the line or its message changes.
+     */
+    content_line_t fos_parsed_line{content_line_t(-1)};
+    size_t fos_parsed_generation{0};
+    ssize_t fos_parsed_size{-1};
+    /** The field lines built from the parsed line, if they were built. */
+    nonstd::optional<std::vector<attr_line_t>> fos_field_lines;
 };
 
 #endif //LNAV_FIELD_OVERLAY_SOURCE_H
@@ -53,7 +53,14 @@ CREATE TABLE lnav_file (
     filepath text,        -- The path to the file.
     format text,          -- The log file format for the file.
     lines integer,        -- The number of lines in the file.
-    time_offset integer   -- The millisecond offset for timestamps.
+    time_offset integer,  -- The millisecond offset for timestamps.
+    errors integer,       -- The number of error messages in the file.
+    warnings integer,     -- The number of warning messages in the file.
+    index_memory integer, -- The number of bytes used by the line index.
+    bytes_indexed integer, -- The number of uncompressed bytes that were indexed.
+    index_rate integer,   -- The number of bytes indexed per second.
+    compression_ratio real, -- The uncompressed size divided by the compressed size.
+    syncpoint_memory integer -- The number of bytes used to index a gzipped file.
 );
 )";
 
@@ -104,6 +111,46 @@ CREATE TABLE lnav_file (
                 to_sqlite(ctx, ms);
                 break;
             }
+            case 6:
+                to_sqlite(ctx, (int64_t) (lf->get_level_count(LEVEL_ERROR) +
+                                          lf->get_level_count(LEVEL_CRITICAL) +
+                                          lf->get_level_count(LEVEL_FATAL)));
+                break;
+            case 7:
+                to_sqlite(ctx, (int64_t) lf->get_level_count(LEVEL_WARNING));
+                break;
+            case 8:
+                to_sqlite(ctx, (int64_t) lf->get_index_memory());
+                break;
+            case 9:
+                to_sqlite(ctx, (int64_t) lf->get_index_size());
+                break;
+            case 10: {
+                const auto &la = lf->get_activity();
+                uint64_t ns = la.la_read_perf.get_total_ns() +
+                              la.la_scan_perf.get_total_ns() +
+                              la.la_filter_perf.get_total_ns();
+
+                if (ns == 0) {
+                    sqlite3_result_null(ctx);
+                } else {
+                    to_sqlite(ctx, (int64_t) (lf->get_index_size() * 1e9 / ns));
+                }
+                break;
+            }
+            case 11: {
+                off_t read_size = lf->get_index_read_size();
+
+                if (read_size == 0) {
+                    sqlite3_result_null(ctx);
+                } else {
+                    to_sqlite(ctx, (double) lf->get_index_size() / read_size);
+                }
+                break;
+            }
+            case 12:
+                to_sqlite(ctx, (int64_t) lf->get_syncpoint_memory());
+                break;
             default:
                 ensure(0);
                 break;
@@ -131,11 +178,18 @@ CREATE TABLE lnav_file (
                    const char *path,
                    const char *format,
                    int64_t lines,
-                   int64_t time_offset) {
+                   int64_t time_offset,
+                   int64_t errors,
+                   int64_t warnings,
+                   int64_t index_memory,
+                   int64_t bytes_indexed,
+                   nonstd::optional<int64_t> index_rate,
+                   double compression_ratio,
+                   int64_t syncpoint_memory) {
         auto lf = lnav_data.ld_files[rowid];
         struct timeval tv = {
             (int) (time_offset / 1000LL),
-            (int) (time_offset / (1000LL * 1000LL)),
+            (int) ((time_offset % 1000LL) * 1000LL),
         };
 
         lf->adjust_content_time(0, tv, true);
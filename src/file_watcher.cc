@@ -0,0 +1,142 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+#include <algorithm>
+
+#include "base/lnav_log.hh"
+#include "file_watcher.hh"
+
+using namespace std;
+
+file_watcher::file_watcher()
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    this->fw_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (this->fw_fd == -1) {
+        log_error("unable to initialize inotify -- %s", strerror(errno));
+    }
+#endif
+}
+
+int file_watcher::watch(const std::string &path)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    if (this->fw_fd == -1) {
+        return -1;
+    }
+
+    int retval = inotify_add_watch(this->fw_fd, path.c_str(),
+                                   IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE |
+                                   IN_MOVE_SELF | IN_DELETE_SELF);
+
+    if (retval == -1) {
+        log_info("unable to watch file, it will be polled -- %s: %s",
+                 path.c_str(), strerror(errno));
+    }
+
+    return retval;
+#else
+    return -1;
+#endif
+}
+
+int file_watcher::watch_dir(const std::string &path)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    if (this->fw_fd == -1) {
+        return -1;
+    }
+
+    int retval = inotify_add_watch(this->fw_fd, path.c_str(),
+                                   IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                   IN_MOVED_TO | IN_ATTRIB | IN_MOVE_SELF |
+                                   IN_DELETE_SELF | IN_ONLYDIR);
+
+    if (retval == -1) {
+        log_info("unable to watch directory, it will be polled -- %s: %s",
+                 path.c_str(), strerror(errno));
+    }
+
+    return retval;
+#else
+    return -1;
+#endif
+}
+
+void file_watcher::unwatch(int wd)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    if (this->fw_fd != -1 && wd != -1) {
+        inotify_rm_watch(this->fw_fd, wd);
+    }
+#endif
+}
+
+vector<int> file_watcher::read_events()
+{
+    vector<int> retval;
+
+#ifdef HAVE_SYS_INOTIFY_H
+    if (this->fw_fd == -1) {
+        return retval;
+    }
+
+    char buffer[4096]
+        __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t rc;
+
+    while ((rc = read(this->fw_fd, buffer, sizeof(buffer))) > 0) {
+        for (char *ptr = buffer; ptr < buffer + rc; ) {
+            auto *event = (const struct inotify_event *) ptr;
+
+            if (find(retval.begin(), retval.end(), event->wd) == retval.end()) {
+                retval.push_back(event->wd);
+            }
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    if (rc == -1 && errno != EAGAIN && errno != EINTR) {
+        log_error("unable to read inotify events -- %s", strerror(errno));
+    }
+#endif
+
+    return retval;
+}
@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file file_watcher.hh
+ */
+
+#ifndef lnav_file_watcher_hh
+#define lnav_file_watcher_hh
+
+#include <string>
+#include <vector>
+
+#include "auto_fd.hh"
+
+/**
+ * Delivers notifications from the kernel about changes to the files being
+ * followed so that they do not need to be polled.  On systems without
+ * inotify, nothing can be watched and the files are polled as before.
+ */
+class file_watcher {
+public:
+    file_watcher();
+
+    /**
+     * @return The descriptor to add to the poll() set, which becomes
+     *   readable when there are events, or -1 if watching is not supported.
+     */
+    int get_fd() const {
+        return this->fw_fd.get();
+    };
+
+    /**
+     * Start watching a file for changes.
+     *
+     * @param path The path to the file.
+     * @return The watch descriptor to match against the results of
+     *   read_events() or -1 if the file cannot be watched.
+     */
+    int watch(const std::string &path);
+
+    /**
+     * Start watching a directory for files being created, removed or
+     * renamed in it.
+     *
+     * @param path The path to the directory.
+     * @return The watch descriptor to match against the results of
+     *   read_events() or -1 if the directory cannot be watched.
+     */
+    int watch_dir(const std::string &path);
+
+    /**
+     * Stop watching a file.
+     *
+     * @param wd The watch descriptor returned by watch().
+     */
+    void unwatch(int wd);
+
+    /**
+     * Read the events that are waiting.
+     *
+     * @return The watch descriptors of the files that changed.
+     */
+    std::vector<int> read_events();
+
+private:
+    auto_fd fw_fd;
+};
+
+#endif
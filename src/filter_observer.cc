@@ -29,8 +29,34 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <chrono>
+
+#include "auto_fd.hh"
+#include "lnav_util.hh"
 #include "filter_observer.hh"
 
+static const char MATCH_CACHE_MAGIC[8] = "lnavflt";
+static const uint32_t MATCH_CACHE_VERSION = 1;
+
+/**
+ * The header for the saved matches of a filter.  It is followed by one bit
+ * for each line of the file, set if the message the line is part of
+ * matched.
+ */
+struct match_cache_header {
+    char mch_magic[8];
+    uint32_t mch_version;
+    uint32_t mch_reserved;
+    uint64_t mch_line_count;
+    uint64_t mch_hits;
+};
+
 void line_filter_observer::logline_new_line(const logfile &lf,
                                             logfile::const_iterator ll,
                                             shared_buffer_ref &sbr)
@@ -47,16 +73,69 @@ void line_filter_observer::logline_new_line(const logfile &lf,
     if (lf.get_format() != nullptr) {
         lf.get_format()->get_subline(*ll, sbr);
     }
+
+    filter_mask_t candidates;
+    bool prefiltered = this->lfo_filter_stack.get_candidates(
+        sbr.get_data(), sbr.length(), candidates);
+
     for (auto &filter : this->lfo_filter_stack) {
         if (filter->lf_deleted) {
             continue;
         }
         if (offset >= this->lfo_filter_state.tfs_filter_count[filter->get_index()]) {
-            filter->add_line(this->lfo_filter_state, ll, sbr);
+            bool maybe_matches = !prefiltered ||
+                !this->lfo_filter_stack.is_prefiltered(filter.get()) ||
+                candidates.test(filter->get_index());
+
+            filter->add_line(this->lfo_filter_state, ll, sbr, maybe_matches);
         }
     }
 }
 
+bool line_filter_observer::logline_skip_line(const logfile &lf,
+                                             logfile::const_iterator ll)
+{
+    size_t offset = std::distance(lf.begin(), ll);
+    bool pending = false;
+
+    // The line can only be skipped if the search index says that none of
+    // the filters that still need to see it can match.
+    for (auto &filter : this->lfo_filter_stack) {
+        if (filter->lf_deleted) {
+            continue;
+        }
+        if (offset < this->lfo_filter_state.tfs_filter_count[filter->get_index()]) {
+            continue;
+        }
+
+        auto &literal = this->lfo_filter_stack.required_literal_for(
+            filter->get_index());
+
+        if (literal.empty() || lf.line_may_contain(offset, literal)) {
+            return false;
+        }
+        pending = true;
+    }
+
+    if (!pending) {
+        return false;
+    }
+
+    shared_buffer_ref empty;
+
+    this->lfo_filter_state.resize(lf.size());
+    for (auto &filter : this->lfo_filter_stack) {
+        if (filter->lf_deleted) {
+            continue;
+        }
+        if (offset >= this->lfo_filter_state.tfs_filter_count[filter->get_index()]) {
+            filter->add_line(this->lfo_filter_state, ll, empty, false);
+        }
+    }
+
+    return true;
+}
+
 void line_filter_observer::logline_eof(const logfile &lf)
 {
     for (auto &iter : this->lfo_filter_stack) {
@@ -66,3 +145,301 @@ void line_filter_observer::logline_eof(const logfile &lf)
         iter->end_of_message(this->lfo_filter_state);
     }
 }
+
+void line_filter_observer::load_cached_matches(const logfile &lf)
+{
+    auto &fs = this->lfo_filter_state;
+    size_t line_count = lf.size();
+
+    for (auto &filter : this->lfo_filter_stack) {
+        size_t index = filter->get_index();
+
+        if (filter->lf_deleted ||
+            fs.tfs_filter_count[index] != 0 ||
+            fs.tfs_lines_for_message[index] != 0) {
+            continue;
+        }
+
+        auto key = filter->get_match_cache_key();
+
+        if (key.empty()) {
+            continue;
+        }
+
+        auto cache_path = lf.get_match_cache_path(key);
+
+        if (!cache_path) {
+            return;
+        }
+
+        auto_fd fd;
+
+        if ((fd = openp(cache_path.value(), O_RDONLY)) == -1) {
+            continue;
+        }
+
+        struct match_cache_header mch;
+        std::vector<uint32_t> bits((line_count + 31) / 32);
+        ssize_t bits_size = sizeof(uint32_t) * bits.size();
+
+        if (read(fd, &mch, sizeof(mch)) != sizeof(mch) ||
+            memcmp(mch.mch_magic, MATCH_CACHE_MAGIC,
+                   sizeof(mch.mch_magic)) != 0 ||
+            mch.mch_version != MATCH_CACHE_VERSION ||
+            mch.mch_line_count != line_count ||
+            read(fd, bits.data(), bits_size) != bits_size) {
+            continue;
+        }
+
+        fs.resize(line_count);
+        fs.ensure_mask_width(index / 32 + 1);
+        for (size_t lpc = 0; lpc < bits.size(); lpc++) {
+            uint32_t word = bits[lpc];
+
+            while (word != 0) {
+                fs.set_mask(lpc * 32 + __builtin_ctz(word), index);
+                word &= word - 1;
+            }
+        }
+
+        // Fake the state end_of_message() leaves behind so a restart of the
+        // last message reverts the right lines.
+        size_t last_start = line_count - 1;
+
+        while (last_start > 0 && lf.begin()[last_start].is_continued()) {
+            last_start -= 1;
+        }
+
+        fs.tfs_filter_count[index] = line_count;
+        fs.tfs_filter_hits[index] = mch.mch_hits;
+        fs.tfs_message_matched[index] = false;
+        fs.tfs_last_message_matched[index] = fs.test_mask(line_count - 1,
+                                                          index);
+        fs.tfs_last_lines_for_message[index] = line_count - last_start;
+        fs.tfs_cached_count[index] = line_count;
+
+        // Keep the cache from expiring while it is being used.
+        log_perror(utimes(cache_path.value().str().c_str(), nullptr));
+
+        log_info("%s: restored %llu filter matches from index cache -- %s",
+                 lf.get_filename().c_str(),
+                 (unsigned long long) mch.mch_hits,
+                 key.c_str());
+    }
+}
+
+void line_filter_observer::save_cached_matches(const logfile &lf)
+{
+    auto &fs = this->lfo_filter_state;
+    size_t line_count = lf.size();
+
+    for (auto &filter : this->lfo_filter_stack) {
+        size_t index = filter->get_index();
+
+        if (filter->lf_deleted ||
+            fs.tfs_filter_count[index] != line_count ||
+            fs.tfs_lines_for_message[index] != 0 ||
+            fs.tfs_cached_count[index] == line_count) {
+            continue;
+        }
+
+        auto key = filter->get_match_cache_key();
+
+        if (key.empty()) {
+            continue;
+        }
+
+        auto cache_path = lf.get_match_cache_path(key);
+
+        if (!cache_path) {
+            return;
+        }
+
+        struct match_cache_header mch;
+        std::vector<uint32_t> bits((line_count + 31) / 32, 0);
+        ssize_t bits_size = sizeof(uint32_t) * bits.size();
+
+        memset(&mch, 0, sizeof(mch));
+        memcpy(mch.mch_magic, MATCH_CACHE_MAGIC, sizeof(mch.mch_magic));
+        mch.mch_version = MATCH_CACHE_VERSION;
+        mch.mch_line_count = line_count;
+        mch.mch_hits = fs.tfs_filter_hits[index];
+        for (size_t lpc = 0; lpc < line_count; lpc++) {
+            if (fs.test_mask(lpc, index)) {
+                bits[lpc / 32] |= (1UL << (lpc % 32));
+            }
+        }
+
+        auto tmp_path = cache_path.value().str() + "." +
+                        std::to_string(getpid()) + ".tmp";
+        auto_fd fd;
+
+        if ((fd = openp(filesystem::path(tmp_path),
+                        O_WRONLY | O_CREAT | O_TRUNC, 0600)) == -1) {
+            log_debug("unable to create match cache -- %s", strerror(errno));
+            return;
+        }
+
+        if (write(fd, &mch, sizeof(mch)) != sizeof(mch) ||
+            write(fd, bits.data(), bits_size) != bits_size) {
+            log_error("unable to write match cache -- %s", strerror(errno));
+            log_perror(unlink(tmp_path.c_str()));
+            return;
+        }
+
+        if (rename(tmp_path.c_str(), cache_path.value().str().c_str()) == -1) {
+            log_error("unable to rename match cache -- %s", strerror(errno));
+            log_perror(unlink(tmp_path.c_str()));
+            return;
+        }
+
+        fs.tfs_cached_count[index] = line_count;
+    }
+}
+
+void line_filter_observer::start_preview(std::shared_ptr<text_filter> tf)
+{
+    this->lfo_preview_filter = std::move(tf);
+    this->lfo_preview_state.reset();
+    if (this->lfo_preview_filter != nullptr) {
+        this->lfo_preview_state = std::make_unique<logfile_filter_state>(
+            this->lfo_filter_state.tfs_logfile);
+    }
+    this->lfo_preview_read = 0;
+    this->lfo_preview_counted = 0;
+    this->lfo_preview_hidden = 0;
+    this->lfo_preview_shown = 0;
+}
+
+bool line_filter_observer::preview_lines(logfile::deadline_t deadline)
+{
+    static const size_t LINES_PER_DEADLINE_CHECK = 1024;
+
+    if (this->lfo_preview_state == nullptr) {
+        return true;
+    }
+
+    auto &ps = *this->lfo_preview_state;
+    auto &filter = *this->lfo_preview_filter;
+    auto lf = this->lfo_filter_state.tfs_logfile;
+
+    if (lf == nullptr) {
+        return true;
+    }
+    if (ps.tfs_logfile != lf) {
+        this->start_preview(this->lfo_preview_filter);
+    }
+
+    auto literal = filter.get_required_literal();
+    size_t line_count = lf->size();
+
+    ps.resize(line_count);
+    while (this->lfo_preview_read < line_count) {
+        size_t offset = this->lfo_preview_read;
+
+        if (deadline && (offset % LINES_PER_DEADLINE_CHECK) == 0 &&
+            std::chrono::steady_clock::now() > deadline.value()) {
+            return false;
+        }
+
+        auto ll = lf->begin() + offset;
+        bool maybe_matches = literal.empty() ||
+                             lf->line_may_contain(offset, literal);
+        shared_buffer_ref sbr;
+
+        if (maybe_matches) {
+            auto read_result = lf->read_line(ll);
+
+            if (read_result.isOk()) {
+                sbr = read_result.unwrap();
+                if (lf->get_format() != nullptr) {
+                    lf->get_format()->get_subline(*ll, sbr);
+                }
+            } else {
+                maybe_matches = false;
+            }
+        }
+        filter.add_line(ps, ll, sbr, maybe_matches);
+        this->lfo_preview_read += 1;
+    }
+
+    return true;
+}
+
+void line_filter_observer::truncate_preview(size_t line_count)
+{
+    if (this->lfo_preview_state == nullptr ||
+        this->lfo_preview_read <= line_count) {
+        return;
+    }
+
+    auto &ps = *this->lfo_preview_state;
+    size_t index = this->lfo_preview_filter->get_index();
+
+    if (ps.tfs_filter_count[index] <= line_count) {
+        // Only the message that was still open is affected, so start it
+        // over again.
+        ps.tfs_message_matched[index] = false;
+        ps.tfs_lines_for_message[index] = 0;
+        this->lfo_preview_read = ps.tfs_filter_count[index];
+    } else {
+        this->start_preview(this->lfo_preview_filter);
+    }
+    if (this->lfo_preview_counted > this->lfo_preview_read) {
+        this->lfo_preview_counted = 0;
+        this->lfo_preview_hidden = 0;
+        this->lfo_preview_shown = 0;
+    }
+}
+
+bool line_filter_observer::commit_preview(const text_filter &tf)
+{
+    auto &fs = this->lfo_filter_state;
+    size_t index = tf.get_index();
+
+    if (this->lfo_preview_state == nullptr ||
+        this->lfo_preview_state->tfs_logfile != fs.tfs_logfile ||
+        fs.tfs_logfile == nullptr ||
+        fs.tfs_filter_count[index] != 0 ||
+        fs.tfs_lines_for_message[index] != 0) {
+        return false;
+    }
+
+    auto &ps = *this->lfo_preview_state;
+    size_t line_count = fs.tfs_logfile->size();
+
+    if (this->lfo_preview_read == line_count) {
+        // All of the lines have been seen, so the last message can be
+        // finished like at the end of the file.
+        this->lfo_preview_filter->end_of_message(ps);
+    }
+
+    size_t count = ps.tfs_filter_count[index];
+
+    if (count == 0) {
+        return false;
+    }
+
+    fs.resize(line_count);
+    fs.ensure_mask_width(index / 32 + 1);
+    for (size_t lpc = 0; lpc < count; lpc++) {
+        if (ps.test_mask(lpc, index)) {
+            fs.set_mask(lpc, index);
+        }
+    }
+    fs.tfs_filter_count[index] = count;
+    fs.tfs_filter_hits[index] = ps.tfs_filter_hits[index];
+    fs.tfs_message_matched[index] = false;
+    fs.tfs_lines_for_message[index] = 0;
+    fs.tfs_last_message_matched[index] = ps.tfs_last_message_matched[index];
+    fs.tfs_last_lines_for_message[index] =
+        ps.tfs_last_lines_for_message[index];
+    fs.tfs_cached_count[index] = 0;
+
+    log_info("%s: using %zu lines of filter preview -- %s",
+             fs.tfs_logfile->get_filename().c_str(),
+             count,
+             tf.get_id().c_str());
+
+    return true;
+}
@@ -46,18 +46,86 @@ public:
         for (auto &filter : this->lfo_filter_stack) {
             filter->revert_to_last(this->lfo_filter_state, rollback_size);
         }
+        this->truncate_preview(lf.size());
     };
 
     void logline_new_line(const logfile &lf, logfile::const_iterator ll, shared_buffer_ref &sbr);
 
+    bool logline_skip_line(const logfile &lf, logfile::const_iterator ll);
+
     void logline_eof(const logfile &lf);;
 
-    bool excluded(uint32_t filter_in_mask, uint32_t filter_out_mask,
-            size_t offset) const {
-        bool filtered_in = (filter_in_mask == 0) || (
-                this->lfo_filter_state.tfs_mask[offset] & filter_in_mask) != 0;
-        bool filtered_out = (
-                this->lfo_filter_state.tfs_mask[offset] & filter_out_mask) != 0;
+    /**
+     * Restore the matches of the filters that have not looked at the file
+     * yet from the index cache, so they do not need to be evaluated again.
+     */
+    void load_cached_matches(const logfile &lf);
+
+    /**
+     * Save the matches of the filters that have looked at the whole file to
+     * the index cache.
+     */
+    void save_cached_matches(const logfile &lf);
+
+    /**
+     * Start running a filter that is not in the stack yet over this file,
+     * with its own state so the other filters are not affected.
+     *
+     * @param tf The filter to try out or nullptr to stop.
+     */
+    void start_preview(std::shared_ptr<text_filter> tf);
+
+    /**
+     * Pass more lines to the filter being previewed.
+     *
+     * @return True if all of the lines in the file have been passed to it.
+     */
+    bool preview_lines(logfile::deadline_t deadline);
+
+    /**
+     * Forget what the previewed filter found for lines that are no longer
+     * in the file, they are read again after they are re-indexed.
+     */
+    void truncate_preview(size_t line_count);
+
+    /**
+     * Copy the matches found by the previewed filter for the messages it
+     * has seen all of into the state for the filter in the stack with the
+     * same index.  The rest of the lines are observed as usual.
+     *
+     * @return True if the matches were used.
+     */
+    bool commit_preview(const text_filter &tf);
+
+    /** @return The number of lines whose preview result is known. */
+    size_t get_preview_count() const {
+        if (this->lfo_preview_state == nullptr) {
+            return 0;
+        }
+        return this->lfo_preview_state->tfs_filter_count[
+            this->lfo_preview_filter->get_index()];
+    };
+
+    /** @return True if the previewed filter matched the given line. */
+    bool preview_matched(size_t offset) const {
+        return this->lfo_preview_state->test_mask(
+            offset, this->lfo_preview_filter->get_index());
+    };
+
+    bool excluded(const filter_mask_t &filter_in_mask,
+                  const filter_mask_t &filter_out_mask,
+                  size_t offset) const {
+        const uint32_t *line_mask = this->lfo_filter_state.mask_for_line(offset);
+        size_t width = this->lfo_filter_state.tfs_mask_width;
+        uint32_t in_hits = 0, out_hits = 0;
+
+        for (size_t lpc = 0; lpc < width; lpc++) {
+            in_hits |= line_mask[lpc] & filter_in_mask.fm_words[lpc];
+            out_hits |= line_mask[lpc] & filter_out_mask.fm_words[lpc];
+        }
+
+        bool filtered_in = in_hits != 0 || !filter_in_mask.any();
+        bool filtered_out = out_hits != 0;
         return !filtered_in || filtered_out;
     };
 
@@ -75,20 +143,29 @@ public:
     };
 
     void clear_deleted_filter_state() {
-        uint32_t used_mask = 0;
+        filter_mask_t used_mask;
 
         for (auto &filter : this->lfo_filter_stack) {
             if (filter->lf_deleted) {
                 log_debug("skipping deleted %d", filter->get_index());
                 continue;
             }
-            used_mask |= (1UL << filter->get_index());
+            used_mask.set(filter->get_index());
         }
         this->lfo_filter_state.clear_deleted_filter_state(used_mask);
     };
 
     filter_stack &lfo_filter_stack;
     logfile_filter_state lfo_filter_state;
+
+    std::shared_ptr<text_filter> lfo_preview_filter;
+    std::unique_ptr<logfile_filter_state> lfo_preview_state;
+    /** The number of lines that have been passed to the previewed filter. */
+    size_t lfo_preview_read{0};
+    /** The number of lines counted in lfo_preview_hidden/shown. */
+    size_t lfo_preview_counted{0};
+    size_t lfo_preview_hidden{0};
+    size_t lfo_preview_shown{0};
 };
 
 #endif
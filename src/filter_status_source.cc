@@ -72,6 +72,8 @@ filter_status_source::filter_status_source()
     this->tss_error.set_left_pad(1);
     this->tss_error.set_min_width(35);
     this->tss_error.set_share(1);
+    this->tss_preview.right_justify(true);
+    this->tss_preview.set_min_width(20);
 }
 
 size_t filter_status_source::statusview_fields()
@@ -82,7 +84,8 @@ size_t filter_status_source::statusview_fields()
         this->tss_fields[TSF_HELP].set_value(TOGGLE_MSG);
     }
 
-    if (this->tss_prompt.empty() && this->tss_error.empty()) {
+    if (this->tss_prompt.empty() && this->tss_error.empty() &&
+        this->tss_preview.empty()) {
         lnav_data.ld_view_stack.top() | [this] (auto tc) {
             text_sub_source *tss = tc->get_sub_source();
             if (tss == nullptr) {
@@ -111,6 +114,10 @@ size_t filter_status_source::statusview_fields()
         return TSF__MAX;
     }
 
+    if (!this->tss_preview.empty()) {
+        return 4;
+    }
+
     return 3;
 }
 
@@ -120,6 +127,10 @@ status_field &filter_status_source::statusview_value_for_field(int field)
         return this->tss_fields[field];
     }
 
+    if (field == 3 && !this->tss_preview.empty()) {
+        return this->tss_preview;
+    }
+
     if (!this->tss_error.empty()) {
         return this->tss_error;
     }
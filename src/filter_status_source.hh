@@ -58,6 +58,8 @@ public:
 
     status_field tss_error{1024, view_colors::VCR_ALERT_STATUS};
     status_field tss_prompt{1024, view_colors::VCR_STATUS};
+    /** The effect of the filter being edited, see text_preview_filter(). */
+    status_field tss_preview{64, view_colors::VCR_STATUS};
 private:
     status_field tss_fields[TSF__MAX];
     int          bss_last_filtered_count{0};
@@ -271,7 +271,13 @@ void filter_sub_source::text_value_for_line(textview_curses &tc, int line,
     }
 
     if (this->fss_editing && line == tc.get_selection()) {
-        snprintf(hits, sizeof(hits), "%6s hits | ", "-");
+        auto fp = tss->text_get_filter_preview();
+
+        if (fp) {
+            snprintf(hits, sizeof(hits), "%6zu hits | ", fp->fp_hits);
+        } else {
+            snprintf(hits, sizeof(hits), "%6s hits | ", "-");
+        }
     } else {
         snprintf(hits, sizeof(hits), "%6d hits | ", tss->get_filtered_count_for(tf->get_index()));
     }
@@ -355,7 +361,8 @@ void filter_sub_source::rl_change(readline_curses *rc)
                  .set_value("error: %s", errptr);
     } else {
         textview_curses::highlight_map_t &hm = top_view->get_highlights();
-        highlighter hl(code.release());
+        pcre *raw_code = code.release();
+        highlighter hl(raw_code);
         int color;
 
         if (tf->get_type() == text_filter::EXCLUDE) {
@@ -369,7 +376,59 @@ void filter_sub_source::rl_change(readline_curses *rc)
         hm[{highlight_source_t::PREVIEW, "preview"}] = hl;
         top_view->set_needs_update();
         lnav_data.ld_filter_status_source.tss_error.clear();
+
+        // Find out what the filter would do to the whole view while it is
+        // being edited, instead of just highlighting what is on the screen.
+        tss->text_preview_filter(make_shared<pcre_filter>(
+            tf->get_type(), new_value, tf->get_index(), raw_code));
+        this->update_preview_status(tss);
+        return;
+    }
+
+    tss->text_preview_filter(nullptr);
+    this->update_preview_status(tss);
+}
+
+bool filter_sub_source::update_preview(logfile::deadline_t deadline)
+{
+    if (!this->fss_editing) {
+        return false;
+    }
+
+    return (lnav_data.ld_view_stack.top() | [this, deadline] (auto tc) {
+        text_sub_source *tss = tc->get_sub_source();
+
+        if (tss == nullptr) {
+            return nonstd::make_optional(false);
+        }
+
+        bool retval = tss->text_preview_step(deadline);
+
+        this->update_preview_status(tss);
+        this->tss_view->set_needs_update();
+
+        return nonstd::make_optional(retval);
+    }).value_or(false);
+}
+
+void filter_sub_source::update_preview_status(text_sub_source *tss)
+{
+    status_field &sf = lnav_data.ld_filter_status_source.tss_preview;
+    auto fp = tss->text_get_filter_preview();
+
+    if (!fp || fp->fp_line_count == 0) {
+        sf.clear();
+        return;
+    }
+
+    char progress[32] = "";
+
+    if (!fp->is_done()) {
+        snprintf(progress, sizeof(progress), " (%zu%%)",
+                 fp->fp_lines_done * 100 / fp->fp_line_count);
     }
+    sf.set_value("%'zu hits, %'zu lines hidden, %'zu shown%s ",
+                 fp->fp_hits, fp->fp_hidden, fp->fp_shown, progress);
 }
 
 void filter_sub_source::rl_perform(readline_curses *rc)
@@ -403,7 +462,9 @@ void filter_sub_source::rl_perform(readline_curses *rc)
         tss->text_filters_changed();
     }
 
+    tss->text_preview_filter(nullptr);
     lnav_data.ld_filter_status_source.tss_prompt.clear();
+    lnav_data.ld_filter_status_source.tss_preview.clear();
     this->fss_editing = false;
     this->fss_editor.set_visible(false);
     this->tss_view->reload_data();
@@ -417,8 +478,10 @@ void filter_sub_source::rl_abort(readline_curses *rc)
     auto iter = fs.begin() + this->tss_view->get_selection();
     shared_ptr<text_filter> tf = *iter;
 
+    tss->text_preview_filter(nullptr);
     lnav_data.ld_filter_status_source.tss_prompt.clear();
     lnav_data.ld_filter_status_source.tss_error.clear();
+    lnav_data.ld_filter_status_source.tss_preview.clear();
     top_view->get_highlights().erase({highlight_source_t::PREVIEW, "preview"});
     top_view->reload_data();
     fs.delete_filter("");
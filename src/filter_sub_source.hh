@@ -61,6 +61,16 @@ public:
 
     void rl_change(readline_curses *rc);
 
+    /**
+     * Run the filter being edited over more of the lines in the top view.
+     *
+     * @param deadline The time to stop by.
+     * @return True if there are still lines left.
+     */
+    bool update_preview(logfile::deadline_t deadline);
+
+    void update_preview_status(text_sub_source *tss);
+
     void rl_perform(readline_curses *rc);
 
     void rl_abort(readline_curses *rc);
@@ -0,0 +1,796 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file frame_indexed.cc
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#ifdef HAVE_ZSTD_H
+#include <zstd.h>
+#endif
+
+#ifdef HAVE_LZMA_H
+#include <lzma.h>
+#endif
+
+#include "base/lnav_log.hh"
+#include "fmt/format.h"
+#include "frame_indexed.hh"
+#include "parquet_reader.hh"
+
+using namespace std;
+
+static const size_t FRAME_INBUF_SIZE = 128 * 1024;
+static const size_t FRAME_SKIP_SIZE = 64 * 1024;
+
+static uint32_t read_le32(const unsigned char *data)
+{
+    return ((uint32_t) data[0] |
+            ((uint32_t) data[1] << 8) |
+            ((uint32_t) data[2] << 16) |
+            ((uint32_t) data[3] << 24));
+}
+
+frame_indexed::frame_indexed(int fd) : fi_fd(fd), fi_inbuf(FRAME_INBUF_SIZE)
+{
+    struct stat st;
+
+    if (fstat(fd, &st) == 0) {
+        this->fi_file_size = st.st_size;
+    }
+}
+
+ssize_t frame_indexed::refill()
+{
+    ssize_t rc = pread(this->fi_fd,
+                       this->fi_inbuf.data(),
+                       this->fi_inbuf.size(),
+                       this->fi_read_pos);
+
+    if (rc > 0) {
+        this->fi_read_pos += rc;
+    }
+
+    return rc;
+}
+
+bool frame_indexed::start_frame(size_t index)
+{
+    require(index < this->fi_frames.size());
+
+    const auto &fr = this->fi_frames[index];
+
+    this->fi_curr_frame = index;
+    this->fi_out_pos = fr.f_out_offset;
+    this->fi_in_pos = fr.f_in_offset;
+    this->fi_read_pos = fr.f_in_offset;
+
+    return this->begin_frame(fr);
+}
+
+bool frame_indexed::next_frame()
+{
+    auto &fr = this->fi_frames[this->fi_curr_frame];
+
+    if (fr.f_in_size == -1) {
+        fr.f_in_size = this->fi_in_pos - fr.f_in_offset;
+    }
+    if (fr.f_out_size == -1) {
+        fr.f_out_size = this->fi_out_pos - fr.f_out_offset;
+    }
+
+    if ((size_t) this->fi_curr_frame + 1 == this->fi_frames.size()) {
+        off_t next_in = fr.f_in_offset + fr.f_in_size;
+
+        if (this->fi_frames_complete || next_in >= this->fi_file_size) {
+            this->fi_frames_complete = true;
+            return false;
+        }
+        this->fi_frames.push_back({next_in, -1, this->fi_out_pos, -1});
+    }
+
+    return this->start_frame(this->fi_curr_frame + 1);
+}
+
+int frame_indexed::read(void *buf, size_t offset, size_t size)
+{
+    size_t copied = 0;
+
+    while (copied < size) {
+        off_t off = offset + copied;
+
+        // Find the last known frame that starts at or before the offset.
+        auto iter = upper_bound(this->fi_frames.begin(),
+                                this->fi_frames.end(),
+                                off,
+                                [](off_t lhs, const frame &rhs) {
+                                    return lhs < rhs.f_out_offset;
+                                });
+        ssize_t index = std::distance(this->fi_frames.begin(), iter) - 1;
+
+        if (index < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        /*
+         * Restart from a frame boundary if we need to go backwards or if
+         * there is a known frame that is closer to the requested offset.
+         */
+        if (this->fi_curr_frame == -1 || index > this->fi_curr_frame ||
+            off < this->fi_out_pos) {
+            if (!this->start_frame(index)) {
+                errno = EIO;
+                return -1;
+            }
+        }
+
+        bool frame_end = false;
+        ssize_t rc;
+
+        if (off > this->fi_out_pos) {
+            unsigned char scratch[FRAME_SKIP_SIZE];
+
+            rc = this->decode(scratch,
+                              std::min((off_t) sizeof(scratch),
+                                       off - this->fi_out_pos),
+                              frame_end);
+        }
+        else {
+            rc = this->decode((char *) buf + copied, size - copied, frame_end);
+            if (rc > 0) {
+                copied += rc;
+            }
+        }
+
+        if (rc < 0) {
+            errno = EIO;
+            return -1;
+        }
+        this->fi_out_pos += rc;
+
+        if (frame_end) {
+            if (!this->next_frame()) {
+                break;
+            }
+        }
+        else if (rc == 0) {
+            break;
+        }
+    }
+
+    return copied;
+}
+
+#ifdef HAVE_ZSTD_H
+/**
+ * Reader for zstd files.  Files in the seekable format have a table of
+ * frames at the end that is loaded up front, otherwise the frames are
+ * discovered as the file is read.
+ */
+class zstd_indexed : public frame_indexed {
+public:
+    static const uint32_t SEEKABLE_MAGIC = 0x8F92EAB1;
+    static const uint32_t SKIPPABLE_MAGIC = 0x184D2A5E;
+    static const size_t SEEKABLE_FOOTER_SIZE = 9;
+    static const size_t SKIPPABLE_HEADER_SIZE = 8;
+
+    explicit zstd_indexed(int fd) : frame_indexed(fd) {
+        this->zi_ctx = ZSTD_createDCtx();
+        if (this->zi_ctx == nullptr) {
+            throw bad_alloc();
+        }
+        if (!this->load_seek_table()) {
+            this->fi_frames.push_back({0, -1, 0, -1});
+        }
+    };
+
+    ~zstd_indexed() override {
+        ZSTD_freeDCtx(this->zi_ctx);
+    };
+
+protected:
+    bool load_seek_table() {
+        unsigned char footer[SEEKABLE_FOOTER_SIZE];
+        off_t footer_off = this->fi_file_size - SEEKABLE_FOOTER_SIZE;
+
+        if (footer_off <= 0 ||
+            pread(this->fi_fd, footer, sizeof(footer), footer_off) !=
+            sizeof(footer) ||
+            read_le32(&footer[5]) != SEEKABLE_MAGIC) {
+            return false;
+        }
+
+        uint32_t frame_count = read_le32(footer);
+        size_t entry_size = (footer[4] & 0x80) ? 12 : 8;
+        off_t table_size = SKIPPABLE_HEADER_SIZE +
+                           (off_t) frame_count * entry_size +
+                           SEEKABLE_FOOTER_SIZE;
+        off_t table_off = this->fi_file_size - table_size;
+
+        if (frame_count == 0 || table_off < 0) {
+            return false;
+        }
+
+        vector<unsigned char> table(table_size);
+
+        if (pread(this->fi_fd, table.data(), table.size(), table_off) !=
+            table_size ||
+            read_le32(&table[0]) != SKIPPABLE_MAGIC) {
+            return false;
+        }
+
+        off_t in_offset = 0, out_offset = 0;
+
+        for (uint32_t lpc = 0; lpc < frame_count; lpc++) {
+            const unsigned char *entry =
+                &table[SKIPPABLE_HEADER_SIZE + lpc * entry_size];
+            off_t in_size = read_le32(entry);
+            off_t out_size = read_le32(entry + 4);
+
+            this->fi_frames.push_back({
+                in_offset, in_size, out_offset, out_size
+            });
+            in_offset += in_size;
+            out_offset += out_size;
+        }
+
+        if (in_offset != table_off) {
+            log_error("zstd seek table does not match file size");
+            this->fi_frames.clear();
+            return false;
+        }
+
+        this->fi_frames_complete = true;
+        log_info("loaded zstd seek table with %d frames", frame_count);
+
+        return true;
+    };
+
+    bool begin_frame(const frame &fr) override {
+        ZSTD_DCtx_reset(this->zi_ctx, ZSTD_reset_session_only);
+        this->zi_input = {this->fi_inbuf.data(), 0, 0};
+
+        return true;
+    };
+
+    ssize_t decode(void *buf, size_t size, bool &frame_end) override {
+        ZSTD_outBuffer output = {buf, size, 0};
+
+        frame_end = false;
+        while (output.pos < output.size) {
+            if (this->zi_input.pos == this->zi_input.size) {
+                ssize_t rc = this->refill();
+
+                if (rc < 0) {
+                    return -1;
+                }
+                if (rc == 0) {
+                    break;
+                }
+                this->zi_input = {this->fi_inbuf.data(), (size_t) rc, 0};
+            }
+
+            size_t rc = ZSTD_decompressStream(this->zi_ctx,
+                                              &output,
+                                              &this->zi_input);
+
+            if (ZSTD_isError(rc)) {
+                log_error("zstd decompression failed -- %s",
+                          ZSTD_getErrorName(rc));
+                return -1;
+            }
+            if (rc == 0) {
+                frame_end = true;
+                break;
+            }
+        }
+
+        this->fi_in_pos = this->fi_read_pos -
+                          (this->zi_input.size - this->zi_input.pos);
+
+        return output.pos;
+    };
+
+    ZSTD_DCtx *zi_ctx;
+    ZSTD_inBuffer zi_input{nullptr, 0, 0};
+};
+#endif
+
+#ifdef HAVE_LZMA_H
+/**
+ * Reader for xz files.  The index at the end of the file is used to treat
+ * each block as a frame.  If the index cannot be used, for example because
+ * there are multiple streams in the file, the whole file is decoded as a
+ * single frame.
+ */
+class xz_indexed : public frame_indexed {
+public:
+    explicit xz_indexed(int fd) : frame_indexed(fd) {
+        if (!this->load_index()) {
+            this->fi_frames.push_back({0, -1, 0, -1});
+        }
+    };
+
+    ~xz_indexed() override {
+        lzma_end(&this->xi_strm);
+    };
+
+protected:
+    bool load_index() {
+        unsigned char footer[LZMA_STREAM_HEADER_SIZE];
+        lzma_stream_flags flags;
+        off_t footer_off = this->fi_file_size - LZMA_STREAM_HEADER_SIZE;
+
+        if (footer_off < LZMA_STREAM_HEADER_SIZE ||
+            pread(this->fi_fd, footer, sizeof(footer), footer_off) !=
+            sizeof(footer) ||
+            lzma_stream_footer_decode(&flags, footer) != LZMA_OK) {
+            return false;
+        }
+
+        off_t index_off = footer_off - flags.backward_size;
+
+        if (index_off < LZMA_STREAM_HEADER_SIZE) {
+            return false;
+        }
+
+        vector<unsigned char> index_data(flags.backward_size);
+
+        if (pread(this->fi_fd, index_data.data(), index_data.size(),
+                  index_off) != (ssize_t) index_data.size()) {
+            return false;
+        }
+
+        lzma_index *index = nullptr;
+        uint64_t memlimit = UINT64_MAX;
+        size_t in_pos = 0;
+
+        if (lzma_index_buffer_decode(&index, &memlimit, nullptr,
+                                     index_data.data(), &in_pos,
+                                     index_data.size()) != LZMA_OK) {
+            return false;
+        }
+
+        // Only a file with a single stream and no padding is supported.
+        if (lzma_index_file_size(index) != (lzma_vli) this->fi_file_size) {
+            lzma_index_end(index, nullptr);
+            return false;
+        }
+
+        lzma_index_iter iter;
+
+        lzma_index_iter_init(&iter, index);
+        while (!lzma_index_iter_next(&iter, LZMA_INDEX_ITER_BLOCK)) {
+            this->fi_frames.push_back({
+                (off_t) iter.block.compressed_file_offset,
+                (off_t) iter.block.total_size,
+                (off_t) iter.block.uncompressed_file_offset,
+                (off_t) iter.block.uncompressed_size,
+            });
+        }
+        lzma_index_end(index, nullptr);
+
+        if (this->fi_frames.empty()) {
+            return false;
+        }
+
+        this->xi_check = flags.check;
+        this->xi_blocks = true;
+        this->fi_frames_complete = true;
+        log_info("loaded xz index with %d blocks", this->fi_frames.size());
+
+        return true;
+    };
+
+    bool begin_frame(const frame &fr) override {
+        lzma_ret rc;
+
+        this->xi_strm.next_in = nullptr;
+        this->xi_strm.avail_in = 0;
+        this->xi_input_done = false;
+        if (!this->xi_blocks) {
+            rc = lzma_stream_decoder(&this->xi_strm, UINT64_MAX,
+                                     LZMA_CONCATENATED);
+            return rc == LZMA_OK;
+        }
+
+        unsigned char header[LZMA_BLOCK_HEADER_SIZE_MAX];
+
+        if (pread(this->fi_fd, header, 1, fr.f_in_offset) != 1) {
+            return false;
+        }
+
+        lzma_filter filters[LZMA_FILTERS_MAX + 1];
+        lzma_block block;
+
+        memset(&block, 0, sizeof(block));
+        block.version = 0;
+        block.check = this->xi_check;
+        block.filters = filters;
+        block.header_size = lzma_block_header_size_decode(header[0]);
+
+        if (pread(this->fi_fd, header, block.header_size, fr.f_in_offset) !=
+            (ssize_t) block.header_size ||
+            lzma_block_header_decode(&block, nullptr, header) != LZMA_OK) {
+            return false;
+        }
+
+        rc = lzma_block_decoder(&this->xi_strm, &block);
+        for (int lpc = 0; filters[lpc].id != LZMA_VLI_UNKNOWN; lpc++) {
+            free(filters[lpc].options);
+        }
+        this->fi_read_pos += block.header_size;
+
+        return rc == LZMA_OK;
+    };
+
+    ssize_t decode(void *buf, size_t size, bool &frame_end) override {
+        this->xi_strm.next_out = (uint8_t *) buf;
+        this->xi_strm.avail_out = size;
+
+        frame_end = false;
+        while (this->xi_strm.avail_out > 0) {
+            if (this->xi_strm.avail_in == 0 && !this->xi_input_done) {
+                ssize_t rc = this->refill();
+
+                if (rc < 0) {
+                    return -1;
+                }
+                if (rc == 0) {
+                    this->xi_input_done = true;
+                }
+                this->xi_strm.next_in = this->fi_inbuf.data();
+                this->xi_strm.avail_in = rc;
+            }
+
+            lzma_ret rc = lzma_code(&this->xi_strm,
+                                    this->xi_input_done ?
+                                    LZMA_FINISH : LZMA_RUN);
+
+            if (rc == LZMA_STREAM_END) {
+                frame_end = true;
+                break;
+            }
+            if (rc == LZMA_BUF_ERROR && this->xi_input_done) {
+                break;
+            }
+            if (rc != LZMA_OK) {
+                log_error("xz decompression failed -- %d", rc);
+                return -1;
+            }
+        }
+
+        this->fi_in_pos = this->fi_read_pos - this->xi_strm.avail_in;
+
+        return size - this->xi_strm.avail_out;
+    };
+
+    lzma_stream xi_strm = LZMA_STREAM_INIT;
+    lzma_check xi_check{LZMA_CHECK_NONE};
+    bool xi_blocks{false};
+    bool xi_input_done{false};
+};
+#endif
+
+/**
+ * Reader for Parquet files that presents each row as a log message.  The
+ * row groups are the frames, so a group's columns are only decoded when a
+ * line in it is needed.  A row is rendered as the ISO 8601 timestamp from
+ * the time column, the level and message columns, and then the rest of the
+ * columns as key=value pairs so that they are picked up as fields.
+ */
+class parquet_indexed : public frame_indexed {
+public:
+    parquet_indexed(int fd, parquet_file pf)
+        : frame_indexed(fd), pi_file(std::move(pf)) {
+        const auto &columns = this->pi_file.get_columns();
+        const auto &groups = this->pi_file.get_row_groups();
+
+        for (size_t lpc = 0; lpc < columns.size(); lpc++) {
+            const auto &col = columns[lpc];
+            bool is_time = col.c_kind == parquet_file::value_kind_t::TIMESTAMP;
+            bool is_text = col.c_kind == parquet_file::value_kind_t::TEXT;
+
+            if (is_time && this->pi_time_column == -1 &&
+                is_name_of(col.c_name, TIME_NAMES)) {
+                this->pi_time_column = lpc;
+            } else if (is_text && this->pi_level_column == -1 &&
+                       is_name_of(col.c_name, LEVEL_NAMES)) {
+                this->pi_level_column = lpc;
+            } else if (is_text && this->pi_message_column == -1 &&
+                       is_name_of(col.c_name, MESSAGE_NAMES)) {
+                this->pi_message_column = lpc;
+            }
+        }
+        if (this->pi_time_column == -1) {
+            for (size_t lpc = 0; lpc < columns.size(); lpc++) {
+                if (columns[lpc].c_kind ==
+                    parquet_file::value_kind_t::TIMESTAMP) {
+                    this->pi_time_column = lpc;
+                    break;
+                }
+            }
+        }
+        this->pi_values.resize(columns.size());
+
+        this->fi_frames.push_back({
+            groups.empty() ? 0 : groups.front().rg_start, -1, 0, -1
+        });
+        if (groups.size() <= 1) {
+            this->fi_frames_complete = true;
+        }
+        log_info("opened parquet file with %d row groups", groups.size());
+    };
+
+protected:
+    static constexpr const char *TIME_NAMES[] = {
+        "timestamp", "time", "ts", "@timestamp", "log_time", nullptr,
+    };
+    static constexpr const char *LEVEL_NAMES[] = {
+        "level", "severity", "log_level", "lvl", nullptr,
+    };
+    static constexpr const char *MESSAGE_NAMES[] = {
+        "message", "msg", "body", "log", nullptr,
+    };
+
+    static bool is_name_of(const string &name, const char *const *names) {
+        for (int lpc = 0; names[lpc] != nullptr; lpc++) {
+            if (strcasecmp(name.c_str(), names[lpc]) == 0) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    bool begin_frame(const frame &fr) override {
+        size_t group = this->fi_curr_frame;
+
+        this->pi_row = 0;
+        this->pi_line.clear();
+        this->pi_line_pos = 0;
+        if (group >= this->pi_file.get_row_groups().size() ||
+            (ssize_t) group == this->pi_decoded_group) {
+            return true;
+        }
+
+        this->pi_decoded_group = -1;
+        for (size_t lpc = 0; lpc < this->pi_values.size(); lpc++) {
+            auto rc = this->pi_file.read_column(group, lpc,
+                                                this->pi_values[lpc]);
+
+            if (rc.isErr()) {
+                log_error("unable to decode parquet column %s -- %s",
+                          this->pi_file.get_columns()[lpc].c_name.c_str(),
+                          rc.unwrapErr().c_str());
+                return false;
+            }
+        }
+        this->pi_decoded_group = group;
+
+        return true;
+    };
+
+    ssize_t decode(void *buf, size_t size, bool &frame_end) override {
+        const auto &groups = this->pi_file.get_row_groups();
+        size_t group = this->fi_curr_frame;
+        int64_t rows = group < groups.size() ? groups[group].rg_num_rows : 0;
+        size_t copied = 0;
+
+        frame_end = false;
+        while (copied < size) {
+            if (this->pi_line_pos == this->pi_line.size()) {
+                if (this->pi_row >= rows) {
+                    frame_end = true;
+                    // Point at the next group so that it becomes the next
+                    // frame.
+                    this->fi_in_pos = group + 1 < groups.size() ?
+                                      groups[group + 1].rg_start :
+                                      this->fi_file_size;
+                    break;
+                }
+                this->render_row(this->pi_row);
+                this->pi_row += 1;
+                this->pi_line_pos = 0;
+            }
+
+            size_t amount = std::min(size - copied,
+                                     this->pi_line.size() - this->pi_line_pos);
+
+            memcpy((char *) buf + copied,
+                   this->pi_line.data() + this->pi_line_pos,
+                   amount);
+            this->pi_line_pos += amount;
+            copied += amount;
+        }
+
+        return copied;
+    };
+
+    void append_value(size_t col, const parquet_file::cell &ce, bool quote) {
+        const auto &column = this->pi_file.get_columns()[col];
+        const auto &cv = this->pi_values[col];
+        string &line = this->pi_line;
+
+        switch (ce.c_type) {
+            case parquet_file::cell::NULL_VALUE:
+                break;
+            case parquet_file::cell::INTEGER:
+                if (column.c_kind == parquet_file::value_kind_t::TIMESTAMP) {
+                    line.append(parquet_format_timestamp(ce.c_integer, true));
+                } else if (column.c_kind == parquet_file::value_kind_t::DATE) {
+                    line.append(parquet_format_date(ce.c_integer));
+                } else {
+                    line.append(fmt::format_int(ce.c_integer).str());
+                }
+                break;
+            case parquet_file::cell::REAL:
+                line.append(fmt::format("{}", ce.c_real));
+                break;
+            case parquet_file::cell::BYTES: {
+                const char *bytes = cv.bytes_of(ce);
+                size_t len = ce.c_bytes.cb_length;
+
+                if (column.c_kind == parquet_file::value_kind_t::BLOB) {
+                    for (size_t lpc = 0; lpc < len; lpc++) {
+                        line.append(fmt::format("{:02x}",
+                                                (unsigned char) bytes[lpc]));
+                    }
+                } else if (!quote) {
+                    line.append(bytes, len);
+                } else if (len > 0 && memchr(bytes, ' ', len) == nullptr &&
+                           memchr(bytes, '"', len) == nullptr &&
+                           memchr(bytes, '\n', len) == nullptr) {
+                    line.append(bytes, len);
+                } else {
+                    line.push_back('"');
+                    for (size_t lpc = 0; lpc < len; lpc++) {
+                        switch (bytes[lpc]) {
+                            case '"':
+                            case '\\':
+                                line.push_back('\\');
+                                line.push_back(bytes[lpc]);
+                                break;
+                            case '\n':
+                                line.append("\\n");
+                                break;
+                            default:
+                                line.push_back(bytes[lpc]);
+                                break;
+                        }
+                    }
+                    line.push_back('"');
+                }
+                break;
+            }
+        }
+    };
+
+    void render_row(int64_t row) {
+        const auto &columns = this->pi_file.get_columns();
+
+        this->pi_line.clear();
+        for (int col : {this->pi_time_column,
+                        this->pi_level_column,
+                        this->pi_message_column}) {
+            if (col == -1) {
+                continue;
+            }
+
+            const auto &ce = this->pi_values[col].cv_cells[row];
+
+            if (ce.c_type == parquet_file::cell::NULL_VALUE) {
+                continue;
+            }
+            if (!this->pi_line.empty()) {
+                this->pi_line.push_back(' ');
+            }
+            this->append_value(col, ce, false);
+        }
+        for (size_t col = 0; col < columns.size(); col++) {
+            if ((int) col == this->pi_time_column ||
+                (int) col == this->pi_level_column ||
+                (int) col == this->pi_message_column) {
+                continue;
+            }
+
+            const auto &ce = this->pi_values[col].cv_cells[row];
+
+            if (ce.c_type == parquet_file::cell::NULL_VALUE) {
+                continue;
+            }
+            if (!this->pi_line.empty()) {
+                this->pi_line.push_back(' ');
+            }
+            this->pi_line.append(columns[col].c_name);
+            this->pi_line.push_back('=');
+            this->append_value(col, ce, true);
+        }
+        this->pi_line.push_back('\n');
+    };
+
+    parquet_file pi_file;
+    int pi_time_column{-1};
+    int pi_level_column{-1};
+    int pi_message_column{-1};
+    /** The decoded columns of pi_decoded_group. */
+    vector<parquet_file::column_values> pi_values;
+    ssize_t pi_decoded_group{-1};
+    int64_t pi_row{0};
+    string pi_line;
+    size_t pi_line_pos{0};
+};
+
+constexpr const char *parquet_indexed::TIME_NAMES[];
+constexpr const char *parquet_indexed::LEVEL_NAMES[];
+constexpr const char *parquet_indexed::MESSAGE_NAMES[];
+
+unique_ptr<frame_indexed> frame_indexed::create(int fd,
+                                                const unsigned char *header,
+                                                size_t len)
+{
+#ifdef HAVE_ZSTD_H
+    static const unsigned char ZSTD_MAGIC[] = {0x28, 0xb5, 0x2f, 0xfd};
+
+    if (len >= sizeof(ZSTD_MAGIC) &&
+        memcmp(header, ZSTD_MAGIC, sizeof(ZSTD_MAGIC)) == 0) {
+        return make_unique<zstd_indexed>(fd);
+    }
+#endif
+
+#ifdef HAVE_LZMA_H
+    static const unsigned char XZ_MAGIC[] = {0xfd, '7', 'z', 'X', 'Z', 0x00};
+
+    if (len >= sizeof(XZ_MAGIC) &&
+        memcmp(header, XZ_MAGIC, sizeof(XZ_MAGIC)) == 0) {
+        return make_unique<xz_indexed>(fd);
+    }
+#endif
+
+    if (len >= parquet_file::MAGIC_SIZE &&
+        memcmp(header, parquet_file::MAGIC, parquet_file::MAGIC_SIZE) == 0) {
+        auto open_res = parquet_file::open(fd);
+
+        if (open_res.isErr()) {
+            log_error("unable to open parquet file -- %s",
+                      open_res.unwrapErr().c_str());
+            return nullptr;
+        }
+        return make_unique<parquet_indexed>(fd, open_res.unwrap());
+    }
+
+    return nullptr;
+}
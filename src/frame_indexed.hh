@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file frame_indexed.hh
+ */
+
+#ifndef lnav_frame_indexed_hh
+#define lnav_frame_indexed_hh
+
+#include <sys/types.h>
+
+#include <memory>
+#include <vector>
+
+/**
+ * Reader for compressed files that are made up of independently decodable
+ * frames, like zstd frames, xz blocks or Parquet row groups.  The frames in
+ * a file are recorded as they are decoded, or up front if the file has an
+ * index, so that a random access only needs to decode from the start of the
+ * frame that contains the requested data.
+ */
+class frame_indexed {
+public:
+    struct frame {
+        off_t f_in_offset;      /*< The offset of the frame in the file. */
+        off_t f_in_size;        /*< The compressed size or -1 if unknown. */
+        off_t f_out_offset;     /*< The offset of the frame's data. */
+        off_t f_out_size;       /*< The uncompressed size or -1 if unknown. */
+    };
+
+    /**
+     * Create a reader for the given file if it is in one of the supported
+     * formats.
+     *
+     * @param fd The file to read from, it is not owned by the reader.
+     * @param header The first bytes of the file.
+     * @param len The number of bytes in the header.
+     * @return The reader or nullptr if the format is not supported.
+     */
+    static std::unique_ptr<frame_indexed> create(int fd,
+                                                 const unsigned char *header,
+                                                 size_t len);
+
+    virtual ~frame_indexed() = default;
+
+    /**
+     * Decompress bytes from the file returning at most `size` bytes.
+     * offset is the byte-offset in the decompressed data stream.
+     *
+     * @return The number of bytes read or -1 on error with errno set.
+     */
+    int read(void *buf, size_t offset, size_t size);
+
+    off_t get_source_offset() const {
+        return this->fi_in_pos;
+    };
+
+    const std::vector<frame> &get_frames() const {
+        return this->fi_frames;
+    };
+
+protected:
+    explicit frame_indexed(int fd);
+
+    /**
+     * Prepare the decoder to start decoding the given frame.  The input
+     * will be read from fi_read_pos, which starts at the frame offset.
+     */
+    virtual bool begin_frame(const frame &fr) = 0;
+
+    /**
+     * Continue decoding the current frame.
+     *
+     * @param frame_end Set to true when the end of the frame was reached.
+     * @return The number of bytes decoded or -1 on error.
+     */
+    virtual ssize_t decode(void *buf, size_t size, bool &frame_end) = 0;
+
+    /**
+     * Read more compressed data into fi_inbuf from fi_read_pos.
+     *
+     * @return The number of bytes read.
+     */
+    ssize_t refill();
+
+    bool start_frame(size_t index);
+
+    bool next_frame();
+
+    int fi_fd;
+    off_t fi_file_size{0};
+    std::vector<frame> fi_frames;
+    bool fi_frames_complete{false}; /*< All the frames are known. */
+    ssize_t fi_curr_frame{-1};
+    off_t fi_out_pos{0};            /*< The decoder position in the output. */
+    off_t fi_in_pos{0};             /*< The compressed data consumed so far. */
+    off_t fi_read_pos{0};           /*< Where the next refill() reads from. */
+    std::vector<unsigned char> fi_inbuf;
+};
+
+#endif
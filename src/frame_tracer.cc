@@ -0,0 +1,158 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file frame_tracer.cc
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include "base/lnav_log.hh"
+#include "lnav_config.hh"
+#include "frame_tracer.hh"
+
+using namespace std;
+
+frame_tracer &frame_tracer::singleton()
+{
+    static frame_tracer retval;
+
+    return retval;
+}
+
+frame_tracer::~frame_tracer()
+{
+    this->close_trace();
+}
+
+void frame_tracer::close_trace()
+{
+    if (this->ft_trace_file != nullptr) {
+        fprintf(this->ft_trace_file, "{}]\n");
+        this->ft_trace_file.reset();
+    }
+}
+
+void frame_tracer::update_config()
+{
+    this->ft_overlay = lnav_config.lc_ui_frame_times;
+
+    if (lnav_config.lc_ui_frame_trace_file == this->ft_trace_path) {
+        return;
+    }
+
+    this->close_trace();
+    this->ft_trace_path = lnav_config.lc_ui_frame_trace_file;
+    if (this->ft_trace_path.empty()) {
+        return;
+    }
+
+    this->ft_trace_file = fopen(this->ft_trace_path.c_str(), "w");
+    if (this->ft_trace_file == nullptr) {
+        log_error("unable to open frame trace file: %s -- %s",
+                  this->ft_trace_path.c_str(),
+                  strerror(errno));
+        return;
+    }
+
+    log_info("writing frame trace to: %s", this->ft_trace_path.c_str());
+    // The array is left open so the file can still be loaded if lnav exits
+    // without closing it.
+    fprintf(this->ft_trace_file, "[\n");
+}
+
+void frame_tracer::begin_frame()
+{
+    if (!this->is_enabled()) {
+        return;
+    }
+
+    this->ft_frame_start = clock::now();
+}
+
+void frame_tracer::end_frame()
+{
+    if (!this->is_enabled()) {
+        return;
+    }
+
+    auto now = clock::now();
+
+    this->ft_last_frame_ns = chrono::duration_cast<chrono::nanoseconds>(
+        now - this->ft_frame_start).count();
+    this->ft_frames.record(this->ft_last_frame_ns);
+    this->write_event("frame", "", this->ft_frame_start, now);
+
+    if (this->ft_input_pending) {
+        this->ft_input_pending = false;
+        this->ft_last_input_ns = chrono::duration_cast<chrono::nanoseconds>(
+            now - this->ft_input_time).count();
+        this->ft_input_latency.record(this->ft_last_input_ns);
+        this->write_event("input-to-paint", "", this->ft_input_time, now);
+    }
+
+    if (this->ft_trace_file != nullptr) {
+        fflush(this->ft_trace_file);
+    }
+}
+
+void frame_tracer::input_received()
+{
+    if (!this->is_enabled() || this->ft_input_pending) {
+        return;
+    }
+
+    this->ft_input_pending = true;
+    this->ft_input_time = clock::now();
+}
+
+void frame_tracer::write_event(const char *name,
+                               const std::string &detail,
+                               clock::time_point start,
+                               clock::time_point end)
+{
+    if (this->ft_trace_file == nullptr) {
+        return;
+    }
+
+    auto ts = chrono::duration_cast<chrono::microseconds>(
+        start - this->ft_epoch).count();
+    auto dur = chrono::duration_cast<chrono::microseconds>(end - start).count();
+
+    fprintf(this->ft_trace_file,
+            "{\"name\":\"%s%s%s\",\"cat\":\"ui\",\"ph\":\"X\","
+            "\"ts\":%lld,\"dur\":%lld,\"pid\":%d,\"tid\":1},\n",
+            name,
+            detail.empty() ? "" : ":",
+            detail.c_str(),
+            (long long) ts,
+            (long long) dur,
+            (int) getpid());
+}
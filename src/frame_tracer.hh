@@ -0,0 +1,158 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file frame_tracer.hh
+ */
+
+#ifndef lnav_frame_tracer_hh
+#define lnav_frame_tracer_hh
+
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+
+#include "auto_mem.hh"
+#include "base/perf_counter.hh"
+
+/**
+ * Times the steps of the main loop so that stalls in the UI can be tracked
+ * down.  The time taken to draw each frame and the latency between a key
+ * press and the frame that shows its result are kept.  The steps can also
+ * be written to a file in the Chrome trace-event format so they can be
+ * viewed in chrome://tracing or a compatible viewer.
+ */
+class frame_tracer {
+public:
+    using clock = std::chrono::steady_clock;
+
+    static frame_tracer &singleton();
+
+    /**
+     * Pick up changes to the "/ui/frame-times" and "/ui/frame-trace-file"
+     * configuration.
+     */
+    void update_config();
+
+    /** @return True if frames are being timed. */
+    bool is_enabled() const {
+        return this->ft_overlay || this->ft_trace_file != nullptr;
+    };
+
+    /** @return True if the steps are being written to a trace file. */
+    bool is_tracing() const {
+        return this->ft_trace_file != nullptr;
+    };
+
+    /** @return True if the frame times should be shown on screen. */
+    bool is_overlay_enabled() const {
+        return this->ft_overlay;
+    };
+
+    void begin_frame();
+
+    void end_frame();
+
+    /**
+     * Note that input was received, the latency is measured until the end
+     * of the next frame.
+     */
+    void input_received();
+
+    /**
+     * Times a step in the main loop.
+     */
+    class span {
+    public:
+        span(const char *name, const std::string &detail = "")
+            : s_name(name), s_detail(detail) {
+            if (frame_tracer::singleton().is_tracing()) {
+                this->s_start = clock::now();
+                this->s_active = true;
+            }
+        };
+
+        span(const span &) = delete;
+
+        ~span() {
+            if (this->s_active) {
+                frame_tracer::singleton().write_event(
+                    this->s_name, this->s_detail, this->s_start, clock::now());
+            }
+        };
+
+    private:
+        const char *s_name;
+        std::string s_detail;
+        clock::time_point s_start;
+        bool s_active{false};
+    };
+
+    const perf_counter &get_frame_counter() const {
+        return this->ft_frames;
+    };
+
+    const perf_counter &get_input_counter() const {
+        return this->ft_input_latency;
+    };
+
+    uint64_t get_last_frame_ns() const {
+        return this->ft_last_frame_ns;
+    };
+
+    uint64_t get_last_input_ns() const {
+        return this->ft_last_input_ns;
+    };
+
+private:
+    frame_tracer() = default;
+
+    ~frame_tracer();
+
+    /** Finish the trace-event array and close the file. */
+    void close_trace();
+
+    void write_event(const char *name,
+                     const std::string &detail,
+                     clock::time_point start,
+                     clock::time_point end);
+
+    bool ft_overlay{false};
+    std::string ft_trace_path;
+    auto_mem<FILE> ft_trace_file{fclose};
+    clock::time_point ft_epoch{clock::now()};
+    clock::time_point ft_frame_start;
+    clock::time_point ft_input_time;
+    bool ft_input_pending{false};
+    uint64_t ft_last_frame_ns{0};
+    uint64_t ft_last_input_ns{0};
+    perf_counter ft_frames;
+    perf_counter ft_input_latency;
+};
+
+#endif
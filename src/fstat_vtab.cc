@@ -37,6 +37,10 @@
 #include <grp.h>
 #include <pwd.h>
 
+#include <algorithm>
+#include <thread>
+#include <vector>
+
 #include "auto_mem.hh"
 #include "base/lnav_log.hh"
 #include "sql_util.hh"
@@ -100,21 +104,107 @@ CREATE TABLE fstat (
         };
     };
 
+    /**
+     * The paths are stat'd a window at a time so that a query with a LIMIT
+     * does not have to wait for every path to be stat'd.  The window starts
+     * small and grows as the query keeps reading rows.
+     */
+    static const size_t MIN_WINDOW = 64;
+    static const size_t MAX_WINDOW = 4 * 1024;
+    /**
+     * Windows with fewer paths than this are stat'd on the query thread,
+     * larger ones are split between threads so that the latency of each
+     * call is overlapped when the files are on a network filesystem.
+     */
+    static const size_t PARALLEL_MIN = 32;
+    static const size_t MAX_WORKERS = 16;
+
     struct cursor {
         sqlite3_vtab_cursor base;
         string c_pattern;
         static_root_mem<glob_t, globfree> c_glob;
         size_t c_path_index{0};
         struct stat c_stat;
+        size_t c_window_start{0};
+        size_t c_window_size{MIN_WINDOW};
+        vector<struct stat> c_window_stats;
+        vector<char> c_window_valid;
 
         cursor(sqlite3_vtab *vt) : base({vt}) {
             memset(&this->c_stat, 0, sizeof(this->c_stat));
         };
 
+        void clear_window() {
+            this->c_path_index = 0;
+            this->c_window_start = 0;
+            this->c_window_size = MIN_WINDOW;
+            this->c_window_stats.clear();
+            this->c_window_valid.clear();
+        };
+
+        void stat_range(size_t first, size_t last) {
+            for (size_t lpc = first; lpc < last; lpc++) {
+                const char *path =
+                    this->c_glob->gl_pathv[this->c_window_start + lpc];
+
+                this->c_window_valid[lpc] =
+                    lstat(path, &this->c_window_stats[lpc]) == 0;
+            }
+        };
+
+        /** Stat the paths in the window that starts at the given index. */
+        void fill_window(size_t start) {
+            size_t count = std::min(this->c_window_size,
+                                    this->c_glob->gl_pathc - start);
+
+            this->c_window_start = start;
+            this->c_window_stats.resize(count);
+            this->c_window_valid.assign(count, false);
+
+            size_t workers = std::min(
+                {(size_t) std::thread::hardware_concurrency() * 2,
+                 MAX_WORKERS,
+                 count / (PARALLEL_MIN / 2)});
+
+            if (count < PARALLEL_MIN || workers <= 1) {
+                this->stat_range(0, count);
+            } else {
+                size_t per_worker = (count + workers - 1) / workers;
+                vector<std::thread> threads;
+
+                for (size_t lpc = 1; lpc < workers; lpc++) {
+                    size_t first = lpc * per_worker;
+
+                    if (first >= count) {
+                        break;
+                    }
+                    threads.emplace_back(&cursor::stat_range, this,
+                                         first,
+                                         std::min(first + per_worker, count));
+                }
+                this->stat_range(0, std::min(per_worker, count));
+                for (auto &th : threads) {
+                    th.join();
+                }
+            }
+
+            this->c_window_size = std::min(this->c_window_size * 2,
+                                           MAX_WINDOW);
+        };
+
         void load_stat() {
-            while ((this->c_path_index < this->c_glob->gl_pathc) &&
-                   lstat(this->c_glob->gl_pathv[this->c_path_index],
-                         &this->c_stat) == -1) {
+            while (this->c_path_index < this->c_glob->gl_pathc) {
+                if (this->c_path_index >=
+                    this->c_window_start + this->c_window_stats.size()) {
+                    this->fill_window(this->c_path_index);
+                }
+
+                size_t offset = this->c_path_index - this->c_window_start;
+
+                if (this->c_window_valid[offset]) {
+                    this->c_stat = this->c_window_stats[offset];
+                    break;
+                }
                 this->c_path_index += 1;
             }
         };
@@ -314,6 +404,7 @@ static int rcFilter(sqlite3_vtab_cursor *pVtabCursor,
 {
     fstat_table::cursor *pCur = (fstat_table::cursor *)pVtabCursor;
 
+    pCur->clear_window();
     if (argc != 1) {
         pCur->c_pattern.clear();
         return SQLITE_OK;
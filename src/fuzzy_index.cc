@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file fuzzy_index.cc
+ */
+
+#include "config.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#include "fts_fuzzy_match.hh"
+#include "fuzzy_index.hh"
+
+uint32_t fuzzy_index::char_bit(char ch)
+{
+    auto lower = (unsigned char) tolower((unsigned char) ch);
+
+    if ('a' <= lower && lower <= 'z') {
+        return lower - 'a';
+    }
+    if ('0' <= lower && lower <= '9') {
+        return 26 + lower - '0';
+    }
+
+    return 36 + lower % 28;
+}
+
+uint32_t fuzzy_index::pair_bit(uint32_t first, uint32_t second)
+{
+    return (first * 64 + second) % (PAIR_WORDS * 64);
+}
+
+fuzzy_index::fuzzy_index(const std::set<std::string> &candidates)
+{
+    this->fi_entries.reserve(candidates.size());
+    for (const auto &cand : candidates) {
+        entry e;
+        uint64_t seen = 0;
+
+        e.e_value = &cand;
+        e.e_lower.reserve(cand.size());
+        e.e_chars = 0;
+        memset(e.e_pairs, 0, sizeof(e.e_pairs));
+        for (auto ch : cand) {
+            auto bit = char_bit(ch);
+
+            e.e_lower.push_back(tolower((unsigned char) ch));
+            // Every character seen so far comes before this one.
+            for (uint32_t prev = 0; prev < 64; prev++) {
+                if (seen & (1ULL << prev)) {
+                    auto pb = pair_bit(prev, bit);
+
+                    e.e_pairs[pb / 64] |= 1ULL << (pb % 64);
+                }
+            }
+            seen |= 1ULL << bit;
+        }
+        e.e_chars = seen;
+        this->fi_entries.emplace_back(std::move(e));
+    }
+}
+
+std::vector<fuzzy_index::hit> fuzzy_index::match(const std::string &query)
+{
+    uint64_t query_chars = 0;
+    uint64_t query_pairs[PAIR_WORDS] = {0, 0, 0, 0};
+
+    for (size_t lpc = 0; lpc < query.size(); lpc++) {
+        auto bit = char_bit(query[lpc]);
+
+        query_chars |= 1ULL << bit;
+        if (lpc > 0) {
+            auto pb = pair_bit(char_bit(query[lpc - 1]), bit);
+
+            query_pairs[pb / 64] |= 1ULL << (pb % 64);
+        }
+    }
+
+    // A candidate that did not match a prefix of the query cannot match
+    // the whole query.
+    bool narrow = this->fi_last_valid &&
+                  query.compare(0, this->fi_last_query.size(),
+                                this->fi_last_query) == 0;
+    std::vector<uint32_t> hits;
+    std::vector<hit> retval;
+    size_t count = narrow ? this->fi_last_hits.size() :
+                   this->fi_entries.size();
+
+    for (size_t lpc = 0; lpc < count; lpc++) {
+        uint32_t index = narrow ? this->fi_last_hits[lpc] : lpc;
+        const auto &e = this->fi_entries[index];
+
+        if ((e.e_chars & query_chars) != query_chars) {
+            continue;
+        }
+
+        bool pairs_present = true;
+
+        for (size_t word = 0; word < PAIR_WORDS; word++) {
+            if ((e.e_pairs[word] & query_pairs[word]) != query_pairs[word]) {
+                pairs_present = false;
+                break;
+            }
+        }
+        if (!pairs_present) {
+            continue;
+        }
+
+        int score;
+
+        if (!fts::fuzzy_match(query.c_str(), e.e_lower.c_str(), score)) {
+            continue;
+        }
+        hits.push_back(index);
+        retval.emplace_back(score, *e.e_value);
+    }
+
+    this->fi_last_query = query;
+    this->fi_last_hits = std::move(hits);
+    this->fi_last_valid = true;
+
+    return retval;
+}
@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file fuzzy_index.hh
+ */
+
+#ifndef lnav_fuzzy_index_hh
+#define lnav_fuzzy_index_hh
+
+#include <stdint.h>
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Finds the fuzzy matches for a query in a set of candidates.  A candidate
+ * can only match if it has all of the characters in the query and every
+ * pair of adjacent query characters appears in the same order, so those
+ * are checked with precomputed masks before the candidate is scored.  When
+ * the query grows by a keystroke, only the candidates that matched the
+ * previous query are checked.
+ *
+ * The index keeps pointers into the set, so it must be rebuilt if the set
+ * changes.
+ */
+class fuzzy_index {
+public:
+    using hit = std::pair<int, std::string>;
+
+    explicit fuzzy_index(const std::set<std::string> &candidates);
+
+    /**
+     * @param query The text to match, case is ignored.
+     * @return The score and value of the candidates that matched, in the
+     *   order of the set.
+     */
+    std::vector<hit> match(const std::string &query);
+
+private:
+    static const size_t PAIR_WORDS = 4;
+
+    struct entry {
+        const std::string *e_value;
+        std::string e_lower;
+        uint64_t e_chars;
+        uint64_t e_pairs[PAIR_WORDS];
+    };
+
+    static uint32_t char_bit(char ch);
+
+    static uint32_t pair_bit(uint32_t first, uint32_t second);
+
+    std::vector<entry> fi_entries;
+    /** The last query and the entries that matched it. */
+    std::string fi_last_query;
+    std::vector<uint32_t> fi_last_hits;
+    bool fi_last_valid{false};
+};
+
+#endif
@@ -41,11 +41,16 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 
+#include <algorithm>
+#include <chrono>
+
 #include "base/lnav_log.hh"
+#include "base/perf_counter.hh"
 #include "base/string_util.hh"
 #include "lnav_util.hh"
 #include "grep_proc.hh"
 #include "listview_curses.hh"
+#include "task_pool.hh"
 
 #include "time_T.hh"
 
@@ -53,7 +58,7 @@ using namespace std;
 
 template<typename LineType>
 grep_proc<LineType>::grep_proc(pcre *code, grep_proc_source<LineType> &gps)
-    : gp_pcre(code),
+    : gp_pcre(std::make_unique<pcrepp>(code)),
       gp_source(gps)
 {
     require(this->invariant());
@@ -103,6 +108,11 @@ void grep_proc<LineType>::start()
         return;
     }
 
+    if (this->gp_in_process) {
+        this->start_workers();
+        return;
+    }
+
     auto_pipe in_pipe(STDIN_FILENO);
     auto_pipe out_pipe(STDOUT_FILENO);
     auto_pipe err_pipe(STDERR_FILENO);
@@ -184,7 +194,7 @@ void grep_proc<LineType>::child_loop()
                 pcre_context_static<128> pc;
                 pcre_input pi(line_value);
 
-                while (this->gp_pcre.match(pc, pi)) {
+                while (this->gp_pcre->match(pc, pi)) {
                     pcre_context::iterator   pc_iter;
                     pcre_context::capture_t *m;
 
@@ -234,9 +244,484 @@ void grep_proc<LineType>::child_loop()
     }
 }
 
+template<typename LineType>
+void grep_proc<LineType>::start_workers()
+{
+    if (this->gp_worker_started) {
+        // A search is still going from an earlier request, so the new
+        // requests are just added to the end of the ones in progress.
+        this->gp_child_queue_size += this->gp_queue.size();
+        this->gp_worker_queue.insert(this->gp_worker_queue.end(),
+                                     this->gp_queue.begin(),
+                                     this->gp_queue.end());
+        this->gp_queue.clear();
+        this->feed_workers();
+        return;
+    }
+
+    if (this->gp_wake_pipe.open() < 0) {
+        throw error(errno);
+    }
+    log_perror(fcntl(this->gp_wake_pipe.read_end(), F_SETFL, O_NONBLOCK));
+    log_perror(fcntl(this->gp_wake_pipe.read_end(), F_SETFD, FD_CLOEXEC));
+    log_perror(fcntl(this->gp_wake_pipe.write_end(), F_SETFL, O_NONBLOCK));
+    log_perror(fcntl(this->gp_wake_pipe.write_end(), F_SETFD, FD_CLOEXEC));
+
+    size_t count = task_pool::singleton().get_worker_count();
+
+    if (this->gp_worker_count != 0) {
+        count = std::min(count, this->gp_worker_count);
+    }
+    count = std::max((size_t) 1, std::min(count, (size_t) MAX_WORKERS));
+
+    this->gp_worker_queue.swap(this->gp_queue);
+    this->gp_queue.clear();
+    this->gp_child_queue_size = this->gp_worker_queue.size();
+    this->gp_request_active = false;
+    this->gp_next_batch = 0;
+    this->gp_next_dispatch = 0;
+    this->gp_max_in_flight = count * MAX_BATCHES_PER_WORKER;
+    this->gp_worker_started = true;
+
+    this->feed_workers();
+}
+
+template<typename LineType>
+void grep_proc<LineType>::stop_workers()
+{
+    // The tasks in the pool refer to this object, so they all have to be
+    // handed back before it can go away.
+    this->drain_workers();
+    this->gp_worker_started = false;
+    this->gp_wake_pipe.close();
+}
+
+template<typename LineType>
+void grep_proc<LineType>::run_batch(batch *b)
+{
+    if (!this->gp_worker_skip) {
+        perf_timer search_timer(perf_stage_t::SEARCH);
+
+        if (b->b_next_span == 0) {
+            search_timer.add(b->b_spans.size(), b->b_chunk.length());
+        }
+        if (!this->match_batch(*b)) {
+            task_pool::singleton().submit(
+                [this, b]() { this->run_batch(b); },
+                task_pool::priority_t::INTERACTIVE);
+            return;
+        }
+    }
+
+    // The lock is held while writing to the pipe so that the pipe cannot be
+    // closed by stop_workers() once the batch has been seen.
+    std::lock_guard<std::mutex> lg(this->gp_completed_mutex);
+
+    this->gp_completed.push_back(b);
+    // The pipe is only used to wake up the poll() in the main loop, it does
+    // not matter if the write fails because it is full.
+    if (write(this->gp_wake_pipe.write_end(), "", 1) < 0) {
+    }
+}
+
+template<typename LineType>
+void grep_proc<LineType>::collect_batches()
+{
+    std::lock_guard<std::mutex> lg(this->gp_completed_mutex);
+
+    for (auto b : this->gp_completed) {
+        this->gp_reorder[b->b_sequence] = std::unique_ptr<batch>(b);
+    }
+    this->gp_completed.clear();
+}
+
+template<typename LineType>
+grep_proc<LineType> &grep_proc<LineType>::set_pattern(const std::string &pattern)
+{
+    static const unsigned long LITERAL_SAFE_OPTIONS =
+        PCRE_CASELESS | PCRE_UTF8 | PCRE_NO_UTF8_CHECK | PCRE_MULTILINE |
+        PCRE_DOTALL;
+
+    unsigned long options = this->gp_pcre->get_options();
+    std::string literal;
+
+    this->gp_literal.clear();
+    this->gp_required_literal = pcrepp::required_literal(pattern.c_str());
+    if ((options & ~LITERAL_SAFE_OPTIONS) != 0 ||
+        !pcrepp::literal_pattern(pattern.c_str(), literal)) {
+        return *this;
+    }
+
+    this->gp_literal_caseless = (options & PCRE_CASELESS) != 0;
+    if (this->gp_literal_caseless) {
+        for (auto ch : literal) {
+            // Non-ASCII characters, and the letters that have non-ASCII
+            // case variants in Unicode, are left to pcre.
+            if ((unsigned char) ch >= 0x80 ||
+                ((options & PCRE_UTF8) && strchr("kKsS", ch) != nullptr)) {
+                return *this;
+            }
+        }
+    }
+    this->gp_literal = literal;
+
+    return *this;
+}
+
+template<typename LineType>
+void grep_proc<LineType>::match_literal(batch &b)
+{
+    const char *needle = this->gp_literal.c_str();
+    size_t needle_len = this->gp_literal.length();
+    const char *data = b.b_chunk.data();
+    size_t data_len = b.b_chunk.length();
+    size_t off = 0;
+
+    // Scan the whole chunk in one go and then find the line for each hit.
+    while (off + needle_len <= data_len) {
+        const char *hit;
+
+        if (this->gp_literal_caseless) {
+            hit = find_caseless(&data[off], data_len - off,
+                                needle, needle_len);
+        }
+        else {
+            hit = (const char *) memmem(&data[off], data_len - off,
+                                        needle, needle_len);
+        }
+        if (hit == nullptr) {
+            break;
+        }
+
+        size_t hit_off = hit - data;
+        auto span_iter = std::upper_bound(
+            b.b_spans.begin(), b.b_spans.end(), hit_off,
+            [](size_t lhs, const std::pair<size_t, size_t> &rhs) {
+                return lhs < rhs.first;
+            });
+
+        if (span_iter == b.b_spans.begin() ||
+            hit_off + needle_len > (span_iter - 1)->second) {
+            // The hit is outside of a line value or crosses the end of one.
+            off = hit_off + 1;
+            continue;
+        }
+        --span_iter;
+
+        line_match lm;
+
+        lm.lm_index = span_iter - b.b_spans.begin();
+        lm.lm_range.mr_start = hit_off - span_iter->first;
+        lm.lm_range.mr_end = lm.lm_range.mr_start + needle_len;
+        lm.lm_capture_start = lm.lm_capture_end = b.b_captures.size();
+        b.b_matches.push_back(lm);
+        off = hit_off + needle_len;
+    }
+}
+
+template<typename LineType>
+bool grep_proc<LineType>::match_batch(batch &b)
+{
+    if (!this->gp_literal.empty()) {
+        // A scan for a literal is quick enough that it is not split up.
+        this->match_literal(b);
+        return true;
+    }
+
+    auto &pool = task_pool::singleton();
+
+    for (size_t &lpc = b.b_next_span; lpc < b.b_spans.size(); lpc++) {
+        if (lpc > 0 && (lpc % YIELD_CHECK_LINES) == 0 && pool.should_yield()) {
+            return false;
+        }
+
+        const auto &span = b.b_spans[lpc];
+        pcre_context_static<128> pc;
+        pcre_input pi(&b.b_chunk[span.first], 0, span.second - span.first);
+
+        while (this->gp_pcre->match(pc, pi)) {
+            pcre_context::capture_t *m = pc.all();
+            line_match lm;
+
+            lm.lm_index = lpc;
+            lm.lm_range = { m->c_begin, m->c_end };
+            lm.lm_capture_start = b.b_captures.size();
+            for (auto pc_iter = pc.begin(); pc_iter != pc.end(); pc_iter++) {
+                if (!pc_iter->is_valid()) {
+                    continue;
+                }
+                b.b_captures.push_back({ pc_iter->c_begin, pc_iter->c_end });
+            }
+            lm.lm_capture_end = b.b_captures.size();
+            b.b_matches.push_back(lm);
+        }
+    }
+
+    return true;
+}
+
+template<typename LineType>
+void grep_proc<LineType>::feed_workers()
+{
+    static const auto MAX_FEED_TIME = std::chrono::milliseconds(20);
+
+    auto feed_start = std::chrono::steady_clock::now();
+
+    while (this->gp_batches_in_flight < this->gp_max_in_flight &&
+           !this->gp_worker_queue.empty()) {
+        if (std::chrono::steady_clock::now() - feed_start > MAX_FEED_TIME) {
+            // Give the main loop a chance to run and make sure it comes
+            // back here right away to continue.
+            if (write(this->gp_wake_pipe.write_end(), "", 1) < 0) {
+            }
+            break;
+        }
+
+        LineType stop_line = this->gp_worker_queue.front().second;
+        std::unique_ptr<batch> b;
+
+        if (this->gp_free_batches.empty()) {
+            b = std::make_unique<batch>();
+        } else {
+            b = std::move(this->gp_free_batches.back());
+            this->gp_free_batches.pop_back();
+            b->clear();
+        }
+
+        if (!this->gp_request_active) {
+            this->gp_next_line = this->gp_source.grep_initial_line(
+                this->gp_worker_queue.front().first, this->gp_highest_line);
+            this->gp_request_active = true;
+        }
+
+        bool done = false;
+
+        while (!done && b->b_spans.size() < BATCH_SIZE &&
+               b->b_chunk.size() < MAX_BATCH_BYTES) {
+            LineType line = this->gp_next_line;
+
+            if (line == -1 || (stop_line != -1 && line >= stop_line)) {
+                done = true;
+                break;
+            }
+
+            if (this->gp_source.grep_line_is_cached(line)) {
+                this->gp_source.grep_next_line(this->gp_next_line);
+                continue;
+            }
+
+            if (!this->gp_required_literal.empty() &&
+                this->gp_source.grep_line_is_excluded(
+                    line, this->gp_required_literal)) {
+                this->gp_source.grep_next_line(this->gp_next_line);
+                continue;
+            }
+
+            size_t count = this->gp_source.grep_values_for_lines(
+                line,
+                stop_line,
+                BATCH_SIZE - b->b_spans.size(),
+                b->b_chunk,
+                b->b_spans);
+
+            if (count > 0) {
+                for (size_t lpc = 0; lpc < count; lpc++) {
+                    b->b_lines.push_back(this->gp_next_line);
+                    this->gp_source.grep_next_line(this->gp_next_line);
+                }
+                continue;
+            }
+
+            this->gp_line_value.clear();
+            done = !this->gp_source.grep_value_for_line(line,
+                                                        this->gp_line_value);
+            if (!done) {
+                size_t start = b->b_chunk.size();
+
+                b->b_chunk.append(this->gp_line_value);
+                b->b_spans.emplace_back(start, b->b_chunk.size());
+                b->b_chunk.push_back('\n');
+                b->b_lines.push_back(line);
+            }
+            this->gp_source.grep_next_line(this->gp_next_line);
+        }
+
+        if (done) {
+            b->b_end_of_request = true;
+            if (stop_line == -1) {
+                // When scanning to the end of the source, we need to remember
+                // the highest line that was seen so that the next request
+                // that continues from the end works properly.
+                b->b_set_highest = true;
+                b->b_highest_line = this->gp_next_line - LineType(1);
+            }
+            this->gp_worker_queue.pop_front();
+            this->gp_request_active = false;
+        }
+
+        batch *bp = b.release();
+
+        bp->b_sequence = this->gp_next_batch;
+        this->gp_next_batch += 1;
+        this->gp_batches_in_flight += 1;
+        task_pool::singleton().submit(
+            [this, bp]() { this->run_batch(bp); },
+            task_pool::priority_t::INTERACTIVE);
+    }
+}
+
+template<typename LineType>
+void grep_proc<LineType>::dispatch_batch(batch &b)
+{
+    for (const auto &lm : b.b_matches) {
+        LineType line = b.b_lines[lm.lm_index];
+
+        this->gp_last_line = line;
+        if (this->gp_sink == nullptr) {
+            continue;
+        }
+
+        this->gp_sink->grep_match(*this,
+                                  line,
+                                  lm.lm_range.mr_start,
+                                  lm.lm_range.mr_end);
+        for (size_t lpc = lm.lm_capture_start;
+             lpc < lm.lm_capture_end;
+             lpc++) {
+            const match_range &cap = b.b_captures[lpc];
+
+            if (cap.mr_start < 0) {
+                this->gp_sink->grep_capture(*this, line,
+                                            cap.mr_start, cap.mr_end,
+                                            nullptr);
+                continue;
+            }
+
+            std::string capture = b.b_chunk.substr(
+                b.b_spans[lm.lm_index].first + cap.mr_start,
+                cap.mr_end - cap.mr_start);
+
+            this->gp_sink->grep_capture(*this, line,
+                                        cap.mr_start, cap.mr_end,
+                                        &capture[0]);
+        }
+        this->gp_sink->grep_match_end(*this, line);
+    }
+
+    if (this->gp_sink != nullptr && !b.b_lines.empty()) {
+        this->gp_sink->grep_searched(*this,
+                                     b.b_lines.front(),
+                                     b.b_lines.back() + LineType(1));
+    }
+
+    if (b.b_end_of_request) {
+        if (b.b_set_highest) {
+            this->gp_highest_line = b.b_highest_line;
+        }
+        this->gp_child_queue_size -= 1;
+        if (this->gp_sink) {
+            this->gp_sink->grep_end(*this);
+        }
+    }
+}
+
+template<typename LineType>
+void grep_proc<LineType>::check_workers(const std::vector<struct pollfd> &pollfds)
+{
+    if (!this->gp_worker_started) {
+        return;
+    }
+
+    if (pollfd_ready(pollfds, this->gp_wake_pipe.read_end())) {
+        char buffer[128];
+
+        while (read(this->gp_wake_pipe.read_end(),
+                    buffer,
+                    sizeof(buffer)) > 0) {
+        }
+    }
+
+    this->collect_batches();
+    // The batches can finish in any order, but the sink has to see them in
+    // the order the lines were read.
+    while (!this->gp_reorder.empty() &&
+           this->gp_reorder.begin()->first == this->gp_next_dispatch) {
+        auto b = std::move(this->gp_reorder.begin()->second);
+
+        this->gp_reorder.erase(this->gp_reorder.begin());
+        this->gp_next_dispatch += 1;
+        this->gp_batches_in_flight -= 1;
+        this->dispatch_batch(*b);
+        this->gp_free_batches.push_back(std::move(b));
+    }
+
+    this->feed_workers();
+
+    if (this->gp_sink != nullptr) {
+        this->gp_sink->grep_end_batch(*this);
+    }
+
+    if (this->gp_worker_queue.empty() && this->gp_batches_in_flight == 0 &&
+        !this->gp_queue.empty()) {
+        this->start();
+    }
+}
+
+template<typename LineType>
+void grep_proc<LineType>::drain_workers()
+{
+    // The tasks skip the batches they have not started on yet, so this
+    // only waits for the ones that are being matched right now.
+    this->gp_worker_queue.clear();
+    this->gp_request_active = false;
+    this->gp_worker_skip = true;
+    while (this->gp_batches_in_flight > 0) {
+        bool popped = false;
+
+        this->collect_batches();
+        for (auto &pair : this->gp_reorder) {
+            this->gp_batches_in_flight -= 1;
+            this->gp_free_batches.push_back(std::move(pair.second));
+            popped = true;
+        }
+        this->gp_reorder.clear();
+        if (!popped) {
+            struct pollfd pfd = {this->gp_wake_pipe.read_end(), POLLIN, 0};
+            char buffer[128];
+
+            poll(&pfd, 1, 10);
+            while (read(this->gp_wake_pipe.read_end(),
+                        buffer,
+                        sizeof(buffer)) > 0) {
+            }
+        }
+    }
+    this->gp_worker_skip = false;
+    this->gp_next_batch = 0;
+    this->gp_next_dispatch = 0;
+
+    if (this->gp_sink) {
+        for (size_t lpc = 0; lpc < this->gp_child_queue_size; lpc++) {
+            this->gp_sink->grep_end(*this);
+        }
+    }
+    this->gp_child_queue_size = 0;
+}
+
 template<typename LineType>
 void grep_proc<LineType>::cleanup()
 {
+    if (this->gp_worker_started) {
+        this->stop_workers();
+
+        if (this->gp_sink) {
+            for (size_t lpc = 0; lpc < this->gp_child_queue_size; lpc++) {
+                this->gp_sink->grep_end(*this);
+            }
+        }
+        this->gp_child_queue_size = 0;
+    }
+
     if (this->gp_child != -1 && this->gp_child != 0) {
         int status = 0;
 
@@ -319,6 +804,8 @@ void grep_proc<LineType>::check_poll_set(const std::vector<struct pollfd> &pollf
 {
     require(this->invariant());
 
+    this->check_workers(pollfds);
+
     if (this->gp_err_pipe != -1 && pollfd_ready(pollfds, this->gp_err_pipe)) {
         char buffer[1024 + 1];
         ssize_t rc;
@@ -409,4 +896,24 @@ grep_proc<LineType> &grep_proc<LineType>::invalidate()
     return *this;
 }
 
+template<typename LineType>
+grep_proc<LineType> &grep_proc<LineType>::set_code(pcre *code,
+                                                   const std::string &pattern)
+{
+    if (this->gp_worker_started) {
+        if (this->gp_sink) {
+            for (size_t lpc = 0; lpc < this->gp_queue.size(); lpc++) {
+                this->gp_sink->grep_end(*this);
+            }
+        }
+        this->gp_queue.clear();
+        this->drain_workers();
+    } else {
+        this->invalidate();
+    }
+    this->gp_pcre = std::make_unique<pcrepp>(code);
+
+    return this->set_pattern(pattern);
+}
+
 template class grep_proc<vis_line_t>;
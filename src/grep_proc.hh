@@ -45,7 +45,11 @@
 #include <pcre/pcre.h>
 #endif
 
+#include <atomic>
 #include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <exception>
@@ -80,6 +84,29 @@ public:
      */
     virtual bool grep_value_for_line(LineType line, std::string &value_out) = 0;
 
+    /**
+     * Get the values for a run of consecutive lines at once, so that a
+     * source can hand over a block of its data without making a string for
+     * each line.  This is only used by in-process searches.
+     *
+     * @param line The first line to read.
+     * @param stop_line The line to stop at (exclusive) or -1.
+     * @param max_lines The maximum number of lines to read.
+     * @param chunk_out The line values are appended to this buffer, they
+     *   can be separated by other data, like line endings.
+     * @param spans_out The start and end offsets in chunk_out of each
+     *   line value are appended to this vector.
+     * @return The number of lines read or zero if the lines need to be read
+     *   one at a time with grep_value_for_line().
+     */
+    virtual size_t grep_values_for_lines(LineType line,
+                                         LineType stop_line,
+                                         size_t max_lines,
+                                         std::string &chunk_out,
+                                         std::vector<std::pair<size_t, size_t>> &spans_out) {
+        return 0;
+    };
+
     virtual LineType grep_initial_line(LineType start, LineType highest) {
         if (start == -1) {
             return highest;
@@ -91,6 +118,31 @@ public:
         line = line + LineType(1);
     };
 
+    /**
+     * Check if a line can be skipped because the result of searching it is
+     * already known.  This is only used by in-process searches.
+     *
+     * @param line The line number to check.
+     * @return True if the line does not need to be searched.
+     */
+    virtual bool grep_line_is_cached(LineType line) {
+        return false;
+    };
+
+    /**
+     * Check if a line can be skipped because it cannot contain a string
+     * that every match of the pattern has to contain.  This is only used by
+     * in-process searches.
+     *
+     * @param line The line number to check.
+     * @param literal The lowercase string that a match must contain.
+     * @return True if the line cannot match.
+     */
+    virtual bool grep_line_is_excluded(LineType line,
+                                       const std::string &literal) {
+        return false;
+    };
+
     grep_proc<LineType> *gps_proc;
 };
 
@@ -120,6 +172,14 @@ public:
     /** Called periodically between grep_begin and grep_end. */
     virtual void grep_end_batch(grep_proc<LineType> &gp) { };
 
+    /**
+     * Called after all of the matches for the lines in [start, stop) have
+     * been passed to the sink.  This is only used by in-process searches.
+     */
+    virtual void grep_searched(grep_proc<LineType> &gp,
+                               LineType start,
+                               LineType stop) { };
+
     /** Called at the end of a grep run. */
     virtual void grep_end(grep_proc<LineType> &gp) { };
 
@@ -161,6 +221,9 @@ public:
  * delegate and the results are sent to the grep_proc_sink delegate in the
  * parent process.
  *
+ * The search can also be done on the task pool in this process, see
+ * set_in_process().
+ *
  * Note: The "grep" executable is not actually used, instead we use the pcre(3)
  * library directly.
  */
@@ -204,6 +267,57 @@ public:
     /** @return The sink to send results to. */
     grep_proc_sink<LineType> *get_sink() { return this->gp_sink; };
 
+    /**
+     * Do the matching in the task pool instead of a forked child.  The
+     * lines are still read from the source in the thread that calls
+     * check_poll_set(), a batch at a time, so the source does not need to
+     * be thread-safe, but it should not block.  Each batch is matched by an
+     * interactive task and the matches are passed back in binary form and
+     * delivered to the sink in line order.
+     */
+    grep_proc &set_in_process(bool value)
+    {
+        this->gp_in_process = value;
+        return *this;
+    };
+
+    /**
+     * Give the text of the regular expression so that searches for plain
+     * strings can be done with a substring scan instead of pcre.
+     *
+     * @param pattern The pattern the code was compiled from.
+     */
+    grep_proc &set_pattern(const std::string &pattern);
+
+    /**
+     * Switch to a new pattern.  The requests that are queued or being
+     * searched are dropped, like with invalidate(), but an in-process search
+     * keeps going with the requests that follow.
+     *
+     * @param code The pcre code to run over the lines of input.
+     * @param pattern The pattern the code was compiled from.
+     */
+    grep_proc &set_code(pcre *code, const std::string &pattern);
+
+    /** @return True if all of the requests have been searched. */
+    bool is_idle() const
+    {
+        return this->gp_queue.empty() &&
+               !this->gp_child_started &&
+               this->gp_worker_queue.empty() &&
+               this->gp_batches_in_flight == 0;
+    };
+
+    /**
+     * @param count The number of task pool workers an in-process search
+     *   can keep busy or zero to use all of them.
+     */
+    grep_proc &set_worker_count(size_t count)
+    {
+        this->gp_worker_count = count;
+        return *this;
+    };
+
     /**
      * Queue a request to search the input between the given line numbers.
      *
@@ -227,6 +341,8 @@ public:
 
     /**
      * Start the search requests that have been queued up with queue_request.
+     * For an in-process search, the lines are matched in batches on the
+     * task pool until the object is invalidated.
      */
     void start();
 
@@ -246,6 +362,13 @@ public:
                     0
             });
         }
+        if (this->gp_wake_pipe.read_end() != -1) {
+            pollfds.push_back((struct pollfd) {
+                    this->gp_wake_pipe.read_end(),
+                    POLLIN,
+                    0
+            });
+        }
     };
 
     /**
@@ -271,12 +394,102 @@ public:
     };
 
 protected:
+    static const size_t BATCH_SIZE = 1024;
+    static const size_t MAX_BATCHES_PER_WORKER = 8;
+    /**
+     * A batch is sent off once its text gets this large, so that a run of
+     * very long lines does not pile up in memory waiting for BATCH_SIZE.
+     */
+    static const size_t MAX_BATCH_BYTES = 8 * 1024 * 1024;
+    static const size_t MAX_WORKERS = 64;
+    /** The number of lines matched between checks of should_yield(). */
+    static const size_t YIELD_CHECK_LINES = 64;
+
+    struct match_range {
+        int mr_start;
+        int mr_end;
+    };
+
+    struct line_match {
+        size_t lm_index;          /*< The index of the line in the batch. */
+        match_range lm_range;
+        size_t lm_capture_start;  /*< The first capture in b_captures. */
+        size_t lm_capture_end;
+    };
+
+    /**
+     * A group of lines matched by a task in the pool and the matches found
+     * in them.  Batches are recycled to reuse the buffers.
+     */
+    struct batch {
+        void clear() {
+            this->b_lines.clear();
+            this->b_chunk.clear();
+            this->b_spans.clear();
+            this->b_matches.clear();
+            this->b_captures.clear();
+            this->b_end_of_request = false;
+            this->b_set_highest = false;
+            this->b_next_span = 0;
+        };
+
+        std::vector<LineType> b_lines;
+        std::string b_chunk;           /*< The values of all the lines. */
+        std::vector<std::pair<size_t, size_t>> b_spans; /*< Line extents. */
+        std::vector<line_match> b_matches;
+        std::vector<match_range> b_captures;
+        bool b_end_of_request{false};  /*< Last batch for a request. */
+        bool b_set_highest{false};     /*< b_highest_line is valid. */
+        LineType b_highest_line{0};
+        size_t b_sequence{0};          /*< The order to dispatch in. */
+        size_t b_next_span{0};         /*< Where to resume matching. */
+    };
 
     /**
      * Dispatch a line received from the child.
      */
     void dispatch_line(char *line);
 
+    void start_workers();
+
+    void stop_workers();
+
+    /**
+     * Drop the requests given to the task pool and wait for it to hand back
+     * the batches it was working on.
+     */
+    void drain_workers();
+
+    /**
+     * The task that matches a batch in the pool.  If a more urgent task is
+     * waiting, the rest of the batch is submitted again as a new task.
+     */
+    void run_batch(batch *b);
+
+    /**
+     * Match the lines in the batch, starting from b_next_span.
+     *
+     * @return False if matching stopped early because the pool asked the
+     * task to yield.
+     */
+    bool match_batch(batch &b);
+
+    /** Move the batches handed back by the pool into gp_reorder. */
+    void collect_batches();
+
+    void match_literal(batch &b);
+
+    /**
+     * Read lines from the source and submit them to the pool until the
+     * maximum number of batches are in flight, there are no more requests,
+     * or this call has taken too long.
+     */
+    void feed_workers();
+
+    void dispatch_batch(batch &b);
+
+    void check_workers(const std::vector<struct pollfd> &pollfds);
+
     /**
      * Free any resources used by the object and make sure the child has been
      * terminated.
@@ -297,7 +510,7 @@ protected:
                               int *matches,
                               int count);
 
-    pcrepp             gp_pcre;
+    std::unique_ptr<pcrepp> gp_pcre;
     grep_proc_source<LineType> &gp_source;        /*< The data source delegate. */
 
     auto_fd     gp_err_pipe;             /*< Standard error from the child. */
@@ -325,5 +538,27 @@ protected:
                                          */
     grep_proc_sink<LineType> *gp_sink{nullptr};         /*< The sink delegate. */
     grep_proc_control *gp_control{nullptr};      /*< The control delegate. */
+
+    bool gp_in_process{false};
+    size_t gp_worker_count{0};
+    std::string gp_literal;             /*< The pattern, if it is a literal. */
+    bool gp_literal_caseless{false};
+    /*< A lowercase string every match must contain, used to skip lines. */
+    std::string gp_required_literal;
+    bool gp_worker_started{false};
+    size_t gp_max_in_flight{0};
+    std::atomic<bool> gp_worker_skip{false}; /*< Skip matching while draining. */
+    auto_pipe gp_wake_pipe;             /*< Written when a batch is done. */
+    std::mutex gp_completed_mutex;
+    std::vector<batch *> gp_completed;  /*< Handed back by the pool tasks. */
+    std::map<size_t, std::unique_ptr<batch>> gp_reorder;
+    std::vector<std::unique_ptr<batch>> gp_free_batches;
+    size_t gp_batches_in_flight{0};
+    size_t gp_next_batch{0};            /*< Sequence number of the next batch. */
+    size_t gp_next_dispatch{0};         /*< Next batch to send to the sink. */
+    std::deque<std::pair<LineType, LineType> > gp_worker_queue;
+    bool gp_request_active{false};      /*< gp_next_line is valid. */
+    LineType gp_next_line{0};
+    std::string gp_line_value;
 };
 #endif
@@ -11,7 +11,7 @@ highlighter::highlighter(const highlighter &other)
     this->h_role = other.h_role;
     this->h_code = other.h_code;
     pcre_refcount(this->h_code, 1);
-    this->study();
+    this->h_code_extra = nullptr;
     this->h_attrs = other.h_attrs;
     this->h_text_format = other.h_text_format;
     this->h_format_name = other.h_format_name;
@@ -25,6 +25,9 @@ highlighter &highlighter::operator=(const highlighter &other)
         this->h_code = nullptr;
     }
     free(this->h_code_extra);
+    this->h_code_extra = nullptr;
+    this->h_studied = false;
+    this->h_limit_hits = 0;
 
     this->h_pattern = other.h_pattern;
     this->h_fg = other.h_fg;
@@ -32,7 +35,6 @@ highlighter &highlighter::operator=(const highlighter &other)
     this->h_role = other.h_role;
     this->h_code = other.h_code;
     pcre_refcount(this->h_code, 1);
-    this->study();
     this->h_format_name = other.h_format_name;
     this->h_attrs = other.h_attrs;
     this->h_text_format = other.h_text_format;
@@ -41,10 +43,12 @@ highlighter &highlighter::operator=(const highlighter &other)
     return *this;
 }
 
-void highlighter::study()
+void highlighter::study() const
 {
     const char *errptr;
 
+    this->h_studied = true;
+
     this->h_code_extra = pcre_study(this->h_code, 0, &errptr);
     if (!this->h_code_extra && errptr) {
         log_error("pcre_study error: %s", errptr);
@@ -69,6 +73,12 @@ void highlighter::annotate(attr_line_t &al, int start) const
     const char *line_start = &(str.c_str()[start]);
     size_t re_end;
 
+    if (this->is_over_budget()) {
+        return;
+    }
+    if (!this->h_studied) {
+        this->study();
+    }
     if ((str.length() - start) > 8192)
         re_end = 8192;
     else
@@ -126,6 +136,7 @@ void highlighter::annotate(attr_line_t &al, int start) const
             }
         }
         else {
+            pcrepp::record_limit_hit(rc, this->h_limit_hits);
             off = str.size();
         }
     }
@@ -45,10 +45,12 @@ struct highlighter {
           h_text_format(text_format_t::TF_UNKNOWN) { };
 
     explicit highlighter(pcre *code)
-        : h_code(code), h_attrs(-1), h_text_format(text_format_t::TF_UNKNOWN)
+        : h_code(code),
+          h_code_extra(nullptr),
+          h_attrs(-1),
+          h_text_format(text_format_t::TF_UNKNOWN)
     {
         pcre_refcount(this->h_code, 1);
-        this->study();
     };
 
     highlighter(const highlighter &other);
@@ -63,7 +65,11 @@ struct highlighter {
         free(this->h_code_extra);
     };
 
-    void study();
+    /**
+     * Study the pattern, which is put off until the first annotate() since
+     * many highlighters are copied around, but never used.
+     */
+    void study() const;
 
     highlighter &with_pattern(const std::string &pattern) {
         this->h_pattern = pattern;
@@ -116,12 +122,23 @@ struct highlighter {
 
     void annotate(attr_line_t &al, int start) const;
 
+    /**
+     * @return True if too many matches were stopped by the match limits, in
+     *   which case annotate() does nothing.
+     */
+    bool is_over_budget() const {
+        return this->h_limit_hits.load(std::memory_order_relaxed) >=
+               pcrepp::LIMIT_HITS_BUDGET;
+    };
+
     std::string h_pattern;
     view_colors::role_t h_role{view_colors::VCR_NONE};
     rgb_color h_fg;
     rgb_color h_bg;
     pcre *h_code;
-    pcre_extra *h_code_extra;
+    mutable pcre_extra *h_code_extra;
+    mutable bool h_studied{false};
+    mutable std::atomic<uint32_t> h_limit_hits{0};
     int h_attrs;
     text_format_t h_text_format;
     intern_string_t h_format_name;
@@ -29,6 +29,8 @@
 
 #include "config.h"
 
+#include <algorithm>
+
 #include "lnav_util.hh"
 #include "hist_source.hh"
 
@@ -64,6 +66,116 @@ int hist_source2::row_for_time(struct timeval tv_bucket)
     return retval;
 }
 
+int64_t hist_source2::bucket_index_for_time(time_t row)
+{
+    int64_t low = 0, high = this->hs_line_count;
+
+    while (low < high) {
+        int64_t mid = low + (high - low) / 2;
+
+        if (this->find_bucket(mid).b_time < row) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low < this->hs_line_count && this->find_bucket(low).b_time == row) {
+        return low;
+    }
+
+    return -1;
+}
+
+void hist_source2::update_value(time_t row, hist_type_t htype, double delta)
+{
+    int64_t index = this->bucket_index_for_time(
+        rounddown(row, this->hs_time_slice));
+
+    if (index == -1) {
+        return;
+    }
+
+    this->find_bucket(index).b_values[htype].hv_value += delta;
+}
+
+void hist_source2::clear_values(hist_type_t htype)
+{
+    for (int64_t lpc = 0; lpc < this->hs_line_count; lpc++) {
+        this->find_bucket(lpc).b_values[htype].hv_value = 0;
+    }
+}
+
+std::vector<hist_source2::bucket_t> hist_source2::copy_buckets()
+{
+    std::vector<bucket_t> retval;
+
+    retval.reserve(this->hs_line_count);
+    for (int64_t lpc = 0; lpc < this->hs_line_count; lpc++) {
+        retval.emplace_back(this->find_bucket(lpc));
+    }
+
+    return retval;
+}
+
+void hist_source2::add_buckets(const std::vector<bucket_t> &buckets)
+{
+    for (const auto &bucket : buckets) {
+        for (int lpc = 0; lpc < HT__MAX; lpc++) {
+            this->add_value(bucket.b_time, (hist_type_t) lpc,
+                            bucket.b_values[lpc].hv_value);
+        }
+    }
+}
+
+bool hist_source2::rescale(int64_t slice)
+{
+    if (slice == this->hs_time_slice) {
+        return true;
+    }
+
+    if (slice % this->hs_time_slice != 0) {
+        this->hs_time_slice = slice;
+        return false;
+    }
+
+    auto buckets = this->copy_buckets();
+
+    this->clear();
+    this->hs_time_slice = slice;
+    this->add_buckets(buckets);
+
+    return true;
+}
+
+bool hist_source2::merge_from(hist_source2 &other, int64_t slice)
+{
+    if (slice % other.hs_time_slice != 0) {
+        return false;
+    }
+
+    this->clear();
+    this->hs_time_slice = slice;
+    this->add_buckets(other.copy_buckets());
+
+    return true;
+}
+
+void hist_source2::rebuild_chart()
+{
+    auto buckets = this->copy_buckets();
+    auto new_end = std::remove_if(
+        buckets.begin(), buckets.end(), [](const bucket_t &bucket) {
+            return bucket.b_values[HT_NORMAL].hv_value == 0 &&
+                   bucket.b_values[HT_WARNING].hv_value == 0 &&
+                   bucket.b_values[HT_ERROR].hv_value == 0;
+        });
+
+    buckets.erase(new_end, buckets.end());
+    this->clear();
+    this->add_buckets(buckets);
+}
+
 void hist_source2::text_value_for_line(textview_curses &tc, int row,
                                        std::string &value_out,
                                        text_sub_source::line_flags_t flags)
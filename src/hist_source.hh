@@ -385,6 +385,41 @@ public:
         bucket.b_values[htype].hv_value += value;
     };
 
+    /**
+     * Change the value in the bucket that holds the given time.  Nothing is
+     * done if no value has been added for that bucket.
+     */
+    void update_value(time_t row, hist_type_t htype, double delta);
+
+    /**
+     * Set the values of the given type to zero in all of the buckets.
+     */
+    void clear_values(hist_type_t htype);
+
+    /**
+     * Change the time slice, merging the existing buckets if the new slice
+     * is a multiple of the current one.
+     *
+     * @return False if the buckets could not be merged and the values need
+     *   to be added again.
+     */
+    bool rescale(int64_t slice);
+
+    /**
+     * Replace the buckets with the ones from another source, merged into
+     * the given time slice.
+     *
+     * @return False if the slice is not a multiple of the other source's
+     *   slice and nothing was changed.
+     */
+    bool merge_from(hist_source2 &other, int64_t slice);
+
+    /**
+     * Drop the buckets that no longer count any lines and recompute the
+     * chart's range, for use after values were updated.
+     */
+    void rebuild_chart();
+
     void end_of_row() {
         if (this->hs_last_bucket >= 0) {
             bucket_t &last_bucket = this->find_bucket(this->hs_last_bucket);
@@ -444,6 +479,15 @@ private:
         bucket_t bb_buckets[BLOCK_SIZE];
     };
 
+    std::vector<bucket_t> copy_buckets();
+
+    void add_buckets(const std::vector<bucket_t> &buckets);
+
+    /**
+     * @return The index of the bucket with the given rounded time or -1.
+     */
+    int64_t bucket_index_for_time(time_t row);
+
     bucket_t &find_bucket(int64_t index) {
         struct bucket_block &bb = this->hs_blocks[index / BLOCK_SIZE];
         unsigned int intra_block_index = index % BLOCK_SIZE;
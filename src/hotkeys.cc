@@ -626,6 +626,20 @@ void handle_paging_key(int ch)
                 if (!opid_range.is_valid()) {
                     alerter::singleton().chime();
                     lnav_data.ld_rl_view->set_value("Log message does not contain an opid");
+                } else if (lss->has_opid_index()) {
+                    string opid_str = start_helper.to_string(opid_range);
+                    auto next_line = lss->find_opid(
+                        opid_str, start_helper.lh_current_line, ch == 'o');
+
+                    if (next_line) {
+                        lnav_data.ld_rl_view->set_value("");
+                        tc->set_top(next_line.value());
+                    }
+                    else {
+                        lnav_data.ld_rl_view->set_value(
+                                "No more messages found with opid: " + opid_str);
+                        alerter::singleton().chime();
+                    }
                 } else {
                     unsigned int opid_hash = start_line.get_opid();
                     logline_helper next_helper(*lss);
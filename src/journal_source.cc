@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file journal_source.cc
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "base/lnav_log.hh"
+#include "journal_source.hh"
+
+using namespace std;
+
+static const char *JOURNAL_PREFIX = "journal:";
+
+/**
+ * The fields used by the journald_json_log format, the "__" fields, like
+ * the timestamps, are always included by journalctl.
+ */
+static const char *JOURNAL_FIELDS =
+    "MESSAGE,PRIORITY,_SYSTEMD_UNIT,SYSLOG_IDENTIFIER,_PID";
+
+bool is_journal_path(const char *fn)
+{
+    return strncmp(fn, JOURNAL_PREFIX, strlen(JOURNAL_PREFIX)) == 0;
+}
+
+Result<journal_reader_proc, std::string> start_journal_reader(
+    const std::string &journal_path)
+{
+    const char *journalctl = getenv("LNAV_JOURNALCTL");
+
+    if (journalctl == nullptr || journalctl[0] == '\0') {
+        journalctl = "journalctl";
+    }
+
+    vector<string> extra_args;
+    auto extra = journal_path.substr(strlen(JOURNAL_PREFIX));
+    size_t start = 0;
+
+    while (start < extra.size()) {
+        auto end = extra.find(' ', start);
+
+        if (end == string::npos) {
+            end = extra.size();
+        }
+        if (end > start) {
+            extra_args.emplace_back(extra.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+
+    auto_pipe out_pipe(STDOUT_FILENO);
+
+    if (out_pipe.open() == -1) {
+        return Err(string("unable to create pipe -- ") + strerror(errno));
+    }
+
+    pid_t child_pid = fork();
+
+    out_pipe.after_fork(child_pid);
+
+    switch (child_pid) {
+        case -1:
+            return Err(string("unable to fork journalctl -- ") +
+                       strerror(errno));
+        case 0: {
+            vector<const char *> args = {
+                journalctl,
+                "--no-pager",
+                "--follow",
+                "--no-tail",
+                "--output=json",
+                "--output-fields",
+                JOURNAL_FIELDS,
+            };
+
+            for (const auto &arg : extra_args) {
+                args.push_back(arg.c_str());
+            }
+            args.push_back(nullptr);
+
+            // Any errors from journalctl end up in the file so they can be
+            // seen.
+            dup2(STDOUT_FILENO, STDERR_FILENO);
+            execvp(args[0], (char *const *) args.data());
+            fprintf(stderr,
+                    "error: could not exec %s -- %s\n",
+                    args[0],
+                    strerror(errno));
+            _exit(EXIT_FAILURE);
+        }
+        default:
+            break;
+    }
+
+    log_info("started %s with pid %d for %s",
+             journalctl, child_pid, journal_path.c_str());
+
+    journal_reader_proc retval;
+
+    retval.jrp_output = std::move(out_pipe.read_end());
+    retval.jrp_output.close_on_exec();
+    retval.jrp_child = child_pid;
+
+    return Ok(std::move(retval));
+}
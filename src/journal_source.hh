@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file journal_source.hh
+ */
+
+#ifndef lnav_journal_source_hh
+#define lnav_journal_source_hh
+
+#include <sys/types.h>
+
+#include <string>
+
+#include "auto_fd.hh"
+#include "base/result.h"
+
+/**
+ * @param fn The name of a file given on the command-line.
+ * @return True if the name refers to the systemd journal, for example,
+ *   "journal:" or "journal:-u sshd --since yesterday".
+ */
+bool is_journal_path(const char *fn);
+
+/**
+ * The journalctl process that is feeding the journal's entries to a file.
+ */
+struct journal_reader_proc {
+    /** The pipe that the JSON entries are read from. */
+    auto_fd jrp_output;
+    /** The pid of the journalctl process. */
+    pid_t jrp_child{-1};
+};
+
+/**
+ * Start journalctl to follow the journal.  Only the fields that are shown
+ * by the "journald_json_log" format are asked for, so there is much less
+ * JSON to write and parse than with a plain "journalctl -o json".  The
+ * journalctl command can be changed with the LNAV_JOURNALCTL environment
+ * variable.
+ *
+ * @param journal_path The "journal:" name, anything after the colon is
+ *   split on spaces and passed to journalctl as extra arguments.
+ * @return The running journalctl or an error message.
+ */
+Result<journal_reader_proc, std::string> start_journal_reader(
+    const std::string &journal_path);
+
+#endif
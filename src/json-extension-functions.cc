@@ -42,6 +42,7 @@
 
 #include "yajlpp/yajlpp.hh"
 #include "yajlpp/json_op.hh"
+#include "yajlpp/json_fast_parse.hh"
 #include "mapbox/variant.hpp"
 #include "vtab_module.hh"
 
@@ -106,7 +107,6 @@ static bool json_contains(const char *json_in, sqlite3_value *value)
     contains_userdata cu;
 
     memset(&cb, 0, sizeof(cb));
-    handle = yajl_alloc(&cb, nullptr, &cu);
 
     switch (sqlite3_value_type(value)) {
         case SQLITE3_TEXT:
@@ -119,6 +119,12 @@ static bool json_contains(const char *json_in, sqlite3_value *value)
             break;
     }
 
+    if (json_fast_parse(cb, &cu, json_in, strlen(json_in)) == JFS_OK) {
+        return cu.cu_result;
+    }
+    cu.cu_result = false;
+
+    handle = yajl_alloc(&cb, nullptr, &cu);
     if (yajl_parse(handle.in(), (const unsigned char *) json_in, strlen(json_in)) != yajl_status_ok ||
         yajl_complete_parse(handle.in()) != yajl_status_ok) {
         throw yajlpp_error(handle.in(), json_in, strlen(json_in));
@@ -174,27 +180,32 @@ static int gen_handle_string(void *ctx, const unsigned char * stringVal, size_t
     return sjo->jo_ptr_error_code == yajl_gen_status_ok;
 }
 
-static void sql_jget(sqlite3_context *context,
-                     int argc, sqlite3_value **argv)
+static void jget_canceled(sqlite3_context *context,
+                          int argc, sqlite3_value **argv,
+                          const sql_json_op &jo)
 {
-    if (argc < 2) {
-        sqlite3_result_error(context, "expecting JSON value and pointer", -1);
-        return;
+    if (jo.jo_ptr.jp_state == json_ptr::MS_ERR_INVALID_ESCAPE) {
+        sqlite3_result_error(context, jo.jo_ptr.error_msg().c_str(), -1);
     }
-
-    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+    else {
         null_or_default(context, argc, argv);
-        return;
-    }
-
-    const char *json_in = (const char *)sqlite3_value_text(argv[0]);
-
-    if (sqlite3_value_type(argv[1]) == SQLITE_NULL) {
-        sqlite3_result_text(context, json_in, -1, SQLITE_TRANSIENT);
-        return;
     }
+}
 
-    const char *ptr_in = (const char *)sqlite3_value_text(argv[1]);
+/**
+ * Look up the pointer in the JSON value and set the result.
+ *
+ * @param fast Use json_fast_parse() instead of yajl.
+ * @return False if the fast parser gave up, in which case no result was
+ *   set and the lookup needs to be done again with yajl.
+ */
+static bool jget_with_parser(sqlite3_context *context,
+                             int argc, sqlite3_value **argv,
+                             const char *json_in,
+                             size_t json_len,
+                             const char *ptr_in,
+                             bool fast)
+{
     json_ptr jp(ptr_in);
     sql_json_op jo(jp);
     auto_mem<yajl_handle_t> handle(yajl_free);
@@ -209,61 +220,218 @@ static void sql_jget(sqlite3_context *context,
     jo.jo_ptr_callbacks.yajl_string = gen_handle_string;
     jo.jo_ptr_data = gen.get_handle();
 
-    handle.reset(yajl_alloc(&json_op::ptr_callbacks, nullptr, &jo));
-    switch (yajl_parse(handle.in(), (const unsigned char *)json_in, strlen(json_in))) {
-    case yajl_status_error:
-        err = yajl_get_error(handle.in(), 0, (const unsigned char *)json_in, strlen(json_in));
-        sqlite3_result_error(context, (const char *)err, -1);
-        return;
-    case yajl_status_client_canceled:
-        if (jo.jo_ptr.jp_state == json_ptr::MS_ERR_INVALID_ESCAPE) {
-            sqlite3_result_error(context, jo.jo_ptr.error_msg().c_str(), -1);
-        }
-        else {
-            null_or_default(context, argc, argv);
+    if (fast) {
+        switch (json_fast_parse(json_op::ptr_callbacks, &jo,
+                                json_in, json_len)) {
+            case JFS_OK:
+                break;
+            case JFS_CANCELED:
+                jget_canceled(context, argc, argv, jo);
+                return true;
+            case JFS_FALLBACK:
+                return false;
         }
-        return;
-    default:
-        break;
     }
-
-    switch (yajl_complete_parse(handle.in())) {
-    case yajl_status_error:
-        err = yajl_get_error(handle.in(), 0, (const unsigned char *)json_in, strlen(json_in));
-        sqlite3_result_error(context, (const char *)err, -1);
-        return;
-    case yajl_status_client_canceled:
-        if (jo.jo_ptr.jp_state == json_ptr::MS_ERR_INVALID_ESCAPE) {
-            sqlite3_result_error(context, jo.jo_ptr.error_msg().c_str(), -1);
+    else {
+        handle.reset(yajl_alloc(&json_op::ptr_callbacks, nullptr, &jo));
+        switch (yajl_parse(handle.in(), (const unsigned char *)json_in, json_len)) {
+        case yajl_status_error:
+            err = yajl_get_error(handle.in(), 0, (const unsigned char *)json_in, json_len);
+            sqlite3_result_error(context, (const char *)err, -1);
+            return true;
+        case yajl_status_client_canceled:
+            jget_canceled(context, argc, argv, jo);
+            return true;
+        default:
+            break;
         }
-        else {
-            null_or_default(context, argc, argv);
+
+        switch (yajl_complete_parse(handle.in())) {
+        case yajl_status_error:
+            err = yajl_get_error(handle.in(), 0, (const unsigned char *)json_in, json_len);
+            sqlite3_result_error(context, (const char *)err, -1);
+            return true;
+        case yajl_status_client_canceled:
+            jget_canceled(context, argc, argv, jo);
+            return true;
+        default:
+            break;
         }
-        return;
-    default:
-        break;
     }
 
     switch (jo.sjo_type) {
     case SQLITE3_TEXT:
         sqlite3_result_text(context, jo.sjo_str.c_str(), jo.sjo_str.size(), SQLITE_TRANSIENT);
-        return;
+        return true;
     case SQLITE_NULL:
         sqlite3_result_null(context);
-        return;
+        return true;
     case SQLITE_INTEGER:
         sqlite3_result_int(context, jo.sjo_int);
-        return;
+        return true;
     }
 
     string_fragment result = gen.to_string_fragment();
 
     if (result.empty()) {
         null_or_default(context, argc, argv);
-        return;
+        return true;
     }
 
     sqlite3_result_text(context, result.data(), result.length(), SQLITE_TRANSIENT);
+    return true;
+}
+
+static int copy_string_value(void *ctx,
+                             const unsigned char *stringVal,
+                             size_t len)
+{
+    string *str = (string *)ctx;
+
+    str->assign((const char *)stringVal, len);
+
+    return 1;
+}
+
+/**
+ * Look up a compiled pointer in the JSON value and set the result.  Only
+ * the parts of the value that lead to the target are looked at.
+ *
+ * @return False if no result was set and the lookup needs to be done by
+ *   jget_with_parser().
+ */
+static bool jget_with_path(sqlite3_context *context,
+                           int argc, sqlite3_value **argv,
+                           const json_fast_path &path,
+                           const char *json_in,
+                           size_t json_len)
+{
+    static const json_ptr EMPTY_PTR("");
+
+    const char *value;
+    size_t value_len;
+
+    if (json_fast_find(path, json_in, json_len, value, value_len) !=
+        JFS_OK) {
+        return false;
+    }
+
+    if (value == nullptr) {
+        null_or_default(context, argc, argv);
+        return true;
+    }
+
+    switch (value[0]) {
+        case '"': {
+            yajl_callbacks string_callbacks = {};
+            string str;
+
+            string_callbacks.yajl_string = copy_string_value;
+            if (json_fast_parse(string_callbacks, &str,
+                                value, value_len) != JFS_OK) {
+                return false;
+            }
+            sqlite3_result_text(context, str.c_str(), str.size(),
+                                SQLITE_TRANSIENT);
+            return true;
+        }
+        case 't':
+            sqlite3_result_int(context, 1);
+            return true;
+        case 'f':
+            sqlite3_result_int(context, 0);
+            return true;
+        case 'n':
+            sqlite3_result_null(context);
+            return true;
+        case '{':
+        case '[': {
+            json_op jo(EMPTY_PTR);
+            yajlpp_gen gen;
+
+            yajl_gen_config(gen, yajl_gen_beautify, false);
+            jo.jo_ptr_data = gen.get_handle();
+            if (json_fast_parse(json_op::gen_callbacks, &jo,
+                                value, value_len) != JFS_OK) {
+                return false;
+            }
+
+            string_fragment result = gen.to_string_fragment();
+
+            sqlite3_result_text(context, result.data(), result.length(),
+                                SQLITE_TRANSIENT);
+            return true;
+        }
+        default:
+            // Numbers are passed through as they were written.
+            sqlite3_result_text(context, value, value_len, SQLITE_TRANSIENT);
+            return true;
+    }
+}
+
+/**
+ * The compiled form of a jget() pointer argument, kept with the statement
+ * by sqlite3_set_auxdata() so that it is only compiled once.
+ */
+struct jget_path_cache {
+    bool jpc_valid{false};
+    json_fast_path jpc_path;
+};
+
+static void free_jget_path_cache(void *data)
+{
+    delete (jget_path_cache *) data;
+}
+
+static void sql_jget(sqlite3_context *context,
+                     int argc, sqlite3_value **argv)
+{
+    if (argc < 2) {
+        sqlite3_result_error(context, "expecting JSON value and pointer", -1);
+        return;
+    }
+
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+        null_or_default(context, argc, argv);
+        return;
+    }
+
+    const char *json_in = (const char *)sqlite3_value_text(argv[0]);
+
+    if (sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+        sqlite3_result_text(context, json_in, -1, SQLITE_TRANSIENT);
+        return;
+    }
+
+    const char *ptr_in = (const char *)sqlite3_value_text(argv[1]);
+    size_t json_len = strlen(json_in);
+    auto *jpc = (jget_path_cache *) sqlite3_get_auxdata(context, 1);
+    jget_path_cache local_jpc;
+
+    if (jpc == nullptr) {
+        jpc = new jget_path_cache();
+        jpc->jpc_valid = jpc->jpc_path.compile(ptr_in);
+        sqlite3_set_auxdata(context, 1, jpc, free_jget_path_cache);
+        // The cache might have been freed already if the pointer is not a
+        // constant, so fetch it again.
+        jpc = (jget_path_cache *) sqlite3_get_auxdata(context, 1);
+        if (jpc == nullptr) {
+            local_jpc.jpc_valid = local_jpc.jpc_path.compile(ptr_in);
+            jpc = &local_jpc;
+        }
+    }
+
+    if (jpc->jpc_valid &&
+        jget_with_path(context, argc, argv, jpc->jpc_path,
+                       json_in, json_len)) {
+        return;
+    }
+
+    if (!jget_with_parser(context, argc, argv, json_in, json_len, ptr_in,
+                          true)) {
+        jget_with_parser(context, argc, argv, json_in, json_len, ptr_in,
+                         false);
+    }
 }
 
 struct json_agg_context {
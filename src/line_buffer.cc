@@ -36,19 +36,20 @@
 #include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #ifdef HAVE_BZLIB_H
 #include <bzlib.h>
 #endif
 
+#include <mutex>
 #include <set>
-
-#ifdef HAVE_X86INTRIN_H
-#include "simdutf8check.h"
-#endif
+#include <vector>
 
 #include "base/is_utf8.hh"
 #include "lnav_util.hh"
+#include "lnav_config.hh"
 #include "line_buffer.hh"
 #include "fmtlib/fmt/format.h"
 
@@ -56,69 +57,60 @@ using namespace std;
 
 static const ssize_t DEFAULT_INCREMENT          = 128 * 1024;
 static const ssize_t MAX_COMPRESSED_BUFFER_SIZE = 32 * 1024 * 1024;
-
+static const ssize_t MIN_READAHEAD_SIZE         = 256 * 1024;
+static const ssize_t MAX_READAHEAD_SIZE         = 16 * 1024 * 1024;
 /*
- * XXX REMOVE ME
- *
- * The stock bzipped file code does not use pread, so we need to use a lock to
- * get exclusive access to the file.  In the future, we should just rewrite
- * the bzipped file code to use pread.
+ * Once a sequential read has passed this offset, the pages that are far
+ * enough behind it are dropped from the page cache, so that indexing a huge
+ * file does not push everything else out.
  */
-class lock_hack {
-public:
-    class guard {
-public:
-
-        guard() : g_lock(lock_hack::singleton())
-        {
-            this->g_lock.lock();
-        };
-
-        ~guard()
-        {
-            this->g_lock.unlock();
-        };
-
-private:
-        lock_hack &g_lock;
-    };
+static const off_t DROP_BEHIND_OFFSET           = 1024 * 1024 * 1024;
+static const off_t DROP_BEHIND_KEEP             = 64 * 1024 * 1024;
+static const off_t DROP_BEHIND_CHUNK            = 32 * 1024 * 1024;
 
-    static lock_hack &singleton()
-    {
-        static lock_hack retval;
+#define Z_BUFSIZE 65536U
+#define SYNCPOINT_SIZE (1024 * 1024)
+#define GZ_PREFETCH_SIZE (1024 * 1024)
 
-        return retval;
-    };
+/** Used to order the buffers by when they were last read from. */
+static std::atomic<uint64_t> BUFFER_ACCESS_CLOCK{1};
 
-    void lock()
-    {
-        lockf(this->lh_fd, F_LOCK, 0);
-    };
+/** The number of open descriptors that could be closed while idle. */
+static std::atomic<size_t> OPEN_FD_COUNT{0};
 
-    void unlock()
-    {
-        lockf(this->lh_fd, F_ULOCK, 0);
-    };
+/**
+ * The line_buffers that are alive, so their memory can be kept under the
+ * budget.
+ */
+struct buffer_registry {
+    std::mutex br_mutex;
+    std::set<line_buffer *> br_buffers;
+};
 
-private:
+static buffer_registry &get_buffer_registry()
+{
+    static buffer_registry retval;
 
-    lock_hack()
-    {
-        char lockname[64];
+    return retval;
+}
 
-        snprintf(lockname, sizeof(lockname), "/tmp/lnav.%d.lck", getpid());
-        this->lh_fd = open(lockname, O_CREAT | O_RDWR, 0600);
-        log_perror(fcntl(this->lh_fd, F_SETFD, FD_CLOEXEC));
-        unlink(lockname);
-    };
+static const char SYNCPOINT_CACHE_MAGIC[8] = "lnavgzi";
+static const uint32_t SYNCPOINT_CACHE_VERSION = 1;
 
-    auto_fd lh_fd;
+/**
+ * The header for a file of saved syncpoints in the index cache.  The header
+ * is followed by the indexDict structures.
+ */
+struct syncpoint_cache_header {
+    char sch_magic[8];
+    uint32_t sch_version;
+    uint32_t sch_dict_size;
+    uint64_t sch_dev;
+    uint64_t sch_ino;
+    int64_t sch_file_size;
+    int64_t sch_mtime;
+    uint64_t sch_count;
 };
-/* XXX END */
-
-
-#define Z_BUFSIZE 65536U
-#define SYNCPOINT_SIZE (1024 * 1024)
 line_buffer::gz_indexed::gz_indexed()
 {
     if ((this->inbuf = (Bytef *)malloc(Z_BUFSIZE)) == NULL) {
@@ -130,6 +122,19 @@ void line_buffer::gz_indexed::close()
 {
     // Release old stream, if we were open
     if (*this) {
+        try {
+            this->finish_prefetch();
+        }
+        catch (...) {
+            // The error will be reported if the data is read again.
+        }
+        this->gz_prefetch_size = 0;
+        try {
+            this->save_syncpoints();
+        }
+        catch (const std::exception &e) {
+            log_error("unable to save gzip syncpoints -- %s", e.what());
+        }
         inflateEnd(&this->strm);
         ::close(this->gz_fd);
         this->syncpoints.clear();
@@ -178,6 +183,129 @@ void line_buffer::gz_indexed::open(int fd)
     this->close();
     this->init_stream();
     this->gz_fd = fd;
+    this->gz_cache_path.clear();
+    this->gz_loaded_syncpoints = 0;
+    // Loaded on the first read, in case they are replaced by
+    // use_syncpoints() before then.
+    this->gz_syncpoints_pending = true;
+}
+
+void line_buffer::gz_indexed::load_syncpoints()
+{
+    struct stat st;
+
+    this->gz_cache_path.clear();
+    this->gz_loaded_syncpoints = 0;
+
+    if (!lnav_config.lc_tuning_index_cache_enabled ||
+        fstat(this->gz_fd, &st) == -1 ||
+        !S_ISREG(st.st_mode) ||
+        st.st_size < lnav_config.lc_tuning_index_cache_min_size) {
+        return;
+    }
+
+    auto key = fmt::format("gz:{}:{}:{}:{}",
+                           (uint64_t) st.st_dev,
+                           (uint64_t) st.st_ino,
+                           (int64_t) st.st_size,
+                           (int64_t) st.st_mtime);
+    auto cache_path = dotlnav_path() / "index-cache" /
+                      ("gz-" + hash_string(key));
+
+    this->gz_cache_path = cache_path.str();
+
+    auto_fd fd;
+
+    if ((fd = openp(cache_path, O_RDONLY)) == -1) {
+        return;
+    }
+
+    struct syncpoint_cache_header sch;
+
+    if (::read(fd, &sch, sizeof(sch)) != sizeof(sch) ||
+        memcmp(sch.sch_magic, SYNCPOINT_CACHE_MAGIC,
+               sizeof(sch.sch_magic)) != 0 ||
+        sch.sch_version != SYNCPOINT_CACHE_VERSION ||
+        sch.sch_dict_size != sizeof(indexDict) ||
+        sch.sch_dev != (uint64_t) st.st_dev ||
+        sch.sch_ino != (uint64_t) st.st_ino ||
+        sch.sch_file_size != st.st_size ||
+        sch.sch_mtime != st.st_mtime ||
+        sch.sch_count > (uint64_t) st.st_size / SYNCPOINT_SIZE + 1) {
+        log_debug("ignoring stale gzip syncpoints -- %s",
+                  this->gz_cache_path.c_str());
+        return;
+    }
+
+    vector<indexDict> dicts(sch.sch_count);
+    ssize_t dicts_size = sizeof(indexDict) * dicts.size();
+
+    if (::read(fd, dicts.data(), dicts_size) != dicts_size) {
+        log_error("truncated gzip syncpoints -- %s",
+                  this->gz_cache_path.c_str());
+        return;
+    }
+
+    this->syncpoints = std::move(dicts);
+    this->gz_loaded_syncpoints = this->syncpoints.size();
+    log_info("loaded %d gzip syncpoints -- %s",
+             this->gz_loaded_syncpoints,
+             this->gz_cache_path.c_str());
+}
+
+void line_buffer::gz_indexed::save_syncpoints()
+{
+    if (this->gz_cache_path.empty() ||
+        this->syncpoints.size() <= this->gz_loaded_syncpoints) {
+        return;
+    }
+
+    struct stat st;
+
+    if (fstat(this->gz_fd, &st) == -1) {
+        return;
+    }
+
+    struct syncpoint_cache_header sch;
+
+    memset(&sch, 0, sizeof(sch));
+    memcpy(sch.sch_magic, SYNCPOINT_CACHE_MAGIC, sizeof(sch.sch_magic));
+    sch.sch_version = SYNCPOINT_CACHE_VERSION;
+    sch.sch_dict_size = sizeof(indexDict);
+    sch.sch_dev = st.st_dev;
+    sch.sch_ino = st.st_ino;
+    sch.sch_file_size = st.st_size;
+    sch.sch_mtime = st.st_mtime;
+    sch.sch_count = this->syncpoints.size();
+
+    auto tmp_path = this->gz_cache_path + ".tmp";
+    auto_fd fd;
+
+    if ((fd = openp(filesystem::path(tmp_path),
+                    O_WRONLY | O_CREAT | O_TRUNC, 0600)) == -1) {
+        log_debug("unable to create gzip syncpoint cache -- %s",
+                  strerror(errno));
+        return;
+    }
+
+    ssize_t dicts_size = sizeof(indexDict) * this->syncpoints.size();
+
+    if (::write(fd, &sch, sizeof(sch)) != sizeof(sch) ||
+        ::write(fd, this->syncpoints.data(), dicts_size) != dicts_size) {
+        log_error("unable to write gzip syncpoints -- %s", strerror(errno));
+        log_perror(unlink(tmp_path.c_str()));
+        return;
+    }
+
+    if (rename(tmp_path.c_str(), this->gz_cache_path.c_str()) == -1) {
+        log_error("unable to rename gzip syncpoints -- %s", strerror(errno));
+        log_perror(unlink(tmp_path.c_str()));
+        return;
+    }
+
+    log_info("saved %d gzip syncpoints -- %s",
+             this->syncpoints.size(),
+             this->gz_cache_path.c_str());
 }
 
 int line_buffer::gz_indexed::stream_data(void * buf, size_t size)
@@ -229,6 +357,25 @@ int line_buffer::gz_indexed::stream_data(void * buf, size_t size)
     return size - this->strm.avail_out;
 }
 
+vector<line_buffer::gz_indexed::indexDict>
+line_buffer::gz_indexed::get_syncpoints()
+{
+    this->finish_prefetch();
+
+    return this->syncpoints;
+}
+
+void line_buffer::gz_indexed::use_syncpoints(vector<indexDict> syncpoints)
+{
+    this->finish_prefetch();
+    this->gz_prefetch_size = 0;
+    this->gz_prefetch_start = 0;
+    this->syncpoints = std::move(syncpoints);
+    this->gz_loaded_syncpoints = this->syncpoints.size();
+    this->gz_cache_path.clear();
+    this->gz_syncpoints_pending = false;
+}
+
 void line_buffer::gz_indexed::seek(size_t offset)
 {
     if (offset == this->strm.total_out) {
@@ -270,17 +417,391 @@ void line_buffer::gz_indexed::seek(size_t offset)
     }
 }
 
+void line_buffer::gz_indexed::start_prefetch()
+{
+    require(!this->gz_prefetch.valid());
+
+    if (this->gz_prefetch_buffer.in() == nullptr) {
+        this->gz_prefetch_buffer = (unsigned char *) malloc(GZ_PREFETCH_SIZE);
+        if (this->gz_prefetch_buffer.in() == nullptr) {
+            return;
+        }
+    }
+
+    this->gz_source_offset = this->strm.total_in + this->strm.avail_in;
+    this->gz_prefetch_offset = this->strm.total_out;
+    this->gz_prefetch_start = 0;
+    this->gz_prefetch_size = 0;
+    this->gz_prefetch = std::async(std::launch::async, [this]() {
+        return this->stream_data(this->gz_prefetch_buffer.in(),
+                                 GZ_PREFETCH_SIZE);
+    });
+}
+
+int line_buffer::gz_indexed::finish_prefetch()
+{
+    if (!this->gz_prefetch.valid()) {
+        return 0;
+    }
+
+    int rc = this->gz_prefetch.get();
+
+    this->gz_source_offset = this->strm.total_in + this->strm.avail_in;
+    if (rc > 0) {
+        this->gz_prefetch_size = rc;
+    }
+
+    return rc;
+}
+
 int line_buffer::gz_indexed::read(void * buf, size_t offset, size_t size)
 {
+    this->finish_prefetch();
+
+    if (this->gz_syncpoints_pending) {
+        this->gz_syncpoints_pending = false;
+        this->load_syncpoints();
+    }
+
+    size_t avail = this->gz_prefetch_size - this->gz_prefetch_start;
+
+    if (avail > 0 &&
+        offset == this->gz_prefetch_offset + this->gz_prefetch_start) {
+        size_t to_copy = std::min(size, avail);
+
+        memcpy(buf,
+               &this->gz_prefetch_buffer[this->gz_prefetch_start],
+               to_copy);
+        this->gz_prefetch_start += to_copy;
+        if (this->gz_prefetch_start == this->gz_prefetch_size &&
+            this->gz_prefetch_size == GZ_PREFETCH_SIZE) {
+            this->start_prefetch();
+        }
+
+        return to_copy;
+    }
+
+    this->gz_prefetch_size = 0;
+    this->gz_prefetch_start = 0;
+
     if (offset != this->strm.total_out) {
         this->seek(offset);
     }
 
     int bytes = stream_data(buf, size);
 
+    this->gz_source_offset = this->strm.total_in + this->strm.avail_in;
+    if (bytes > 0 && (size_t) bytes == size) {
+        this->start_prefetch();
+    }
+
     return bytes;
 }
 
+#ifdef HAVE_BZLIB_H
+static const uint64_t BZ_BLOCK_MAGIC = 0x314159265359ULL;
+static const uint64_t BZ_EOS_MAGIC = 0x177245385090ULL;
+static const uint64_t BZ_MAGIC_MASK = 0xffffffffffffULL;
+static const int BZ_MAGIC_BITS = 48;
+static const int BZ_CRC_BITS = 32;
+static const int BZ_MAX_FALSE_BOUNDARIES = 16;
+
+/**
+ * Accumulates a bit stream, most-significant bit first, the way bzip2 writes
+ * them.
+ */
+class bit_writer {
+public:
+    bit_writer(vector<unsigned char> &out) : bw_out(out) {
+    };
+
+    void put(uint64_t value, int nbits) {
+        for (int lpc = nbits - 1; lpc >= 0; lpc--) {
+            this->put_bit((value >> lpc) & 1);
+        }
+    };
+
+    void put_bit(int bit) {
+        this->bw_acc = (this->bw_acc << 1) | bit;
+        this->bw_count += 1;
+        if (this->bw_count == 8) {
+            this->bw_out.push_back(this->bw_acc);
+            this->bw_acc = 0;
+            this->bw_count = 0;
+        }
+    };
+
+    /**
+     * Copy a range of bits from a buffer.
+     *
+     * @param src The buffer to copy from.
+     * @param start_bit The bit offset in the buffer to start copying from.
+     * @param nbits The number of bits to copy.
+     */
+    void copy(const unsigned char *src, uint64_t start_bit, uint64_t nbits) {
+        int shift = start_bit % 8;
+        const unsigned char *curr = &src[start_bit / 8];
+
+        require(this->bw_count == 0);
+
+        for (; nbits >= 8; nbits -= 8, curr++) {
+            if (shift == 0) {
+                this->bw_out.push_back(curr[0]);
+            }
+            else {
+                this->bw_out.push_back(
+                    (curr[0] << shift) | (curr[1] >> (8 - shift)));
+            }
+        }
+        for (int lpc = 0; lpc < (int) nbits; lpc++) {
+            int bit_off = shift + lpc;
+
+            this->put_bit((curr[bit_off / 8] >> (7 - (bit_off % 8))) & 1);
+        }
+    };
+
+    void flush() {
+        while (this->bw_count != 0) {
+            this->put_bit(0);
+        }
+    };
+
+private:
+    vector<unsigned char> &bw_out;
+    uint32_t bw_acc{0};
+    int bw_count{0};
+};
+
+void line_buffer::bz_indexed::open(int fd)
+{
+    struct stat st;
+
+    this->close();
+    if (fstat(fd, &st) == -1) {
+        throw error(errno);
+    }
+    this->bz_fd = fd;
+    this->bz_file_bits = (uint64_t) st.st_size * 8;
+}
+
+bool line_buffer::bz_indexed::find_boundary(uint64_t from_bit,
+                                            uint64_t &bit_out,
+                                            bool &eos_out)
+{
+    unsigned char buffer[Z_BUFSIZE];
+    off_t byte_off = from_bit / 8;
+    uint64_t reg = 0;
+    ssize_t rc;
+
+    while ((rc = pread(this->bz_fd, buffer, sizeof(buffer), byte_off)) > 0) {
+        for (ssize_t lpc = 0; lpc < rc; lpc++) {
+            reg = (reg << 8) | buffer[lpc];
+
+            uint64_t end_bit = (byte_off + lpc + 1) * 8;
+
+            for (int shift = 7; shift >= 0; shift--) {
+                if (end_bit < (uint64_t) (BZ_MAGIC_BITS + shift)) {
+                    continue;
+                }
+
+                uint64_t start_bit = end_bit - shift - BZ_MAGIC_BITS;
+
+                if (start_bit < from_bit) {
+                    continue;
+                }
+
+                uint64_t cand = (reg >> shift) & BZ_MAGIC_MASK;
+
+                if (cand == BZ_BLOCK_MAGIC || cand == BZ_EOS_MAGIC) {
+                    bit_out = start_bit;
+                    eos_out = cand == BZ_EOS_MAGIC;
+                    return true;
+                }
+            }
+        }
+        byte_off += rc;
+    }
+
+    if (rc == -1) {
+        throw error(errno);
+    }
+
+    return false;
+}
+
+bool line_buffer::bz_indexed::decode_block(uint64_t start_bit,
+                                           uint64_t end_bit,
+                                           vector<char> &data_out)
+{
+    off_t first_byte = start_bit / 8;
+    size_t src_len = (end_bit + 7) / 8 - first_byte;
+    auto_mem<unsigned char> src;
+
+    if ((src = (unsigned char *) malloc(src_len + 1)) == nullptr) {
+        throw bad_alloc();
+    }
+    src[src_len] = '\0';
+    if (pread(this->bz_fd, src.in(), src_len, first_byte) != (ssize_t) src_len) {
+        return false;
+    }
+
+    /*
+     * Build a stream with a single block in it.  The CRC for the block
+     * comes right after the block magic and the combined CRC for a stream
+     * with one block is the same as the block CRC.
+     */
+    uint64_t rel_start = start_bit - first_byte * 8;
+    uint32_t block_crc = 0;
+
+    for (int lpc = 0; lpc < BZ_CRC_BITS; lpc++) {
+        uint64_t bit_off = rel_start + BZ_MAGIC_BITS + lpc;
+
+        block_crc = (block_crc << 1) |
+                    ((src[bit_off / 8] >> (7 - (bit_off % 8))) & 1);
+    }
+
+    vector<unsigned char> stream;
+    bit_writer bw(stream);
+
+    stream.reserve(src_len + 16);
+    stream.push_back('B');
+    stream.push_back('Z');
+    stream.push_back('h');
+    stream.push_back('9');
+    bw.copy(src.in(), rel_start, end_bit - start_bit);
+    bw.put(BZ_EOS_MAGIC, BZ_MAGIC_BITS);
+    bw.put(block_crc, BZ_CRC_BITS);
+    bw.flush();
+
+    bz_stream bzs;
+    int rc;
+
+    memset(&bzs, 0, sizeof(bzs));
+    if (BZ2_bzDecompressInit(&bzs, 0, 0) != BZ_OK) {
+        throw bad_alloc();
+    }
+
+    data_out.clear();
+    bzs.next_in = (char *) stream.data();
+    bzs.avail_in = stream.size();
+    do {
+        size_t used = data_out.size();
+
+        data_out.resize(used + SYNCPOINT_SIZE);
+        bzs.next_out = &data_out[used];
+        bzs.avail_out = SYNCPOINT_SIZE;
+        rc = BZ2_bzDecompress(&bzs);
+        data_out.resize(used + SYNCPOINT_SIZE - bzs.avail_out);
+    } while (rc == BZ_OK && (bzs.avail_in > 0 || bzs.avail_out == 0));
+    BZ2_bzDecompressEnd(&bzs);
+
+    return rc == BZ_STREAM_END;
+}
+
+bool line_buffer::bz_indexed::index_next_block()
+{
+    uint64_t start_bit, from_bit = this->bz_scan_bit;
+    bool eos;
+
+    if (this->bz_eof) {
+        return false;
+    }
+
+    // Skip over the end-of-stream markers in concatenated files.
+    do {
+        if (!this->find_boundary(from_bit, start_bit, eos)) {
+            this->bz_eof = true;
+            return false;
+        }
+        from_bit = start_bit + BZ_MAGIC_BITS + BZ_CRC_BITS;
+    } while (eos);
+
+    /*
+     * The magic numbers are not escaped in the compressed data, so a match
+     * might be a false positive.  In that case, the block will not decode
+     * and we try again with the following boundary.
+     */
+    for (int attempt = 0; attempt < BZ_MAX_FALSE_BOUNDARIES; attempt++) {
+        uint64_t end_bit;
+        bool found = this->find_boundary(from_bit, end_bit, eos);
+
+        if (!found) {
+            end_bit = this->bz_file_bits;
+        }
+        if (this->decode_block(start_bit, end_bit, this->bz_block_data)) {
+            off_t out_offset = 0;
+
+            if (!this->bz_blocks.empty()) {
+                auto &last = this->bz_blocks.back();
+
+                out_offset = last.b_out_offset + last.b_out_size;
+            }
+            this->bz_blocks.push_back({
+                start_bit, end_bit, out_offset, this->bz_block_data.size()
+            });
+            this->bz_cached_block = this->bz_blocks.size() - 1;
+            this->bz_scan_bit = end_bit;
+            return true;
+        }
+        if (!found) {
+            break;
+        }
+        from_bit = end_bit + BZ_MAGIC_BITS;
+    }
+
+    log_error("unable to decode bzip2 block at bit offset %lld",
+              (long long) start_bit);
+    this->bz_eof = true;
+    return false;
+}
+
+int line_buffer::bz_indexed::read(void *buf, size_t offset, size_t size)
+{
+    size_t copied = 0;
+
+    while (copied < size) {
+        off_t off = offset + copied;
+
+        if (this->bz_blocks.empty() ||
+            off >= (off_t) (this->bz_blocks.back().b_out_offset +
+                            this->bz_blocks.back().b_out_size)) {
+            if (!this->index_next_block()) {
+                break;
+            }
+            continue;
+        }
+
+        auto iter = upper_bound(this->bz_blocks.begin(),
+                                this->bz_blocks.end(),
+                                off,
+                                [](off_t lhs, const block &rhs) {
+                                    return lhs < rhs.b_out_offset;
+                                });
+        ssize_t index = std::distance(this->bz_blocks.begin(), iter) - 1;
+        const block &blk = this->bz_blocks[index];
+
+        if (index != this->bz_cached_block) {
+            if (!this->decode_block(blk.b_start_bit, blk.b_end_bit,
+                                    this->bz_block_data) ||
+                this->bz_block_data.size() != blk.b_out_size) {
+                this->bz_cached_block = -1;
+                throw error(EIO);
+            }
+            this->bz_cached_block = index;
+        }
+
+        size_t block_off = off - blk.b_out_offset;
+        size_t to_copy = std::min(size - copied, blk.b_out_size - block_off);
+
+        memcpy((char *) buf + copied, &this->bz_block_data[block_off], to_copy);
+        copied += to_copy;
+        this->bz_source_offset = blk.b_end_bit / 8;
+    }
+
+    return copied;
+}
+#endif
+
 line_buffer::line_buffer()
     : lb_bz_file(false),
       lb_compressed_offset(0),
@@ -296,6 +817,13 @@ line_buffer::line_buffer()
         throw bad_alloc();
     }
 
+    {
+        auto &reg = get_buffer_registry();
+        std::lock_guard<std::mutex> lg(reg.br_mutex);
+
+        reg.br_buffers.insert(this);
+    }
+
     ensure(this->invariant());
 }
 
@@ -303,23 +831,119 @@ line_buffer::~line_buffer()
 {
     auto_fd fd = -1;
 
-    // Make sure any shared refs take ownership of the data.
-    this->lb_share_manager.invalidate_refs();
+    {
+        auto &reg = get_buffer_registry();
+        std::lock_guard<std::mutex> lg(reg.br_mutex);
+
+        reg.br_buffers.erase(this);
+    }
+
+    // Any shared refs keep the buffer alive after this object is gone.
+    this->replace_buffer(0, 0, 0);
     this->set_fd(fd);
 }
 
+size_t line_buffer::release_buffer()
+{
+    if (this->lb_buffer == nullptr ||
+        !this->lb_seekable ||
+        this->lb_pipe_source != nullptr ||
+        this->lb_mmap_addr != nullptr) {
+        return 0;
+    }
+
+    size_t retval = this->lb_buffer_max;
+
+    // The refs point into the buffer, so it is retired if there are any.
+    if (!this->replace_buffer(0, 0, 0)) {
+        this->lb_buffer.reset();
+    }
+    this->lb_buffer_max = 0;
+    this->lb_buffer_size = 0;
+    this->lb_file_offset = 0;
+
+    ensure(this->invariant());
+
+    return retval;
+}
+
+size_t line_buffer::get_buffer_usage()
+{
+    auto &reg = get_buffer_registry();
+    std::lock_guard<std::mutex> lg(reg.br_mutex);
+    size_t retval = 0;
+
+    for (auto lb : reg.br_buffers) {
+        retval += lb->lb_buffer_max;
+    }
+
+    return retval;
+}
+
+size_t line_buffer::enforce_buffer_budget(size_t budget)
+{
+    auto &reg = get_buffer_registry();
+    std::lock_guard<std::mutex> lg(reg.br_mutex);
+    std::vector<line_buffer *> candidates;
+    size_t total = 0, retval = 0;
+
+    for (auto lb : reg.br_buffers) {
+        total += lb->lb_buffer_max;
+        if (lb->lb_buffer != nullptr) {
+            candidates.push_back(lb);
+        }
+    }
+
+    if (total <= budget) {
+        return 0;
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+              [](const line_buffer *lhs, const line_buffer *rhs) {
+                  return lhs->lb_last_access < rhs->lb_last_access;
+              });
+
+    for (auto lb : candidates) {
+        if (total <= budget) {
+            break;
+        }
+
+        size_t freed = lb->release_buffer();
+
+        total -= freed;
+        retval += freed;
+    }
+
+    if (retval > 0) {
+        log_debug("released %zu bytes of line buffers, %zu bytes in use",
+                  retval, total);
+    }
+
+    return retval;
+}
+
 void line_buffer::set_fd(auto_fd &fd)
 {
     off_t newoff = 0;
 
+    this->unmap_file();
+    this->lb_use_mmap = false;
+
     if (this->lb_gz_file) {
         this->lb_gz_file.close();
     }
 
     if (this->lb_bz_file) {
+        this->lb_bz_index.close();
         this->lb_bz_file = false;
     }
 
+    this->lb_frame_file.reset();
+    this->lb_stream_filter.reset();
+    this->lb_stream_scratch.clear();
+    this->lb_has_member_range = false;
+    this->lb_member_range.clear();
+
     if (fd != -1) {
         /* Sync the fd's offset with the object. */
         newoff = lseek(fd, 0, SEEK_CUR);
@@ -358,38 +982,216 @@ void line_buffer::set_fd(auto_fd &fd)
                         throw error(errno);
                     }
                     this->lb_bz_file = true;
-
-                    /*
-                     * Loading data from a bzip2 file is pretty slow, so we try
-                     * to keep as much in memory as possible.
-                     */
-                    this->resize_buffer(MAX_COMPRESSED_BUFFER_SIZE);
-
+                    this->lb_bz_index.open(fd);
                     this->lb_compressed_offset = 0;
                 }
 #endif
+                else if ((this->lb_frame_file = frame_indexed::create(
+                    fd, (const unsigned char *) gz_id, sizeof(gz_id)))) {
+                    this->lb_compressed_offset = 0;
+                }
             }
             this->lb_seekable = true;
+
+            if (this->lb_mmap_enabled && !this->is_compressed()) {
+                struct stat st;
+
+                this->lb_use_mmap = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+            }
         }
     }
+    this->replace_buffer(this->lb_buffer_max, 0, 0);
     this->lb_file_offset = newoff;
     this->lb_buffer_size = 0;
     this->lb_fd          = fd;
+    this->lb_fd_closed   = false;
+    this->lb_next_read_offset = -1;
+    this->lb_dropped_offset = 0;
+    this->lb_framing = framing_t::UNKNOWN;
+    this->update_fd_count();
+
+    ensure(this->invariant());
+}
+
+void line_buffer::set_member_range(file_range fr,
+                                   vector<gz_indexed::indexDict> syncpoints)
+{
+    require(!this->lb_bz_file && this->lb_frame_file == nullptr);
+
+    this->unmap_file();
+    this->lb_use_mmap = false;
+    this->lb_has_member_range = true;
+    this->lb_member_range = fr;
+    if (this->lb_gz_file) {
+        this->lb_gz_file.use_syncpoints(std::move(syncpoints));
+    }
+    this->replace_buffer(this->lb_buffer_max, 0, 0);
+    this->lb_file_offset = 0;
+    this->lb_file_size = (ssize_t) -1;
+    this->lb_buffer_size = 0;
+    this->lb_next_read_offset = -1;
+    this->lb_dropped_offset = fr.fr_offset;
+    this->lb_framing = framing_t::UNKNOWN;
+}
+
+void line_buffer::set_range_source(std::shared_ptr<range_source> rs)
+{
+    require(this->lb_seekable);
+    require(!this->is_compressed());
+
+    // Reads of a mapping cannot be intercepted, so the parts of the file
+    // that have not been fetched yet would read as zeroes.
+    this->unmap_file();
+    this->lb_use_mmap = false;
+    this->lb_range_source = std::move(rs);
+}
+
+void line_buffer::fetch_source_range(off_t offset, ssize_t length)
+{
+    if (this->lb_range_source == nullptr || length <= 0) {
+        return;
+    }
+
+    auto fetch_res = this->lb_range_source->fetch_range(
+        {offset, length});
+
+    if (fetch_res.isErr()) {
+        log_error("unable to fetch range %lld:%zd -- %s",
+                  (long long) offset,
+                  length,
+                  fetch_res.unwrapErr().c_str());
+        throw error(EIO);
+    }
+}
+
+void line_buffer::set_reopen_path(const std::string &path)
+{
+    this->lb_reopen_path = path;
+    this->update_fd_count();
+}
+
+void line_buffer::update_fd_count()
+{
+    bool counted = this->lb_fd != -1 && this->can_close_fd();
+
+    if (counted != this->lb_fd_counted) {
+        this->lb_fd_counted = counted;
+        if (counted) {
+            OPEN_FD_COUNT += 1;
+        } else {
+            OPEN_FD_COUNT -= 1;
+        }
+    }
+}
+
+bool line_buffer::close_fd()
+{
+    struct stat st;
+
+    if (this->lb_fd == -1 || !this->can_close_fd()) {
+        return false;
+    }
+
+    if (fstat(this->lb_fd, &st) == -1) {
+        return false;
+    }
+
+    this->unmap_file();
+    this->lb_reopen_dev = st.st_dev;
+    this->lb_reopen_ino = st.st_ino;
+    this->lb_fd.reset();
+    this->lb_fd_closed = true;
+    this->update_fd_count();
+
+    return true;
+}
+
+bool line_buffer::ensure_fd_open()
+{
+    if (!this->lb_fd_closed) {
+        return this->lb_fd != -1;
+    }
+
+    auto_fd fd(open(this->lb_reopen_path.c_str(), O_RDONLY));
+    struct stat st;
+
+    if (fd == -1) {
+        log_error("unable to reopen file: %s -- %s",
+                  this->lb_reopen_path.c_str(), strerror(errno));
+        return false;
+    }
+
+    fd.close_on_exec();
+    if (fstat(fd, &st) == -1 ||
+        st.st_dev != this->lb_reopen_dev ||
+        st.st_ino != this->lb_reopen_ino) {
+        log_info("file was replaced while it was closed -- %s",
+                 this->lb_reopen_path.c_str());
+        return false;
+    }
+
+    this->lb_fd = fd;
+    this->lb_fd_closed = false;
+    this->lb_last_access = BUFFER_ACCESS_CLOCK++;
+    this->update_fd_count();
+
+    return true;
+}
+
+size_t line_buffer::enforce_fd_limit(size_t max_open)
+{
+    if (OPEN_FD_COUNT <= max_open) {
+        return 0;
+    }
+
+    auto &reg = get_buffer_registry();
+    std::lock_guard<std::mutex> lg(reg.br_mutex);
+    std::vector<line_buffer *> candidates;
+    // Close a few more than needed so this is not done for every new file.
+    size_t target = max_open - max_open / 4;
+    size_t retval = 0;
+
+    for (auto lb : reg.br_buffers) {
+        if (lb->lb_fd_counted) {
+            candidates.push_back(lb);
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+              [](const line_buffer *lhs, const line_buffer *rhs) {
+                  return lhs->lb_last_access < rhs->lb_last_access;
+              });
+
+    for (auto lb : candidates) {
+        if (OPEN_FD_COUNT <= target) {
+            break;
+        }
+
+        if (lb->close_fd()) {
+            retval += 1;
+        }
+    }
+
+    log_info("closed %zu idle files, %zu are still open",
+             retval, (size_t) OPEN_FD_COUNT);
 
-    ensure(this->invariant());
+    return retval;
 }
 
 void line_buffer::resize_buffer(size_t new_max)
 {
-    require(this->lb_bz_file || this->lb_gz_file ||
+    require(this->is_compressed() ||
         new_max <= MAX_LINE_BUFFER_SIZE);
 
     if (new_max > (size_t)this->lb_buffer_max) {
         char *tmp, *old;
 
+        if (this->replace_buffer(new_max, 0, this->lb_buffer_size)) {
+            return;
+        }
+
         /* Still need more space, try a realloc. */
         old = this->lb_buffer.release();
-        this->lb_share_manager.invalidate_refs();
         tmp = (char *) realloc(old, new_max);
         if (tmp != NULL) {
             this->lb_buffer = tmp;
@@ -402,12 +1204,110 @@ void line_buffer::resize_buffer(size_t new_max)
     }
 }
 
+bool line_buffer::replace_buffer(size_t new_max,
+                                 size_t keep_offset,
+                                 size_t keep_length)
+{
+    if (this->lb_buffer == nullptr || !this->lb_share_manager.has_refs()) {
+        return false;
+    }
+
+    require(keep_offset + keep_length <= (size_t) this->lb_buffer_max);
+    require(keep_length <= new_max);
+
+    auto_mem<char> new_buffer;
+
+    if (new_max > 0) {
+        new_buffer = (char *) malloc(new_max);
+        if (new_buffer == nullptr) {
+            throw error(ENOMEM);
+        }
+        memcpy(new_buffer.in(), &this->lb_buffer[keep_offset], keep_length);
+    }
+
+    char *old = this->lb_buffer.release();
+
+    this->lb_share_manager.retire([old]() { free(old); });
+    this->lb_buffer = new_buffer.release();
+    this->lb_buffer_max = new_max;
+
+    return true;
+}
+
+bool line_buffer::map_file()
+{
+    struct stat st;
+
+    if (fstat(this->lb_fd, &st) == -1) {
+        throw error(errno);
+    }
+
+    if (this->lb_mmap_addr != nullptr &&
+        (size_t) st.st_size <= this->lb_mmap_size) {
+        return true;
+    }
+
+    if (st.st_size == 0) {
+        return this->lb_mmap_addr != nullptr;
+    }
+
+    this->unmap_file();
+
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE,
+                      this->lb_fd, 0);
+
+    if (addr == MAP_FAILED) {
+        log_error("unable to map file, falling back to read -- %s",
+                  strerror(errno));
+        this->lb_use_mmap = false;
+        this->lb_file_offset = 0;
+        this->lb_buffer_size = 0;
+        return false;
+    }
+
+    this->lb_mmap_addr = (char *) addr;
+    this->lb_mmap_size = st.st_size;
+
+    return true;
+}
+
+void line_buffer::unmap_file()
+{
+    if (this->lb_mmap_addr == nullptr) {
+        return;
+    }
+
+    char *addr = this->lb_mmap_addr;
+    size_t size = this->lb_mmap_size;
+
+    // The refs point into the mapping, so it is retired if there are any.
+    if (this->lb_share_manager.has_refs()) {
+        this->lb_share_manager.retire([addr, size]() { munmap(addr, size); });
+    } else {
+        munmap(addr, size);
+    }
+    this->lb_mmap_addr = nullptr;
+    this->lb_mmap_size = 0;
+    this->lb_file_offset = 0;
+    this->lb_buffer_size = 0;
+}
+
 void line_buffer::ensure_available(off_t start, ssize_t max_length)
 {
     ssize_t prefill, available;
 
     require(max_length <= MAX_LINE_BUFFER_SIZE);
 
+    if (this->lb_mmap_addr != nullptr) {
+        /* The whole file is already available through the mapping. */
+        return;
+    }
+
+    if (this->lb_buffer == nullptr) {
+        /* The buffer was released to stay under the budget. */
+        this->resize_buffer(DEFAULT_LINE_BUFFER_SIZE);
+    }
+
     if (this->lb_file_size != -1) {
         if (start + (off_t)max_length > this->lb_file_size) {
             max_length = (this->lb_file_size - start);
@@ -424,7 +1324,7 @@ void line_buffer::ensure_available(off_t start, ssize_t max_length)
          * The request is outside the cached range, need to reload the
          * whole thing.
          */
-        this->lb_share_manager.invalidate_refs();
+        this->replace_buffer(this->lb_buffer_max, 0, 0);
         prefill = 0;
         this->lb_buffer_size = 0;
         if ((this->lb_file_size != (ssize_t)-1) &&
@@ -456,15 +1356,18 @@ void line_buffer::ensure_available(off_t start, ssize_t max_length)
     if (max_length > available) {
         /*
          * Need more space, move any existing data to the front of the
-         * buffer.
+         * buffer.  If there are refs to the buffer, the data is copied to
+         * a new one instead.
          */
-        this->lb_share_manager.invalidate_refs();
-
         this->lb_buffer_size -= prefill;
         this->lb_file_offset += prefill;
-        memmove(&this->lb_buffer[0],
-                &this->lb_buffer[prefill],
-                this->lb_buffer_size);
+        if (!this->replace_buffer(this->lb_buffer_max,
+                                  prefill,
+                                  this->lb_buffer_size)) {
+            memmove(&this->lb_buffer[0],
+                    &this->lb_buffer[prefill],
+                    this->lb_buffer_size);
+        }
 
         available = this->lb_buffer_max - (start - this->lb_file_offset);
         if (max_length > available) {
@@ -474,22 +1377,217 @@ void line_buffer::ensure_available(off_t start, ssize_t max_length)
     }
 }
 
+void line_buffer::set_pipe_source(std::shared_ptr<pipe_source> ps)
+{
+    require(this->lb_seekable);
+
+    // The file keeps growing, so it is always read through the buffer.
+    this->unmap_file();
+    this->lb_use_mmap = false;
+    this->lb_pipe_source = std::move(ps);
+    this->update_fd_count();
+}
+
+void line_buffer::append_pipe_data(const char *data,
+                                   size_t len,
+                                   bool in_buffer)
+{
+    auto &ps = *this->lb_pipe_source;
+    size_t buffered = 0;
+
+    for (size_t written = 0; written < len; ) {
+        ssize_t wrc = pwrite(this->lb_fd,
+                             &data[written],
+                             len - written,
+                             ps.ps_size + written);
+
+        if (wrc == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw error(errno);
+        }
+        written += wrc;
+    }
+
+    if (in_buffer) {
+        this->lb_buffer_size += len;
+    }
+    else if (this->lb_file_offset + this->lb_buffer_size == ps.ps_size) {
+        while (buffered < len &&
+               this->lb_buffer_size < MAX_LINE_BUFFER_SIZE) {
+            if (this->lb_buffer_size == this->lb_buffer_max) {
+                this->resize_buffer(
+                    std::min(this->lb_buffer_max * 2,
+                             (ssize_t) MAX_LINE_BUFFER_SIZE));
+            }
+
+            size_t room = std::min(
+                len - buffered,
+                (size_t) (this->lb_buffer_max - this->lb_buffer_size));
+
+            memcpy(&this->lb_buffer[this->lb_buffer_size],
+                   &data[buffered],
+                   room);
+            this->lb_buffer_size += room;
+            buffered += room;
+        }
+    }
+
+    ps.ps_size += len;
+}
+
+bool line_buffer::pull_pipe()
+{
+    static const size_t MAX_PULL_SIZE = 4 * MAX_LINE_BUFFER_SIZE;
+
+    if (this->lb_pipe_source == nullptr || this->lb_pipe_source->ps_eof) {
+        return false;
+    }
+
+    auto &ps = *this->lb_pipe_source;
+    size_t pulled = 0;
+
+    while (pulled < MAX_PULL_SIZE) {
+        bool buffered = false;
+        char *dst;
+        ssize_t room;
+
+        if (ps.ps_filter.is_passthrough() &&
+            this->lb_file_offset + this->lb_buffer_size == ps.ps_size &&
+            this->lb_buffer_size < MAX_LINE_BUFFER_SIZE) {
+            if (this->lb_buffer_size == this->lb_buffer_max) {
+                this->resize_buffer(
+                    std::min(this->lb_buffer_max * 2,
+                             (ssize_t) MAX_LINE_BUFFER_SIZE));
+            }
+            buffered = true;
+            dst = &this->lb_buffer[this->lb_buffer_size];
+            room = this->lb_buffer_max - this->lb_buffer_size;
+        } else {
+            // The data is going through the decoder or the buffer is being
+            // used for an earlier part of the file, so it is read into the
+            // scratch space first.
+            ps.ps_scratch.resize(DEFAULT_INCREMENT);
+            dst = ps.ps_scratch.data();
+            room = ps.ps_scratch.size();
+        }
+
+        ssize_t rc = read(ps.ps_fd, dst, room);
+
+        if (rc == 0) {
+            ps.ps_eof = true;
+            if (!ps.ps_filter.finish()) {
+                log_error("unable to decode the data from the pipe");
+            }
+        }
+        else if (rc == -1) {
+            if (errno != EAGAIN && errno != EINTR) {
+                log_error("unable to read from pipe -- %s", strerror(errno));
+                ps.ps_eof = true;
+            }
+        }
+        else if (buffered) {
+            this->append_pipe_data(dst, rc, true);
+            pulled += rc;
+        }
+        else if (!ps.ps_filter.push(dst, rc)) {
+            log_error("unable to decode the data from the pipe");
+            ps.ps_eof = true;
+        }
+
+        if (ps.ps_filter.get_size() > 0) {
+            size_t len = ps.ps_filter.get_size();
+
+            this->append_pipe_data(ps.ps_filter.get_data(), len, false);
+            ps.ps_filter.consume(len);
+            pulled += len;
+        }
+        if (rc <= 0 || ps.ps_eof) {
+            break;
+        }
+    }
+
+    if (ps.ps_eof) {
+        ps.ps_fd.reset();
+        ps.ps_scratch.clear();
+        ps.ps_scratch.shrink_to_fit();
+        ps.ps_filter.reset();
+    }
+
+    return pulled > 0;
+}
+
+ssize_t line_buffer::read_stream(char *dst, size_t size)
+{
+    auto &sf = this->lb_stream_filter;
+
+    if (sf.is_passthrough()) {
+        return read(this->lb_fd, dst, size);
+    }
+
+    while (sf.get_size() == 0) {
+        this->lb_stream_scratch.resize(DEFAULT_INCREMENT);
+
+        ssize_t rc = read(this->lb_fd,
+                          this->lb_stream_scratch.data(),
+                          this->lb_stream_scratch.size());
+
+        if (rc == -1) {
+            return -1;
+        }
+        if (!(rc == 0 ? sf.finish() :
+              sf.push(this->lb_stream_scratch.data(), rc))) {
+            errno = EILSEQ;
+            return -1;
+        }
+        if (rc == 0) {
+            break;
+        }
+    }
+
+    return sf.take(dst, size);
+}
+
 bool line_buffer::fill_range(off_t start, ssize_t max_length)
 {
     bool retval = false;
 
     require(start >= 0);
 
+    this->lb_last_access = BUFFER_ACCESS_CLOCK++;
     if (this->in_range(start) && this->in_range(start + max_length - 1)) {
         /* Cache already has the data, nothing to do. */
         retval = true;
     }
+    else if (this->lb_fd_closed && !this->ensure_fd_open()) {
+        /* The file was replaced while it was closed, nothing to read. */
+    }
+    else if (this->lb_use_mmap && this->map_file()) {
+        /* The mapping covers the whole file, there is nothing to copy. */
+        this->lb_file_offset = 0;
+        this->lb_buffer_size = this->lb_mmap_size;
+        retval = start < (off_t) this->lb_mmap_size;
+    }
     else if (this->lb_fd != -1) {
         ssize_t rc;
 
         /* Make sure there is enough space, then */
         this->ensure_available(start, max_length);
 
+        off_t read_base = 0;
+        ssize_t read_max = this->lb_buffer_max - this->lb_buffer_size;
+
+        if (this->lb_has_member_range) {
+            // Stop at the end of the member, a short read is its EOF.
+            off_t member_left = this->lb_member_range.fr_size -
+                                (this->lb_file_offset + this->lb_buffer_size);
+
+            read_base = this->lb_member_range.fr_offset;
+            read_max = std::min(read_max,
+                                (ssize_t) std::max(member_left, (off_t) 0));
+        }
+
         /* ... read in the new data. */
         if (this->lb_gz_file) {
             if (this->lb_file_size != (ssize_t)-1 &&
@@ -499,8 +1597,8 @@ bool line_buffer::fill_range(off_t start, ssize_t max_length)
             }
             else {
                 rc = this->lb_gz_file.read(&this->lb_buffer[this->lb_buffer_size],
-                                     this->lb_file_offset + this->lb_buffer_size,
-                                     this->lb_buffer_max - this->lb_buffer_size);
+                                     read_base + this->lb_file_offset + this->lb_buffer_size,
+                                     read_max);
                 this->lb_compressed_offset = this->lb_gz_file.get_source_offset();
                 if (rc != -1 && (
                         rc < (this->lb_buffer_max - this->lb_buffer_size))) {
@@ -518,46 +1616,12 @@ bool line_buffer::fill_range(off_t start, ssize_t max_length)
                 rc = 0;
             }
             else {
-                lock_hack::guard guard;
-                char             scratch[32 * 1024];
-                BZFILE *         bz_file;
-                off_t            seek_to;
-                int              bzfd;
-
-                /*
-                 * Unfortunately, there is no bzseek, so we need to reopen the
-                 * file every time we want to do a read.
-                 */
-                bzfd = dup(this->lb_fd);
-                if (lseek(this->lb_fd, 0, SEEK_SET) < 0) {
-                    close(bzfd);
-                    throw error(errno);
-                }
-                if ((bz_file = BZ2_bzdopen(bzfd, "r")) == NULL) {
-                    close(bzfd);
-                    if (errno == 0) {
-                        throw bad_alloc();
-                    }
-                    else{
-                        throw error(errno);
-                    }
-                }
-
-                seek_to = this->lb_file_offset + this->lb_buffer_size;
-                while (seek_to > 0) {
-                    int count;
-
-                    count = BZ2_bzread(bz_file,
-                                       scratch,
-                                       std::min((size_t)seek_to,
-                                                sizeof(scratch)));
-                    seek_to -= count;
-                }
-                rc = BZ2_bzread(bz_file,
-                                &this->lb_buffer[this->lb_buffer_size],
-                                this->lb_buffer_max - this->lb_buffer_size);
-                this->lb_compressed_offset = lseek(bzfd, 0, SEEK_SET);
-                BZ2_bzclose(bz_file);
+                rc = this->lb_bz_index.read(
+                    &this->lb_buffer[this->lb_buffer_size],
+                    this->lb_file_offset + this->lb_buffer_size,
+                    this->lb_buffer_max - this->lb_buffer_size);
+                this->lb_compressed_offset =
+                    this->lb_bz_index.get_source_offset();
 
                 if (rc != -1 && (
                     rc < (this->lb_buffer_max - this->lb_buffer_size))) {
@@ -567,16 +1631,44 @@ bool line_buffer::fill_range(off_t start, ssize_t max_length)
             }
         }
 #endif
+        else if (this->lb_frame_file) {
+            if (this->lb_file_size != (ssize_t)-1 &&
+                (((ssize_t)start >= this->lb_file_size) ||
+                 (this->in_range(start) &&
+                  this->in_range(this->lb_file_size - 1)))) {
+                rc = 0;
+            }
+            else {
+                rc = this->lb_frame_file->read(
+                    &this->lb_buffer[this->lb_buffer_size],
+                    this->lb_file_offset + this->lb_buffer_size,
+                    this->lb_buffer_max - this->lb_buffer_size);
+                this->lb_compressed_offset =
+                    this->lb_frame_file->get_source_offset();
+                if (rc != -1 && (
+                    rc < (this->lb_buffer_max - this->lb_buffer_size))) {
+                    this->lb_file_size = (
+                        this->lb_file_offset + this->lb_buffer_size + rc);
+                }
+            }
+        }
         else if (this->lb_seekable) {
+            off_t read_offset =
+                read_base + this->lb_file_offset + this->lb_buffer_size;
+
+            this->fetch_source_range(read_offset, read_max);
+            this->advise_readahead(read_offset, read_max);
             rc = pread(this->lb_fd,
                        &this->lb_buffer[this->lb_buffer_size],
-                       this->lb_buffer_max - this->lb_buffer_size,
-                       this->lb_file_offset + this->lb_buffer_size);
+                       read_max,
+                       read_offset);
+            if (rc > 0) {
+                this->lb_next_read_offset = read_offset + rc;
+            }
         }
         else {
-            rc = read(this->lb_fd,
-                      &this->lb_buffer[this->lb_buffer_size],
-                      this->lb_buffer_max - this->lb_buffer_size);
+            rc = this->read_stream(&this->lb_buffer[this->lb_buffer_size],
+                                   this->lb_buffer_max - this->lb_buffer_size);
         }
         // XXX For some reason, cygwin is giving us a bogus return value when
         // up to the end of the file.
@@ -597,7 +1689,7 @@ bool line_buffer::fill_range(off_t start, ssize_t max_length)
                 retval = true;
             }
 
-            if (this->lb_gz_file || this->lb_bz_file) {
+            if (this->is_compressed()) {
                 /*
                  * For compressed files, increase the buffer size so we don't
                  * have to spend as much time uncompressing the data.
@@ -634,6 +1726,75 @@ bool line_buffer::fill_range(off_t start, ssize_t max_length)
     return retval;
 }
 
+void line_buffer::prefetch_range(file_range fr)
+{
+#ifdef POSIX_FADV_WILLNEED
+    if (this->lb_fd == -1 ||
+        this->lb_fd_closed ||
+        !this->lb_seekable ||
+        this->is_compressed() ||
+        fr.fr_size <= 0 ||
+        (this->in_range(fr.fr_offset) &&
+         this->in_range(fr.next_offset() - 1))) {
+        return;
+    }
+
+    off_t base = this->lb_has_member_range ?
+                 this->lb_member_range.fr_offset : 0;
+
+    posix_fadvise(this->lb_fd, base + fr.fr_offset, fr.fr_size,
+                  POSIX_FADV_WILLNEED);
+#endif
+}
+
+void line_buffer::advise_readahead(off_t offset, ssize_t length)
+{
+#ifdef POSIX_FADV_WILLNEED
+    off_t end = offset + length;
+
+    if (offset != this->lb_next_read_offset) {
+        // A jump, like a read for the view, the pages around it are not
+        // likely to be needed so nothing extra is asked for.
+        this->lb_readahead_size = MIN_READAHEAD_SIZE;
+        this->lb_readahead_end = end;
+        return;
+    }
+
+    if (this->lb_readahead_size < MAX_READAHEAD_SIZE) {
+        this->lb_readahead_size *= 2;
+    } else if (this->lb_buffer_max < MAX_LINE_BUFFER_SIZE) {
+        // The file is being read quickly and in order, use bigger reads
+        // so there are fewer calls.
+        this->resize_buffer(MAX_LINE_BUFFER_SIZE);
+    }
+
+    if (offset > DROP_BEHIND_OFFSET &&
+        offset - DROP_BEHIND_KEEP >
+            this->lb_dropped_offset + DROP_BEHIND_CHUNK) {
+        off_t drop_end = offset - DROP_BEHIND_KEEP;
+
+        posix_fadvise(this->lb_fd,
+                      this->lb_dropped_offset,
+                      drop_end - this->lb_dropped_offset,
+                      POSIX_FADV_DONTNEED);
+        this->lb_dropped_offset = drop_end;
+    }
+
+    // Only ask for more once half of the last window has been consumed so
+    // that there is one call per window instead of one per read.
+    if (this->lb_readahead_end - end < this->lb_readahead_size / 2) {
+        off_t start = std::max(end, this->lb_readahead_end);
+        off_t window_end = end + this->lb_readahead_size;
+
+        posix_fadvise(this->lb_fd,
+                      start,
+                      window_end - start,
+                      POSIX_FADV_WILLNEED);
+        this->lb_readahead_end = window_end;
+    }
+#endif
+}
+
 Result<line_info, string> line_buffer::load_next_line(file_range prev_line)
 {
     ssize_t request_size = DEFAULT_INCREMENT;
@@ -643,6 +1804,14 @@ Result<line_info, string> line_buffer::load_next_line(file_range prev_line)
     require(this->lb_fd != -1);
 
     auto offset = prev_line.next_offset();
+
+    if (this->lb_framing == framing_t::UNKNOWN) {
+        this->detect_framing();
+    }
+    if (this->is_length_prefixed()) {
+        return this->load_next_record(offset);
+    }
+
     retval.li_file_range.fr_offset = offset;
     while (!done) {
         char *line_start, *lf;
@@ -651,27 +1820,28 @@ Result<line_info, string> line_buffer::load_next_line(file_range prev_line)
 
         /* Find the data in the cache and */
         line_start = this->get_range(offset, retval.li_file_range.fr_size);
+        if (retval.li_file_range.fr_size > MAX_LINE_BUFFER_SIZE) {
+            // The mapping of a file can be much larger than a line is
+            // allowed to be, don't scan past what would be kept.
+            retval.li_file_range.fr_size = MAX_LINE_BUFFER_SIZE;
+        }
         /* ... look for the end-of-line or end-of-file. */
         ssize_t utf8_end = -1;
 
-#undef HAVE_X86INTRIN_H
-#ifdef HAVE_X86INTRIN_H
-        if (!validate_utf8_fast(line_start, retval.li_file_range.fr_size, &utf8_end)) {
-            retval.li_valid_utf = false;
-        }
-#else
         {
             const char *msg;
             int faulty_bytes;
 
             utf8_end = is_utf8((unsigned char *) line_start, retval.li_file_range.fr_size, &msg, &faulty_bytes);
             if (msg != nullptr) {
-                lf = (char *) memchr(line_start, '\n', retval.li_file_range.fr_size);
-                utf8_end = lf - line_start;
+                // Everything before the invalid byte was checked for a line
+                // feed already, so the search can pick up from there.
+                lf = (char *) memchr(&line_start[utf8_end], '\n',
+                                     retval.li_file_range.fr_size - utf8_end);
+                utf8_end = lf == nullptr ? -1 : lf - line_start;
                 retval.li_valid_utf = false;
             }
         }
-#endif
         if (utf8_end >= 0) {
             lf = line_start + utf8_end;
         } else {
@@ -703,6 +1873,7 @@ Result<line_info, string> line_buffer::load_next_line(file_range prev_line)
                                 offset);
                     retval.li_file_range.fr_size = MAX_LINE_BUFFER_SIZE - 1;
                     retval.li_partial = false;
+                    retval.li_split = true;
                 }
                 else {
                     retval.li_partial = true;
@@ -752,6 +1923,145 @@ Result<line_info, string> line_buffer::load_next_line(file_range prev_line)
     return Ok(retval);
 }
 
+void line_buffer::detect_framing()
+{
+    ssize_t avail = 0;
+
+    if (this->is_pipe() && this->lb_file_offset != 0) {
+        // The start of a pipe cannot be read again.
+        this->lb_framing = framing_t::LINES;
+        return;
+    }
+
+    this->fill_range(0, RECORD_PREFIX_SIZE + 1);
+
+    auto start = (const unsigned char *) this->get_range(0, avail);
+
+    if (avail < (ssize_t) (RECORD_PREFIX_SIZE + 1)) {
+        if (this->is_pipe_closed()) {
+            this->lb_framing = framing_t::LINES;
+        }
+        return;
+    }
+
+    auto record_len = read_be32(start);
+    auto type = start[RECORD_PREFIX_SIZE];
+    // Text does not start with a NUL, so the high byte of the length is
+    // enough to tell them apart.  The type byte needs to start a map, since
+    // each record should be a message with fields.
+    bool is_map = (type & 0xf0) == 0x80 || type == 0xde || type == 0xdf;
+
+    if (record_len > 0 &&
+        record_len <= MAX_LINE_BUFFER_SIZE - RECORD_PREFIX_SIZE &&
+        is_map) {
+        log_info("file is made up of length-prefixed records");
+        this->lb_framing = framing_t::LENGTH_PREFIXED;
+    } else {
+        this->lb_framing = framing_t::LINES;
+    }
+}
+
+Result<line_info, string> line_buffer::load_next_record(off_t offset)
+{
+    line_info retval;
+    ssize_t avail;
+    size_t record_size = RECORD_PREFIX_SIZE;
+
+    retval.li_file_range.fr_offset = offset;
+
+    this->fill_range(offset, RECORD_PREFIX_SIZE);
+    auto record_start = this->get_range(offset, avail);
+    if (avail >= (ssize_t) RECORD_PREFIX_SIZE) {
+        auto record_len = read_be32((const unsigned char *) record_start);
+
+        if (record_len > MAX_LINE_BUFFER_SIZE - RECORD_PREFIX_SIZE) {
+            return Err(fmt::format("record at offset {} is too large: {}",
+                                   offset, record_len));
+        }
+        record_size += record_len;
+        if ((size_t) avail < record_size) {
+            this->fill_range(offset, record_size);
+            this->get_range(offset, avail);
+        }
+    }
+
+    if ((size_t) avail >= record_size) {
+        retval.li_file_range.fr_size = record_size;
+        if (offset >= this->lb_last_line_offset) {
+            this->lb_last_line_offset = offset + record_size;
+        }
+    } else if (avail > 0) {
+        // The rest of the record has not been written yet.
+        retval.li_file_range.fr_size = avail;
+        retval.li_partial = !this->is_pipe_closed();
+        if (retval.li_partial) {
+            this->lb_last_line_offset = offset;
+        }
+    }
+
+    ensure((size_t) retval.li_file_range.fr_size <=
+           (size_t) this->lb_buffer_size);
+    ensure(this->invariant());
+
+    return Ok(retval);
+}
+
+Result<std::vector<line_info>, std::string>
+line_buffer::load_next_lines(file_range prev_line, size_t max_lines)
+{
+    std::vector<line_info> retval;
+
+    retval.reserve(max_lines);
+    while (retval.size() < max_lines) {
+        if (!retval.empty() && this->lb_mmap_addr == nullptr) {
+            auto off = prev_line.next_offset();
+            ssize_t avail;
+
+            /*
+             * Only continue the batch if the next line can be found without
+             * refilling the buffer.  A refill can move the start of the
+             * batch out of the buffer and, for a pipe, that data cannot be
+             * read again.
+             */
+            if (!this->in_range(off) ||
+                !this->in_range(off + DEFAULT_INCREMENT - 1)) {
+                break;
+            }
+
+            auto line_start = this->get_range(off, avail);
+            if (this->is_length_prefixed()) {
+                auto record_len = read_be32((const unsigned char *) line_start);
+
+                if (RECORD_PREFIX_SIZE + record_len > (size_t) avail) {
+                    break;
+                }
+            } else if (memchr(line_start, '\n', avail) == nullptr) {
+                break;
+            }
+        }
+
+        auto load_result = this->load_next_line(prev_line);
+
+        if (load_result.isErr()) {
+            return Err(load_result.unwrapErr());
+        }
+
+        auto li = load_result.unwrap();
+
+        if (li.li_file_range.empty()) {
+            break;
+        }
+
+        retval.emplace_back(li);
+        if (li.li_partial) {
+            break;
+        }
+        prev_line = li.li_file_range;
+    }
+
+    return Ok(std::move(retval));
+}
+
 Result<shared_buffer_ref, std::string> line_buffer::read_range(const file_range fr)
 {
     shared_buffer_ref retval;
@@ -767,7 +2077,9 @@ Result<shared_buffer_ref, std::string> line_buffer::read_range(const file_range
         return Err(string("out-of-bounds"));
     }
 
-    this->fill_range(fr.fr_offset, fr.fr_size);
+    if (!this->fill_range(fr.fr_offset, fr.fr_size) && this->lb_fd_closed) {
+        return Err(string("unable to reopen file"));
+    }
     line_start = this->get_range(fr.fr_offset, avail);
 
     if (fr.fr_size > avail) {
@@ -779,7 +2091,66 @@ Result<shared_buffer_ref, std::string> line_buffer::read_range(const file_range
     return Ok(retval);
 }
 
+Result<off_t, std::string> line_buffer::find_line_start(off_t off)
+{
+    char buffer[4 * 1024];
+
+    require(!this->is_compressed());
+
+    if (!this->ensure_fd_open()) {
+        return Err(string("unable to reopen file"));
+    }
+
+    if (this->lb_framing == framing_t::UNKNOWN) {
+        this->detect_framing();
+    }
+    if (this->is_length_prefixed()) {
+        // A record can contain line feeds and the lengths can only be
+        // followed forward, so the start has to be the start of the file.
+        return Ok((off_t) 0);
+    }
+
+    off_t base = this->lb_has_member_range ?
+                 this->lb_member_range.fr_offset : 0;
+
+    while (off > 0) {
+        ssize_t len = std::min((off_t) sizeof(buffer), off);
+
+        try {
+            this->fetch_source_range(base + off - len, len);
+        } catch (const error &e) {
+            return Err(string(strerror(e.e_err)));
+        }
+
+        ssize_t rc = pread(this->lb_fd, buffer, len, base + off - len);
+
+        if (rc == -1) {
+            return Err(string(strerror(errno)));
+        }
+        if (rc != len) {
+            return Err(string("short-read"));
+        }
+
+        for (ssize_t lpc = len - 1; lpc >= 0; lpc--) {
+            if (buffer[lpc] == '\n') {
+                return Ok(off - len + lpc + 1);
+            }
+        }
+        off -= len;
+    }
+
+    return Ok((off_t) 0);
+}
+
 file_range line_buffer::get_available()
 {
+    if (this->lb_mmap_addr != nullptr) {
+        return {
+            0,
+            std::min(this->lb_buffer_size,
+                     (ssize_t) DEFAULT_LINE_BUFFER_SIZE),
+        };
+    }
+
     return {this->lb_file_offset, this->lb_buffer_size};
 }
@@ -37,7 +37,12 @@
 #include <unistd.h>
 #include <zlib.h>
 
+#include <algorithm>
+#include <atomic>
 #include <exception>
+#include <future>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "base/lnav_log.hh"
@@ -45,12 +50,57 @@
 #include "base/result.h"
 #include "auto_fd.hh"
 #include "auto_mem.hh"
+#include "frame_indexed.hh"
 #include "shared_buffer.hh"
+#include "stream_decoder.hh"
 
 struct line_info {
     file_range li_file_range;
     bool li_partial{false};
     bool li_valid_utf{true};
+    /**
+     * The line was longer than MAX_LINE_BUFFER_SIZE, so this is only the
+     * first part of it and the rest starts at the next offset.
+     */
+    bool li_split{false};
+};
+
+/**
+ * The read end of a pipe whose contents are copied to the end of the file
+ * that a line_buffer reads from.  The data is pulled in by the line_buffer
+ * itself, so the newest part of the pipe is indexed straight out of memory
+ * instead of being read back from the file.  If the pipe carries compressed
+ * data, it is decoded as it arrives and the file holds the decoded text.
+ */
+struct pipe_source {
+    explicit pipe_source(auto_fd fd) : ps_fd(std::move(fd)) {};
+
+    auto_fd ps_fd;              /*< The non-blocking pipe to read from. */
+    off_t ps_size{0};           /*< The amount of data copied to the file. */
+    bool ps_eof{false};         /*< The pipe was closed or had an error. */
+    std::vector<char> ps_scratch; /*< Data that did not fit in the buffer. */
+    stream_filter ps_filter;    /*< Decodes the pipe if it is compressed. */
+};
+
+/**
+ * The source of a file whose contents are fetched as they are needed, like
+ * a remote file that is read with range requests.  The file given to
+ * line_buffer::set_fd() is a sparse local copy that is already full size
+ * and the line_buffer asks for each range to be filled in before reading
+ * it.  The ranges can be asked for from any thread that reads the file.
+ */
+class range_source {
+public:
+    virtual ~range_source() = default;
+
+    /**
+     * Make sure a range of the local copy has been fetched.  The range can
+     * extend past the end of the file.
+     *
+     * @param fr The range of the file that is about to be read.
+     * @return An error message if the range could not be fetched.
+     */
+    virtual Result<void, std::string> fetch_range(file_range fr) = 0;
 };
 
 /**
@@ -66,6 +116,9 @@ class line_buffer {
 public:
     static const ssize_t DEFAULT_LINE_BUFFER_SIZE   = 256 * 1024;
     static const ssize_t MAX_LINE_BUFFER_SIZE       = 4 * 4 * DEFAULT_LINE_BUFFER_SIZE;
+    static const size_t DEFAULT_LINE_BATCH_SIZE     = 512;
+    /** The size of the big-endian length at the start of each record. */
+    static const size_t RECORD_PREFIX_SIZE          = 4;
     class error
         : public std::exception {
 public:
@@ -99,7 +152,13 @@ public:
         }
 
         uLong get_source_offset() {
-            return !!*this ? this->strm.total_in + this->strm.avail_in : 0;
+            if (!*this) {
+                return 0;
+            }
+            if (this->gz_prefetch.valid()) {
+                return this->gz_source_offset;
+            }
+            return this->strm.total_in + this->strm.avail_in;
         }
 
         void close();
@@ -115,12 +174,18 @@ public:
          */
         int read(void * buf, size_t offset, size_t size);
 
+        /** @return The number of bytes used by the syncpoints. */
+        size_t get_syncpoint_memory() const {
+            return this->syncpoints.capacity() * sizeof(indexDict);
+        };
+
         struct indexDict {
             off_t in = 0;
             off_t out = 0;
             unsigned char bits = 0;
             unsigned char in_bits = 0;
             Bytef index[GZ_WINSIZE];
+            indexDict() = default;
             indexDict(z_stream const & s, const off_t size) {
                 assert((s.data_type & GZ_END_OF_BLOCK_MASK));
                 assert(!(s.data_type & GZ_END_OF_FILE_MASK));
@@ -153,26 +218,274 @@ public:
                 return ret;
             }
         };
+
+        /**
+         * @return A copy of the syncpoints found so far, after waiting for
+         *   any running prefetch.
+         */
+        std::vector<indexDict> get_syncpoints();
+
+        /**
+         * Replace the syncpoints with ones found by another reader of the
+         * same file.  They are not saved to the index cache since they
+         * might only cover part of the file.
+         */
+        void use_syncpoints(std::vector<indexDict> syncpoints);
     private:
+        /**
+         * Load the syncpoints saved by a previous session for this file from
+         * the index cache.
+         */
+        void load_syncpoints();
+
+        /**
+         * Save any syncpoints discovered in this session to the index cache.
+         */
+        void save_syncpoints();
+
+        /**
+         * Start inflating the data that follows the current position in a
+         * background thread so that it is ready for the next sequential read.
+         */
+        void start_prefetch();
+
+        /**
+         * Wait for any running prefetch to finish.
+         *
+         * @return The number of bytes that were prefetched.
+         */
+        int finish_prefetch();
+
         z_stream                strm;               /*< gzip streams structure */
         std::vector<indexDict>  syncpoints;         /*< indexed dictionaries as discovered */
         auto_mem<Bytef>         inbuf;              /*< Compressed data buffer */
         int gz_fd = -1;                             /*< The file to read data from. */
+        std::string gz_cache_path;                  /*< Where the syncpoints are saved. */
+        size_t gz_loaded_syncpoints = 0;            /*< Number of syncpoints loaded from the cache. */
+        bool gz_syncpoints_pending = false;         /*< The cache has not been checked yet. */
+        std::future<int> gz_prefetch;               /*< The running prefetch, if any. */
+        auto_mem<unsigned char> gz_prefetch_buffer; /*< Data inflated ahead of the reader. */
+        size_t gz_prefetch_offset = 0;              /*< Uncompressed offset of the prefetched data. */
+        size_t gz_prefetch_start = 0;               /*< Start of the unread prefetched data. */
+        size_t gz_prefetch_size = 0;                /*< Number of valid bytes in the prefetch buffer. */
+        uLong gz_source_offset = 0;                 /*< Compressed offset as of the last read. */
+    };
+
+    /**
+     * A bzip2 file reader that keeps an index of the compressed blocks in the
+     * file so that a random access only needs to decompress the block that
+     * contains the requested data.
+     */
+    class bz_indexed {
+    public:
+        inline operator bool() const {
+            return this->bz_fd != -1;
+        }
+
+        off_t get_source_offset() const {
+            return this->bz_source_offset;
+        }
+
+        void open(int fd);
+
+        void close() {
+            this->bz_fd = -1;
+            this->bz_file_bits = 0;
+            this->bz_scan_bit = 0;
+            this->bz_eof = false;
+            this->bz_blocks.clear();
+            this->bz_cached_block = -1;
+            this->bz_block_data.clear();
+            this->bz_source_offset = 0;
+        }
+
+        /**
+         * Decompress bytes from the bz2 file returning at most `size` bytes.
+         * offset is the byte-offset in the decompressed data stream.
+         */
+        int read(void *buf, size_t offset, size_t size);
+
+        struct block {
+            uint64_t b_start_bit;   /*< Bit offset of the block magic. */
+            uint64_t b_end_bit;     /*< Bit offset of the next magic. */
+            off_t b_out_offset;     /*< Offset of the block's data. */
+            size_t b_out_size;      /*< Size of the block's data. */
+        };
+
+    private:
+        /**
+         * Find the next block or end-of-stream magic number in the file.
+         *
+         * @param from_bit The bit offset to start searching from.
+         * @param bit_out On return, the bit offset of the magic number.
+         * @param eos_out On return, true if it was an end-of-stream marker.
+         * @return True if a magic number was found.
+         */
+        bool find_boundary(uint64_t from_bit, uint64_t &bit_out, bool &eos_out);
+
+        /**
+         * Decompress a single block by wrapping it in a stream of its own.
+         */
+        bool decode_block(uint64_t start_bit, uint64_t end_bit,
+                          std::vector<char> &data_out);
+
+        /**
+         * Add the block after the last indexed one to the index.
+         *
+         * @return True if a block was added, false at the end of the file.
+         */
+        bool index_next_block();
+
+        int bz_fd = -1;                     /*< The file to read data from. */
+        uint64_t bz_file_bits = 0;          /*< The size of the file in bits. */
+        uint64_t bz_scan_bit = 0;           /*< Where the next block is searched for. */
+        bool bz_eof = false;                /*< All the blocks have been indexed. */
+        std::vector<block> bz_blocks;       /*< The blocks found so far. */
+        ssize_t bz_cached_block = -1;       /*< The block in bz_block_data. */
+        std::vector<char> bz_block_data;    /*< The last decompressed block. */
+        off_t bz_source_offset = 0;         /*< The offset into the compressed file. */
     };
 
     /** Construct an empty line_buffer. */
     line_buffer();
 
-    line_buffer(line_buffer &&other) = default;
+    line_buffer(const line_buffer &) = delete;
 
     virtual ~line_buffer();
 
     /** @param fd The file descriptor that data should be pulled from. */
     void set_fd(auto_fd &fd);
 
-    /** @return The file descriptor that data should be pulled from. */
+    /**
+     * Read plain files by mapping them into memory instead of copying their
+     * contents into the internal buffer.  Takes effect on the next call to
+     * set_fd().
+     *
+     * @param enabled True if regular, uncompressed files should be mapped.
+     */
+    void set_mmap_enabled(bool enabled) {
+        this->lb_mmap_enabled = enabled;
+    };
+
+    /**
+     * Read a member of an archive as if it were a file of its own.  The
+     * offsets passed to the other methods are relative to the start of the
+     * member and reads stop at its end.  For a gzipped archive, the range
+     * is in the decompressed data.  This needs to be called after set_fd().
+     *
+     * @param fr The range of the member's data in the file.
+     * @param syncpoints For a gzipped archive, the syncpoints around the
+     *   range, so the data before the member does not have to be inflated.
+     */
+    void set_member_range(file_range fr,
+                          std::vector<gz_indexed::indexDict> syncpoints = {});
+
+    /** @return True if only a member of the file is being read. */
+    bool has_member_range() const {
+        return this->lb_has_member_range;
+    };
+
+    /** @return The range of the member in the file. */
+    const file_range &get_member_range() const {
+        return this->lb_member_range;
+    };
+
+    /**
+     * Append the data from a pipe to the file given to set_fd() as it is
+     * read.  The file needs to be empty when this is called.
+     *
+     * @param ps The pipe to read from.
+     */
+    void set_pipe_source(std::shared_ptr<pipe_source> ps);
+
+    bool has_pipe_source() const {
+        return this->lb_pipe_source != nullptr;
+    };
+
+    /**
+     * Fetch the ranges of the file given to set_fd() from the source before
+     * they are read.  The file has to be a plain, uncompressed one, so it
+     * is read with pread() instead of being mapped.
+     *
+     * @param rs The source of the file's contents.
+     */
+    void set_range_source(std::shared_ptr<range_source> rs);
+
+    bool has_range_source() const {
+        return this->lb_range_source != nullptr;
+    };
+
+    /**
+     * Ask the kernel to start reading a range of a plain file in the
+     * background, so that a later read_range() of it does not block.
+     * Nothing is done for compressed files or pipes.
+     *
+     * @param fr The range of the file that will be read soon.
+     */
+    void prefetch_range(file_range fr);
+
+    /**
+     * Read whatever is available from the pipe source without blocking and
+     * append it to the file.  While the buffer holds the end of the file,
+     * the new data is kept in the buffer as well.
+     *
+     * @return True if any data was read.
+     */
+    bool pull_pipe();
+
+    /** @return True if the file is currently being read through a mapping. */
+    bool is_mapped() const {
+        return this->lb_mmap_addr != nullptr;
+    };
+
+    /**
+     * @return The file descriptor that data should be pulled from.  The
+     *   descriptor can be -1 if it was closed by enforce_fd_limit(), call
+     *   ensure_fd_open() first if it is needed.
+     */
     int get_fd() const { return this->lb_fd; };
 
+    /**
+     * Allow the file descriptor to be closed while the file is idle and
+     * reopened from the given path when it is read again.  Only plain,
+     * uncompressed files are closed.
+     *
+     * @param path The absolute path to the file given to set_fd().
+     */
+    void set_reopen_path(const std::string &path);
+
+    /** @return True if the descriptor was closed to stay under the limit. */
+    bool is_fd_closed() const {
+        return this->lb_fd_closed;
+    };
+
+    /**
+     * Close the file descriptor, if the file can be reopened later.
+     *
+     * @return True if the descriptor was closed.
+     */
+    bool close_fd();
+
+    /**
+     * Reopen the file if the descriptor was closed.  The file at the path
+     * has to be the same one that was closed, the descriptor is left closed
+     * if the file has since been replaced.
+     *
+     * @return True if the descriptor is open.
+     */
+    bool ensure_fd_open();
+
+    /**
+     * Close the descriptors that were least recently used until the number
+     * of descriptors that can be reopened is under the given limit.  Like
+     * enforce_buffer_budget(), this should only be called while no other
+     * thread is reading from a line_buffer.
+     *
+     * @param max_open The number of descriptors that can stay open.
+     * @return The number of descriptors that were closed.
+     */
+    static size_t enforce_fd_limit(size_t max_open);
+
     time_t get_file_time() const { return this->lb_file_time; };
 
     /**
@@ -189,7 +502,34 @@ public:
     };
 
     bool is_compressed() const {
-        return this->lb_gz_file || this->lb_bz_file;
+        return this->lb_gz_file || this->lb_bz_file ||
+               this->lb_frame_file != nullptr;
+    };
+
+    /**
+     * @return True if the file is made up of binary records that each
+     *   start with their length, instead of lines.  The records are
+     *   MessagePack maps and the length is a four byte, big-endian integer
+     *   that does not include itself.  The file_range of a record includes
+     *   the length and, since there is no delimiter, nothing should be
+     *   trimmed from the end of it.  The framing is detected from the start
+     *   of the file the first time a line is loaded.
+     */
+    bool is_length_prefixed() const {
+        return this->lb_framing == framing_t::LENGTH_PREFIXED;
+    };
+
+    /**
+     * @return True if the file is gzipped, which means that random access
+     *   is cheap after the syncpoints have been built.
+     */
+    bool is_gzipped() const {
+        return (bool) this->lb_gz_file;
+    };
+
+    /** @return The number of bytes used to index a gzipped file. */
+    size_t get_syncpoint_memory() const {
+        return this->lb_gz_file.get_syncpoint_memory();
     };
 
     off_t get_read_offset(off_t off) const
@@ -223,35 +563,98 @@ public:
      * line is not NULL-terminated, but this method ensures there is room to NULL
      * terminate the line.  If any modifications are made to the line, such as
      * NULL termination, the invalidate() must be called before re-reading the
-     * line to refresh the buffer.
+     * line to refresh the buffer.  If the file is length-prefixed, the next
+     * record is loaded instead.
      */
     Result<line_info, std::string> load_next_line(file_range prev_line = {});
 
+    /**
+     * Read a batch of lines that follow the given line.  The batch stops
+     * early at a partial line or when reading another line would push the
+     * start of the batch out of the buffer, so the whole batch can be
+     * retrieved with a single call to read_range().
+     *
+     * @param prev_line The line before the batch.
+     * @param max_lines The maximum number of lines to read.
+     * @return The lines that were read, an empty vector at end-of-file.
+     */
+    Result<std::vector<line_info>, std::string> load_next_lines(
+        file_range prev_line = {},
+        size_t max_lines = DEFAULT_LINE_BATCH_SIZE);
+
     Result<shared_buffer_ref, std::string> read_range(file_range fr);
 
+    /**
+     * Find the start of the line that contains the given offset by reading
+     * backward from it.  Only plain files are supported.
+     *
+     * @param off An offset in the file.
+     * @return The offset just past the closest line feed before 'off' or
+     *   zero if there is none.
+     */
+    Result<off_t, std::string> find_line_start(off_t off);
+
     file_range get_available();
 
+    /**
+     * Free the internal buffer.  The buffer is allocated again the next
+     * time data is read, so this is only done for files whose contents can
+     * be read back.
+     *
+     * @return The number of bytes that were freed.
+     */
+    size_t release_buffer();
+
+    /** @return The amount of memory used by the internal buffer. */
+    size_t get_buffer_memory() const {
+        return this->lb_buffer_max;
+    };
+
+    /**
+     * Release the buffers that were least recently used until the memory
+     * used by all of the line_buffers is under the given budget.  This
+     * should only be called while no other thread is reading from a
+     * line_buffer.
+     *
+     * @param budget The number of bytes the buffers can use or zero to
+     *   release every idle buffer.
+     * @return The number of bytes that were freed.
+     */
+    static size_t enforce_buffer_budget(size_t budget);
+
+    /** @return The memory used by the buffers of all the line_buffers. */
+    static size_t get_buffer_usage();
+
     void clear()
     {
+        this->replace_buffer(this->lb_buffer_max, 0, 0);
         this->lb_buffer_size  = 0;
     };
 
     /** Release any resources held by this object. */
     void reset()
     {
+        this->unmap_file();
+        this->lb_use_mmap = false;
         this->lb_fd.reset();
+        this->lb_fd_closed = false;
+        this->update_fd_count();
+        this->lb_pipe_source.reset();
 
         this->lb_file_offset      = 0;
         this->lb_file_size        = (ssize_t)-1;
         this->lb_buffer_size      = 0;
         this->lb_last_line_offset = -1;
+        this->lb_has_member_range = false;
+        this->lb_framing          = framing_t::UNKNOWN;
     };
 
     /** Check the invariants for this object. */
     bool invariant(void)
     {
-        require(this->lb_buffer != NULL);
-        require(this->lb_buffer_size <= this->lb_buffer_max);
+        require(this->lb_buffer != NULL || this->lb_buffer_max == 0);
+        require(this->lb_mmap_addr != nullptr ||
+                this->lb_buffer_size <= this->lb_buffer_max);
 
         return true;
     };
@@ -265,11 +668,53 @@ private:
     bool in_range(off_t off) const
     {
         return this->lb_file_offset <= off &&
-               off < (int)(this->lb_file_offset + this->lb_buffer_size);
+               off < (off_t)(this->lb_file_offset + this->lb_buffer_size);
     };
 
     void resize_buffer(size_t new_max);
 
+    /**
+     * Switch to a new buffer if there are refs to the current one, so that
+     * the data they point to is not overwritten.  The old buffer is retired
+     * to the share manager and freed after the last ref is dropped.
+     *
+     * @param new_max The size of the new buffer.
+     * @param keep_offset The offset of the data to copy to the new buffer.
+     * @param keep_length The amount of data to copy to the new buffer.
+     * @return True if the buffer was replaced, false if there were no refs
+     *   and the current buffer can be changed in place.
+     */
+    bool replace_buffer(size_t new_max, size_t keep_offset, size_t keep_length);
+
+    /** @return True if the descriptor could be closed and reopened. */
+    bool can_close_fd() const {
+        return !this->lb_reopen_path.empty() &&
+               this->lb_seekable &&
+               this->lb_pipe_source == nullptr &&
+               !this->is_compressed();
+    };
+
+    /**
+     * Update the count of open descriptors that enforce_fd_limit() checks
+     * after the descriptor or its settings have changed.
+     */
+    void update_fd_count();
+
+    /**
+     * Map the file into memory, or remap it if it has grown since it was
+     * last mapped.  If the mapping fails, the buffer falls back to reading
+     * the file with pread().
+     *
+     * @return True if the file is mapped.
+     */
+    bool map_file();
+
+    /**
+     * Release the mapping of the file.  If there are shared refs to it, the
+     * mapping is retired and unmapped after the last ref is dropped.
+     */
+    void unmap_file();
+
     /**
      * Ensure there is enough room in the buffer to cache a range of data from
      * the file.  First, this method will check to see if there is enough room
@@ -294,6 +739,52 @@ private:
      */
     bool fill_range(off_t start, ssize_t max_length);
 
+    /**
+     * Ask the range source, if there is one, to fetch a range of the file.
+     * An error from the source is thrown as a line_buffer::error.
+     */
+    void fetch_source_range(off_t offset, ssize_t length);
+
+    /**
+     * Read from a pipe, decoding the data if the start of the pipe turned
+     * out to be compressed.
+     *
+     * @return The number of bytes read or -1 with errno set.
+     */
+    ssize_t read_stream(char *dst, size_t size);
+
+    /**
+     * Append data to the end of the file that is fed by the pipe source and
+     * to the buffer, if it holds the end of the file.
+     *
+     * @param in_buffer True if the data was read straight into the end of
+     * the buffer.
+     */
+    void append_pipe_data(const char *data, size_t len, bool in_buffer);
+
+    /**
+     * Ask the kernel to start reading the data after a read from a plain
+     * file, so that the next read does not block on the storage.  The
+     * window grows as long as the reads are sequential, so a file that is
+     * being indexed quickly gets more data in flight.  Reads that jump
+     * around do not get any read-ahead and, for very large files, the
+     * pages far behind a sequential read are dropped from the cache.
+     *
+     * @param offset The offset that is about to be read.
+     * @param length The amount of data that is about to be read, the
+     *   lb_next_read_offset should be updated after the read finishes.
+     */
+    void advise_readahead(off_t offset, ssize_t length);
+
+    /**
+     * Check the start of the file for a length-prefixed record, the file
+     * is left as unknown until there is enough data to tell.
+     */
+    void detect_framing();
+
+    /** Load the length-prefixed record at the given offset. */
+    Result<line_info, std::string> load_next_record(off_t offset);
+
     /**
      * After a successful fill, the cached data can be retrieved with this
      * method.
@@ -310,6 +801,14 @@ private:
         char *retval;
 
         require(buffer_offset >= 0);
+        if (this->lb_mmap_addr != nullptr) {
+            if (buffer_offset > this->lb_buffer_size) {
+                buffer_offset = this->lb_buffer_size;
+            }
+            avail_out = this->lb_buffer_size - buffer_offset;
+
+            return &this->lb_mmap_addr[buffer_offset];
+        }
         require(this->lb_buffer_size >= buffer_offset);
 
         retval    = &this->lb_buffer[buffer_offset];
@@ -318,14 +817,25 @@ private:
         return retval;
     };
 
-    shared_buffer lb_share_manager;
+    shared_buffer lb_share_manager{shared_buffer::mode_t::GENERATIONS};
+
+    std::shared_ptr<pipe_source> lb_pipe_source; /*< Feeds the file, if set. */
+    std::shared_ptr<range_source> lb_range_source; /*< Fills in the file. */
 
     auto_fd lb_fd;              /*< The file to read data from. */
     gz_indexed  lb_gz_file;     /*< File reader for gzipped files. */
     bool    lb_bz_file;         /*< Flag set for bzip2 compressed files. */
+    bz_indexed lb_bz_index;     /*< File reader for bzip2 compressed files. */
+    std::unique_ptr<frame_indexed> lb_frame_file; /*< File reader for zstd/xz files. */
     off_t   lb_compressed_offset; /*< The offset into the compressed file. */
+    stream_filter lb_stream_filter; /*< Decodes compressed data from a pipe. */
+    std::vector<char> lb_stream_scratch; /*< Raw data read from a pipe. */
 
     auto_mem<char> lb_buffer;   /*< The internal buffer where data is cached */
+    bool   lb_mmap_enabled{false}; /*< Map plain files instead of copying. */
+    bool   lb_use_mmap{false};     /*< The current file can be mapped. */
+    char  *lb_mmap_addr{nullptr};  /*< The mapping of the file, if any. */
+    size_t lb_mmap_size{0};        /*< The size of the file when mapped. */
 
     ssize_t lb_file_size;       /*<
                                  * The size of the file.  When lb_fd refers to
@@ -340,6 +850,26 @@ private:
     ssize_t lb_buffer_size;     /*< The amount of cached data in the buffer. */
     ssize_t lb_buffer_max;      /*< The size of the buffer memory. */
     bool   lb_seekable;         /*< Flag set for seekable file descriptors. */
+    uint64_t lb_last_access{0}; /*< When the buffer was last filled. */
+    std::string lb_reopen_path; /*< The path used to reopen the file. */
+    dev_t  lb_reopen_dev{0};    /*< The device of the file that was closed. */
+    ino_t  lb_reopen_ino{0};    /*< The inode of the file that was closed. */
+    bool   lb_fd_closed{false}; /*< The descriptor was closed while idle. */
+    bool   lb_fd_counted{false}; /*< The descriptor is in the open count. */
     off_t  lb_last_line_offset; /*< */
+    off_t  lb_next_read_offset{-1}; /*< Where a sequential read would start. */
+    off_t  lb_readahead_end{0};     /*< The end of the data asked for so far. */
+    ssize_t lb_readahead_size{0};   /*< The current read-ahead window. */
+    off_t  lb_dropped_offset{0};    /*< The pages before this were dropped. */
+    bool   lb_has_member_range{false}; /*< Only lb_member_range is read. */
+    file_range lb_member_range;     /*< The archive member being read. */
+
+    enum class framing_t {
+        UNKNOWN,
+        LINES,
+        LENGTH_PREFIXED,
+    };
+
+    framing_t lb_framing{framing_t::UNKNOWN}; /*< How the data is split. */
 };
 #endif
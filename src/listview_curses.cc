@@ -37,6 +37,7 @@
 #include <cmath>
 
 #include "base/lnav_log.hh"
+#include "base/perf_counter.hh"
 #include "listview_curses.hh"
 
 using namespace std;
@@ -65,9 +66,40 @@ void listview_curses::reload_data()
             this->lv_selection = this->get_inner_height() - 1_vl;
         }
     }
+    this->invalidate_wrap_cache();
     this->vc_needs_update = true;
 }
 
+int listview_curses::wrapped_height(vis_line_t row, unsigned long width) const
+{
+    static const size_t MAX_WRAP_HEIGHTS = 64 * 1024;
+
+    bool cacheable = this->lv_source->listview_is_size_cacheable(*this);
+
+    if (cacheable) {
+        if (width != this->lv_wrap_width ||
+            this->lv_wrap_heights.size() >= MAX_WRAP_HEIGHTS) {
+            this->lv_wrap_heights.clear();
+            this->lv_wrap_width = width;
+        }
+
+        auto iter = this->lv_wrap_heights.find(row);
+
+        if (iter != this->lv_wrap_heights.end()) {
+            return iter->second;
+        }
+    }
+
+    size_t len = this->lv_source->listview_size_for_row(*this, row);
+    int retval = len == 0 || width == 0 ? 1 : (len + width - 1) / width;
+
+    if (cacheable) {
+        this->lv_wrap_heights[row] = retval;
+    }
+
+    return retval;
+}
+
 bool listview_curses::handle_key(int ch)
 {
     for (auto &lv_input_delegate : this->lv_input_delegates) {
@@ -183,9 +215,10 @@ void listview_curses::do_update()
     }
 
     if (this->vc_needs_update) {
+        perf_timer render_timer(perf_stage_t::RENDER);
         view_colors &vc = view_colors::singleton();
         vis_line_t        height, row;
-        attr_line_t       overlay_line;
+        attr_line_t       &overlay_line = this->lv_overlay_line;
         struct line_range lr;
         unsigned long     width, wrap_width;
         size_t            row_count;
@@ -203,8 +236,36 @@ void listview_curses::do_update()
         row_count = this->get_inner_height();
         row   = this->lv_top;
         bottom = y + height;
-        vector<attr_line_t> rows(min((size_t) height, row_count - (int) this->lv_top));
+        // The rows are kept from one update to the next so that their
+        // strings and attributes reuse the memory from the last frame
+        // instead of allocating it again for every row.
+        auto &rows = this->lv_rows;
+
+        rows.resize(min((size_t) height, row_count - (int) this->lv_top));
+        for (auto &al : rows) {
+            al.clear();
+        }
+        overlay_line.clear();
         this->lv_source->listview_value_for_rows(*this, row, rows);
+        render_timer.add(rows.size());
+
+        // Rows that would be drawn the same as they were last time are
+        // skipped, curses only sends the changes to the terminal but
+        // drawing the rows into the window is not free.
+        int max_y, max_x;
+        size_t seed = std::hash<const void *>()(this);
+
+        getmaxyx(this->lv_window, max_y, max_x);
+        seed = seed * 31 + this->lv_x;
+        seed = seed * 31 + width;
+        seed = seed * 31 + wrap_width;
+        seed = seed * 31 + max_y;
+        seed = seed * 31 + max_x;
+        seed = seed * 31 + height;
+        seed = seed * 31 + this->lv_word_wrap;
+        seed = seed * 31 + this->lv_show_scrollbar;
+        seed = seed * 31 + this->lv_show_bottom_border;
+
         while (y < bottom) {
             lr.lr_start = this->lv_left;
             lr.lr_end   = this->lv_left + wrap_width;
@@ -214,7 +275,13 @@ void listview_curses::do_update()
                     y - this->lv_y, bottom - this->lv_y,
                     row,
                     overlay_line)) {
-                mvwattrline(this->lv_window, y, this->lv_x, overlay_line, lr);
+                size_t stamp = row_stamp(seed, overlay_line, lr,
+                                         view_colors::VCR_TEXT);
+
+                if (!is_row_current(this->lv_window, y, stamp)) {
+                    mvwattrline(this->lv_window, y, this->lv_x, overlay_line, lr);
+                    set_row_stamp(this->lv_window, y, stamp);
+                }
                 overlay_line.clear();
                 ++y;
             }
@@ -222,10 +289,16 @@ void listview_curses::do_update()
                 attr_line_t &al = rows[row - this->lv_top];
 
                 do {
-                    mvwattrline(this->lv_window, y, this->lv_x, al, lr,
-                                this->vc_default_role);
-                    if (this->lv_word_wrap) {
-                        mvwhline(this->lv_window, y, this->lv_x + wrap_width, ' ', width - wrap_width);
+                    size_t stamp = row_stamp(seed, al, lr,
+                                             this->vc_default_role);
+
+                    if (!is_row_current(this->lv_window, y, stamp)) {
+                        mvwattrline(this->lv_window, y, this->lv_x, al, lr,
+                                    this->vc_default_role);
+                        if (this->lv_word_wrap) {
+                            mvwhline(this->lv_window, y, this->lv_x + wrap_width, ' ', width - wrap_width);
+                        }
+                        set_row_stamp(this->lv_window, y, stamp);
                     }
                     lr.lr_start += wrap_width;
                     lr.lr_end += wrap_width;
@@ -237,6 +310,7 @@ void listview_curses::do_update()
                 wattron(this->lv_window, role_attrs);
                 mvwhline(this->lv_window, y, this->lv_x, ' ', width);
                 wattroff(this->lv_window, role_attrs);
+                set_row_stamp(this->lv_window, y, 0);
                 ++y;
             }
         }
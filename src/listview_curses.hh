@@ -36,6 +36,7 @@
 
 #include <list>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <algorithm>
 
@@ -79,6 +80,16 @@ public:
     virtual size_t listview_size_for_row(const listview_curses &lv,
         vis_line_t row) = 0;
 
+    /**
+     * @return True if the size of a row only changes when the view is
+     *   reloaded, so the number of screen rows it takes when wrapped can be
+     *   kept.  A source that changes in some other way must call
+     *   listview_curses::invalidate_wrap_cache().
+     */
+    virtual bool listview_is_size_cacheable(const listview_curses &lv) const {
+        return false;
+    };
+
     virtual std::string listview_source_name(const listview_curses &lv) {
         return "";
     };
@@ -275,12 +286,7 @@ public:
 
             width -= 1;
             while ((height > 0) && (line >= 0) && ((size_t)line < row_count)) {
-                size_t len = this->lv_source->listview_size_for_row(*this, line);
-
-                do {
-                    len -= std::min((size_t)width, len);
-                    --height;
-                } while (len > 0);
+                height -= vis_line_t(this->wrapped_height(line, width));
                 line += vis_line_t(dir);
                 if (height >= 0) {
                     ++retval;
@@ -531,6 +537,11 @@ public:
     /** This method should be called when the data source has changed. */
     virtual void reload_data();
 
+    /** Forget the wrapped heights of the rows. */
+    void invalidate_wrap_cache() {
+        this->lv_wrap_heights.clear();
+    };
+
     /**
      * @param ch The input to be handled.
      * @return True if the key was eaten by this view.
@@ -562,6 +573,13 @@ public:
     }
 
 protected:
+    /**
+     * @param row The row to measure.
+     * @param width The width the row is wrapped at.
+     * @return The number of screen rows the row takes up when wrapped.
+     */
+    int wrapped_height(vis_line_t row, unsigned long width) const;
+
     void delegate_scroll_out() {
         for (auto &lv_input_delegate : this->lv_input_delegates) {
             lv_input_delegate->list_input_handle_scroll_out(*this);
@@ -594,6 +612,10 @@ protected:
     bool lv_show_bottom_border{false};
     list_gutter_source *lv_gutter_source{&DEFAULT_GUTTER_SOURCE};
     bool lv_word_wrap{false};
+    /** The number of screen rows each row takes up when wrapped. */
+    mutable std::unordered_map<int, int> lv_wrap_heights;
+    /** The width the heights in lv_wrap_heights were computed for. */
+    mutable unsigned long lv_wrap_width{0};
     bool lv_selectable{false};
     vis_line_t lv_selection{0};
 
@@ -603,5 +625,8 @@ protected:
     int lv_mouse_y{-1};
     lv_mode_t lv_mouse_mode{LV_MODE_NONE};
     vis_line_t lv_tail_space{1};
+    /** The rows drawn in the last update, kept to reuse their memory. */
+    std::vector<attr_line_t> lv_rows;
+    attr_line_t lv_overlay_line;
 };
 #endif
@@ -70,6 +70,7 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <chrono>
 #include <algorithm>
 #include <functional>
 
@@ -126,6 +127,11 @@
 #include "file_vtab.hh"
 #include "regexp_vtab.hh"
 #include "fstat_vtab.hh"
+#include "parquet_vtab.hh"
+#include "perf_vtab.hh"
+#include "memory_governor.hh"
+#include "task_pool.hh"
+#include "frame_tracer.hh"
 #include "textfile_highlighters.hh"
 
 #ifdef HAVE_LIBCURL
@@ -141,9 +147,13 @@
 #include "readline_possibilities.hh"
 #include "field_overlay_source.hh"
 #include "url_loader.hh"
+#include "url_range_source.hh"
 #include "log_search_table.hh"
 #include "shlex.hh"
 #include "log_actions.hh"
+#include "journal_source.hh"
+#include "archive_source.hh"
+#include "remote_agent.hh"
 
 #ifndef SYSCONFDIR
 #define SYSCONFDIR "/usr/etc"
@@ -153,6 +163,12 @@ using namespace std;
 
 static multimap<lnav_flags_t, string> DEFAULT_FILES;
 
+/**
+ * How long the main loop spends indexing new data before it goes back to
+ * handling input and redrawing the screen.
+ */
+static const auto INDEX_TIME_SLICE = chrono::milliseconds(50);
+
 struct _lnav_data lnav_data;
 
 const int ZOOM_LEVELS[] = {
@@ -229,15 +245,23 @@ static std::vector<std::string> DEFAULT_DB_KEY_NAMES = {
 
 const static size_t MAX_STDIN_CAPTURE_SIZE = 10 * 1024 * 1024;
 
-static void regenerate_unique_file_names()
-{
-    unique_path_generator upg;
+/**
+ * Generates the unique names for the open files, it is kept up-to-date as
+ * files are opened and closed so only the names of files with the same
+ * base name are generated again.
+ */
+static unique_path_generator UNIQUE_PATHS;
 
-    for (auto lf : lnav_data.ld_files) {
-        upg.add_source(shared_ptr<logfile>(lf));
-    }
+static void add_unique_file_name(const shared_ptr<logfile> &lf)
+{
+    UNIQUE_PATHS.add_source(lf);
+    UNIQUE_PATHS.generate();
+}
 
-    upg.generate();
+static void remove_unique_file_name(const shared_ptr<logfile> &lf)
+{
+    UNIQUE_PATHS.remove_source(lf);
+    UNIQUE_PATHS.generate();
 }
 
 bool setup_logline_table(exec_context &ec)
@@ -247,6 +271,7 @@ bool setup_logline_table(exec_context &ec)
         "log_path",
         "log_text",
         "log_body",
+        "log_time_us",
 
         nullptr
     };
@@ -376,12 +401,12 @@ public:
 
     };
 
-    void logfile_indexing(logfile &lf, off_t off, size_t total)
+    bool logfile_indexing(logfile &lf, off_t off, size_t total)
     {
         static sig_atomic_t index_counter = 0;
 
         if (lnav_data.ld_flags & (LNF_HEADLESS|LNF_CHECK_CONFIG)) {
-            return;
+            return true;
         }
 
         /* XXX require(off <= total); */
@@ -399,9 +424,24 @@ public:
         if (!lnav_data.ld_looping) {
             throw logfile::error(lf.get_filename(), EINTR);
         }
+
+        // Stop at the end of this batch so that the keypress can be
+        // handled, the main loop will resume the indexing afterward.
+        return !this->input_pending();
     };
 
 private:
+    bool input_pending() const
+    {
+        if (!lnav_data.ld_input_ready) {
+            return false;
+        }
+
+        struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+
+        return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+    };
+
     void do_update()
     {
         lnav_data.ld_top_source.update_time();
@@ -416,13 +456,21 @@ private:
 
 class hist_index_delegate : public index_delegate {
 public:
+    /**
+     * The time slice of the copy of the histogram that is kept so that any
+     * zoom level that is a multiple of it can be built without a pass over
+     * the log.
+     */
+    static const int64_t BASE_TIME_SLICE = 60;
+
     hist_index_delegate(hist_source2 &hs, textview_curses &tc)
             : hid_source(hs), hid_view(tc) {
-
+        this->hid_base.set_time_slice(BASE_TIME_SLICE);
     };
 
     void index_start(logfile_sub_source &lss) {
         this->hid_source.clear();
+        this->hid_base.clear();
     };
 
     void index_line(logfile_sub_source &lss, logfile *lf, logfile::iterator ll) {
@@ -430,33 +478,72 @@ public:
             return;
         }
 
-        hist_source2::hist_type_t ht;
-
-        switch (ll->get_msg_level()) {
-            case LEVEL_FATAL:
-            case LEVEL_CRITICAL:
-            case LEVEL_ERROR:
-                ht = hist_source2::HT_ERROR;
-                break;
-            case LEVEL_WARNING:
-                ht = hist_source2::HT_WARNING;
-                break;
-            default:
-                ht = hist_source2::HT_NORMAL;
-                break;
-        }
+        auto ht = type_for_line(*ll);
 
         this->hid_source.add_value(ll->get_time(), ht);
+        this->hid_base.add_value(ll->get_time(), ht);
         if (ll->is_marked()) {
             this->hid_source.add_value(ll->get_time(), hist_source2::HT_MARK);
+            this->hid_base.add_value(ll->get_time(), hist_source2::HT_MARK);
         }
     };
 
+    bool supports_line_removal() const {
+        return true;
+    };
+
+    void index_line_removed(logfile_sub_source &lss, logfile *lf, logfile::iterator ll) {
+        if (ll->is_continued() || ll->get_time() == 0) {
+            return;
+        }
+
+        auto ht = type_for_line(*ll);
+
+        this->hid_source.update_value(ll->get_time(), ht, -1);
+        this->hid_base.update_value(ll->get_time(), ht, -1);
+        if (ll->is_marked()) {
+            this->hid_source.update_value(ll->get_time(),
+                                          hist_source2::HT_MARK, -1);
+            this->hid_base.update_value(ll->get_time(),
+                                        hist_source2::HT_MARK, -1);
+        }
+        this->hid_removed_lines = true;
+    };
+
     void index_complete(logfile_sub_source &lss) {
+        if (this->hid_removed_lines) {
+            this->hid_source.rebuild_chart();
+            this->hid_base.rebuild_chart();
+            this->hid_removed_lines = false;
+        }
         this->hid_view.reload_data();
     };
 
+    /**
+     * Build the histogram for the given time slice from the base copy.
+     *
+     * @return False if the slice is finer than the base copy.
+     */
+    bool restore_from_base(int64_t slice) {
+        return this->hid_source.merge_from(this->hid_base, slice);
+    };
+
 private:
+    static hist_source2::hist_type_t type_for_line(const logline &ll) {
+        switch (ll.get_msg_level()) {
+            case LEVEL_FATAL:
+            case LEVEL_CRITICAL:
+            case LEVEL_ERROR:
+                return hist_source2::HT_ERROR;
+            case LEVEL_WARNING:
+                return hist_source2::HT_WARNING;
+            default:
+                return hist_source2::HT_NORMAL;
+        }
+    };
+
+    hist_source2 hid_base;
+    bool hid_removed_lines{false};
     hist_source2 &hid_source;
     textview_curses &hid_view;
 };
@@ -467,8 +554,44 @@ void rebuild_hist()
     hist_source2 &hs = lnav_data.ld_hist_source2;
     int zoom = lnav_data.ld_zoom_level;
 
-    hs.set_time_slice(ZOOM_LEVELS[zoom]);
-    lss.reload_index_delegate();
+    if (lss.get_index_delegate() == nullptr) {
+        // In headless mode, the histogram is only kept up-to-date after it
+        // has been viewed.
+        lss.set_index_delegate(new hist_index_delegate(
+            hs, lnav_data.ld_views[LNV_HISTOGRAM]));
+    }
+
+    // The counts are kept up-to-date as lines are indexed, so a full pass
+    // over the log is only needed when zooming in below the resolution of
+    // the delegate's base copy.  Otherwise, the buckets are merged and the
+    // marks, which can change without an index update, are recounted.
+    if (!hs.rescale(ZOOM_LEVELS[zoom])) {
+        auto hid = dynamic_cast<hist_index_delegate *>(
+            lss.get_index_delegate());
+
+        if (hid == nullptr || !hid->restore_from_base(ZOOM_LEVELS[zoom])) {
+            lss.reload_index_delegate();
+            return;
+        }
+    }
+
+    auto &bv = lnav_data.ld_views[LNV_LOG].get_bookmarks()[&textview_curses::BM_USER];
+
+    hs.clear_values(hist_source2::HT_MARK);
+    for (const auto &vl : bv) {
+        if (vl >= (ssize_t) lss.text_line_count()) {
+            continue;
+        }
+
+        auto ll = lss.find_line(lss.at(vl));
+
+        if (ll->is_continued() || ll->get_time() == 0) {
+            continue;
+        }
+        hs.update_value(ll->get_time(), hist_source2::HT_MARK, 1);
+    }
+    hs.rebuild_chart();
+    lnav_data.ld_views[LNV_HISTOGRAM].reload_data();
 }
 
 class textfile_callback {
@@ -483,9 +606,10 @@ public:
         auto file_iter = find(lnav_data.ld_files.begin(),
                               lnav_data.ld_files.end(),
                               lf);
+        lnav_data.ld_file_watcher.unwatch(lf->get_watch_descriptor());
         lnav_data.ld_files.erase(file_iter);
 
-        regenerate_unique_file_names();
+        remove_unique_file_name(lf);
     };
 
     void promote_file(const shared_ptr<logfile> &lf) {
@@ -521,7 +645,7 @@ public:
     int front_top;
 };
 
-void rebuild_indexes()
+void rebuild_indexes(logfile::deadline_t deadline)
 {
     logfile_sub_source &lss = lnav_data.ld_log_source;
     textview_curses &log_view  = lnav_data.ld_views[LNV_LOG];
@@ -541,7 +665,7 @@ void rebuild_indexes()
         textfile_sub_source *tss = &lnav_data.ld_text_source;
         textfile_callback cb;
 
-        if (tss->rescan_files(cb)) {
+        if (tss->rescan_files(cb, deadline)) {
             text_view.reload_data();
         }
 
@@ -574,16 +698,20 @@ void rebuild_indexes()
             }
             lnav_data.ld_text_source.remove(lf);
             lnav_data.ld_log_source.remove_file(lf);
+            lnav_data.ld_file_watcher.unwatch(lf->get_watch_descriptor());
             file_iter = lnav_data.ld_files.erase(file_iter);
 
-            regenerate_unique_file_names();
+            remove_unique_file_name(lf);
         }
         else {
             ++file_iter;
         }
     }
 
-    logfile_sub_source::rebuild_result result = lss.rebuild_index();
+    logfile_sub_source::rebuild_result result = lss.rebuild_index(deadline);
+    line_buffer::enforce_buffer_budget(lnav_config.lc_tuning_buffer_budget);
+    line_buffer::enforce_fd_limit(lnav_config.lc_tuning_max_open_files);
+    memory_governor::singleton().check();
     if (result != logfile_sub_source::rebuild_result::rr_no_change) {
         size_t new_count = lss.text_line_count();
         bool force =
@@ -611,6 +739,21 @@ void rebuild_indexes()
     };
 }
 
+/**
+ * @return True if a file stopped indexing at the deadline passed to the last
+ * rebuild_indexes() and needs another call to catch up.
+ */
+static bool indexing_incomplete()
+{
+    for (auto &lf : lnav_data.ld_files) {
+        if (lf->is_indexing_incomplete()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 static bool append_default_files(lnav_flags_t flag)
 {
     bool retval = true;
@@ -652,6 +795,13 @@ static bool append_default_files(lnav_flags_t flag)
 
 static void sigint(int sig)
 {
+    // A Ctrl-C while a query is running only cancels the query.
+    if (sig == SIGINT && lnav_data.ld_sql_running) {
+        lnav_data.ld_sql_interrupted = true;
+        sqlite3_interrupt(lnav_data.ld_db.in());
+        return;
+    }
+
     lnav_data.ld_looping = false;
 }
 
@@ -840,6 +990,8 @@ static void usage()
         "  -t         Prepend timestamps to the lines of data being read in\n"
         "             on the standard input.\n"
         "  -w file    Write the contents of the standard input to this file.\n"
+        "  -A file    Run as an agent that follows the given file for an lnav\n"
+        "             on another host, see the 'host:/path' argument below.\n"
         "\n"
         "  -c cmd     Execute a command after the files have been loaded.\n"
         "  -f path    Execute the commands in the given file.\n"
@@ -850,7 +1002,11 @@ static void usage()
         "Optional arguments:\n"
         "  logfile1          The log files or directories to view.  If a\n"
         "                    directory is given, all of the files in the\n"
-        "                    directory will be loaded.\n"
+        "                    directory will be loaded.  A file on another\n"
+        "                    host can be given as 'host:/path', it is\n"
+        "                    followed by running 'lnav -A' there with ssh.\n"
+        "                    The systemd journal can be given as 'journal:',\n"
+        "                    followed by any extra journalctl arguments.\n"
         "\n"
         "Examples:\n"
         "  To load and follow the syslog file:\n"
@@ -878,26 +1034,151 @@ static void clear_last_user_mark(void *, listview_curses *lv)
 }
 
 /**
- * Functor used to compare files based on their device and inode number.
+ * The open log files keyed by their device and inode numbers, so the files
+ * found by expanding the file name patterns can be matched against them
+ * without comparing every one.
  */
-struct same_file {
-    same_file(const struct stat &stat) : sf_stat(stat) { };
+using file_id_map = map<pair<dev_t, ino_t>, shared_ptr<logfile>>;
 
-    /**
-     * Compare the given log file against the 'stat' given in the constructor.
-     * @param  lf The log file to compare.
-     * @return    True if the dev/inode values in the stat given in the
-     *   constructor matches the stat in the logfile object.
-     */
-    bool operator()(const shared_ptr<logfile> &lf) const
-    {
-        return this->sf_stat.st_dev == lf->get_stat().st_dev &&
-               this->sf_stat.st_ino == lf->get_stat().st_ino;
-    };
+static file_id_map build_file_ids()
+{
+    file_id_map retval;
+
+    for (const auto &lf : lnav_data.ld_files) {
+        const struct stat &st = lf->get_stat();
+
+        // The members of an archive share its inode.
+        if (lf->is_archive_member()) {
+            continue;
+        }
+        retval[make_pair(st.st_dev, st.st_ino)] = lf;
+    }
 
-    const struct stat &sf_stat;
+    return retval;
+}
+
+/**
+ * The directory watch for a file name pattern.  The pattern only needs to
+ * be expanded again after something has changed in the directory.
+ */
+struct glob_watch {
+    int gw_descriptor{-1};
+    bool gw_expanded{false};
 };
 
+static map<string, glob_watch> GLOB_WATCHES;
+
+/**
+ * Start watching the directory of a file name pattern if it has not been
+ * done yet.
+ *
+ * @return True if the directory is being watched, otherwise the pattern
+ *   has to be expanded every time.
+ */
+static bool watch_glob_dir(const string &path, glob_watch &gw)
+{
+    if (gw.gw_descriptor != -1) {
+        return true;
+    }
+
+    auto slash = path.rfind('/');
+
+    if (slash == string::npos) {
+        return false;
+    }
+
+    string dir = slash == 0 ? "/" : path.substr(0, slash);
+
+    // Only a fixed directory can be watched.
+    if (dir.find_first_of("*?[") != string::npos) {
+        return false;
+    }
+
+    gw.gw_descriptor = lnav_data.ld_file_watcher.watch_dir(dir);
+
+    return gw.gw_descriptor != -1;
+}
+
+/**
+ * Make the patterns whose directories changed be expanded again.
+ *
+ * @param changed The watch descriptors from file_watcher::read_events().
+ */
+static void glob_dirs_changed(const vector<int> &changed)
+{
+    for (auto &gw_pair : GLOB_WATCHES) {
+        auto &gw = gw_pair.second;
+
+        if (gw.gw_descriptor != -1 &&
+            find(changed.begin(), changed.end(), gw.gw_descriptor) !=
+            changed.end()) {
+            gw.gw_expanded = false;
+            // The directory might have been removed or replaced, so the
+            // watch is added again when the pattern is expanded.
+            gw.gw_descriptor = -1;
+        }
+    }
+}
+
+/**
+ * Open each file in a tar archive as a logfile that reads its data straight
+ * out of the archive.
+ *
+ * @param filename The path to the archive.
+ * @param obs The observer for the new files.
+ * @return True if any files were opened.
+ */
+static bool open_archive_members(const string &filename,
+                                 logfile_observer *obs)
+{
+    auto index_res = index_tar_archive(filename);
+
+    if (index_res.isErr()) {
+        log_error("unable to read archive: %s -- %s",
+                  filename.c_str(), index_res.unwrapErr().c_str());
+        return false;
+    }
+
+    auto ai = index_res.unwrap();
+    bool retval = false;
+
+    for (const auto &am : ai.ai_members) {
+        auto member_name = filename + "/" + am.am_name;
+        logfile_open_options loo;
+        auto_fd fd(open(filename.c_str(), O_RDONLY));
+
+        if (fd == -1) {
+            log_error("unable to open archive: %s -- %s",
+                      filename.c_str(), strerror(errno));
+            break;
+        }
+        fd.close_on_exec();
+        loo.with_fd(std::move(fd))
+           .with_archive_member(am.am_range, am.am_mtime,
+                                ai.syncpoints_for(am));
+        if (lnav_data.ld_flags & LNF_HEADLESS) {
+            loo.with_sequential_access(true);
+        }
+
+        try {
+            auto lf = make_shared<logfile>(member_name, loo);
+
+            log_info("loading archive member: filename=%s",
+                     member_name.c_str());
+            lf->set_logfile_observer(obs);
+            lnav_data.ld_files.push_back(lf);
+            lnav_data.ld_text_source.push_back(lf);
+            add_unique_file_name(lf);
+            retval = true;
+        } catch (const logfile::error &e) {
+            log_error("unable to open archive member: %s -- %s",
+                      member_name.c_str(), strerror(e.e_err));
+        }
+    }
+
+    return retval;
+}
+
 /**
  * Try to load the given file as a log file.  If the file has not already been
  * loaded, it will be loaded.  If the file has already been loaded, the file
@@ -906,8 +1187,12 @@ struct same_file {
  * @param filename The file name to check.
  * @param fd       An already-opened descriptor for 'filename'.
  * @param required Specifies whether or not the file must exist and be valid.
+ * @param file_ids The files that are already open, a new file is added.
  */
-static bool watch_logfile(string filename, logfile_open_options &loo, bool required)
+static bool watch_logfile(string filename,
+                          logfile_open_options &loo,
+                          bool required,
+                          file_id_map &file_ids)
 {
     static loading_observer obs;
     struct stat st;
@@ -956,11 +1241,9 @@ static bool watch_logfile(string filename, logfile_open_options &loo, bool requi
         }
     }
 
-    auto file_iter = find_if(lnav_data.ld_files.begin(),
-                             lnav_data.ld_files.end(),
-                             same_file(st));
+    auto file_iter = file_ids.find(make_pair(st.st_dev, st.st_ino));
 
-    if (file_iter == lnav_data.ld_files.end()) {
+    if (file_iter == file_ids.end()) {
         if (find(lnav_data.ld_other_files.begin(),
                  lnav_data.ld_other_files.end(),
                  filename) == lnav_data.ld_other_files.end()) {
@@ -973,17 +1256,31 @@ static bool watch_logfile(string filename, logfile_open_options &loo, bool requi
                 retval = true;
                 break;
 
+            case FF_TAR_ARCHIVE:
+                lnav_data.ld_other_files.push_back(filename);
+                retval = open_archive_members(filename, &obs);
+                break;
+
             default:
                 /* It's a new file, load it in. */
+                if (lnav_data.ld_flags & LNF_HEADLESS) {
+                    loo.with_sequential_access(true);
+                }
+                // Make room for the new file's descriptor.
+                line_buffer::enforce_fd_limit(
+                    lnav_config.lc_tuning_max_open_files);
                 shared_ptr<logfile> lf = make_shared<logfile>(filename, loo);
 
                 log_info("loading new file: filename=%s",
                          filename.c_str());
                 lf->set_logfile_observer(&obs);
+                lf->set_watch_descriptor(
+                    lnav_data.ld_file_watcher.watch(filename));
                 lnav_data.ld_files.push_back(lf);
                 lnav_data.ld_text_source.push_back(lf);
+                file_ids[make_pair(st.st_dev, st.st_ino)] = lf;
 
-                regenerate_unique_file_names();
+                add_unique_file_name(lf);
 
                 retval = true;
                 break;
@@ -994,7 +1291,13 @@ static bool watch_logfile(string filename, logfile_open_options &loo, bool requi
         /* The file is already loaded, but has been found under a different
          * name.  We just need to update the stored file name.
          */
-        (*file_iter)->set_filename(filename);
+        auto &lf = file_iter->second;
+
+        if (lf->get_filename() != filename) {
+            remove_unique_file_name(lf);
+            lf->set_filename(filename);
+            add_unique_file_name(lf);
+        }
     }
 
     return retval;
@@ -1005,8 +1308,9 @@ static bool watch_logfile(string filename, logfile_open_options &loo, bool requi
  * the pattern.
  * @param path     The glob pattern to expand.
  * @param required Passed to watch_logfile.
+ * @param file_ids The files that are already open.
  */
-static void expand_filename(string path, bool required)
+static void expand_filename(string path, bool required, file_id_map &file_ids)
 {
     static_root_mem<glob_t, globfree> gl;
 
@@ -1041,7 +1345,7 @@ static void expand_filename(string path, bool required)
             else if (required || access(abspath.in(), R_OK) == 0) {
                 logfile_open_options loo;
 
-                watch_logfile(abspath.in(), loo, required);
+                watch_logfile(abspath.in(), loo, required, file_ids);
             }
         }
     }
@@ -1051,20 +1355,39 @@ bool rescan_files(bool required)
 {
     map<string, logfile_open_options>::iterator iter;
     bool retval = false;
+    file_id_map file_ids;
+    bool file_ids_built = false;
+    auto get_file_ids = [&]() -> file_id_map & {
+        if (!file_ids_built) {
+            file_ids = build_file_ids();
+            file_ids_built = true;
+        }
+        return file_ids;
+    };
 
     for (iter = lnav_data.ld_file_names.begin();
          iter != lnav_data.ld_file_names.end();
          iter++) {
         if (iter->second.loo_fd == -1) {
-            expand_filename(iter->first, required);
+            auto &gw = GLOB_WATCHES[iter->first];
+
+            // Nothing new can match the pattern until something changes in
+            // the directory.
+            if (!required && gw.gw_expanded) {
+                continue;
+            }
+            gw.gw_expanded = watch_glob_dir(iter->first, gw);
+
+            expand_filename(iter->first, required, get_file_ids());
             if (lnav_data.ld_flags & LNF_ROTATED) {
                 string path = iter->first + ".*";
 
-                expand_filename(path, false);
+                expand_filename(path, false, get_file_ids());
             }
         } else {
             retval = retval ||
-                     watch_logfile(iter->first, iter->second, required);
+                     watch_logfile(iter->first, iter->second, required,
+                                   get_file_ids());
         }
     }
 
@@ -1309,6 +1632,123 @@ static void wait_for_pipers()
     }
 }
 
+/**
+ * Turn off the user's filters and highlights whose patterns keep hitting the
+ * regex match limits, so a single pattern that backtracks badly does not
+ * slow down everything else.
+ */
+static void disable_expensive_patterns()
+{
+    string disabled;
+
+    for (auto &tc : lnav_data.ld_views) {
+        auto *tss = tc.get_sub_source();
+
+        if (tss != nullptr) {
+            bool changed = false;
+
+            for (auto &filter : tss->get_filters()) {
+                if (!filter->is_enabled() || !filter->is_over_budget()) {
+                    continue;
+                }
+
+                log_warning("disabling expensive filter -- %s",
+                            filter->get_id().c_str());
+                filter->disable();
+                disabled = filter->get_id();
+                changed = true;
+            }
+            if (changed) {
+                tss->text_filters_changed();
+            }
+        }
+
+        const auto &const_tc = tc;
+        auto &const_hm = const_tc.get_highlights();
+        bool over_budget = any_of(
+            const_hm.begin(), const_hm.end(), [](const auto &pair) {
+                return pair.first.first != highlight_source_t::INTERNAL &&
+                       pair.second.is_over_budget();
+            });
+
+        if (!over_budget) {
+            continue;
+        }
+
+        auto &hm = tc.get_highlights();
+
+        for (auto iter = hm.begin(); iter != hm.end();) {
+            if (iter->first.first != highlight_source_t::INTERNAL &&
+                iter->second.is_over_budget()) {
+                log_warning("removing expensive highlight -- %s",
+                            iter->first.second.c_str());
+                disabled = iter->first.second;
+                iter = hm.erase(iter);
+            }
+            else {
+                ++iter;
+            }
+        }
+    }
+
+    if (!disabled.empty() && lnav_data.ld_rl_view != nullptr) {
+        lnav_data.ld_rl_view->set_value(
+            "warning: turned off " ANSI_BOLD_START + disabled + ANSI_NORM
+            " since it kept hitting the regex match limit");
+    }
+}
+
+/**
+ * Let the memory governor shed the caches that can be refilled when lnav
+ * is using too much memory.  The line buffers are the cheapest to refill
+ * since it is only a read of the file.
+ */
+static void register_memory_caches()
+{
+    auto &mg = memory_governor::singleton();
+
+    mg.register_cache(
+        "line-buffers", 1,
+        []() { return line_buffer::get_buffer_usage(); },
+        [](size_t amount) {
+            size_t usage = line_buffer::get_buffer_usage();
+
+            return line_buffer::enforce_buffer_budget(
+                usage > amount ? usage - amount : 0);
+        });
+    mg.register_cache(
+        "json-lines", 2,
+        []() {
+            size_t retval = 0;
+
+            for (auto &lf : lnav_data.ld_files) {
+                auto format = lf->get_format();
+
+                if (format != nullptr) {
+                    retval += format->get_cache_memory();
+                }
+            }
+
+            return retval;
+        },
+        [](size_t amount) {
+            size_t retval = 0;
+
+            for (auto &lf : lnav_data.ld_files) {
+                auto format = lf->get_format();
+
+                if (retval >= amount) {
+                    break;
+                }
+                if (format != nullptr) {
+                    retval += format->shed_caches();
+                }
+            }
+
+            return retval;
+        });
+}
+
 static void looper()
 {
     try {
@@ -1379,6 +1819,9 @@ static void looper()
         (void)cbreak();
         (void)noecho();
         (void)nodelay(lnav_data.ld_window, 1);
+        // Let curses scroll the terminal when the views are scrolled
+        // instead of sending every row again.
+        (void)idlok(lnav_data.ld_window, TRUE);
 
 #ifdef VDSUSP
         {
@@ -1521,6 +1964,7 @@ static void looper()
         struct timeval current_time;
 
         static sig_atomic_t index_counter;
+        struct timeval last_watch_events = { 0, 0 };
 
 
         timer.start_fade(index_counter, 1);
@@ -1532,29 +1976,72 @@ static void looper()
 
             gettimeofday(&current_time, nullptr);
 
+            auto &ft = frame_tracer::singleton();
+
+            ft.update_config();
+            ft.begin_frame();
+
             lnav_data.ld_top_source.update_time(current_time);
+            lnav_data.ld_top_source.update_frame_time(ft);
 
             layout_views();
 
-            rescan_files();
-            rebuild_indexes();
+            {
+                frame_tracer::span rescan_span("rescan_files");
 
-            lnav_data.ld_view_stack.do_update();
-            lnav_data.ld_doc_view.do_update();
-            lnav_data.ld_example_view.do_update();
-            lnav_data.ld_match_view.do_update();
-            lnav_data.ld_preview_view.do_update();
-            for (auto &sc : lnav_data.ld_status) {
-                sc.do_update();
+                rescan_files();
             }
-            rlc.do_update();
-            if (lnav_data.ld_filter_source.fss_editing) {
-                lnav_data.ld_filter_source.fss_match_view.set_needs_update();
+            {
+                frame_tracer::span rebuild_span("rebuild_indexes");
+
+                rebuild_indexes(chrono::steady_clock::now() + INDEX_TIME_SLICE);
+            }
+            bool preview_pending = lnav_data.ld_filter_source.update_preview(
+                chrono::steady_clock::now() + INDEX_TIME_SLICE);
+            disable_expensive_patterns();
+
+            {
+                string top_name;
+
+                if (ft.is_tracing()) {
+                    lnav_data.ld_view_stack.top() | [&top_name] (auto tc) {
+                        top_name = tc->get_title();
+                    };
+                }
+
+                frame_tracer::span render_span("render", top_name);
+
+                lnav_data.ld_view_stack.do_update();
             }
-            lnav_data.ld_filter_view.set_needs_update();
-            lnav_data.ld_filter_view.do_update();
-            refresh();
+            {
+                frame_tracer::span panels_span("render", "panels");
 
+                lnav_data.ld_doc_view.do_update();
+                lnav_data.ld_example_view.do_update();
+                lnav_data.ld_match_view.do_update();
+                lnav_data.ld_preview_view.do_update();
+            }
+            {
+                frame_tracer::span status_span("render", "status");
+
+                for (auto &sc : lnav_data.ld_status) {
+                    sc.do_update();
+                }
+                rlc.do_update();
+                if (lnav_data.ld_filter_source.fss_editing) {
+                    lnav_data.ld_filter_source.fss_match_view.set_needs_update();
+                }
+                lnav_data.ld_filter_view.set_needs_update();
+                lnav_data.ld_filter_view.do_update();
+            }
+            {
+                frame_tracer::span refresh_span("doupdate");
+
+                refresh();
+            }
+            ft.end_frame();
+
+            lnav_data.ld_input_ready = session_loaded;
             if (session_loaded) {
                 // Only take input from the user after everything has loaded.
                 pollfds.push_back((struct pollfd) {
@@ -1570,10 +2057,42 @@ static void looper()
                 tc.update_poll_set(pollfds);
             }
 
+            auto &pool = task_pool::singleton();
+
+            if (pool.get_notify_fd() != -1) {
+                pollfds.push_back((struct pollfd) {
+                    pool.get_notify_fd(),
+                    POLLIN,
+                    0
+                });
+            }
+
+            // Files that are written to constantly would otherwise wake
+            // the loop up for every write.
+            struct timeval watch_diff;
+
+            timersub(&current_time, &last_watch_events, &watch_diff);
+            if (lnav_data.ld_file_watcher.get_fd() != -1 &&
+                (watch_diff.tv_sec > 0 || watch_diff.tv_usec >= 100000)) {
+                pollfds.push_back((struct pollfd) {
+                    lnav_data.ld_file_watcher.get_fd(),
+                    POLLIN,
+                    0
+                });
+            }
+
             if (lnav_data.ld_input_dispatcher.in_escape()) {
                 to.tv_usec = 15000;
             }
-            rc = poll(&pollfds[0], pollfds.size(), to.tv_usec / 1000);
+            if (indexing_incomplete() || preview_pending) {
+                // Only check for input before indexing the next slice.
+                to.tv_usec = 0;
+            }
+            {
+                frame_tracer::span poll_span("poll");
+
+                rc = poll(&pollfds[0], pollfds.size(), to.tv_usec / 1000);
+            }
 
             gettimeofday(&current_time, nullptr);
             lnav_data.ld_input_dispatcher.poll(current_time);
@@ -1594,7 +2113,10 @@ static void looper()
                 if (pollfd_ready(pollfds, STDIN_FILENO)) {
                     int ch;
 
+                    frame_tracer::span input_span("input");
+
                     while ((ch = getch()) != ERR) {
+                        ft.input_received();
                         alerter::singleton().new_input(ch);
 
                         lnav_data.ld_input_dispatcher.new_input(current_time, ch);
@@ -1622,6 +2144,26 @@ static void looper()
 
                 rlc.check_poll_set(pollfds);
                 lnav_data.ld_filter_source.fss_editor.check_poll_set(pollfds);
+
+                if (pool.get_notify_fd() != -1 &&
+                    pollfd_ready(pollfds, pool.get_notify_fd())) {
+                    pool.run_completions();
+                }
+
+                if (lnav_data.ld_file_watcher.get_fd() != -1 &&
+                    pollfd_ready(pollfds, lnav_data.ld_file_watcher.get_fd())) {
+                    auto changed = lnav_data.ld_file_watcher.read_events();
+
+                    glob_dirs_changed(changed);
+                    // The files are re-indexed at the top of the loop.
+                    for (auto &lf : lnav_data.ld_files) {
+                        if (find(changed.begin(), changed.end(),
+                                 lf->get_watch_descriptor()) != changed.end()) {
+                            lf->set_change_pending();
+                        }
+                    }
+                    last_watch_events = current_time;
+                }
             }
 
             if (timer.time_to_update(overlay_counter)) {
@@ -1639,7 +2181,8 @@ static void looper()
                 else {
                     timer.start_fade(index_counter, 3);
                 }
-                rebuild_indexes();
+                rebuild_indexes(
+                    chrono::steady_clock::now() + INDEX_TIME_SLICE);
                 if (!initial_build &&
                         lnav_data.ld_log_source.text_line_count() == 0 &&
                         lnav_data.ld_text_source.text_line_count() > 0) {
@@ -1673,7 +2216,9 @@ static void looper()
                     initial_build = true;
                 }
 
-                if (!session_loaded) {
+                // The session refers to lines all over the files, so wait
+                // for the initial indexing to finish.
+                if (!session_loaded && !indexing_incomplete()) {
                     load_session();
                     if (!lnav_data.ld_session_file_names.empty()) {
                         std::string ago;
@@ -1815,6 +2360,7 @@ int main(int argc, char *argv[])
 
     shared_ptr<piper_proc> stdin_reader;
     const char *         stdin_out = nullptr;
+    const char *         agent_path = nullptr;
     int                  stdin_out_fd = -1;
     bool exec_stdin = false;
     const char *LANG = getenv("LANG");
@@ -1860,7 +2406,7 @@ int main(int argc, char *argv[])
     lnav_data.ld_config_paths.emplace_back("/etc/lnav");
     lnav_data.ld_config_paths.emplace_back(SYSCONFDIR "/lnav");
     lnav_data.ld_config_paths.emplace_back(dotlnav_path());
-    while ((c = getopt(argc, argv, "hHarRCc:I:iuf:d:nqtw:vVW")) != -1) {
+    while ((c = getopt(argc, argv, "hHA:arRCc:I:iuf:d:nqtw:vVW")) != -1) {
         switch (c) {
         case 'h':
             usage();
@@ -1871,6 +2417,10 @@ int main(int argc, char *argv[])
             lnav_data.ld_flags |= LNF_HELP;
             break;
 
+        case 'A':
+            agent_path = optarg;
+            break;
+
         case 'C':
             lnav_data.ld_flags |= LNF_CHECK_CONFIG;
             break;
@@ -1987,6 +2537,10 @@ int main(int argc, char *argv[])
     lnav_log_file = fopen(lnav_data.ld_debug_log_name, "a");
     log_info("lnav started");
 
+    if (agent_path != nullptr) {
+        return run_remote_agent(agent_path);
+    }
+
     load_config(lnav_data.ld_config_paths, config_errors);
     if (!config_errors.empty()) {
         print_errors(config_errors);
@@ -2103,6 +2657,9 @@ int main(int argc, char *argv[])
     register_file_vtab(lnav_data.ld_db.in());
     register_regexp_vtab(lnav_data.ld_db.in());
     register_fstat_vtab(lnav_data.ld_db.in());
+    register_parquet_vtab(lnav_data.ld_db.in());
+    register_perf_vtab(lnav_data.ld_db.in());
+    register_memory_caches();
 
     lnav_data.ld_vtab_manager =
         new log_vtab_manager(lnav_data.ld_db,
@@ -2125,6 +2682,7 @@ int main(int argc, char *argv[])
         }
     }
 
+    lnav_data.ld_vtab_manager->begin_batch();
     lnav_data.ld_vtab_manager->register_vtab(new all_logs_vtab());
     lnav_data.ld_vtab_manager->register_vtab(new log_format_vtab_impl(
             *log_format::find_root_format("generic_log")));
@@ -2137,8 +2695,12 @@ int main(int argc, char *argv[])
         }
     }
 
+    lnav_data.ld_vtab_manager->end_batch();
+
     load_format_extra(lnav_data.ld_db.in(), lnav_data.ld_config_paths, loader_errors);
+    lnav_data.ld_vtab_manager->begin_batch();
     load_format_vtabs(lnav_data.ld_vtab_manager, loader_errors);
+    lnav_data.ld_vtab_manager->end_batch();
     if (!loader_errors.empty()) {
         print_errors(loader_errors);
         return EXIT_FAILURE;
@@ -2196,9 +2758,13 @@ int main(int argc, char *argv[])
     {
         hist_source2 &hs = lnav_data.ld_hist_source2;
 
-        lnav_data.ld_log_source.set_index_delegate(
+        // Nobody sees the histogram in headless mode unless a command
+        // switches to it, so rebuild_hist() adds the delegate on demand.
+        if (!(lnav_data.ld_flags & LNF_HEADLESS)) {
+            lnav_data.ld_log_source.set_index_delegate(
                 new hist_index_delegate(lnav_data.ld_hist_source2,
-                        lnav_data.ld_views[LNV_HISTOGRAM]));
+                                        lnav_data.ld_views[LNV_HISTOGRAM]));
+        }
         hs.init();
         lnav_data.ld_zoom_level = 3;
         hs.set_time_slice(ZOOM_LEVELS[lnav_data.ld_zoom_level]);
@@ -2253,13 +2819,81 @@ int main(int argc, char *argv[])
         }
 #ifdef HAVE_LIBCURL
         else if (is_url(argv[lpc])) {
-            unique_ptr<url_loader> ul(new url_loader(argv[lpc]));
+            auto range_res = url_range_source::open(argv[lpc]);
 
-            lnav_data.ld_file_names[argv[lpc]]
-                .with_fd(ul->copy_fd());
-            lnav_data.ld_curl_looper.add_request(ul.release());
+            if (range_res.isOk()) {
+                auto rs = range_res.unwrap();
+
+                lnav_data.ld_file_names[argv[lpc]]
+                    .with_fd(rs->copy_fd())
+                    .with_range_source(rs);
+            } else {
+                log_info("%s: downloading the whole file -- %s",
+                         argv[lpc],
+                         range_res.unwrapErr().c_str());
+
+                unique_ptr<url_loader> ul(new url_loader(argv[lpc]));
+
+                lnav_data.ld_file_names[argv[lpc]]
+                    .with_fd(ul->copy_fd());
+                lnav_data.ld_curl_looper.add_request(ul.release());
+            }
         }
 #endif
+        else if (is_journal_path(argv[lpc]) && access(argv[lpc], F_OK) == -1) {
+            auto reader_result = start_journal_reader(argv[lpc]);
+
+            if (reader_result.isErr()) {
+                fprintf(stderr,
+                        "error: unable to read the journal: %s -- %s\n",
+                        argv[lpc],
+                        reader_result.unwrapErr().c_str());
+                retval = EXIT_FAILURE;
+                continue;
+            }
+
+            auto reader = reader_result.unwrap();
+            auto temp_fd = open_temp_file(
+                system_tmpdir() / "lnav.journal.XXXXXX")
+                .then([](auto pair) { pair.first.remove_file(); })
+                .expect("Cannot create temporary file for the journal")
+                .second;
+            auto ps = make_shared<pipe_source>(std::move(reader.jrp_output));
+
+            lnav_data.ld_children.push_back(reader.jrp_child);
+            lnav_data.ld_pipers.push_back(make_shared<piper_proc>(ps));
+            lnav_data.ld_file_names[argv[lpc]]
+                .with_fd(temp_fd)
+                .with_pipe_source(ps);
+        }
+        else if (is_remote_path(argv[lpc]) && access(argv[lpc], F_OK) == -1) {
+            auto agent_result = start_remote_agent(argv[lpc]);
+
+            if (agent_result.isErr()) {
+                fprintf(stderr,
+                        "error: unable to follow remote file: %s -- %s\n",
+                        argv[lpc],
+                        agent_result.unwrapErr().c_str());
+                retval = EXIT_FAILURE;
+                continue;
+            }
+
+            auto agent = agent_result.unwrap();
+            // The lines are read straight from the agent's pipe and kept
+            // in a temporary file, like the standard input.
+            auto temp_fd = open_temp_file(
+                system_tmpdir() / "lnav.remote.XXXXXX")
+                .then([](auto pair) { pair.first.remove_file(); })
+                .expect("Cannot create temporary file for remote file")
+                .second;
+            auto ps = make_shared<pipe_source>(std::move(agent.rap_output));
+
+            lnav_data.ld_children.push_back(agent.rap_child);
+            lnav_data.ld_pipers.push_back(make_shared<piper_proc>(ps));
+            lnav_data.ld_file_names[argv[lpc]]
+                .with_fd(temp_fd)
+                .with_pipe_source(ps);
+        }
         else if (is_glob(argv[lpc])) {
             lnav_data.ld_file_names[argv[lpc]] = default_loo;
         }
@@ -2400,10 +3034,22 @@ int main(int argc, char *argv[])
             }
         }
 
-        stdin_reader = make_shared<piper_proc>(
-            STDIN_FILENO, lnav_data.ld_flags & LNF_TIMESTAMP, stdin_out_fd);
-        lnav_data.ld_file_names["stdin"]
-            .with_fd(stdin_out_fd);
+        if (lnav_data.ld_flags & LNF_TIMESTAMP) {
+            stdin_reader = make_shared<piper_proc>(
+                STDIN_FILENO, true, stdin_out_fd);
+            lnav_data.ld_file_names["stdin"]
+                .with_fd(stdin_out_fd);
+        } else {
+            // Without timestamps, the lines can go straight from the pipe
+            // to the logfile's buffer.
+            auto ps = make_shared<pipe_source>(auto_fd(dup(STDIN_FILENO)));
+
+            ps->ps_fd.close_on_exec();
+            stdin_reader = make_shared<piper_proc>(ps);
+            lnav_data.ld_file_names["stdin"]
+                .with_fd(stdin_out_fd)
+                .with_pipe_source(ps);
+        }
         if (dup2(STDOUT_FILENO, STDIN_FILENO) == -1) {
             perror("cannot dup stdout to stdin");
         }
@@ -44,6 +44,7 @@
 #include <memory>
 
 #include "logfile.hh"
+#include "file_watcher.hh"
 #include "hist_source.hh"
 #include "statusview_curses.hh"
 #include "listview_curses.hh"
@@ -68,6 +69,7 @@
 #include "filter_sub_source.hh"
 #include "filter_status_source.hh"
 #include "preview_status_source.hh"
+#include "sql_util.hh"
 
 /** The command modes that are available while viewing a file. */
 typedef enum {
@@ -228,6 +230,7 @@ struct _lnav_data {
     std::vector<filesystem::path>           ld_config_paths;
     std::map<std::string, logfile_open_options> ld_file_names;
     std::vector<std::shared_ptr<logfile>>   ld_files;
+    file_watcher                            ld_file_watcher;
     std::list<std::string>                  ld_other_files;
     std::set<std::string>                   ld_closed_files;
     std::list<std::pair<std::string, int> > ld_files_to_front;
@@ -236,7 +239,13 @@ struct _lnav_data {
     time_t                                  ld_pt_max_time;
     bool                                    ld_stdout_used;
     sig_atomic_t                            ld_looping;
+    /** True once the main loop is taking keyboard input. */
+    bool                                    ld_input_ready;
     sig_atomic_t                            ld_winched;
+    /** True while a query is being executed for the user. */
+    sig_atomic_t                            ld_sql_running;
+    /** Set when the user interrupts the running query with Ctrl-C. */
+    sig_atomic_t                            ld_sql_interrupted;
     sig_atomic_t                            ld_child_terminated;
     unsigned long                           ld_flags;
     WINDOW *                                ld_window;
@@ -293,6 +302,8 @@ struct _lnav_data {
 
     log_vtab_manager *                      ld_vtab_manager;
     auto_mem<sqlite3, sqlite_close_wrapper> ld_db;
+    /** Declared after ld_db so the statements are finalized first. */
+    sql_stmt_cache                          ld_stmt_cache;
 
     std::unordered_map<std::string, std::string> ld_table_ddl;
 
@@ -330,7 +341,7 @@ extern const ssize_t ZOOM_COUNT;
     "Press " ANSI_BOLD(#x) "/" ANSI_BOLD(#y) " " msg
 
 void rebuild_hist();
-void rebuild_indexes();
+void rebuild_indexes(logfile::deadline_t deadline = nonstd::nullopt);
 void execute_examples();
 attr_line_t eval_example(const help_text &ht, const help_example &ex);
 
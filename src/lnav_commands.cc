@@ -33,6 +33,7 @@
 #include <sys/stat.h>
 
 #include <string>
+#include <thread>
 #include <vector>
 #include <fstream>
 #include <unordered_map>
@@ -50,14 +51,19 @@
 #include "session_data.hh"
 #include "command_executor.hh"
 #include "url_loader.hh"
+#include "url_range_source.hh"
 #include "readline_curses.hh"
 #include "relative_time.hh"
 #include "log_search_table.hh"
+#include "batch_pipe_writer.hh"
 #include "shlex.hh"
+#include "sql_export.hh"
 #include "sysclip.hh"
 #include "yajl/api/yajl_parse.h"
 #include "db_sub_source.hh"
 #include "papertrail_proc.hh"
+#include "remote_agent.hh"
+#include "task_pool.hh"
 #include "yajlpp/json_op.hh"
 
 using namespace std;
@@ -501,12 +507,13 @@ static void yajl_writer(void *context, const char *str, size_t len)
 static void json_write_row(yajl_gen handle, int row)
 {
     db_label_source &dls = lnav_data.ld_db_row_source;
+    const auto &cells = dls.dls_rows[row];
     yajlpp_map obj_map(handle);
 
     for (size_t col = 0; col < dls.dls_headers.size(); col++) {
         obj_map.gen(dls.dls_headers[col].hm_name);
 
-        if (dls.dls_rows[row][col] == db_label_source::NULL_STR) {
+        if (cells[col] == db_label_source::NULL_STR) {
             obj_map.gen();
             continue;
         }
@@ -516,8 +523,8 @@ static void json_write_row(yajl_gen handle, int row)
         switch (hm.hm_column_type) {
         case SQLITE_FLOAT:
         case SQLITE_INTEGER:
-            yajl_gen_number(handle, dls.dls_rows[row][col],
-                strlen(dls.dls_rows[row][col]));
+            yajl_gen_number(handle, cells[col],
+                strlen(cells[col]));
             break;
         case SQLITE_TEXT:
             switch (hm.hm_sub_type) {
@@ -531,13 +538,13 @@ static void json_write_row(yajl_gen handle, int row)
                     jo.jo_ptr_data = handle;
                     parse_handle.reset(yajl_alloc(&json_op::ptr_callbacks, nullptr, &jo));
 
-                    const unsigned char *json_in = (const unsigned char *) dls.dls_rows[row][col];
+                    const unsigned char *json_in = (const unsigned char *) cells[col];
                     switch (yajl_parse(parse_handle.in(), json_in, strlen((const char *) json_in))) {
                         case yajl_status_error:
                         case yajl_status_client_canceled:
                             err = yajl_get_error(parse_handle.in(), 0, json_in, strlen((const char *) json_in));
                             log_error("unable to parse JSON cell: %s", err);
-                            obj_map.gen(dls.dls_rows[row][col]);
+                            obj_map.gen(cells[col]);
                             return;
                         default:
                             break;
@@ -548,7 +555,7 @@ static void json_write_row(yajl_gen handle, int row)
                         case yajl_status_client_canceled:
                             err = yajl_get_error(parse_handle.in(), 0, json_in, strlen((const char *) json_in));
                             log_error("unable to parse JSON cell: %s", err);
-                            obj_map.gen(dls.dls_rows[row][col]);
+                            obj_map.gen(cells[col]);
                             return;
                         default:
                             break;
@@ -556,12 +563,12 @@ static void json_write_row(yajl_gen handle, int row)
                     break;
                 }
                 default:
-                    obj_map.gen(dls.dls_rows[row][col]);
+                    obj_map.gen(cells[col]);
                     break;
             }
             break;
         default:
-            obj_map.gen(dls.dls_rows[row][col]);
+            obj_map.gen(cells[col]);
             break;
         }
     }
@@ -706,8 +713,6 @@ static string com_save_to(exec_context &ec, string cmdline, vector<string> &args
     int line_count = 0;
 
     if (args[0] == "write-csv-to") {
-        std::vector<std::vector<const char *> >::iterator row_iter;
-        std::vector<const char *>::iterator iter;
         std::vector<db_label_source::header_meta>::iterator hdr_iter;
         bool first = true;
 
@@ -722,22 +727,17 @@ static string com_save_to(exec_context &ec, string cmdline, vector<string> &args
         }
         fprintf(outfile, "\n");
 
-        for (row_iter = dls.dls_rows.begin();
-             row_iter != dls.dls_rows.end();
-             ++row_iter) {
-            if (ec.ec_dry_run &&
-                distance(dls.dls_rows.begin(), row_iter) > 10) {
+        for (size_t row = 0; row < dls.dls_rows.size(); row++) {
+            if (ec.ec_dry_run && row > 10) {
                 break;
             }
 
             first = true;
-            for (iter = row_iter->begin();
-                 iter != row_iter->end();
-                 ++iter) {
+            for (const auto cell : dls.dls_rows[row]) {
                 if (!first) {
                     fprintf(outfile, ",");
                 }
-                csv_write_string(outfile, *iter);
+                csv_write_string(outfile, cell);
                 first = false;
             }
             fprintf(outfile, "\n");
@@ -808,21 +808,13 @@ static string com_save_to(exec_context &ec, string cmdline, vector<string> &args
     }
     else if (args[0] == "write-raw-to") {
         if (tc == &lnav_data.ld_views[LNV_DB]) {
-            std::vector<std::vector<const char *> >::iterator row_iter;
-            std::vector<const char *>::iterator iter;
-
-            for (row_iter = dls.dls_rows.begin();
-                 row_iter != dls.dls_rows.end();
-                 ++row_iter) {
-                if (ec.ec_dry_run &&
-                    distance(dls.dls_rows.begin(), row_iter) > 10) {
+            for (size_t row = 0; row < dls.dls_rows.size(); row++) {
+                if (ec.ec_dry_run && row > 10) {
                     break;
                 }
 
-                for (iter = row_iter->begin();
-                     iter != row_iter->end();
-                     ++iter) {
-                    fputs(*iter, outfile);
+                for (const auto cell : dls.dls_rows[row]) {
+                    fputs(cell, outfile);
                 }
                 fprintf(outfile, "\n");
 
@@ -896,6 +888,67 @@ static string com_save_to(exec_context &ec, string cmdline, vector<string> &args
     return retval;
 }
 
+static string com_export_to(exec_context &ec, string cmdline, vector<string> &args)
+{
+    if (args.empty()) {
+        args.emplace_back("filename");
+        return "";
+    }
+
+    if (lnav_data.ld_flags & LNF_SECURE_MODE) {
+        return "error: " + args[0] + " -- unavailable in secure mode";
+    }
+
+    if (args.size() < 3) {
+        return "error: expecting a file name and a query";
+    }
+
+    if (ec.ec_dry_run) {
+        return "";
+    }
+
+    vector<string> split_args;
+    shlex lexer(args[1]);
+    scoped_resolver scopes = {
+        &ec.ec_local_vars.top(),
+        &ec.ec_global_vars,
+    };
+
+    if (!lexer.split(split_args, scopes) || split_args.size() != 1) {
+        return "error: unable to parse file name";
+    }
+
+    auto create_res = sql_exporter::create(split_args[0]);
+
+    if (create_res.isErr()) {
+        return "error: " + create_res.unwrapErr();
+    }
+
+    auto exporter = create_res.unwrap();
+    string query = remaining_args(cmdline, args, 2);
+    string alt_msg;
+    auto old_callback = ec.ec_sql_callback;
+
+    // The rows go straight to the file instead of the DB view.
+    ec.ec_sql_callback = sql_export_callback;
+    sql_exporter::se_active = exporter.get();
+    string retval = execute_sql(ec, query, alt_msg);
+    sql_exporter::se_active = nullptr;
+    ec.ec_sql_callback = old_callback;
+
+    auto finish_res = exporter->finish();
+
+    if (startswith(retval, "error:")) {
+        return retval;
+    }
+    if (finish_res.isErr()) {
+        return "error: " + finish_res.unwrapErr();
+    }
+
+    return "info: wrote " + to_string(finish_res.unwrap()) + " rows to " +
+           split_args[0];
+}
+
 static string com_pipe_to(exec_context &ec, string cmdline, vector<string> &args)
 {
     string retval = "error: expecting command to execute";
@@ -995,6 +1048,10 @@ static string com_pipe_to(exec_context &ec, string cmdline, vector<string> &args
 
             lnav_data.ld_children.push_back(child_pid);
 
+            // The lines are fed to the child from another thread so a slow
+            // command does not hold up the UI.
+            batch_pipe_writer writer(in_pipe.write_end());
+
             future<string> reader;
 
             if (out_pipe.read_end() != -1) {
@@ -1009,32 +1066,50 @@ static string com_pipe_to(exec_context &ec, string cmdline, vector<string> &args
                     logfile_sub_source &lss = lnav_data.ld_log_source;
                     content_line_t cl = lss.at(tc->get_top());
                     std::shared_ptr<logfile> lf = lss.find(cl);
-                    shared_buffer_ref sbr;
-                    lf->read_full_message(lf->message_start(lf->begin() + cl), sbr);
-                    if (write(in_pipe.write_end(), sbr.get_data(), sbr.length()) == -1) {
-                        return "warning: Unable to write to pipe -- " + string(strerror(errno));
+                    auto msg_start = lf->message_start(lf->begin() + cl);
+                    int write_errno = 0;
+                    bool wrote_chunk = false;
+                    auto write_chunk = [&](const shared_buffer_ref &sbr) {
+                        wrote_chunk = true;
+                        if (!writer.append(sbr.get_data(), sbr.length())) {
+                            write_errno = writer.get_errno();
+                            return false;
+                        }
+                        return true;
+                    };
+
+                    if (!lf->read_message_chunks(
+                        msg_start, line_buffer::DEFAULT_LINE_BUFFER_SIZE,
+                        write_chunk) && !wrote_chunk) {
+                        shared_buffer_ref sbr;
+
+                        lf->read_full_message(msg_start, sbr);
+                        write_chunk(sbr);
+                    }
+                    if (write_errno != 0) {
+                        return "warning: Unable to write to pipe -- " + string(strerror(write_errno));
                     }
-                    log_perror(write(in_pipe.write_end(), "\n", 1));
+                    writer.append("\n", 1);
                 }
                 else {
                     tc->grep_value_for_line(tc->get_top(), line);
-                    if (write(in_pipe.write_end(), line.c_str(), line.size()) == -1) {
-                        return "warning: Unable to write to pipe -- " + string(strerror(errno));
+                    line.push_back('\n');
+                    if (!writer.append(line)) {
+                        return "warning: Unable to write to pipe -- " + string(strerror(writer.get_errno()));
                     }
-                    log_perror(write(in_pipe.write_end(), "\n", 1));
                 }
             }
             else {
                 for (iter = bv.begin(); iter != bv.end(); iter++) {
                     tc->grep_value_for_line(*iter, line);
-                    if (write(in_pipe.write_end(), line.c_str(), line.size()) == -1) {
-                        return "warning: Unable to write to pipe -- " + string(strerror(errno));
+                    line.push_back('\n');
+                    if (!writer.append(line)) {
+                        return "warning: Unable to write to pipe -- " + string(strerror(writer.get_errno()));
                     }
-                    log_perror(write(in_pipe.write_end(), "\n", 1));
                 }
             }
 
-            in_pipe.write_end().reset();
+            writer.finish();
 
             if (reader.valid()) {
                 retval = reader.get();
@@ -1127,7 +1202,7 @@ static string com_highlight(exec_context &ec, string cmdline, vector<string> &ar
                 hl_attrs |= A_BLINK;
             }
 
-            hl.with_attrs(hl_attrs);
+            hl.with_pattern(args[1]).with_attrs(hl_attrs);
 
             if (ec.ec_dry_run) {
                 hm[{highlight_source_t::PREVIEW, "preview"}] = hl;
@@ -1288,6 +1363,60 @@ static string com_filter(exec_context &ec, string cmdline, vector<string> &args)
     return retval;
 }
 
+static string com_filter_expr(exec_context &ec, string cmdline, vector<string> &args)
+{
+    string retval = "error: expecting an SQL expression to filter with";
+
+    if (args.empty()) {
+        args.emplace_back("filter-expr");
+
+        return "";
+    }
+
+    auto tc = *lnav_data.ld_view_stack.top();
+    auto tss = tc->get_sub_source();
+
+    if (!tss->tss_supports_filtering) {
+        retval = "error: view does not support filtering";
+    }
+    else if (args.size() > 1) {
+        filter_stack &fs = tss->get_filters();
+        auto_mem<sqlite3_stmt> stmt(sqlite3_finalize);
+        auto expr = trim(remaining_args(cmdline, args));
+        auto stmt_str = "SELECT 1 WHERE " + expr;
+
+        args[1] = expr;
+        if (fs.get_filter(expr) != nullptr) {
+            retval = com_enable_filter(ec, cmdline, args);
+        }
+        else if (fs.full()) {
+            retval = "error: filter limit reached";
+        }
+        else if (sqlite3_prepare_v2(lnav_data.ld_db.in(),
+                                    stmt_str.c_str(),
+                                    stmt_str.size(),
+                                    stmt.out(),
+                                    nullptr) != SQLITE_OK) {
+            retval = "error: " + string(sqlite3_errmsg(lnav_data.ld_db.in()));
+        }
+        else if (ec.ec_dry_run) {
+            retval = "";
+        }
+        else {
+            auto sf = make_shared<sql_filter>(expr, fs.next_index(), stmt.release());
+
+            log_debug("filter-expr [%d] %s", sf->get_index(), expr.c_str());
+            fs.add_filter(sf);
+            tss->text_filters_changed();
+            tc->reload_data();
+
+            retval = "info: filter now active";
+        }
+    }
+
+    return retval;
+}
+
 static string com_delete_filter(exec_context &ec, string cmdline, vector<string> &args)
 {
     string retval = "error: expecting a filter to delete";
@@ -1510,6 +1639,47 @@ static string com_delete_logline_table(exec_context &ec, string cmdline, vector<
 
 static std::set<string> custom_search_tables;
 
+static string com_remote_query(exec_context &ec, string cmdline, vector<string> &args)
+{
+    if (args.empty()) {
+        return "";
+    }
+
+    if (args.size() < 4) {
+        return "error: expecting a table name, the remote files, and a query";
+    }
+
+    if (ec.ec_dry_run) {
+        return "";
+    }
+
+    vector<string> remote_paths;
+    string query = remaining_args(cmdline, args, 3);
+    size_t start = 0;
+
+    while (start <= args[2].size()) {
+        size_t comma = args[2].find(',', start);
+
+        if (comma == string::npos) {
+            comma = args[2].size();
+        }
+        if (comma > start) {
+            remote_paths.emplace_back(args[2].substr(start, comma - start));
+        }
+        start = comma + 1;
+    }
+
+    string errmsg = create_remote_query_table(
+        lnav_data.ld_db.in(), args[1], remote_paths, query);
+
+    if (!errmsg.empty()) {
+        return "error: " + errmsg;
+    }
+
+    return "info: created table " + args[1] + " with the results from " +
+           to_string(remote_paths.size()) + " remote file(s)";
+}
+
 static string com_create_search_table(exec_context &ec, string cmdline, vector<string> &args)
 {
     string retval = "error: expecting a table name";
@@ -1625,6 +1795,61 @@ static string com_delete_search_table(exec_context &ec, string cmdline, vector<s
     return retval;
 }
 
+static string com_create_materialized_view(exec_context &ec,
+                                          string cmdline,
+                                          vector<string> &args)
+{
+    string retval = "error: expecting a table name and a query";
+
+    if (args.empty()) {
+
+    }
+    else if (args.size() >= 3) {
+        if (ec.ec_dry_run) {
+            return "";
+        }
+
+        string query = remaining_args(cmdline, args, 2);
+        string errmsg = create_materialized_view(args[1], query);
+
+        if (errmsg.empty()) {
+            retval = "info: created new materialized view -- " + args[1];
+        }
+        else {
+            retval = "error: unable to create materialized view -- " + errmsg;
+        }
+    }
+
+    return retval;
+}
+
+static string com_delete_materialized_view(exec_context &ec,
+                                          string cmdline,
+                                          vector<string> &args)
+{
+    string retval = "error: expecting a table name";
+
+    if (args.empty()) {
+
+    }
+    else if (args.size() == 2) {
+        if (ec.ec_dry_run) {
+            return "";
+        }
+
+        string errmsg = delete_materialized_view(args[1]);
+
+        if (errmsg.empty()) {
+            retval = "info: deleted materialized view";
+        }
+        else {
+            retval = "error: " + errmsg;
+        }
+    }
+
+    return retval;
+}
+
 static string com_session(exec_context &ec, string cmdline, vector<string> &args)
 {
     string retval = "error: expecting a command to save to the session file";
@@ -1640,6 +1865,7 @@ static string com_session(exec_context &ec, string cmdline, vector<string> &args
             args[1] != "disable-word-wrap" &&
             args[1] != "filter-in" &&
             args[1] != "filter-out" &&
+            args[1] != "filter-expr" &&
             args[1] != "enable-filter" &&
             args[1] != "disable-filter") {
             retval = "error: only the highlight, filter, and word-wrap commands are "
@@ -1772,11 +1998,25 @@ static string com_open(exec_context &ec, string cmdline, vector<string> &args)
                 retval = "error: lnav was not compiled with libcurl";
 #else
                 if (!ec.ec_dry_run) {
-                    auto_ptr<url_loader> ul(new url_loader(fn));
+                    auto range_res = url_range_source::open(fn);
+
+                    if (range_res.isOk()) {
+                        auto rs = range_res.unwrap();
+
+                        lnav_data.ld_file_names[fn]
+                            .with_fd(rs->copy_fd())
+                            .with_range_source(rs);
+                    } else {
+                        log_info("%s: downloading the whole file -- %s",
+                                 fn.c_str(),
+                                 range_res.unwrapErr().c_str());
+
+                        auto_ptr<url_loader> ul(new url_loader(fn));
 
-                    lnav_data.ld_file_names[fn]
-                        .with_fd(ul->copy_fd());
-                    lnav_data.ld_curl_looper.add_request(ul.release());
+                        lnav_data.ld_file_names[fn]
+                            .with_fd(ul->copy_fd());
+                        lnav_data.ld_curl_looper.add_request(ul.release());
+                    }
                     lnav_data.ld_files_to_front.emplace_back(fn, top);
                     retval = "info: opened URL";
                 } else {
@@ -2832,6 +3072,7 @@ static string com_toggle_field(exec_context &ec, string cmdline, vector<string>
                                 HELP_MSG_1(x, "to quickly show hidden fields"));
                         }
                     }
+                    tc->invalidate_row_cache();
                     tc->set_needs_update();
                 } else {
                     missing_fields.push_back(args[lpc]);
@@ -3330,6 +3571,9 @@ static string com_config(exec_context &ec, string cmdline, vector<string> &args)
                     } else if (!ec.ec_dry_run) {
                         retval = "info: changed config option -- " + option;
                         rollback_lnav_config = lnav_config;
+                        for (auto &tc : lnav_data.ld_views) {
+                            tc.invalidate_row_cache();
+                        }
                     }
                 }
             }
@@ -3376,6 +3620,9 @@ static string com_reset_config(exec_context &ec, string cmdline, vector<string>
             if (!ec.ec_dry_run) {
                 reset_config(option);
                 rollback_lnav_config = lnav_config;
+                for (auto &tc : lnav_data.ld_views) {
+                    tc.invalidate_row_cache();
+                }
             }
             if (option == "*") {
                 retval = "info: reset all options";
@@ -3467,12 +3714,47 @@ public:
         sb_out.sb_count = this->lsvs_stats.lvs_count;
     };
 
+    /**
+     * The number of messages in a row before the values are extracted on
+     * worker threads.
+     */
+    static const size_t CONCURRENT_MIN_MESSAGES = 4096;
+
+    struct pending_message {
+        shared_buffer_ref pm_msg;
+        const external_log_format *pm_format;
+        uint64_t pm_line;
+        bool pm_marked;
+    };
+
+    bool find_value(const vector<logline_value> &values, double &value_out) const {
+        auto lv_iter = find_if(values.begin(), values.end(),
+                               logline_value_cmp(&this->lsvs_colname));
+
+        if (lv_iter == values.end()) {
+            return false;
+        }
+
+        switch (lv_iter->lv_kind) {
+            case logline_value::VALUE_FLOAT:
+                value_out = lv_iter->lv_value.d;
+                return true;
+            case logline_value::VALUE_INTEGER:
+                value_out = lv_iter->lv_value.i;
+                return true;
+            default:
+                return false;
+        }
+    };
+
     void spectro_row(spectrogram_request &sr, spectrogram_row &row_out) {
         logfile_sub_source &lss = lnav_data.ld_log_source;
         vis_line_t begin_line = lss.find_from_time(sr.sr_begin_time);
         vis_line_t end_line = lss.find_from_time(sr.sr_end_time);
         vector<logline_value> values;
+        vector<pending_message> pending;
         string_attrs_t sa;
+        double value;
 
         if (begin_line == -1) {
             begin_line = 0_vl;
@@ -3492,27 +3774,61 @@ public:
             }
 
             lf->read_full_message(ll, sbr);
+
+            // The patterns of text formats can be run on other threads,
+            // other formats keep state from reading the message.
+            auto elf = dynamic_cast<const external_log_format *>(format);
+            if (elf != nullptr &&
+                elf->elf_type == external_log_format::ELF_TYPE_TEXT) {
+                pending.push_back({sbr, elf, (uint64_t) cl, ll->is_marked()});
+                // Values are carved out of the message, so the workers need
+                // copies that are not tied to the line buffer.
+                pending.back().pm_msg.take_ownership();
+                continue;
+            }
+
             sa.clear();
             values.clear();
             format->annotate(cl, sbr, sa, values, false);
 
-            vector<logline_value>::iterator lv_iter;
-
-            lv_iter = find_if(values.begin(), values.end(),
-                              logline_value_cmp(&this->lsvs_colname));
+            if (this->find_value(values, value)) {
+                row_out.add_value(sr, value, ll->is_marked());
+            }
+        }
 
-            if (lv_iter != values.end()) {
-                switch (lv_iter->lv_kind) {
-                    case logline_value::VALUE_FLOAT:
-                        row_out.add_value(sr, lv_iter->lv_value.d, ll->is_marked());
-                        break;
-                    case logline_value::VALUE_INTEGER:
-                        row_out.add_value(sr, lv_iter->lv_value.i, ll->is_marked());
-                        break;
-                    default:
-                        break;
+        size_t worker_count = pending.size() < CONCURRENT_MIN_MESSAGES ? 1 :
+            std::min(task_pool::singleton().get_worker_count(),
+                     pending.size() / CONCURRENT_MIN_MESSAGES);
+        vector<vector<pair<double, bool>>> found(std::max((size_t) 1,
+                                                          worker_count));
+        auto extract_range = [this, &pending, &found, worker_count](size_t index) {
+            size_t per_worker = (pending.size() + worker_count - 1) / worker_count;
+            size_t end = std::min(pending.size(), (index + 1) * per_worker);
+            vector<logline_value> values;
+            string_attrs_t sa;
+            double value;
+
+            for (size_t lpc = index * per_worker; lpc < end; lpc++) {
+                auto &pm = pending[lpc];
+
+                sa.clear();
+                values.clear();
+                pm.pm_format->annotate(pm.pm_line, pm.pm_msg, sa, values,
+                                       false);
+                if (this->find_value(values, value)) {
+                    found[index].emplace_back(value, pm.pm_marked);
                 }
             }
+        };
+
+        // The rows are being drawn, so they go ahead of any indexing.
+        task_pool::singleton().parallel_for(
+            worker_count, extract_range, task_pool::priority_t::VIEWPORT);
+
+        for (const auto &worker_found : found) {
+            for (const auto &pair : worker_found) {
+                row_out.add_value(sr, pair.first, pair.second);
+            }
         }
     };
 
@@ -3662,9 +3978,7 @@ public:
         }
 
         for (int lpc = begin_row; lpc < end_row; lpc++) {
-            double value = 0.0;
-
-            sscanf(dls.dls_rows[lpc][this->dsvs_column_index], "%lf", &value);
+            double value = dls.number_for_cell(lpc, this->dsvs_column_index);
 
             row_out.add_value(sr, value, false);
         }
@@ -3989,6 +4303,18 @@ readline_context::command_t STD_COMMANDS[] = {
             .with_tags({"filtering"})
             .with_example({"last message repeated"})
     },
+    {
+        "filter-expr",
+        com_filter_expr,
+
+        help_text(":filter-expr")
+            .with_summary("Only show log messages where the given SQL expression is true.  "
+                          "The values in a message can be referenced as "
+                          "parameters, like :sc_bytes")
+            .with_parameter(help_text("expr", "The SQL expression to evaluate"))
+            .with_tags({"filtering"})
+            .with_example({":sc_status >= 500"})
+    },
     {
         "delete-filter",
         com_delete_filter,
@@ -4071,6 +4397,24 @@ readline_context::command_t STD_COMMANDS[] = {
             .with_tags({"io", "scripting", "sql"})
             .with_example({"/tmp/table.txt"})
     },
+    {
+        "export-to",
+        com_export_to,
+
+        help_text(":export-to")
+            .with_summary("Write the results of a SQL query straight to a "
+                          "file as the rows are produced, without loading "
+                          "them into the DB view.  The format is picked from "
+                          "the file extension: .csv, .json or .jsonl, with "
+                          "an optional .gz or .zst extension to compress "
+                          "the file, .db to write a SQLite database with "
+                          "the rows in a table named 'export', or .parquet "
+                          "to write an Apache Parquet file")
+            .with_parameter(help_text("path", "The path to the file to write"))
+            .with_parameter(help_text("query", "The SQL query to execute"))
+            .with_tags({"io", "scripting", "sql"})
+            .with_example({"/tmp/errors.csv.gz SELECT * FROM syslog_log WHERE log_level = 'error'"})
+    },
     {
         "pipe-to",
         com_pipe_to,
@@ -4164,6 +4508,27 @@ readline_context::command_t STD_COMMANDS[] = {
             .with_tags({"vtables", "sql"})
             .with_example({"task_durations"})
     },
+    {
+        "remote-query",
+        com_remote_query,
+
+        help_text(":remote-query")
+            .with_summary("Run a query on the hosts of the given remote files and "
+                          "collect the results in a local table.  Only the "
+                          "results are sent back, so a query with a GROUP BY "
+                          "can be used to compute partial aggregates on each "
+                          "host that are then merged by querying the table.")
+            .with_parameter(help_text("table-name", "The name for the new table"))
+            .with_parameter(help_text("remote-files",
+                                      "A comma-separated list of files of the "
+                                      "form host:/path"))
+            .with_parameter(help_text("query", "The SQL query to run on each host"))
+            .with_tags({"sql"})
+            .with_example({"err_counts web1:/var/log/syslog,web2:/var/log/syslog "
+                           "SELECT log_procname, count(*) AS total FROM "
+                           "syslog_log WHERE log_level >= 'error' "
+                           "GROUP BY log_procname"})
+    },
     {
         "create-search-table",
         com_create_search_table,
@@ -4190,6 +4555,39 @@ readline_context::command_t STD_COMMANDS[] = {
             .with_tags({"vtables", "sql"})
             .with_example({"task_durations"})
     },
+    {
+        "create-materialized-view",
+        com_create_materialized_view,
+
+        help_text(":create-materialized-view")
+            .with_summary("Create an SQL table from the results of a query "
+                          "that is kept up-to-date as lines are added")
+            .with_parameter(help_text("table-name",
+                                      "The name of the table to create"))
+            .with_parameter(help_text(
+                "query",
+                "The SELECT statement that produces the rows.  The "
+                "$log_line_start parameter is bound to the first line "
+                "that has not been seen yet, so the statement should only "
+                "look at lines with a log_line greater than or equal to it."))
+            .with_tags({"sql"})
+            .with_example({
+                "error_counts SELECT count(*) AS total FROM syslog_log "
+                "WHERE log_line >= $log_line_start AND log_level = 'error'"
+            })
+    },
+    {
+        "delete-materialized-view",
+        com_delete_materialized_view,
+
+        help_text(":delete-materialized-view")
+            .with_summary("Delete a table created with create-materialized-view")
+            .with_parameter(help_text("table-name",
+                                      "The name of the table to delete"))
+            .with_opposites({"create-materialized-view"})
+            .with_tags({"sql"})
+            .with_example({"error_counts"})
+    },
     {
         "open",
         com_open,
@@ -53,6 +53,7 @@
 #include "auto_mem.hh"
 #include "auto_pid.hh"
 #include "lnav_config.hh"
+#include "pcrepp/pcrepp.hh"
 #include "yajlpp/yajlpp.hh"
 #include "yajlpp/yajlpp_def.hh"
 #include "shlex.hh"
@@ -64,6 +65,7 @@ using namespace std;
 
 static const int MAX_CRASH_LOG_COUNT = 16;
 static const auto STDIN_CAPTURE_RETENTION = 24h;
+static const auto INDEX_CACHE_RETENTION = 7 * 24h;
 
 struct _lnav_config lnav_config;
 struct _lnav_config rollback_lnav_config;
@@ -128,6 +130,7 @@ void ensure_dotlnav()
         "formats/default",
         "formats/installed",
         "stdin-captures",
+        "index-cache",
         "crash",
     };
 
@@ -178,6 +181,31 @@ void ensure_dotlnav()
             }
         }
     }
+
+    {
+        static_root_mem<glob_t, globfree> gl;
+        auto cache_glob = path / "index-cache/*";
+
+        if (glob(cache_glob.str().c_str(), GLOB_NOCHECK, nullptr, gl.inout()) == 0) {
+            auto old_time = std::chrono::system_clock::now() -
+                INDEX_CACHE_RETENTION;
+
+            for (size_t lpc = 0; lpc < gl->gl_pathc; lpc++) {
+                struct stat st;
+
+                if (stat(gl->gl_pathv[lpc], &st) == -1) {
+                    continue;
+                }
+
+                if (chrono::system_clock::from_time_t(st.st_mtime) > old_time) {
+                    continue;
+                }
+
+                log_debug("Removing old index cache: %s", gl->gl_pathv[lpc]);
+                log_perror(remove(gl->gl_pathv[lpc]));
+            }
+        }
+    }
 }
 
 void install_git_format(const char *repo)
@@ -699,6 +727,18 @@ static struct json_path_handler ui_handlers[] = {
             .with_synopsis("bool")
             .with_description("Use default terminal fg/bg colors")
             .FOR_FIELD(_lnav_config, lc_ui_default_colors),
+        json_path_handler("frame-times")
+            .with_synopsis("bool")
+            .with_description(
+                "Show the time taken to draw the screen and to respond to "
+                "input in the top status bar")
+            .FOR_FIELD(_lnav_config, lc_ui_frame_times),
+        json_path_handler("frame-trace-file")
+            .with_synopsis("path")
+            .with_description(
+                "Write the time taken by each step of drawing the screen to "
+                "this file in the Chrome trace-event format")
+            .FOR_FIELD(_lnav_config, lc_ui_frame_trace_file),
         json_path_handler("keymap")
             .with_synopsis("keymap_name")
             .with_description("The name of the keymap to use")
@@ -717,6 +757,210 @@ static struct json_path_handler ui_handlers[] = {
         json_path_handler()
 };
 
+static struct json_path_handler index_cache_handlers[] = {
+        json_path_handler("enabled")
+            .with_synopsis("bool")
+            .with_description(
+                "Save the line index of large files so that they can be "
+                "reopened without scanning them again")
+            .FOR_FIELD(_lnav_config, lc_tuning_index_cache_enabled),
+        json_path_handler("min-file-size")
+            .with_synopsis("bytes")
+            .with_description(
+                "The minimum size of a file before its index is cached")
+            .with_min_value(0)
+            .FOR_FIELD(_lnav_config, lc_tuning_index_cache_min_size),
+
+        json_path_handler()
+};
+
+static struct json_path_handler index_handlers[] = {
+        json_path_handler("tail-first-size")
+            .with_synopsis("bytes")
+            .with_description(
+                "The amount of data at the end of a newly opened file to "
+                "index and show before the rest of the file.  Only files "
+                "that are more than twice this size are indexed this way, a "
+                "size of zero disables it")
+            .with_min_value(0)
+            .FOR_FIELD(_lnav_config, lc_tuning_index_tail_first_size),
+        json_path_handler("reorder-window")
+            .with_synopsis("milliseconds")
+            .with_description(
+                "How far back in time a new line can be from the newest line "
+                "in the log view and still be merged in without rebuilding "
+                "the whole view.  A value of zero disables it")
+            .with_min_value(0)
+            .FOR_FIELD(_lnav_config, lc_tuning_index_reorder_window),
+        json_path_handler("level-scan-limit")
+            .with_synopsis("bytes")
+            .with_description(
+                "How far into the level field of a message to look for a "
+                "level keyword, like ERROR or WARN.  Formats that take the "
+                "level from the body of the message look through the whole "
+                "body otherwise.  A value of zero disables the limit")
+            .with_min_value(0)
+            .FOR_FIELD(_lnav_config, lc_tuning_index_level_scan_limit),
+        json_path_handler("search-index")
+            .with_synopsis("bool")
+            .with_description(
+                "Keep an index of the three-character sequences in each "
+                "block of lines so that searches and filters with a literal "
+                "string can skip the blocks that cannot match.  The index "
+                "takes about an eighth of the size of the files and is only "
+                "used for files that are opened after it is enabled")
+            .FOR_FIELD(_lnav_config, lc_tuning_index_search_index),
+        json_path_handler("file-backed")
+            .with_synopsis("bool")
+            .with_description(
+                "Keep the merged index of the log view in a temporary file "
+                "in the index-cache directory instead of in memory, so that "
+                "the parts that are not being looked at can be paged out "
+                "when memory is tight")
+            .FOR_FIELD(_lnav_config, lc_tuning_index_file_backed),
+
+        json_path_handler()
+};
+
+static struct json_path_handler line_buffer_handlers[] = {
+        json_path_handler("mmap")
+            .with_synopsis("bool")
+            .with_description(
+                "Map plain files into memory instead of copying them into a "
+                "buffer.  Files that are truncated while open can cause a "
+                "crash when this is enabled")
+            .FOR_FIELD(_lnav_config, lc_tuning_mmap_enabled),
+        json_path_handler("budget")
+            .with_synopsis("bytes")
+            .with_description(
+                "The amount of memory the buffers for all of the open files "
+                "can use.  The buffers for the files that were read least "
+                "recently are freed when the budget is exceeded and are "
+                "refilled when needed")
+            .with_min_value(0)
+            .FOR_FIELD(_lnav_config, lc_tuning_buffer_budget),
+        json_path_handler("max-open-files")
+            .with_synopsis("count")
+            .with_description(
+                "The number of files that can be kept open.  The files that "
+                "were read least recently are closed when there are more and "
+                "are reopened when needed")
+            .with_min_value(16)
+            .FOR_FIELD(_lnav_config, lc_tuning_max_open_files),
+
+        json_path_handler()
+};
+
+static struct json_path_handler regex_handlers[] = {
+        json_path_handler("jit-stack-size")
+            .with_synopsis("bytes")
+            .with_description(
+                "The largest size the stack used by compiled regular "
+                "expressions can grow to in each thread")
+            .with_min_value(32 * 1024)
+            .FOR_FIELD(_lnav_config, lc_tuning_regex_jit_stack_size),
+        json_path_handler("match-limit")
+            .with_synopsis("count")
+            .with_description(
+                "The number of backtracking steps a regular expression can "
+                "take before a match is abandoned")
+            .with_min_value(1)
+            .FOR_FIELD(_lnav_config, lc_tuning_regex_match_limit),
+        json_path_handler("match-limit-recursion")
+            .with_synopsis("count")
+            .with_description(
+                "The recursion depth a regular expression can reach before "
+                "a match is abandoned")
+            .with_min_value(1)
+            .FOR_FIELD(_lnav_config, lc_tuning_regex_match_limit_recursion),
+
+        json_path_handler()
+};
+
+static struct json_path_handler retention_handlers[] = {
+        json_path_handler("max-lines")
+            .with_synopsis("count")
+            .with_description(
+                "The number of lines to keep in the index for each file.  "
+                "The oldest lines are dropped when a file grows past this "
+                "by more than an eighth, a value of zero disables it")
+            .with_min_value(0)
+            .FOR_FIELD(_lnav_config, lc_tuning_retention_max_lines),
+        json_path_handler("max-bytes")
+            .with_synopsis("bytes")
+            .with_description(
+                "The amount of data at the end of each file to keep in the "
+                "index, a value of zero disables it")
+            .with_min_value(0)
+            .FOR_FIELD(_lnav_config, lc_tuning_retention_max_bytes),
+        json_path_handler("max-age")
+            .with_synopsis("seconds")
+            .with_description(
+                "How long to keep lines in the index after the time in their "
+                "timestamp, a value of zero disables it")
+            .with_min_value(0)
+            .FOR_FIELD(_lnav_config, lc_tuning_retention_max_age),
+
+        json_path_handler()
+};
+
+static struct json_path_handler memory_handlers[] = {
+        json_path_handler("limit")
+            .with_synopsis("bytes")
+            .with_description(
+                "The resident size that lnav tries to stay under by freeing "
+                "its caches, the caches that are cheapest to refill are "
+                "freed first.  A value of zero uses three-quarters of the "
+                "cgroup memory limit or the physical memory")
+            .with_min_value(0)
+            .FOR_FIELD(_lnav_config, lc_tuning_memory_limit),
+
+        json_path_handler()
+};
+
+static struct json_path_handler thread_pool_handlers[] = {
+        json_path_handler("size")
+            .with_synopsis("count")
+            .with_description(
+                "The number of worker threads used to index, sort, and query "
+                "files in parallel.  A value of zero uses one thread for "
+                "each processor.  The threads are started when they are "
+                "first needed, so changes take effect the next time lnav "
+                "is started")
+            .with_min_value(0)
+            .FOR_FIELD(_lnav_config, lc_tuning_thread_pool_size),
+
+        json_path_handler()
+};
+
+static struct json_path_handler tuning_handlers[] = {
+        json_path_handler("index/")
+            .with_description("Settings for indexing files")
+            .with_children(index_handlers),
+        json_path_handler("index-cache/")
+            .with_description("Settings for the on-disk line index cache")
+            .with_children(index_cache_handlers),
+        json_path_handler("line-buffer/")
+            .with_description("Settings for reading files")
+            .with_children(line_buffer_handlers),
+        json_path_handler("memory/")
+            .with_description("Settings for the memory used by caches")
+            .with_children(memory_handlers),
+        json_path_handler("regex/")
+            .with_description("Settings for matching regular expressions")
+            .with_children(regex_handlers),
+        json_path_handler("thread-pool/")
+            .with_description("Settings for the worker threads")
+            .with_children(thread_pool_handlers),
+        json_path_handler("retention/")
+            .with_description(
+                "Settings for bounding the memory used while following "
+                "files that keep growing")
+            .with_children(retention_handlers),
+
+        json_path_handler()
+};
+
 struct json_path_handler lnav_config_handlers[] = {
         json_path_handler("/ui/")
             .with_description("User-interface settings")
@@ -726,6 +970,10 @@ struct json_path_handler lnav_config_handlers[] = {
             .with_description("Global variable definitions")
             .with_children(global_var_handlers),
 
+        json_path_handler("/tuning/")
+            .with_description("Internal settings")
+            .with_children(tuning_handlers),
+
         json_path_handler()
 };
 
@@ -897,6 +1145,18 @@ string save_config()
     return "info: configuration saved";
 }
 
+class regex_listener : public lnav_config_listener {
+public:
+    void reload_config(error_reporter &reporter) override {
+        pcrepp::set_jit_stack_size(lnav_config.lc_tuning_regex_jit_stack_size);
+        pcrepp::set_match_limits(
+            lnav_config.lc_tuning_regex_match_limit,
+            lnav_config.lc_tuning_regex_match_limit_recursion);
+    };
+};
+
+static regex_listener _REGEX_LISTENER;
+
 void reload_config(vector<string> &errors)
 {
     lnav_config_listener *curr = lnav_config_listener::LISTENER_LIST;
@@ -108,12 +108,32 @@ struct _lnav_config {
     std::string lc_ui_clock_format;
     bool lc_ui_dim_text;
     bool lc_ui_default_colors{true};
+    bool lc_ui_frame_times{false};
+    std::string lc_ui_frame_trace_file;
     std::string lc_ui_keymap;
     std::string lc_ui_theme;
     std::unordered_map<std::string, key_map> lc_ui_keymaps;
     std::map<std::string, std::string> lc_ui_key_overrides;
     std::map<std::string, std::string> lc_global_vars;
     std::map<std::string, lnav_theme> lc_ui_theme_defs;
+    bool lc_tuning_index_cache_enabled{true};
+    int64_t lc_tuning_index_cache_min_size{1024 * 1024};
+    int64_t lc_tuning_index_tail_first_size{64 * 1024 * 1024};
+    int64_t lc_tuning_index_reorder_window{1000};
+    int64_t lc_tuning_index_level_scan_limit{0};
+    bool lc_tuning_index_search_index{false};
+    bool lc_tuning_index_file_backed{false};
+    bool lc_tuning_mmap_enabled{false};
+    int64_t lc_tuning_buffer_budget{512 * 1024 * 1024};
+    int64_t lc_tuning_max_open_files{512};
+    int64_t lc_tuning_memory_limit{0};
+    int64_t lc_tuning_thread_pool_size{0};
+    int64_t lc_tuning_regex_jit_stack_size{512 * 1024};
+    int64_t lc_tuning_regex_match_limit{10000};
+    int64_t lc_tuning_regex_match_limit_recursion{500};
+    int64_t lc_tuning_retention_max_lines{0};
+    int64_t lc_tuning_retention_max_bytes{0};
+    int64_t lc_tuning_retention_max_age{0};
 };
 
 extern struct _lnav_config lnav_config;
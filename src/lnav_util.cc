@@ -35,6 +35,7 @@
 
 #include <stdio.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <ctype.h>
 #include <stdarg.h>
 #include <paths.h>
@@ -306,7 +307,7 @@ file_format_t detect_file_format(const std::string &filename)
     auto_fd       fd;
 
     if ((fd = open(filename.c_str(), O_RDONLY)) != -1) {
-        char buffer[32];
+        char buffer[512];
         int  rc;
 
         if ((rc = read(fd, buffer, sizeof(buffer))) > 0) {
@@ -314,6 +315,17 @@ file_format_t detect_file_format(const std::string &filename)
                 strncmp(buffer, "SQLite format 3", 16) == 0) {
                 retval = FF_SQLITE_DB;
             }
+            else if (rc == sizeof(buffer) &&
+                     memcmp(&buffer[257], "ustar", 5) == 0) {
+                retval = FF_TAR_ARCHIVE;
+            }
+            else if (rc > 2 &&
+                     buffer[0] == '\037' && buffer[1] == '\213' &&
+                     (endswith(filename.c_str(), ".tar.gz") ||
+                      endswith(filename.c_str(), ".tgz"))) {
+                // The header is compressed, so go by the name.
+                retval = FF_TAR_ARCHIVE;
+            }
         }
     }
 
@@ -405,6 +417,16 @@ static void secs2wday(const struct timeval &tv, struct tm *res)
 
 struct tm *secs2tm(time_t *tim_p, struct tm *res)
 {
+    /*
+     * Adjacent log lines are almost always from the same day, so the date
+     * of the last day converted on this thread is kept to skip the year
+     * and month loops.
+     */
+    static thread_local struct {
+        long dc_days{LONG_MIN};
+        struct tm dc_tm;
+    } day_cache;
+
     long days, rem;
     time_t lcltime;
     int y;
@@ -428,6 +450,18 @@ struct tm *secs2tm(time_t *tim_p, struct tm *res)
     res->tm_min = (int) (rem / SECSPERMIN);
     res->tm_sec = (int) (rem % SECSPERMIN);
 
+    if (days == day_cache.dc_days) {
+        res->tm_wday = day_cache.dc_tm.tm_wday;
+        res->tm_year = day_cache.dc_tm.tm_year;
+        res->tm_yday = day_cache.dc_tm.tm_yday;
+        res->tm_mon = day_cache.dc_tm.tm_mon;
+        res->tm_mday = day_cache.dc_tm.tm_mday;
+        res->tm_isdst = 0;
+
+        return (res);
+    }
+    day_cache.dc_days = days;
+
     /* compute day of week */
     if ((res->tm_wday = ((EPOCH_WDAY + days) % DAYSPERWEEK)) < 0)
         res->tm_wday += DAYSPERWEEK;
@@ -464,6 +498,8 @@ struct tm *secs2tm(time_t *tim_p, struct tm *res)
 
     res->tm_isdst = 0;
 
+    day_cache.dc_tm = *res;
+
     return (res);
 }
 
@@ -496,13 +532,31 @@ const char *date_time_scanner::scan(const char *time_dest,
 {
     int  curr_time_fmt = -1;
     bool found         = false;
+    bool from_cache    = false;
     const char *retval = NULL;
 
     if (!time_fmt) {
         time_fmt = PTIMEC_FORMAT_STR;
     }
 
-    while (next_format(time_fmt,
+    if (this->dts_last_len > 0 &&
+        this->dts_last_len <= time_len &&
+        this->dts_last_fmt == time_fmt &&
+        this->dts_last_convert == convert_local &&
+        this->dts_last_next == (this->dts_last_len == time_len ?
+                                -1 :
+                                (unsigned char) time_dest[this->dts_last_len]) &&
+        memcmp(time_dest, this->dts_last_prefix, this->dts_last_len) == 0) {
+        *tm_out = this->dts_last_tm;
+        tv_out.tv_sec = this->dts_last_sec;
+        tv_out.tv_usec = this->dts_last_usec;
+        this->dts_fmt_len = this->dts_last_len;
+        retval = &time_dest[this->dts_last_len];
+        found = true;
+        from_cache = true;
+    }
+
+    while (!found && next_format(time_fmt,
                        curr_time_fmt,
                        this->dts_fmt_lock)) {
         *tm_out = this->dts_base_tm;
@@ -578,7 +632,10 @@ const char *date_time_scanner::scan(const char *time_dest,
                 tm_out->et_tm.tm_zone = NULL;
             }
 #endif
-            if (ptime_fmt(time_fmt[curr_time_fmt], tm_out, time_dest, off, time_len) &&
+            const ptime_program &prog = this->program_for(time_fmt,
+                                                          curr_time_fmt);
+
+            if (prog.parse(tm_out, time_dest, off, time_len) &&
                 (time_dest[off] == '.' || time_dest[off] == ',' || off == (off_t)time_len)) {
                 retval = &time_dest[off];
                 if (tm_out->et_tm.tm_year < 70) {
@@ -611,6 +668,25 @@ const char *date_time_scanner::scan(const char *time_dest,
     if (!found) {
         retval = NULL;
     }
+    else if (!from_cache) {
+        size_t prefix_len = retval - time_dest;
+
+        if (this->dts_fmt_lock != -1 &&
+            prefix_len < sizeof(this->dts_last_prefix)) {
+            memcpy(this->dts_last_prefix, time_dest, prefix_len);
+            this->dts_last_len = prefix_len;
+            this->dts_last_next = prefix_len == time_len ?
+                                  -1 : (unsigned char) time_dest[prefix_len];
+            this->dts_last_fmt = time_fmt;
+            this->dts_last_convert = convert_local;
+            this->dts_last_tm = *tm_out;
+            this->dts_last_sec = tv_out.tv_sec;
+            this->dts_last_usec = tv_out.tv_usec;
+        }
+        else {
+            this->dts_last_len = 0;
+        }
+    }
 
     if (retval != NULL) {
         /* Try to pull out the milli/micro-second value. */
@@ -742,7 +818,7 @@ open_temp_file(const filesystem::path &pattern)
 
     strcpy(pattern_copy, pattern_str.c_str());
     if ((fd = mkstemp(pattern_copy)) == -1) {
-        throw Err(strerror(errno));
+        return Err(std::string(strerror(errno)));
     }
 
     return Ok(make_pair(filesystem::path(pattern_copy), fd));
@@ -137,6 +137,15 @@ inline int32_t read_le32(const unsigned char *data)
         (data[3] << 24));
 }
 
+inline uint32_t read_be32(const unsigned char *data)
+{
+    return (
+        ((uint32_t) data[0] << 24) |
+        ((uint32_t) data[1] << 16) |
+        ((uint32_t) data[2] <<  8) |
+        ((uint32_t) data[3] <<  0));
+}
+
 inline time_t day_num(time_t ti)
 {
     return ti / (24 * 60 * 60);
@@ -222,6 +231,7 @@ std::pair<std::string, std::string> split_path(const std::string &path) {
 enum file_format_t {
     FF_UNKNOWN,
     FF_SQLITE_DB,
+    FF_TAR_ARCHIVE,
 };
 
 file_format_t detect_file_format(const std::string &filename);
@@ -339,16 +349,19 @@ struct date_time_scanner {
         memset(&this->dts_base_tm, 0, sizeof(this->dts_base_tm));
         this->dts_fmt_lock = -1;
         this->dts_fmt_len = -1;
+        this->dts_last_len = 0;
     };
 
     void unlock(void) {
         this->dts_fmt_lock = -1;
         this->dts_fmt_len = -1;
+        this->dts_last_len = 0;
     }
 
     void set_base_time(time_t base_time) {
         this->dts_base_time = base_time;
         localtime_r(&base_time, &this->dts_base_tm.et_tm);
+        this->dts_last_len = 0;
     };
 
     /**
@@ -393,12 +406,47 @@ struct date_time_scanner {
     struct exttm dts_base_tm;
     int dts_fmt_lock;
     int dts_fmt_len;
+    std::vector<ptime_program> dts_programs;
+
+    /**
+     * The text before the sub-second part of the last timestamp that was
+     * scanned and the result of converting it.  Busy logs repeat the same
+     * second for many lines in a row, so the next scan can skip straight
+     * to the fraction when the text has not changed.
+     */
+    char dts_last_prefix[64];
+    size_t dts_last_len{0};
+    int dts_last_next;              /*< The byte after the prefix or -1. */
+    const char * const *dts_last_fmt;
+    bool dts_last_convert;
+    struct exttm dts_last_tm;
+    time_t dts_last_sec;
+    suseconds_t dts_last_usec;
     time_t dts_local_offset_cache;
     time_t dts_local_offset_valid;
     time_t dts_local_offset_expiry;
 
     static const int EXPIRE_TIME = 15 * 60;
 
+    /**
+     * @return The compiled form of the given custom time format, the result
+     * is cached since the format strings are interned and do not change.
+     */
+    const ptime_program &program_for(const char * const time_fmt[],
+                                     int index) {
+        if ((size_t) index >= this->dts_programs.size()) {
+            this->dts_programs.resize(index + 1);
+        }
+
+        ptime_program &retval = this->dts_programs[index];
+
+        if (retval.get_format() != time_fmt[index]) {
+            retval = ptime_program(time_fmt[index]);
+        }
+
+        return retval;
+    };
+
     const char *scan(const char *time_src,
                      size_t time_len,
                      const char * const time_fmt[],
@@ -52,6 +52,11 @@ public:
         A_ACCEL,
     };
 
+    /** @return The number of points needed to fill the history. */
+    static int history_points() {
+        return HISTORY_SIZE + 1;
+    };
+
     log_accel()
         : la_last_point(0),
           la_last_point_set(false),
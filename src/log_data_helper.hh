@@ -94,14 +94,16 @@ public:
             this->ldh_line_attrs.clear();
         }
         else {
-            log_format *format = this->ldh_file->get_format();
             struct line_range body;
             string_attrs_t    &sa = this->ldh_line_attrs;
 
             this->ldh_line_attrs.clear();
             this->ldh_line_values.clear();
             this->ldh_file->read_full_message(ll, this->ldh_msg);
-            format->annotate(this->ldh_line_index, this->ldh_msg, sa, this->ldh_line_values, false);
+            this->ldh_file->annotate_message(this->ldh_line_index,
+                                             this->ldh_msg,
+                                             sa,
+                                             this->ldh_line_values);
 
             body = find_string_attr_range(sa, &textview_curses::SA_BODY);
             if (body.lr_start == -1) {
@@ -118,7 +120,7 @@ public:
             this->ldh_json_pairs.clear();
 
             for (auto lv : this->ldh_line_values) {
-                this->ldh_namer->cn_builtin_names.emplace_back(lv.lv_name.get());
+                this->ldh_namer->add_builtin_name(lv.lv_name.get());
             }
 
             for (auto & ldh_line_value : this->ldh_line_values) {
@@ -126,8 +128,7 @@ public:
                 case logline_value::VALUE_JSON: {
                     json_ptr_walk jpw;
 
-                    if (jpw.parse(ldh_line_value.lv_sbr.get_data(), ldh_line_value.lv_sbr.length()) == yajl_status_ok &&
-                        jpw.complete_parse() == yajl_status_ok) {
+                    if (jpw.parse_complete(ldh_line_value.lv_sbr.get_data(), ldh_line_value.lv_sbr.length()) == yajl_status_ok) {
                         this->ldh_json_pairs[ldh_line_value.lv_name] = jpw.jpw_values;
                     }
                     break;
@@ -88,6 +88,7 @@ public:
         column_namer cn;
 
         dp.parse();
+        this->compile_template(line, body, dp);
 
         cols.emplace_back("log_msg_instance", SQLITE_INTEGER, nullptr);
         for (auto pair_iter = dp.dp_pairs.begin();
@@ -137,14 +138,14 @@ public:
         lc.lc_curr_line = lc.lc_curr_line + vis_line_t(1);
         lc.lc_sub_index = 0;
 
-        if (lc.lc_curr_line == (int)lss.text_line_count()) {
+        if (lc.is_eof()) {
             return true;
         }
 
         content_line_t cl;
 
-        cl = lss.at(lc.lc_curr_line);
-        std::shared_ptr<logfile> lf = lss.find(cl);
+        cl = lc.line_at(lc.lc_curr_line);
+        logfile *lf = lss.find_file_ptr(cl);
         auto lf_iter = lf->begin() + cl;
 
         if (lf_iter->is_continued()) {
@@ -171,6 +172,19 @@ public:
             return false;
         }
 
+        if (this->ldt_template_compiled) {
+            data_scanner ds(this->ldt_current_line,
+                            body.lr_start,
+                            body.lr_end);
+
+            scan_tokens(ds, this->ldt_scan_tokens);
+            if (this->match_template(this->ldt_current_line)) {
+                lf_iter->set_schema(this->ldt_schema_id);
+                this->ldt_instance += 1;
+                return true;
+            }
+        }
+
         data_scanner ds(this->ldt_current_line, body.lr_start, body.lr_end);
         data_parser  dp(&ds);
         dp.parse();
@@ -183,8 +197,13 @@ public:
             return false;
         }
 
-        this->ldt_pairs.clear();
-        this->ldt_pairs.swap(dp.dp_pairs, __FILE__, __LINE__);
+        this->ldt_values.clear();
+        for (const auto &pair : dp.dp_pairs) {
+            const data_parser::element &pvalue = pair.get_pair_value();
+
+            this->ldt_values.emplace_back(pvalue.value_token(),
+                                          pvalue.e_capture);
+        }
         this->ldt_instance += 1;
 
         return true;
@@ -203,18 +222,18 @@ public:
         values.emplace_back(instance_name, this->ldt_instance);
         logline_value &lv = values.back();
         lv.lv_column = next_column++;
-        for (auto &ldt_pair : this->ldt_pairs) {
-            const data_parser::element &pvalue = ldt_pair.get_pair_value();
+        for (const auto &ldt_value : this->ldt_values) {
+            const pcre_context::capture_t &cap = ldt_value.second;
 
-            switch (pvalue.value_token()) {
+            switch (ldt_value.first) {
             case DT_NUMBER: {
                 char scan_value[line.length() + 1];
                 double d = 0.0;
 
                 memcpy(scan_value,
-                    line.get_data() + pvalue.e_capture.c_begin,
-                    pvalue.e_capture.length());
-                scan_value[pvalue.e_capture.length()] = '\0';
+                    line.get_data() + cap.c_begin,
+                    cap.length());
+                scan_value[cap.length()] = '\0';
                 if (sscanf(scan_value, "%lf", &d) != 1) {
                     d = 0.0;
                 }
@@ -225,8 +244,7 @@ public:
             default: {
                 shared_buffer_ref value_sbr;
 
-                value_sbr.subset(line,
-                    pvalue.e_capture.c_begin, pvalue.e_capture.length());
+                value_sbr.subset(line, cap.c_begin, cap.length());
                 values.emplace_back(intern_string::lookup("", 0),
                     logline_value::VALUE_TEXT, value_sbr);
                 break;
@@ -238,11 +256,184 @@ public:
     };
 
 private:
+    /**
+     * A token from the template line.  Tokens that are not part of a value
+     * are "fixed" and a line has to contain the same text for them to be
+     * considered a match for the template.
+     */
+    struct template_token {
+        data_token_t tt_token;
+        pcre_context::capture_t tt_capture;
+        bool tt_fixed;
+    };
+
+    /**
+     * The position of one end of a value, relative to the start or end of a
+     * token in the template.
+     */
+    struct template_anchor {
+        size_t ta_index;
+        bool ta_at_end;
+        int ta_delta;
+    };
+
+    struct template_value {
+        data_token_t tv_token;
+        template_anchor tv_begin;
+        template_anchor tv_end;
+    };
+
+    static void scan_tokens(data_scanner &ds,
+                            std::vector<template_token> &tokens_out)
+    {
+        pcre_context_static<30> pc;
+        data_token_t token;
+
+        tokens_out.clear();
+        while (ds.tokenize2(pc, token)) {
+            auto pc_iter = std::find_if(pc.begin(), pc.end(),
+                                        capture_if_not(-1));
+
+            require(pc_iter != pc.end());
+
+            tokens_out.push_back({token, *pc_iter, true});
+        }
+    };
+
+    bool anchor_for(int pos, bool at_end, template_anchor &anchor_out) const
+    {
+        const auto &tokens = this->ldt_template_tokens;
+
+        for (size_t lpc = 0; lpc < tokens.size(); lpc++) {
+            const auto &cap = tokens[lpc].tt_capture;
+
+            if ((at_end ? cap.c_end : cap.c_begin) == pos) {
+                anchor_out = {lpc, at_end, 0};
+                return true;
+            }
+        }
+
+        // Fall back to an offset within a token whose text is fixed.
+        for (size_t lpc = 0; lpc < tokens.size(); lpc++) {
+            const auto &tt = tokens[lpc];
+
+            if (tt.tt_fixed &&
+                tt.tt_capture.c_begin <= pos && pos <= tt.tt_capture.c_end) {
+                anchor_out = {lpc, false, pos - tt.tt_capture.c_begin};
+                return true;
+            }
+        }
+
+        return false;
+    };
+
+    /**
+     * Record the token layout of the template line and where the values
+     * of each pair fall in it, so that lines with the same layout can be
+     * picked apart without running the full parser.
+     */
+    void compile_template(shared_buffer_ref &line,
+                          const struct line_range &body,
+                          const data_parser &dp)
+    {
+        data_scanner ds(line, body.lr_start, body.lr_end);
+
+        this->ldt_template_compiled = false;
+        this->ldt_template_values.clear();
+        scan_tokens(ds, this->ldt_template_tokens);
+        this->ldt_template_text.assign(line.get_data(), line.length());
+
+        for (const auto &pair : dp.dp_pairs) {
+            const data_parser::element &pvalue = pair.get_pair_value();
+            const auto &cap = pvalue.e_capture;
+
+            for (auto &tt : this->ldt_template_tokens) {
+                if (tt.tt_capture.c_end <= cap.c_begin ||
+                    cap.c_end <= tt.tt_capture.c_begin) {
+                    continue;
+                }
+                if (tt.tt_capture.c_begin < cap.c_begin ||
+                    cap.c_end < tt.tt_capture.c_end) {
+                    // The value splits a token, give up.
+                    return;
+                }
+                tt.tt_fixed = false;
+            }
+        }
+
+        for (const auto &pair : dp.dp_pairs) {
+            const data_parser::element &pvalue = pair.get_pair_value();
+            template_value tv;
+
+            tv.tv_token = pvalue.value_token();
+            if (!this->anchor_for(pvalue.e_capture.c_begin, false,
+                                  tv.tv_begin) ||
+                !this->anchor_for(pvalue.e_capture.c_end, true,
+                                  tv.tv_end)) {
+                return;
+            }
+            this->ldt_template_values.push_back(tv);
+        }
+
+        this->ldt_template_compiled = true;
+    };
+
+    /**
+     * Check if the tokens in ldt_scan_tokens have the same layout as the
+     * template and, if so, fill in ldt_values from them.
+     */
+    bool match_template(shared_buffer_ref &line)
+    {
+        const auto &tokens = this->ldt_scan_tokens;
+
+        if (tokens.size() != this->ldt_template_tokens.size()) {
+            return false;
+        }
+
+        for (size_t lpc = 0; lpc < tokens.size(); lpc++) {
+            const auto &tt = this->ldt_template_tokens[lpc];
+            const auto &cap = tokens[lpc].tt_capture;
+
+            if (tokens[lpc].tt_token != tt.tt_token) {
+                return false;
+            }
+            if (!tt.tt_fixed) {
+                continue;
+            }
+            if (cap.length() != tt.tt_capture.length() ||
+                memcmp(line.get_data() + cap.c_begin,
+                       &this->ldt_template_text[tt.tt_capture.c_begin],
+                       cap.length()) != 0) {
+                return false;
+            }
+        }
+
+        this->ldt_values.clear();
+        for (const auto &tv : this->ldt_template_values) {
+            const auto &begin_cap = tokens[tv.tv_begin.ta_index].tt_capture;
+            const auto &end_cap = tokens[tv.tv_end.ta_index].tt_capture;
+            int begin = (tv.tv_begin.ta_at_end ? begin_cap.c_end :
+                         begin_cap.c_begin) + tv.tv_begin.ta_delta;
+            int end = (tv.tv_end.ta_at_end ? end_cap.c_end :
+                       end_cap.c_begin) + tv.tv_end.ta_delta;
+
+            this->ldt_values.emplace_back(
+                tv.tv_token, pcre_context::capture_t(begin, end));
+        }
+
+        return true;
+    };
+
     logfile_sub_source &ldt_log_source;
     const content_line_t     ldt_template_line;
     data_parser::schema_id_t ldt_schema_id;
     shared_buffer_ref ldt_current_line;
-    data_parser::element_list_t ldt_pairs;
+    std::vector<std::pair<data_token_t, pcre_context::capture_t>> ldt_values;
+    bool ldt_template_compiled{false};
+    std::string ldt_template_text;
+    std::vector<template_token> ldt_template_tokens;
+    std::vector<template_value> ldt_template_values;
+    std::vector<template_token> ldt_scan_tokens;
     log_vtab_impl *ldt_format_impl;
     int ldt_parent_column_count;
     int64_t ldt_instance;
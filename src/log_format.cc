@@ -34,15 +34,21 @@
 #include <string.h>
 #include <strings.h>
 
+#include <unordered_map>
+
 #include "fmt/format.h"
 #include "yajlpp/yajlpp.hh"
 #include "yajlpp/yajlpp_def.hh"
+#include "yajlpp/json_fast_parse.hh"
+#include "yajlpp/msgpack_parse.hh"
 #include "sql_util.hh"
 #include "log_format.hh"
 #include "log_vtab_impl.hh"
 #include "ptimec.hh"
 #include "log_search_table.hh"
 #include "command_executor.hh"
+#include "base/pthreadpp.hh"
+#include "lnav_config.hh"
 
 using namespace std;
 
@@ -55,8 +61,24 @@ string_attr_type logline::L_OPID("opid");
 string_attr_type logline::L_META("meta");
 
 external_log_format::mod_map_t external_log_format::MODULE_FORMATS;
+size_t external_log_format::LEVEL_SCAN_LIMIT = 0;
+
+class level_scan_listener : public lnav_config_listener {
+public:
+    void reload_config(error_reporter &reporter) override {
+        external_log_format::LEVEL_SCAN_LIMIT =
+            lnav_config.lc_tuning_index_level_scan_limit;
+    };
+};
+
+static level_scan_listener _LEVEL_SCAN_LISTENER;
 std::vector<external_log_format *> external_log_format::GRAPH_ORDERED_FORMATS;
 
+/**
+ * Guards MODULE_FORMATS during scanning, files can be indexed concurrently.
+ */
+static pthread_mutex_t MODULE_FORMATS_MUTEX = PTHREAD_MUTEX_INITIALIZER;
+
 struct line_range logline_value::origin_in_full_msg(const char *msg, size_t len) const
 {
     if (this->lv_sub_offset == 0) {
@@ -207,7 +229,7 @@ const char *log_format::log_scanf(uint32_t line_number,
     return retval;
 }
 
-void log_format::check_for_new_year(std::vector<logline> &dst, exttm etm,
+void log_format::check_for_new_year(chunked_vector<logline> &dst, exttm etm,
                                     struct timeval log_tv)
 {
     if (dst.empty()) {
@@ -216,7 +238,7 @@ void log_format::check_for_new_year(std::vector<logline> &dst, exttm etm,
 
     time_t diff = dst.back().get_time() - log_tv.tv_sec;
     int off_year = 0, off_month = 0, off_day = 0, off_hour = 0;
-    std::vector<logline>::iterator iter;
+    chunked_vector<logline>::iterator iter;
     bool do_change = true;
 
     if (diff <= 0) {
@@ -272,6 +294,17 @@ struct json_log_userdata {
     size_t jlu_line_size;
     size_t jlu_sub_start;
     shared_buffer_ref &jlu_shared_buffer;
+    /** The decoder of a MessagePack record, if the line is one. */
+    msgpack_parser *jlu_msgpack{nullptr};
+    /** The start of the MessagePack value in the record. */
+    const char *jlu_record_value{nullptr};
+    /**
+     * The numeric values found in the line, they are only added to the
+     * stats once the whole line has been parsed successfully.
+     */
+    std::vector<std::pair<size_t, double>> jlu_numeric_values;
+    /** The operation ID of the line, if the format has an opid field. */
+    std::string jlu_opid;
 };
 
 static int read_json_field(yajlpp_parse_context *ypc, const unsigned char *str, size_t len);
@@ -298,6 +331,19 @@ static int read_json_bool(yajlpp_parse_context *ypc, int val)
     return 1;
 }
 
+static void add_json_numeric_value(json_log_userdata *jlu,
+                                   const intern_string_t &field_name,
+                                   double val)
+{
+    const auto vd = jlu->jlu_format->find_value_def(field_name);
+
+    if (vd == nullptr || vd->vd_values_index < 0) {
+        return;
+    }
+
+    jlu->jlu_numeric_values.emplace_back(vd->vd_values_index, val);
+}
+
 static int read_json_int(yajlpp_parse_context *ypc, long long val)
 {
     json_log_userdata *jlu = (json_log_userdata *)ypc->ypc_userdata;
@@ -312,7 +358,7 @@ static int read_json_int(yajlpp_parse_context *ypc, long long val)
         jlu->jlu_base_line->set_time(tv);
     }
     else if (jlu->jlu_format->elf_level_field == field_name) {
-        if (jlu->jlu_format->elf_level_pairs.empty()) {
+        if (jlu->jlu_format->elf_level_pairs->empty()) {
             char level_buf[128];
 
             snprintf(level_buf, sizeof(level_buf), "%lld", val);
@@ -324,8 +370,8 @@ static int read_json_int(yajlpp_parse_context *ypc, long long val)
         } else {
             vector<pair<int64_t, log_level_t> >::iterator iter;
 
-            for (iter = jlu->jlu_format->elf_level_pairs.begin();
-                 iter != jlu->jlu_format->elf_level_pairs.end();
+            for (iter = jlu->jlu_format->elf_level_pairs->begin();
+                 iter != jlu->jlu_format->elf_level_pairs->end();
                  ++iter) {
                 if (iter->first == val) {
                     jlu->jlu_base_line->set_level(iter->second);
@@ -334,6 +380,9 @@ static int read_json_int(yajlpp_parse_context *ypc, long long val)
             }
         }
     }
+    else {
+        add_json_numeric_value(jlu, field_name, val);
+    }
 
     jlu->jlu_sub_line_count += jlu->jlu_format->value_line_count(
         field_name, ypc->is_level(1));
@@ -354,6 +403,9 @@ static int read_json_double(yajlpp_parse_context *ypc, double val)
         tv.tv_usec = fmod(val, divisor) * (1000000.0 / divisor);
         jlu->jlu_base_line->set_time(tv);
     }
+    else {
+        add_json_numeric_value(jlu, field_name, val);
+    }
 
     jlu->jlu_sub_line_count += jlu->jlu_format->value_line_count(
         field_name, ypc->is_level(1));
@@ -370,7 +422,11 @@ static int json_array_start(void *ctx)
         const intern_string_t field_name = ypc->get_path_fragment_i(0);
 
         jlu->jlu_sub_line_count += jlu->jlu_format->value_line_count(field_name, true);
-        jlu->jlu_sub_start = yajl_get_bytes_consumed(jlu->jlu_handle) - 1;
+        if (jlu->jlu_msgpack != nullptr) {
+            jlu->jlu_sub_start = jlu->jlu_msgpack->get_value_start();
+        } else {
+            jlu->jlu_sub_start = yajl_get_bytes_consumed(jlu->jlu_handle) - 1;
+        }
     }
 
     return 1;
@@ -383,12 +439,29 @@ static int json_array_end(void *ctx)
 
     if (ypc->ypc_path_index_stack.size() == 1) {
         const intern_string_t field_name = ypc->get_path_fragment_i(0);
-        size_t sub_end = yajl_get_bytes_consumed(jlu->jlu_handle);
-        shared_buffer_ref sbr;
 
-        sbr.subset(jlu->jlu_shared_buffer, jlu->jlu_sub_start,
-            sub_end - jlu->jlu_sub_start);
-        jlu->jlu_format->jlf_line_values.emplace_back(field_name, sbr);
+        if (jlu->jlu_msgpack != nullptr) {
+            // The value is shown as JSON, so it has to be converted.
+            size_t sub_end = jlu->jlu_msgpack->get_bytes_consumed();
+            yajlpp_gen gen;
+
+            msgpack_to_json(gen,
+                            jlu->jlu_record_value + jlu->jlu_sub_start,
+                            sub_end - jlu->jlu_sub_start);
+
+            auto sf = gen.to_string_fragment();
+            tmp_shared_buffer tsb(sf.data(), sf.length());
+
+            jlu->jlu_format->jlf_line_values.emplace_back(field_name,
+                                                          tsb.tsb_ref);
+        } else {
+            size_t sub_end = yajl_get_bytes_consumed(jlu->jlu_handle);
+            shared_buffer_ref sbr;
+
+            sbr.subset(jlu->jlu_shared_buffer, jlu->jlu_sub_start,
+                sub_end - jlu->jlu_sub_start);
+            jlu->jlu_format->jlf_line_values.emplace_back(field_name, sbr);
+        }
         jlu->jlu_format->jlf_line_values.back().lv_kind = logline_value::VALUE_JSON;
     }
 
@@ -471,6 +544,31 @@ static struct json_path_handler json_log_rewrite_handlers[] = {
     json_path_handler()
 };
 
+/**
+ * Find the MessagePack value in a length-prefixed record.
+ *
+ * @return False if the length at the start does not match the record.
+ */
+static bool find_record_value(const shared_buffer_ref &sbr,
+                              const char *&value_out,
+                              size_t &len_out)
+{
+    if (sbr.length() < line_buffer::RECORD_PREFIX_SIZE) {
+        return false;
+    }
+
+    size_t len = read_be32((const unsigned char *) sbr.get_data());
+
+    if (len != sbr.length() - line_buffer::RECORD_PREFIX_SIZE) {
+        return false;
+    }
+
+    value_out = sbr.get_data() + line_buffer::RECORD_PREFIX_SIZE;
+    len_out = len;
+
+    return true;
+}
+
 bool external_log_format::scan_for_partial(shared_buffer_ref &sbr, size_t &len_out)
 {
     if (this->elf_type != ELF_TYPE_TEXT) {
@@ -495,15 +593,16 @@ bool external_log_format::scan_for_partial(shared_buffer_ref &sbr, size_t &len_o
 }
 
 log_format::scan_result_t external_log_format::scan(logfile &lf,
-                                                    std::vector<logline> &dst,
+                                                    chunked_vector<logline> &dst,
                                                     const line_info &li,
                                                     shared_buffer_ref &sbr)
 {
-    if (this->elf_type == ELF_TYPE_JSON) {
+    if (this->has_json_values()) {
         yajlpp_parse_context &ypc = *(this->jlf_parse_context);
         logline ll(li.li_file_range.fr_offset, 0, 0, LEVEL_INFO);
-        yajl_handle handle = this->jlf_yajl_handle.in();
+        yajl_handle handle = this->jlf_yajl_handle.get();
         json_log_userdata jlu(sbr);
+        msgpack_parser mp(ypc.ypc_callbacks, &ypc);
 
         if (li.li_partial) {
             log_debug("skipping partial line at offset %d", li.li_file_range.fr_offset);
@@ -525,12 +624,47 @@ log_format::scan_result_t external_log_format::scan(logfile &lf,
         jlu.jlu_line_value = sbr.get_data();
         jlu.jlu_line_size = sbr.length();
         jlu.jlu_handle = handle;
-        if (yajl_parse(handle, line_data, sbr.length()) == yajl_status_ok &&
-            yajl_complete_parse(handle) == yajl_status_ok) {
+
+        bool parsed;
+
+        if (this->elf_type == ELF_TYPE_MSGPACK) {
+            jlu.jlu_msgpack = &mp;
+            parsed = find_record_value(sbr, jlu.jlu_record_value,
+                                       jlu.jlu_line_size) &&
+                     mp.parse(jlu.jlu_record_value,
+                              jlu.jlu_line_size) == MPS_OK;
+        } else {
+            parsed = json_fast_parse(ypc.ypc_callbacks, &ypc,
+                                     sbr.get_data(), sbr.length()) == JFS_OK;
+        }
+
+        if (!parsed && this->elf_type == ELF_TYPE_JSON) {
+            // Start over with yajl, which also gives the error message.
+            ll = logline(li.li_file_range.fr_offset, 0, 0, LEVEL_INFO);
+            jlu.jlu_sub_line_count = 1;
+            jlu.jlu_numeric_values.clear();
+            jlu.jlu_opid.clear();
+            ypc.set_static_handler(json_log_handlers[0]);
+            parsed =
+                yajl_parse(handle, line_data, sbr.length()) == yajl_status_ok &&
+                yajl_complete_parse(handle) == yajl_status_ok;
+        }
+
+        if (parsed) {
             if (ll.get_time() == 0) {
                 return log_format::SCAN_NO_MATCH;
             }
 
+            for (const auto &nv : jlu.jlu_numeric_values) {
+                if (nv.first < this->lf_value_stats.size()) {
+                    this->lf_value_stats[nv.first].add_value(nv.second);
+                }
+            }
+            if (!jlu.jlu_opid.empty()) {
+                this->add_opid(jlu.jlu_opid.data(), jlu.jlu_opid.size(),
+                               dst.size(), ll.get_timeval());
+            }
+
             jlu.jlu_sub_line_count += this->jlf_line_format_init_count;
             for (int lpc = 0; lpc < jlu.jlu_sub_line_count; lpc++) {
                 ll.set_sub_offset(lpc);
@@ -545,15 +679,24 @@ log_format::scan_result_t external_log_format::scan(logfile &lf,
             unsigned char *msg;
             int line_count = 1;
 
-            msg = yajl_get_error(handle, 1, (const unsigned char *)sbr.get_data(), sbr.length());
+            if (!this->lf_specialized) {
+                return log_format::SCAN_NO_MATCH;
+            }
+            if (this->elf_type == ELF_TYPE_MSGPACK) {
+                msg = nullptr;
+                log_debug("Unable to decode record at offset %d: %s",
+                          li.li_file_range.fr_offset,
+                          jlu.jlu_record_value == nullptr ?
+                          "the length does not match the record" :
+                          mp.get_error().c_str());
+            } else {
+                msg = yajl_get_error(handle, 1, (const unsigned char *)sbr.get_data(), sbr.length());
+            }
             if (msg != nullptr) {
                 log_debug("Unable to parse line at offset %d: %s", li.li_file_range.fr_offset, msg);
                 line_count = count(msg, msg + strlen((char *) msg), '\n');
                 yajl_free_error(handle, msg);
             }
-            if (!this->lf_specialized) {
-                return log_format::SCAN_NO_MATCH;
-            }
             for (int lpc = 0; lpc < line_count; lpc++) {
                 log_level_t level = LEVEL_ERROR;
 
@@ -570,12 +713,23 @@ log_format::scan_result_t external_log_format::scan(logfile &lf,
         return log_format::SCAN_MATCH;
     }
 
+    // Continuation lines, like the frames of a stack trace, usually start
+    // with a byte that none of the patterns can match, so they can be
+    // passed over without trying each pattern.
+    if (!this->scan_prefilter(sbr)) {
+        return log_format::SCAN_NO_MATCH;
+    }
+
     pcre_input pi(sbr.get_data(), 0, sbr.length());
     pcre_context_static<128> pc;
     int curr_fmt = -1, orig_lock = this->last_pattern_index();
     int pat_index = orig_lock;
+    auto first_byte = (unsigned char) (sbr.length() > 0 ?
+                                       sbr.get_data()[0] : '\0');
+    size_t order_pos = 0;
 
-    while (::next_format(this->elf_pattern_order, curr_fmt, pat_index)) {
+    while (this->next_scan_pattern(first_byte, curr_fmt, pat_index,
+                                   order_pos)) {
         auto fpat = this->elf_pattern_order[curr_fmt];
         pcrepp *pat = fpat->p_pcre;
 
@@ -586,7 +740,7 @@ log_format::scan_result_t external_log_format::scan(logfile &lf,
         if (!pat->match(pc, pi)) {
             if (!this->lf_pattern_locks.empty() && pat_index != -1) {
                 log_debug("no match on pattern %d", pat_index);
-                curr_fmt = -1;
+                // Leave curr_fmt as it is so the pattern is not tried again.
                 pat_index = -1;
             }
             continue;
@@ -631,10 +785,15 @@ log_format::scan_result_t external_log_format::scan(logfile &lf,
         if (opid_cap != nullptr) {
             opid = hash_str(pi.get_substr_start(opid_cap), opid_cap->length());
         }
+        if (opid_cap != nullptr && opid_cap->is_valid()) {
+            this->add_opid(pi.get_substr_start(opid_cap), opid_cap->length(),
+                           dst.size(), log_tv);
+        }
 
         if (mod_cap != nullptr) {
             intern_string_t mod_name = intern_string::lookup(
                     pi.get_substr_start(mod_cap), mod_cap->length());
+            mutex_guard mg(MODULE_FORMATS_MUTEX);
             auto mod_iter = MODULE_FORMATS.find(mod_name);
 
             if (mod_iter == MODULE_FORMATS.end()) {
@@ -685,6 +844,14 @@ log_format::scan_result_t external_log_format::scan(logfile &lf,
 
         dst.emplace_back(li.li_file_range.fr_offset, log_tv, level, mod_index, opid);
 
+        if (pat_index == -1 && order_pos > 1) {
+            auto &order = this->elf_scan_order;
+
+            std::rotate(order.begin(),
+                        order.begin() + order_pos - 1,
+                        order.begin() + order_pos);
+        }
+
         if (orig_lock != curr_fmt) {
             uint32_t lock_line;
 
@@ -702,6 +869,40 @@ log_format::scan_result_t external_log_format::scan(logfile &lf,
     return log_format::SCAN_NO_MATCH;
 }
 
+bool external_log_format::next_scan_pattern(unsigned char first_byte,
+                                            int &curr_fmt,
+                                            int &locked_index,
+                                            size_t &order_pos) const
+{
+    if (locked_index != -1) {
+        if (curr_fmt == locked_index) {
+            return false;
+        }
+
+        curr_fmt = locked_index;
+        return true;
+    }
+
+    while (order_pos < this->elf_scan_order.size()) {
+        int index = this->elf_scan_order[order_pos];
+        const auto &pat = this->elf_pattern_order[index];
+
+        order_pos += 1;
+        if (index == curr_fmt) {
+            // The locked pattern that was already tried.
+            continue;
+        }
+        if (pat->p_first_bytes_valid && !pat->p_first_bytes.test(first_byte)) {
+            continue;
+        }
+
+        curr_fmt = index;
+        return true;
+    }
+
+    return false;
+}
+
 uint8_t external_log_format::module_scan(const pcre_input &pi,
                                          pcre_context::capture_t *body_cap,
                                          const intern_string_t &mod_name)
@@ -746,8 +947,12 @@ uint8_t external_log_format::module_scan(const pcre_input &pi,
     return 0;
 }
 
-void external_log_format::annotate(uint64_t line_number, shared_buffer_ref &line, string_attrs_t &sa,
-                                   std::vector<logline_value> &values, bool annotate_module) const
+void external_log_format::annotate_columns(uint64_t line_number,
+                                           shared_buffer_ref &line,
+                                           string_attrs_t &sa,
+                                           std::vector<logline_value> &values,
+                                           bool annotate_module,
+                                           const std::vector<bool> *columns) const
 {
     pcre_context_static<128> pc;
     pcre_input pi(line.get_data(), 0, line.length());
@@ -755,7 +960,19 @@ void external_log_format::annotate(uint64_t line_number, shared_buffer_ref &line
     pcre_context::capture_t *cap, *body_cap, *module_cap = NULL;
 
     if (this->elf_type != ELF_TYPE_TEXT) {
-        values = this->jlf_line_values;
+        if (columns == nullptr) {
+            values = this->jlf_line_values;
+        } else {
+            values.clear();
+            for (const auto &lv : this->jlf_line_values) {
+                if (lv.lv_column >= 0 &&
+                    (size_t) lv.lv_column < columns->size() &&
+                    !(*columns)[lv.lv_column]) {
+                    continue;
+                }
+                values.emplace_back(lv);
+            }
+        }
         sa = this->jlf_line_attrs;
         return;
     }
@@ -812,6 +1029,12 @@ void external_log_format::annotate(uint64_t line_number, shared_buffer_ref &line
         const value_def &vd = *ivd.ivd_value_def;
         shared_buffer_ref field;
 
+        if (columns != nullptr && vd.vd_column >= 0 &&
+            (size_t) vd.vd_column < columns->size() &&
+            !(*columns)[vd.vd_column]) {
+            continue;
+        }
+
         if (ivd.ivd_unit_field_index >= 0) {
             pcre_context::iterator unit_cap = pc[ivd.ivd_unit_field_index];
 
@@ -885,8 +1108,8 @@ void external_log_format::rewrite(exec_context &ec,
             continue;
         }
 
-        auto vd_iter = this->elf_value_defs.find(iter->lv_name);
-        if (vd_iter == this->elf_value_defs.end()) {
+        auto vd_iter = this->elf_value_defs->find(iter->lv_name);
+        if (vd_iter == this->elf_value_defs->end()) {
             log_debug("not rewriting undefined value -- %s", iter->lv_name.get());
             continue;
         }
@@ -939,6 +1162,7 @@ static int read_json_field(yajlpp_parse_context *ypc, const unsigned char *str,
     else if (jlu->jlu_format->elf_opid_field == field_name) {
         uint8_t opid = hash_str((const char *) str, len);
         jlu->jlu_base_line->set_opid(opid);
+        jlu->jlu_opid.assign((const char *) str, len);
     }
 
     jlu->jlu_sub_line_count += jlu->jlu_format->value_line_count(
@@ -1004,17 +1228,64 @@ static int rewrite_json_field(yajlpp_parse_context *ypc, const unsigned char *st
     return 1;
 }
 
+uint64_t external_log_format::elf_render_generation = 1;
+
+static off_t json_cache_key(off_t offset, bool full_message)
+{
+    return (offset << 1) | (full_message ? 1 : 0);
+}
+
 void external_log_format::get_subline(const logline &ll, shared_buffer_ref &sbr, bool full_message)
 {
     if (this->elf_type == ELF_TYPE_TEXT) {
         return;
     }
 
+    if (this->jlf_cache_generation != elf_render_generation) {
+        this->jlf_line_cache.clear();
+        this->jlf_cached_offset = -1;
+        this->jlf_cache_generation = elf_render_generation;
+    }
+
+    if (this->jlf_cached_offset != ll.get_offset() ||
+        this->jlf_cached_full != full_message) {
+        off_t key = json_cache_key(ll.get_offset(), full_message);
+
+        // The refs to the current line need their own copy before the line
+        // is moved into the cache, since it might be evicted later.
+        this->jlf_share_manager.invalidate_refs();
+        if (this->jlf_cached_offset != -1) {
+            this->jlf_line_cache.insert(
+                json_cache_key(this->jlf_cached_offset,
+                               this->jlf_cached_full),
+                json_cached_line{
+                    std::move(this->jlf_cached_line),
+                    std::move(this->jlf_line_offsets),
+                    std::move(this->jlf_line_values),
+                    std::move(this->jlf_line_attrs),
+                });
+            this->jlf_cached_offset = -1;
+        }
+
+        auto *cached = this->jlf_line_cache.find(key);
+
+        if (cached != nullptr) {
+            this->jlf_cached_line = std::move(cached->jcl_line);
+            this->jlf_line_offsets = std::move(cached->jcl_line_offsets);
+            this->jlf_line_values = std::move(cached->jcl_values);
+            this->jlf_line_attrs = std::move(cached->jcl_attrs);
+            this->jlf_line_cache.erase(key);
+            this->jlf_cached_offset = ll.get_offset();
+            this->jlf_cached_full = full_message;
+        }
+    }
+
     if (this->jlf_cached_offset != ll.get_offset() ||
         this->jlf_cached_full != full_message) {
         yajlpp_parse_context &ypc = *(this->jlf_parse_context);
-        yajl_handle handle = this->jlf_yajl_handle.in();
+        yajl_handle handle = this->jlf_yajl_handle.get();
         json_log_userdata jlu(sbr);
+        msgpack_parser mp(ypc.ypc_callbacks, &ypc);
 
         this->jlf_share_manager.invalidate_refs();
         this->jlf_cached_line.clear();
@@ -1035,15 +1306,32 @@ void external_log_format::get_subline(const logline &ll, shared_buffer_ref &sbr,
         jlu.jlu_handle = handle;
         jlu.jlu_line_value = sbr.get_data();
 
-        yajl_status parse_status = yajl_parse(handle,
-            (const unsigned char *)sbr.get_data(), sbr.length());
-        if (parse_status != yajl_status_ok ||
-            yajl_complete_parse(handle) != yajl_status_ok) {
+        bool parsed;
+
+        if (this->elf_type == ELF_TYPE_MSGPACK) {
+            jlu.jlu_msgpack = &mp;
+            parsed = find_record_value(sbr, jlu.jlu_record_value,
+                                       jlu.jlu_line_size) &&
+                     mp.parse(jlu.jlu_record_value,
+                              jlu.jlu_line_size) == MPS_OK;
+        } else {
+            parsed = yajl_parse(handle,
+                                (const unsigned char *)sbr.get_data(),
+                                sbr.length()) == yajl_status_ok &&
+                     yajl_complete_parse(handle) == yajl_status_ok;
+        }
+        if (!parsed) {
             unsigned char *msg;
             string full_msg;
 
-            msg = yajl_get_error(handle, 1, (const unsigned char *)sbr.get_data(), sbr.length());
-            if (msg != nullptr) {
+            if (this->elf_type == ELF_TYPE_MSGPACK) {
+                full_msg = fmt::format(
+                    "lnav: unable to decode record at offset {}: {}",
+                    ll.get_offset(),
+                    jlu.jlu_record_value == nullptr ?
+                    string("the length does not match the record") :
+                    mp.get_error());
+            } else if ((msg = yajl_get_error(handle, 1, (const unsigned char *)sbr.get_data(), sbr.length())) != nullptr) {
                 full_msg = fmt::format("lnav: unable to parse line at offset {}: {}", ll.get_offset(), msg);
                 yajl_free_error(handle, msg);
             }
@@ -1061,19 +1349,19 @@ void external_log_format::get_subline(const logline &ll, shared_buffer_ref &sbr,
                  lv_iter != this->jlf_line_values.end();
                  ++lv_iter) {
                 lv_iter->lv_format = this;
-                auto vd_iter = this->elf_value_defs.find(lv_iter->lv_name);
-                if (vd_iter != this->elf_value_defs.end()) {
-                    lv_iter->lv_identifier = vd_iter->second->vd_identifier;
-                    lv_iter->lv_column = vd_iter->second->vd_column;
-                    lv_iter->lv_hidden = vd_iter->second->vd_hidden;
-                    lv_iter->lv_user_hidden = vd_iter->second->vd_user_hidden;
+                auto vd = this->find_value_def(lv_iter->lv_name);
+                if (vd != nullptr) {
+                    lv_iter->lv_identifier = vd->vd_identifier;
+                    lv_iter->lv_column = vd->vd_column;
+                    lv_iter->lv_hidden = vd->vd_hidden;
+                    lv_iter->lv_user_hidden = vd->vd_user_hidden;
                 } else {
                     lv_iter->lv_hidden = this->jlf_hide_extra;
                 }
             }
 
             int sub_offset = 1 + this->jlf_line_format_init_count;
-            for (const auto &jfe : this->jlf_line_format) {
+            for (const auto &jfe : *this->jlf_line_format) {
                 static const intern_string_t ts_field = intern_string::lookup("__timestamp__", -1);
                 static const intern_string_t level_field = intern_string::lookup("__level__");
                 size_t begin_size = this->jlf_cached_line.size();
@@ -1088,20 +1376,28 @@ void external_log_format::get_subline(const logline &ll, shared_buffer_ref &sbr,
                                       this->jlf_line_values.end(),
                                       logline_value_cmp(&jfe.jfe_value));
                     if (lv_iter != this->jlf_line_values.end()) {
-                        string str = lv_iter->to_string();
-                        size_t nl_pos = str.find('\n');
+                        string str_buf;
+                        auto str = lv_iter->to_string_fragment();
+
+                        if (!str.is_valid()) {
+                            str_buf = lv_iter->to_string();
+                            str = str_buf;
+                        }
+
+                        auto nl = (const char *) memchr(
+                            str.data(), '\n', str.length());
 
                         lr.lr_start = this->jlf_cached_line.size();
 
                         lv_iter->lv_hidden = lv_iter->lv_user_hidden;
-                        if ((int)str.size() > jfe.jfe_max_width) {
+                        if (str.length() > jfe.jfe_max_width) {
                             switch (jfe.jfe_overflow) {
                                 case json_format_element::overflow_t::ABBREV: {
                                     this->json_append_to_cache(
-                                        str.c_str(), str.size());
+                                        str.data(), str.length());
                                     size_t new_size = abbreviate_str(
                                         &this->jlf_cached_line[lr.lr_start],
-                                        str.size(),
+                                        str.length(),
                                         jfe.jfe_max_width);
 
                                     this->jlf_cached_line.resize(
@@ -1110,30 +1406,33 @@ void external_log_format::get_subline(const logline &ll, shared_buffer_ref &sbr,
                                 }
                                 case json_format_element::overflow_t::TRUNCATE: {
                                     this->json_append_to_cache(
-                                        str.c_str(), jfe.jfe_max_width);
+                                        str.data(), jfe.jfe_max_width);
                                     break;
                                 }
                                 case json_format_element::overflow_t::DOTDOT: {
                                     size_t middle = (jfe.jfe_max_width / 2) - 1;
                                     this->json_append_to_cache(
-                                        str.c_str(), middle);
+                                        str.data(), middle);
                                     this->json_append_to_cache("..", 2);
                                     size_t rest = (jfe.jfe_max_width - middle - 2);
                                     this->json_append_to_cache(
-                                        str.c_str() + str.size() - rest, rest);
+                                        str.data() + str.length() - rest,
+                                        rest);
                                     break;
                                 }
                             }
                         }
                         else {
-                            sub_offset += count(str.begin(), str.end(), '\n');
-                            this->json_append(jfe, str.c_str(), str.size());
+                            sub_offset += count(str.data(),
+                                                str.data() + str.length(),
+                                                '\n');
+                            this->json_append(jfe, str.data(), str.length());
                         }
 
-                        if (nl_pos == string::npos || full_message) {
+                        if (nl == nullptr || full_message) {
                             lr.lr_end = this->jlf_cached_line.size();
                         } else {
-                            lr.lr_end = lr.lr_start + nl_pos;
+                            lr.lr_end = lr.lr_start + (nl - str.data());
                         }
 
                         if (lv_iter->lv_name == this->lf_timestamp_field) {
@@ -1164,9 +1463,8 @@ void external_log_format::get_subline(const logline &ll, shared_buffer_ref &sbr,
                             struct exttm et;
 
                             ll.to_exttm(et);
-                            ts_len = ftime_fmt(ts, sizeof(ts),
-                                               jfe.jfe_ts_format.c_str(),
-                                               et);
+                            ts_len = jfe.jfe_ts_program.format(ts, sizeof(ts),
+                                                               et);
                         }
                         lr.lr_start = this->jlf_cached_line.size();
                         this->json_append_to_cache(ts, ts_len);
@@ -1226,30 +1524,43 @@ void external_log_format::get_subline(const logline &ll, shared_buffer_ref &sbr,
                     continue;
                 }
 
-                const std::string str = lv.to_string();
+                string str_buf;
+                auto str = lv.to_string_fragment();
+
+                if (!str.is_valid()) {
+                    str_buf = lv.to_string();
+                    str = str_buf;
+                }
+
+                size_t str_len = str.length();
                 size_t curr_pos = 0, nl_pos, line_len = -1;
 
                 lv.lv_sub_offset = sub_offset;
                 lv.lv_origin.lr_start = 2 + lv.lv_name.size() + 2;
                 do {
-                    nl_pos = str.find('\n', curr_pos);
-                    if (nl_pos != std::string::npos) {
+                    auto nl = (const char *) memchr(str.data() + curr_pos,
+                                                    '\n',
+                                                    str_len - curr_pos);
+
+                    if (nl != nullptr) {
+                        nl_pos = nl - str.data();
                         line_len = nl_pos - curr_pos;
                     }
                     else {
-                        line_len = str.size() - curr_pos;
+                        nl_pos = std::string::npos;
+                        line_len = str_len - curr_pos;
                     }
                     this->json_append_to_cache("  ", 2);
                     this->json_append_to_cache(lv.lv_name.get(),
                                                lv.lv_name.size());
                     this->json_append_to_cache(": ", 2);
                     this->json_append_to_cache(
-                        &str.c_str()[curr_pos], line_len);
+                        str.data() + curr_pos, line_len);
                     this->json_append_to_cache("\n", 1);
                     curr_pos = nl_pos + 1;
                     sub_offset += 1;
                 } while (nl_pos != std::string::npos &&
-                         nl_pos < str.size());
+                         nl_pos < str_len);
             }
 
         }
@@ -1297,7 +1608,7 @@ void external_log_format::get_subline(const logline &ll, shared_buffer_ref &sbr,
 
 void external_log_format::build(std::vector<std::string> &errors) {
     if (!this->lf_timestamp_field.empty()) {
-        auto &vd = this->elf_value_defs[this->lf_timestamp_field];
+        auto &vd = (*this->elf_value_defs)[this->lf_timestamp_field];
         if (vd.get() == nullptr) {
             vd = make_shared<external_log_format::value_def>();
         }
@@ -1305,9 +1616,9 @@ void external_log_format::build(std::vector<std::string> &errors) {
         vd->vd_kind = logline_value::VALUE_TEXT;
         vd->vd_internal = true;
     }
-    if (!this->elf_level_field.empty() && this->elf_value_defs.
-        find(this->elf_level_field) == this->elf_value_defs.end()) {
-        auto &vd = this->elf_value_defs[this->elf_level_field];
+    if (!this->elf_level_field.empty() && this->elf_value_defs->
+        find(this->elf_level_field) == this->elf_value_defs->end()) {
+        auto &vd = (*this->elf_value_defs)[this->elf_level_field];
         if (vd.get() == nullptr) {
             vd = make_shared<external_log_format::value_def>();
         }
@@ -1316,7 +1627,7 @@ void external_log_format::build(std::vector<std::string> &errors) {
         vd->vd_internal = true;
     }
     if (!this->elf_body_field.empty()) {
-        auto &vd = this->elf_value_defs[this->elf_body_field];
+        auto &vd = (*this->elf_value_defs)[this->elf_body_field];
         if (vd.get() == nullptr) {
             vd = make_shared<external_log_format::value_def>();
         }
@@ -1336,8 +1647,8 @@ void external_log_format::build(std::vector<std::string> &errors) {
                          this->elf_name.to_string() + ".file-pattern:" +
                          e.what());
     }
-    for (auto iter = this->elf_patterns.begin();
-         iter != this->elf_patterns.end();
+    for (auto iter = this->elf_patterns->begin();
+         iter != this->elf_patterns->end();
          ++iter) {
         pattern &pat = *iter->second;
 
@@ -1387,8 +1698,8 @@ void external_log_format::build(std::vector<std::string> &errors) {
                 pat.p_body_field_index = name_iter->index();
             }
 
-            auto value_iter = this->elf_value_defs.find(name);
-            if (value_iter != this->elf_value_defs.end()) {
+            auto value_iter = this->elf_value_defs->find(name);
+            if (value_iter != this->elf_value_defs->end()) {
                 auto &vd = *value_iter->second;
                 indexed_value_def ivd;
 
@@ -1446,33 +1757,54 @@ void external_log_format::build(std::vector<std::string> &errors) {
         this->elf_pattern_order.push_back(iter->second);
     }
 
+    this->elf_scan_order.clear();
+    this->elf_first_bytes.reset();
+    this->elf_first_bytes_valid = this->elf_type == ELF_TYPE_TEXT;
+    for (size_t lpc = 0; lpc < this->elf_pattern_order.size(); lpc++) {
+        auto &pat = this->elf_pattern_order[lpc];
+
+        this->elf_scan_order.push_back(lpc);
+        if (pat->p_module_format) {
+            continue;
+        }
+        pat->p_first_bytes.reset();
+        pat->p_first_bytes_valid = pcrepp::anchored_first_bytes(
+            pat->p_string.c_str(), pat->p_first_bytes);
+        if (pat->p_first_bytes_valid) {
+            this->elf_first_bytes |= pat->p_first_bytes;
+        }
+        else {
+            this->elf_first_bytes_valid = false;
+        }
+    }
+
     if (this->elf_type != ELF_TYPE_TEXT) {
-        if (!this->elf_patterns.empty()) {
+        if (!this->elf_patterns->empty()) {
             errors.push_back("error:" +
                              this->elf_name.to_string() +
                              ": structured logs cannot have regexes");
         }
-        if (this->elf_type == ELF_TYPE_JSON) {
+        if (this->has_json_values()) {
             this->jlf_parse_context.reset(
                 new yajlpp_parse_context(this->elf_name.to_string()));
             this->jlf_yajl_handle.reset(yajl_alloc(
                 &this->jlf_parse_context->ypc_callbacks,
                 NULL,
-                this->jlf_parse_context.get()));
-            yajl_config(this->jlf_yajl_handle.in(), yajl_dont_validate_strings,
+                this->jlf_parse_context.get()), yajl_free);
+            yajl_config(this->jlf_yajl_handle.get(), yajl_dont_validate_strings,
                         1);
         }
 
     }
     else {
-        if (this->elf_patterns.empty()) {
+        if (this->elf_patterns->empty()) {
             errors.push_back("error:" +
                              this->elf_name.to_string() +
                              ": no regexes specified for format");
         }
     }
 
-    for (auto &elf_level_pattern : this->elf_level_patterns) {
+    for (auto &elf_level_pattern : *this->elf_level_patterns) {
         try {
             elf_level_pattern.second.lp_pcre = new pcrepp(
                 elf_level_pattern.second.lp_regex.c_str());
@@ -1483,9 +1815,9 @@ void external_log_format::build(std::vector<std::string> &errors) {
         }
     }
 
-    stable_sort(this->elf_level_pairs.begin(), this->elf_level_pairs.end());
+    stable_sort(this->elf_level_pairs->begin(), this->elf_level_pairs->end());
 
-    for (auto &elf_value_def : this->elf_value_defs) {
+    for (auto &elf_value_def : *this->elf_value_defs) {
         std::vector<std::string>::iterator act_iter;
 
         if (!elf_value_def.second->vd_internal &&
@@ -1510,13 +1842,13 @@ void external_log_format::build(std::vector<std::string> &errors) {
         }
     }
 
-    if (this->elf_type == ELF_TYPE_TEXT && this->elf_samples.empty()) {
+    if (this->elf_type == ELF_TYPE_TEXT && this->elf_samples->empty()) {
         errors.push_back("error:" +
                          this->elf_name.to_string() +
                          ":no sample logs provided, all formats must have samples");
     }
 
-    for (auto &elf_sample : this->elf_samples) {
+    for (auto &elf_sample : *this->elf_samples) {
         pcre_context_static<128> pc;
         pcre_input pi(elf_sample.s_line);
         bool found = false;
@@ -1650,7 +1982,7 @@ void external_log_format::build(std::vector<std::string> &errors) {
         }
     }
 
-    for (auto &elf_value_def : this->elf_value_defs) {
+    for (auto &elf_value_def : *this->elf_value_defs) {
         if (elf_value_def.second->vd_foreign_key || elf_value_def.second->vd_identifier) {
             continue;
         }
@@ -1658,19 +1990,19 @@ void external_log_format::build(std::vector<std::string> &errors) {
         switch (elf_value_def.second->vd_kind) {
             case logline_value::VALUE_INTEGER:
             case logline_value::VALUE_FLOAT:
-                elf_value_def.second->vd_values_index = this->elf_numeric_value_defs.size();
-                this->elf_numeric_value_defs.push_back(elf_value_def.second);
+                elf_value_def.second->vd_values_index = this->elf_numeric_value_defs->size();
+                this->elf_numeric_value_defs->push_back(elf_value_def.second);
                 break;
             default:
                 break;
         }
     }
 
-    this->lf_value_stats.resize(this->elf_numeric_value_defs.size());
+    this->lf_value_stats.resize(this->elf_numeric_value_defs->size());
 
     int format_index = 0;
-    for (auto iter = this->jlf_line_format.begin();
-         iter != this->jlf_line_format.end();
+    for (auto iter = this->jlf_line_format->begin();
+         iter != this->jlf_line_format->end();
          ++iter, format_index++) {
         static const intern_string_t ts = intern_string::lookup("__timestamp__");
         static const intern_string_t level_field = intern_string::lookup("__level__");
@@ -1684,16 +2016,17 @@ void external_log_format::build(std::vector<std::string> &errors) {
                             jfe.jfe_value.get());
             }
             jfe.jfe_value = ts;
+            jfe.jfe_ts_program = ftime_program(jfe.jfe_ts_format.c_str());
         }
 
         switch (jfe.jfe_type) {
             case JLF_VARIABLE: {
-                auto vd_iter = this->elf_value_defs.find(jfe.jfe_value);
+                auto vd_iter = this->elf_value_defs->find(jfe.jfe_value);
                 if (jfe.jfe_value == ts) {
-                    this->elf_value_defs[this->lf_timestamp_field]->vd_hidden = true;
+                    (*this->elf_value_defs)[this->lf_timestamp_field]->vd_hidden = true;
                 } else if (jfe.jfe_value == level_field) {
-                    this->elf_value_defs[this->elf_level_field]->vd_hidden = true;
-                } else if (vd_iter == this->elf_value_defs.end()) {
+                    (*this->elf_value_defs)[this->elf_level_field]->vd_hidden = true;
+                } else if (vd_iter == this->elf_value_defs->end()) {
                     char index_str[32];
 
                     snprintf(index_str, sizeof(index_str), "%d", format_index);
@@ -1717,7 +2050,7 @@ void external_log_format::build(std::vector<std::string> &errors) {
         }
     }
 
-    for (auto &hd_pair : this->elf_highlighter_patterns) {
+    for (auto &hd_pair : *this->elf_highlighter_patterns) {
         external_log_format::highlighter_def &hd = hd_pair.second;
         const std::string &pattern = hd.hd_pattern;
         std::string errmsg;
@@ -1789,14 +2122,20 @@ void external_log_format::build(std::vector<std::string> &errors) {
                 .with_attrs(attrs);
         }
     }
+
+    this->elf_value_def_index->clear();
+    for (const auto &vd_pair : *this->elf_value_defs) {
+        (*this->elf_value_def_index)[vd_pair.first.unwrap()] =
+            vd_pair.second.get();
+    }
 }
 
 void external_log_format::register_vtabs(log_vtab_manager *vtab_manager,
                                          std::vector<std::string> &errors)
 {
     vector<pair<intern_string_t, string> >::iterator search_iter;
-    for (search_iter = this->elf_search_tables.begin();
-         search_iter != this->elf_search_tables.end();
+    for (search_iter = this->elf_search_tables->begin();
+         search_iter != this->elf_search_tables->end();
          ++search_iter) {
         log_search_table *lst;
 
@@ -1860,7 +2199,7 @@ public:
         const external_log_format &elf = this->elt_format;
 
         cols.resize(elf.elf_column_count);
-        for (const auto &elf_value_def : elf.elf_value_defs) {
+        for (const auto &elf_value_def : *elf.elf_value_defs) {
             const auto &vd = *elf_value_def.second;
             pair<int, unsigned int> type_pair = log_vtab_impl::logline_value_to_sqlite_type(vd.vd_kind);
 
@@ -1880,7 +2219,7 @@ public:
     {
         log_vtab_impl::get_foreign_keys(keys_inout);
 
-        for (const auto &elf_value_def : this->elt_format.elf_value_defs) {
+        for (const auto &elf_value_def : *this->elt_format.elf_value_defs) {
             if (elf_value_def.second->vd_foreign_key) {
                 keys_inout.push_back(elf_value_def.first.to_string());
             }
@@ -1896,8 +2235,8 @@ public:
             return true;
         }
 
-        content_line_t cl(lss.at(lc.lc_curr_line));
-        shared_ptr<logfile> lf = lss.find(cl);
+        content_line_t cl(lc.line_at(lc.lc_curr_line));
+        logfile *lf = lss.find_file_ptr(cl);
         auto lf_iter = lf->begin() + cl;
         uint8_t mod_id = lf_iter->get_module_id();
 
@@ -1969,14 +2308,224 @@ public:
                                                             false);
         }
         else {
+            auto elf = dynamic_cast<external_log_format *>(format);
+
             this->vi_attrs.clear();
-            format->annotate(line_number, line, this->vi_attrs, values, false);
+            if (lf->find_annotations(line_number, line, this->vi_attrs, values)) {
+                return;
+            }
+            if (elf != nullptr) {
+                elf->annotate_columns(line_number, line, this->vi_attrs,
+                                      values, false, this->vi_columns_used);
+            } else {
+                format->annotate(line_number, line, this->vi_attrs, values,
+                                 false);
+            }
+        }
+    };
+
+    bool can_extract_concurrently(const logfile &lf) const {
+        auto elf = dynamic_cast<const external_log_format *>(
+            lf.get_format());
+
+        // Lines for module formats are found in the bodies of other
+        // formats, so only the plain lines of text formats qualify.
+        return this->lfvi_format.lf_mod_index == 0 &&
+               elf != nullptr &&
+               elf->get_name() == this->lfvi_format.get_name() &&
+               elf->elf_type == external_log_format::ELF_TYPE_TEXT;
+    };
+
+    void extract_concurrent(const logfile &lf,
+                            uint64_t line_number,
+                            shared_buffer_ref &line,
+                            const std::vector<bool> *columns,
+                            string_attrs_t &sa,
+                            std::vector<logline_value> &values) const {
+        auto elf = dynamic_cast<const external_log_format *>(
+            lf.get_format());
+
+        elf->annotate_columns(line_number, line, sa, values, false, columns);
+    };
+
+    bool has_index(int col) const {
+        return this->index_value_def(col) != nullptr;
+    };
+
+    bool index_lookup(int col,
+                      sqlite3_value *value,
+                      logfile_sub_source &lss,
+                      std::vector<vis_line_t> &lines_out) {
+        const auto *vd = this->index_value_def(col);
+        string key;
+
+        if (vd == nullptr) {
+            return false;
+        }
+
+        switch (sqlite3_value_type(value)) {
+            case SQLITE_NULL:
+                // Nothing is equal to NULL.
+                lines_out.clear();
+                return true;
+            case SQLITE_INTEGER:
+                if (vd->vd_kind == logline_value::VALUE_INTEGER) {
+                    key = std::to_string(sqlite3_value_int64(value));
+                    break;
+                }
+                // fallthrough
+            default:
+                // A text value would need the column's affinity applied to
+                // compare with an integer field, so skip the index.
+                if (vd->vd_kind != logline_value::VALUE_TEXT) {
+                    return false;
+                }
+                key.assign((const char *) sqlite3_value_text(value),
+                           sqlite3_value_bytes(value));
+                break;
         }
+
+        auto &ci = this->elt_indexes[col];
+
+        this->update_index(ci, *vd, lss);
+        lines_out.clear();
+
+        auto iter = ci.ci_values.find(key);
+
+        if (iter == ci.ci_values.end()) {
+            return true;
+        }
+
+        for (auto cl : iter->second) {
+            auto vl = lss.find_from_content(cl);
+
+            if (vl) {
+                lines_out.push_back(vl.value());
+            }
+        }
+        sort(lines_out.begin(), lines_out.end());
+
+        return true;
     };
 
     const external_log_format &elt_format;
     module_format elt_module_format;
     struct line_range elt_container_body;
+
+private:
+    /**
+     * Maps the values in a field to the lines that contain them.
+     */
+    struct column_index {
+        size_t ci_generation{0};
+        /** The number of lines in each file that have been indexed. */
+        std::vector<size_t> ci_lines_indexed;
+        std::unordered_map<std::string, std::vector<content_line_t>> ci_values;
+    };
+
+    const external_log_format::value_def *index_value_def(int col) const {
+        // Lines from other formats can contain messages for a module
+        // format, those are not indexed.
+        if (this->lfvi_format.lf_mod_index != 0) {
+            return nullptr;
+        }
+
+        for (const auto &elf_value_def : *this->elt_format.elf_value_defs) {
+            const auto &vd = *elf_value_def.second;
+
+            if (vd.vd_column == -1 || vd.vd_column != col - VT_COL_MAX) {
+                continue;
+            }
+
+            // The index only works for values that sqlite compares as is.
+            if (!vd.vd_indexed || !vd.vd_collate.empty()) {
+                return nullptr;
+            }
+            switch (vd.vd_kind) {
+                case logline_value::VALUE_TEXT:
+                case logline_value::VALUE_INTEGER:
+                    return &vd;
+                default:
+                    return nullptr;
+            }
+        }
+
+        return nullptr;
+    };
+
+    /**
+     * Add the lines that have been added to the view since the last update
+     * to the index or rebuild it if the lines in a file were replaced.
+     */
+    void update_index(column_index &ci,
+                      const external_log_format::value_def &vd,
+                      logfile_sub_source &lss) {
+        if (ci.ci_generation != lss.get_index_generation()) {
+            ci.ci_generation = lss.get_index_generation();
+            ci.ci_lines_indexed.clear();
+            ci.ci_values.clear();
+        }
+
+        std::vector<logline_value> values;
+        string_attrs_t sa;
+        shared_buffer_ref sbr;
+
+        for (auto ld : lss) {
+            auto lf = ld->get_file();
+
+            if (lf == nullptr || lf->get_format() == nullptr ||
+                lf->get_format()->get_name() != this->elt_format.get_name()) {
+                continue;
+            }
+
+            if (ci.ci_lines_indexed.size() <= ld->ld_file_index) {
+                ci.ci_lines_indexed.resize(ld->ld_file_index + 1);
+            }
+
+            auto &lines_indexed = ci.ci_lines_indexed[ld->ld_file_index];
+            auto *format = lf->get_format();
+
+            for (; lines_indexed < ld->ld_lines_indexed; lines_indexed++) {
+                auto ll = lf->begin() + lines_indexed;
+
+                if (ll->is_continued()) {
+                    continue;
+                }
+
+                lf->read_full_message(ll, sbr);
+                sa.clear();
+                values.clear();
+                format->annotate(lines_indexed, sbr, sa, values, false);
+
+                auto lv_iter = find_if(values.begin(), values.end(),
+                                       logline_value_cmp(nullptr,
+                                                         vd.vd_column));
+
+                if (lv_iter == values.end()) {
+                    continue;
+                }
+
+                string key;
+
+                switch (lv_iter->lv_kind) {
+                    case logline_value::VALUE_TEXT:
+                        key.assign(lv_iter->text_value(),
+                                   lv_iter->text_length());
+                        break;
+                    case logline_value::VALUE_INTEGER:
+                        key = std::to_string(lv_iter->lv_value.i);
+                        break;
+                    default:
+                        continue;
+                }
+
+                ci.ci_values[key].push_back(
+                    lss.get_content_line(ld, lines_indexed));
+            }
+        }
+    };
+
+    std::map<int, column_index> elt_indexes;
 };
 
 log_vtab_impl *external_log_format::get_vtab_impl() const
@@ -2001,6 +2550,102 @@ int log_format::pattern_index_for_line(uint64_t line_number) const
     return iter->pfl_pat_index;
 }
 
+void log_format::add_opid(const char *opid, size_t len,
+                          uint32_t line, const struct timeval &tv)
+{
+    require(line >= this->lf_opid_max_line);
+
+    this->lf_opids[std::string(opid, len)].add_line(line, tv);
+    this->lf_opid_max_line = line + 1;
+}
+
+void log_format::truncate_opids(size_t line_count)
+{
+    if (line_count >= this->lf_opid_max_line) {
+        return;
+    }
+
+    uint32_t max_line = 0;
+
+    for (auto iter = this->lf_opids.begin(); iter != this->lf_opids.end(); ) {
+        auto &lines = iter->second.od_lines;
+
+        while (!lines.empty() && lines.back() >= line_count) {
+            lines.pop_back();
+        }
+        if (lines.empty()) {
+            iter = this->lf_opids.erase(iter);
+            continue;
+        }
+        max_line = std::max(max_line, lines.back() + 1);
+        ++iter;
+    }
+    this->lf_opid_max_line = max_line;
+}
+
+void log_format::prepend_opids(log_opid_map &prefix, size_t prefix_size)
+{
+    for (auto &pair : this->lf_opids) {
+        auto &desc = prefix[pair.first];
+        bool was_empty = desc.od_lines.empty();
+
+        for (auto line : pair.second.od_lines) {
+            desc.od_lines.push_back(line + prefix_size);
+        }
+        if (was_empty || pair.second.od_begin < desc.od_begin) {
+            desc.od_begin = pair.second.od_begin;
+        }
+        if (was_empty || desc.od_end < pair.second.od_end) {
+            desc.od_end = pair.second.od_end;
+        }
+    }
+    this->lf_opids = std::move(prefix);
+    if (this->lf_opid_max_line > 0) {
+        this->lf_opid_max_line += prefix_size;
+    }
+    else if (!this->lf_opids.empty()) {
+        this->lf_opid_max_line = prefix_size;
+    }
+}
+
+void log_format::drop_lines_before(size_t line_count)
+{
+    uint32_t max_line = 0;
+
+    for (auto iter = this->lf_opids.begin(); iter != this->lf_opids.end(); ) {
+        auto &lines = iter->second.od_lines;
+        auto keep = std::lower_bound(lines.begin(), lines.end(), line_count);
+
+        lines.erase(lines.begin(), keep);
+        if (lines.empty()) {
+            iter = this->lf_opids.erase(iter);
+            continue;
+        }
+        for (auto &line : lines) {
+            line -= line_count;
+        }
+        max_line = std::max(max_line, lines.back() + 1);
+        ++iter;
+    }
+    this->lf_opid_max_line = max_line;
+
+    // The lock that covers the first line that is kept now starts at zero.
+    auto &locks = this->lf_pattern_locks;
+    auto first_kept = std::find_if(locks.begin(), locks.end(),
+        [line_count](const pattern_for_lines &pfl) {
+            return pfl.pfl_line > line_count;
+        });
+
+    if (first_kept != locks.begin()) {
+        --first_kept;
+    }
+    locks.erase(locks.begin(), first_kept);
+    for (auto &pfl : locks) {
+        pfl.pfl_line = pfl.pfl_line > line_count ?
+                       pfl.pfl_line - line_count : 0;
+    }
+}
+
 log_format::pattern_for_lines::pattern_for_lines(
     uint32_t pfl_line, uint32_t pfl_pat_index) :
     pfl_line(pfl_line), pfl_pat_index(pfl_pat_index)
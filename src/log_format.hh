@@ -41,6 +41,7 @@
 
 #include <set>
 #include <list>
+#include <unordered_map>
 #include <string>
 #include <vector>
 #include <limits>
@@ -50,11 +51,14 @@
 #include "optional.hpp"
 #include "pcrepp/pcrepp.hh"
 #include "yajlpp/yajlpp.hh"
+#include "base/chunked_vector.hh"
 #include "base/lnav_log.hh"
 #include "lnav_util.hh"
 #include "byte_array.hh"
 #include "view_curses.hh"
 #include "base/intern_string.hh"
+#include "base/lru_cache.hh"
+#include "base/sketches.hh"
 #include "shared_buffer.hh"
 #include "highlighter.hh"
 #include "log_level.hh"
@@ -93,15 +97,15 @@ public:
             log_level_t l,
             uint8_t mod = 0,
             uint8_t opid = 0)
-        : ll_offset(off),
-          ll_time(t),
-          ll_millis(millis),
+        : ll_millis(millis),
           ll_opid(opid),
           ll_sub_offset(0),
           ll_valid_utf(1),
           ll_level(l),
           ll_module_id(mod)
     {
+        this->set_offset(off);
+        this->set_time(t);
         memset(this->ll_schema, 0, sizeof(this->ll_schema));
     };
 
@@ -110,33 +114,45 @@ public:
             log_level_t l,
             uint8_t mod = 0,
             uint8_t opid = 0)
-        : ll_offset(off),
-          ll_opid(opid),
+        : ll_opid(opid),
           ll_sub_offset(0),
           ll_valid_utf(1),
           ll_level(l),
           ll_module_id(mod)
     {
+        this->set_offset(off);
         this->set_time(tv);
         memset(this->ll_schema, 0, sizeof(this->ll_schema));
     };
 
     /** @return The offset of the line in the file. */
-    off_t get_offset() const { return this->ll_offset; };
+    off_t get_offset() const {
+        return (off_t) this->ll_offset_lo |
+               ((off_t) this->ll_offset_hi << 32);
+    };
 
     uint16_t get_sub_offset() const { return this->ll_sub_offset; };
 
     void set_sub_offset(uint16_t suboff) { this->ll_sub_offset = suboff; };
 
     /** @return The timestamp for the line. */
-    time_t get_time() const { return this->ll_time; };
+    time_t get_time() const {
+        return (time_t) this->ll_time_hi * TIME_HI_SCALE +
+               (time_t) this->ll_time_lo;
+    };
 
     void to_exttm(struct exttm &tm_out) const {
-        tm_out.et_tm = *gmtime(&this->ll_time);
+        time_t t = this->get_time();
+
+        secs2tm(&t, &tm_out.et_tm);
         tm_out.et_nsec = this->ll_millis * 1000 * 1000;
     };
 
-    void set_time(time_t t) { this->ll_time = t; };
+    void set_time(time_t t) {
+        this->ll_time_lo = (uint32_t) t;
+        this->ll_time_hi = (int16_t) ((t - (time_t) this->ll_time_lo) /
+                                      TIME_HI_SCALE);
+    };
 
     /** @return The millisecond timestamp for the line. */
     uint16_t get_millis() const { return this->ll_millis; };
@@ -144,17 +160,17 @@ public:
     void set_millis(uint16_t m) { this->ll_millis = m; };
 
     uint64_t get_time_in_millis() const {
-        return (this->ll_time * 1000ULL + (uint64_t) this->ll_millis);
+        return (this->get_time() * 1000ULL + (uint64_t) this->ll_millis);
     };
 
     struct timeval get_timeval() const {
-        struct timeval retval = { this->ll_time, this->ll_millis * 1000 };
+        struct timeval retval = { this->get_time(), this->ll_millis * 1000 };
 
         return retval;
     };
 
     void set_time(const struct timeval &tv) {
-        this->ll_time = tv.tv_sec;
+        this->set_time(tv.tv_sec);
         this->ll_millis = tv.tv_usec / 1000;
     };
 
@@ -267,34 +283,58 @@ public:
      */
     bool operator<(const logline &rhs) const
     {
-        return (this->ll_time < rhs.ll_time) ||
-               (this->ll_time == rhs.ll_time &&
-                this->ll_millis < rhs.ll_millis) ||
-               (this->ll_time == rhs.ll_time &&
-                this->ll_millis == rhs.ll_millis &&
-                this->ll_offset < rhs.ll_offset) ||
-               (this->ll_time == rhs.ll_time &&
-                this->ll_millis == rhs.ll_millis &&
-                this->ll_offset == rhs.ll_offset &&
-                this->ll_sub_offset < rhs.ll_sub_offset);
+        time_t lhs_time = this->get_time(), rhs_time = rhs.get_time();
+
+        if (lhs_time != rhs_time) {
+            return lhs_time < rhs_time;
+        }
+        if (this->ll_millis != rhs.ll_millis) {
+            return this->ll_millis < rhs.ll_millis;
+        }
+
+        off_t lhs_off = this->get_offset(), rhs_off = rhs.get_offset();
+
+        if (lhs_off != rhs_off) {
+            return lhs_off < rhs_off;
+        }
+        return this->ll_sub_offset < rhs.ll_sub_offset;
     };
 
-    bool operator<(const time_t &rhs) const { return this->ll_time < rhs; };
+    bool operator<(const time_t &rhs) const { return this->get_time() < rhs; };
 
     bool operator<(const struct timeval &rhs) const {
-        return ((this->ll_time < rhs.tv_sec) ||
-                ((this->ll_time == rhs.tv_sec) &&
+        time_t t = this->get_time();
+
+        return ((t < rhs.tv_sec) ||
+                ((t == rhs.tv_sec) &&
                  (this->ll_millis < (rhs.tv_usec / 1000))));
     };
 
     bool operator<=(const struct timeval &rhs) const {
-        return ((this->ll_time < rhs.tv_sec) ||
-                ((this->ll_time == rhs.tv_sec) &&
+        time_t t = this->get_time();
+
+        return ((t < rhs.tv_sec) ||
+                ((t == rhs.tv_sec) &&
                  (this->ll_millis <= (rhs.tv_usec / 1000))));
     };
 private:
-    off_t    ll_offset;
-    time_t   ll_time;
+    static constexpr time_t TIME_HI_SCALE = 1LL << 32;
+
+    void set_offset(off_t off) {
+        this->ll_offset_lo = (uint32_t) off;
+        this->ll_offset_hi = (uint16_t) (off >> 32);
+    };
+
+    /*
+     * The offset and time are split into 32-bit halves so that the struct
+     * only needs four-byte alignment and avoids padding.  That leaves 48
+     * bits for each, which is 256TB for offsets and several million years
+     * for times.
+     */
+    uint32_t ll_offset_lo;
+    uint32_t ll_time_lo;
+    uint16_t ll_offset_hi;
+    int16_t  ll_time_hi;
     unsigned int ll_millis : 10;
     unsigned int ll_opid : 6;
     unsigned int ll_sub_offset : 15;
@@ -304,6 +344,8 @@ private:
     char     ll_schema[2];
 };
 
+static_assert(sizeof(logline) == 20, "logline should be packed");
+
 enum class scale_op_t {
     SO_IDENTITY,
     SO_MULTIPLY,
@@ -498,6 +540,28 @@ public:
         return std::string(buffer);
     };
 
+    /**
+     * @return The text of the value without making a copy, if the value is
+     *   stored as text.  Otherwise, the fragment is invalid and to_string()
+     *   needs to be used to format the value.
+     */
+    string_fragment to_string_fragment() const {
+        switch (this->lv_kind) {
+            case VALUE_JSON:
+            case VALUE_STRUCT:
+            case VALUE_TEXT:
+            case VALUE_TIMESTAMP:
+                return string_fragment(this->text_value(), 0,
+                                       this->text_length());
+            default: {
+                string_fragment retval("", 0, 0);
+
+                retval.invalidate();
+                return retval;
+            }
+        }
+    };
+
     const char *text_value() const {
         if (this->lv_sbr.empty()) {
             if (this->lv_intern_string.empty()) {
@@ -539,6 +603,11 @@ public:
     const log_format *lv_format;
 };
 
+/**
+ * The statistics for a numeric value in a log, these are updated as the
+ * file is indexed so they are ready for things like the spectrogram without
+ * another pass over the file.
+ */
 struct logline_value_stats {
 
     logline_value_stats() {
@@ -550,6 +619,7 @@ struct logline_value_stats {
         this->lvs_total = 0;
         this->lvs_min_value = std::numeric_limits<double>::max();
         this->lvs_max_value = -std::numeric_limits<double>::max();
+        this->lvs_sketch = quantile_sketch();
     };
 
     void merge(const logline_value_stats &other) {
@@ -567,6 +637,7 @@ struct logline_value_stats {
         }
         this->lvs_count += other.lvs_count;
         this->lvs_total += other.lvs_total;
+        this->lvs_sketch.merge(other.lvs_sketch);
 
         ensure(this->lvs_count >= 0);
         ensure(this->lvs_min_value <= this->lvs_max_value);
@@ -581,14 +652,49 @@ struct logline_value_stats {
         }
         this->lvs_count += 1;
         this->lvs_total += value;
+        this->lvs_sketch.add(value);
+    };
+
+    /**
+     * @param fraction The quantile to compute, between zero and one.
+     * @return The approximate value at the quantile.
+     */
+    double quantile(double fraction) const {
+        return this->lvs_sketch.quantile(fraction);
     };
 
     int64_t lvs_count;
     double lvs_total;
     double lvs_min_value;
     double lvs_max_value;
+    quantile_sketch lvs_sketch;
+};
+
+/**
+ * The lines in a file that have a particular operation ID, so the messages
+ * for an operation can be found without comparing the ID in every line.
+ */
+struct opid_descriptor {
+    /** The time of the first message with the ID. */
+    struct timeval od_begin{0, 0};
+    /** The time of the last message with the ID. */
+    struct timeval od_end{0, 0};
+    /** The line numbers of the messages with the ID, in ascending order. */
+    std::vector<uint32_t> od_lines;
+
+    void add_line(uint32_t line, const struct timeval &tv) {
+        if (this->od_lines.empty() || tv < this->od_begin) {
+            this->od_begin = tv;
+        }
+        if (this->od_lines.empty() || this->od_end < tv) {
+            this->od_end = tv;
+        }
+        this->od_lines.push_back(line);
+    };
 };
 
+using log_opid_map = std::unordered_map<std::string, opid_descriptor>;
+
 struct logline_value_cmp {
     logline_value_cmp(const intern_string_t *name = NULL, int col = -1)
         : lvc_name(name), lvc_column(col) {
@@ -675,6 +781,8 @@ public:
     {
         this->lf_pattern_locks.clear();
         this->lf_date_time.clear();
+        this->lf_opids.clear();
+        this->lf_opid_max_line = 0;
     };
 
     /**
@@ -702,7 +810,7 @@ public:
      * @param len The length of the prefix string.
      */
     virtual scan_result_t scan(logfile &lf,
-                               std::vector<logline> &dst,
+                               chunked_vector<logline> &dst,
                                const line_info &li,
                                shared_buffer_ref &sbr) = 0;
 
@@ -710,6 +818,18 @@ public:
         return false;
     };
 
+    /**
+     * Quickly check if a line could be matched by this format.  During
+     * format detection, this is used to skip the formats that cannot match
+     * the line before calling scan().
+     *
+     * @param sbr The contents of the line.
+     * @return False if scan() would definitely not match the line.
+     */
+    virtual bool scan_prefilter(const shared_buffer_ref &sbr) const {
+        return true;
+    };
+
     /**
      * Remove redundant data from the log line string.
      *
@@ -745,6 +865,28 @@ public:
     virtual void get_subline(const logline &ll, shared_buffer_ref &sbr, bool full_message = false) {
     };
 
+    /**
+     * @return True if get_subline() leaves the lines as they are in the file.
+     */
+    virtual bool subline_is_raw() const {
+        return true;
+    };
+
+    /** @return The memory used to cache the lines made by get_subline(). */
+    virtual size_t get_cache_memory() const {
+        return 0;
+    };
+
+    /**
+     * Drop the cached lines made by get_subline(), other than the current
+     * one.
+     *
+     * @return The number of bytes that were freed.
+     */
+    virtual size_t shed_caches() {
+        return 0;
+    };
+
     virtual const std::vector<std::string> *get_actions(const logline_value &lv) const {
         return NULL;
     };
@@ -769,7 +911,7 @@ public:
         return &this->lf_timestamp_format[0];
     };
 
-    void check_for_new_year(std::vector<logline> &dst, exttm log_tv,
+    void check_for_new_year(chunked_vector<logline> &dst, exttm log_tv,
                             timeval timeval1);
 
     virtual std::string get_pattern_name(uint64_t line_number) const {
@@ -800,6 +942,41 @@ public:
 
     int pattern_index_for_line(uint64_t line_number) const;
 
+    /**
+     * Record that a line has the given operation ID.
+     *
+     * @param opid The text of the operation ID.
+     * @param len The length of the ID.
+     * @param line The line number in the file, lines must be added in order.
+     * @param tv The time of the message.
+     */
+    void add_opid(const char *opid, size_t len,
+                  uint32_t line, const struct timeval &tv);
+
+    /**
+     * Forget the operation IDs of lines at or after the given line number.
+     */
+    void truncate_opids(size_t line_count);
+
+    /**
+     * Put the operation IDs found by the format for the lines before this
+     * file's lines in front of the IDs found by this format.
+     *
+     * @param prefix The IDs found for the earlier lines.
+     * @param prefix_size The number of earlier lines.
+     */
+    void prepend_opids(log_opid_map &prefix, size_t prefix_size);
+
+    /**
+     * Forget the state for the lines before the given line number and move
+     * the rest down, used when the oldest lines of a file are dropped.
+     */
+    void drop_lines_before(size_t line_count);
+
+    const log_opid_map &get_opids() const {
+        return this->lf_opids;
+    };
+
     uint8_t lf_mod_index;
     date_time_scanner lf_date_time;
     std::vector<pattern_for_lines> lf_pattern_locks;
@@ -808,6 +985,10 @@ public:
     int lf_timestamp_flags;
     std::map<std::string, action_def> lf_action_defs;
     std::vector<logline_value_stats> lf_value_stats;
+    /** The lines for each operation ID found while scanning. */
+    log_opid_map lf_opids;
+    /** One past the highest line number in lf_opids. */
+    uint32_t lf_opid_max_line{0};
     std::vector<highlighter> lf_highlighters;
     bool lf_is_self_describing;
     bool lf_time_ordered;
@@ -856,6 +1037,7 @@ public:
             vd_kind(logline_value::VALUE_UNKNOWN),
             vd_identifier(false),
             vd_foreign_key(false),
+            vd_indexed(false),
             vd_column(-1),
             vd_values_index(-1),
             vd_hidden(false),
@@ -869,6 +1051,7 @@ public:
         std::string vd_collate;
         bool vd_identifier;
         bool vd_foreign_key;
+        bool vd_indexed;
         intern_string_t vd_unit_field;
         std::map<const intern_string_t, scaling_factor> vd_unit_scaling;
         int vd_column;
@@ -921,6 +1104,9 @@ public:
         int p_body_field_index;
         int p_timestamp_end;
         bool p_module_format;
+        /** The bytes that a match can start with, if they are known. */
+        std::bitset<256> p_first_bytes;
+        bool p_first_bytes_valid{false};
     };
 
     struct level_pattern {
@@ -944,7 +1130,6 @@ public:
           elf_type(ELF_TYPE_TEXT),
           jlf_hide_extra(false),
           jlf_cached_offset(-1),
-          jlf_yajl_handle(yajl_free),
           elf_name(name) {
             this->jlf_line_offsets.reserve(128);
         };
@@ -961,14 +1146,58 @@ public:
     };
 
     scan_result_t scan(logfile &lf,
-                       std::vector<logline> &dst,
+                       chunked_vector<logline> &dst,
                        const line_info &offset,
                        shared_buffer_ref &sbr);
 
     bool scan_for_partial(shared_buffer_ref &sbr, size_t &len_out);
 
+    /**
+     * Pick the next pattern to try for a line.  The locked pattern is tried
+     * first, then the others in elf_scan_order, skipping the ones that
+     * cannot start with the first byte of the line.
+     *
+     * @param first_byte The first byte of the line.
+     * @param curr_fmt The pattern that was tried last, -1 to start.
+     * @param locked_index The locked pattern or -1 if there is none.
+     * @param order_pos The position in elf_scan_order, 0 to start.
+     * @return True if there is another pattern to try.
+     */
+    bool next_scan_pattern(unsigned char first_byte,
+                           int &curr_fmt,
+                           int &locked_index,
+                           size_t &order_pos) const;
+
+    bool scan_prefilter(const shared_buffer_ref &sbr) const {
+        if (!this->elf_first_bytes_valid) {
+            return true;
+        }
+        if (sbr.length() == 0) {
+            return false;
+        }
+
+        return this->elf_first_bytes.test((unsigned char) sbr.get_data()[0]);
+    };
+
     void annotate(uint64_t line_number, shared_buffer_ref &line, string_attrs_t &sa,
-                      std::vector<logline_value> &values, bool annotate_module = true) const;
+                      std::vector<logline_value> &values, bool annotate_module = true) const {
+        this->annotate_columns(line_number, line, sa, values, annotate_module,
+                               nullptr);
+    };
+
+    /**
+     * Annotate the line, but only extract the values whose column is set in
+     * the given vector.
+     *
+     * @param columns The value columns to extract, indexed by the column
+     *   number of the value, or nullptr to extract all of them.
+     */
+    void annotate_columns(uint64_t line_number,
+                          shared_buffer_ref &line,
+                          string_attrs_t &sa,
+                          std::vector<logline_value> &values,
+                          bool annotate_module,
+                          const std::vector<bool> *columns) const;
 
     void rewrite(exec_context &ec,
                  shared_buffer_ref &line,
@@ -983,47 +1212,86 @@ public:
     bool match_samples(const std::vector<sample> &samples) const;
 
     bool hide_field(const intern_string_t field_name, bool val) {
-        auto vd_iter = this->elf_value_defs.find(field_name);
+        auto vd_iter = this->elf_value_defs->find(field_name);
 
-        if (vd_iter == this->elf_value_defs.end()) {
+        if (vd_iter == this->elf_value_defs->end()) {
             return false;
         }
 
         vd_iter->second->vd_user_hidden = val;
+        // The value definitions are shared with the specialized formats, so
+        // their rendered lines are dropped the next time they are used.
+        elf_render_generation += 1;
         return true;
     };
 
+    size_t get_cache_memory() const override {
+        size_t retval = 0;
+
+        this->jlf_line_cache.for_each(
+            [&retval](off_t, const json_cached_line &jcl) {
+                retval += sizeof(jcl) +
+                          jcl.jcl_line.capacity() +
+                          jcl.jcl_line_offsets.capacity() * sizeof(off_t) +
+                          jcl.jcl_values.capacity() * sizeof(logline_value) +
+                          jcl.jcl_attrs.capacity() * sizeof(string_attr);
+            });
+
+        return retval;
+    };
+
+    size_t shed_caches() override {
+        size_t retval = this->get_cache_memory();
+
+        this->jlf_line_cache.clear();
+
+        return retval;
+    };
+
+    virtual void clear(void) {
+        log_format::clear();
+        this->lf_value_stats.clear();
+        this->lf_value_stats.resize(this->elf_numeric_value_defs->size());
+        this->jlf_line_cache.clear();
+        this->jlf_cached_offset = -1;
+    };
+
+    /**
+     * Create a copy of this format for a single file.  The copy gets its own
+     * parser state and this format is left untouched, so root formats can be
+     * specialized from more than one thread.  The definition is shared with
+     * this format, see shared_def.
+     */
     std::unique_ptr<log_format> specialized(int fmt_lock) {
         external_log_format *elf = new external_log_format(*this);
         std::unique_ptr<log_format> retval(elf);
 
         elf->lf_specialized = true;
-        this->lf_pattern_locks.clear();
         if (fmt_lock != -1) {
+            elf->lf_pattern_locks.clear();
             elf->lf_pattern_locks.emplace_back(0, fmt_lock);
         }
 
-        if (this->elf_type == ELF_TYPE_JSON) {
-            this->jlf_parse_context.reset(new yajlpp_parse_context(this->elf_name.to_string()));
-            this->jlf_yajl_handle.reset(yajl_alloc(
-                    &this->jlf_parse_context->ypc_callbacks,
+        if (this->has_json_values()) {
+            elf->jlf_parse_context = std::make_shared<yajlpp_parse_context>(
+                this->elf_name.to_string());
+            elf->jlf_yajl_handle.reset(yajl_alloc(
+                    &elf->jlf_parse_context->ypc_callbacks,
                     NULL,
-                    this->jlf_parse_context.get()));
-            yajl_config(this->jlf_yajl_handle.in(), yajl_dont_validate_strings, 1);
-            this->jlf_cached_line.reserve(16 * 1024);
+                    elf->jlf_parse_context.get()), yajl_free);
+            yajl_config(elf->jlf_yajl_handle.get(), yajl_dont_validate_strings, 1);
+            elf->jlf_cached_line.reserve(16 * 1024);
+            elf->jlf_line_cache.clear();
         }
 
-        this->lf_value_stats.clear();
-        this->lf_value_stats.resize(this->elf_numeric_value_defs.size());
-
         return retval;
     };
 
     const logline_value_stats *stats_for_value(const intern_string_t &name) const {
         const logline_value_stats *retval = NULL;
 
-        for (size_t lpc = 0; lpc < this->elf_numeric_value_defs.size(); lpc++) {
-            value_def &vd = *this->elf_numeric_value_defs[lpc];
+        for (size_t lpc = 0; lpc < this->elf_numeric_value_defs->size(); lpc++) {
+            value_def &vd = *(*this->elf_numeric_value_defs)[lpc];
 
             if (vd.vd_name == name) {
                 retval = &this->lf_value_stats[lpc];
@@ -1036,13 +1304,17 @@ public:
 
     void get_subline(const logline &ll, shared_buffer_ref &sbr, bool full_message);
 
+    bool subline_is_raw() const {
+        return this->elf_type == ELF_TYPE_TEXT;
+    };
+
     log_vtab_impl *get_vtab_impl(void) const;
 
     const std::vector<std::string> *get_actions(const logline_value &lv) const {
         const std::vector<std::string> *retval = NULL;
 
-        const auto iter = this->elf_value_defs.find(lv.lv_name);
-        if (iter != this->elf_value_defs.end()) {
+        const auto iter = this->elf_value_defs->find(lv.lv_name);
+        if (iter != this->elf_value_defs->end()) {
             retval = &iter->second->vd_action_list;
         }
 
@@ -1050,7 +1322,7 @@ public:
     };
 
     const std::set<std::string> get_source_path() const {
-        return this->elf_source_path;
+        return *this->elf_source_path;
     };
 
     enum json_log_field {
@@ -1093,6 +1365,8 @@ public:
         overflow_t jfe_overflow;
         transform_t jfe_text_transform;
         std::string jfe_ts_format;
+        /** The compiled jfe_ts_format, filled in by build(). */
+        ftime_program jfe_ts_program;
     };
 
     struct json_field_cmp {
@@ -1121,25 +1395,47 @@ public:
         bool hd_blink;
     };
 
+    /**
+     * @param ist The name of the value.
+     * @return The definition of the value or nullptr if there is none.
+     */
+    value_def *find_value_def(const intern_string_t ist) const {
+        if (this->elf_value_def_index->size() != this->elf_value_defs->size()) {
+            const auto iter = this->elf_value_defs->find(ist);
+
+            if (iter == this->elf_value_defs->end()) {
+                return nullptr;
+            }
+            return iter->second.get();
+        }
+
+        const auto iter = this->elf_value_def_index->find(ist.unwrap());
+
+        if (iter == this->elf_value_def_index->end()) {
+            return nullptr;
+        }
+        return iter->second;
+    };
+
     long value_line_count(const intern_string_t ist,
                           bool top_level,
                           const unsigned char *str = NULL,
                           ssize_t len = -1) const {
-        const auto iter = this->elf_value_defs.find(ist);
+        const auto vd = this->find_value_def(ist);
         long line_count = (str != NULL) ? std::count(&str[0], &str[len], '\n') + 1 : 1;
 
-        if (iter == this->elf_value_defs.end()) {
+        if (vd == nullptr) {
             return (this->jlf_hide_extra || !top_level) ? 0 : line_count;
         }
 
-        if (iter->second->vd_hidden) {
+        if (vd->vd_hidden) {
             return 0;
         }
 
-        if (std::find_if(this->jlf_line_format.begin(),
-                         this->jlf_line_format.end(),
+        if (std::find_if(this->jlf_line_format->begin(),
+                         this->jlf_line_format->end(),
                          json_field_cmp(JLF_VARIABLE, ist)) !=
-            this->jlf_line_format.end()) {
+            this->jlf_line_format->end()) {
             return line_count - 1;
         }
 
@@ -1147,9 +1443,7 @@ public:
     };
 
     bool has_value_def(const intern_string_t ist) const {
-        const auto iter = this->elf_value_defs.find(ist);
-
-        return iter != this->elf_value_defs.end();
+        return this->find_value_def(ist) != nullptr;
     };
 
     std::string get_pattern_name(uint64_t line_number) const {
@@ -1173,14 +1467,20 @@ public:
 
         if (level_cap != nullptr && level_cap->is_valid()) {
             pcre_context_static<128> pc_level;
+            size_t level_len = level_cap->length();
+
+            if (LEVEL_SCAN_LIMIT > 0) {
+                level_len = std::min(level_len, LEVEL_SCAN_LIMIT);
+            }
+
             pcre_input pi_level(pi.get_substr_start(level_cap),
                                 0,
-                                level_cap->length());
+                                level_len);
 
-            if (this->elf_level_patterns.empty()) {
-                retval = string2level(pi_level.get_string(), level_cap->length());
+            if (this->elf_level_patterns->empty()) {
+                retval = string2level(pi_level.get_string(), level_len);
             } else {
-                for (const auto &elf_level_pattern : this->elf_level_patterns) {
+                for (const auto &elf_level_pattern : *this->elf_level_patterns) {
                     if (elf_level_pattern.second.lp_pcre->match(pc_level, pi_level)) {
                         retval = elf_level_pattern.first;
                         break;
@@ -1192,42 +1492,102 @@ public:
         return retval;
     }
 
+    /**
+     * The number of bytes at the start of a level field to look for a level
+     * in, from "/tuning/index/level-scan-limit", or zero for no limit.
+     */
+    static size_t LEVEL_SCAN_LIMIT;
+
     typedef std::map<intern_string_t, module_format> mod_map_t;
     static mod_map_t MODULE_FORMATS;
     static std::vector<external_log_format *> GRAPH_ORDERED_FORMATS;
 
-    std::set<std::string> elf_source_path;
+    /**
+     * The parts of the definition that are filled in by the loader and
+     * build() are held through shared pointers, so the copies made by
+     * specialized() for each file share them with the root format instead
+     * of copying them.  They must not be changed once the root format has
+     * been specialized.
+     */
+    template<typename T>
+    using shared_def = std::shared_ptr<T>;
+
+    template<typename T>
+    static shared_def<T> make_def() {
+        return std::make_shared<T>();
+    };
+
+    shared_def<std::set<std::string>> elf_source_path{
+        make_def<std::set<std::string>>()};
     std::list<intern_string_t> elf_collision;
     std::string elf_file_pattern;
     pcrepp *elf_filename_pcre;
-    std::map<std::string, std::shared_ptr<pattern>> elf_patterns;
+    shared_def<std::map<std::string, std::shared_ptr<pattern>>> elf_patterns{
+        make_def<std::map<std::string, std::shared_ptr<pattern>>>()};
     std::vector<std::shared_ptr<pattern>> elf_pattern_order;
-    std::vector<sample> elf_samples;
-    std::map<const intern_string_t, std::shared_ptr<value_def>> elf_value_defs;
-    std::vector<std::shared_ptr<value_def>> elf_numeric_value_defs;
+    /**
+     * The indexes into elf_pattern_order in the order they are tried when
+     * the locked pattern does not match.  The pattern that matched is moved
+     * to the front, so files that mix a few patterns find them quickly.
+     */
+    std::vector<int> elf_scan_order;
+    std::bitset<256> elf_first_bytes; /*< Bytes that the patterns can start with. */
+    bool elf_first_bytes_valid{false};
+    shared_def<std::vector<sample>> elf_samples{
+        make_def<std::vector<sample>>()};
+    shared_def<std::map<const intern_string_t, std::shared_ptr<value_def>>>
+        elf_value_defs{
+        make_def<std::map<const intern_string_t, std::shared_ptr<value_def>>>()};
+    /**
+     * The value definitions keyed by the address of the interned name, so
+     * the fields in a JSON message can be looked up without comparing
+     * strings.  This is filled in by build().
+     */
+    shared_def<std::unordered_map<const intern_string *, value_def *>>
+        elf_value_def_index{
+        make_def<std::unordered_map<const intern_string *, value_def *>>()};
+    shared_def<std::vector<std::shared_ptr<value_def>>> elf_numeric_value_defs{
+        make_def<std::vector<std::shared_ptr<value_def>>>()};
     int elf_column_count;
     double elf_timestamp_divisor;
     intern_string_t elf_level_field;
     intern_string_t elf_body_field;
     intern_string_t elf_module_id_field;
     intern_string_t elf_opid_field;
-    std::map<log_level_t, level_pattern> elf_level_patterns;
-    std::vector<std::pair<int64_t, log_level_t> > elf_level_pairs;
+    shared_def<std::map<log_level_t, level_pattern>> elf_level_patterns{
+        make_def<std::map<log_level_t, level_pattern>>()};
+    shared_def<std::vector<std::pair<int64_t, log_level_t>>> elf_level_pairs{
+        make_def<std::vector<std::pair<int64_t, log_level_t>>>()};
     bool elf_multiline;
     bool elf_container;
     bool elf_has_module_format;
     bool elf_builtin_format;
-    std::vector<std::pair<intern_string_t, std::string> > elf_search_tables;
-    std::map<const intern_string_t, highlighter_def> elf_highlighter_patterns;
+    shared_def<std::vector<std::pair<intern_string_t, std::string>>>
+        elf_search_tables{
+        make_def<std::vector<std::pair<intern_string_t, std::string>>>()};
+    shared_def<std::map<const intern_string_t, highlighter_def>>
+        elf_highlighter_patterns{
+        make_def<std::map<const intern_string_t, highlighter_def>>()};
 
     enum elf_type_t {
         ELF_TYPE_TEXT,
         ELF_TYPE_JSON,
         ELF_TYPE_CSV,
+        /**
+         * Length-prefixed MessagePack records, which are handled like JSON
+         * lines without any text parsing.
+         */
+        ELF_TYPE_MSGPACK,
     };
 
     elf_type_t elf_type;
 
+    /** @return True if the lines are decoded with the JSON handlers. */
+    bool has_json_values() const {
+        return this->elf_type == ELF_TYPE_JSON ||
+               this->elf_type == ELF_TYPE_MSGPACK;
+    };
+
     void json_append_to_cache(const char *value, ssize_t len) {
         size_t old_size = this->jlf_cached_line.size();
         if (len == -1) {
@@ -1261,7 +1621,8 @@ public:
     };
 
     bool jlf_hide_extra;
-    std::vector<json_format_element> jlf_line_format;
+    shared_def<std::vector<json_format_element>> jlf_line_format{
+        make_def<std::vector<json_format_element>>()};
     int jlf_line_format_init_count{0};
     std::vector<logline_value> jlf_line_values;
 
@@ -1271,8 +1632,35 @@ public:
     shared_buffer jlf_share_manager;
     std::vector<char> jlf_cached_line;
     string_attrs_t jlf_line_attrs;
+
+    /**
+     * A JSON line that was rewritten by get_subline() and set aside when
+     * another line was rewritten.
+     */
+    struct json_cached_line {
+        std::vector<char> jcl_line;
+        std::vector<off_t> jcl_line_offsets;
+        std::vector<logline_value> jcl_values;
+        string_attrs_t jcl_attrs;
+    };
+
+    static const size_t JSON_LINE_CACHE_SIZE = 256;
+
+    /**
+     * Bumped when a change to the value definitions affects how lines are
+     * rewritten.
+     */
+    static uint64_t elf_render_generation;
+
+    /**
+     * The recently rewritten lines other than the current one, keyed by
+     * the offset of the line shifted left once and or'd with the
+     * full_message flag.
+     */
+    lru_cache<off_t, json_cached_line> jlf_line_cache{JSON_LINE_CACHE_SIZE};
+    uint64_t jlf_cache_generation{0};
     std::shared_ptr<yajlpp_parse_context> jlf_parse_context;
-    auto_mem<yajl_handle_t> jlf_yajl_handle;
+    std::shared_ptr<yajl_handle_t> jlf_yajl_handle;
 private:
     const intern_string_t elf_name;
 
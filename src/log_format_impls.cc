@@ -138,7 +138,7 @@ class generic_log_format : public log_format {
     };
 
     scan_result_t scan(logfile &lf,
-                       vector<logline> &dst,
+                       chunked_vector<logline> &dst,
                        const line_info &li,
                        shared_buffer_ref &sbr)
     {
@@ -398,7 +398,7 @@ public:
         this->blf_field_defs.clear();
     };
 
-    scan_result_t scan_int(std::vector<logline> &dst,
+    scan_result_t scan_int(chunked_vector<logline> &dst,
                            const line_info &li,
                            shared_buffer_ref &sbr) {
         static const intern_string_t STATUS_CODE = intern_string::lookup("bro_status_code");
@@ -472,7 +472,7 @@ public:
     }
 
     scan_result_t scan(logfile &lf,
-                       std::vector<logline> &dst,
+                       chunked_vector<logline> &dst,
                        const line_info &li,
                        shared_buffer_ref &sbr) {
         static pcrepp SEP_RE(R"(^#separator\s+(.+))");
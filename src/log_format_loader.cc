@@ -38,7 +38,9 @@
 #include <sys/stat.h>
 
 #include <map>
+#include <atomic>
 #include <string>
+#include <thread>
 #include <fstream>
 
 #include "fmt/format.h"
@@ -81,7 +83,7 @@ static external_log_format *ensure_format(const yajlpp_provider_context &ypc, us
         LOG_FORMATS[name] = retval = new external_log_format(name);
         log_debug("Loading format -- %s", name.get());
     }
-    retval->elf_source_path.insert(ud->ud_format_path.substr(0, ud->ud_format_path.rfind('/')));
+    retval->elf_source_path->insert(ud->ud_format_path.substr(0, ud->ud_format_path.rfind('/')));
 
     if (find(formats->begin(), formats->end(), name) == formats->end()) {
         formats->push_back(name);
@@ -97,7 +99,7 @@ static external_log_format *ensure_format(const yajlpp_provider_context &ypc, us
 static external_log_format::pattern *pattern_provider(const yajlpp_provider_context &ypc, external_log_format *elf)
 {
     string regex_name = ypc.get_substr(0);
-    auto &pat = elf->elf_patterns[regex_name];
+    auto &pat = (*elf->elf_patterns)[regex_name];
 
     if (pat.get() == nullptr) {
         pat = make_shared<external_log_format::pattern>();
@@ -114,7 +116,7 @@ static external_log_format::value_def *value_def_provider(const yajlpp_provider_
 {
     const intern_string_t value_name = ypc.get_substr_i(0);
 
-    auto &retval = elf->elf_value_defs[value_name];
+    auto &retval = (*elf->elf_value_defs)[value_name];
 
     if (retval.get() == nullptr) {
         retval = make_shared<external_log_format::value_def>();
@@ -145,9 +147,9 @@ static scaling_factor *scaling_factor_provider(const yajlpp_provider_context &yp
 static external_log_format::json_format_element &
 ensure_json_format_element(external_log_format *elf, int index)
 {
-    elf->jlf_line_format.resize(index + 1);
+    elf->jlf_line_format->resize(index + 1);
 
-    return elf->jlf_line_format[index];
+    return (*elf->jlf_line_format)[index];
 }
 
 static external_log_format::json_format_element *line_format_provider(
@@ -250,7 +252,7 @@ static int read_levels(yajlpp_parse_context *ypc, const unsigned char *str, size
     string regex = string((const char *)str, len);
     string level_name_or_number = ypc->get_path_fragment(2);
     log_level_t level = string2level(level_name_or_number.c_str());
-    elf->elf_level_patterns[level].lp_regex = regex;
+    (*elf->elf_level_patterns)[level].lp_regex = regex;
 
     return 1;
 }
@@ -261,7 +263,7 @@ static int read_level_int(yajlpp_parse_context *ypc, long long val)
     string level_name_or_number = ypc->get_path_fragment(2);
     log_level_t level = string2level(level_name_or_number.c_str());
 
-    elf->elf_level_pairs.push_back(make_pair(val, level));
+    elf->elf_level_pairs->push_back(make_pair(val, level));
 
     return 1;
 }
@@ -307,9 +309,9 @@ static int read_action_cmd(yajlpp_parse_context *ypc, const unsigned char *str,
 static external_log_format::sample &ensure_sample(external_log_format *elf,
                                                   int index)
 {
-    elf->elf_samples.resize(index + 1);
+    elf->elf_samples->resize(index + 1);
 
-    return elf->elf_samples[index];
+    return (*elf->elf_samples)[index];
 }
 
 static external_log_format::sample *sample_provider(const yajlpp_provider_context &ypc, external_log_format *elf)
@@ -341,7 +343,7 @@ static int create_search_table(yajlpp_parse_context *ypc, const unsigned char *s
     const intern_string_t table_name = ypc->get_path_fragment_i(2);
     string regex = string((const char *) str, len);
 
-    elf->elf_search_tables.push_back(make_pair(table_name, regex));
+    elf->elf_search_tables->push_back(make_pair(table_name, regex));
 
     return 1;
 }
@@ -491,6 +493,11 @@ static struct json_path_handler value_def_handlers[] = {
         .with_description("Indicates whether or not this field should be treated as a foreign key for row in another table")
         .FOR_FIELD(external_log_format::value_def, vd_foreign_key),
 
+    json_path_handler("indexed")
+        .with_synopsis("<bool>")
+        .with_description("Indicates whether or not an index of the values in this field should be kept to speed up SQL queries that look for a single value")
+        .FOR_FIELD(external_log_format::value_def, vd_indexed),
+
     json_path_handler("hidden")
         .with_synopsis("<bool>")
         .with_description("Indicates whether or not this field should be hidden")
@@ -579,6 +586,7 @@ static const json_path_handler_base::enum_value_t TYPE_ENUM[] = {
     { "text", external_log_format::elf_type_t::ELF_TYPE_TEXT },
     { "json", external_log_format::elf_type_t::ELF_TYPE_JSON },
     { "csv", external_log_format::elf_type_t::ELF_TYPE_CSV },
+    { "msgpack", external_log_format::elf_type_t::ELF_TYPE_MSGPACK },
 
     json_path_handler_base::ENUM_TERMINATOR
 };
@@ -634,7 +642,7 @@ struct json_path_handler format_handlers[] = {
     json_path_handler("highlights/(?<highlight_name>[^/]+)/")
         .with_description("Highlight definitions")
         .with_obj_provider<external_log_format::highlighter_def, external_log_format>([](const yajlpp_provider_context &ypc, external_log_format *root) {
-            return &(root->elf_highlighter_patterns[ypc.get_substr_i(0)]);
+            return &((*root->elf_highlighter_patterns)[ypc.get_substr_i(0)]);
         })
         .with_children(highlighter_def_handlers),
 
@@ -812,6 +820,58 @@ static void load_from_path(const filesystem::path &path, std::vector<string> &er
     }
 }
 
+/**
+ * The results of building a single format, these are kept separate so the
+ * formats can be built in parallel and then handled in order.
+ */
+struct format_build_result {
+    std::vector<std::string> fbr_errors;
+    std::list<intern_string_t> fbr_collisions;
+};
+
+/**
+ * Build the formats and check their samples against each other.  Compiling
+ * the patterns and matching all of the samples against all of the formats
+ * is most of the work of loading the formats, so it is spread out over a
+ * few threads.
+ */
+static void build_formats(const vector<external_log_format *> &formats,
+                          vector<format_build_result> &results)
+{
+    std::atomic<size_t> next_format{0};
+    auto work = [&]() {
+        for (size_t index = next_format++;
+             index < formats.size();
+             index = next_format++) {
+            auto elf = formats[index];
+            auto &result = results[index];
+
+            elf->build(result.fbr_errors);
+            for (auto check_elf : formats) {
+                if (check_elf == elf) {
+                    continue;
+                }
+
+                if (elf->match_samples(*check_elf->elf_samples)) {
+                    result.fbr_collisions.push_back(check_elf->get_name());
+                }
+            }
+        }
+    };
+    size_t worker_count = std::min(
+        formats.size(), (size_t) std::thread::hardware_concurrency());
+    vector<std::thread> workers;
+
+    results.resize(formats.size());
+    for (size_t lpc = 1; lpc < worker_count; lpc++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
 void load_formats(const std::vector<filesystem::path> &extra_paths,
                   std::vector<std::string> &errors)
 {
@@ -851,32 +911,33 @@ void load_formats(const std::vector<filesystem::path> &extra_paths,
 
     uint8_t mod_counter = 0;
 
+    vector<external_log_format *> formats;
+    vector<format_build_result> results;
+
+    for (const auto &pair : LOG_FORMATS) {
+        formats.push_back(pair.second);
+    }
+    build_formats(formats, results);
+
     vector<external_log_format *> alpha_ordered_formats;
-    for (map<intern_string_t, external_log_format *>::iterator iter = LOG_FORMATS.begin();
-         iter != LOG_FORMATS.end();
-         ++iter) {
-        external_log_format *elf = iter->second;
-        elf->build(errors);
+    for (size_t lpc = 0; lpc < formats.size(); lpc++) {
+        external_log_format *elf = formats[lpc];
+        auto &result = results[lpc];
+
+        errors.insert(errors.end(),
+                      result.fbr_errors.begin(),
+                      result.fbr_errors.end());
 
         if (elf->elf_has_module_format) {
             mod_counter += 1;
             elf->lf_mod_index = mod_counter;
         }
 
-        for (map<intern_string_t, external_log_format *>::iterator check_iter = LOG_FORMATS.begin();
-             check_iter != LOG_FORMATS.end();
-             ++check_iter) {
-            if (iter->first == check_iter->first) {
-                continue;
-            }
-
-            external_log_format *check_elf = check_iter->second;
-            if (elf->match_samples(check_elf->elf_samples)) {
-                log_warning("Format collision, format '%s' matches sample from '%s'",
-                        elf->get_name().get(),
-                        check_elf->get_name().get());
-                elf->elf_collision.push_back(check_elf->get_name());
-            }
+        for (const auto &check_name : result.fbr_collisions) {
+            log_warning("Format collision, format '%s' matches sample from '%s'",
+                    elf->get_name().get(),
+                    check_name.get());
+            elf->elf_collision.push_back(check_name);
         }
 
         if (errors.empty()) {
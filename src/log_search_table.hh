@@ -33,6 +33,7 @@
 #define _log_search_table_hh
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "logfile.hh"
@@ -47,7 +48,8 @@ public:
     log_search_table(const char *regex, intern_string_t table_name)
         : log_vtab_impl(table_name),
           lst_regex_string(regex),
-          lst_regex(regex, PCRE_CASELESS),
+          lst_regex(pcrepp::cached(regex, PCRE_CASELESS)),
+          lst_required_literal(pcrepp::required_literal(regex)),
           lst_instance(-1) {
         this->vi_supports_indexes = false;
         this->get_columns_int(this->lst_cols);
@@ -58,14 +60,14 @@ public:
         column_namer cn;
 
         cols.push_back(vtab_column("log_msg_instance", SQLITE_INTEGER, NULL));
-        for (int lpc = 0; lpc < this->lst_regex.get_capture_count(); lpc++) {
+        for (int lpc = 0; lpc < this->lst_regex->get_capture_count(); lpc++) {
             std::vector<pcre_context::capture>::const_iterator iter;
             const char *collator = NULL;
             std::string cap_re, colname;
             int sqlite_type = SQLITE3_TEXT;
 
-            if (this->lst_regex.captures().size() == (size_t) this->lst_regex.get_capture_count()) {
-                iter = this->lst_regex.cap_begin() + lpc;
+            if (this->lst_regex->captures().size() == (size_t) this->lst_regex->get_capture_count()) {
+                iter = this->lst_regex->cap_begin() + lpc;
                 cap_re = this->lst_regex_string.substr(iter->c_begin,
                                                        iter->length());
                 sqlite_type = guess_type_from_pcre(cap_re, &collator);
@@ -84,7 +86,7 @@ public:
                         break;
                 }
             }
-            colname = cn.add_column(this->lst_regex.name_for_capture(lpc));
+            colname = cn.add_column(this->lst_regex->name_for_capture(lpc));
             cols.push_back(vtab_column(colname, sqlite_type, collator));
         }
     };
@@ -103,36 +105,83 @@ public:
     {
         if (lc.lc_curr_line == vis_line_t(-1)) {
             this->lst_instance = -1;
+            if (this->lst_index_generation != lss.get_index_generation()) {
+                this->lst_file_matches.clear();
+                this->lst_index_generation = lss.get_index_generation();
+            }
         }
 
         lc.lc_curr_line = lc.lc_curr_line + vis_line_t(1);
         lc.lc_sub_index = 0;
 
-        if (lc.lc_curr_line == (int)lss.text_line_count()) {
+        if (lc.is_eof()) {
             return true;
         }
 
         content_line_t cl;
 
-        cl = lss.at(lc.lc_curr_line);
-        std::shared_ptr<logfile> lf = lss.find(cl);
+        cl = lc.line_at(lc.lc_curr_line);
+        logfile *lf = lss.find_file_ptr(cl);
         auto lf_iter = lf->begin() + cl;
 
         if (lf_iter->is_continued()) {
             return false;
         }
 
-        string_attrs_t             sa;
-        std::vector<logline_value> line_values;
+        auto &fm = this->lst_file_matches[lf];
+        size_t line_number = cl;
+
+        if (line_number >= fm.fm_checked.size()) {
+            fm.fm_checked.resize(lf->size());
+            fm.fm_matched.resize(lf->size());
+        }
+        if (fm.fm_checked[line_number]) {
+            if (!fm.fm_matched[line_number]) {
+                return false;
+            }
+
+            const auto &caps = fm.fm_captures[line_number];
+
+            std::copy(caps.begin(), caps.end(), this->lst_match_context.all());
+            this->lst_match_context.set_count(caps.size());
+            this->lst_instance += 1;
+            return true;
+        }
+
+        // The last message in the file can still have lines appended to
+        // it, so its result is not kept.
+        auto next_iter = std::find_if(lf_iter + 1, lf->end(),
+                                      [](const logline &ll) {
+                                          return !ll.is_continued();
+                                      });
+        bool complete = next_iter != lf->end();
+        bool matched;
+
+        if (!this->lst_required_literal.empty() &&
+            !lf->message_may_contain(lf_iter, this->lst_required_literal)) {
+            matched = false;
+        } else {
+            lf->read_full_message(lf_iter, this->lst_current_line);
+
+            pcre_input pi(this->lst_current_line.get_data(),
+                          0,
+                          this->lst_current_line.length());
+
+            matched = this->lst_regex->match(this->lst_match_context, pi);
+        }
+
+        if (complete) {
+            fm.fm_checked[line_number] = true;
+            if (matched) {
+                auto *all = this->lst_match_context.all();
 
-        lf->read_full_message(lf_iter, this->lst_current_line);
-        lf->get_format()->annotate(cl, this->lst_current_line, sa, line_values,
-                                   false);
-        pcre_input pi(this->lst_current_line.get_data(),
-                      0,
-                      this->lst_current_line.length());
+                fm.fm_matched[line_number] = true;
+                fm.fm_captures[line_number].assign(
+                    all, all + this->lst_match_context.get_count());
+            }
+        }
 
-        if (!this->lst_regex.match(this->lst_match_context, pi)) {
+        if (!matched) {
             return false;
         }
 
@@ -149,14 +198,11 @@ public:
         static intern_string_t instance_name = intern_string::lookup("log_msg_instance");
         static intern_string_t empty = intern_string::lookup("", 0);
 
-        pcre_input pi(this->lst_current_line.get_data(),
-                      0,
-                      this->lst_current_line.length());
         int next_column = 0;
 
         values.emplace_back(instance_name, this->lst_instance);
         values.back().lv_column = next_column++;
-        for (int lpc = 0; lpc < this->lst_regex.get_capture_count(); lpc++) {
+        for (int lpc = 0; lpc < this->lst_regex->get_capture_count(); lpc++) {
             pcre_context::capture_t *cap = this->lst_match_context[lpc];
             shared_buffer_ref value_sbr;
 
@@ -167,12 +213,30 @@ public:
     };
 
     std::string lst_regex_string;
-    pcrepp lst_regex;
+    std::shared_ptr<pcrepp> lst_regex;
+    std::string lst_required_literal;
     shared_buffer_ref lst_current_line;
     pcre_context_static<128> lst_match_context;
     std::vector<logline_value::kind_t> lst_column_types;
     int64_t lst_instance;
     std::vector<vtab_column> lst_cols;
+
+    /**
+     * The results of matching the regex against the messages in a file,
+     * so that another query only needs to match the new messages.
+     */
+    struct file_matches {
+        /** The messages that have been matched, by their first line. */
+        std::vector<bool> fm_checked;
+        std::vector<bool> fm_matched;
+        /** The captures for the messages that matched. */
+        std::unordered_map<size_t, std::vector<pcre_context::capture_t>>
+            fm_captures;
+    };
+
+    std::unordered_map<const logfile *, file_matches> lst_file_matches;
+    /** The index generation of the view when the matches were kept. */
+    size_t lst_index_generation{0};
 };
 
 #endif
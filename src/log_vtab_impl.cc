@@ -31,11 +31,13 @@
 
 #include "base/lnav_log.hh"
 #include "sql_util.hh"
+#include "strnatcmp.h"
 #include "log_vtab_impl.hh"
 #include "yajlpp/yajlpp_def.hh"
 #include "vtab_module.hh"
 
 #include "logfile_sub_source.hh"
+#include "task_pool.hh"
 
 using namespace std;
 
@@ -61,7 +63,8 @@ static const char *LOG_FOOTER_COLUMNS = R"(
   -- END Format-specific fields
   log_path        TEXT HIDDEN COLLATE naturalnocase, -- The path to the log file this message is from
   log_text        TEXT HIDDEN,                       -- The full text of the log message
-  log_body        TEXT HIDDEN                        -- The body of the log message
+  log_body        TEXT HIDDEN,                       -- The body of the log message
+  log_time_us     INTEGER HIDDEN                     -- The adjusted timestamp in microseconds since the epoch
 );
 )";
 
@@ -165,13 +168,359 @@ struct vtab {
     textview_curses *tc;
     logfile_sub_source *lss;
     log_vtab_impl *     vi;
+    /** Incremented when an UPDATE changes the bookmark metadata. */
+    uint64_t meta_generation;
+};
+
+/**
+ * Extracts the values for the messages ahead of a cursor on several threads.
+ * The messages are read into a window by the thread running the query and
+ * then split between the workers, which annotate them in place.  The values
+ * reference the window, so they are only valid until the next fill().
+ */
+class value_prefetcher {
+public:
+    /** Scans shorter than this are not worth starting the threads for. */
+    static const int MIN_LINES = 16 * 1024;
+    static const size_t WINDOW_LINES = 4 * 1024;
+    static const size_t WINDOW_BYTES = 8 * 1024 * 1024;
+    static const size_t MAX_WORKERS = 8;
+
+    struct entry {
+        vis_line_t e_line;
+        std::shared_ptr<logfile> e_file;
+        uint64_t e_line_number;
+        size_t e_offset;
+        size_t e_length;
+        shared_buffer_ref e_msg;
+        string_attrs_t e_attrs;
+        std::vector<logline_value> e_values;
+    };
+
+    static size_t worker_count() {
+        return std::min(task_pool::singleton().get_worker_count(),
+                        MAX_WORKERS);
+    };
+
+    value_prefetcher(log_vtab_impl *vi) : vp_vi(vi) {
+        this->vp_buffers.resize(worker_count());
+    };
+
+    ~value_prefetcher() {
+        this->clear();
+    };
+
+    void clear() {
+        this->vp_entries.clear();
+        this->vp_next = 0;
+        for (auto &sb : this->vp_buffers) {
+            sb.invalidate_refs();
+        }
+        this->vp_chunk.clear();
+    };
+
+    /**
+     * @return The entry for the given line, if it is in the window.  The
+     *   lines are expected to be requested in order.
+     */
+    entry *find(vis_line_t vl) {
+        while (this->vp_next < this->vp_entries.size() &&
+               this->vp_entries[this->vp_next].e_line < vl) {
+            this->vp_next += 1;
+        }
+        if (this->vp_next < this->vp_entries.size() &&
+            this->vp_entries[this->vp_next].e_line == vl) {
+            return &this->vp_entries[this->vp_next];
+        }
+
+        return nullptr;
+    };
+
+    /**
+     * Read the messages starting at the given line into the window and
+     * extract their values.
+     *
+     * @param index The order of the lines for the scan.
+     * @param accept Called with each line to check if it is a row that the
+     *   cursor could return.
+     */
+    template<typename F>
+    void fill(logfile_sub_source &lss,
+              const logfile_sub_source::snapshot_t &index,
+              vis_line_t start,
+              vis_line_t end,
+              const std::vector<bool> *columns,
+              F accept) {
+        this->clear();
+        for (vis_line_t vl = start;
+             vl < end &&
+             this->vp_entries.size() < WINDOW_LINES &&
+             this->vp_chunk.size() < WINDOW_BYTES;
+             ++vl) {
+            content_line_t cl(index[vl]);
+            uint64_t line_number;
+            auto ld = lss.find_data(cl, line_number);
+            auto *lf = ld->get_file_ptr();
+            auto ll = lf->begin() + line_number;
+
+            if (ll->is_continued() ||
+                !this->vp_vi->can_extract_concurrently(*lf) ||
+                !accept(vl)) {
+                continue;
+            }
+
+            shared_buffer_ref msg;
+
+            lf->read_full_message(ll, msg);
+            this->vp_entries.emplace_back();
+
+            auto &e = this->vp_entries.back();
+
+            e.e_line = vl;
+            e.e_file = ld->get_file();
+            e.e_line_number = line_number;
+            e.e_offset = this->vp_chunk.size();
+            e.e_length = msg.length();
+            this->vp_chunk.append(msg.get_data(), msg.length());
+        }
+
+        if (this->vp_entries.empty()) {
+            return;
+        }
+
+        size_t per_worker = (this->vp_entries.size() +
+                             this->vp_buffers.size() - 1) /
+                            this->vp_buffers.size();
+        size_t chunks = (this->vp_entries.size() + per_worker - 1) /
+                        per_worker;
+
+        task_pool::singleton().parallel_for(chunks, [&](size_t index) {
+            size_t first = index * per_worker;
+
+            this->extract_range(this->vp_buffers[index],
+                                first,
+                                std::min(first + per_worker,
+                                         this->vp_entries.size()),
+                                columns);
+        }, task_pool::priority_t::INTERACTIVE);
+    };
+
+private:
+    void extract_range(shared_buffer &sb,
+                       size_t first,
+                       size_t last,
+                       const std::vector<bool> *columns) {
+        for (size_t lpc = first; lpc < last; lpc++) {
+            auto &e = this->vp_entries[lpc];
+
+            e.e_msg.share(sb, &this->vp_chunk[e.e_offset], e.e_length);
+            this->vp_vi->extract_concurrent(*e.e_file,
+                                            e.e_line_number,
+                                            e.e_msg,
+                                            columns,
+                                            e.e_attrs,
+                                            e.e_values);
+        }
+    };
+
+    log_vtab_impl *vp_vi;
+    std::vector<shared_buffer> vp_buffers;
+    std::string vp_chunk;
+    std::vector<entry> vp_entries;
+    size_t vp_next{0};
 };
 
 struct vtab_cursor {
+    void clear_constraints() {
+        this->level_constraint = nonstd::nullopt;
+        this->file_constraint.clear();
+        this->has_file_constraint = false;
+        this->row_list.clear();
+        this->has_row_list = false;
+    };
+
+    /**
+     * @return True if the current line can satisfy the equality constraints
+     *   that were passed to xFilter.
+     */
+    bool matches_constraints(logfile_sub_source &lss) const {
+        return this->matches_constraints(lss, this->log_cursor.lc_curr_line);
+    };
+
+    bool matches_constraints(logfile_sub_source &lss, vis_line_t vl) const {
+        if (!this->level_constraint && !this->has_file_constraint) {
+            return true;
+        }
+
+        content_line_t cl(this->log_cursor.line_at(vl));
+        uint64_t line_number;
+        auto ld = lss.find_data(cl, line_number);
+
+        if (this->has_file_constraint &&
+            (ld->ld_file_index >= this->file_constraint.size() ||
+             !this->file_constraint[ld->ld_file_index])) {
+            return false;
+        }
+        if (this->level_constraint) {
+            auto lf = ld->get_file_ptr();
+
+            // Check the summary of the block first so the lines in blocks
+            // without the level do not need to be touched.
+            if (!lf->block_has_levels(
+                    line_number,
+                    logfile::level_mask(this->level_constraint.value()))) {
+                return false;
+            }
+
+            auto ll = lf->begin() + line_number;
+
+            if (ll->get_msg_level() != this->level_constraint.value()) {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    /**
+     * Read the current message and extract the values of the columns used
+     * by the query.
+     */
+    void extract_values(log_vtab_impl *vi,
+                        logfile_sub_source &lss,
+                        const std::shared_ptr<logfile> &lf,
+                        logfile::iterator ll,
+                        uint64_t line_number) {
+        if (this->prefetcher) {
+            vis_line_t vl = this->log_cursor.lc_curr_line;
+            auto e = this->prefetcher->find(vl);
+
+            if (e == nullptr) {
+                this->line_values.clear();
+                this->log_msg.disown();
+                this->prefetcher->fill(
+                    lss, *this->index, vl, this->log_cursor.lc_end_line,
+                    this->has_columns_used ? &this->columns_used : nullptr,
+                    [this, &lss](vis_line_t row) {
+                        return this->matches_constraints(lss, row);
+                    });
+                e = this->prefetcher->find(vl);
+            }
+            if (e != nullptr) {
+                this->log_msg = e->e_msg;
+                this->line_values = e->e_values;
+                vi->vi_attrs = e->e_attrs;
+                this->index_values(vi);
+                return;
+            }
+        }
+
+        lf->read_full_message(ll, this->log_msg);
+        vi->vi_columns_used = this->has_columns_used ?
+            &this->columns_used : nullptr;
+        vi->extract(lf, line_number, this->log_msg, this->line_values);
+        vi->vi_columns_used = nullptr;
+        this->index_values(vi);
+    };
+
+    /**
+     * Record the position in line_values of the first value for each
+     * column, so the columns of wide tables do not each have to search
+     * through all of the values.
+     */
+    void index_values(log_vtab_impl *vi) {
+        this->value_index.assign(vi->vi_column_count, -1);
+        for (size_t lpc = 0; lpc < this->line_values.size(); lpc++) {
+            int col = this->line_values[lpc].lv_column;
+
+            if (col >= 0 && col < (int) this->value_index.size() &&
+                this->value_index[col] == -1) {
+                this->value_index[col] = lpc;
+            }
+        }
+    };
+
+    /** @return The value for a column of the current row or nullptr. */
+    logline_value *find_value(size_t col) {
+        if (col >= this->value_index.size() || this->value_index[col] == -1) {
+            return nullptr;
+        }
+
+        return &this->line_values[this->value_index[col]];
+    };
+
+    /**
+     * Look up the file and line for the current row, if the cursor has
+     * moved since the last call.  The shared_ptr for the file is only
+     * copied when the cursor moves into a different file.
+     */
+    void update_row(logfile_sub_source &lss) {
+        if (this->row_line == this->log_cursor.lc_curr_line) {
+            return;
+        }
+
+        content_line_t cl(
+            this->log_cursor.line_at(this->log_cursor.lc_curr_line));
+        auto ld = lss.find_data(cl, this->row_line_number);
+
+        if (this->row_file.get() != ld->get_file_ptr()) {
+            this->row_file = ld->get_file();
+        }
+        this->row_data = ld;
+        this->row_iter = this->row_file->begin() + this->row_line_number;
+        this->row_line = this->log_cursor.lc_curr_line;
+    };
+
+    /**
+     * Start a new scan of the lines that are currently visible.  The scan
+     * holds on to a snapshot of the index, so lines that are merged into
+     * the index while the statement is open do not shift the rows that are
+     * returned.
+     */
+    void start_scan(logfile_sub_source &lss) {
+        this->index = lss.get_index_snapshot();
+        this->log_cursor.lc_index = this->index.get();
+        this->log_cursor.lc_curr_line = vis_line_t(-1);
+        this->log_cursor.lc_end_line = vis_line_t(this->index->size());
+        this->log_cursor.lc_sub_index = 0;
+    };
+
     sqlite3_vtab_cursor        base;
     struct log_cursor          log_cursor;
+    /** The order of the lines for the current scan. */
+    std::shared_ptr<const logfile_sub_source::snapshot_t> index;
+    /** The row that row_data, row_file, and row_iter are for. */
+    vis_line_t                 row_line{-1};
+    logfile_sub_source::logfile_data *row_data{nullptr};
+    std::shared_ptr<logfile>   row_file;
+    uint64_t                   row_line_number{0};
+    logfile::iterator          row_iter;
     shared_buffer_ref          log_msg;
     std::vector<logline_value> line_values;
+    /** The position in line_values of the value for each column or -1. */
+    std::vector<int>           value_index;
+    /** The value columns read by the query, if has_columns_used. */
+    std::vector<bool>          columns_used;
+    bool                       has_columns_used{false};
+    /** Extracts the values ahead of the cursor for long scans. */
+    std::unique_ptr<value_prefetcher> prefetcher;
+    /** Only lines with this level can match, if set. */
+    nonstd::optional<log_level_t> level_constraint;
+    /** The indexes of the files that can match, if has_file_constraint. */
+    std::vector<bool>          file_constraint;
+    bool                       has_file_constraint{false};
+    /** The only lines that can match, in order, if has_row_list. */
+    std::vector<vis_line_t>    row_list;
+    bool                       has_row_list{false};
+    /**
+     * The partition that covers the lines in [part_start, part_end), so
+     * that a scan only has to look up the partition when it crosses into
+     * the next one.
+     */
+    vis_line_t                 part_start{-1};
+    vis_line_t                 part_end{-1};
+    uint64_t                   part_generation{0};
+    nonstd::optional<std::string> part_name;
 };
 
 static int vt_destructor(sqlite3_vtab *p_svt);
@@ -195,6 +544,7 @@ static int vt_create(sqlite3 *db,
 
     memset(&p_vt->base, 0, sizeof(sqlite3_vtab));
     p_vt->db = db;
+    p_vt->meta_generation = 0;
 
     /* Declare the vtable's structure */
     p_vt->vi = vm->lookup_impl(intern_string::lookup(argv[3]));
@@ -253,9 +603,7 @@ static int vt_open(sqlite3_vtab *p_svt, sqlite3_vtab_cursor **pp_cursor)
     *pp_cursor = (sqlite3_vtab_cursor *)p_cur;
 
     p_cur->base.pVtab = p_svt;
-    p_cur->log_cursor.lc_curr_line = vis_line_t(-1);
-    p_cur->log_cursor.lc_end_line = vis_line_t(p_vt->lss->text_line_count());
-    p_cur->log_cursor.lc_sub_index = 0;
+    p_cur->start_scan(*p_vt->lss);
     vt_next((sqlite3_vtab_cursor *)p_cur);
 
     return SQLITE_OK;
@@ -292,7 +640,24 @@ static int vt_next(sqlite3_vtab_cursor *cur)
              log_vtab_data.lvd_progress(log_cursor_latest))) {
             break;
         }
+        if (vc->has_row_list) {
+            // Jump to the line before the next one from the index.
+            auto iter = upper_bound(vc->row_list.begin(),
+                                    vc->row_list.end(),
+                                    vc->log_cursor.lc_curr_line);
+
+            if (iter == vc->row_list.end() ||
+                *iter >= vc->log_cursor.lc_end_line) {
+                vc->log_cursor.lc_curr_line = vc->log_cursor.lc_end_line;
+                break;
+            }
+            vc->log_cursor.lc_curr_line = *iter - vis_line_t(1);
+        }
         done = vt->vi->next(vc->log_cursor, *vt->lss);
+        if (done && !vc->log_cursor.is_eof() &&
+            !vc->matches_constraints(*vt->lss)) {
+            done = false;
+        }
     } while (!done);
 
     return SQLITE_OK;
@@ -303,11 +668,12 @@ static int vt_column(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int col)
     vtab_cursor *vc = (vtab_cursor *)cur;
     vtab *       vt = (vtab *)cur->pVtab;
 
-    content_line_t    cl(vt->lss->at(vc->log_cursor.lc_curr_line));
-    uint64_t line_number;
-    auto ld = vt->lss->find_data(cl, line_number);
-    shared_ptr<logfile> lf = ld->get_file();
-    auto ll = lf->begin() + line_number;
+    vc->update_row(*vt->lss);
+
+    const shared_ptr<logfile> &lf = vc->row_file;
+    auto *ld = vc->row_data;
+    uint64_t line_number = vc->row_line_number;
+    auto ll = vc->row_iter;
 
     require(col >= 0);
 
@@ -323,34 +689,47 @@ static int vt_column(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int col)
     {
         vis_bookmarks &vb = vt->tc->get_bookmarks();
         bookmark_vector<vis_line_t> &bv = vb[&textview_curses::BM_META];
+        vis_line_t curr_line(vc->log_cursor.lc_curr_line);
 
         if (bv.empty()) {
             sqlite3_result_null(ctx);
+            break;
         }
-        else {
-            vis_line_t curr_line(vc->log_cursor.lc_curr_line);
+
+        if (vc->part_generation != vt->meta_generation ||
+            curr_line < vc->part_start || curr_line >= vc->part_end) {
             auto iter = lower_bound(bv.begin(), bv.end(), curr_line + 1_vl);
 
+            vc->part_generation = vt->meta_generation;
+            vc->part_end = iter == bv.end() ?
+                vc->log_cursor.lc_end_line : *iter;
+            vc->part_name = nonstd::nullopt;
             if (iter != bv.begin()) {
                 --iter;
-                content_line_t part_line = vt->lss->at(*iter);
+                vc->part_start = *iter;
+
+                content_line_t part_line = vc->log_cursor.line_at(*iter);
                 std::map<content_line_t, bookmark_metadata> &bm_meta = vt->lss->get_user_bookmark_metadata();
                 std::map<content_line_t, bookmark_metadata>::iterator meta_iter;
 
                 meta_iter = bm_meta.find(part_line);
                 if (meta_iter != bm_meta.end() &&
                     !meta_iter->second.bm_name.empty()) {
-                    sqlite3_result_text(ctx,
-                                        meta_iter->second.bm_name.c_str(),
-                                        meta_iter->second.bm_name.size(),
-                                        SQLITE_TRANSIENT);
-                } else {
-                    sqlite3_result_null(ctx);
+                    vc->part_name = meta_iter->second.bm_name;
                 }
             } else {
-                sqlite3_result_null(ctx);
+                vc->part_start = 0_vl;
             }
         }
+
+        if (vc->part_name) {
+            sqlite3_result_text(ctx,
+                                vc->part_name->c_str(),
+                                vc->part_name->size(),
+                                SQLITE_TRANSIENT);
+        } else {
+            sqlite3_result_null(ctx);
+        }
     }
     break;
 
@@ -368,8 +747,7 @@ static int vt_column(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int col)
 
             if (ll->is_time_skewed()) {
                 if (vc->line_values.empty()) {
-                    lf->read_full_message(ll, vc->log_msg);
-                    vt->vi->extract(lf, line_number, vc->log_msg, vc->line_values);
+                    vc->extract_values(vt->vi, *vt->lss, lf, ll, line_number);
                 }
 
                 struct line_range time_range;
@@ -401,10 +779,9 @@ static int vt_column(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int col)
             sqlite3_result_int64(ctx, 0);
         }
         else {
-            content_line_t prev_cl(vt->lss->at(vis_line_t(
-                                                   vc->log_cursor.lc_curr_line -
-                                                   1)));
-            shared_ptr<logfile>         prev_lf = vt->lss->find(prev_cl);
+            content_line_t prev_cl(vc->log_cursor.line_at(vis_line_t(
+                vc->log_cursor.lc_curr_line - 1)));
+            logfile *prev_lf = vt->lss->find_file_ptr(prev_cl);
             logfile::iterator prev_ll = prev_lf->begin() + prev_cl;
             uint64_t          prev_time, curr_line_time;
 
@@ -437,7 +814,8 @@ static int vt_column(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int col)
         case VT_COL_LOG_COMMENT: {
             const map<content_line_t, bookmark_metadata> &bm = vt->lss->get_user_bookmark_metadata();
 
-            auto bm_iter = bm.find(vt->lss->at(vc->log_cursor.lc_curr_line));
+            auto bm_iter = bm.find(
+                vc->log_cursor.line_at(vc->log_cursor.lc_curr_line));
             if (bm_iter == bm.end() || bm_iter->second.bm_comment.empty()) {
                 sqlite3_result_null(ctx);
             } else {
@@ -453,7 +831,8 @@ static int vt_column(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int col)
         case VT_COL_LOG_TAGS: {
             const map<content_line_t, bookmark_metadata> &bm = vt->lss->get_user_bookmark_metadata();
 
-            auto bm_iter = bm.find(vt->lss->at(vc->log_cursor.lc_curr_line));
+            auto bm_iter = bm.find(
+                vc->log_cursor.line_at(vc->log_cursor.lc_curr_line));
             if (bm_iter == bm.end() || bm_iter->second.bm_tags.empty()) {
                 sqlite3_result_null(ctx);
             } else {
@@ -497,10 +876,8 @@ static int vt_column(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int col)
                         continue;
                     }
 
-                    uint32_t mask = (1UL << filter->get_index());
-
-                    if (filter_state.lfo_filter_state.tfs_mask[line_number] &
-                        mask) {
+                    if (filter_state.lfo_filter_state.test_mask(
+                            line_number, filter->get_index())) {
                         arr.gen(filter->get_index());
                     }
                 }
@@ -539,8 +916,7 @@ static int vt_column(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int col)
                 }
                 case 2: {
                     if (vc->line_values.empty()) {
-                        lf->read_full_message(ll, vc->log_msg);
-                        vt->vi->extract(lf, line_number, vc->log_msg, vc->line_values);
+                        vc->extract_values(vt->vi, *vt->lss, lf, ll, line_number);
                     }
 
                     struct line_range body_range;
@@ -560,21 +936,22 @@ static int vt_column(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int col)
                     }
                     break;
                 }
+                case 3: {
+                    sqlite3_result_int64(ctx,
+                                         ll->get_time_in_millis() * 1000LL);
+                    break;
+                }
             }
         }
         else {
             if (vc->line_values.empty()) {
-                lf->read_full_message(ll, vc->log_msg);
-                vt->vi->extract(lf, line_number, vc->log_msg, vc->line_values);
+                vc->extract_values(vt->vi, *vt->lss, lf, ll, line_number);
             }
 
             size_t sub_col = col - VT_COL_MAX;
-            std::vector<logline_value>::iterator lv_iter;
-
-            lv_iter = find_if(vc->line_values.begin(), vc->line_values.end(),
-                              logline_value_cmp(NULL, sub_col));
+            logline_value *lv_iter = vc->find_value(sub_col);
 
-            if (lv_iter != vc->line_values.end()) {
+            if (lv_iter != nullptr) {
                 switch (lv_iter->lv_kind) {
                 case logline_value::VALUE_NULL:
                     sqlite3_result_null(ctx);
@@ -689,21 +1066,175 @@ void log_cursor::update(unsigned char op, vis_line_t vl, bool exact)
     }
 }
 
+void log_cursor::update_time(unsigned char op,
+                             struct timeval tv,
+                             logfile_sub_source &lss)
+{
+    // The log_time column only has millisecond precision, so the bounds are
+    // rounded outward to the millisecond and sqlite checks the constraint
+    // on the rows that are returned.
+    bool whole_millis = (tv.tv_usec % 1000) == 0;
+
+    tv.tv_usec -= tv.tv_usec % 1000;
+
+    struct timeval next_tv = tv;
+
+    next_tv.tv_usec += 1000;
+    if (next_tv.tv_usec >= 1000000) {
+        next_tv.tv_sec += 1;
+        next_tv.tv_usec -= 1000000;
+    }
+
+    auto line_count = vis_line_t(lss.text_line_count());
+    auto first_at_or_after = [&lss, line_count](const struct timeval &bound) {
+        vis_line_t vl = lss.find_from_time(bound);
+
+        return vl == -1 ? line_count : vl;
+    };
+
+    switch (op) {
+    case SQLITE_INDEX_CONSTRAINT_EQ:
+        this->lc_curr_line = std::max(this->lc_curr_line,
+                                      first_at_or_after(tv));
+        this->lc_end_line = std::min(this->lc_end_line,
+                                     first_at_or_after(next_tv));
+        break;
+    case SQLITE_INDEX_CONSTRAINT_GE:
+    case SQLITE_INDEX_CONSTRAINT_GT:
+        this->lc_curr_line = std::max(this->lc_curr_line,
+                                      first_at_or_after(tv));
+        break;
+    case SQLITE_INDEX_CONSTRAINT_LE:
+        this->lc_end_line = std::min(this->lc_end_line,
+                                     first_at_or_after(next_tv));
+        break;
+    case SQLITE_INDEX_CONSTRAINT_LT:
+        this->lc_end_line = std::min(this->lc_end_line,
+                                     first_at_or_after(
+                                         whole_millis ? tv : next_tv));
+        break;
+    }
+}
+
+/**
+ * The plan passed from xBestIndex to xFilter through idxStr.  The header is
+ * followed by the constraints whose values are passed as arguments.
+ */
+struct vtab_index_plan {
+    /** The colUsed mask for the table, the last bit covers the rest. */
+    sqlite3_uint64 vip_columns_used;
+
+    sqlite3_index_info::sqlite3_index_constraint *constraints() {
+        return (sqlite3_index_info::sqlite3_index_constraint *) (this + 1);
+    };
+};
+
+static bool column_used(sqlite3_uint64 mask, int col)
+{
+    return (mask & (((sqlite3_uint64) 1) << std::min(col, 63))) != 0;
+}
+
+/**
+ * Start extracting values on worker threads if the cursor is going to scan
+ * enough lines to make it worthwhile.  The values are still handed to
+ * SQLite one row at a time, but the parsing of the messages, which is the
+ * bulk of the work for a GROUP BY over a format's fields, is spread out.
+ */
+/** @return The index of the hidden log_time_us column. */
+static int time_us_column(const vtab *vt)
+{
+    return VT_COL_MAX + vt->vi->vi_column_count + 3;
+}
+
+static void start_prefetch(vtab_cursor *p_cur, vtab *vt)
+{
+    bool any_values = !p_cur->has_columns_used ||
+        std::find(p_cur->columns_used.begin(),
+                  p_cur->columns_used.end(),
+                  true) != p_cur->columns_used.end();
+
+    if (p_cur->has_row_list ||
+        !any_values ||
+        value_prefetcher::worker_count() < 2 ||
+        (p_cur->log_cursor.lc_end_line - p_cur->log_cursor.lc_curr_line) <
+        value_prefetcher::MIN_LINES) {
+        p_cur->prefetcher.reset();
+        return;
+    }
+
+    if (p_cur->prefetcher) {
+        p_cur->prefetcher->clear();
+    } else {
+        p_cur->prefetcher = std::make_unique<value_prefetcher>(vt->vi);
+    }
+}
+
+/**
+ * Use the level counts of the files to leave out the files that do not have
+ * any messages with the level in the constraint, like the statistics for a
+ * row group.  If none of the files have the level, there is nothing to scan.
+ */
+static void exclude_files_without_level(vtab_cursor *p_cur, vtab *vt)
+{
+    auto level = p_cur->level_constraint.value();
+    std::vector<bool> files(vt->lss->end() - vt->lss->begin());
+    bool found = false;
+
+    for (auto ld : *vt->lss) {
+        auto lf = ld->get_file_ptr();
+
+        if (lf == nullptr ||
+            (p_cur->has_file_constraint &&
+             (ld->ld_file_index >= p_cur->file_constraint.size() ||
+              !p_cur->file_constraint[ld->ld_file_index]))) {
+            continue;
+        }
+
+        // The counts only cover the lines that have been summarized.
+        if (lf->size() > 0 && lf->get_level_block(lf->size() - 1) != nullptr &&
+            lf->get_level_count(level) == 0) {
+            continue;
+        }
+
+        files[ld->ld_file_index] = true;
+        found = true;
+    }
+
+    if (!found) {
+        p_cur->log_cursor.lc_curr_line = p_cur->log_cursor.lc_end_line;
+    }
+    p_cur->file_constraint = std::move(files);
+    p_cur->has_file_constraint = true;
+}
+
 static int vt_filter(sqlite3_vtab_cursor *p_vtc,
                      int idxNum, const char *idxStr,
                      int argc, sqlite3_value **argv)
 {
     vtab_cursor *p_cur = (vtab_cursor *)p_vtc;
     vtab *       vt = (vtab *)p_vtc->pVtab;
-    sqlite3_index_info::sqlite3_index_constraint *index = (
-        sqlite3_index_info::sqlite3_index_constraint *)idxStr;
+    vtab_index_plan *plan = (vtab_index_plan *) idxStr;
+    sqlite3_index_info::sqlite3_index_constraint *index = nullptr;
 
     log_info("(%p) filter called: %d", vt, idxNum);
-    p_cur->log_cursor.lc_curr_line = vis_line_t(-1);
-    p_cur->log_cursor.lc_end_line = vis_line_t(vt->lss->text_line_count());
+    p_cur->clear_constraints();
+    p_cur->row_line = vis_line_t(-1);
+    p_cur->columns_used.clear();
+    p_cur->has_columns_used = false;
+    if (plan != nullptr) {
+        index = plan->constraints();
+        p_cur->columns_used.resize(vt->vi->vi_column_count);
+        for (int lpc = 0; lpc < vt->vi->vi_column_count; lpc++) {
+            p_cur->columns_used[lpc] = column_used(plan->vip_columns_used,
+                                                   VT_COL_MAX + lpc);
+        }
+        p_cur->has_columns_used = true;
+    }
+    p_cur->start_scan(*vt->lss);
     vt_next(p_vtc);
 
     if (!idxNum) {
+        start_prefetch(p_cur, vt);
         return SQLITE_OK;
     }
 
@@ -716,32 +1247,139 @@ static int vt_filter(sqlite3_vtab_cursor *p_vtc,
 
         case VT_COL_LOG_TIME:
             if (sqlite3_value_type(argv[lpc]) == SQLITE3_TEXT) {
-                const unsigned char *datestr = sqlite3_value_text(argv[lpc]);
+                const char *datestr =
+                    (const char *) sqlite3_value_text(argv[lpc]);
                 date_time_scanner dts;
                 struct timeval tv;
                 struct exttm mytm;
-                vis_line_t vl;
 
-                dts.scan((const char *)datestr, strlen((const char *)datestr), NULL, &mytm, tv);
-                if ((vl = vt->lss->find_from_time(tv)) == -1) {
-                    p_cur->log_cursor.lc_curr_line = p_cur->log_cursor.lc_end_line;
+                if (dts.scan(datestr, strlen(datestr), nullptr,
+                             &mytm, tv) == nullptr) {
+                    break;
                 }
-                else {
-                    p_cur->log_cursor.update(index[lpc].op, vl, false);
+
+                p_cur->log_cursor.update_time(index[lpc].op, tv, *vt->lss);
+            }
+            break;
+
+        case VT_COL_LEVEL:
+            if (sqlite3_value_type(argv[lpc]) == SQLITE3_TEXT) {
+                const char *levelstr =
+                    (const char *) sqlite3_value_text(argv[lpc]);
+                log_level_t level = abbrev2level(levelstr, strlen(levelstr));
+
+                if (p_cur->level_constraint &&
+                    p_cur->level_constraint.value() != level) {
+                    p_cur->log_cursor.lc_curr_line =
+                        p_cur->log_cursor.lc_end_line;
                 }
+                p_cur->level_constraint = level;
             }
             break;
 
+        default:
+            if (vt->vi->has_index(index[lpc].iColumn)) {
+                std::vector<vis_line_t> lines;
+
+                if (!vt->vi->index_lookup(index[lpc].iColumn, argv[lpc],
+                                          *vt->lss, lines)) {
+                    break;
+                }
+                if (p_cur->has_row_list) {
+                    std::vector<vis_line_t> both;
+
+                    set_intersection(p_cur->row_list.begin(),
+                                     p_cur->row_list.end(),
+                                     lines.begin(), lines.end(),
+                                     back_inserter(both));
+                    lines = std::move(both);
+                }
+                p_cur->row_list = std::move(lines);
+                p_cur->has_row_list = true;
+            }
+            else if (index[lpc].iColumn == time_us_column(vt)) {
+                if (sqlite3_value_type(argv[lpc]) == SQLITE_INTEGER) {
+                    int64_t us = sqlite3_value_int64(argv[lpc]);
+                    struct timeval tv;
+
+                    tv.tv_sec = us / 1000000LL;
+                    tv.tv_usec = us % 1000000LL;
+                    if (tv.tv_usec < 0) {
+                        tv.tv_sec -= 1;
+                        tv.tv_usec += 1000000;
+                    }
+                    p_cur->log_cursor.update_time(index[lpc].op, tv, *vt->lss);
+                }
+            }
+            else if (index[lpc].iColumn == VT_COL_MAX + vt->vi->vi_column_count &&
+                sqlite3_value_type(argv[lpc]) == SQLITE3_TEXT) {
+                const char *path =
+                    (const char *) sqlite3_value_text(argv[lpc]);
+                std::vector<bool> files(vt->lss->end() - vt->lss->begin());
+                size_t path_len = strlen(path);
+
+                for (auto ld : *vt->lss) {
+                    auto lf = ld->get_file();
+
+                    if (lf == nullptr) {
+                        continue;
+                    }
+
+                    const auto &fn = lf->get_filename();
+
+                    // Follow the naturalnocase collation of the column.
+                    if (strnatcasecmp(path_len, path,
+                                      fn.length(), fn.c_str()) == 0 &&
+                        (!p_cur->has_file_constraint ||
+                         (ld->ld_file_index < p_cur->file_constraint.size() &&
+                          p_cur->file_constraint[ld->ld_file_index]))) {
+                        files[ld->ld_file_index] = true;
+                    }
+                }
+                p_cur->file_constraint = std::move(files);
+                p_cur->has_file_constraint = true;
+            }
+            break;
         }
     }
 
-    while (!p_cur->log_cursor.is_eof() && !vt->vi->is_valid(p_cur->log_cursor, *vt->lss)) {
-        p_cur->log_cursor.lc_curr_line += vis_line_t(1);
+    if (p_cur->level_constraint) {
+        exclude_files_without_level(p_cur, vt);
     }
 
+    if (p_cur->has_row_list) {
+        if (!p_cur->log_cursor.is_eof()) {
+            p_cur->log_cursor.lc_curr_line -= vis_line_t(1);
+            vt_next(p_vtc);
+        }
+    } else {
+        while (!p_cur->log_cursor.is_eof() &&
+               (!vt->vi->is_valid(p_cur->log_cursor, *vt->lss) ||
+                !p_cur->matches_constraints(*vt->lss))) {
+            p_cur->log_cursor.lc_curr_line += vis_line_t(1);
+        }
+    }
+
+    start_prefetch(p_cur, vt);
+
     return SQLITE_OK;
 }
 
+/**
+ * @return True if the constraint compares values with the BINARY collation,
+ *   which is what the format indexes are keyed by.
+ */
+static bool uses_binary_collation(sqlite3_index_info *p_info, int lpc)
+{
+#if SQLITE_VERSION_NUMBER >= 3022000
+    const char *coll = sqlite3_vtab_collation(p_info, lpc);
+
+    return coll == nullptr || strcasecmp(coll, "BINARY") == 0;
+#else
+    return false;
+#endif
+}
+
 static int vt_best_index(sqlite3_vtab *tab, sqlite3_index_info *p_info)
 {
     std::vector<sqlite3_index_info::sqlite3_index_constraint> indexes;
@@ -767,15 +1405,34 @@ static int vt_best_index(sqlite3_vtab *tab, sqlite3_index_info *p_info)
         }
     }
 
-    if (!argvInUse) {
-        for (int lpc = 0; lpc < p_info->nConstraint; lpc++) {
-            if (!p_info->aConstraint[lpc].usable ||
-                p_info->aConstraint[lpc].op == SQLITE_INDEX_CONSTRAINT_MATCH) {
-                continue;
-            }
+    // The time constraints are applied after the line number constraints
+    // and can only narrow the range of lines that is scanned.  Equality
+    // constraints on the level and path let the scan skip lines without
+    // extracting them, an IN is turned into one xFilter call per value.
+    for (int lpc = 0; lpc < p_info->nConstraint; lpc++) {
+        if (!p_info->aConstraint[lpc].usable) {
+            continue;
+        }
+
+        int col = p_info->aConstraint[lpc].iColumn;
 
-            switch (p_info->aConstraint[lpc].iColumn) {
-            case VT_COL_LOG_TIME:
+        if ((col == VT_COL_LEVEL ||
+             col == VT_COL_MAX + vt->vi->vi_column_count ||
+             (vt->vi->has_index(col) && uses_binary_collation(p_info, lpc))) &&
+            p_info->aConstraint[lpc].op == SQLITE_INDEX_CONSTRAINT_EQ) {
+            argvInUse += 1;
+            indexes.push_back(p_info->aConstraint[lpc]);
+            p_info->aConstraintUsage[lpc].argvIndex = argvInUse;
+            continue;
+        }
+
+        if (col == VT_COL_LOG_TIME || col == time_us_column(vt)) {
+            switch (p_info->aConstraint[lpc].op) {
+            case SQLITE_INDEX_CONSTRAINT_EQ:
+            case SQLITE_INDEX_CONSTRAINT_GT:
+            case SQLITE_INDEX_CONSTRAINT_GE:
+            case SQLITE_INDEX_CONSTRAINT_LT:
+            case SQLITE_INDEX_CONSTRAINT_LE:
                 argvInUse += 1;
                 indexes.push_back(p_info->aConstraint[lpc]);
                 p_info->aConstraintUsage[lpc].argvIndex = argvInUse;
@@ -784,24 +1441,32 @@ static int vt_best_index(sqlite3_vtab *tab, sqlite3_index_info *p_info)
         }
     }
 
-    if (argvInUse) {
-        sqlite3_index_info::sqlite3_index_constraint *index_copy;
-        size_t len = indexes.size() * sizeof(*index_copy);
+    vtab_index_plan *plan;
+    size_t len = indexes.size() * sizeof(indexes[0]);
 
+    if (argvInUse) {
         log_info("found index, passing %d args", argvInUse);
-
-        index_copy = (sqlite3_index_info::sqlite3_index_constraint *)
-            sqlite3_malloc(len);
-        if (!index_copy) {
-            return SQLITE_NOMEM;
-        }
-        memcpy(index_copy, &indexes[0], len);
-        p_info->idxNum = argvInUse;
-        p_info->idxStr = (char *) index_copy;
-        p_info->needToFreeIdxStr = 1;
         p_info->estimatedCost = 10.0;
     }
 
+    // Pass along the columns that are read by the query so that extract()
+    // can skip building the values that are not needed.
+    plan = (vtab_index_plan *) sqlite3_malloc(sizeof(*plan) + len);
+    if (!plan) {
+        return SQLITE_NOMEM;
+    }
+#if SQLITE_VERSION_NUMBER >= 3010000
+    plan->vip_columns_used = p_info->colUsed;
+#else
+    plan->vip_columns_used = ~((sqlite3_uint64) 0);
+#endif
+    if (len > 0) {
+        memcpy(plan->constraints(), &indexes[0], len);
+    }
+    p_info->idxNum = argvInUse;
+    p_info->idxStr = (char *) plan;
+    p_info->needToFreeIdxStr = 1;
+
     return SQLITE_OK;
 }
 
@@ -862,6 +1527,7 @@ static int vt_update(sqlite3_vtab *tab,
 
         bookmark_vector<vis_line_t> &bv = vt->tc->get_bookmarks()[
                 &textview_curses::BM_META];
+        vt->meta_generation += 1;
         bool has_meta = part_name != nullptr || log_comment != nullptr ||
             log_tags != nullptr;
 
@@ -984,6 +1650,10 @@ string log_vtab_manager::register_vtab(log_vtab_impl *vi)
         if (rc != SQLITE_OK) {
             retval = errmsg;
         }
+        sql_forget_table_metadata(vi->get_name().to_string());
+        if (!this->vm_in_batch) {
+            sql_stmt_cache::schema_changed();
+        }
     }
     else {
         retval = "a table with the given name already exists";
@@ -992,6 +1662,23 @@ string log_vtab_manager::register_vtab(log_vtab_impl *vi)
     return retval;
 }
 
+void log_vtab_manager::begin_batch()
+{
+    require(!this->vm_in_batch);
+
+    this->vm_in_batch = true;
+    sqlite3_exec(this->vm_db, "BEGIN TRANSACTION", nullptr, nullptr, nullptr);
+}
+
+void log_vtab_manager::end_batch()
+{
+    require(this->vm_in_batch);
+
+    this->vm_in_batch = false;
+    sqlite3_exec(this->vm_db, "COMMIT", nullptr, nullptr, nullptr);
+    sql_stmt_cache::schema_changed();
+}
+
 string log_vtab_manager::unregister_vtab(intern_string_t name)
 {
     string retval = "";
@@ -1012,6 +1699,8 @@ string log_vtab_manager::unregister_vtab(intern_string_t name)
                            NULL);
 
         this->vm_impls.erase(name);
+        sql_forget_table_metadata(name.to_string());
+        sql_stmt_cache::schema_changed();
     }
 
     return retval;
@@ -59,9 +59,28 @@ struct log_cursor {
     vis_line_t lc_curr_line;
     int        lc_sub_index;
     vis_line_t lc_end_line;
+    /**
+     * The order of the lines when the scan started.  The snapshot is owned
+     * by the vtab cursor, this is only a pointer so that copying the cursor
+     * for the progress callback stays cheap.
+     */
+    const logfile_sub_source::snapshot_t *lc_index{nullptr};
+
+    /** @return The content line for a row of the scan. */
+    content_line_t line_at(vis_line_t vl) const {
+        return (*this->lc_index)[vl];
+    };
 
     void update(unsigned char op, vis_line_t vl, bool exact = true);
 
+    /**
+     * Narrow the range of lines to those that could satisfy a constraint on
+     * the log_time column.
+     */
+    void update_time(unsigned char op,
+                     struct timeval tv,
+                     logfile_sub_source &lss);
+
     void set_eof() {
         this->lc_curr_line = this->lc_end_line = vis_line_t(0);
     };
@@ -99,7 +118,7 @@ public:
     static std::pair<int, unsigned int> logline_value_to_sqlite_type(logline_value::kind_t kind);
 
     log_vtab_impl(const intern_string_t name) : vi_supports_indexes(true), vi_name(name) {
-        this->vi_attrs.resize(128);
+        this->vi_attrs.reserve(128);
     };
     virtual ~log_vtab_impl() { };
 
@@ -111,8 +130,8 @@ public:
     std::string get_table_statement(void);
 
     virtual bool is_valid(log_cursor &lc, logfile_sub_source &lss) {
-        content_line_t    cl(lss.at(lc.lc_curr_line));
-        std::shared_ptr<logfile> lf = lss.find(cl);
+        content_line_t    cl(lc.line_at(lc.lc_curr_line));
+        logfile *lf = lss.find_file_ptr(cl);
         auto lf_iter = lf->begin() + cl;
 
         if (lf_iter->is_continued()) {
@@ -124,6 +143,29 @@ public:
 
     virtual bool next(log_cursor &lc, logfile_sub_source &lss) = 0;
 
+    /**
+     * @param col The column number in the table.
+     * @return True if index_lookup() can be used to find the lines with a
+     *   given value in the column.
+     */
+    virtual bool has_index(int col) const { return false; };
+
+    /**
+     * Find the lines where a column has the given value.
+     *
+     * @param col The column number in the table.
+     * @param value The value to look for.
+     * @param lss The source of the lines.
+     * @param lines_out The visible lines with the value, in order.
+     * @return False if the index cannot be used for this value.
+     */
+    virtual bool index_lookup(int col,
+                              sqlite3_value *value,
+                              logfile_sub_source &lss,
+                              std::vector<vis_line_t> &lines_out) {
+        return false;
+    };
+
     virtual void get_columns(std::vector<vtab_column> &cols) const { };
 
     virtual void get_foreign_keys(std::vector<std::string> &keys_inout) const
@@ -141,12 +183,45 @@ public:
         log_format *format = lf->get_format();
 
         this->vi_attrs.clear();
-        format->annotate(line_number, line, this->vi_attrs, values, false);
+        if (!lf->find_annotations(line_number, line, this->vi_attrs, values)) {
+            format->annotate(line_number, line, this->vi_attrs, values, false);
+        }
+    };
+
+    /**
+     * @return True if extract_concurrent() can be used for the lines in the
+     *   given file.
+     */
+    virtual bool can_extract_concurrently(const logfile &lf) const {
+        return false;
+    };
+
+    /**
+     * Extract the values for a message from a worker thread.  Unlike
+     * extract(), the attributes are returned through the given vector and
+     * the state of this object is not touched.  The line must be backed by
+     * a shared_buffer that is only used by the calling thread.
+     *
+     * @param columns The value columns to extract, or nullptr for all.
+     */
+    virtual void extract_concurrent(const logfile &lf,
+                                    uint64_t line_number,
+                                    shared_buffer_ref &line,
+                                    const std::vector<bool> *columns,
+                                    string_attrs_t &sa,
+                                    std::vector<logline_value> &values) const {
     };
 
     bool vi_supports_indexes;
     int vi_column_count;
     string_attrs_t vi_attrs;
+    /**
+     * The value columns that the current query reads, indexed by the column
+     * number of the value, or nullptr if all of them are needed.  Set by the
+     * cursor before extract() is called, implementations are free to ignore
+     * it.
+     */
+    const std::vector<bool> *vi_columns_used{nullptr};
 protected:
     const intern_string_t vi_name;
 };
@@ -168,8 +243,8 @@ public:
             return true;
         }
 
-        content_line_t    cl(lss.at(lc.lc_curr_line));
-        std::shared_ptr<logfile> lf = lss.find(cl);
+        content_line_t    cl(lc.line_at(lc.lc_curr_line));
+        logfile *lf = lss.find_file_ptr(cl);
         logfile::iterator lf_iter = lf->begin() + cl;
         uint8_t mod_id = lf_iter->get_module_id();
 
@@ -233,6 +308,15 @@ public:
     std::string register_vtab(log_vtab_impl *vi);
     std::string unregister_vtab(intern_string_t name);
 
+    /**
+     * Start a batch of registrations.  The tables are created in a single
+     * transaction and the statement cache is only invalidated once, when
+     * end_batch() is called.
+     */
+    void begin_batch();
+
+    void end_batch();
+
     log_vtab_impl *lookup_impl(intern_string_t name) const
     {
         log_vtab_impl *retval = nullptr;
@@ -259,5 +343,6 @@ private:
     textview_curses &vm_textview;
     logfile_sub_source &vm_source;
     std::map<intern_string_t, log_vtab_impl *> vm_impls;
+    bool vm_in_batch{false};
 };
 #endif
@@ -45,14 +45,101 @@
 
 #include <time.h>
 
+#include <type_traits>
+
+#include "base/pthreadpp.hh"
 #include "base/string_util.hh"
 #include "logfile.hh"
 #include "lnav_util.hh"
+#include "lnav_config.hh"
+#include "task_pool.hh"
 
 using namespace std;
 
 static const size_t MAX_UNRECOGNIZED_LINES = 1000;
-static const size_t INDEX_RESERVE_INCREMENT = 1024;
+
+static const char INDEX_CACHE_MAGIC[8] = "lnavidx";
+static const uint32_t INDEX_CACHE_VERSION = 3;
+static const size_t INDEX_CACHE_HASH_SIZE = 4096;
+
+/**
+ * The root formats are shared by all files and carry the state of a scan
+ * while a file's format is being detected, so only one file at a time can
+ * use them.  Once detected, a file scans with its own specialized copy.
+ */
+static pthread_mutex_t ROOT_FORMATS_MUTEX = PTHREAD_MUTEX_INITIALIZER;
+
+static_assert(std::is_trivially_copyable<logline>::value,
+              "loglines are written to the index cache as-is");
+
+/**
+ * The header for a file in the index cache.  The header is followed by the
+ * pattern locks for the format, the loglines themselves and, if
+ * ich_search_index_lines is not zero, the blocks of the search index.
+ */
+struct index_cache_header {
+    char ich_magic[8];
+    uint32_t ich_version;
+    uint32_t ich_logline_size;
+    char ich_package[64];
+    char ich_formats_hash[64];
+    char ich_format_name[128];
+    char ich_content_id[64];
+    char ich_head_hash[64];
+    char ich_tail_hash[64];
+    uint64_t ich_dev;
+    uint64_t ich_ino;
+    int64_t ich_file_size;
+    int64_t ich_mtime;
+    int64_t ich_index_size;
+    uint64_t ich_line_count;
+    uint64_t ich_pattern_lock_count;
+    uint64_t ich_longest_line;
+    int32_t ich_text_format;
+    int32_t ich_timestamp_flags;
+    uint64_t ich_search_index_lines;
+};
+
+static void copy_to_field(char *dst, size_t dst_size, const string &src)
+{
+    memset(dst, 0, dst_size);
+    strncpy(dst, src.c_str(), dst_size - 1);
+}
+
+static string field_to_string(const char *src, size_t src_size)
+{
+    return string(src, strnlen(src, src_size));
+}
+
+/**
+ * The module indexes stored in the loglines are handed out as formats are
+ * loaded, so the cache is only valid for the same set of formats.
+ */
+static string root_formats_hash()
+{
+    string names;
+
+    for (auto lf : log_format::get_root_formats()) {
+        names.append(lf->get_name().get());
+        names.append(1, '\n');
+    }
+
+    return hash_string(names);
+}
+
+static bool hash_file_range(int fd, off_t off, size_t len, string &hash_out)
+{
+    char buffer[INDEX_CACHE_HASH_SIZE];
+
+    require(len <= sizeof(buffer));
+
+    if (pread(fd, buffer, len, off) != (ssize_t) len) {
+        return false;
+    }
+
+    hash_out = hash_bytes(buffer, len, nullptr);
+    return true;
+}
 
 logfile::logfile(const string &filename, logfile_open_options &loo)
     : lf_filename(filename)
@@ -81,6 +168,8 @@ logfile::logfile(const string &filename, logfile_open_options &loo)
         }
 
         loo.loo_fd.close_on_exec();
+        // The descriptor can be closed while the file is idle.
+        this->lf_line_buffer.set_reopen_path(resolved_path);
 
         log_info("Creating logfile: fd=%d; size=%" PRId64 "; mtime=%" PRId64 "; filename=%s",
                  (int) loo.loo_fd,
@@ -96,16 +185,45 @@ logfile::logfile(const string &filename, logfile_open_options &loo)
     }
 
     this->lf_content_id = hash_string(this->lf_filename);
+    this->lf_line_buffer.set_mmap_enabled(lnav_config.lc_tuning_mmap_enabled);
+    if (lnav_config.lc_tuning_index_search_index) {
+        this->lf_ngram_index = std::make_unique<ngram_index>();
+    }
     this->lf_line_buffer.set_fd(loo.loo_fd);
-    this->lf_index.reserve(INDEX_RESERVE_INCREMENT);
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (loo.loo_sequential_access) {
+        // Let the kernel read ahead further while the lines already read
+        // are being scanned.
+        posix_fadvise(loo.loo_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+    if (loo.loo_pipe_source != nullptr) {
+        this->lf_line_buffer.set_pipe_source(loo.loo_pipe_source);
+    }
+    if (loo.loo_range_source != nullptr) {
+        this->lf_line_buffer.set_range_source(loo.loo_range_source);
+    }
+    if (loo.loo_is_member) {
+        this->lf_line_buffer.set_member_range(loo.loo_member_range,
+                                              std::move(loo.loo_syncpoints));
+        loo.loo_syncpoints.clear();
+    }
 
     this->lf_options = loo;
+    this->adjust_member_stat(this->lf_stat);
 
     ensure(this->invariant());
 }
 
 logfile::~logfile()
 {
+    try {
+        this->save_index_cache();
+    }
+    catch (const std::exception &e) {
+        log_error("unable to save index cache for %s -- %s",
+                  this->lf_filename.c_str(), e.what());
+    }
 }
 
 bool logfile::exists() const
@@ -125,6 +243,34 @@ bool logfile::exists() const
            this->lf_stat.st_size <= st.st_size;
 }
 
+bool logfile::has_unindexed_data()
+{
+    struct stat st;
+
+    if (this->lf_line_buffer.is_fd_closed()) {
+        if (::stat(this->lf_filename.c_str(), &st) == -1) {
+            return false;
+        }
+    }
+    else if (fstat(this->lf_line_buffer.get_fd(), &st) == -1) {
+        return false;
+    }
+    this->adjust_member_stat(st);
+
+    return this->lf_line_buffer.is_data_available(this->lf_index_size,
+                                                  st.st_size);
+}
+
+void logfile::adjust_member_stat(struct stat &st) const
+{
+    if (!this->lf_options.loo_is_member) {
+        return;
+    }
+
+    st.st_size = this->lf_options.loo_member_range.fr_size;
+    st.st_mtime = this->lf_options.loo_member_mtime;
+}
+
 void logfile::set_format_base_time(log_format *lf)
 {
     time_t file_time = this->lf_line_buffer.get_file_time();
@@ -135,6 +281,349 @@ void logfile::set_format_base_time(log_format *lf)
     lf->lf_date_time.set_base_time(file_time);
 }
 
+filesystem::path logfile::get_index_cache_path() const
+{
+    return dotlnav_path() / "index-cache" / hash_string(this->lf_filename);
+}
+
+nonstd::optional<filesystem::path>
+logfile::get_match_cache_path(const string &key) const
+{
+    if (key.empty() ||
+        this->lf_index.empty() ||
+        this->lf_index_cache_lines != this->lf_index.size() ||
+        this->lf_indexing_incomplete ||
+        this->lf_tail_start > 0 ||
+        this->lf_dropped_lines > 0) {
+        return nonstd::nullopt;
+    }
+
+    // The fingerprint of the indexed data is part of the name, so the
+    // matches for an older version of the file are never used.
+    string fingerprint = this->lf_content_id + ":" +
+        to_string((uint64_t) this->lf_stat.st_dev) + ":" +
+        to_string((uint64_t) this->lf_stat.st_ino) + ":" +
+        to_string((int64_t) this->lf_stat.st_size) + ":" +
+        to_string((int64_t) this->lf_stat.st_mtime) + ":" +
+        to_string((int64_t) this->lf_index_size) + ":" +
+        to_string(this->lf_index.size()) + "\n" + key;
+
+    return dotlnav_path() / "index-cache" /
+           ("match-" + hash_string(fingerprint));
+}
+
+bool logfile::load_index_cache(const struct stat &st)
+{
+    if (!lnav_config.lc_tuning_index_cache_enabled ||
+        !this->lf_valid_filename ||
+        !this->lf_index.empty() ||
+        (this->lf_line_buffer.is_compressed() &&
+         !this->lf_line_buffer.is_gzipped()) ||
+        st.st_size < lnav_config.lc_tuning_index_cache_min_size) {
+        return false;
+    }
+
+    auto cache_path = this->get_index_cache_path();
+    auto_fd fd;
+
+    if ((fd = openp(cache_path, O_RDONLY)) == -1) {
+        return false;
+    }
+
+    struct index_cache_header ich;
+
+    if (read(fd, &ich, sizeof(ich)) != sizeof(ich)) {
+        return false;
+    }
+
+    if (memcmp(ich.ich_magic, INDEX_CACHE_MAGIC, sizeof(ich.ich_magic)) != 0 ||
+        ich.ich_version != INDEX_CACHE_VERSION ||
+        ich.ich_logline_size != sizeof(logline) ||
+        field_to_string(ich.ich_package, sizeof(ich.ich_package)) !=
+        VCS_PACKAGE_STRING ||
+        field_to_string(ich.ich_formats_hash, sizeof(ich.ich_formats_hash)) !=
+        root_formats_hash()) {
+        log_debug("index cache is from a different version -- %s",
+                  cache_path.str().c_str());
+        return false;
+    }
+
+    /*
+     * The offsets in a compressed file are for the uncompressed data, so
+     * the file has to be unchanged and the hashes cover the compressed
+     * data instead.
+     */
+    bool compressed = this->lf_line_buffer.is_compressed();
+    off_t hash_end = compressed ? st.st_size : ich.ich_index_size;
+
+    if (ich.ich_dev != (uint64_t) st.st_dev ||
+        ich.ich_ino != (uint64_t) st.st_ino ||
+        ich.ich_file_size > st.st_size ||
+        ((compressed || ich.ich_file_size == st.st_size) &&
+         (ich.ich_file_size != st.st_size || ich.ich_mtime != st.st_mtime)) ||
+        (!compressed && ich.ich_index_size > st.st_size) ||
+        ich.ich_line_count == 0) {
+        log_debug("index cache is stale -- %s", cache_path.str().c_str());
+        return false;
+    }
+
+    size_t head_len = std::min((size_t) hash_end, INDEX_CACHE_HASH_SIZE);
+    string head_hash, tail_hash;
+
+    if (!hash_file_range(this->lf_line_buffer.get_fd(), 0, head_len,
+                         head_hash) ||
+        !hash_file_range(this->lf_line_buffer.get_fd(),
+                         hash_end - head_len, head_len,
+                         tail_hash) ||
+        head_hash !=
+        field_to_string(ich.ich_head_hash, sizeof(ich.ich_head_hash)) ||
+        tail_hash !=
+        field_to_string(ich.ich_tail_hash, sizeof(ich.ich_tail_hash))) {
+        log_debug("index cache does not match file contents -- %s",
+                  cache_path.str().c_str());
+        return false;
+    }
+
+    auto format_name = field_to_string(ich.ich_format_name,
+                                       sizeof(ich.ich_format_name));
+    auto root_format = log_format::find_root_format(format_name.c_str());
+
+    if (root_format == nullptr || root_format->lf_is_self_describing ||
+        !root_format->match_name(this->lf_filename)) {
+        return false;
+    }
+
+    static const size_t LINES_PER_READ = 16 * 1024;
+
+    vector<log_format::pattern_for_lines> pattern_locks;
+    chunked_vector<logline> index;
+    vector<logline> lines;
+
+    pattern_locks.resize(ich.ich_pattern_lock_count, {0, 0});
+
+    ssize_t locks_size = sizeof(log_format::pattern_for_lines) *
+                         pattern_locks.size();
+
+    if (read(fd, pattern_locks.data(), locks_size) != locks_size) {
+        log_error("truncated index cache -- %s", cache_path.str().c_str());
+        return false;
+    }
+    // The lines are read in batches so the whole index is never in
+    // memory twice.
+    for (uint64_t start = 0;
+         start < ich.ich_line_count;
+         start += LINES_PER_READ) {
+        size_t count = std::min((uint64_t) LINES_PER_READ,
+                                ich.ich_line_count - start);
+
+        lines.resize(count, logline(0, 0, 0, LEVEL_UNKNOWN));
+
+        ssize_t lines_size = sizeof(logline) * lines.size();
+
+        if (read(fd, lines.data(), lines_size) != lines_size) {
+            log_error("truncated index cache -- %s", cache_path.str().c_str());
+            return false;
+        }
+        // Caches written by older builds could have the user's marks in
+        // them.
+        for (auto &ll : lines) {
+            ll.set_mark(false);
+        }
+        index.append(lines.begin(), lines.end());
+    }
+
+    {
+        mutex_guard mg(ROOT_FORMATS_MUTEX);
+
+        root_format->clear();
+        this->lf_format = root_format->specialized();
+    }
+    this->lf_format->lf_pattern_locks = std::move(pattern_locks);
+    this->lf_format->lf_timestamp_flags = ich.ich_timestamp_flags;
+    this->set_format_base_time(this->lf_format.get());
+    this->lf_index = std::move(index);
+    this->lf_level_summary_lines = 0;
+    this->lf_index_size = ich.ich_index_size;
+    this->lf_content_id = field_to_string(ich.ich_content_id,
+                                          sizeof(ich.ich_content_id));
+    this->lf_text_format = (text_format_t) ich.ich_text_format;
+    this->lf_longest_line = ich.ich_longest_line;
+    this->lf_index_cache_lines = this->lf_index.size();
+    // The cache does not have the operation IDs.
+    this->lf_opids_missing = true;
+    this->lf_sort_needed = true;
+    // The cache does not say if the last line was complete, so read it
+    // again to be sure.
+    this->lf_partial_line = true;
+
+    if (this->lf_ngram_index != nullptr &&
+        ich.ich_search_index_lines == ich.ich_line_count) {
+        if (this->lf_ngram_index->load(fd, ich.ich_search_index_lines)) {
+            this->lf_index_cache_search_lines = ich.ich_search_index_lines;
+        } else {
+            log_error("truncated search index in index cache -- %s",
+                      cache_path.str().c_str());
+        }
+    }
+
+    log_info("%s: restored %d lines (%lld bytes) from index cache -- %s",
+             this->lf_filename.c_str(),
+             this->lf_index.size(),
+             (long long) this->lf_index_size,
+             format_name.c_str());
+
+    this->reobserve_from(this->begin());
+
+    return true;
+}
+
+bool logfile::write_cached_lines(int fd) const
+{
+    static const size_t LINES_PER_WRITE = 16 * 1024;
+
+    // The marks belong to the session and the time offset is applied
+    // again when the session is restored, so neither is saved.
+    int64_t offset_millis = (int64_t) this->lf_time_offset.tv_sec * 1000LL +
+                            this->lf_time_offset.tv_usec / 1000LL;
+    vector<logline> lines;
+
+    lines.reserve(std::min(LINES_PER_WRITE, this->lf_index.size()));
+    for (size_t start = 0;
+         start < this->lf_index.size();
+         start += LINES_PER_WRITE) {
+        size_t end = std::min(start + LINES_PER_WRITE, this->lf_index.size());
+
+        lines.assign(this->lf_index.begin() + start,
+                     this->lf_index.begin() + end);
+        for (auto &ll : lines) {
+            ll.set_mark(false);
+            if (offset_millis != 0) {
+                shift_line_time(ll, -offset_millis);
+            }
+        }
+
+        ssize_t lines_size = sizeof(logline) * lines.size();
+
+        if (write(fd, lines.data(), lines_size) != lines_size) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void logfile::save_index_cache()
+{
+    if (!lnav_config.lc_tuning_index_cache_enabled ||
+        !this->lf_valid_filename ||
+        this->lf_tail_start > 0 ||
+        this->lf_dropped_lines > 0 ||
+        this->lf_index_limit != -1 ||
+        this->lf_is_closed ||
+        this->lf_format == nullptr ||
+        this->lf_format->lf_is_self_describing ||
+        (this->lf_line_buffer.is_compressed() &&
+         !this->lf_line_buffer.is_gzipped()) ||
+        this->lf_index.empty() ||
+        this->lf_index_size < lnav_config.lc_tuning_index_cache_min_size) {
+        return;
+    }
+
+    auto cache_path = this->get_index_cache_path();
+
+    size_t search_lines = 0;
+
+    if (this->lf_ngram_index != nullptr &&
+        this->lf_ngram_index->get_line_count() == this->lf_index.size()) {
+        search_lines = this->lf_index.size();
+    }
+
+    if (this->lf_index_cache_lines == this->lf_index.size() &&
+        this->lf_index_cache_search_lines >= search_lines) {
+        // Nothing new was indexed, just keep the cache from expiring.
+        log_perror(utimes(cache_path.str().c_str(), nullptr));
+        return;
+    }
+
+    off_t hash_end = this->lf_line_buffer.is_compressed() ?
+                     this->lf_stat.st_size : this->lf_index_size;
+    size_t head_len = std::min((size_t) hash_end, INDEX_CACHE_HASH_SIZE);
+    string head_hash, tail_hash;
+
+    if (!this->lf_line_buffer.ensure_fd_open() ||
+        !hash_file_range(this->lf_line_buffer.get_fd(), 0, head_len,
+                         head_hash) ||
+        !hash_file_range(this->lf_line_buffer.get_fd(),
+                         hash_end - head_len, head_len,
+                         tail_hash)) {
+        return;
+    }
+
+    struct index_cache_header ich;
+
+    memset(&ich, 0, sizeof(ich));
+    memcpy(ich.ich_magic, INDEX_CACHE_MAGIC, sizeof(ich.ich_magic));
+    ich.ich_version = INDEX_CACHE_VERSION;
+    ich.ich_logline_size = sizeof(logline);
+    copy_to_field(ich.ich_package, sizeof(ich.ich_package),
+                  VCS_PACKAGE_STRING);
+    copy_to_field(ich.ich_formats_hash, sizeof(ich.ich_formats_hash),
+                  root_formats_hash());
+    copy_to_field(ich.ich_format_name, sizeof(ich.ich_format_name),
+                  this->lf_format->get_name().to_string());
+    copy_to_field(ich.ich_content_id, sizeof(ich.ich_content_id),
+                  this->lf_content_id);
+    copy_to_field(ich.ich_head_hash, sizeof(ich.ich_head_hash), head_hash);
+    copy_to_field(ich.ich_tail_hash, sizeof(ich.ich_tail_hash), tail_hash);
+    ich.ich_dev = this->lf_stat.st_dev;
+    ich.ich_ino = this->lf_stat.st_ino;
+    ich.ich_file_size = this->lf_stat.st_size;
+    ich.ich_mtime = this->lf_stat.st_mtime;
+    ich.ich_index_size = this->lf_index_size;
+    ich.ich_line_count = this->lf_index.size();
+    ich.ich_pattern_lock_count = this->lf_format->lf_pattern_locks.size();
+    ich.ich_longest_line = this->lf_longest_line;
+    ich.ich_text_format = (int32_t) this->lf_text_format;
+    ich.ich_timestamp_flags = this->lf_format->lf_timestamp_flags;
+    ich.ich_search_index_lines = search_lines;
+
+    // Other instances can be saving a cache for the same file at the same
+    // time, so each one writes to its own temporary file.
+    auto tmp_path = cache_path.str() + "." + std::to_string(getpid()) + ".tmp";
+    auto_fd fd;
+
+    if ((fd = openp(filesystem::path(tmp_path), O_WRONLY | O_CREAT | O_TRUNC, 0600)) == -1) {
+        log_debug("unable to create index cache -- %s", strerror(errno));
+        return;
+    }
+
+    ssize_t locks_size = sizeof(log_format::pattern_for_lines) *
+                         this->lf_format->lf_pattern_locks.size();
+
+    if (write(fd, &ich, sizeof(ich)) != sizeof(ich) ||
+        write(fd, this->lf_format->lf_pattern_locks.data(), locks_size) !=
+        locks_size ||
+        !this->write_cached_lines(fd) ||
+        (search_lines > 0 && !this->lf_ngram_index->save(fd))) {
+        log_error("unable to write index cache -- %s", strerror(errno));
+        log_perror(unlink(tmp_path.c_str()));
+        return;
+    }
+
+    if (rename(tmp_path.c_str(), cache_path.str().c_str()) == -1) {
+        log_error("unable to rename index cache -- %s", strerror(errno));
+        log_perror(unlink(tmp_path.c_str()));
+        return;
+    }
+
+    this->lf_index_cache_lines = this->lf_index.size();
+    this->lf_index_cache_search_lines = search_lines;
+
+    log_info("%s: saved %d lines to index cache",
+             this->lf_filename.c_str(),
+             this->lf_index.size());
+}
+
 bool logfile::process_prefix(shared_buffer_ref &sbr, const line_info &li)
 {
     log_format::scan_result_t found = log_format::SCAN_NO_MATCH;
@@ -151,6 +640,7 @@ bool logfile::process_prefix(shared_buffer_ref &sbr, const line_info &li)
     }
     else if (this->lf_options.loo_detect_format &&
              this->lf_index.size() < MAX_UNRECOGNIZED_LINES) {
+        mutex_guard mg(ROOT_FORMATS_MUTEX);
         vector<log_format *> &root_formats =
             log_format::get_root_formats();
         vector<log_format *>::iterator iter;
@@ -166,6 +656,10 @@ bool logfile::process_prefix(shared_buffer_ref &sbr, const line_info &li)
                 continue;
             }
 
+            if (!(*iter)->scan_prefilter(sbr)) {
+                continue;
+            }
+
             (*iter)->clear();
             this->set_format_base_time(*iter);
             found = (*iter)->scan(*this, this->lf_index, li, sbr);
@@ -230,37 +724,9 @@ bool logfile::process_prefix(shared_buffer_ref &sbr, const line_info &li)
                 }
             }
             break;
-        case log_format::SCAN_NO_MATCH: {
-            log_level_t last_level = LEVEL_UNKNOWN;
-            time_t last_time = this->lf_index_time;
-            short last_millis = 0;
-            uint8_t last_mod = 0, last_opid = 0;
-
-            if (!this->lf_index.empty()) {
-                logline &ll = this->lf_index.back();
-
-                /*
-                 * Assume this line is part of the previous one(s) and copy the
-                 * metadata over.
-                 */
-                last_time = ll.get_time();
-                last_millis = ll.get_millis();
-                if (this->lf_format.get() != NULL) {
-                    last_level = (log_level_t)(ll.get_level_and_flags() |
-                        LEVEL_CONTINUED);
-                }
-                last_mod = ll.get_module_id();
-                last_opid = ll.get_opid();
-            }
-            this->lf_index.emplace_back(li.li_file_range.fr_offset,
-                                        last_time,
-                                        last_millis,
-                                        last_level,
-                                        last_mod,
-                                        last_opid);
-            this->lf_index.back().set_valid_utf(li.li_valid_utf);
+        case log_format::SCAN_NO_MATCH:
+            this->add_continued_line(li);
             break;
-        }
         case log_format::SCAN_INCOMPLETE:
             break;
     }
@@ -268,16 +734,121 @@ bool logfile::process_prefix(shared_buffer_ref &sbr, const line_info &li)
     return retval;
 }
 
-logfile::rebuild_result_t logfile::rebuild_index()
+void logfile::add_continued_line(const line_info &li)
+{
+    log_level_t last_level = LEVEL_UNKNOWN;
+    time_t last_time = this->lf_index_time;
+    short last_millis = 0;
+    uint8_t last_mod = 0, last_opid = 0;
+
+    if (!this->lf_index.empty()) {
+        logline &ll = this->lf_index.back();
+
+        /*
+         * Assume this line is part of the previous one(s) and copy the
+         * metadata over.
+         */
+        last_time = ll.get_time();
+        last_millis = ll.get_millis();
+        if (this->lf_format.get() != NULL) {
+            last_level = (log_level_t)(ll.get_level_and_flags() |
+                LEVEL_CONTINUED);
+        }
+        last_mod = ll.get_module_id();
+        last_opid = ll.get_opid();
+    }
+    this->lf_index.emplace_back(li.li_file_range.fr_offset,
+                                last_time,
+                                last_millis,
+                                last_level,
+                                last_mod,
+                                last_opid);
+    this->lf_index.back().set_valid_utf(li.li_valid_utf);
+}
+
+bool logfile::is_split_before(off_t off)
+{
+    if (this->lf_index.empty()) {
+        return false;
+    }
+
+    off_t last_off = this->lf_index.back().get_offset();
+
+    if (off - last_off != line_buffer::MAX_LINE_BUFFER_SIZE - 1) {
+        return false;
+    }
+
+    // A line that is exactly that long and ends with a line feed was not
+    // split.
+    try {
+        auto read_result = this->lf_line_buffer.read_range({off - 1, 1});
+
+        return read_result.isOk() &&
+               read_result.unwrap().get_data()[0] != '\n';
+    }
+    catch (line_buffer::error & e) {
+        return false;
+    }
+}
+
+logfile::rebuild_result_t logfile::rebuild_index(deadline_t deadline)
 {
     rebuild_result_t retval = RR_NO_NEW_LINES;
     struct stat st;
+    time_t now = time(nullptr);
+
+    if (this->lf_watch_descriptor != -1 && !this->lf_change_pending &&
+        !this->lf_sort_needed &&
+        (now - this->lf_last_poll_time) < WATCHED_POLL_INTERVAL) {
+        return RR_NO_NEW_LINES;
+    }
+    this->lf_change_pending = false;
+    this->lf_indexing_incomplete = false;
+    this->lf_last_poll_time = now;
 
     this->lf_activity.la_polls += 1;
 
+    this->lf_line_buffer.pull_pipe();
+
+    if (this->lf_line_buffer.is_fd_closed()) {
+        // Check for changes without reopening the file, exists() will catch
+        // the file being removed or replaced.
+        if (::stat(this->lf_filename.c_str(), &st) == -1 ||
+            (!this->lf_sort_needed &&
+             st.st_size == this->lf_stat.st_size &&
+             st.st_mtime == this->lf_stat.st_mtime)) {
+            return RR_NO_NEW_LINES;
+        }
+        if (!this->lf_line_buffer.ensure_fd_open()) {
+            return RR_NO_NEW_LINES;
+        }
+    }
+
     if (fstat(this->lf_line_buffer.get_fd(), &st) == -1) {
         throw error(this->lf_filename, errno);
     }
+    this->adjust_member_stat(st);
+
+    if (!this->lf_index_cache_checked) {
+        this->lf_index_cache_checked = true;
+        if (this->load_index_cache(st)) {
+            retval = RR_NEW_ORDER;
+        }
+    }
+
+    if (!this->lf_tail_first_checked) {
+        this->lf_tail_first_checked = true;
+        // Only worth it when the caller is going to show the partial index.
+        if (deadline && this->lf_index.empty()) {
+            this->start_tail_first(st);
+        }
+    }
+
+    off_t index_end = st.st_size;
+
+    if (this->lf_index_limit != -1) {
+        index_end = std::min(index_end, this->lf_index_limit);
+    }
 
     // Check the previous stat against the last to see if things are wonky.
     if (st.st_size < this->lf_stat.st_size ||
@@ -288,7 +859,7 @@ logfile::rebuild_result_t logfile::rebuild_index()
         this->close();
         return RR_NO_NEW_LINES;
     }
-    else if (this->lf_line_buffer.is_data_available(this->lf_index_size, st.st_size)) {
+    else if (this->lf_line_buffer.is_data_available(this->lf_index_size, index_end)) {
         this->lf_activity.la_reads += 1;
 
         // We haven't reached the end of the file.  Note that we use the
@@ -305,12 +876,19 @@ logfile::rebuild_result_t logfile::rebuild_index()
             getrusage(RUSAGE_SELF, &begin_rusage);
         }
 
-        if (!this->lf_index.empty()) {
+        if (!this->lf_index.empty() && !this->lf_partial_line) {
+            // The last line ended with a newline, so there is nothing to
+            // read again and the buffered data is still good.  The filters
+            // are still restarted below so that the last message can pick
+            // up any continuation lines.
+            off = this->lf_index_size;
+            this->lf_annotation_cache.clear();
+        }
+        else if (!this->lf_index.empty()) {
             off = this->lf_index.back().get_offset();
 
             /*
-             * Drop the last line we read since it might have been a partial
-             * read.
+             * Drop the last line we read since it was a partial read.
              */
             while (this->lf_index.back().get_sub_offset() != 0) {
                 this->lf_index.pop_back();
@@ -318,8 +896,22 @@ logfile::rebuild_result_t logfile::rebuild_index()
             }
             this->lf_index.pop_back();
             rollback_size += 1;
+            this->lf_level_summary_lines = std::min(
+                this->lf_level_summary_lines, this->lf_index.size());
+            if (this->lf_ngram_index != nullptr) {
+                this->lf_ngram_index->truncate(this->lf_index.size());
+            }
+            if (this->lf_format != nullptr) {
+                this->lf_format->truncate_opids(this->lf_index.size());
+            }
 
-            this->lf_line_buffer.clear();
+            // The last message can pick up continuation lines.
+            this->lf_annotation_cache.clear();
+            if (!this->lf_line_buffer.has_pipe_source()) {
+                // A pipe is only ever appended to, so what is buffered is
+                // still good.
+                this->lf_line_buffer.clear();
+            }
             if (!this->lf_index.empty()) {
                 off_t check_line_off = this->lf_index.back().get_offset();
 
@@ -337,7 +929,7 @@ logfile::rebuild_result_t logfile::rebuild_index()
             }
         }
         else {
-            off = 0;
+            off = this->lf_tail_start;
         }
         if (this->lf_logline_observer != NULL) {
             this->lf_logline_observer->logline_restart(*this, rollback_size);
@@ -347,68 +939,155 @@ logfile::rebuild_result_t logfile::rebuild_index()
         this->lf_sort_needed = false;
 
         auto prev_range = file_range{off};
-        while (true) {
-            auto load_result = this->lf_line_buffer.load_next_line(prev_range);
+        bool prev_split = this->is_split_before(off);
+        bool done = false;
+        while (!done) {
+            perf_timer read_timer(perf_stage_t::READ,
+                                  &this->lf_activity.la_read_perf);
+            auto load_result = this->lf_line_buffer.load_next_lines(prev_range);
 
             if (load_result.isErr()) {
                 this->close();
                 return RR_INVALID;
             }
 
-            auto li = load_result.unwrap();
+            auto lines = load_result.unwrap();
 
-            if (li.li_file_range.empty()) {
+            if (lines.empty()) {
                 break;
             }
-            prev_range = li.li_file_range;
-
-            size_t old_size = this->lf_index.size();
-
-            // Update this early so that line_length() works
-            this->lf_index_size = li.li_file_range.next_offset();
-            if (old_size == 0) {
-                file_range fr = this->lf_line_buffer.get_available();
-                auto avail_data = this->lf_line_buffer.read_range(fr);
-
-                this->lf_text_format = avail_data.map(
-                    [](const shared_buffer_ref &avail_sbr) -> text_format_t {
-                        return detect_text_format(
-                            avail_sbr.get_data(), avail_sbr.length());
-                    })
-                    .unwrapOr(text_format_t::TF_UNKNOWN);
-            }
 
-            auto read_result = this->lf_line_buffer.read_range(li.li_file_range);
-            if (read_result.isErr()) {
+            // The batch is contiguous and in the buffer, so the lines can
+            // share a single read of the whole range.
+            auto batch_range = file_range{
+                lines.front().li_file_range.fr_offset,
+                lines.back().li_file_range.next_offset() -
+                lines.front().li_file_range.fr_offset,
+            };
+            auto batch_result = this->lf_line_buffer.read_range(batch_range);
+            if (batch_result.isErr()) {
                 this->close();
                 return RR_INVALID;
             }
 
-            auto sbr = read_result.unwrap().rtrim(is_line_ending);
-            this->lf_longest_line = std::max(this->lf_longest_line, sbr.length());
-            this->lf_partial_line = li.li_partial;
-            sort_needed = this->process_prefix(sbr, li) || sort_needed;
+            auto batch_sbr = batch_result.unwrap();
 
-            if (old_size > this->lf_index.size()) {
-                old_size = 0;
-            }
+            read_timer.add(lines.size(), batch_range.fr_size);
+            read_timer.stop();
+
+            auto scan_start = std::chrono::steady_clock::now();
+            std::chrono::steady_clock::duration filter_time{0};
+            size_t scanned = 0;
+
+            for (const auto &li : lines) {
+                if (this->lf_index_limit != -1 &&
+                    li.li_file_range.fr_offset >= this->lf_index_limit) {
+                    done = true;
+                    break;
+                }
+
+                prev_range = li.li_file_range;
+
+                size_t old_size = this->lf_index.size();
+
+                // Update this early so that line_length() works
+                this->lf_index_size = li.li_file_range.next_offset();
+                if (old_size == 0) {
+                    file_range fr = this->lf_line_buffer.get_available();
+                    auto avail_data = this->lf_line_buffer.read_range(fr);
+
+                    this->lf_text_format = avail_data.map(
+                        [](const shared_buffer_ref &avail_sbr) -> text_format_t {
+                            return detect_text_format(
+                                avail_sbr.get_data(), avail_sbr.length());
+                        })
+                        .unwrapOr(text_format_t::TF_UNKNOWN);
+                }
+
+                shared_buffer_ref sbr;
+
+                sbr.subset(batch_sbr,
+                           li.li_file_range.fr_offset - batch_range.fr_offset,
+                           li.li_file_range.fr_size);
+                if (!this->lf_line_buffer.is_length_prefixed()) {
+                    sbr.rtrim(is_line_ending);
+                }
+                this->lf_longest_line = std::max(this->lf_longest_line, sbr.length());
+                this->lf_partial_line = li.li_partial;
+                if (prev_split && !this->lf_index.empty()) {
+                    // The rest of a line that was too long is not scanned
+                    // for a new message, it is part of the same one.  The
+                    // pieces are lines in the index so that each one can be
+                    // read, searched, and filtered without having the whole
+                    // line in memory.
+                    this->add_continued_line(li);
+                } else {
+                    sort_needed = this->process_prefix(sbr, li) || sort_needed;
+                }
+                prev_split = li.li_split;
+                scanned += 1;
+
+                if (old_size > this->lf_index.size()) {
+                    old_size = 0;
+                }
+
+                if (this->lf_ngram_index != nullptr) {
+                    this->lf_ngram_index->truncate(old_size);
+                    for (size_t lpc = old_size;
+                         lpc < this->lf_index.size();
+                         lpc++) {
+                        this->lf_ngram_index->add_line(
+                            lpc, sbr.get_data(), sbr.length());
+                    }
+                }
 
-            for (auto iter = this->begin() + old_size;
-                    iter != this->end(); ++iter) {
                 if (this->lf_logline_observer != nullptr) {
-                    this->lf_logline_observer->logline_new_line(*this, iter, sbr);
+                    auto filter_start = std::chrono::steady_clock::now();
+
+                    for (auto iter = this->begin() + old_size;
+                         iter != this->end(); ++iter) {
+                        this->lf_logline_observer->logline_new_line(*this, iter, sbr);
+                    }
+                    filter_time += std::chrono::steady_clock::now() -
+                                   filter_start;
+                }
+
+                if (!has_format && this->lf_format != nullptr) {
+                    done = true;
+                    break;
                 }
             }
 
-            if (this->lf_logfile_observer != nullptr) {
-                this->lf_logfile_observer->logfile_indexing(
-                    *this,
-                    this->lf_line_buffer.get_read_offset(li.li_file_range.next_offset()),
-                    st.st_size);
+            auto scan_time = std::chrono::steady_clock::now() - scan_start;
+            perf_record(perf_stage_t::SCAN,
+                        &this->lf_activity.la_scan_perf,
+                        scan_time - filter_time,
+                        scanned);
+            if (this->lf_logline_observer != nullptr) {
+                perf_record(perf_stage_t::FILTER,
+                            &this->lf_activity.la_filter_perf,
+                            filter_time,
+                            scanned);
             }
 
-            if (!has_format && this->lf_format != nullptr) {
-                break;
+            if (this->lf_logfile_observer != nullptr &&
+                !this->lf_logfile_observer->logfile_indexing(
+                    *this,
+                    this->lf_line_buffer.get_read_offset(prev_range.next_offset()),
+                    st.st_size)) {
+                // Make sure the next call does not skip the rest of the file.
+                this->lf_change_pending = true;
+                this->lf_indexing_incomplete = true;
+                done = true;
+            }
+            else if (deadline &&
+                     (std::chrono::steady_clock::now() >= deadline.value() ||
+                      task_pool::singleton().should_yield())) {
+                // Stop early when more urgent work is waiting for a worker,
+                // the rest of the file is picked up in the next slice.
+                this->lf_change_pending = true;
+                this->lf_indexing_incomplete = true;
+                done = true;
             }
         }
 
@@ -455,15 +1134,359 @@ logfile::rebuild_result_t logfile::rebuild_index()
         this->lf_out_of_time_order_count = 0;
     }
 
+    if (this->lf_tail_start > 0 && !this->lf_indexing_incomplete &&
+        !this->lf_is_closed) {
+        auto backfill_result = this->rebuild_backfill(deadline);
+
+        if (backfill_result != RR_NO_NEW_LINES) {
+            retval = backfill_result;
+        }
+    }
+
+    if (retval != RR_NO_NEW_LINES &&
+        this->apply_retention() == RR_NEW_ORDER) {
+        retval = RR_NEW_ORDER;
+    }
+
+    // Indexing can stop early, so check again until nothing new is found.
+    if (retval != RR_NO_NEW_LINES) {
+        this->lf_change_pending = true;
+    }
+
+    this->update_level_summary();
+
+    // Publish the index as soon as the file has been read through once so
+    // that other instances opening the same file can start from it instead
+    // of waiting for this one to exit.
+    if (!this->lf_index_cache_published && !this->lf_indexing_incomplete &&
+        this->lf_tail_start == 0 && !this->lf_index.empty()) {
+        this->lf_index_cache_published = true;
+        try {
+            this->save_index_cache();
+        }
+        catch (const std::exception &e) {
+            log_error("unable to save index cache for %s -- %s",
+                      this->lf_filename.c_str(), e.what());
+        }
+    }
+
     return retval;
 }
 
+void logfile::update_level_summary()
+{
+    if (this->lf_level_summary_lines == this->lf_index.size()) {
+        return;
+    }
+
+    // The last block might have been partly filled or had lines dropped,
+    // so the summary is redone from the start of that block.
+    size_t first_block = std::min(this->lf_level_summary_lines,
+                                  this->lf_index.size()) / LEVEL_BLOCK_SIZE;
+
+    if (first_block == 0) {
+        memset(this->lf_level_counts, 0, sizeof(this->lf_level_counts));
+        this->lf_level_blocks.clear();
+    }
+    for (size_t block = first_block;
+         block < this->lf_level_blocks.size();
+         block++) {
+        for (int lpc = 0; lpc < LEVEL__MAX; lpc++) {
+            this->lf_level_counts[lpc] -=
+                this->lf_level_blocks[block].lb_counts[lpc];
+        }
+    }
+    this->lf_level_blocks.resize(first_block);
+
+    for (size_t line_number = first_block * LEVEL_BLOCK_SIZE;
+         line_number < this->lf_index.size();
+         line_number++) {
+        if (line_number % LEVEL_BLOCK_SIZE == 0) {
+            this->lf_level_blocks.emplace_back();
+        }
+
+        const auto &ll = this->lf_index[line_number];
+        auto level = ll.get_msg_level();
+        auto &lb = this->lf_level_blocks.back();
+
+        // Continuation lines have the level of their message, so they are
+        // in the mask for filtering, but they are not counted.
+        lb.lb_mask |= level_mask(level);
+        lb.lb_min_time = std::min(lb.lb_min_time, ll.get_time_in_millis());
+        lb.lb_max_time = std::max(lb.lb_max_time, ll.get_time_in_millis());
+        if (ll.is_continued()) {
+            continue;
+        }
+        lb.lb_counts[level] += 1;
+        this->lf_level_counts[level] += 1;
+    }
+    this->lf_level_summary_lines = this->lf_index.size();
+}
+
+void logfile::start_tail_first(const struct stat &st)
+{
+    off_t tail_size = lnav_config.lc_tuning_index_tail_first_size;
+
+    if (tail_size == 0 ||
+        !this->lf_valid_filename ||
+        this->lf_line_buffer.is_compressed() ||
+        st.st_size < 2 * tail_size) {
+        return;
+    }
+
+    auto start_result = this->lf_line_buffer.find_line_start(
+        st.st_size - tail_size);
+
+    if (start_result.isErr()) {
+        log_error("%s: unable to find the start of the tail -- %s",
+                  this->lf_filename.c_str(),
+                  start_result.unwrapErr().c_str());
+        return;
+    }
+
+    auto tail_start = start_result.unwrap();
+
+    if (tail_start == 0) {
+        return;
+    }
+
+    log_info("%s: indexing from offset %lld first",
+             this->lf_filename.c_str(),
+             (long long) tail_start);
+    this->lf_tail_start = tail_start;
+    this->lf_index_size = tail_start;
+}
+
+logfile::rebuild_result_t logfile::rebuild_backfill(deadline_t deadline)
+{
+    if (this->lf_backfill == nullptr) {
+        logfile_open_options loo;
+
+        loo.loo_detect_format = this->lf_options.loo_detect_format;
+        try {
+            this->lf_backfill = std::make_unique<logfile>(this->lf_filename,
+                                                          loo);
+        } catch (const error &e) {
+            log_error("%s: unable to open file for back-fill -- %s",
+                      this->lf_filename.c_str(),
+                      strerror(e.e_err));
+            this->abandon_tail_first();
+            return RR_NEW_ORDER;
+        }
+
+        auto &bf = *this->lf_backfill;
+
+        bf.lf_index_cache_checked = true;
+        bf.lf_tail_first_checked = true;
+        bf.lf_index_limit = this->lf_tail_start;
+        if (this->lf_format != nullptr) {
+            // The earlier lines have to be scanned the same way.
+            auto root_format = log_format::find_root_format(
+                this->lf_format->get_name().get());
+
+            if (root_format != nullptr) {
+                mutex_guard mg(ROOT_FORMATS_MUTEX);
+
+                root_format->clear();
+                bf.lf_format = root_format->specialized();
+                bf.set_format_base_time(bf.lf_format.get());
+            }
+        }
+    }
+
+    auto &bf = *this->lf_backfill;
+
+    bf.rebuild_index(deadline);
+    if (bf.is_closed()) {
+        this->abandon_tail_first();
+        return RR_NEW_ORDER;
+    }
+    if (bf.is_indexing_incomplete()) {
+        this->lf_change_pending = true;
+        this->lf_indexing_incomplete = true;
+        return RR_NO_NEW_LINES;
+    }
+
+    if ((bf.lf_format == nullptr) != (this->lf_format == nullptr) ||
+        (bf.lf_format != nullptr &&
+         bf.lf_format->get_name() != this->lf_format->get_name())) {
+        // The start of the file was recognized differently.
+        this->abandon_tail_first();
+        return RR_NEW_ORDER;
+    }
+
+    size_t prefix_size = bf.lf_index.size();
+
+    log_info("%s: back-filled %d lines before the tail",
+             this->lf_filename.c_str(),
+             prefix_size);
+    if (this->lf_logline_observer != nullptr) {
+        this->lf_logline_observer->logline_restart(*this,
+                                                   this->lf_index.size());
+    }
+    if (this->lf_format != nullptr) {
+        auto &locks = bf.lf_format->lf_pattern_locks;
+
+        for (const auto &pfl : this->lf_format->lf_pattern_locks) {
+            locks.emplace_back(pfl.pfl_line + prefix_size, pfl.pfl_pat_index);
+        }
+        this->lf_format->lf_pattern_locks = std::move(locks);
+
+        auto &stats = this->lf_format->lf_value_stats;
+
+        for (size_t lpc = 0;
+             lpc < std::min(stats.size(), bf.lf_format->lf_value_stats.size());
+             lpc++) {
+            stats[lpc].merge(bf.lf_format->lf_value_stats[lpc]);
+        }
+
+        this->lf_format->prepend_opids(bf.lf_format->lf_opids, prefix_size);
+    }
+    bf.lf_index.append(this->lf_index.begin(), this->lf_index.end());
+    this->lf_index = std::move(bf.lf_index);
+    this->lf_level_summary_lines = 0;
+    if (this->lf_ngram_index != nullptr) {
+        // The line numbers have moved, the index is filled in again by
+        // reobserve_from() below.
+        this->lf_ngram_index->truncate(0);
+    }
+    this->lf_longest_line = std::max(this->lf_longest_line,
+                                     bf.lf_longest_line);
+    this->lf_text_format = bf.lf_text_format;
+    this->lf_content_id = bf.lf_content_id;
+    this->lf_tail_start = 0;
+    this->lf_backfill.reset();
+    this->lf_annotation_cache.clear();
+    this->lf_next_line_cache = nonstd::nullopt;
+    this->lf_line_buffer.clear();
+
+    this->reobserve_from(this->begin());
+
+    return RR_NEW_ORDER;
+}
+
+void logfile::abandon_tail_first()
+{
+    log_info("%s: indexing from the start instead of the tail",
+             this->lf_filename.c_str());
+    if (this->lf_logline_observer != nullptr) {
+        this->lf_logline_observer->logline_restart(*this,
+                                                   this->lf_index.size());
+    }
+    if (this->lf_format != nullptr) {
+        this->lf_format->clear();
+        this->set_format_base_time(this->lf_format.get());
+    }
+    this->lf_index.clear();
+    this->lf_level_summary_lines = 0;
+    if (this->lf_ngram_index != nullptr) {
+        this->lf_ngram_index->truncate(0);
+    }
+    this->lf_opids_missing = false;
+    this->lf_index_size = 0;
+    this->lf_tail_start = 0;
+    this->lf_backfill.reset();
+    this->lf_annotation_cache.clear();
+    this->lf_next_line_cache = nonstd::nullopt;
+    this->lf_line_buffer.clear();
+    this->lf_change_pending = true;
+    this->lf_indexing_incomplete = true;
+}
+
+logfile::rebuild_result_t logfile::apply_retention()
+{
+    int64_t max_lines = lnav_config.lc_tuning_retention_max_lines;
+    int64_t max_bytes = lnav_config.lc_tuning_retention_max_bytes;
+    int64_t max_age = lnav_config.lc_tuning_retention_max_age;
+
+    if ((max_lines == 0 && max_bytes == 0 && max_age == 0) ||
+        this->lf_tail_start > 0 ||
+        this->lf_backfill != nullptr ||
+        this->lf_index.size() < 2) {
+        return RR_NO_NEW_LINES;
+    }
+
+    size_t drop_count = 0;
+
+    if (max_lines > 0 && this->lf_index.size() > (size_t) max_lines) {
+        drop_count = this->lf_index.size() - max_lines;
+    }
+    if (max_bytes > 0 && this->lf_index_size > max_bytes) {
+        off_t keep_start = this->lf_index_size - max_bytes;
+
+        while (drop_count < this->lf_index.size() &&
+               this->lf_index[drop_count].get_offset() < keep_start) {
+            drop_count += 1;
+        }
+    }
+    if (max_age > 0 && this->lf_format != nullptr) {
+        uint64_t cutoff = (uint64_t) (time(nullptr) - max_age) * 1000ULL;
+
+        while (drop_count < this->lf_index.size() &&
+               this->lf_index[drop_count].get_time_in_millis() < cutoff) {
+            drop_count += 1;
+        }
+    }
+
+    // Dropping a few lines at a time would mean rebuilding the views for
+    // every new line, so wait until there is a good amount to drop.
+    if (drop_count == 0 || drop_count < this->lf_index.size() / 8) {
+        return RR_NO_NEW_LINES;
+    }
+
+    // Keep whole messages and at least the last one.
+    while (drop_count < this->lf_index.size() &&
+           (this->lf_index[drop_count].get_sub_offset() != 0 ||
+            this->lf_index[drop_count].is_continued())) {
+        drop_count += 1;
+    }
+    if (drop_count >= this->lf_index.size()) {
+        drop_count = this->lf_index.size() - 1;
+        while (drop_count > 0 &&
+               (this->lf_index[drop_count].get_sub_offset() != 0 ||
+                this->lf_index[drop_count].is_continued())) {
+            drop_count -= 1;
+        }
+        if (drop_count == 0) {
+            return RR_NO_NEW_LINES;
+        }
+    }
+
+    log_info("%s: dropping %d of %d lines to stay within the retention limits",
+             this->lf_filename.c_str(),
+             drop_count,
+             this->lf_index.size());
+    if (this->lf_logline_observer != nullptr) {
+        this->lf_logline_observer->logline_restart(*this,
+                                                   this->lf_index.size());
+    }
+    if (this->lf_format != nullptr) {
+        this->lf_format->drop_lines_before(drop_count);
+    }
+    // A new index is made so the memory for the dropped lines is freed.
+    chunked_vector<logline>(this->lf_index.begin() + drop_count,
+                            this->lf_index.end()).swap(this->lf_index);
+    this->lf_dropped_lines += drop_count;
+    this->lf_level_summary_lines = 0;
+    if (this->lf_ngram_index != nullptr) {
+        this->lf_ngram_index->truncate(0);
+    }
+    this->lf_annotation_cache.clear();
+    this->lf_next_line_cache = nonstd::nullopt;
+
+    this->reobserve_from(this->begin());
+
+    return RR_NEW_ORDER;
+}
+
 Result<shared_buffer_ref, std::string> logfile::read_line(logfile::iterator ll)
 {
     try {
         return this->lf_line_buffer.read_range(this->get_file_range(ll, false))
             .map([&ll, this](auto sbr) {
-                sbr.rtrim(is_line_ending);
+                if (!this->lf_line_buffer.is_length_prefixed()) {
+                    sbr.rtrim(is_line_ending);
+                }
                 if (!ll->is_valid_utf()) {
                     scrub_to_utf8(sbr.get_writable_data(), sbr.length());
                 }
@@ -480,6 +1503,104 @@ Result<shared_buffer_ref, std::string> logfile::read_line(logfile::iterator ll)
     }
 }
 
+Result<shared_buffer_ref, std::string> logfile::read_line_prefix(
+    logfile::iterator ll, size_t max_size)
+{
+    auto fr = this->get_file_range(ll, false);
+
+    if ((size_t) fr.fr_size <= max_size ||
+        (this->lf_format != nullptr && !this->lf_format->subline_is_raw())) {
+        return this->read_line(ll);
+    }
+
+    fr.fr_size = max_size;
+    try {
+        return this->lf_line_buffer.read_range(fr)
+            .map([&ll](auto sbr) {
+                if (!ll->is_valid_utf()) {
+                    scrub_to_utf8(sbr.get_writable_data(), sbr.length());
+                }
+
+                return sbr;
+            });
+    }
+    catch (line_buffer::error & e) {
+        return Err(string(strerror(e.e_err)));
+    }
+}
+
+size_t logfile::read_lines(logfile::iterator ll,
+                           size_t max_lines,
+                           string &chunk_out,
+                           vector<pair<size_t, size_t>> &spans_out)
+{
+    if ((this->lf_format != nullptr && !this->lf_format->subline_is_raw()) ||
+        this->lf_line_buffer.is_length_prefixed()) {
+        return 0;
+    }
+
+    size_t chunk_base = chunk_out.size();
+    size_t spans_base = spans_out.size();
+    off_t start_off = ll->get_offset();
+    off_t end_off = start_off;
+    size_t count = 0;
+
+    for (auto iter = ll;
+         count < max_lines && iter != this->end();
+         ++iter, count++) {
+        if (iter->get_sub_offset() != 0 || iter->get_offset() < end_off) {
+            break;
+        }
+
+        auto fr = this->get_file_range(iter, false);
+        off_t line_end = fr.fr_offset + fr.fr_size;
+
+        if (line_end - start_off > line_buffer::DEFAULT_LINE_BUFFER_SIZE) {
+            break;
+        }
+        spans_out.emplace_back(chunk_base + fr.fr_offset - start_off,
+                               chunk_base + line_end - start_off);
+        end_off = line_end;
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    try {
+        auto read_result = this->lf_line_buffer.read_range({
+            start_off, static_cast<ssize_t>(end_off - start_off)});
+
+        if (read_result.isErr()) {
+            spans_out.resize(spans_base);
+            return 0;
+        }
+
+        auto sbr = read_result.unwrap();
+
+        chunk_out.append(sbr.get_data(), sbr.length());
+    }
+    catch (line_buffer::error & e) {
+        spans_out.resize(spans_base);
+        return 0;
+    }
+
+    auto iter = ll;
+    for (size_t lpc = spans_base; lpc < spans_out.size(); lpc++, ++iter) {
+        auto &span = spans_out[lpc];
+
+        while (span.second > span.first &&
+               is_line_ending(chunk_out[span.second - 1])) {
+            span.second -= 1;
+        }
+        if (!iter->is_valid_utf()) {
+            scrub_to_utf8(&chunk_out[span.first], span.second - span.first);
+        }
+    }
+
+    return count;
+}
+
 void logfile::read_full_message(logfile::iterator ll,
                                 shared_buffer_ref &msg_out,
                                 int max_lines)
@@ -507,6 +1628,143 @@ void logfile::read_full_message(logfile::iterator ll,
     }
 }
 
+bool logfile::read_message_chunks(
+    logfile::iterator ll,
+    size_t max_chunk,
+    const std::function<bool(const shared_buffer_ref &)> &callback)
+{
+    require(ll->get_sub_offset() == 0);
+
+    if ((this->lf_format != nullptr && !this->lf_format->subline_is_raw()) ||
+        this->lf_line_buffer.is_length_prefixed()) {
+        return false;
+    }
+
+    off_t msg_end = ll->get_offset() + this->line_length(ll);
+    off_t chunk_start = ll->get_offset();
+    auto next_line = std::next(ll);
+
+    try {
+        while (chunk_start < msg_end) {
+            off_t last_boundary = chunk_start;
+            off_t chunk_end = msg_end;
+
+            for (; next_line != this->end() &&
+                   next_line->get_offset() < msg_end;
+                 ++next_line) {
+                off_t line_off = next_line->get_offset();
+
+                if (line_off == last_boundary) {
+                    continue;
+                }
+                if (line_off - chunk_start > (off_t) max_chunk &&
+                    last_boundary > chunk_start) {
+                    break;
+                }
+                last_boundary = line_off;
+            }
+            if (msg_end - chunk_start > (off_t) max_chunk &&
+                last_boundary > chunk_start) {
+                chunk_end = last_boundary;
+            }
+
+            auto read_result = this->lf_line_buffer.read_range({
+                chunk_start, static_cast<ssize_t>(chunk_end - chunk_start)});
+
+            if (read_result.isErr()) {
+                return false;
+            }
+            if (!callback(read_result.unwrap())) {
+                break;
+            }
+            chunk_start = chunk_end;
+        }
+    }
+    catch (line_buffer::error & e) {
+        return false;
+    }
+
+    return true;
+}
+
+void logfile::annotate_message(uint64_t line_number,
+                               shared_buffer_ref &msg,
+                               string_attrs_t &sa,
+                               std::vector<logline_value> &values)
+{
+    if (this->find_annotations(line_number, msg, sa, values)) {
+        return;
+    }
+
+    auto *format = this->lf_format.get();
+
+    if (format == nullptr) {
+        return;
+    }
+
+    format->annotate(line_number, msg, sa, values, false);
+
+    // The values for JSON formats come from the last message that was
+    // formatted instead of the given one, so they cannot be saved.
+    auto *elf = dynamic_cast<external_log_format *>(format);
+    if (elf != nullptr &&
+        elf->elf_type != external_log_format::ELF_TYPE_TEXT) {
+        return;
+    }
+
+    annotations anno;
+
+    anno.a_length = msg.length();
+    anno.a_attrs = sa;
+    anno.a_values = values;
+    for (auto &lv : anno.a_values) {
+        // Keep a private copy of the text so the entry does not hold onto
+        // the caller's buffer.
+        lv.lv_sbr.take_ownership();
+    }
+    this->lf_annotation_cache.insert(line_number, std::move(anno));
+}
+
+bool logfile::find_annotations(uint64_t line_number,
+                               const shared_buffer_ref &msg,
+                               string_attrs_t &sa,
+                               std::vector<logline_value> &values)
+{
+    auto *anno = this->lf_annotation_cache.find(line_number);
+
+    if (anno == nullptr || anno->a_length != msg.length()) {
+        return false;
+    }
+
+    sa.insert(sa.end(), anno->a_attrs.begin(), anno->a_attrs.end());
+    values = anno->a_values;
+
+    return true;
+}
+
+bool logfile::message_may_contain(const_iterator ll,
+                                  const std::string &literal) const
+{
+    // The lines are checked one at a time, so a literal that spans lines
+    // cannot be ruled out.
+    if (this->lf_ngram_index == nullptr ||
+        literal.find('\n') != std::string::npos) {
+        return true;
+    }
+
+    size_t line_number = std::distance(this->begin(), ll);
+
+    do {
+        if (this->line_may_contain(line_number, literal)) {
+            return true;
+        }
+        line_number += 1;
+    } while (line_number < this->lf_index.size() &&
+             this->lf_index[line_number].is_continued());
+
+    return false;
+}
+
 void logfile::set_logline_observer(logline_observer *llo)
 {
     this->lf_logline_observer = llo;
@@ -526,7 +1784,16 @@ void logfile::reobserve_from(iterator iter)
                         *this, offset, this->size());
             }
 
-            this->read_line(iter).then([this, iter](auto sbr) {
+            if (this->lf_logline_observer->logline_skip_line(*this, iter)) {
+                continue;
+            }
+
+            this->read_line(iter).then([this, iter, offset](auto sbr) {
+                if (this->lf_ngram_index != nullptr &&
+                    (size_t) offset >= this->lf_ngram_index->get_line_count()) {
+                    this->lf_ngram_index->add_line(
+                        offset, sbr.get_data(), sbr.length());
+                }
                 this->lf_logline_observer->logline_new_line(*this, iter, sbr);
             });
         }
@@ -561,14 +1828,17 @@ size_t logfile::line_length(logfile::iterator ll, bool include_continues)
              ((ll->get_offset() == next_line->get_offset()) ||
               (include_continues && next_line->is_continued())));
 
+    // Records do not end with a delimiter that needs to be left off.
+    size_t delim_size = this->lf_line_buffer.is_length_prefixed() ? 0 : 1;
+
     if (next_line == this->end()) {
         retval = this->lf_index_size - ll->get_offset();
         if (retval > 0 && !this->lf_partial_line) {
-            retval -= 1;
+            retval -= delim_size;
         }
     }
     else {
-        retval = next_line->get_offset() - ll->get_offset() - 1;
+        retval = next_line->get_offset() - ll->get_offset() - delim_size;
         if (!include_continues) {
             this->lf_next_line_cache = nonstd::make_optional(
                 std::make_pair(ll->get_offset(), retval));
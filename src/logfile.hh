@@ -42,9 +42,14 @@
 
 #include <string>
 #include <vector>
+#include <chrono>
+#include <memory>
+#include <functional>
 #include <algorithm>
 
 #include "base/lnav_log.hh"
+#include "base/lru_cache.hh"
+#include "base/perf_counter.hh"
 #include "base/result.h"
 #include "byte_array.hh"
 #include "line_buffer.hh"
@@ -52,6 +57,7 @@
 #include "unique_path.hh"
 #include "text_format.hh"
 #include "shared_buffer.hh"
+#include "ngram_index.hh"
 #include "filesystem/path.h"
 
 class logfile;
@@ -70,8 +76,10 @@ public:
      * @param lf The logfile object that is doing the indexing.
      * @param off The current offset in the file being processed.
      * @param total The total size of the file.
+     * @return False if the indexing should stop after the current batch of
+     *   lines.  The next call to rebuild_index() picks up where it left off.
      */
-    virtual void logfile_indexing(logfile &lf, off_t off, size_t total) = 0;
+    virtual bool logfile_indexing(logfile &lf, off_t off, size_t total) = 0;
 };
 
 struct logfile_open_options {
@@ -90,18 +98,85 @@ struct logfile_open_options {
         return *this;
     };
 
+    logfile_open_options &with_sequential_access(bool val) {
+        this->loo_sequential_access = val;
+
+        return *this;
+    };
+
+    logfile_open_options &with_pipe_source(std::shared_ptr<pipe_source> ps) {
+        this->loo_pipe_source = std::move(ps);
+
+        return *this;
+    };
+
+    logfile_open_options &with_range_source(std::shared_ptr<range_source> rs) {
+        this->loo_range_source = std::move(rs);
+
+        return *this;
+    };
+
+    /**
+     * Read a member of the archive in loo_fd instead of the whole file, see
+     * line_buffer::set_member_range().
+     */
+    logfile_open_options &with_archive_member(
+        file_range fr,
+        time_t mtime,
+        std::vector<line_buffer::gz_indexed::indexDict> syncpoints) {
+        this->loo_is_member = true;
+        this->loo_member_range = fr;
+        this->loo_member_mtime = mtime;
+        this->loo_syncpoints = std::move(syncpoints);
+
+        return *this;
+    };
+
     auto_fd loo_fd;
     bool loo_detect_format;
+    /** A pipe whose data is appended to loo_fd as the file is indexed. */
+    std::shared_ptr<pipe_source> loo_pipe_source;
+    /** Fetches the parts of loo_fd as they are read. */
+    std::shared_ptr<range_source> loo_range_source;
+    /** The file will be read once from front to back. */
+    bool loo_sequential_access{false};
+    /** The file is a member of the archive in loo_fd. */
+    bool loo_is_member{false};
+    file_range loo_member_range;
+    time_t loo_member_mtime{0};
+    /** Handed to the line_buffer when the file is opened. */
+    std::vector<line_buffer::gz_indexed::indexDict> loo_syncpoints;
 };
 
 struct logfile_activity {
     logfile_activity() {
-        memset(this, 0, sizeof(*this));
+        memset(&this->la_initial_index_rusage, 0,
+               sizeof(this->la_initial_index_rusage));
     };
 
-    int64_t la_polls;
-    int64_t la_reads;
+    /**
+     * @return The counter for the given stage of indexing this file or
+     * nullptr if the stage is not tracked per-file.
+     */
+    const perf_counter *get_perf_counter(perf_stage_t stage) const {
+        switch (stage) {
+            case perf_stage_t::READ:
+                return &this->la_read_perf;
+            case perf_stage_t::SCAN:
+                return &this->la_scan_perf;
+            case perf_stage_t::FILTER:
+                return &this->la_filter_perf;
+            default:
+                return nullptr;
+        }
+    };
+
+    int64_t la_polls{0};
+    int64_t la_reads{0};
     struct rusage la_initial_index_rusage;
+    perf_counter la_read_perf;
+    perf_counter la_scan_perf;
+    perf_counter la_filter_perf;
 };
 
 /**
@@ -120,8 +195,8 @@ public:
         int         e_err;
     };
 
-    typedef std::vector<logline>::iterator       iterator;
-    typedef std::vector<logline>::const_iterator const_iterator;
+    typedef chunked_vector<logline>::iterator       iterator;
+    typedef chunked_vector<logline>::const_iterator const_iterator;
 
     /**
      * Construct a logfile with the given arguments.
@@ -168,6 +243,70 @@ public:
         return this->lf_line_buffer.is_compressed();
     };
 
+    /** @return The number of bytes of the file, uncompressed, that have been indexed. */
+    off_t get_index_size() const {
+        return this->lf_index_size;
+    };
+
+    /**
+     * @return The number of bytes of the file on disk that have been read
+     * to build the index.
+     */
+    off_t get_index_read_size() const {
+        return this->lf_line_buffer.get_read_offset(this->lf_index_size);
+    };
+
+    /** @return The number of bytes used by the line index. */
+    size_t get_index_memory() const {
+        return this->lf_index.get_memory_usage() +
+               this->lf_level_blocks.capacity() * sizeof(level_block);
+    };
+
+    /** @return The number of bytes used by the search index, if enabled. */
+    size_t get_search_index_memory() const {
+        if (this->lf_ngram_index == nullptr) {
+            return 0;
+        }
+        return this->lf_ngram_index->get_memory_usage();
+    };
+
+    /**
+     * Check the search index to see if a line might contain a literal.
+     * Lines that have not been added to the index and the lines of formats
+     * that rewrite their messages are assumed to match.
+     *
+     * @param line_number The index of the line in the file.
+     * @param literal The string to look for.
+     * @return False if the line cannot contain the literal.
+     */
+    bool line_may_contain(size_t line_number,
+                          const std::string &literal) const {
+        if (this->lf_ngram_index == nullptr ||
+            (this->lf_format != nullptr &&
+             !this->lf_format->subline_is_raw())) {
+            return true;
+        }
+
+        return this->lf_ngram_index->may_contain(
+            this->lf_ngram_index->query_for(literal), line_number);
+    };
+
+    /**
+     * Check the search index to see if any line in a message might contain
+     * a literal.
+     *
+     * @param ll The first line of the message.
+     * @param literal The string to look for.
+     * @return False if the message cannot contain the literal.
+     */
+    bool message_may_contain(const_iterator ll,
+                             const std::string &literal) const;
+
+    /** @return The number of bytes used to index a gzipped file. */
+    size_t get_syncpoint_memory() const {
+        return this->lf_line_buffer.get_syncpoint_memory();
+    };
+
     bool is_valid_filename() const {
         return this->lf_valid_filename;
     };
@@ -178,6 +317,12 @@ public:
      */
     log_format *get_format() const { return this->lf_format.get(); };
 
+    /**
+     * @return True if the operation IDs found in the file are in the format's
+     *   opid index, which is not the case when loaded from the index cache.
+     */
+    bool has_opid_index() const { return !this->lf_opids_missing; };
+
     text_format_t get_text_format() const {
         return this->lf_text_format;
     }
@@ -196,6 +341,14 @@ public:
         return this->lf_time_offset;
     };
 
+    /**
+     * Shift the times of all the lines in the file.
+     *
+     * @param line The line the offset was applied at, for the session.
+     * @param tv The offset or the change to the offset.
+     * @param abs_offset True if tv is the new offset, false if it should be
+     *   added to the current offset.
+     */
     void adjust_content_time(int line,
                              const struct timeval &tv,
                              bool abs_offset=true) {
@@ -208,15 +361,40 @@ public:
         else {
             timeradd(&old_time, &tv, &this->lf_time_offset);
         }
-        for (auto &iter : *this) {
-            struct timeval curr, diff, new_time;
 
-            curr = iter.get_timeval();
-            timersub(&curr, &old_time, &diff);
-            timeradd(&diff, &this->lf_time_offset, &new_time);
-            iter.set_time(new_time);
+        int64_t delta_millis =
+            ((int64_t) this->lf_time_offset.tv_sec - old_time.tv_sec) * 1000LL +
+            ((int64_t) this->lf_time_offset.tv_usec - old_time.tv_usec) / 1000LL;
+
+        if (delta_millis == 0) {
+            // Restoring a session or updating another column of the file
+            // table sets the same offset again, nothing needs to move.
+            return;
+        }
+
+        // Every line moves by the same amount, so the order of the lines in
+        // the file does not change and only the merged index needs to be
+        // rebuilt.
+        for (auto &ll : *this) {
+            shift_line_time(ll, delta_millis);
         }
         this->lf_sort_needed = true;
+        // The times in the summary have changed too.
+        this->lf_level_summary_lines = 0;
+        this->update_level_summary();
+    };
+
+    /**
+     * Move the time of a line by the given number of milliseconds.  The
+     * result is rounded down so that times before the epoch keep a
+     * millisecond part between 0 and 999.
+     */
+    static void shift_line_time(logline &ll, int64_t delta_millis) {
+        int64_t millis = (int64_t) ll.get_time_in_millis() + delta_millis;
+        int64_t sec = millis / 1000LL - (millis % 1000LL < 0 ? 1 : 0);
+
+        ll.set_time((time_t) sec);
+        ll.set_millis((uint16_t) (millis - sec * 1000LL));
     };
 
     void clear_time_offset() {
@@ -247,9 +425,76 @@ public:
         return this->lf_index.back();
     };
 
+    /** The number of lines covered by each level_block. */
+    static const size_t LEVEL_BLOCK_SIZE = 1024;
+
+    /**
+     * A summary of the levels and times of the messages in a block of lines,
+     * so that levels can be counted and whole blocks can be filtered without
+     * looking at each logline.  Continuation lines are in the mask and time
+     * range, but not the counts.
+     */
+    struct level_block {
+        /** Bit N is set if a message in the block has level N. */
+        uint32_t lb_mask{0};
+        uint32_t lb_counts[LEVEL__MAX]{};
+        /** The range of times, in milliseconds, of the lines in the block. */
+        uint64_t lb_min_time{UINT64_MAX};
+        uint64_t lb_max_time{0};
+    };
+
+    static uint32_t level_mask(log_level_t level) {
+        return 1U << level;
+    };
+
+    /** @return A mask with the bits set for the given level and above. */
+    static uint32_t level_mask_at_least(log_level_t level) {
+        return ~(level_mask(level) - 1U) & (level_mask(LEVEL__MAX) - 1U);
+    };
+
+    /** @return The number of messages in the file with the given level. */
+    size_t get_level_count(log_level_t level) const {
+        return this->lf_level_counts[level];
+    };
+
+    /**
+     * @param line_number A line in the file.
+     * @param mask The levels to check for, see level_mask().
+     * @return True if the block holding the line has a message with one of
+     *   the levels in the mask.
+     */
+    bool block_has_levels(size_t line_number, uint32_t mask) const {
+        const level_block *lb = this->get_level_block(line_number);
+
+        if (lb == nullptr) {
+            // Not summarized yet, so the line has to be checked.
+            return true;
+        }
+
+        return (lb->lb_mask & mask) != 0;
+    };
+
+    /**
+     * @param line_number A line in the file.
+     * @return The summary of the block holding the line or nullptr if the
+     *   line has not been summarized yet.
+     */
+    const level_block *get_level_block(size_t line_number) const {
+        if (line_number >= this->lf_level_summary_lines) {
+            return nullptr;
+        }
+
+        return &this->lf_level_blocks[line_number / LEVEL_BLOCK_SIZE];
+    };
+
     /** @return True if this log file still exists. */
     bool exists() const;
 
+    /** @return True if this is a member of an archive file. */
+    bool is_archive_member() const {
+        return this->lf_options.loo_is_member;
+    };
+
     void close() {
         this->lf_is_closed = true;
     };
@@ -258,6 +503,32 @@ public:
         return this->lf_is_closed;
     };
 
+    /**
+     * The number of seconds between checks of a watched file that has not
+     * reported any changes, in case the notifications are not delivered
+     * for the file system it is on.
+     */
+    static const time_t WATCHED_POLL_INTERVAL = 30;
+
+    /**
+     * Record that change notifications are delivered for this file, so
+     * rebuild_index() only needs to check it after set_change_pending().
+     *
+     * @param wd The watch descriptor from the file_watcher or -1.
+     */
+    void set_watch_descriptor(int wd) {
+        this->lf_watch_descriptor = wd;
+        this->lf_change_pending = true;
+    };
+
+    int get_watch_descriptor() const {
+        return this->lf_watch_descriptor;
+    };
+
+    void set_change_pending() {
+        this->lf_change_pending = true;
+    };
+
     struct timeval original_line_time(iterator ll) {
         if (this->is_time_adjusted()) {
             struct timeval line_time = ll->get_timeval();
@@ -272,6 +543,36 @@ public:
 
     Result<shared_buffer_ref, std::string> read_line(iterator ll);
 
+    /**
+     * Read the start of a line, for when only the part of a long line that
+     * fits on the screen is needed.  Lines that are rewritten by the
+     * format are always read in full.
+     *
+     * @param ll The line to read.
+     * @param max_size The maximum number of bytes to read.
+     */
+    Result<shared_buffer_ref, std::string> read_line_prefix(iterator ll,
+                                                            size_t max_size);
+
+    /**
+     * Read the raw values of a run of consecutive lines with a single read
+     * of the underlying file.  The values are the same as what read_line()
+     * would return.
+     *
+     * @param ll The first line to read.
+     * @param max_lines The maximum number of lines to read.
+     * @param chunk_out The line values are appended to this buffer.
+     * @param spans_out The offsets of each value in chunk_out are appended
+     *   to this vector.
+     * @return The number of lines read, zero if the format rewrites lines,
+     *   the file is made up of records, or the lines could not be read at
+     *   once.
+     */
+    size_t read_lines(iterator ll,
+                      size_t max_lines,
+                      std::string &chunk_out,
+                      std::vector<std::pair<size_t, size_t>> &spans_out);
+
     iterator line_base(iterator ll) {
         iterator retval = ll;
 
@@ -302,6 +603,69 @@ public:
 
     void read_full_message(iterator ll, shared_buffer_ref &msg_out, int max_lines=50);
 
+    /**
+     * Start loading the given lines in the background because they are
+     * about to be read.
+     */
+    void prefetch_lines(iterator first, iterator last) {
+        if (first >= last) {
+            return;
+        }
+
+        auto start = first->get_offset();
+        auto end = this->get_file_range(last - 1, false).next_offset();
+
+        this->lf_line_buffer.prefetch_range({start, (ssize_t) (end - start)});
+    };
+
+    /**
+     * Read a complete message in pieces so that the line buffer does not
+     * have to hold all of a message with many continuation lines at once.
+     * The pieces cover whole lines and, when joined, are the same as what
+     * read_full_message() would return.
+     *
+     * @param ll The first line of the message.
+     * @param max_chunk The preferred maximum size of a piece.  A single line
+     *   that is longer than this is passed as its own piece.
+     * @param callback Called with each piece, return false to stop reading.
+     * @return False if the format rewrites lines or the file is made up of
+     *   records, in which case the caller needs to use read_full_message(),
+     *   or the file could not be read.
+     */
+    bool read_message_chunks(
+        iterator ll,
+        size_t max_chunk,
+        const std::function<bool(const shared_buffer_ref &)> &callback);
+
+    /**
+     * Annotate a complete message that was read with read_full_message().
+     * The results for recently annotated messages are kept so that the
+     * views and SQL tables looking at the same line do not need to run the
+     * format's patterns over it again.
+     *
+     * @param line_number The index of the first line of the message.
+     * @param msg The contents of the full message.
+     * @param sa The string attributes found in the message.
+     * @param values The values extracted from the message.
+     */
+    void annotate_message(uint64_t line_number,
+                          shared_buffer_ref &msg,
+                          string_attrs_t &sa,
+                          std::vector<logline_value> &values);
+
+    /**
+     * Copy out the annotations for a message that were saved by an earlier
+     * call to annotate_message(), without annotating it on a cache miss.
+     * Entries saved for a message of a different length are ignored since
+     * the line was read differently, with or without the line ending.
+     *
+     * @return True if the annotations were in the cache.
+     */
+    bool find_annotations(uint64_t line_number,
+                          const shared_buffer_ref &msg,
+                          string_attrs_t &sa,
+                          std::vector<logline_value> &values);
+
     enum rebuild_result_t {
         RR_INVALID,
         RR_NO_NEW_LINES,
@@ -309,14 +673,25 @@ public:
         RR_NEW_ORDER,
     };
 
+    using deadline_t = nonstd::optional<std::chrono::steady_clock::time_point>;
+
     /**
      * Index any new data in the log file.
      *
-     * @param lo The observer object that will be called regularly during
-     * indexing.
+     * @param deadline If given, stop indexing after the first batch of lines
+     * that finishes past this time.  The next call resumes from there and
+     * is_indexing_incomplete() reports whether there is more to do.
      * @return True if any new lines were indexed.
      */
-    rebuild_result_t rebuild_index();
+    rebuild_result_t rebuild_index(deadline_t deadline = nonstd::nullopt);
+
+    /**
+     * @return True if the last call to rebuild_index() stopped before
+     * reaching the end of the file.
+     */
+    bool is_indexing_incomplete() const {
+        return this->lf_indexing_incomplete;
+    };
 
     void reobserve_from(iterator iter);
 
@@ -324,6 +699,17 @@ public:
         this->lf_logfile_observer = lo;
     };
 
+    logfile_observer *get_logfile_observer() const {
+        return this->lf_logfile_observer;
+    };
+
+    /**
+     * @return True if there is data in the file that has not been indexed
+     * yet.  This does an fstat() on the file, so it is cheaper than a call
+     * to rebuild_index() that would not find anything new.
+     */
+    bool has_unindexed_data();
+
     void set_logline_observer(logline_observer *llo);
 
     logline_observer *get_logline_observer() const {
@@ -357,6 +743,16 @@ public:
 
     filesystem::path get_path() const override;
 
+    /**
+     * @param key A string that identifies what was matched, like the
+     *   pattern of a filter.
+     * @return The path to the file in the index cache directory that holds
+     *   the lines that matched, or nothing if the file does not match its
+     *   saved index, since only an unchanged file can reuse the matches.
+     */
+    nonstd::optional<filesystem::path> get_match_cache_path(
+        const std::string &key) const;
+
 protected:
 
     /**
@@ -368,8 +764,94 @@ protected:
      */
     bool process_prefix(shared_buffer_ref &sbr, const line_info &li);
 
+    /**
+     * Add a line to the index that continues the message of the line before
+     * it.
+     */
+    void add_continued_line(const line_info &li);
+
+    /**
+     * @param off The offset just past the last line in the index.
+     * @return True if the last line in the index is the first part of a line
+     *   that was too long and the rest of it starts at the given offset.
+     */
+    bool is_split_before(off_t off);
+
     void set_format_base_time(log_format *lf);
 
+    /**
+     * @return The path to the file in the index cache directory that holds
+     *   the saved index for this file.
+     */
+    filesystem::path get_index_cache_path() const;
+
+    /**
+     * Try to restore the line index from the index cache.  The cache is only
+     * used if the fingerprint of the file (device, inode, size, and a hash
+     * of the head and tail of the indexed data) still matches.
+     *
+     * @param st The current stat of the file.
+     * @return True if the index was restored.
+     */
+    bool load_index_cache(const struct stat &st);
+
+    /**
+     * Write the line index out to the index cache so that the next time
+     * this file is opened, only the data appended since needs to be scanned.
+     */
+    void save_index_cache();
+
+    /**
+     * Write the lines of the index to the cache, without the marks and
+     * with the time offset taken back out.
+     *
+     * @return True if all of the lines were written.
+     */
+    bool write_cached_lines(int fd) const;
+
+    /**
+     * Decide whether to index the end of a new file before the rest of it.
+     * If so, indexing starts at the first line in the last part of the file
+     * and a back-fill of the earlier data is done once it reaches the end.
+     *
+     * @param st The current stat of the file.
+     */
+    void start_tail_first(const struct stat &st);
+
+    /**
+     * Index more of the data before the tail of a tail-first file and, once
+     * it is all indexed, put those lines in front of the tail's lines.
+     *
+     * @param deadline The time to stop indexing.
+     * @return RR_NEW_ORDER if the index was put together.
+     */
+    rebuild_result_t rebuild_backfill(deadline_t deadline);
+
+    /**
+     * Drop the tail-first index and index the file from the start instead.
+     */
+    void abandon_tail_first();
+
+    /**
+     * Drop the oldest lines from the index when the file has grown past the
+     * limits in "/tuning/retention".
+     *
+     * @return RR_NEW_ORDER if lines were dropped.
+     */
+    rebuild_result_t apply_retention();
+
+    /**
+     * Bring lf_level_blocks and lf_level_counts up-to-date with the lines
+     * that were indexed since the last call.
+     */
+    void update_level_summary();
+
+    /**
+     * Change the result of an fstat() of the archive holding this file to
+     * describe the member instead, so it looks like a file of its own.
+     */
+    void adjust_member_stat(struct stat &st) const;
+
     logfile_open_options lf_options;
     logfile_activity lf_activity;
     bool        lf_valid_filename;
@@ -378,7 +860,11 @@ protected:
     std::string lf_content_id;
     struct stat lf_stat;
     std::unique_ptr<log_format> lf_format;
-    std::vector<logline>      lf_index;
+    chunked_vector<logline>   lf_index;
+    std::vector<level_block>  lf_level_blocks;
+    size_t lf_level_counts[LEVEL__MAX]{};
+    /** The number of lines in lf_index covered by lf_level_blocks. */
+    size_t lf_level_summary_lines{0};
     time_t      lf_index_time{0};
     off_t       lf_index_size{0};
     bool lf_sort_needed{false};
@@ -392,8 +878,39 @@ protected:
     size_t lf_longest_line{0};
     text_format_t lf_text_format{text_format_t::TF_UNKNOWN};
     uint32_t lf_out_of_time_order_count{0};
+    bool lf_index_cache_checked{false};
+    int lf_watch_descriptor{-1};
+    bool lf_change_pending{true};
+    bool lf_indexing_incomplete{false};
+    bool lf_tail_first_checked{false};
+    /** Offset of the first indexed line while the tail is indexed first. */
+    off_t lf_tail_start{0};
+    /** The offset to stop indexing at, used for the back-fill. */
+    off_t lf_index_limit{-1};
+    /** Indexes the data before lf_tail_start. */
+    std::unique_ptr<logfile> lf_backfill;
+    /** The number of lines dropped from the front by apply_retention(). */
+    size_t lf_dropped_lines{0};
+    /** The trigrams in each block of lines, if /tuning/index/search-index is set. */
+    std::unique_ptr<ngram_index> lf_ngram_index;
+    time_t lf_last_poll_time{0};
+    size_t lf_index_cache_lines{0};
+    /** True once the index was saved after the file was first read. */
+    bool lf_index_cache_published{false};
+    /** True if the lines were loaded from the index cache without opids. */
+    bool lf_opids_missing{false};
+    size_t lf_index_cache_search_lines{0};
 
     nonstd::optional<std::pair<off_t, size_t>> lf_next_line_cache;
+
+    struct annotations {
+        size_t a_length;
+        string_attrs_t a_attrs;
+        std::vector<logline_value> a_values;
+    };
+
+    /** The annotations of recently viewed messages, by line index. */
+    lru_cache<uint64_t, annotations> lf_annotation_cache{256};
 };
 
 class logline_observer {
@@ -404,6 +921,17 @@ public:
 
     virtual void logline_new_line(const logfile &lf, logfile::const_iterator ll, shared_buffer_ref &sbr) = 0;
 
+    /**
+     * Called before a line is read again by logfile::reobserve_from() to
+     * give the observer a chance to handle it without its contents.
+     *
+     * @return True if the line was handled and logline_new_line() does not
+     *   need to be called.
+     */
+    virtual bool logline_skip_line(const logfile &lf, logfile::const_iterator ll) {
+        return false;
+    };
+
     virtual void logline_eof(const logfile &lf) = 0;
 };
 
@@ -30,9 +30,14 @@
 #include "config.h"
 
 #include <future>
+#include <atomic>
+#include <mutex>
 #include <algorithm>
+#include <functional>
+#include <condition_variable>
 #include <sqlite3.h>
 
+#include "base/perf_counter.hh"
 #include "k_merge_tree.h"
 #include "lnav_util.hh"
 #include "log_accel.hh"
@@ -41,6 +46,7 @@
 #include "command_executor.hh"
 #include "ansi_scrubber.hh"
 #include "lnav_config.hh"
+#include "task_pool.hh"
 
 using namespace std;
 
@@ -131,11 +137,9 @@ shared_ptr<logfile> logfile_sub_source::find(const char *fn,
             continue;
         }
         if (strcmp(ld.get_file()->get_filename().c_str(), fn) == 0) {
+            line_base = this->get_content_line(&ld, 0);
             retval = ld.get_file();
         }
-        else {
-            line_base += content_line_t(MAX_LINES_PER_FILE);
-        }
     }
 
     return retval;
@@ -143,20 +147,79 @@ shared_ptr<logfile> logfile_sub_source::find(const char *fn,
 
 vis_line_t logfile_sub_source::find_from_time(const struct timeval &start)
 {
-    vector<uint32_t>::iterator lb;
     vis_line_t retval(-1);
-
-    lb = lower_bound(this->lss_filtered_index.begin(),
-                     this->lss_filtered_index.end(),
-                     start,
-                     filtered_logline_cmp(*this));
+    auto range = this->find_index_partition(
+        (uint64_t) start.tv_sec * 1000ULL + start.tv_usec / 1000);
+    // Only the visible lines in the partition need to be searched, if they
+    // are all before the time, the answer is the first visible line of the
+    // partitions that follow.
+    auto filtered_begin = this->lss_filtered_index.begin();
+    auto lb = lower_bound(
+        filtered_begin + this->lss_filtered_index.rank(range.first),
+        filtered_begin + this->lss_filtered_index.rank(range.second),
+        start,
+        filtered_logline_cmp(*this));
     if (lb != this->lss_filtered_index.end()) {
-        retval = vis_line_t(lb - this->lss_filtered_index.begin());
+        retval = vis_line_t(lb - filtered_begin);
     }
 
     return retval;
 }
 
+shared_ptr<const logfile_sub_source::snapshot_t>
+logfile_sub_source::get_index_snapshot()
+{
+    size_t size = this->lss_filtered_index.size();
+
+    if (this->lss_snapshot != nullptr &&
+        this->lss_snapshot_stable == size &&
+        this->lss_snapshot->size() == size) {
+        return this->lss_snapshot;
+    }
+
+    size_t version = this->lss_snapshot == nullptr ?
+                     1 : this->lss_snapshot->get_version() + 1;
+
+    rank_select_bitmap::select_hint hint;
+
+    // The lines are copied in order, so the hint keeps each select() from
+    // having to search the whole bitmap again.
+    this->lss_snapshot = snapshot_t::create(
+        this->lss_snapshot.get(),
+        this->lss_snapshot_stable,
+        size,
+        version,
+        [this, &hint](size_t vl) {
+            return (content_line_t) this->lss_index[
+                this->lss_filtered_index.select(vl, hint)];
+        });
+    this->lss_snapshot_stable = size;
+
+    return this->lss_snapshot;
+}
+
+pair<size_t, size_t> logfile_sub_source::find_index_partition(
+    uint64_t millis) const
+{
+    uint64_t partition = millis / INDEX_PARTITION_MILLIS;
+    auto iter = upper_bound(
+        this->lss_index_partitions.begin(),
+        this->lss_index_partitions.end(),
+        partition,
+        [](uint64_t lhs, const pair<uint64_t, size_t> &rhs) {
+            return lhs < rhs.first;
+        });
+    size_t end = iter == this->lss_index_partitions.end() ?
+                 this->lss_index.size() : iter->second;
+
+    if (iter != this->lss_index_partitions.begin() &&
+        (iter - 1)->first == partition) {
+        return make_pair((iter - 1)->second, end);
+    }
+
+    return make_pair(end, end);
+}
+
 void logfile_sub_source::text_value_for_line(textview_curses &tc,
                                              int row,
                                              string &value_out,
@@ -185,32 +248,76 @@ void logfile_sub_source::text_value_for_line(textview_curses &tc,
     this->lss_token_values.clear();
     this->lss_share_manager.invalidate_refs();
     if (flags & text_sub_source::RF_FULL) {
-        shared_buffer_ref sbr;
+        this->lss_token_value.clear();
+        if (!this->lss_token_file->read_message_chunks(
+            this->lss_token_line, line_buffer::DEFAULT_LINE_BUFFER_SIZE,
+            [this](const shared_buffer_ref &sbr) {
+                this->lss_token_value.append(sbr.get_data(), sbr.length());
+                return true;
+            })) {
+            shared_buffer_ref sbr;
 
-        this->lss_token_file->read_full_message(this->lss_token_line, sbr);
-        this->lss_token_value = to_string(sbr);
+            this->lss_token_file->read_full_message(this->lss_token_line,
+                                                    sbr);
+            this->lss_token_value.assign(sbr.get_data(), sbr.length());
+        }
+    } else if (flags == 0) {
+        // Only the part of the line up to the right edge of the view is
+        // needed to draw it.  There is room for multi-byte characters and
+        // escape sequences, so this only cuts off the rest of long lines.
+        size_t max_size = 4 * (tc.get_left() + tc.get_width()) +
+                          MIN_ROW_READ_SIZE;
+
+        this->lss_token_value.clear();
+        this->lss_token_file->read_line_prefix(this->lss_token_line, max_size)
+            .then([this](auto sbr) {
+                this->lss_token_value.assign(sbr.get_data(), sbr.length());
+            });
     } else {
-        this->lss_token_value =
-            this->lss_token_file->read_line(this->lss_token_line).map([](auto sbr) {
-                return to_string(sbr);
-            }).unwrapOr({});
+        // Assign into the existing string to reuse its buffer.
+        this->lss_token_value.clear();
+        this->lss_token_file->read_line(this->lss_token_line).then(
+            [this](auto sbr) {
+                this->lss_token_value.assign(sbr.get_data(), sbr.length());
+            });
     }
     this->lss_token_shift_start = 0;
     this->lss_token_shift_size = 0;
 
     log_format *format = this->lss_token_file->get_format();
 
-    value_out = this->lss_token_value;
+    // The line is only copied out of lss_token_value when it needs to be
+    // changed.  The decorations that go in front of it are put together
+    // separately and everything is copied into value_out once at the end,
+    // instead of inserting each decoration at the front of the line.
+    const string *line_text = &this->lss_token_value;
+    auto edit_line = [this, &line_text]() -> string & {
+        if (line_text != &this->lss_row_text) {
+            this->lss_row_text = this->lss_token_value;
+            line_text = &this->lss_row_text;
+        }
+        return this->lss_row_text;
+    };
+
     if (this->lss_flags & F_SCRUB) {
-        format->scrub(value_out);
+        format->scrub(edit_line());
     }
 
     shared_buffer_ref sbr;
 
     sbr.share(this->lss_share_manager,
               (char *)this->lss_token_value.c_str(), this->lss_token_value.size());
-    format->annotate(line, sbr, this->lss_token_attrs, this->lss_token_values,
-                     false);
+    auto next_line = std::next(this->lss_token_line);
+    if ((flags & text_sub_source::RF_FULL) ||
+        next_line == this->lss_token_file->end() ||
+        !next_line->is_continued()) {
+        this->lss_token_file->annotate_message(line, sbr,
+                                               this->lss_token_attrs,
+                                               this->lss_token_values);
+    } else {
+        format->annotate(line, sbr, this->lss_token_attrs,
+                         this->lss_token_values, false);
+    }
     if (this->lss_token_line->get_sub_offset() != 0) {
         this->lss_token_attrs.clear();
     }
@@ -223,7 +330,7 @@ void logfile_sub_source::text_value_for_line(textview_curses &tc,
         add_global_vars(ec);
         format->rewrite(ec, sbr, this->lss_token_attrs, rewritten_line);
         this->lss_token_value.assign(rewritten_line);
-        value_out = this->lss_token_value;
+        line_text = &this->lss_token_value;
     }
 
     if ((this->lss_token_file->is_time_adjusted() ||
@@ -234,9 +341,10 @@ void logfile_sub_source::text_value_for_line(textview_curses &tc,
         if (time_attr != this->lss_token_attrs.end()) {
             const struct line_range time_range = time_attr->sa_range;
             struct timeval adjusted_time;
+            static const ftime_program MACHINE_TIME_PROGRAM(
+                "%Y-%m-%d %H:%M:%S.%f");
             struct exttm adjusted_tm;
             char buffer[128];
-            const char *fmt;
             ssize_t len;
 
             if (format->lf_timestamp_flags & ETF_MACHINE_ORIENTED) {
@@ -245,59 +353,39 @@ void logfile_sub_source::text_value_for_line(textview_curses &tc,
                     time_range.length(),
                     format->get_timestamp_formats(),
                     adjusted_time);
-                fmt = "%Y-%m-%d %H:%M:%S.%f";
-                gmtime_r(&adjusted_time.tv_sec, &adjusted_tm.et_tm);
+                secs2tm(&adjusted_time.tv_sec, &adjusted_tm.et_tm);
                 adjusted_tm.et_nsec = adjusted_time.tv_usec * 1000;
-                len = ftime_fmt(buffer, sizeof(buffer), fmt, adjusted_tm);
+                len = MACHINE_TIME_PROGRAM.format(buffer, sizeof(buffer),
+                                                  adjusted_tm);
             } else {
                 adjusted_time = this->lss_token_line->get_timeval();
-                gmtime_r(&adjusted_time.tv_sec, &adjusted_tm.et_tm);
+                secs2tm(&adjusted_time.tv_sec, &adjusted_tm.et_tm);
                 adjusted_tm.et_nsec = adjusted_time.tv_usec * 1000;
                 len = format->lf_date_time.ftime(buffer, sizeof(buffer),
                                                  adjusted_tm);
             }
 
+            auto &text = edit_line();
+
             if (len > time_range.length()) {
                 ssize_t padding = len - time_range.length();
 
-                value_out.insert(time_range.lr_start,
-                                 padding,
-                                 ' ');
+                text.insert(time_range.lr_start,
+                            padding,
+                            ' ');
             }
-            value_out.replace(time_range.lr_start,
-                              len,
-                              buffer,
-                              len);
+            text.replace(time_range.lr_start,
+                         len,
+                         buffer,
+                         len);
             this->lss_token_shift_start = time_range.lr_start;
             this->lss_token_shift_size = len - time_range.length();
         }
     }
 
-    if (this->lss_flags & F_FILENAME || this->lss_flags & F_BASENAME) {
-        size_t file_offset_end;
-        std::string name;
-        if (this->lss_flags & F_FILENAME) {
-            file_offset_end = this->lss_filename_width;
-            name = this->lss_token_file->get_filename();
-            if (file_offset_end < name.size()) {
-                file_offset_end = name.size();
-                this->lss_filename_width = name.size();
-            }
-        } else {
-            file_offset_end = this->lss_basename_width;
-            name = this->lss_token_file->get_unique_path();
-            if (file_offset_end < name.size()) {
-                file_offset_end = name.size();
-                this->lss_basename_width = name.size();
-            }
-        }
-        value_out.insert(0, file_offset_end - name.size() + 1, ' ');
-        value_out.insert(0, name);
-    } else {
-        // Insert space for the file/search-hit markers.
-        value_out.insert(0, 1, ' ');
-    }
+    string &prefix = this->lss_row_prefix;
 
+    prefix.clear();
     if (this->lss_flags & F_TIME_OFFSET) {
         int64_t curr_millis, diff;
 
@@ -321,14 +409,87 @@ void logfile_sub_source::text_value_for_line(textview_curses &tc,
             diff = curr_millis - start_millis;
         }
 
-        value_out = "|" + value_out;
         string relstr;
         size_t rel_length = duration2str(diff, relstr);
-        value_out.insert(0, relstr);
         if (rel_length < 12) {
-            value_out.insert(0, 12 - rel_length, ' ');
+            prefix.append(12 - rel_length, ' ');
+        }
+        prefix.append(relstr);
+        prefix.append(1, '|');
+    }
+
+    if (this->lss_flags & F_FILENAME || this->lss_flags & F_BASENAME) {
+        size_t file_offset_end;
+        const std::string *name;
+        std::string unique_path;
+        if (this->lss_flags & F_FILENAME) {
+            file_offset_end = this->lss_filename_width;
+            name = &this->lss_token_file->get_filename();
+            if (file_offset_end < name->size()) {
+                file_offset_end = name->size();
+                this->lss_filename_width = name->size();
+            }
+        } else {
+            file_offset_end = this->lss_basename_width;
+            unique_path = this->lss_token_file->get_unique_path();
+            name = &unique_path;
+            if (file_offset_end < name->size()) {
+                file_offset_end = name->size();
+                this->lss_basename_width = name->size();
+            }
+        }
+        prefix.append(*name);
+        prefix.append(file_offset_end - name->size() + 1, ' ');
+    } else {
+        // Leave space for the file/search-hit markers.
+        prefix.append(1, ' ');
+    }
+
+    value_out.clear();
+    value_out.reserve(prefix.size() + line_text->size());
+    value_out.append(prefix);
+    value_out.append(*line_text);
+}
+
+size_t logfile_sub_source::text_raw_values_for_lines(
+    textview_curses &tc,
+    int row,
+    int stop_row,
+    size_t max_lines,
+    string &chunk_out,
+    vector<pair<size_t, size_t>> &spans_out)
+{
+    int end_row = this->lss_filtered_index.size();
+
+    if (stop_row != -1 && stop_row < end_row) {
+        end_row = stop_row;
+    }
+    if (row < 0 || row >= end_row) {
+        return 0;
+    }
+
+    content_line_t first_line = this->at(vis_line_t(row));
+    shared_ptr<logfile> lf = this->find(first_line);
+    size_t count = 1;
+
+    // Only lines that are next to each other in the same file can be read
+    // in one go.  The run also stops at lines that have already been
+    // searched so they can be skipped.
+    while (count < max_lines && row + (int) count < end_row) {
+        if (this->text_is_searched(vis_line_t(row + count))) {
+            break;
         }
+
+        content_line_t line = this->at(vis_line_t(row + count));
+
+        if (this->find(line) != lf || line != first_line + count) {
+            break;
+        }
+        count += 1;
     }
+
+    return lf->read_lines(lf->begin() + first_line, count,
+                          chunk_out, spans_out);
 }
 
 void logfile_sub_source::text_attrs_for_line(textview_curses &lv,
@@ -546,12 +707,436 @@ void logfile_sub_source::text_attrs_for_line(textview_curses &lv,
     }
 }
 
-logfile_sub_source::rebuild_result logfile_sub_source::rebuild_index()
+/**
+ * Stand-in for a file's logfile_observer while the file is being indexed on
+ * a worker thread.  The real observer updates the UI, so the progress is
+ * only recorded here and then forwarded from the main thread.
+ */
+class concurrent_index_observer : public logfile_observer {
+public:
+    concurrent_index_observer(std::atomic<bool> &cancelled,
+                              std::atomic<bool> &stopping)
+        : cio_cancelled(cancelled), cio_stopping(stopping) {
+    };
+
+    bool logfile_indexing(logfile &lf, off_t off, size_t total) override {
+        if (this->cio_cancelled) {
+            throw logfile::error(lf.get_filename(), EINTR);
+        }
+
+        this->cio_offset = off;
+        this->cio_total = total;
+
+        return !this->cio_stopping;
+    };
+
+    std::atomic<bool> &cio_cancelled;
+    std::atomic<bool> &cio_stopping;
+    std::atomic<off_t> cio_offset{0};
+    std::atomic<size_t> cio_total{0};
+};
+
+sql_filter::sql_filter(const std::string id, size_t index, sqlite3_stmt *stmt)
+    : text_filter(text_filter::INCLUDE, id, index), sf_stmt(sqlite3_finalize)
+{
+    int param_count = sqlite3_bind_parameter_count(stmt);
+
+    this->sf_stmt = stmt;
+    this->sf_param_names.resize(param_count + 1);
+    for (int lpc = 1; lpc <= param_count; lpc++) {
+        const char *name = sqlite3_bind_parameter_name(stmt, lpc);
+
+        if (name != nullptr) {
+            this->sf_param_names[lpc] = &name[1];
+        }
+    }
+}
+
+bool sql_filter::matches(const logfile &lf, logfile::const_iterator ll,
+                         shared_buffer_ref &line)
+{
+    // The result for the first line of a message covers the whole message.
+    if (ll->is_continued()) {
+        return false;
+    }
+
+    auto format = lf.get_format();
+    uint64_t line_number = std::distance(lf.begin(), ll);
+    string_attrs_t sa;
+    vector<logline_value> values;
+
+    if (format != nullptr) {
+        format->annotate(line_number, line, sa, values, false);
+    }
+
+    lock_guard<mutex> lg(this->sf_mutex);
+    sqlite3_stmt *stmt = this->sf_stmt.in();
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    for (size_t lpc = 1; lpc < this->sf_param_names.size(); lpc++) {
+        const auto &name = this->sf_param_names[lpc];
+
+        if (name == "log_level") {
+            sqlite3_bind_text(stmt, lpc, ll->get_level_name(), -1,
+                              SQLITE_STATIC);
+            continue;
+        }
+        if (name == "log_path") {
+            sqlite3_bind_text(stmt, lpc, lf.get_filename().c_str(), -1,
+                              SQLITE_TRANSIENT);
+            continue;
+        }
+        if (name == "log_text") {
+            sqlite3_bind_text(stmt, lpc, line.get_data(), line.length(),
+                              SQLITE_TRANSIENT);
+            continue;
+        }
+
+        for (const auto &lv : values) {
+            if (!(lv.lv_name == name.c_str())) {
+                continue;
+            }
+
+            switch (lv.lv_kind) {
+                case logline_value::VALUE_NULL:
+                    break;
+                case logline_value::VALUE_BOOLEAN:
+                case logline_value::VALUE_INTEGER:
+                    sqlite3_bind_int64(stmt, lpc, lv.lv_value.i);
+                    break;
+                case logline_value::VALUE_FLOAT:
+                    sqlite3_bind_double(stmt, lpc, lv.lv_value.d);
+                    break;
+                default: {
+                    auto str = lv.to_string();
+
+                    sqlite3_bind_text(stmt, lpc, str.c_str(), str.size(),
+                                      SQLITE_TRANSIENT);
+                    break;
+                }
+            }
+            break;
+        }
+    }
+
+    bool retval = sqlite3_step(stmt) == SQLITE_ROW;
+
+    sqlite3_reset(stmt);
+
+    return retval;
+}
+
+void run_concurrently(const vector<logfile *> &files,
+                      const std::function<void(size_t)> &work,
+                      task_pool::priority_t prio)
+{
+    auto &pool = task_pool::singleton();
+    size_t worker_count = std::min(files.size(), pool.get_worker_count());
+
+    if (worker_count < 2) {
+        for (size_t lpc = 0; lpc < files.size(); lpc++) {
+            work(lpc);
+        }
+        return;
+    }
+
+    /**
+     * The state shared with the tasks, a task that starts after all of the
+     * files are done only looks at this, so it can outlive this call.
+     */
+    struct shared_state {
+        const std::function<void(size_t)> *ss_work;
+        size_t ss_count;
+        std::atomic<size_t> ss_next_work{0};
+        size_t ss_done_count{0};
+        std::mutex ss_done_mutex;
+        std::condition_variable ss_done_cond;
+        vector<exception_ptr> ss_errors;
+    };
+
+    auto st = make_shared<shared_state>();
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> stopping{false};
+    vector<unique_ptr<concurrent_index_observer>> progress;
+    vector<logfile_observer *> observers;
+    auto &done_mutex = st->ss_done_mutex;
+    auto &done_cond = st->ss_done_cond;
+    auto &done_count = st->ss_done_count;
+    auto &errors = st->ss_errors;
+
+    st->ss_work = &work;
+    st->ss_count = files.size();
+    errors.resize(files.size());
+
+    for (auto lf : files) {
+        progress.emplace_back(make_unique<concurrent_index_observer>(cancelled,
+                                                                 stopping));
+        observers.push_back(lf->get_logfile_observer());
+        lf->set_logfile_observer(progress.back().get());
+    }
+
+    log_debug("working on %d files with %d workers",
+              files.size(), worker_count);
+    for (size_t lpc = 0; lpc < worker_count; lpc++) {
+        pool.submit([st]() {
+            for (size_t index = st->ss_next_work++;
+                 index < st->ss_count;
+                 index = st->ss_next_work++) {
+                try {
+                    (*st->ss_work)(index);
+                } catch (...) {
+                    st->ss_errors[index] = current_exception();
+                }
+
+                std::lock_guard<std::mutex> lg(st->ss_done_mutex);
+
+                st->ss_done_count += 1;
+                st->ss_done_cond.notify_one();
+            }
+        }, prio);
+    }
+
+    exception_ptr observer_error;
+
+    {
+        std::unique_lock<std::mutex> ul(done_mutex);
+
+        while (done_count < files.size()) {
+            done_cond.wait_for(ul, std::chrono::milliseconds(100));
+
+            off_t total_off = 0;
+            size_t total_size = 0;
+            logfile_observer *lo = nullptr;
+            logfile *lo_file = nullptr;
+
+            for (size_t lpc = 0; lpc < files.size(); lpc++) {
+                total_off += progress[lpc]->cio_offset;
+                total_size += progress[lpc]->cio_total;
+                if (lo == nullptr && observers[lpc] != nullptr) {
+                    lo = observers[lpc];
+                    lo_file = files[lpc];
+                }
+            }
+
+            if (lo == nullptr || cancelled) {
+                continue;
+            }
+
+            ul.unlock();
+            try {
+                // The real observer can ask for the indexing to stop early,
+                // pass that on to the workers.
+                if (!lo->logfile_indexing(*lo_file, total_off, total_size)) {
+                    stopping = true;
+                }
+            } catch (...) {
+                observer_error = current_exception();
+                cancelled = true;
+            }
+            ul.lock();
+        }
+    }
+
+    for (size_t lpc = 0; lpc < files.size(); lpc++) {
+        files[lpc]->set_logfile_observer(observers[lpc]);
+    }
+
+    if (observer_error) {
+        rethrow_exception(observer_error);
+    }
+    for (auto &error : errors) {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+}
+
+vector<logfile::rebuild_result_t>
+logfile_sub_source::rebuild_files(const vector<logfile_data *> &files,
+                                  logfile::deadline_t deadline)
+{
+    vector<logfile::rebuild_result_t> retval(files.size(),
+                                             logfile::RR_NO_NEW_LINES);
+    vector<size_t> concurrent;
+    vector<logfile *> concurrent_files;
+
+    for (size_t lpc = 0; lpc < files.size(); lpc++) {
+        logfile &lf = *files[lpc]->get_file();
+
+        if (lf.has_unindexed_data()) {
+            concurrent.push_back(lpc);
+            concurrent_files.push_back(&lf);
+        } else {
+            retval[lpc] = lf.rebuild_index(deadline);
+        }
+    }
+
+    run_concurrently(concurrent_files, [&](size_t index) {
+        retval[concurrent[index]] =
+            concurrent_files[index]->rebuild_index(deadline);
+    });
+
+    return retval;
+}
+
+/**
+ * A line in the log view with the fields it is ordered by copied out of the
+ * logline, so that sorting does not have to look up the logline for every
+ * comparison.
+ */
+struct sort_entry {
+    uint64_t se_millis;
+    uint64_t se_offset;       /*< The file offset shifted over the sub-offset. */
+    uint64_t se_content_line;
+
+    bool operator<(const sort_entry &rhs) const {
+        if (this->se_millis != rhs.se_millis) {
+            return this->se_millis < rhs.se_millis;
+        }
+        if (this->se_offset != rhs.se_offset) {
+            return this->se_offset < rhs.se_offset;
+        }
+        return this->se_content_line < rhs.se_content_line;
+    };
+};
+
+/**
+ * The minimum number of lines to sort before worker threads are used.
+ */
+static const size_t PARALLEL_SORT_MIN_LINES = 64 * 1024;
+
+/**
+ * Sort the entries, which are made up of runs that each come from one file.
+ * The runs are sorted on their own and then merged in pairs, with each round
+ * of merges done in parallel.
+ *
+ * @param entries The entries to sort.
+ * @param bounds The start of each run followed by the end of the last one.
+ * @param run_sorted Whether each run is already in order.
+ */
+static void sort_runs(vector<sort_entry> &entries,
+                      vector<size_t> bounds,
+                      const vector<bool> &run_sorted)
+{
+    bool parallel = entries.size() >= PARALLEL_SORT_MIN_LINES;
+    auto run_work = [&](size_t count, const std::function<void(size_t)> &work) {
+        if (parallel) {
+            task_pool::singleton().parallel_for(count, work);
+        } else {
+            for (size_t lpc = 0; lpc < count; lpc++) {
+                work(lpc);
+            }
+        }
+    };
+
+    run_work(run_sorted.size(), [&](size_t run) {
+        if (!run_sorted[run]) {
+            std::sort(entries.begin() + bounds[run],
+                      entries.begin() + bounds[run + 1]);
+        }
+    });
+
+    vector<sort_entry> merged(entries.size());
+
+    while (bounds.size() > 2) {
+        size_t run_count = bounds.size() - 1;
+
+        run_work((run_count + 1) / 2, [&](size_t pair) {
+            auto start = entries.begin() + bounds[pair * 2];
+            auto middle = entries.begin() + bounds[pair * 2 + 1];
+            auto out = merged.begin() + bounds[pair * 2];
+
+            if (pair * 2 + 1 == run_count) {
+                std::copy(start, middle, out);
+            } else {
+                std::merge(start, middle,
+                           middle, entries.begin() + bounds[pair * 2 + 2],
+                           out);
+            }
+        });
+
+        vector<size_t> next_bounds;
+
+        for (size_t lpc = 0; lpc < bounds.size(); lpc += 2) {
+            next_bounds.push_back(bounds[lpc]);
+        }
+        if (next_bounds.back() != bounds.back()) {
+            next_bounds.push_back(bounds.back());
+        }
+        bounds.swap(next_bounds);
+        entries.swap(merged);
+    }
+}
+
+/**
+ * Check if the new lines in the given files do not overlap in time and, if
+ * so, put the files in the order their new lines should be appended.
+ *
+ * @param files The files with new lines, which are each in time-order.
+ * @return True if the lines of one file all come before the next file.
+ */
+static bool disjoint_new_lines(
+    vector<logfile_sub_source::logfile_data *> &files)
+{
+    using logfile_data = logfile_sub_source::logfile_data;
+
+    auto first_new = [](logfile_data *ld) -> const logline & {
+        return (*ld->get_file())[ld->ld_lines_indexed];
+    };
+
+    if (files.size() < 2) {
+        return true;
+    }
+
+    vector<logfile_data *> ordered(files);
+
+    std::sort(ordered.begin(), ordered.end(),
+              [&](logfile_data *lhs, logfile_data *rhs) {
+                  return first_new(lhs) < first_new(rhs);
+              });
+    for (size_t lpc = 1; lpc < ordered.size(); lpc++) {
+        const logline &prev_last = ordered[lpc - 1]->get_file()->back();
+
+        // Lines with the same time could be ordered differently by a merge,
+        // so only a strict gap counts.
+        if (!(prev_last < first_new(ordered[lpc]).get_timeval())) {
+            return false;
+        }
+    }
+    files.swap(ordered);
+
+    return true;
+}
+
+/**
+ * @return An unlinked file in the index cache directory that the merged
+ *   index can be kept in, see /tuning/index/file-backed.
+ */
+static auto_fd open_index_backing_file()
+{
+    auto open_res = open_temp_file(
+        dotlnav_path() / "index-cache" / "lss-index.XXXXXX");
+
+    if (open_res.isErr()) {
+        log_warning("unable to create file for the log index -- %s",
+                    open_res.unwrapErr().c_str());
+        return auto_fd();
+    }
+
+    auto pair = open_res.unwrap();
+
+    pair.first.remove_file();
+
+    return auto_fd(pair.second);
+}
+
+logfile_sub_source::rebuild_result
+logfile_sub_source::rebuild_index(logfile::deadline_t deadline)
 {
     iterator iter;
     size_t total_lines = 0;
     bool full_sort = false;
-    int file_count = 0;
     bool force = this->lss_force_rebuild;
     rebuild_result retval = rebuild_result::rr_no_change;
 
@@ -560,6 +1145,8 @@ logfile_sub_source::rebuild_result logfile_sub_source::rebuild_index()
         retval = rebuild_result::rr_full_rebuild;
     }
 
+    std::vector<logfile_data *> pending;
+
     for (iter = this->lss_files.begin();
          iter != this->lss_files.end();
          iter++) {
@@ -571,48 +1158,82 @@ logfile_sub_source::rebuild_result logfile_sub_source::rebuild_index()
                 retval = rebuild_result::rr_full_rebuild;
             }
         }
-        else {
-            logfile &lf = *ld.get_file();
-
-            if (!this->tss_view->is_paused()) {
-                switch (lf.rebuild_index()) {
-                    case logfile::RR_NO_NEW_LINES:
-                        // No changes
-                        break;
-                    case logfile::RR_NEW_LINES:
-                        if (retval == rebuild_result::rr_no_change) {
-                            retval = rebuild_result::rr_appended_lines;
-                        }
-                        if (!this->lss_index.empty()) {
-                            logline &new_file_line = lf[ld.ld_lines_indexed];
-                            content_line_t cl = this->lss_index.back();
-                            logline *last_indexed_line = this->find_line(cl);
-
-                            // If there are new lines that are older than what we
-                            // have in the index, we need to resort.
-                            if (last_indexed_line == nullptr ||
-                                new_file_line <
-                                last_indexed_line->get_timeval()) {
-                                force = true;
-                                retval = rebuild_result::rr_full_rebuild;
-                            }
-                        }
-                        break;
-                    case logfile::RR_INVALID:
-                    case logfile::RR_NEW_ORDER:
-                        retval = rebuild_result::rr_full_rebuild;
+        else if (!this->tss_view->is_paused()) {
+            pending.push_back(&ld);
+        }
+    }
+
+    auto results = this->rebuild_files(pending, deadline);
+    const logline *first_new_line = nullptr;
+    bool rewound = false;
+
+    for (size_t lpc = 0; lpc < pending.size(); lpc++) {
+        logfile_data &ld = *pending[lpc];
+        logfile &lf = *ld.get_file();
+
+        switch (results[lpc]) {
+            case logfile::RR_NO_NEW_LINES:
+                // No changes
+                break;
+            case logfile::RR_NEW_LINES:
+                if (retval == rebuild_result::rr_no_change) {
+                    retval = rebuild_result::rr_appended_lines;
+                }
+                if (!this->lss_index.empty()) {
+                    logline &new_file_line = lf[ld.ld_lines_indexed];
+                    content_line_t cl = this->lss_index.back();
+                    logline *last_indexed_line = this->find_line(cl);
+
+                    // If there are new lines that are older than what we
+                    // have in the index, they need to be merged in.
+                    if (last_indexed_line == nullptr) {
                         force = true;
-                        break;
+                        retval = rebuild_result::rr_full_rebuild;
+                    } else if (new_file_line <
+                               last_indexed_line->get_timeval() &&
+                               (first_new_line == nullptr ||
+                                new_file_line < *first_new_line)) {
+                        first_new_line = &new_file_line;
+                    }
                 }
-            }
-            file_count += 1;
-            total_lines += (*iter)->get_file()->size();
+                break;
+            case logfile::RR_INVALID:
+            case logfile::RR_NEW_ORDER:
+                retval = rebuild_result::rr_full_rebuild;
+                force = true;
+                this->forget_search(ld);
+                this->lss_index_generation += 1;
+                break;
+        }
+    }
+
+    if (!force && first_new_line != nullptr) {
+        if (this->rewind_index(*first_new_line)) {
+            rewound = true;
+        } else {
+            force = true;
+            retval = rebuild_result::rr_full_rebuild;
         }
     }
 
-    if (this->lss_index.reserve(total_lines)) {
-        force = true;
+    for (iter = this->lss_files.begin();
+         iter != this->lss_files.end();
+         iter++) {
+        if ((*iter)->get_file() == NULL) {
+            continue;
+        }
+
+        total_lines += (*iter)->get_file()->size();
+    }
+
+    if (lnav_config.lc_tuning_index_file_backed &&
+        !this->lss_index_backing_tried) {
+        this->lss_index_backing_tried = true;
+        this->lss_index.set_backing_file(open_index_backing_file());
+        this->lss_index_times.set_backing_file(open_index_backing_file());
     }
+    this->lss_index.reserve(total_lines);
+    this->lss_index_times.reserve(total_lines);
 
     if (force) {
         full_sort = true;
@@ -623,15 +1244,21 @@ logfile_sub_source::rebuild_result logfile_sub_source::rebuild_index()
         }
 
         this->lss_index.clear();
+        this->lss_index_times.clear();
+        this->lss_index_partitions.clear();
         this->lss_filtered_index.clear();
+        this->lss_snapshot_stable = 0;
+        this->lss_marked_size = 0;
+        this->lss_accel_size = 0;
+        this->lss_reverse_indexed = 0;
         this->lss_longest_line = 0;
         this->lss_basename_width = 0;
         this->lss_filename_width = 0;
     }
 
     if (retval != rebuild_result::rr_no_change || force) {
-        size_t index_size = 0, start_size = this->lss_index.size();
-        logline_cmp line_cmper(*this);
+        size_t start_size = this->lss_index.size();
+        perf_timer merge_timer(perf_stage_t::MERGE);
 
         for (auto ld : this->lss_files) {
             std::shared_ptr<logfile> lf = ld->get_file();
@@ -647,42 +1274,95 @@ logfile_sub_source::rebuild_result logfile_sub_source::rebuild_index()
                 this->lss_filename_width, lf->get_filename().size());
         }
 
-        if (full_sort) {
-            for (auto ld : this->lss_files) {
-                shared_ptr<logfile> lf = ld->get_file();
+        vector<logfile_data *> merge_files, sort_files;
 
-                if (lf == nullptr) {
-                    continue;
-                }
+        for (auto ld : this->lss_files) {
+            shared_ptr<logfile> lf = ld->get_file();
+
+            if (lf == nullptr) {
+                continue;
+            }
+
+            // Most files are already in time-order, so they only need to be
+            // merged.  The rest need to be sorted on a full rebuild.
+            if (full_sort && !is_sorted(lf->begin(), lf->end())) {
+                sort_files.push_back(ld);
+            } else {
+                merge_files.push_back(ld);
+            }
+        }
+
+        vector<logfile_data *> grown_files;
 
-                for (size_t line_index = 0; line_index < lf->size(); line_index++) {
-                    content_line_t con_line(ld->ld_file_index * MAX_LINES_PER_FILE +
-                                            line_index);
+        for (auto ld : merge_files) {
+            if (ld->ld_lines_indexed < ld->get_file()->size()) {
+                grown_files.push_back(ld);
+            }
+        }
+
+        if (!sort_files.empty()) {
+            // The index is empty on a full sort, so everything can be
+            // sorted together by a key that is copied out of the loglines.
+            vector<sort_entry> entries;
+            vector<size_t> bounds{0};
+            vector<bool> run_sorted;
+
+            entries.reserve(total_lines);
+            size_t sorted_count = grown_files.size();
+            grown_files.insert(grown_files.end(),
+                               sort_files.begin(), sort_files.end());
+            for (auto ld : grown_files) {
+                shared_ptr<logfile> lf = ld->get_file();
 
-                    this->lss_index.push_back(con_line);
+                for (size_t line_index = 0;
+                     line_index < lf->size();
+                     line_index++) {
+                    const logline &ll = (*lf)[line_index];
+
+                    entries.push_back({
+                        ll.get_time_in_millis(),
+                        ((uint64_t) ll.get_offset() << 16) |
+                        ll.get_sub_offset(),
+                        this->get_content_line(ld, line_index),
+                    });
                 }
+                bounds.push_back(entries.size());
+                run_sorted.push_back(run_sorted.size() < sorted_count);
             }
 
-            // XXX get rid of this full sort on the initial run, it's not
-            // needed unless the file is not in time-order
-            sort(this->lss_index.begin(), this->lss_index.end(), line_cmper);
+            log_debug("sorting %d lines from %d out-of-order files",
+                      entries.size(), sort_files.size());
+            sort_runs(entries, bounds, run_sorted);
+            for (const auto &entry : entries) {
+                this->push_index_line(content_line_t(entry.se_content_line),
+                                      entry.se_millis);
+            }
+        } else if (disjoint_new_lines(grown_files)) {
+            // Usually only one file has grown or the files are rotated logs
+            // that cover separate periods, so the new lines can just be
+            // appended a file at a time.
+            for (auto ld : grown_files) {
+                shared_ptr<logfile> lf = ld->get_file();
+                size_t file_size = lf->size();
+
+                for (size_t line_index = ld->ld_lines_indexed;
+                     line_index < file_size;
+                     line_index++) {
+                    this->push_index_line(
+                        this->get_content_line(ld, line_index),
+                        (*lf)[line_index].get_time_in_millis());
+                }
+            }
         } else {
             kmerge_tree_c<logline, logfile_data, logfile::iterator> merge(
-                file_count);
+                grown_files.size());
 
-            for (iter = this->lss_files.begin();
-                 iter != this->lss_files.end();
-                 iter++) {
-                logfile_data *ld = *iter;
+            for (auto ld : grown_files) {
                 shared_ptr<logfile> lf = ld->get_file();
-                if (lf == NULL) {
-                    continue;
-                }
 
                 merge.add(ld,
                           lf->begin() + ld->ld_lines_indexed,
                           lf->end());
-                index_size += lf->size();
             }
 
             merge.execute();
@@ -694,13 +1374,12 @@ logfile_sub_source::rebuild_result logfile_sub_source::rebuild_index()
                     break;
                 }
 
-                int file_index = ld->ld_file_index;
-                int line_index = lf_iter - ld->get_file()->begin();
-
-                content_line_t con_line(file_index * MAX_LINES_PER_FILE +
-                                        line_index);
+                uint64_t line_index = lf_iter - ld->get_file()->begin();
+                content_line_t con_line = this->get_content_line(ld,
+                                                                 line_index);
 
-                this->lss_index.push_back(con_line);
+                this->push_index_line(con_line,
+                                      lf_iter->get_time_in_millis());
 
                 merge.next();
             }
@@ -715,10 +1394,25 @@ logfile_sub_source::rebuild_result logfile_sub_source::rebuild_index()
             (*iter)->ld_lines_indexed = (*iter)->get_file()->size();
         }
 
+        merge_timer.add(this->lss_index.size() - start_size);
+        merge_timer.stop();
+
+        perf_timer filter_timer(perf_stage_t::FILTER);
+
+        filter_timer.add(this->lss_index.size() - start_size);
         this->lss_filtered_index.reserve(this->lss_index.size());
 
-        uint32_t filter_in_mask, filter_out_mask;
-        this->get_filters().get_enabled_mask(filter_in_mask, filter_out_mask);
+        filtered_index_state curr_state = this->get_filtered_index_state();
+        filter_mask_t filter_in_mask = curr_state.fis_in_mask;
+        filter_mask_t filter_out_mask = curr_state.fis_out_mask;
+
+        if (start_size == 0) {
+            this->lss_filtered_index_state = std::move(curr_state);
+        } else if (!this->lss_filtered_index_state.is_narrowed_by(curr_state) ||
+                   !curr_state.is_narrowed_by(this->lss_filtered_index_state)) {
+            // The old and new lines were filtered with different settings.
+            this->lss_filtered_index_state.fis_valid = false;
+        }
 
         if (start_size == 0 && this->lss_index_delegate != NULL) {
             this->lss_index_delegate->index_start(*this);
@@ -730,10 +1424,10 @@ logfile_sub_source::rebuild_result logfile_sub_source::rebuild_index()
             content_line_t cl = (content_line_t) this->lss_index[index_index];
             uint64_t line_number;
             logfile_data *ld = this->find_data(cl, line_number);
-            auto line_iter = ld->get_file()->begin() + line_number;
 
             if (!ld->ld_filter_state.excluded(filter_in_mask, filter_out_mask,
-                    line_number) && this->check_extra_filters(*line_iter)) {
+                    line_number) &&
+                this->check_extra_filters(*ld->get_file(), line_number)) {
                 this->lss_filtered_index.push_back(index_index);
                 if (this->lss_index_delegate != NULL) {
                     shared_ptr<logfile> lf = ld->get_file();
@@ -755,62 +1449,320 @@ logfile_sub_source::rebuild_result logfile_sub_source::rebuild_index()
             this->tss_view->redo_search();
             break;
         case rebuild_result::rr_appended_lines:
-            this->tss_view->search_new_data();
+            if (rewound) {
+                // Lines that were already searched have moved.
+                this->tss_view->redo_search();
+            } else {
+                this->tss_view->search_new_data();
+            }
             break;
     }
 
     return retval;
 }
 
-void logfile_sub_source::text_update_marks(vis_bookmarks &bm)
+bool logfile_sub_source::rewind_index(const logline &first_new)
 {
-    shared_ptr<logfile> last_file = nullptr;
-    vis_line_t vl;
+    size_t index_size = this->lss_index.size();
+    auto last_line = this->find_line(this->lss_index.back());
+    auto window = (uint64_t) lnav_config.lc_tuning_index_reorder_window;
 
-    bm[&BM_WARNINGS].clear();
-    bm[&BM_ERRORS].clear();
-    bm[&BM_FILES].clear();
+    if (first_new.get_time_in_millis() + window <
+        last_line->get_time_in_millis()) {
+        return false;
+    }
 
-    for (auto &lss_user_mark : this->lss_user_marks) {
-        bm[lss_user_mark.first].clear();
+    auto first_new_millis = first_new.get_time_in_millis();
+    // The lines before the partition of the new line are all older than it.
+    auto window_iter = upper_bound(
+        this->lss_index_times.begin() +
+        this->find_index_partition(first_new_millis).first,
+        this->lss_index_times.end(),
+        first_new_millis,
+        [this, &first_new](uint64_t millis, const uint64_t &index_millis) {
+            if (millis != index_millis) {
+                return millis < index_millis;
+            }
+
+            size_t index = &index_millis - this->lss_index_times.begin();
+
+            return first_new < *this->find_line(this->lss_index[index]);
+        });
+    size_t new_size = window_iter - this->lss_index_times.begin();
+
+    // The lines of a file can only be merged again if they are at the end
+    // of what was merged from it.
+    map<logfile_data *, pair<size_t, size_t>> rewinds;
+
+    for (size_t index = new_size; index < index_size; index++) {
+        uint64_t line_number;
+        logfile_data *ld = this->find_data(this->lss_index[index],
+                                           line_number);
+        auto rewind_iter = rewinds.find(ld);
+
+        if (rewind_iter == rewinds.end()) {
+            rewinds[ld] = make_pair(line_number, 1);
+        } else {
+            rewind_iter->second.first = std::min(rewind_iter->second.first,
+                                                 (size_t) line_number);
+            rewind_iter->second.second += 1;
+        }
+    }
+    for (const auto &rewind : rewinds) {
+        if (rewind.second.first + rewind.second.second !=
+            rewind.first->ld_lines_indexed) {
+            return false;
+        }
     }
 
-    for (; vl < (int)this->lss_filtered_index.size(); ++vl) {
-        const content_line_t orig_cl = this->at(vl);
-        content_line_t cl = orig_cl;
-        shared_ptr<logfile> lf;
+    auto filtered_iter = lower_bound(this->lss_filtered_index.begin(),
+                                     this->lss_filtered_index.end(),
+                                     new_size);
 
-        lf = this->find(cl);
+    if (filtered_iter != this->lss_filtered_index.end() &&
+        this->lss_index_delegate != nullptr) {
+        if (!this->lss_index_delegate->supports_line_removal()) {
+            return false;
+        }
+
+        for (auto iter = filtered_iter;
+             iter != this->lss_filtered_index.end();
+             ++iter) {
+            uint64_t line_number;
+            logfile_data *ld = this->find_data(this->lss_index[*iter],
+                                               line_number);
+            auto lf = ld->get_file();
+
+            this->lss_index_delegate->index_line_removed(
+                *this, lf.get(), lf->begin() + line_number);
+        }
+    }
+
+    log_debug("merging out-of-order lines into the last %d lines of the index",
+              index_size - new_size);
+    this->lss_filtered_index.truncate(new_size);
+    this->lss_snapshot_stable = std::min(this->lss_snapshot_stable,
+                                         this->lss_filtered_index.size());
+    this->lss_marked_size = std::min(this->lss_marked_size,
+                                     this->lss_filtered_index.size());
+    this->lss_accel_size = std::min(this->lss_accel_size,
+                                    this->lss_filtered_index.size());
+    for (const auto &rewind : rewinds) {
+        rewind.first->ld_lines_indexed = rewind.second.first;
+    }
+    this->lss_index.truncate(new_size);
+    this->lss_reverse_indexed = std::min(this->lss_reverse_indexed, new_size);
+    this->lss_index_times.truncate(new_size);
+    this->truncate_index_partitions(new_size);
 
-        for (auto &lss_user_mark : this->lss_user_marks) {
-            if (binary_search(lss_user_mark.second.begin(),
-                              lss_user_mark.second.end(),
-                              orig_cl)) {
-                bm[lss_user_mark.first].insert_once(vl);
+    return true;
+}
 
-                if (lss_user_mark.first == &textview_curses::BM_USER) {
-                    auto ll = lf->begin() + cl;
+void logfile_sub_source::text_mark_searched(vis_line_t start,
+                                            vis_line_t stop,
+                                            bool searched)
+{
+    if (stop == -1 || stop > (int) this->lss_filtered_index.size()) {
+        stop = vis_line_t(this->lss_filtered_index.size());
+    }
+
+    for (vis_line_t vl = start; vl < stop; ++vl) {
+        uint64_t line_number;
+        logfile_data *ld = this->find_data(this->at(vl), line_number);
 
-                    ll->set_mark(true);
+        if (line_number >= ld->ld_searched.size()) {
+            if (!searched) {
+                continue;
+            }
+            ld->ld_searched.resize(std::max(ld->get_file()->size(),
+                                            (size_t) line_number + 1));
+        }
+        ld->ld_searched[line_number] = searched;
+    }
+}
+
+bool logfile_sub_source::has_opid_index() const
+{
+    for (const auto ld : this->lss_files) {
+        auto lf = ld->get_file_ptr();
+
+        if (lf != nullptr && ld->ld_enabled && !lf->has_opid_index()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+nonstd::optional<vis_line_t> logfile_sub_source::find_opid(
+    const std::string &opid, vis_line_t start, bool forward)
+{
+    nonstd::optional<vis_line_t> retval;
+
+    for (auto ld : this->lss_files) {
+        auto lf = ld->get_file_ptr();
+
+        if (lf == nullptr || !ld->ld_enabled || lf->get_format() == nullptr) {
+            continue;
+        }
+
+        const auto &opids = lf->get_format()->get_opids();
+        auto iter = opids.find(opid);
+
+        if (iter == opids.end()) {
+            continue;
+        }
+
+        for (auto line : iter->second.od_lines) {
+            if (line >= ld->ld_lines_indexed) {
+                break;
+            }
+
+            auto vl_opt = this->find_from_content(
+                this->get_content_line(ld, line));
+
+            if (!vl_opt) {
+                continue;
+            }
+
+            auto vl = vl_opt.value();
+
+            if (forward) {
+                if (vl > start && (!retval || vl < retval.value())) {
+                    retval = vl;
                 }
             }
+            else if (vl < start && (!retval || vl > retval.value())) {
+                retval = vl;
+            }
         }
+    }
+
+    return retval;
+}
+
+nonstd::optional<size_t> logfile_sub_source::index_for_content(content_line_t cl)
+{
+    size_t index_size = this->lss_index.size();
+
+    // The index only grows at the end between rebuilds, so the positions of
+    // the new lines are recorded in the files they came from.
+    for (; this->lss_reverse_indexed < index_size; this->lss_reverse_indexed++) {
+        auto index_cl = content_line_t(
+            this->lss_index[this->lss_reverse_indexed]);
+        uint64_t line_number;
+        logfile_data *ld = this->find_data(index_cl, line_number);
+        auto &positions = ld->ld_index_positions;
+
+        if (line_number >= positions.size()) {
+            auto lf = ld->get_file_ptr();
+
+            positions.resize(std::max(
+                (size_t) line_number + 1,
+                lf == nullptr ? (size_t) 0 : lf->size()));
+        }
+        positions[line_number] = this->lss_reverse_indexed;
+    }
+
+    uint64_t line_number;
+    logfile_data *ld = this->find_data(cl, line_number);
+
+    if (ld->get_file_ptr() == nullptr ||
+        line_number >= ld->ld_index_positions.size()) {
+        return nonstd::nullopt;
+    }
+
+    size_t retval = ld->ld_index_positions[line_number];
+
+    // A position can be left over from before the index was rewound, so it
+    // is only trusted if the index still has the same line there.
+    if (retval >= index_size ||
+        content_line_t(this->lss_index[retval]) != cl) {
+        return nonstd::nullopt;
+    }
+
+    return retval;
+}
+
+void logfile_sub_source::forget_search(logfile_data &ld)
+{
+    auto &bv = this->lss_user_marks[&textview_curses::BM_SEARCH];
+
+    ld.ld_searched.clear();
+    this->lss_user_marks_changed = true;
+    for (auto extent : ld.ld_extents) {
+        auto lb = lower_bound(bv.begin(), bv.end(), content_line_t(
+            (uint64_t) extent << EXTENT_BITS));
+        auto ub = lower_bound(lb, bv.end(), content_line_t(
+            ((uint64_t) extent + 1) << EXTENT_BITS));
+
+        bv.erase(lb, ub);
+    }
+}
+
+void logfile_sub_source::text_update_marks(vis_bookmarks &bm)
+{
+    static const uint32_t WARNING_MASK =
+        logfile::level_mask_at_least(LEVEL_WARNING);
+
+    vis_line_t vl(this->lss_marked_size);
+    shared_ptr<logfile> last_file = nullptr;
+
+    if (&bm != this->lss_marked_bookmarks ||
+        this->lss_marked_size > this->lss_filtered_index.size() ||
+        (vl > 0 && bm[&BM_FILES].empty())) {
+        // The marks were computed for another view or cleared since.
+        vl = 0_vl;
+    }
+
+    vis_line_t marks_start = vl;
+
+    if (vl == 0) {
+        bm[&BM_WARNINGS].clear();
+        bm[&BM_ERRORS].clear();
+        bm[&BM_FILES].clear();
+    } else {
+        // Drop the marks for lines that were removed from the end of the
+        // index since the last update.
+        for (auto bt : {&BM_WARNINGS, &BM_ERRORS, &BM_FILES}) {
+            auto &bv = bm[bt];
+
+            bv.erase(lower_bound(bv.begin(), bv.end(), vl), bv.end());
+        }
+
+        content_line_t cl = this->at(vl - 1_vl);
+
+        last_file = this->find(cl);
+    }
+
+    for (; vl < (int)this->lss_filtered_index.size(); ++vl) {
+        content_line_t cl = this->at(vl);
+        shared_ptr<logfile> lf;
+
+        lf = this->find(cl);
 
         if (lf != last_file) {
             bm[&BM_FILES].insert_once(vl);
         }
 
+        // Most blocks of lines have no warnings or errors, so the summary
+        // can save looking at the logline.
+        if (!lf->block_has_levels(cl, WARNING_MASK)) {
+            last_file = lf;
+            continue;
+        }
+
         auto line_iter = lf->begin() + cl;
         if (!line_iter->is_continued()) {
             switch (line_iter->get_msg_level()) {
                 case LEVEL_WARNING:
-                    bm[&BM_WARNINGS].insert_once(vl);
+                    bm[&BM_WARNINGS].push_back(vl);
                     break;
 
                 case LEVEL_FATAL:
                 case LEVEL_ERROR:
                 case LEVEL_CRITICAL:
-                    bm[&BM_ERRORS].insert_once(vl);
+                    bm[&BM_ERRORS].push_back(vl);
                     break;
 
                 default:
@@ -820,78 +1772,494 @@ void logfile_sub_source::text_update_marks(vis_bookmarks &bm)
 
         last_file = lf;
     }
+    this->lss_marked_size = this->lss_filtered_index.size();
+    this->lss_marked_bookmarks = &bm;
+
+    size_t filtered_size = this->lss_filtered_index.size();
+
+    // The marks that were mapped for the lines before the end of the last
+    // update are still valid, so only the appended lines are looked at
+    // unless the marks were changed behind the view's back.
+    if (this->lss_user_marks_changed) {
+        marks_start = 0_vl;
+        this->lss_user_marks_changed = false;
+    }
+
+    for (auto &lss_user_mark : this->lss_user_marks) {
+        auto &bv = bm[lss_user_mark.first];
+        bool is_user = lss_user_mark.first == &textview_curses::BM_USER;
+
+        bv.erase(lower_bound(bv.begin(), bv.end(), marks_start), bv.end());
+        if (marks_start >= (int) filtered_size) {
+            continue;
+        }
+
+        size_t new_lines = filtered_size - marks_start;
+
+        if (lss_user_mark.second.size() * 16 > new_lines) {
+            // There are enough marks that checking every new line is
+            // quicker than looking up each mark.
+            for (vl = marks_start; vl < (int) filtered_size; ++vl) {
+                content_line_t cl = this->at(vl);
+
+                if (binary_search(lss_user_mark.second.begin(),
+                                  lss_user_mark.second.end(),
+                                  cl)) {
+                    bv.push_back(vl);
+                    if (is_user) {
+                        this->find_line(cl)->set_mark(true);
+                    }
+                }
+            }
+            continue;
+        }
+
+        auto mapped_size = bv.size();
+
+        for (const auto &cl : lss_user_mark.second) {
+            auto vl_opt = this->find_from_content(cl);
+
+            if (!vl_opt || vl_opt.value() < marks_start) {
+                continue;
+            }
+            bv.push_back(vl_opt.value());
+            if (is_user) {
+                this->find_line(cl)->set_mark(true);
+            }
+        }
+        sort(bv.begin() + mapped_size, bv.end());
+    }
 }
 
 log_accel::direction_t logfile_sub_source::get_line_accel_direction(
     vis_line_t vl)
 {
-    log_accel la;
+    if (vl < 0 || vl >= (int) this->lss_filtered_index.size()) {
+        return log_accel::A_STEADY;
+    }
 
-    while (vl >= 0) {
+    if ((size_t) vl >= this->lss_accel_size) {
+        this->extend_accel_track(vl + 1);
+    }
+
+    int shift = (vl % 4) * 2;
+
+    return (log_accel::direction_t) ((this->lss_accel_track[vl / 4] >> shift) &
+                                     0x3);
+}
+
+void logfile_sub_source::extend_accel_track(size_t end)
+{
+    size_t points = log_accel::history_points();
+    // The times of the most recent messages, newest first.
+    std::vector<int64_t> window;
+
+    window.reserve(points + 1);
+    for (vis_line_t vl = vis_line_t(this->lss_accel_size) - 1_vl;
+         vl >= 0 && window.size() < points;
+         --vl) {
         logline *curr_line = this->find_line(this->at(vl));
 
-        if (curr_line->is_continued()) {
-            --vl;
+        if (!curr_line->is_continued()) {
+            window.push_back(curr_line->get_time_in_millis());
+        }
+    }
+
+    auto window_direction = [&window]() {
+        log_accel la;
+
+        for (auto point : window) {
+            la.add_point(point);
+        }
+
+        return la.get_direction();
+    };
+
+    log_accel::direction_t dir = window_direction();
+
+    this->lss_accel_track.resize((end + 3) / 4);
+    for (size_t row = this->lss_accel_size; row < end; row++) {
+        logline *curr_line = this->find_line(this->at(vis_line_t(row)));
+
+        // The lines of a multi-line message share the direction of its
+        // first line.
+        if (!curr_line->is_continued()) {
+            window.insert(window.begin(), curr_line->get_time_in_millis());
+            if (window.size() > points) {
+                window.pop_back();
+            }
+            dir = window_direction();
+        }
+
+        int shift = (row % 4) * 2;
+        uint8_t &packed = this->lss_accel_track[row / 4];
+
+        packed = (packed & ~(0x3 << shift)) | (dir << shift);
+    }
+    this->lss_accel_size = end;
+}
+
+size_t logfile_sub_source::get_index_memory() const
+{
+    size_t retval = this->lss_index.get_memory_usage() +
+                    this->lss_index_times.get_memory_usage() +
+                    this->lss_index_partitions.capacity() *
+                    sizeof(std::pair<uint64_t, size_t>) +
+                    this->lss_extents.capacity() * sizeof(content_extent);
+
+    for (const auto ld : this->lss_files) {
+        retval += (ld->ld_extents.capacity() +
+                   ld->ld_index_positions.capacity()) * sizeof(uint32_t);
+    }
+
+    return retval;
+}
+
+size_t logfile_sub_source::get_filter_mask_memory() const
+{
+    size_t retval = 0;
+
+    for (const auto ld : this->lss_files) {
+        retval += ld->ld_filter_state.lfo_filter_state.get_mask_memory();
+    }
+
+    return retval;
+}
+
+size_t logfile_sub_source::get_bookmark_memory() const
+{
+    size_t retval = 0;
+
+    for (const auto &pair : this->lss_user_marks) {
+        retval += pair.second.capacity() * sizeof(content_line_t);
+    }
+    for (const auto &pair : this->lss_user_mark_metadata) {
+        retval += sizeof(pair) +
+                  pair.second.bm_name.capacity() +
+                  pair.second.bm_comment.capacity();
+        for (const auto &tag : pair.second.bm_tags) {
+            retval += sizeof(tag) + tag.capacity();
+        }
+    }
+
+    return retval;
+}
+
+size_t logfile_sub_source::get_cache_memory() const
+{
+    size_t retval = sizeof(this->lss_line_size_cache) +
+                    this->lss_accel_track.capacity() +
+                    this->lss_token_value.capacity() +
+                    this->lss_row_text.capacity() +
+                    this->lss_row_prefix.capacity();
+
+    for (const auto ld : this->lss_files) {
+        retval += ld->ld_searched.capacity() / 8;
+    }
+
+    return retval;
+}
+
+logfile_sub_source::filtered_index_state
+logfile_sub_source::get_filtered_index_state()
+{
+    filtered_index_state retval;
+
+    retval.fis_valid = true;
+    this->get_filters().get_enabled_mask(retval.fis_in_mask,
+                                         retval.fis_out_mask);
+    retval.fis_filters.resize(logfile_filter_state::MAX_FILTERS);
+    for (auto &filter : this->get_filters()) {
+        if (filter->lf_deleted || !filter->is_enabled()) {
             continue;
         }
+        retval.fis_filters[filter->get_index()] = filter;
+    }
+    retval.fis_min_log_level = this->lss_min_log_level;
+    retval.fis_min_log_time = this->lss_min_log_time;
+    retval.fis_max_log_time = this->lss_max_log_time;
+    retval.fis_marked_only = this->lss_marked_only;
 
-        if (!la.add_point(curr_line->get_time_in_millis())) {
-            break;
+    return retval;
+}
+
+bool logfile_sub_source::filtered_index_state::is_narrowed_by(
+    const filtered_index_state &next) const
+{
+    if (!this->fis_valid || !next.fis_valid) {
+        return false;
+    }
+
+    filter_mask_t common_mask = (this->fis_in_mask | this->fis_out_mask) &
+                                (next.fis_in_mask | next.fis_out_mask);
+
+    for (int lpc = 0; lpc < logfile_filter_state::MAX_FILTERS; lpc++) {
+        if (common_mask.test(lpc) &&
+            this->fis_filters[lpc] != next.fis_filters[lpc]) {
+            // The filter in this slot was replaced.
+            return false;
         }
+    }
 
-        --vl;
+    if ((next.fis_out_mask & this->fis_out_mask) != this->fis_out_mask) {
+        return false;
+    }
+    if (this->fis_in_mask.any() &&
+        (!next.fis_in_mask.any() ||
+         (next.fis_in_mask & ~this->fis_in_mask).any())) {
+        return false;
+    }
+    if (next.fis_min_log_level < this->fis_min_log_level ||
+        next.fis_min_log_time < this->fis_min_log_time ||
+        this->fis_max_log_time < next.fis_max_log_time) {
+        return false;
+    }
+    // The set of marked lines might have changed since the last time.
+    if (this->fis_marked_only) {
+        return false;
     }
 
-    return la.get_direction();
+    return true;
 }
 
 void logfile_sub_source::text_filters_changed()
 {
+    vector<logfile *> reobserve_files;
+    vector<size_t> reobserve_starts;
+    vector<line_filter_observer *> reobserve_observers;
+    shared_ptr<text_filter> previewed;
+
+    if (this->lss_preview_filter != nullptr) {
+        // A filter that was previewed while it was being edited can use
+        // the matches that were found if it was added as it was.
+        for (auto &tf : this->get_filters()) {
+            if (!tf->lf_deleted &&
+                tf->get_index() == this->lss_preview_filter->get_index() &&
+                tf->get_type() == this->lss_preview_filter->get_type() &&
+                tf->get_id() == this->lss_preview_filter->get_id()) {
+                previewed = tf;
+            }
+        }
+    }
+
     for (auto ld : *this) {
         shared_ptr<logfile> lf = ld->get_file();
 
         if (lf != nullptr) {
             ld->ld_filter_state.clear_deleted_filter_state();
-            lf->reobserve_from(lf->begin() + ld->ld_filter_state.get_min_count(lf->size()));
-        }
-    }
-
-    uint32_t filtered_in_mask, filtered_out_mask;
+            if (previewed != nullptr &&
+                ld->ld_filter_state.lfo_preview_filter ==
+                this->lss_preview_filter) {
+                ld->ld_filter_state.commit_preview(*previewed);
+            }
+            // Filters that were run over an unchanged file before, like
+            // the ones restored with a session, can reuse those matches.
+            ld->ld_filter_state.load_cached_matches(*lf);
 
-    this->get_filters().get_enabled_mask(filtered_in_mask, filtered_out_mask);
+            size_t min_count = ld->ld_filter_state.get_min_count(lf->size());
 
-    if (this->lss_index_delegate != nullptr) {
-        this->lss_index_delegate->index_start(*this);
+            if (min_count < lf->size()) {
+                reobserve_files.push_back(lf.get());
+                reobserve_starts.push_back(min_count);
+                reobserve_observers.push_back(&ld->ld_filter_state);
+            } else {
+                lf->reobserve_from(lf->end());
+            }
+        }
     }
 
-    this->lss_filtered_index.clear();
-    for (size_t index_index = 0; index_index < this->lss_index.size(); index_index++) {
+    // Each file has its own filter state, so new filters can be run over
+    // several files at once.  The user is waiting on the result, so this
+    // goes ahead of any indexing.
+    run_concurrently(reobserve_files, [&](size_t index) {
+        logfile *lf = reobserve_files[index];
+
+        lf->reobserve_from(lf->begin() + reobserve_starts[index]);
+        reobserve_observers[index]->save_cached_matches(*lf);
+    }, task_pool::priority_t::INTERACTIVE);
+
+    filtered_index_state next_state = this->get_filtered_index_state();
+    filter_mask_t filtered_in_mask = next_state.fis_in_mask;
+    filter_mask_t filtered_out_mask = next_state.fis_out_mask;
+    bool narrowed = this->lss_filtered_index_state.is_narrowed_by(next_state);
+    // When lines can only be hidden, a delegate that supports it is told
+    // about the lines that went away instead of being given every line.
+    bool remove_lines = narrowed &&
+        this->lss_index_delegate != nullptr &&
+        this->lss_index_delegate->supports_line_removal();
+    auto is_visible = [&](size_t index_index) {
         content_line_t cl = (content_line_t) this->lss_index[index_index];
         uint64_t line_number;
         logfile_data *ld = this->find_data(cl, line_number);
         auto line_iter = ld->get_file()->begin() + line_number;
+        bool retval = !ld->ld_filter_state.excluded(
+            filtered_in_mask, filtered_out_mask, line_number) &&
+            this->check_extra_filters(*ld->get_file(), line_number);
 
-        if (!ld->ld_filter_state.excluded(filtered_in_mask, filtered_out_mask,
-                line_number) && this->check_extra_filters(*line_iter)) {
-            this->lss_filtered_index.push_back(index_index);
-            if (this->lss_index_delegate != nullptr) {
-                shared_ptr<logfile> lf = ld->get_file();
+        if (this->lss_index_delegate != nullptr) {
+            shared_ptr<logfile> lf = ld->get_file();
+
+            if (remove_lines) {
+                if (!retval) {
+                    this->lss_index_delegate->index_line_removed(
+                        *this, lf.get(), line_iter);
+                }
+            } else if (retval) {
                 this->lss_index_delegate->index_line(
-                        *this, lf.get(), lf->begin() + line_number);
+                        *this, lf.get(), line_iter);
             }
         }
+
+        return retval;
+    };
+
+    if (this->lss_index_delegate != nullptr && !remove_lines) {
+        this->lss_index_delegate->index_start(*this);
     }
 
+    if (narrowed) {
+        // Only lines that are visible now can remain visible, so just
+        // drop the ones that do not pass the new settings.
+        this->lss_filtered_index.remove_if([&](size_t index_index) {
+            return !is_visible(index_index);
+        });
+    } else {
+        this->lss_filtered_index.clear();
+        for (size_t index_index = 0;
+             index_index < this->lss_index.size();
+             index_index++) {
+            if (is_visible(index_index)) {
+                this->lss_filtered_index.push_back(index_index);
+            }
+        }
+    }
+    this->lss_filtered_index_state = std::move(next_state);
+    this->lss_snapshot_stable = 0;
+    this->lss_marked_size = 0;
+    this->lss_accel_size = 0;
+
     if (this->lss_index_delegate != nullptr) {
         this->lss_index_delegate->index_complete(*this);
     }
 
+    // The lines that are visible changed, so the effect of the filter being
+    // previewed has to be counted again.
+    for (auto ld : *this) {
+        ld->ld_filter_state.lfo_preview_counted = 0;
+        ld->ld_filter_state.lfo_preview_hidden = 0;
+        ld->ld_filter_state.lfo_preview_shown = 0;
+    }
+
     if (this->tss_view != nullptr) {
         this->tss_view->reload_data();
         this->tss_view->redo_search();
     }
 }
 
+void logfile_sub_source::text_preview_filter(shared_ptr<text_filter> tf)
+{
+    this->lss_preview_filter = tf;
+    for (auto ld : *this) {
+        ld->ld_filter_state.start_preview(tf);
+    }
+}
+
+bool logfile_sub_source::text_preview_step(logfile::deadline_t deadline)
+{
+    if (this->lss_preview_filter == nullptr) {
+        return false;
+    }
+
+    filter_mask_t in_mask, out_mask, no_mask;
+    bool include = this->lss_preview_filter->get_type() ==
+                   text_filter::INCLUDE;
+    bool retval = false;
+
+    this->get_filters().get_enabled_mask(in_mask, out_mask);
+    for (auto ld : *this) {
+        auto &lfo = ld->ld_filter_state;
+        auto lf = ld->get_file();
+
+        if (lf == nullptr) {
+            continue;
+        }
+        if (lfo.lfo_preview_filter != this->lss_preview_filter) {
+            // The file was added after the preview started.
+            lfo.start_preview(this->lss_preview_filter);
+        }
+        if (!lfo.preview_lines(deadline)) {
+            retval = true;
+        }
+
+        size_t count = std::min(lfo.get_preview_count(),
+                                lfo.lfo_filter_state.tfs_mask.size() /
+                                lfo.lfo_filter_state.tfs_mask_width);
+
+        if (!ld->ld_enabled) {
+            lfo.lfo_preview_counted = count;
+            continue;
+        }
+
+        // Compare which lines are visible now with what they would be if
+        // the filter was enabled.
+        for (size_t lpc = lfo.lfo_preview_counted; lpc < count; lpc++) {
+            if (!this->check_extra_filters(*lf, lpc)) {
+                continue;
+            }
+
+            bool matched = lfo.preview_matched(lpc);
+            bool before = !lfo.excluded(in_mask, out_mask, lpc);
+            bool after;
+
+            if (!include) {
+                after = before && !matched;
+            } else if (!in_mask.any()) {
+                after = before && matched;
+            } else {
+                after = before ||
+                        (matched && !lfo.excluded(no_mask, out_mask, lpc));
+            }
+
+            if (before && !after) {
+                lfo.lfo_preview_hidden += 1;
+            } else if (!before && after) {
+                lfo.lfo_preview_shown += 1;
+            }
+        }
+        lfo.lfo_preview_counted = std::max(lfo.lfo_preview_counted, count);
+    }
+
+    return retval;
+}
+
+nonstd::optional<text_sub_source::filter_preview>
+logfile_sub_source::text_get_filter_preview()
+{
+    if (this->lss_preview_filter == nullptr) {
+        return nonstd::nullopt;
+    }
+
+    filter_preview retval;
+    size_t index = this->lss_preview_filter->get_index();
+
+    for (auto ld : *this) {
+        auto &lfo = ld->ld_filter_state;
+        auto lf = ld->get_file();
+
+        if (lf == nullptr || lfo.lfo_preview_state == nullptr) {
+            continue;
+        }
+
+        retval.fp_line_count += lf->size();
+        retval.fp_lines_done += lfo.lfo_preview_read;
+        retval.fp_hits += lfo.lfo_preview_state->tfs_filter_hits[index];
+        retval.fp_hidden += lfo.lfo_preview_hidden;
+        retval.fp_shown += lfo.lfo_preview_shown;
+    }
+
+    return retval;
+}
+
 bool logfile_sub_source::list_input_handle_key(listview_curses &lv, int ch)
 {
     switch (ch) {
@@ -990,3 +2358,77 @@ log_location_history::loc_history_forward(vis_line_t current_top)
 
     return nonstd::nullopt;
 }
+
+void logfile_sub_source::text_scrolled(textview_curses &tc)
+{
+    static const int MAX_PREFETCH_SCREENS = 4;
+
+    vis_line_t top = tc.get_top();
+    vis_line_t height;
+    unsigned long width;
+
+    tc.get_dimensions(height, width);
+    if (top == this->lss_scroll_top || height <= 0) {
+        return;
+    }
+
+    int direction = top > this->lss_scroll_top ? 1 : -1;
+
+    if (direction == this->lss_scroll_direction) {
+        this->lss_scroll_streak += 1;
+    } else {
+        this->lss_scroll_streak = 0;
+    }
+    this->lss_scroll_direction = direction;
+    this->lss_scroll_top = top;
+
+    int screens = std::min(1 + this->lss_scroll_streak / 2,
+                           MAX_PREFETCH_SCREENS);
+    vis_line_t line_count((int) this->text_line_count());
+    vis_line_t start, end;
+
+    if (direction > 0) {
+        start = top + height;
+        end = start + vis_line_t((int) height * screens);
+    } else {
+        end = top;
+        start = end - vis_line_t((int) height * screens);
+    }
+    start = std::max(0_vl, start);
+    end = std::min(line_count, end);
+    if (start >= end) {
+        return;
+    }
+
+    // The lines can come from several files, collect the range of each
+    // file so there is one request per file.
+    std::vector<std::pair<logfile *, std::pair<size_t, size_t>>> ranges;
+
+    for (vis_line_t vl = start; vl < end; ++vl) {
+        content_line_t cl = this->at(vl);
+        logfile *lf = this->find_file_ptr(cl);
+
+        if (lf == nullptr) {
+            continue;
+        }
+
+        auto iter = std::find_if(ranges.begin(), ranges.end(),
+                                 [lf](const auto &elem) {
+                                     return elem.first == lf;
+                                 });
+
+        if (iter == ranges.end()) {
+            ranges.emplace_back(lf, std::make_pair((size_t) cl, (size_t) cl));
+        } else {
+            iter->second.first = std::min(iter->second.first, (size_t) cl);
+            iter->second.second = std::max(iter->second.second, (size_t) cl);
+        }
+    }
+
+    for (const auto &range : ranges) {
+        auto *lf = range.first;
+
+        lf->prefetch_lines(lf->begin() + range.second.first,
+                           lf->begin() + range.second.second + 1);
+    }
+}
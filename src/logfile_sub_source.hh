@@ -40,8 +40,15 @@
 #include <utility>
 #include <vector>
 #include <algorithm>
+#include <mutex>
 
+#include <sqlite3.h>
+
+
+#include "base/index_snapshot.hh"
 #include "base/lnav_log.hh"
+#include "base/rank_select_bitmap.hh"
+#include "auto_mem.hh"
 #include "log_accel.hh"
 #include "strong_int.hh"
 #include "logfile.hh"
@@ -49,6 +56,7 @@
 #include "big_array.hh"
 #include "textview_curses.hh"
 #include "filter_observer.hh"
+#include "task_pool.hh"
 
 STRONG_INT_TYPE(uint64_t, content_line);
 
@@ -66,6 +74,22 @@ public:
 
     };
 
+    /**
+     * @return True if the delegate can be told about lines that were hidden
+     *   by a change to the filters, instead of starting over.
+     */
+    virtual bool supports_line_removal() const {
+        return false;
+    };
+
+    /**
+     * Called for each line that was visible and is now hidden because the
+     * filters were narrowed, if supports_line_removal() is true.
+     */
+    virtual void index_line_removed(logfile_sub_source &lss, logfile *lf, logfile::iterator ll) {
+
+    };
+
     virtual void index_complete(logfile_sub_source &lss) {
 
     };
@@ -80,13 +104,26 @@ public:
 
     ~pcre_filter() override { };
 
-    bool matches(const logfile &lf, const logline &ll, shared_buffer_ref &line) override {
+    bool matches(const logfile &lf, logfile::const_iterator ll,
+                 shared_buffer_ref &line) override {
         pcre_context_static<30> pc;
         pcre_input pi(line.get_data(), 0, line.length());
 
         return this->pf_pcre.match(pc, pi);
     };
 
+    std::string get_required_literal() override {
+        return pcrepp::required_literal(this->lf_id.c_str());
+    };
+
+    bool is_over_budget() const override {
+        return this->pf_pcre.is_over_budget();
+    };
+
+    std::string get_match_cache_key() override {
+        return "regex:" + this->lf_id;
+    };
+
     std::string to_command() override {
         return (this->lf_type == text_filter::INCLUDE ?
                 "filter-in " : "filter-out ") +
@@ -97,6 +134,56 @@ protected:
     pcrepp pf_pcre;
 };
 
+/**
+ * A filter that only shows messages where an SQL expression is true.  The
+ * expression is compiled once into a statement and the values extracted
+ * from each message are bound to the parameters that have the same name,
+ * for example ":sc_status >= 500".  The ":log_level", ":log_path" and
+ * ":log_text" parameters are also available.
+ */
+class sql_filter
+    : public text_filter {
+public:
+    sql_filter(const std::string id, size_t index, sqlite3_stmt *stmt);
+
+    ~sql_filter() override { };
+
+    bool matches(const logfile &lf, logfile::const_iterator ll,
+                 shared_buffer_ref &line) override;
+
+    std::string get_match_cache_key() override {
+        return "sql:" + this->lf_id;
+    };
+
+    std::string to_command() override {
+        return "filter-expr " + this->lf_id;
+    };
+
+protected:
+    /**
+     * The filters run on worker threads, the statement can only be used by
+     * one of them at a time.
+     */
+    std::mutex sf_mutex;
+    auto_mem<sqlite3_stmt> sf_stmt;
+    /** The parameter names without the leading colon, by bind index. */
+    std::vector<std::string> sf_param_names;
+};
+
+/**
+ * Run the given work for each file on a pool of worker threads.  The
+ * logfile_observers of the files are swapped out while the work runs and
+ * the progress is forwarded to them from the calling thread.
+ *
+ * @param files The files to work on.
+ * @param work The function to call with the index of each file.
+ * @param prio The priority class of the tasks in the pool.
+ */
+void run_concurrently(const std::vector<logfile *> &files,
+                      const std::function<void(size_t)> &work,
+                      task_pool::priority_t prio =
+                          task_pool::priority_t::BACKGROUND);
+
 class log_location_history : public location_history {
 public:
     log_location_history(logfile_sub_source &lss)
@@ -284,6 +371,15 @@ public:
         return this->lss_longest_line;
     };
 
+    /**
+     * @return A number that changes whenever the lines in a file are
+     *   replaced or a file is removed, so anything that refers to content
+     *   lines, other than through new lines, needs to be rebuilt.
+     */
+    size_t get_index_generation() const {
+        return this->lss_index_generation;
+    };
+
     size_t file_count() const {
         size_t retval = 0;
         const_iterator iter;
@@ -304,6 +400,13 @@ public:
                              std::string &value_out,
                              line_flags_t flags);
 
+    size_t text_raw_values_for_lines(textview_curses &tc,
+                                     int row,
+                                     int stop_row,
+                                     size_t max_lines,
+                                     std::string &chunk_out,
+                                     std::vector<std::pair<size_t, size_t>> &spans_out);
+
     void text_attrs_for_line(textview_curses &tc,
                              int row,
                              string_attrs_t &value_out);
@@ -355,6 +458,42 @@ public:
         }
     };
 
+    void text_mark_batch(bookmark_type_t *bm,
+                         const std::vector<vis_line_t> &lines,
+                         bool added)
+    {
+        if (bm == &textview_curses::BM_USER ||
+            bm == &textview_curses::BM_META) {
+            text_sub_source::text_mark_batch(bm, lines, added);
+            return;
+        }
+
+        std::vector<content_line_t> cls;
+
+        cls.reserve(lines.size());
+        for (const auto &vl : lines) {
+            if (vl >= (int) this->lss_index.size()) {
+                continue;
+            }
+            cls.push_back(this->at(vl));
+        }
+
+        auto &bv = this->lss_user_marks[bm];
+
+        if (added) {
+            bv.insert_batch(cls);
+            return;
+        }
+
+        std::sort(cls.begin(), cls.end());
+        bv.erase(std::remove_if(bv.begin(), bv.end(),
+                                [&cls](const content_line_t cl) {
+                                    return std::binary_search(
+                                        cls.begin(), cls.end(), cl);
+                                }),
+                 bv.end());
+    };
+
     void text_clear_marks(bookmark_type_t *bm)
     {
         std::vector<content_line_t>::iterator iter;
@@ -373,19 +512,65 @@ public:
         } else {
             this->lss_user_marks[bm].clear();
         }
+        this->lss_user_marks_changed = true;
+        if (bm == &textview_curses::BM_SEARCH) {
+            for (auto ld : this->lss_files) {
+                ld->ld_searched.clear();
+            }
+        }
+    };
+
+    bool text_caches_search() {
+        return true;
+    };
+
+    bool text_is_row_cacheable() const {
+        return true;
+    };
+
+    /**
+     * Start loading the lines that are about to scroll into view.  The
+     * further the view keeps scrolling in one direction, the more screens
+     * ahead are loaded.
+     */
+    void text_scrolled(textview_curses &tc);
+
+    void text_mark_searched(vis_line_t start, vis_line_t stop, bool searched);
+
+    bool text_is_searched(vis_line_t line) {
+        if (line < 0 || line >= (int) this->lss_filtered_index.size()) {
+            return false;
+        }
+
+        uint64_t line_number;
+        logfile_data *ld = this->find_data(this->at(line), line_number);
+
+        return line_number < ld->ld_searched.size() &&
+               ld->ld_searched[line_number];
+    };
+
+    bool text_line_may_contain(vis_line_t line, const std::string &literal) {
+        if (line < 0 || line >= (int) this->lss_filtered_index.size()) {
+            return true;
+        }
+
+        uint64_t line_number;
+        logfile_data *ld = this->find_data(this->at(line), line_number);
+
+        auto &lf = ld->ld_filter_state.lfo_filter_state.tfs_logfile;
+
+        return lf == nullptr || lf->line_may_contain(line_number, literal);
     };
 
     bool insert_file(std::shared_ptr<logfile> lf)
     {
         iterator existing;
 
-        require(lf->size() < MAX_LINES_PER_FILE);
-
         existing = std::find_if(this->lss_files.begin(),
                                 this->lss_files.end(),
                                 logfile_data_eq(NULL));
         if (existing == this->lss_files.end()) {
-            if (this->lss_files.size() >= MAX_FILES) {
+            if (this->lss_extents.size() >= MAX_EXTENTS) {
                 return false;
             }
 
@@ -408,27 +593,29 @@ public:
                             logfile_data_eq(lf));
         if (iter != this->lss_files.end()) {
             bookmarks<content_line_t>::type::iterator mark_iter;
-            int file_index = iter - this->lss_files.begin();
 
             (*iter)->clear();
+            this->lss_index_generation += 1;
             for (mark_iter = this->lss_user_marks.begin();
                  mark_iter != this->lss_user_marks.end();
                  ++mark_iter) {
-                content_line_t mark_curr = content_line_t(
-                    file_index * MAX_LINES_PER_FILE);
-                content_line_t mark_end = content_line_t(
-                    (file_index + 1) * MAX_LINES_PER_FILE);
-                bookmark_vector<content_line_t>::iterator bv_iter;
-                bookmark_vector<content_line_t> &         bv =
-                    mark_iter->second;
-
-                while ((bv_iter =
-                            std::lower_bound(bv.begin(), bv.end(),
-                                             mark_curr)) != bv.end()) {
-                    if (*bv_iter >= mark_end) {
-                        break;
+                for (auto extent : (*iter)->ld_extents) {
+                    content_line_t mark_curr = content_line_t(
+                        (uint64_t) extent << EXTENT_BITS);
+                    content_line_t mark_end = content_line_t(
+                        ((uint64_t) extent + 1) << EXTENT_BITS);
+                    bookmark_vector<content_line_t>::iterator bv_iter;
+                    bookmark_vector<content_line_t> &         bv =
+                        mark_iter->second;
+
+                    while ((bv_iter =
+                                std::lower_bound(bv.begin(), bv.end(),
+                                                 mark_curr)) != bv.end()) {
+                        if (*bv_iter >= mark_end) {
+                            break;
+                        }
+                        mark_iter->second.erase(bv_iter);
                     }
-                    mark_iter->second.erase(bv_iter);
                 }
             }
 
@@ -442,17 +629,42 @@ public:
         rr_full_rebuild,
     };
 
-    rebuild_result rebuild_index();
+    /**
+     * Index any new data in the files and merge it into the view.
+     *
+     * @param deadline Passed on to logfile::rebuild_index() so that large
+     * amounts of new data are merged in slices.  Check is_indexing_incomplete()
+     * to find out if another call is needed to catch up.
+     */
+    rebuild_result rebuild_index(logfile::deadline_t deadline = nonstd::nullopt);
+
+    /**
+     * @return True if one or more files stopped indexing at the deadline
+     * passed to the last call to rebuild_index().
+     */
+    bool is_indexing_incomplete() const {
+        for (const auto &ld : this->lss_files) {
+            auto lf = ld->get_file();
+
+            if (lf != nullptr && lf->is_indexing_incomplete()) {
+                return true;
+            }
+        }
+
+        return false;
+    };
 
     void text_update_marks(vis_bookmarks &bm);
 
     void set_user_mark(bookmark_type_t *bm, content_line_t cl)
     {
         this->lss_user_marks[bm].insert_once(cl);
+        this->lss_user_marks_changed = true;
     };
 
     bookmarks<content_line_t>::type &get_user_bookmarks()
     {
+        this->lss_user_marks_changed = true;
         return this->lss_user_marks;
     };
 
@@ -464,6 +676,29 @@ public:
         return this->lss_index.size() - this->lss_filtered_index.size();
     };
 
+    /**
+     * @return The number of bytes used by lss_index and the tables that
+     *   map between it and the lines of the files.
+     */
+    size_t get_index_memory() const;
+
+    /** @return The number of bytes used by lss_filtered_index. */
+    size_t get_filtered_index_memory() const {
+        return this->lss_filtered_index.get_memory_usage();
+    };
+
+    /** @return The number of bytes used by the filter masks of the files. */
+    size_t get_filter_mask_memory() const;
+
+    /** @return The number of bytes used by the user's bookmarks. */
+    size_t get_bookmark_memory() const;
+
+    /**
+     * @return The number of bytes used by state that is derived from the
+     *   index to speed up drawing and searching.
+     */
+    size_t get_cache_memory() const;
+
     int get_filtered_count_for(size_t filter_index) const {
         int retval = 0;
 
@@ -474,14 +709,38 @@ public:
         return retval;
     }
 
+    void text_preview_filter(std::shared_ptr<text_filter> tf) override;
+
+    bool text_preview_step(logfile::deadline_t deadline) override;
+
+    nonstd::optional<filter_preview> text_get_filter_preview() override;
+
     std::shared_ptr<logfile> find(const char *fn, content_line_t &line_base);
 
     std::shared_ptr<logfile> find(content_line_t &line)
     {
+        const content_extent &ce = this->lss_extents[line >> EXTENT_BITS];
         std::shared_ptr<logfile> retval;
 
-        retval = this->lss_files[line / MAX_LINES_PER_FILE]->get_file();
-        line   = content_line_t(line % MAX_LINES_PER_FILE);
+        retval = this->lss_files[ce.ce_file_index]->get_file();
+        line   = content_line_t(((uint64_t) ce.ce_ordinal << EXTENT_BITS) |
+                                (line & EXTENT_MASK));
+
+        return retval;
+    };
+
+    /**
+     * Like find(), but without the cost of copying the shared_ptr, for
+     * callers that only need the file for as long as it is in the source.
+     */
+    logfile *find_file_ptr(content_line_t &line)
+    {
+        const content_extent &ce = this->lss_extents[line >> EXTENT_BITS];
+        logfile *retval;
+
+        retval = this->lss_files[ce.ce_file_index]->get_file_ptr();
+        line   = content_line_t(((uint64_t) ce.ce_ordinal << EXTENT_BITS) |
+                                (line & EXTENT_MASK));
 
         return retval;
     };
@@ -489,7 +748,7 @@ public:
     logline *find_line(content_line_t line)
     {
         logline *retval = nullptr;
-        std::shared_ptr<logfile> lf = this->find(line);
+        logfile *lf = this->find_file_ptr(line);
 
         if (lf != nullptr) {
             auto ll_iter = lf->begin() + line;
@@ -518,34 +777,25 @@ public:
     };
 
     nonstd::optional<vis_line_t> find_from_content(content_line_t cl) {
-        content_line_t line = cl;
-        std::shared_ptr<logfile> lf = this->find(line);
-
-        if (lf != nullptr) {
-            auto ll_iter = lf->begin() + line;
-            auto &ll = *ll_iter;
-            vis_line_t vis_start = this->find_from_time(ll.get_timeval());
+        auto index_opt = this->index_for_content(cl);
 
-            while (vis_start < this->text_line_count()) {
-                content_line_t guess_cl = this->at(vis_start);
-
-                if (cl == guess_cl) {
-                    return vis_start;
-                }
-
-                auto guess_line = this->find_line(guess_cl);
-
-                if (!guess_line || ll < *guess_line) {
-                    return nonstd::nullopt;
-                }
+        if (!index_opt) {
+            return nonstd::nullopt;
+        }
 
-                ++vis_start;
-            }
+        if (!this->lss_filtered_index.test(index_opt.value())) {
+            return nonstd::nullopt;
         }
 
-        return nonstd::nullopt;
+        return vis_line_t(this->lss_filtered_index.rank(index_opt.value()));
     }
 
+    /**
+     * @param cl The content line to look for.
+     * @return The position of the line in lss_index, if it has been indexed.
+     */
+    nonstd::optional<size_t> index_for_content(content_line_t cl);
+
     struct timeval time_for_row(int row) {
         return this->find_line(this->at(vis_line_t(row)))->get_timeval();
     };
@@ -555,7 +805,8 @@ public:
     };
 
     content_line_t at(vis_line_t vl) {
-        return this->lss_index[this->lss_filtered_index[vl]];
+        return this->lss_index[
+            this->lss_filtered_index.select(vl, this->lss_filtered_hint)];
     };
 
     content_line_t at_base(vis_line_t vl) {
@@ -566,6 +817,44 @@ public:
         return this->at(vl);
     };
 
+    /**
+     * @return True if all of the files have an index of their operation IDs,
+     *   files that were loaded from the index cache do not.
+     */
+    bool has_opid_index() const;
+
+    /**
+     * Find the closest visible message with the given operation ID using the
+     * opid index of each file.
+     *
+     * @param opid The operation ID to look for.
+     * @param start The line to start searching from, it is not included.
+     * @param forward True to search after the start, false to search before.
+     * @return The visible line of the message, if one was found.
+     */
+    nonstd::optional<vis_line_t> find_opid(const std::string &opid,
+                                           vis_line_t start,
+                                           bool forward);
+
+    using snapshot_t = index_snapshot<content_line_t>;
+
+    /**
+     * Get an immutable copy of the content lines of the visible lines that
+     * can be read by other threads while the index is rebuilt.  The same
+     * snapshot is returned until the index changes, and the chunks of the
+     * previous snapshot are reused when lines have only been appended.
+     * Note that the snapshot only covers the order of the lines, the files
+     * themselves are not copied.  The SQL log tables read the rows of a
+     * query through one of these, so the rows do not shift if lines are
+     * merged into the index while the statement is still open.
+     */
+    std::shared_ptr<const snapshot_t> get_index_snapshot();
+
+    /**
+     * @param vl The visible line.
+     * @return The direction of the message rate at the given line, which
+     *   is worked out from the times of the messages before it.
+     */
     log_accel::direction_t get_line_accel_direction(vis_line_t vl);
 
     /**
@@ -584,6 +873,8 @@ public:
         void clear()
         {
             this->ld_filter_state.lfo_filter_state.clear();
+            this->ld_searched.clear();
+            this->ld_index_positions.clear();
         };
 
         void set_enabled(bool enabled) {
@@ -599,10 +890,25 @@ public:
             return this->ld_filter_state.lfo_filter_state.tfs_logfile;
         };
 
+        logfile *get_file_ptr() const {
+            return this->ld_filter_state.lfo_filter_state.tfs_logfile.get();
+        };
+
         size_t ld_file_index;
+        std::vector<uint32_t> ld_extents;
         line_filter_observer ld_filter_state;
         size_t ld_lines_indexed;
         bool ld_enabled;
+        /**
+         * The lines in this file that have been searched with the current
+         * search, the hits are kept in lss_user_marks[&BM_SEARCH].
+         */
+        std::vector<bool> ld_searched;
+        /**
+         * The position of each line of this file in lss_index, this is
+         * filled in lazily by index_for_content().
+         */
+        std::vector<uint32_t> ld_index_positions;
     };
 
     typedef std::vector<logfile_data *>::iterator iterator;
@@ -630,18 +936,42 @@ public:
 
     logfile_data *find_data(content_line_t line, uint64_t &offset_out)
     {
+        const content_extent &ce = this->lss_extents[line >> EXTENT_BITS];
         logfile_data *retval;
 
-        retval = this->lss_files[line / MAX_LINES_PER_FILE];
-        offset_out = line % MAX_LINES_PER_FILE;
+        retval = this->lss_files[ce.ce_file_index];
+        offset_out = ((uint64_t) ce.ce_ordinal << EXTENT_BITS) |
+                     (line & EXTENT_MASK);
 
         return retval;
     };
 
-    content_line_t get_file_base_content_line(iterator iter) {
-        ssize_t index = std::distance(this->begin(), iter);
+    /**
+     * @param ld The file that contains the line.
+     * @param line The index of the line in the file.
+     * @return The content line for the given line in the file.  Extents of
+     *   content lines are handed out to the file as it grows.
+     */
+    content_line_t get_content_line(logfile_data *ld, uint64_t line) {
+        uint64_t ordinal = line >> EXTENT_BITS;
+
+        while (ordinal >= ld->ld_extents.size()) {
+            require(this->lss_extents.size() < MAX_EXTENTS);
+
+            ld->ld_extents.push_back(this->lss_extents.size());
+            this->lss_extents.push_back({
+                (uint32_t) ld->ld_file_index,
+                (uint32_t) (ld->ld_extents.size() - 1),
+            });
+        }
 
-        return content_line_t(index * MAX_LINES_PER_FILE);
+        return content_line_t(
+            ((uint64_t) ld->ld_extents[ordinal] << EXTENT_BITS) |
+            (line & EXTENT_MASK));
+    };
+
+    content_line_t get_file_base_content_line(iterator iter) {
+        return this->get_content_line(*iter, 0);
     };
 
     void set_index_delegate(index_delegate *id) {
@@ -655,6 +985,9 @@ public:
         return this->lss_index_delegate;
     };
 
+    /** Compute the rate directions for the visible lines up to 'end'. */
+    void extend_accel_track(size_t end);
+
     void reload_index_delegate() {
         if (this->lss_index_delegate == nullptr) {
             return;
@@ -747,12 +1080,22 @@ public:
     };
 
     static const uint64_t MAX_CONTENT_LINES = (1ULL << 40) - 1;
-    static const uint64_t MAX_LINES_PER_FILE = 256 * 1024 * 1024;
-    static const uint64_t MAX_FILES          = (
-        MAX_CONTENT_LINES / MAX_LINES_PER_FILE);
+    /**
+     * Content lines are given out to files in extents of this many lines,
+     * so neither the number of files nor the lines in a file have a fixed
+     * limit, only their total.
+     */
+    static const uint64_t EXTENT_BITS = 20;
+    static const uint64_t EXTENT_MASK = (1ULL << EXTENT_BITS) - 1;
+    static const uint64_t MAX_EXTENTS = (MAX_CONTENT_LINES + 1) >> EXTENT_BITS;
 
 private:
     static const size_t LINE_SIZE_CACHE_SIZE = 512;
+    /**
+     * The least amount of a line that is read to draw it, see
+     * text_value_for_line().
+     */
+    static const size_t MIN_ROW_READ_SIZE = 64 * 1024;
 
     enum {
         B_SCRUB,
@@ -770,6 +1113,11 @@ private:
         F_NAME_MASK   = (F_FILENAME | F_BASENAME),
     };
 
+    struct content_extent {
+        uint32_t ce_file_index;
+        uint32_t ce_ordinal;    /*< The position of the extent in the file. */
+    };
+
     struct __attribute__((__packed__)) indexed_content {
         indexed_content() {
 
@@ -838,6 +1186,13 @@ private:
                 : llss_controller(lc) { };
         bool operator()(const uint32_t &lhs, const uint32_t &rhs) const
         {
+            uint64_t lhs_millis = llss_controller.lss_index_times[lhs];
+            uint64_t rhs_millis = llss_controller.lss_index_times[rhs];
+
+            if (lhs_millis != rhs_millis) {
+                return lhs_millis < rhs_millis;
+            }
+
             content_line_t cl_lhs = (content_line_t)
                     llss_controller.lss_index[lhs];
             content_line_t cl_rhs = (content_line_t)
@@ -850,11 +1205,8 @@ private:
 
         bool operator()(const uint32_t &lhs, const struct timeval &rhs) const
         {
-            content_line_t cl_lhs = (content_line_t)
-                    llss_controller.lss_index[lhs];
-            logline *ll_lhs = this->llss_controller.find_line(cl_lhs);
-
-            return (*ll_lhs) < rhs;
+            return llss_controller.lss_index_times[lhs] <
+                   (uint64_t) rhs.tv_sec * 1000ULL + rhs.tv_usec / 1000;
         };
 
         logfile_sub_source & llss_controller;
@@ -874,9 +1226,113 @@ private:
         std::shared_ptr<logfile> lde_file;
     };
 
+    /**
+     * Call rebuild_index() on the given files.  Files that have locked onto a
+     * format and have new data are indexed concurrently by a pool of worker
+     * threads, the rest are indexed on the calling thread.
+     *
+     * @param files The files to index.
+     * @param deadline The time at which each file should stop indexing.
+     * @return The result of indexing each file, in the same order as the
+     * given files.
+     */
+    std::vector<logfile::rebuild_result_t> rebuild_files(
+        const std::vector<logfile_data *> &files,
+        logfile::deadline_t deadline);
+
+    /**
+     * Remove the lines at the end of the index that are newer than the given
+     * line so that they are merged again along with the new lines.  This is
+     * only done when the line is within /tuning/index/reorder-window of the
+     * last line in the index.
+     *
+     * @param first_new The oldest of the new lines.
+     * @return False if the line is older than the window or the lines
+     *   cannot be taken out, the index is left unchanged in that case.
+     */
+    bool rewind_index(const logline &first_new);
+
+    void push_index_line(content_line_t cl, uint64_t millis) {
+        uint64_t partition = millis / INDEX_PARTITION_MILLIS;
+
+        if (this->lss_index_partitions.empty() ||
+            this->lss_index_partitions.back().first != partition) {
+            this->lss_index_partitions.emplace_back(partition,
+                                                    this->lss_index.size());
+        }
+        this->lss_index.push_back(cl);
+        this->lss_index_times.push_back(millis);
+    };
+
+    /**
+     * Find the partition of lss_index that would hold a line with the given
+     * time.
+     *
+     * @param millis The time to look for.
+     * @return The range of positions in lss_index covered by the partition,
+     *   the range is empty if there are no lines in that partition and
+     *   starts where the next partition starts.
+     */
+    std::pair<size_t, size_t> find_index_partition(uint64_t millis) const;
+
+    /** Remove the partitions for the positions at or after new_size. */
+    void truncate_index_partitions(size_t new_size) {
+        while (!this->lss_index_partitions.empty() &&
+               this->lss_index_partitions.back().second >= new_size) {
+            this->lss_index_partitions.pop_back();
+        }
+    };
+
+    /**
+     * Drop the search hits and searched lines for a file whose lines have
+     * been replaced.
+     */
+    void forget_search(logfile_data &ld);
+
     void clear_line_size_cache() {
         memset(this->lss_line_size_cache, 0, sizeof(this->lss_line_size_cache));
         this->lss_line_size_cache[0].first = -1;
+        if (this->tss_view != nullptr) {
+            this->tss_view->invalidate_row_cache();
+        }
+    };
+
+    static uint64_t to_millis(const struct timeval &tv) {
+        if (tv.tv_sec < 0) {
+            return 0;
+        }
+        if ((uint64_t) tv.tv_sec >= UINT64_MAX / 1000ULL - 1) {
+            return UINT64_MAX;
+        }
+
+        return tv.tv_sec * 1000ULL + tv.tv_usec / 1000;
+    };
+
+    bool check_extra_filters(const logfile &lf, size_t line_number) {
+        const logfile::level_block *lb = lf.get_level_block(line_number);
+
+        if (lb != nullptr) {
+            // Use the block summary to decide for all of the lines in the
+            // block at once, when possible.
+            uint32_t level_mask =
+                logfile::level_mask_at_least(this->lss_min_log_level);
+            uint64_t min_time = to_millis(this->lss_min_log_time);
+            uint64_t max_time = to_millis(this->lss_max_log_time);
+
+            if ((lb->lb_mask & level_mask) == 0 ||
+                lb->lb_max_time < min_time ||
+                max_time < lb->lb_min_time) {
+                return false;
+            }
+            if (!this->lss_marked_only &&
+                (lb->lb_mask & ~level_mask) == 0 &&
+                min_time <= lb->lb_min_time &&
+                lb->lb_max_time <= max_time) {
+                return true;
+            }
+        }
+
+        return this->check_extra_filters(lf.begin()[line_number]);
     };
 
     bool check_extra_filters(const logline &ll) {
@@ -890,21 +1346,112 @@ private:
             ll <= this->lss_max_log_time);
     };
 
+    /**
+     * The settings that lss_filtered_index was last computed with.  When a
+     * change to the settings can only hide more lines, the filtered index
+     * can be pruned instead of being recomputed from the whole index.
+     */
+    struct filtered_index_state {
+        bool fis_valid{false};
+        filter_mask_t fis_in_mask;
+        filter_mask_t fis_out_mask;
+        std::vector<std::shared_ptr<text_filter>> fis_filters;
+        log_level_t fis_min_log_level{LEVEL_UNKNOWN};
+        struct timeval fis_min_log_time{0, 0};
+        struct timeval fis_max_log_time{0, 0};
+        bool fis_marked_only{false};
+
+        /**
+         * @return True if every line that is visible with the next settings
+         *   was also visible with these settings.
+         */
+        bool is_narrowed_by(const filtered_index_state &next) const;
+    };
+
+    filtered_index_state get_filtered_index_state();
+
     size_t                    lss_basename_width = 0;
     size_t                    lss_filename_width = 0;
     unsigned long             lss_flags;
     bool lss_force_rebuild;
     std::vector<logfile_data *> lss_files;
+    std::vector<content_extent> lss_extents;
 
     big_array<indexed_content> lss_index;
-    std::vector<uint32_t> lss_filtered_index;
+    /**
+     * The time in milliseconds of each line in lss_index, so that searches
+     * by time do not have to look up the loglines.
+     */
+    big_array<uint64_t> lss_index_times;
+    /** True once lss_index has been given a file to live in, if enabled. */
+    bool lss_index_backing_tried{false};
+    /** The span of time covered by each entry in lss_index_partitions. */
+    static const uint64_t INDEX_PARTITION_MILLIS = 60 * 60 * 1000;
+    /**
+     * The lines in lss_index are in time-order, so they are split up into
+     * partitions of an hour each to narrow down searches by time over long
+     * spans of logs.  Each entry is the partition number, the time divided
+     * by INDEX_PARTITION_MILLIS, and the position of the first line in
+     * lss_index that is in that partition.  Only partitions with lines are
+     * kept, so this stays small even for weeks of logs.
+     */
+    std::vector<std::pair<uint64_t, size_t>> lss_index_partitions;
+    /** The last snapshot returned by get_index_snapshot(). */
+    std::shared_ptr<const snapshot_t> lss_snapshot;
+    /**
+     * The number of visible lines at the start of lss_filtered_index that
+     * have not changed since lss_snapshot was created.
+     */
+    size_t lss_snapshot_stable{0};
+    /**
+     * The positions of the lines in lss_index that pass the filters, kept
+     * as a bitmap with one bit for each line in lss_index.
+     */
+    rank_select_bitmap lss_filtered_index;
+    /** The last line looked up by at(), consecutive lines are common. */
+    rank_select_bitmap::select_hint lss_filtered_hint;
+    filtered_index_state lss_filtered_index_state;
+    /** The filter being edited, see text_preview_filter(). */
+    std::shared_ptr<text_filter> lss_preview_filter;
+    /**
+     * The number of lines at the start of lss_filtered_index that the
+     * bookmarks in lss_marked_bookmarks are up-to-date for.  Lines that are
+     * appended to the index are the only ones that need to be looked at by
+     * text_update_marks().
+     */
+    size_t lss_marked_size{0};
+    vis_bookmarks *lss_marked_bookmarks{nullptr};
+    /**
+     * True if lss_user_marks was changed without the view knowing, so all
+     * of the marks need to be mapped to visible lines again.
+     */
+    bool lss_user_marks_changed{true};
+    /**
+     * The direction of the message rate at each visible line, packed into
+     * two bits per line.  The direction only depends on the lines before
+     * it, so the track is extended as later lines are looked at and only
+     * needs to be recomputed when lss_filtered_index changes.
+     */
+    std::vector<uint8_t> lss_accel_track;
+    /** The number of lines at the start of lss_accel_track that are valid. */
+    size_t lss_accel_size{0};
+    /**
+     * The number of lines at the start of lss_index whose positions have
+     * been recorded in the ld_index_positions of their file.
+     */
+    size_t lss_reverse_indexed{0};
 
     bookmarks<content_line_t>::type lss_user_marks;
+    size_t lss_index_generation{0};
     std::map<content_line_t, bookmark_metadata> lss_user_mark_metadata;
 
     line_flags_t lss_token_flags;
     std::shared_ptr<logfile> lss_token_file;
     std::string       lss_token_value;
+    /** The line as displayed, if it is different from lss_token_value. */
+    std::string       lss_row_text;
+    /** The decorations displayed in front of the line. */
+    std::string       lss_row_prefix;
     string_attrs_t    lss_token_attrs;
     std::vector<logline_value> lss_token_values;
     int lss_token_shift_start;
@@ -912,6 +1459,9 @@ private:
     shared_buffer     lss_share_manager;
     logfile::iterator lss_token_line;
     std::pair<int, size_t> lss_line_size_cache[LINE_SIZE_CACHE_SIZE];
+    vis_line_t lss_scroll_top{-1};
+    int lss_scroll_direction{0};
+    int lss_scroll_streak{0};
     log_level_t  lss_min_log_level;
     struct timeval    lss_min_log_time;
     struct timeval    lss_max_log_time;
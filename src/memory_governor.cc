@@ -0,0 +1,240 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file memory_governor.cc
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+
+#include <algorithm>
+#include <fstream>
+
+#include "base/lnav_log.hh"
+#include "lnav_config.hh"
+#include "memory_governor.hh"
+
+using namespace std;
+
+/** The percentage of the system limit used when no limit is configured. */
+static const size_t AUTO_LIMIT_PERCENT = 75;
+
+/**
+ * The percentage of the limit that the caches are shed down to, so that
+ * the caches are not shed again as soon as they start to refill.
+ */
+static const size_t LOW_WATER_PERCENT = 90;
+
+static const auto CHECK_INTERVAL = chrono::seconds(1);
+
+memory_governor &memory_governor::singleton()
+{
+    static memory_governor retval;
+
+    return retval;
+}
+
+void memory_governor::register_cache(const std::string &name,
+                                     int cost,
+                                     usage_func usage,
+                                     shed_func shed)
+{
+    cache c;
+
+    c.c_name = name;
+    c.c_cost = cost;
+    c.c_usage = std::move(usage);
+    c.c_shed = std::move(shed);
+
+    auto iter = upper_bound(this->mg_caches.begin(), this->mg_caches.end(),
+                            cost,
+                            [](int lhs, const cache &rhs) {
+                                return lhs < rhs.c_cost;
+                            });
+    this->mg_caches.insert(iter, std::move(c));
+}
+
+size_t memory_governor::read_rss()
+{
+#ifdef __APPLE__
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+
+    if (task_info(mach_task_self(),
+                  MACH_TASK_BASIC_INFO,
+                  (task_info_t) &info,
+                  &count) == KERN_SUCCESS) {
+        return info.resident_size;
+    }
+
+    return 0;
+#else
+    ifstream statm("/proc/self/statm");
+    size_t pages, resident;
+
+    if (!(statm >> pages >> resident)) {
+        return 0;
+    }
+
+    return resident * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+/**
+ * @return The value in the given cgroup file or zero if there is no limit.
+ */
+static size_t read_cgroup_limit(const string &path)
+{
+    ifstream file(path);
+    string value;
+
+    if (!(file >> value) || value == "max") {
+        return 0;
+    }
+
+    auto retval = strtoull(value.c_str(), nullptr, 10);
+
+    // cgroup v1 reports a huge number when there is no limit.
+    if (retval >= (1ULL << 62)) {
+        return 0;
+    }
+
+    return retval;
+}
+
+size_t memory_governor::detect_system_limit()
+{
+    size_t retval = 0;
+    long pages = sysconf(_SC_PHYS_PAGES);
+
+    if (pages > 0) {
+        retval = (size_t) pages * sysconf(_SC_PAGESIZE);
+    }
+
+    ifstream cgroups("/proc/self/cgroup");
+    string line;
+    size_t cg_limit = 0;
+
+    while (getline(cgroups, line)) {
+        if (line.compare(0, 3, "0::") == 0) {
+            cg_limit = read_cgroup_limit(
+                "/sys/fs/cgroup" + line.substr(3) + "/memory.max");
+            break;
+        }
+    }
+    if (cg_limit == 0) {
+        cg_limit = read_cgroup_limit(
+            "/sys/fs/cgroup/memory/memory.limit_in_bytes");
+    }
+    if (cg_limit > 0 && (retval == 0 || cg_limit < retval)) {
+        retval = cg_limit;
+    }
+
+    log_info("detected memory limit: %zu", retval);
+
+    return retval;
+}
+
+size_t memory_governor::get_limit()
+{
+    if (lnav_config.lc_tuning_memory_limit > 0) {
+        return lnav_config.lc_tuning_memory_limit;
+    }
+
+    if (!this->mg_system_limit_detected) {
+        this->mg_system_limit = detect_system_limit();
+        this->mg_system_limit_detected = true;
+    }
+
+    return this->mg_system_limit / 100 * AUTO_LIMIT_PERCENT;
+}
+
+size_t memory_governor::check()
+{
+    auto now = chrono::steady_clock::now();
+
+    if (now - this->mg_last_check < CHECK_INTERVAL) {
+        return 0;
+    }
+    this->mg_last_check = now;
+
+    size_t limit = this->get_limit();
+    size_t rss = read_rss();
+
+    if (limit == 0 || rss <= limit) {
+        return 0;
+    }
+
+    size_t low_water = limit / 100 * LOW_WATER_PERCENT;
+
+    log_info("memory usage is over the limit, shedding caches -- "
+             "rss=%zu; limit=%zu",
+             rss, limit);
+
+    return this->shed(rss - low_water);
+}
+
+size_t memory_governor::shed(size_t amount)
+{
+    size_t retval = 0;
+
+    for (auto &c : this->mg_caches) {
+        if (retval >= amount) {
+            break;
+        }
+
+        if (c.c_usage() == 0) {
+            continue;
+        }
+
+        size_t freed = c.c_shed(amount - retval);
+
+        if (freed > 0) {
+            log_info("  shed %zu bytes from cache: %s",
+                     freed, c.c_name.c_str());
+            c.c_sheds += 1;
+            c.c_shed_bytes += freed;
+            retval += freed;
+        }
+    }
+
+    if (retval > 0) {
+        this->mg_sheds += 1;
+        this->mg_shed_bytes += retval;
+    }
+
+    return retval;
+}
@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file memory_governor.hh
+ */
+
+#ifndef lnav_memory_governor_hh
+#define lnav_memory_governor_hh
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Keeps the memory used by lnav under a limit by shedding the contents of
+ * the caches that have registered with it.  The resident size of the
+ * process is checked periodically from the main loop and, when it goes over
+ * the limit, the caches that are cheapest to refill are asked to free
+ * memory first.  The limit defaults to a fraction of the cgroup memory limit
+ * or the physical memory, whichever is smaller.
+ */
+class memory_governor {
+public:
+    /** @return The number of bytes currently used by a cache. */
+    using usage_func = std::function<size_t()>;
+
+    /**
+     * Free at least the given number of bytes from a cache, if possible.
+     *
+     * @return The number of bytes that were freed.
+     */
+    using shed_func = std::function<size_t(size_t)>;
+
+    struct cache {
+        std::string c_name;
+        int c_cost;             /*< The relative cost of refilling the cache. */
+        usage_func c_usage;
+        shed_func c_shed;
+        size_t c_sheds{0};      /*< The number of times the cache was shed. */
+        size_t c_shed_bytes{0}; /*< The total number of bytes freed. */
+    };
+
+    static memory_governor &singleton();
+
+    /**
+     * Add a cache that can be shed under memory pressure.  Caches with a
+     * lower cost are shed before those with a higher cost.
+     */
+    void register_cache(const std::string &name,
+                        int cost,
+                        usage_func usage,
+                        shed_func shed);
+
+    /**
+     * Check the resident size of the process, at most once a second, and
+     * shed caches if it is over the limit.
+     *
+     * @return The number of bytes that were freed.
+     */
+    size_t check();
+
+    /**
+     * Shed the caches, cheapest first, until the given number of bytes have
+     * been freed.
+     *
+     * @return The number of bytes that were freed.
+     */
+    size_t shed(size_t amount);
+
+    /** @return The limit that the resident size is kept under. */
+    size_t get_limit();
+
+    /** @return The resident size of the process or zero if it is unknown. */
+    static size_t read_rss();
+
+    std::vector<cache> &get_caches() {
+        return this->mg_caches;
+    };
+
+    size_t get_sheds() const {
+        return this->mg_sheds;
+    };
+
+    size_t get_shed_bytes() const {
+        return this->mg_shed_bytes;
+    };
+
+private:
+    memory_governor() = default;
+
+    /** @return The cgroup or physical memory limit for the process. */
+    static size_t detect_system_limit();
+
+    std::vector<cache> mg_caches;
+    size_t mg_system_limit{0};
+    bool mg_system_limit_detected{false};
+    std::chrono::steady_clock::time_point mg_last_check;
+    size_t mg_sheds{0};
+    size_t mg_shed_bytes{0};
+};
+
+#endif
@@ -42,26 +42,129 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
 #include "sqlite3.h"
 
+#include "optional.hpp"
+
 #include "auto_mem.hh"
 #include "vtab_module.hh"
 #include "sqlite-extension-func.hh"
 
 using namespace std;
 
-static string sql_gethostbyname(const char *name_in)
+/** How long a successful lookup is remembered. */
+static const auto DNS_TTL = chrono::minutes(10);
+/** How long a failed lookup is remembered. */
+static const auto DNS_NEGATIVE_TTL = chrono::minutes(1);
+/** How long a query waits for a lookup before using the original value. */
+static const auto DNS_LOOKUP_TIMEOUT = chrono::milliseconds(250);
+static const size_t DNS_CACHE_MAX_ENTRIES = 64 * 1024;
+static const size_t DNS_MAX_PENDING = 64;
+
+/**
+ * Remembers the results of DNS lookups so that a query does not need to do
+ * the same lookup for every row.  Lookups run in their own threads and the
+ * query only waits a short time for them.  If a lookup takes longer, the
+ * original value is returned and the result is picked up by later rows or
+ * queries once it is done.
+ */
+class dns_cache {
+public:
+    using resolver_t = nonstd::optional<string> (*)(const string &);
+
+    explicit dns_cache(resolver_t resolver) : dc_resolver(resolver) {};
+
+    string lookup(const string &key)
+    {
+        auto now = chrono::steady_clock::now();
+        shared_future<nonstd::optional<string>> pending;
+
+        {
+            lock_guard<mutex> lg(this->dc_mutex);
+            auto iter = this->dc_entries.find(key);
+
+            if (iter != this->dc_entries.end()) {
+                if (now < iter->second.e_expires) {
+                    return iter->second.e_value;
+                }
+                this->dc_entries.erase(iter);
+            }
+
+            auto pending_iter = this->dc_pending.find(key);
+
+            if (pending_iter != this->dc_pending.end()) {
+                pending = pending_iter->second;
+            } else if (this->dc_pending.size() >= DNS_MAX_PENDING) {
+                return key;
+            } else {
+                packaged_task<nonstd::optional<string>()> task(
+                    [this, key]() {
+                        auto retval = this->dc_resolver(key);
+
+                        this->finish(key, retval);
+                        return retval;
+                    });
+
+                pending = task.get_future().share();
+                this->dc_pending[key] = pending;
+                thread(std::move(task)).detach();
+            }
+        }
+
+        if (pending.wait_for(DNS_LOOKUP_TIMEOUT) != future_status::ready) {
+            return key;
+        }
+
+        return pending.get().value_or(key);
+    }
+
+private:
+    struct entry {
+        string e_value;
+        chrono::steady_clock::time_point e_expires;
+    };
+
+    void finish(const string &key, const nonstd::optional<string> &value)
+    {
+        auto now = chrono::steady_clock::now();
+        lock_guard<mutex> lg(this->dc_mutex);
+
+        this->dc_pending.erase(key);
+        if (this->dc_entries.size() >= DNS_CACHE_MAX_ENTRIES) {
+            this->dc_entries.clear();
+        }
+        this->dc_entries[key] = {
+            value.value_or(key),
+            now + (value ? DNS_TTL : DNS_NEGATIVE_TTL),
+        };
+    }
+
+    resolver_t dc_resolver;
+    mutex dc_mutex;
+    unordered_map<string, entry> dc_entries;
+    unordered_map<string, shared_future<nonstd::optional<string>>> dc_pending;
+};
+
+static nonstd::optional<string> resolve_name(const string &name_in)
 {
     char             buffer[INET6_ADDRSTRLEN];
     auto_mem<struct addrinfo> ai(freeaddrinfo);
     void *           addr_ptr = NULL;
-    int rc;
+    int rc, retries = 0;
 
-    while ((rc = getaddrinfo(name_in, NULL, NULL, ai.out())) == EAI_AGAIN) {
+    while ((rc = getaddrinfo(name_in.c_str(), NULL, NULL, ai.out())) ==
+           EAI_AGAIN && retries++ < 100) {
         sqlite3_sleep(10);
     }
     if (rc != 0) {
-        return name_in;
+        return nonstd::nullopt;
     }
 
     switch (ai.in()->ai_family) {
@@ -74,16 +177,17 @@ static string sql_gethostbyname(const char *name_in)
         break;
 
     default:
-        return name_in;
+        return nonstd::nullopt;
     }
 
     inet_ntop(ai.in()->ai_family, addr_ptr, buffer, sizeof(buffer));
 
-    return buffer;
+    return string(buffer);
 }
 
-static string sql_gethostbyaddr(const char *addr_str)
+static nonstd::optional<string> resolve_addr(const string &addr_in)
 {
+    const char *addr_str = addr_in.c_str();
     union {
         struct sockaddr_in  sin;
         struct sockaddr_in6 sin6;
@@ -91,7 +195,7 @@ static string sql_gethostbyaddr(const char *addr_str)
     char        buffer[NI_MAXHOST];
     int         family, socklen;
     char *      addr_raw;
-    int         rc;
+    int         rc, retries = 0;
 
     memset(&sa, 0, sizeof(sa));
     if (strchr(addr_str, ':')) {
@@ -108,20 +212,39 @@ static string sql_gethostbyaddr(const char *addr_str)
     }
 
     if (inet_pton(family, addr_str, addr_raw) != 1) {
-        return addr_str;
+        return nonstd::nullopt;
     }
 
     while ((rc = getnameinfo((struct sockaddr *)&sa, socklen,
                              buffer, sizeof(buffer), NULL, 0,
-                             0)) == EAI_AGAIN) {
+                             0)) == EAI_AGAIN && retries++ < 100) {
         sqlite3_sleep(10);
     }
 
     if (rc != 0) {
+        return nonstd::nullopt;
+    }
+
+    return string(buffer);
+}
+
+static string sql_gethostbyname(const char *name_in)
+{
+    static dns_cache NAME_CACHE(resolve_name);
+
+    return NAME_CACHE.lookup(name_in);
+}
+
+static string sql_gethostbyaddr(const char *addr_str)
+{
+    static dns_cache ADDR_CACHE(resolve_addr);
+
+    if (!strchr(addr_str, ':') && !strchr(addr_str, '.')) {
+        // Not an address, no need to start a lookup.
         return addr_str;
     }
 
-    return buffer;
+    return ADDR_CACHE.lookup(addr_str);
 }
 
 int network_extension_functions(struct FuncDef **basic_funcs,
@@ -0,0 +1,182 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file ngram_index.cc
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "ngram_index.hh"
+
+const size_t ngram_index::LINES_PER_BLOCK;
+const size_t ngram_index::BLOCK_BITS;
+
+/** The number of queries to keep around before they are thrown out. */
+static const size_t MAX_CACHED_QUERIES = 64;
+
+static inline unsigned char fold(char ch)
+{
+    unsigned char retval = (unsigned char) ch;
+
+    if ('A' <= retval && retval <= 'Z') {
+        retval += 'a' - 'A';
+    }
+
+    return retval;
+}
+
+uint32_t ngram_index::first_bit(uint32_t trigram)
+{
+    return (trigram * 2654435761U) % BLOCK_BITS;
+}
+
+uint32_t ngram_index::second_bit(uint32_t trigram)
+{
+    return ((trigram ^ (trigram >> 11)) * 2246822519U >> 7) % BLOCK_BITS;
+}
+
+void ngram_index::add_line(size_t line_number, const char *data, size_t len)
+{
+    size_t block_index = line_number / LINES_PER_BLOCK;
+
+    if (block_index >= this->ni_blocks.size()) {
+        block empty;
+
+        memset(&empty, 0, sizeof(empty));
+        this->ni_blocks.resize(block_index + 1, empty);
+    }
+
+    auto &b = this->ni_blocks[block_index];
+
+    if (len >= 3) {
+        uint32_t trigram = (fold(data[0]) << 8) | fold(data[1]);
+
+        for (size_t lpc = 2; lpc < len; lpc++) {
+            trigram = ((trigram << 8) | fold(data[lpc])) & 0xffffff;
+
+            auto bit1 = first_bit(trigram), bit2 = second_bit(trigram);
+
+            b.b_words[bit1 / 64] |= 1ULL << (bit1 % 64);
+            b.b_words[bit2 / 64] |= 1ULL << (bit2 % 64);
+        }
+    }
+
+    this->ni_line_count = std::max(this->ni_line_count, line_number + 1);
+}
+
+void ngram_index::truncate(size_t line_count)
+{
+    if (line_count >= this->ni_line_count) {
+        return;
+    }
+
+    this->ni_line_count = line_count;
+    this->ni_blocks.resize(
+        (line_count + LINES_PER_BLOCK - 1) / LINES_PER_BLOCK);
+}
+
+bool ngram_index::save(int fd) const
+{
+    ssize_t size = sizeof(block) * this->ni_blocks.size();
+
+    return write(fd, this->ni_blocks.data(), size) == size;
+}
+
+bool ngram_index::load(int fd, size_t line_count)
+{
+    this->ni_blocks.resize((line_count + LINES_PER_BLOCK - 1) /
+                           LINES_PER_BLOCK);
+
+    ssize_t size = sizeof(block) * this->ni_blocks.size();
+
+    if (read(fd, this->ni_blocks.data(), size) != size) {
+        this->ni_blocks.clear();
+        this->ni_line_count = 0;
+        return false;
+    }
+    this->ni_line_count = line_count;
+
+    return true;
+}
+
+const ngram_index::query &ngram_index::query_for(const std::string &literal) const
+{
+    auto iter = this->ni_queries.find(literal);
+
+    if (iter != this->ni_queries.end()) {
+        return iter->second;
+    }
+
+    if (this->ni_queries.size() >= MAX_CACHED_QUERIES) {
+        this->ni_queries.clear();
+    }
+
+    query q;
+
+    if (literal.size() >= 3) {
+        uint32_t trigram = (fold(literal[0]) << 8) | fold(literal[1]);
+
+        for (size_t lpc = 2; lpc < literal.size(); lpc++) {
+            trigram = ((trigram << 8) | fold(literal[lpc])) & 0xffffff;
+            // The lines are indexed separately, so a literal that spans
+            // more than one line can only use the trigrams within a line.
+            if (memchr(&literal[lpc - 2], '\n', 3) != nullptr) {
+                continue;
+            }
+            q.q_bits.push_back(first_bit(trigram));
+            q.q_bits.push_back(second_bit(trigram));
+        }
+        std::sort(q.q_bits.begin(), q.q_bits.end());
+        q.q_bits.erase(std::unique(q.q_bits.begin(), q.q_bits.end()),
+                       q.q_bits.end());
+    }
+
+    return this->ni_queries.emplace(literal, std::move(q)).first->second;
+}
+
+bool ngram_index::may_contain(const query &q, size_t line_number) const
+{
+    if (q.empty() || line_number >= this->ni_line_count) {
+        return true;
+    }
+
+    const auto &b = this->ni_blocks[line_number / LINES_PER_BLOCK];
+
+    for (auto bit : q.q_bits) {
+        if ((b.b_words[bit / 64] & (1ULL << (bit % 64))) == 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,143 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file ngram_index.hh
+ */
+
+#ifndef lnav_ngram_index_hh
+#define lnav_ngram_index_hh
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * An index of the three-byte sequences in the lines of a file, so that a
+ * search for a literal string can skip the lines that cannot contain it.
+ * The lines are grouped into blocks and each block has a bloom filter of
+ * the trigrams in its lines.  The trigrams are folded to lowercase ASCII,
+ * so the index works for case-sensitive and case-insensitive searches.
+ * A block can report a false positive, but never a false negative.
+ *
+ * The index is not thread-safe, it is expected to be updated by whatever
+ * thread is indexing the file and queried while the file is not being
+ * indexed.
+ */
+class ngram_index {
+public:
+    /** The number of lines in a block. */
+    static const size_t LINES_PER_BLOCK = 128;
+
+    /** The number of bits in the bloom filter of a block. */
+    static const size_t BLOCK_BITS = 16 * 1024;
+
+    /** The bits a literal needs to have set in a block. */
+    struct query {
+        std::vector<uint32_t> q_bits;
+
+        /** @return True if the literal is too short to use the index. */
+        bool empty() const {
+            return this->q_bits.empty();
+        };
+    };
+
+    /**
+     * Add a line to the index.  The lines must be added in order, adding a
+     * line again is harmless.
+     *
+     * @param line_number The index of the line in the file.
+     * @param data The contents of the line.
+     * @param len The length of the line.
+     */
+    void add_line(size_t line_number, const char *data, size_t len);
+
+    /**
+     * Forget the lines from the given one onwards, like when the end of a
+     * file is read again.  The bits for the remaining lines in the last
+     * block are kept, which can only cause false positives.
+     */
+    void truncate(size_t line_count);
+
+    /**
+     * Write the blocks to a file so they can be restored with load().
+     *
+     * @param fd The file to write to.
+     * @return True if all of the blocks were written.
+     */
+    bool save(int fd) const;
+
+    /**
+     * Replace the contents of the index with blocks written by save().
+     *
+     * @param fd The file to read from.
+     * @param line_count The number of lines that were in the saved index.
+     * @return True if the blocks were read, the index is empty otherwise.
+     */
+    bool load(int fd, size_t line_count);
+
+    /** @return The number of lines that have been added. */
+    size_t get_line_count() const {
+        return this->ni_line_count;
+    };
+
+    /**
+     * @param literal The string to search for.
+     * @return The query for the literal, which is cached for later calls.
+     */
+    const query &query_for(const std::string &literal) const;
+
+    /**
+     * @param q The query for the literal.
+     * @param line_number The line to check.
+     * @return False if the line cannot contain the literal.
+     */
+    bool may_contain(const query &q, size_t line_number) const;
+
+    /** @return The number of bytes used by the index. */
+    size_t get_memory_usage() const {
+        return this->ni_blocks.capacity() * sizeof(block);
+    };
+
+private:
+    struct block {
+        uint64_t b_words[BLOCK_BITS / 64];
+    };
+
+    static uint32_t first_bit(uint32_t trigram);
+
+    static uint32_t second_bit(uint32_t trigram);
+
+    std::vector<block> ni_blocks;
+    size_t ni_line_count{0};
+    mutable std::unordered_map<std::string, query> ni_queries;
+};
+
+#endif
@@ -0,0 +1,1911 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file parquet_reader.cc
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include <algorithm>
+
+#ifdef HAVE_ZSTD_H
+#include <zstd.h>
+#endif
+
+#include "base/lnav_log.hh"
+#include "fmt/format.h"
+#include "parquet_reader.hh"
+
+using namespace std;
+
+const char parquet_file::MAGIC[] = "PAR1";
+
+/** The Julian day of the Unix epoch, for INT96 timestamps. */
+static const int64_t JULIAN_EPOCH_DAY = 2440588;
+static const int64_t MICROS_PER_DAY = 86400LL * 1000000LL;
+
+/** The most a single column chunk can decode to. */
+static const size_t MAX_CHUNK_BYTES = UINT32_MAX;
+
+enum {
+    CONVERTED_UTF8 = 0,
+    CONVERTED_ENUM = 4,
+    CONVERTED_DECIMAL = 5,
+    CONVERTED_DATE = 6,
+    CONVERTED_TIMESTAMP_MILLIS = 9,
+    CONVERTED_TIMESTAMP_MICROS = 10,
+    CONVERTED_UINT_8 = 11,
+    CONVERTED_UINT_16 = 12,
+    CONVERTED_UINT_32 = 13,
+    CONVERTED_UINT_64 = 14,
+    CONVERTED_JSON = 19,
+    CONVERTED_BSON = 20,
+    CONVERTED_INTERVAL = 21,
+};
+
+enum {
+    REPETITION_REQUIRED = 0,
+    REPETITION_OPTIONAL = 1,
+    REPETITION_REPEATED = 2,
+};
+
+enum {
+    CODEC_UNCOMPRESSED = 0,
+    CODEC_SNAPPY = 1,
+    CODEC_GZIP = 2,
+    CODEC_ZSTD = 6,
+};
+
+enum {
+    ENCODING_PLAIN = 0,
+    ENCODING_PLAIN_DICTIONARY = 2,
+    ENCODING_RLE = 3,
+    ENCODING_DELTA_BINARY_PACKED = 5,
+    ENCODING_DELTA_LENGTH_BYTE_ARRAY = 6,
+    ENCODING_DELTA_BYTE_ARRAY = 7,
+    ENCODING_RLE_DICTIONARY = 8,
+    ENCODING_BYTE_STREAM_SPLIT = 9,
+};
+
+enum {
+    PAGE_DATA = 0,
+    PAGE_INDEX = 1,
+    PAGE_DICTIONARY = 2,
+    PAGE_DATA_V2 = 3,
+};
+
+static uint32_t read_le32(const unsigned char *data)
+{
+    return ((uint32_t) data[0] |
+            ((uint32_t) data[1] << 8) |
+            ((uint32_t) data[2] << 16) |
+            ((uint32_t) data[3] << 24));
+}
+
+static uint64_t read_le64(const unsigned char *data)
+{
+    return (uint64_t) read_le32(data) |
+           ((uint64_t) read_le32(data + 4) << 32);
+}
+
+static bool read_fully(int fd, void *buf, size_t len, off_t off)
+{
+    size_t got = 0;
+
+    while (got < len) {
+        ssize_t rc = pread(fd, (char *) buf + got, len - got, off + got);
+
+        if (rc == -1 && errno == EINTR) {
+            continue;
+        }
+        if (rc <= 0) {
+            return false;
+        }
+        got += rc;
+    }
+
+    return true;
+}
+
+static bool read_uleb128(const unsigned char *&p,
+                         const unsigned char *end,
+                         uint64_t &value_out)
+{
+    value_out = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p >= end) {
+            return false;
+        }
+
+        uint8_t b = *p++;
+
+        value_out |= (uint64_t) (b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+/**
+ * Reader for the Thrift compact protocol that the metadata is encoded with.
+ * Once a read fails, the reader stays failed and every other read returns
+ * zero values, so the callers only need to check ok() at the end.
+ */
+class compact_reader {
+public:
+    enum {
+        CT_STOP = 0,
+        CT_TRUE = 1,
+        CT_FALSE = 2,
+        CT_BYTE = 3,
+        CT_I16 = 4,
+        CT_I32 = 5,
+        CT_I64 = 6,
+        CT_DOUBLE = 7,
+        CT_BINARY = 8,
+        CT_LIST = 9,
+        CT_SET = 10,
+        CT_MAP = 11,
+        CT_STRUCT = 12,
+    };
+
+    static const int MAX_DEPTH = 32;
+
+    compact_reader(const unsigned char *data, size_t len)
+        : cr_pos(data), cr_end(data + len) {
+    };
+
+    bool ok() const {
+        return !this->cr_failed;
+    };
+
+    const unsigned char *position() const {
+        return this->cr_pos;
+    };
+
+    uint8_t read_byte() {
+        if (this->cr_failed || this->cr_pos >= this->cr_end) {
+            this->cr_failed = true;
+            return 0;
+        }
+        return *this->cr_pos++;
+    };
+
+    uint64_t read_varint() {
+        uint64_t retval = 0;
+
+        if (this->cr_failed ||
+            !read_uleb128(this->cr_pos, this->cr_end, retval)) {
+            this->cr_failed = true;
+            return 0;
+        }
+        return retval;
+    };
+
+    int64_t read_int() {
+        return unzigzag(this->read_varint());
+    };
+
+    void read_binary(string &value_out) {
+        uint64_t len = this->read_varint();
+
+        if (this->cr_failed || len > (uint64_t) (this->cr_end - this->cr_pos)) {
+            this->cr_failed = true;
+            return;
+        }
+        value_out.assign((const char *) this->cr_pos, len);
+        this->cr_pos += len;
+    };
+
+    /**
+     * Read the header of the next field in a struct.
+     *
+     * @param id_inout The id of the previous field, updated to this one's.
+     * @return The type of the field or CT_STOP at the end of the struct.
+     */
+    uint8_t read_field(int16_t &id_inout) {
+        uint8_t b = this->read_byte();
+        uint8_t type = b & 0x0f;
+
+        if (type == CT_STOP) {
+            return CT_STOP;
+        }
+        if ((b >> 4) == 0) {
+            id_inout = (int16_t) this->read_int();
+        } else {
+            id_inout += b >> 4;
+        }
+
+        return type;
+    };
+
+    /** @return The number of elements in the list that follows. */
+    uint32_t read_list(uint8_t &elem_type_out) {
+        uint8_t b = this->read_byte();
+        uint64_t size = b >> 4;
+
+        elem_type_out = b & 0x0f;
+        if (size == 15) {
+            size = this->read_varint();
+        }
+        // Every element takes at least a byte.
+        if (size > (uint64_t) (this->cr_end - this->cr_pos)) {
+            this->cr_failed = true;
+            return 0;
+        }
+
+        return size;
+    };
+
+    /** @return The value of a boolean field or list element. */
+    bool read_bool(uint8_t type, bool in_list = false) {
+        if (in_list) {
+            return this->read_byte() == CT_TRUE;
+        }
+        return type == CT_TRUE;
+    };
+
+    void skip(uint8_t type, int depth = 0) {
+        if (depth > MAX_DEPTH) {
+            this->cr_failed = true;
+            return;
+        }
+
+        switch (type) {
+            case CT_TRUE:
+            case CT_FALSE:
+                break;
+            case CT_BYTE:
+                this->read_byte();
+                break;
+            case CT_I16:
+            case CT_I32:
+            case CT_I64:
+                this->read_varint();
+                break;
+            case CT_DOUBLE:
+                this->skip_bytes(8);
+                break;
+            case CT_BINARY:
+                this->skip_bytes(this->read_varint());
+                break;
+            case CT_LIST:
+            case CT_SET: {
+                uint8_t elem_type;
+                uint32_t size = this->read_list(elem_type);
+
+                for (uint32_t lpc = 0; lpc < size && this->ok(); lpc++) {
+                    if (elem_type == CT_TRUE || elem_type == CT_FALSE) {
+                        this->read_byte();
+                    } else {
+                        this->skip(elem_type, depth + 1);
+                    }
+                }
+                break;
+            }
+            case CT_MAP: {
+                uint64_t size = this->read_varint();
+
+                if (size > 0) {
+                    uint8_t types = this->read_byte();
+
+                    for (uint64_t lpc = 0; lpc < size && this->ok(); lpc++) {
+                        this->skip(types >> 4, depth + 1);
+                        this->skip(types & 0x0f, depth + 1);
+                    }
+                }
+                break;
+            }
+            case CT_STRUCT: {
+                int16_t id = 0;
+                uint8_t field_type;
+
+                while (this->ok() &&
+                       (field_type = this->read_field(id)) != CT_STOP) {
+                    this->skip(field_type, depth + 1);
+                }
+                break;
+            }
+            default:
+                this->cr_failed = true;
+                break;
+        }
+    };
+
+private:
+    void skip_bytes(uint64_t len) {
+        if (this->cr_failed ||
+            len > (uint64_t) (this->cr_end - this->cr_pos)) {
+            this->cr_failed = true;
+            return;
+        }
+        this->cr_pos += len;
+    };
+
+    const unsigned char *cr_pos;
+    const unsigned char *cr_end;
+    bool cr_failed{false};
+};
+
+typedef compact_reader cr_t;
+
+/** The parts of a SchemaElement that are used. */
+struct schema_element {
+    int32_t se_type{-1};
+    int32_t se_type_length{0};
+    int32_t se_repetition{REPETITION_REQUIRED};
+    string se_name;
+    int32_t se_num_children{0};
+    int32_t se_converted_type{-1};
+    int32_t se_scale{0};
+    /** The field id of the member of the LogicalType union, if any. */
+    int16_t se_logical_type{0};
+    int32_t se_logical_scale{0};
+    /** For TIMESTAMP, 1 for milliseconds, 2 for microseconds, 3 for nanos. */
+    int16_t se_logical_unit{0};
+    bool se_logical_signed{true};
+};
+
+enum {
+    LOGICAL_STRING = 1,
+    LOGICAL_ENUM = 4,
+    LOGICAL_DECIMAL = 5,
+    LOGICAL_DATE = 6,
+    LOGICAL_TIMESTAMP = 8,
+    LOGICAL_INTEGER = 10,
+    LOGICAL_JSON = 12,
+    LOGICAL_BSON = 13,
+};
+
+static void read_logical_type(cr_t &cr, schema_element &se)
+{
+    int16_t id = 0;
+    uint8_t type;
+
+    while (cr.ok() && (type = cr.read_field(id)) != cr_t::CT_STOP) {
+        if (type != cr_t::CT_STRUCT) {
+            cr.skip(type);
+            continue;
+        }
+
+        se.se_logical_type = id;
+
+        int16_t sub_id = 0;
+        uint8_t sub_type;
+
+        while (cr.ok() && (sub_type = cr.read_field(sub_id)) != cr_t::CT_STOP) {
+            if (id == LOGICAL_DECIMAL && sub_id == 1 &&
+                sub_type == cr_t::CT_I32) {
+                se.se_logical_scale = cr.read_int();
+            } else if (id == LOGICAL_TIMESTAMP && sub_id == 2 &&
+                       sub_type == cr_t::CT_STRUCT) {
+                int16_t unit_id = 0;
+                uint8_t unit_type;
+
+                while (cr.ok() &&
+                       (unit_type = cr.read_field(unit_id)) != cr_t::CT_STOP) {
+                    se.se_logical_unit = unit_id;
+                    cr.skip(unit_type);
+                }
+            } else if (id == LOGICAL_INTEGER && sub_id == 2) {
+                se.se_logical_signed = cr.read_bool(sub_type);
+            } else {
+                cr.skip(sub_type);
+            }
+        }
+    }
+}
+
+static void read_schema_element(cr_t &cr, schema_element &se)
+{
+    int16_t id = 0;
+    uint8_t type;
+
+    while (cr.ok() && (type = cr.read_field(id)) != cr_t::CT_STOP) {
+        switch (id) {
+            case 1:
+                se.se_type = cr.read_int();
+                break;
+            case 2:
+                se.se_type_length = cr.read_int();
+                break;
+            case 3:
+                se.se_repetition = cr.read_int();
+                break;
+            case 4:
+                cr.read_binary(se.se_name);
+                break;
+            case 5:
+                se.se_num_children = cr.read_int();
+                break;
+            case 6:
+                se.se_converted_type = cr.read_int();
+                break;
+            case 7:
+                se.se_scale = cr.read_int();
+                break;
+            case 10:
+                if (type == cr_t::CT_STRUCT) {
+                    read_logical_type(cr, se);
+                    break;
+                }
+                cr.skip(type);
+                break;
+            default:
+                cr.skip(type);
+                break;
+        }
+    }
+}
+
+/** The statistics as they are stored, before deciding if they are usable. */
+struct raw_statistics {
+    bool rs_has_legacy{false};
+    string rs_legacy_min;
+    string rs_legacy_max;
+    bool rs_has_value{false};
+    string rs_min_value;
+    string rs_max_value;
+    int64_t rs_null_count{-1};
+};
+
+static void read_statistics(cr_t &cr, raw_statistics &rs)
+{
+    int16_t id = 0;
+    uint8_t type;
+    bool has_min = false, has_max = false;
+    bool has_min_value = false, has_max_value = false;
+
+    while (cr.ok() && (type = cr.read_field(id)) != cr_t::CT_STOP) {
+        switch (id) {
+            case 1:
+                cr.read_binary(rs.rs_legacy_max);
+                has_max = true;
+                break;
+            case 2:
+                cr.read_binary(rs.rs_legacy_min);
+                has_min = true;
+                break;
+            case 3:
+                rs.rs_null_count = cr.read_int();
+                break;
+            case 5:
+                cr.read_binary(rs.rs_max_value);
+                has_max_value = true;
+                break;
+            case 6:
+                cr.read_binary(rs.rs_min_value);
+                has_min_value = true;
+                break;
+            default:
+                cr.skip(type);
+                break;
+        }
+    }
+    rs.rs_has_legacy = has_min && has_max;
+    rs.rs_has_value = has_min_value && has_max_value;
+}
+
+struct raw_chunk {
+    bool rc_external{false};
+    bool rc_has_meta{false};
+    int32_t rc_type{-1};
+    parquet_file::column_chunk rc_chunk;
+    raw_statistics rc_stats;
+};
+
+static void read_column_meta(cr_t &cr, raw_chunk &rc)
+{
+    int16_t id = 0;
+    uint8_t type;
+
+    rc.rc_has_meta = true;
+    while (cr.ok() && (type = cr.read_field(id)) != cr_t::CT_STOP) {
+        switch (id) {
+            case 1:
+                rc.rc_type = cr.read_int();
+                break;
+            case 4:
+                rc.rc_chunk.cc_codec = cr.read_int();
+                break;
+            case 5:
+                rc.rc_chunk.cc_num_values = cr.read_int();
+                break;
+            case 7:
+                rc.rc_chunk.cc_total_compressed_size = cr.read_int();
+                break;
+            case 9:
+                rc.rc_chunk.cc_data_page_offset = cr.read_int();
+                break;
+            case 11:
+                rc.rc_chunk.cc_dictionary_page_offset = cr.read_int();
+                break;
+            case 12:
+                if (type == cr_t::CT_STRUCT) {
+                    read_statistics(cr, rc.rc_stats);
+                    break;
+                }
+                cr.skip(type);
+                break;
+            default:
+                cr.skip(type);
+                break;
+        }
+    }
+}
+
+static void read_column_chunk(cr_t &cr, raw_chunk &rc)
+{
+    int16_t id = 0;
+    uint8_t type;
+
+    while (cr.ok() && (type = cr.read_field(id)) != cr_t::CT_STOP) {
+        switch (id) {
+            case 1:
+                // The data is in another file.
+                rc.rc_external = true;
+                cr.skip(type);
+                break;
+            case 3:
+                if (type == cr_t::CT_STRUCT) {
+                    read_column_meta(cr, rc);
+                    break;
+                }
+                cr.skip(type);
+                break;
+            default:
+                cr.skip(type);
+                break;
+        }
+    }
+}
+
+struct raw_row_group {
+    int64_t rrg_num_rows{0};
+    vector<raw_chunk> rrg_chunks;
+};
+
+static void read_row_group(cr_t &cr, raw_row_group &rrg)
+{
+    int16_t id = 0;
+    uint8_t type;
+
+    while (cr.ok() && (type = cr.read_field(id)) != cr_t::CT_STOP) {
+        switch (id) {
+            case 1: {
+                uint8_t elem_type;
+                uint32_t size = cr.read_list(elem_type);
+
+                for (uint32_t lpc = 0; lpc < size && cr.ok(); lpc++) {
+                    rrg.rrg_chunks.emplace_back();
+                    read_column_chunk(cr, rrg.rrg_chunks.back());
+                }
+                break;
+            }
+            case 3:
+                rrg.rrg_num_rows = cr.read_int();
+                break;
+            default:
+                cr.skip(type);
+                break;
+        }
+    }
+}
+
+struct raw_file_meta {
+    vector<schema_element> rfm_schema;
+    int64_t rfm_num_rows{0};
+    vector<raw_row_group> rfm_row_groups;
+};
+
+static void read_file_meta(cr_t &cr, raw_file_meta &rfm)
+{
+    int16_t id = 0;
+    uint8_t type;
+
+    while (cr.ok() && (type = cr.read_field(id)) != cr_t::CT_STOP) {
+        switch (id) {
+            case 2: {
+                uint8_t elem_type;
+                uint32_t size = cr.read_list(elem_type);
+
+                for (uint32_t lpc = 0; lpc < size && cr.ok(); lpc++) {
+                    rfm.rfm_schema.emplace_back();
+                    read_schema_element(cr, rfm.rfm_schema.back());
+                }
+                break;
+            }
+            case 3:
+                rfm.rfm_num_rows = cr.read_int();
+                break;
+            case 4: {
+                uint8_t elem_type;
+                uint32_t size = cr.read_list(elem_type);
+
+                for (uint32_t lpc = 0; lpc < size && cr.ok(); lpc++) {
+                    rfm.rfm_row_groups.emplace_back();
+                    read_row_group(cr, rfm.rfm_row_groups.back());
+                }
+                break;
+            }
+            default:
+                cr.skip(type);
+                break;
+        }
+    }
+}
+
+struct page_header {
+    int32_t ph_type{-1};
+    int32_t ph_uncompressed_size{0};
+    int32_t ph_compressed_size{0};
+    int32_t ph_num_values{0};
+    int32_t ph_encoding{ENCODING_PLAIN};
+    int32_t ph_def_encoding{ENCODING_RLE};
+    /** For version 2 data pages, the sizes of the uncompressed levels. */
+    int32_t ph_def_length{0};
+    int32_t ph_rep_length{0};
+    bool ph_is_compressed{true};
+};
+
+static void read_page_header(cr_t &cr, page_header &ph)
+{
+    int16_t id = 0;
+    uint8_t type;
+
+    while (cr.ok() && (type = cr.read_field(id)) != cr_t::CT_STOP) {
+        switch (id) {
+            case 1:
+                ph.ph_type = cr.read_int();
+                break;
+            case 2:
+                ph.ph_uncompressed_size = cr.read_int();
+                break;
+            case 3:
+                ph.ph_compressed_size = cr.read_int();
+                break;
+            case 5:
+            case 7:
+            case 8: {
+                int16_t sub_id = 0;
+                uint8_t sub_type;
+
+                if (type != cr_t::CT_STRUCT) {
+                    cr.skip(type);
+                    break;
+                }
+                while (cr.ok() &&
+                       (sub_type = cr.read_field(sub_id)) != cr_t::CT_STOP) {
+                    if (sub_id == 1) {
+                        ph.ph_num_values = cr.read_int();
+                    } else if (id == 5 && sub_id == 2) {
+                        ph.ph_encoding = cr.read_int();
+                    } else if (id == 5 && sub_id == 3) {
+                        ph.ph_def_encoding = cr.read_int();
+                    } else if (id == 7 && sub_id == 2) {
+                        ph.ph_encoding = cr.read_int();
+                    } else if (id == 8 && sub_id == 4) {
+                        ph.ph_encoding = cr.read_int();
+                    } else if (id == 8 && sub_id == 5) {
+                        ph.ph_def_length = cr.read_int();
+                    } else if (id == 8 && sub_id == 6) {
+                        ph.ph_rep_length = cr.read_int();
+                    } else if (id == 8 && sub_id == 7) {
+                        ph.ph_is_compressed = cr.read_bool(sub_type);
+                    } else {
+                        cr.skip(sub_type);
+                    }
+                }
+                break;
+            }
+            default:
+                cr.skip(type);
+                break;
+        }
+    }
+}
+
+/**
+ * Decompress a raw snappy block, which is the length of the data followed
+ * by literals and copies of earlier data.
+ */
+static bool snappy_uncompress(const unsigned char *in, size_t in_len,
+                              unsigned char *out, size_t out_len)
+{
+    const unsigned char *end = in + in_len;
+    uint64_t expected;
+    size_t pos = 0;
+
+    if (!read_uleb128(in, end, expected) || expected != out_len) {
+        return false;
+    }
+
+    while (in < end) {
+        uint8_t tag = *in++;
+        size_t length, offset;
+
+        switch (tag & 3) {
+            case 0: {
+                length = tag >> 2;
+                if (length >= 60) {
+                    size_t count = length - 59;
+
+                    if ((size_t) (end - in) < count) {
+                        return false;
+                    }
+                    length = 0;
+                    for (size_t lpc = 0; lpc < count; lpc++) {
+                        length |= (size_t) in[lpc] << (8 * lpc);
+                    }
+                    in += count;
+                }
+                length += 1;
+                if ((size_t) (end - in) < length || out_len - pos < length) {
+                    return false;
+                }
+                memcpy(&out[pos], in, length);
+                in += length;
+                pos += length;
+                continue;
+            }
+            case 1:
+                if (in >= end) {
+                    return false;
+                }
+                length = 4 + ((tag >> 2) & 7);
+                offset = ((size_t) (tag >> 5) << 8) | *in++;
+                break;
+            case 2:
+                if (end - in < 2) {
+                    return false;
+                }
+                length = (tag >> 2) + 1;
+                offset = in[0] | ((size_t) in[1] << 8);
+                in += 2;
+                break;
+            default:
+                if (end - in < 4) {
+                    return false;
+                }
+                length = (tag >> 2) + 1;
+                offset = read_le32(in);
+                in += 4;
+                break;
+        }
+
+        if (offset == 0 || offset > pos || out_len - pos < length) {
+            return false;
+        }
+        // The copy can overlap the data it writes, so go a byte at a time.
+        for (size_t lpc = 0; lpc < length; lpc++) {
+            out[pos + lpc] = out[pos - offset + lpc];
+        }
+        pos += length;
+    }
+
+    return pos == out_len;
+}
+
+static Result<void, string> decompress(int32_t codec,
+                                       const unsigned char *in,
+                                       size_t in_len,
+                                       size_t out_len,
+                                       vector<unsigned char> &out)
+{
+    out.resize(out_len);
+    switch (codec) {
+        case CODEC_UNCOMPRESSED:
+            if (in_len != out_len) {
+                return Err(string("page size does not match"));
+            }
+            memcpy(out.data(), in, in_len);
+            break;
+        case CODEC_SNAPPY:
+            if (!snappy_uncompress(in, in_len, out.data(), out_len)) {
+                return Err(string("invalid snappy data"));
+            }
+            break;
+        case CODEC_GZIP: {
+            z_stream strm;
+
+            memset(&strm, 0, sizeof(strm));
+            if (inflateInit2(&strm, 15 + 32) != Z_OK) {
+                return Err(string("unable to initialize zlib"));
+            }
+            strm.next_in = (Bytef *) in;
+            strm.avail_in = in_len;
+            strm.next_out = out.data();
+            strm.avail_out = out_len;
+
+            int rc = inflate(&strm, Z_FINISH);
+
+            inflateEnd(&strm);
+            if (rc != Z_STREAM_END || strm.avail_out != 0) {
+                return Err(string("invalid gzip data"));
+            }
+            break;
+        }
+#ifdef HAVE_ZSTD_H
+        case CODEC_ZSTD: {
+            size_t rc = ZSTD_decompress(out.data(), out_len, in, in_len);
+
+            if (ZSTD_isError(rc) || rc != out_len) {
+                return Err(string("invalid zstd data"));
+            }
+            break;
+        }
+#endif
+        default:
+            return Err(fmt::format("unsupported compression codec -- {}",
+                                   codec));
+    }
+
+    return Ok();
+}
+
+/**
+ * Read values that are packed with the given number of bits each, starting
+ * from the least significant bit of each byte.
+ */
+class bit_unpacker {
+public:
+    bit_unpacker(const unsigned char *data, size_t len)
+        : bu_data(data), bu_bits(len * 8) {
+    };
+
+    bool read(int width, uint64_t &value_out) {
+        if (this->bu_pos + width > this->bu_bits) {
+            return false;
+        }
+
+        value_out = 0;
+        for (int got = 0; got < width; ) {
+            uint8_t byte = this->bu_data[this->bu_pos >> 3];
+            int shift = this->bu_pos & 7;
+            int take = std::min(8 - shift, width - got);
+
+            value_out |= (uint64_t) ((byte >> shift) & ((1U << take) - 1))
+                         << got;
+            got += take;
+            this->bu_pos += take;
+        }
+
+        return true;
+    };
+
+private:
+    const unsigned char *bu_data;
+    size_t bu_bits;
+    size_t bu_pos{0};
+};
+
+/**
+ * Decode values in the RLE/bit-packing hybrid encoding that is used for the
+ * definition levels and dictionary indexes.
+ */
+static bool decode_hybrid(const unsigned char *&p,
+                          const unsigned char *end,
+                          int bit_width,
+                          size_t count,
+                          vector<uint32_t> &values_out)
+{
+    values_out.clear();
+    if (bit_width < 0 || bit_width > 32) {
+        return false;
+    }
+    if (bit_width == 0) {
+        values_out.assign(count, 0);
+        return true;
+    }
+
+    size_t byte_width = (bit_width + 7) / 8;
+
+    values_out.reserve(count);
+    while (values_out.size() < count) {
+        uint64_t header;
+
+        if (!read_uleb128(p, end, header)) {
+            return false;
+        }
+        if (header & 1) {
+            uint64_t value_count = (header >> 1) * 8;
+            size_t len = std::min((uint64_t) (end - p),
+                                  (header >> 1) * bit_width);
+            bit_unpacker bu(p, len);
+
+            for (uint64_t lpc = 0;
+                 lpc < value_count && values_out.size() < count;
+                 lpc++) {
+                uint64_t value;
+
+                if (!bu.read(bit_width, value)) {
+                    return false;
+                }
+                values_out.push_back(value);
+            }
+            p += len;
+        } else {
+            uint64_t run = header >> 1;
+            uint32_t value = 0;
+
+            if ((size_t) (end - p) < byte_width) {
+                return false;
+            }
+            for (size_t lpc = 0; lpc < byte_width; lpc++) {
+                value |= (uint32_t) p[lpc] << (8 * lpc);
+            }
+            p += byte_width;
+            run = std::min(run, (uint64_t) (count - values_out.size()));
+            values_out.insert(values_out.end(), run, value);
+        }
+    }
+
+    return true;
+}
+
+/** Decode the integers in the DELTA_BINARY_PACKED encoding. */
+static bool decode_delta_binary(const unsigned char *&p,
+                                const unsigned char *end,
+                                vector<int64_t> &values_out)
+{
+    uint64_t block_size, miniblocks, total, first;
+
+    values_out.clear();
+    if (!read_uleb128(p, end, block_size) ||
+        !read_uleb128(p, end, miniblocks) ||
+        !read_uleb128(p, end, total) ||
+        !read_uleb128(p, end, first)) {
+        return false;
+    }
+    if (block_size == 0 || miniblocks == 0 || block_size % miniblocks != 0 ||
+        (block_size / miniblocks) % 8 != 0 ||
+        total > (uint64_t) (end - p) * 8 + 1) {
+        return false;
+    }
+    if (total == 0) {
+        return true;
+    }
+
+    uint64_t per_miniblock = block_size / miniblocks;
+    uint64_t last = (uint64_t) unzigzag(first);
+
+    values_out.reserve(total);
+    values_out.push_back((int64_t) last);
+    while (values_out.size() < total) {
+        uint64_t min_delta;
+
+        if (!read_uleb128(p, end, min_delta) ||
+            (uint64_t) (end - p) < miniblocks) {
+            return false;
+        }
+
+        const unsigned char *widths = p;
+
+        p += miniblocks;
+        for (uint64_t mb = 0; mb < miniblocks && values_out.size() < total;
+             mb++) {
+            int width = widths[mb];
+            uint64_t len = per_miniblock * width / 8;
+
+            if (width > 64 || (uint64_t) (end - p) < len) {
+                return false;
+            }
+
+            bit_unpacker bu(p, len);
+
+            for (uint64_t lpc = 0;
+                 lpc < per_miniblock && values_out.size() < total;
+                 lpc++) {
+                uint64_t delta;
+
+                if (!bu.read(width, delta)) {
+                    return false;
+                }
+                last += (uint64_t) unzigzag(min_delta) + delta;
+                values_out.push_back((int64_t) last);
+            }
+            p += len;
+        }
+    }
+
+    return true;
+}
+
+typedef parquet_file::physical_type_t ptype_t;
+typedef parquet_file::value_kind_t kind_t;
+typedef parquet_file::cell cell_t;
+
+static size_t plain_width(const parquet_file::column &col)
+{
+    switch (col.c_type) {
+        case ptype_t::INT32:
+        case ptype_t::FLOAT:
+            return 4;
+        case ptype_t::INT64:
+        case ptype_t::DOUBLE:
+            return 8;
+        case ptype_t::INT96:
+            return 12;
+        case ptype_t::FIXED_LEN_BYTE_ARRAY:
+            return col.c_type_length;
+        default:
+            return 0;
+    }
+}
+
+/** Convert an integer to the way the column presents it. */
+static cell_t integer_cell(const parquet_file::column &col, int64_t value)
+{
+    cell_t retval;
+
+    switch (col.c_kind) {
+        case kind_t::TIMESTAMP:
+            retval.c_type = cell_t::INTEGER;
+            if (col.c_time_units == 1000) {
+                retval.c_integer = value * 1000;
+            } else if (col.c_time_units == 1000000000) {
+                retval.c_integer = value / 1000 - (value % 1000 < 0 ? 1 : 0);
+            } else {
+                retval.c_integer = value;
+            }
+            break;
+        case kind_t::REAL: {
+            double real = value;
+
+            for (int32_t lpc = 0; lpc < col.c_scale; lpc++) {
+                real /= 10.0;
+            }
+            retval.c_type = cell_t::REAL;
+            retval.c_real = real;
+            break;
+        }
+        default:
+            retval.c_type = cell_t::INTEGER;
+            if (col.c_unsigned && col.c_type == ptype_t::INT32) {
+                retval.c_integer = (uint32_t) value;
+            } else {
+                retval.c_integer = value;
+            }
+            break;
+    }
+
+    return retval;
+}
+
+static bool add_bytes(parquet_file::column_values &cv,
+                      const void *data,
+                      size_t len,
+                      cell_t &cell_out)
+{
+    if (cv.cv_bytes.size() + len > MAX_CHUNK_BYTES) {
+        return false;
+    }
+    cell_out.c_type = cell_t::BYTES;
+    cell_out.c_bytes.cb_offset = cv.cv_bytes.size();
+    cell_out.c_bytes.cb_length = len;
+    cv.cv_bytes.insert(cv.cv_bytes.end(),
+                       (const char *) data,
+                       (const char *) data + len);
+
+    return true;
+}
+
+/** Decode a single fixed width value in the PLAIN encoding. */
+static cell_t fixed_cell(const parquet_file::column &col,
+                         const unsigned char *data,
+                         parquet_file::column_values &cv)
+{
+    cell_t retval;
+
+    switch (col.c_type) {
+        case ptype_t::INT32:
+            retval = integer_cell(col, (int32_t) read_le32(data));
+            break;
+        case ptype_t::INT64:
+            retval = integer_cell(col, (int64_t) read_le64(data));
+            break;
+        case ptype_t::INT96: {
+            int64_t nanos = (int64_t) read_le64(data);
+            int64_t day = (int32_t) read_le32(data + 8);
+
+            retval.c_type = cell_t::INTEGER;
+            retval.c_integer = (day - JULIAN_EPOCH_DAY) * MICROS_PER_DAY +
+                               nanos / 1000;
+            break;
+        }
+        case ptype_t::FLOAT: {
+            uint32_t bits = read_le32(data);
+            float value;
+
+            memcpy(&value, &bits, sizeof(value));
+            retval.c_type = cell_t::REAL;
+            retval.c_real = value;
+            break;
+        }
+        case ptype_t::DOUBLE: {
+            uint64_t bits = read_le64(data);
+            double value;
+
+            memcpy(&value, &bits, sizeof(value));
+            retval.c_type = cell_t::REAL;
+            retval.c_real = value;
+            break;
+        }
+        default:
+            add_bytes(cv, data, col.c_type_length, retval);
+            break;
+    }
+
+    return retval;
+}
+
+/** Decode values in the PLAIN encoding. */
+static bool decode_plain(const parquet_file::column &col,
+                         const unsigned char *&p,
+                         const unsigned char *end,
+                         size_t count,
+                         parquet_file::column_values &cv,
+                         vector<cell_t> &cells_out)
+{
+    cells_out.clear();
+    cells_out.reserve(count);
+    switch (col.c_type) {
+        case ptype_t::BOOLEAN: {
+            if ((size_t) (end - p) < (count + 7) / 8) {
+                return false;
+            }
+            for (size_t lpc = 0; lpc < count; lpc++) {
+                cell_t ce;
+
+                ce.c_type = cell_t::INTEGER;
+                ce.c_integer = (p[lpc / 8] >> (lpc % 8)) & 1;
+                cells_out.push_back(ce);
+            }
+            p += (count + 7) / 8;
+            break;
+        }
+        case ptype_t::BYTE_ARRAY:
+            for (size_t lpc = 0; lpc < count; lpc++) {
+                cell_t ce;
+
+                if (end - p < 4) {
+                    return false;
+                }
+
+                uint32_t len = read_le32(p);
+
+                p += 4;
+                if ((size_t) (end - p) < len || !add_bytes(cv, p, len, ce)) {
+                    return false;
+                }
+                p += len;
+                cells_out.push_back(ce);
+            }
+            break;
+        default: {
+            size_t width = plain_width(col);
+
+            if (width == 0 || (size_t) (end - p) / width < count) {
+                return false;
+            }
+            for (size_t lpc = 0; lpc < count; lpc++) {
+                cells_out.push_back(fixed_cell(col, p, cv));
+                p += width;
+            }
+            break;
+        }
+    }
+
+    return true;
+}
+
+/** Decode the byte arrays in the DELTA_LENGTH_BYTE_ARRAY encoding. */
+static bool decode_delta_length(const unsigned char *&p,
+                                const unsigned char *end,
+                                size_t count,
+                                parquet_file::column_values &cv,
+                                vector<cell_t> &cells_out)
+{
+    vector<int64_t> lengths;
+
+    if (!decode_delta_binary(p, end, lengths) || lengths.size() < count) {
+        return false;
+    }
+    cells_out.clear();
+    cells_out.reserve(count);
+    for (size_t lpc = 0; lpc < count; lpc++) {
+        cell_t ce;
+
+        if (lengths[lpc] < 0 || lengths[lpc] > end - p ||
+            !add_bytes(cv, p, lengths[lpc], ce)) {
+            return false;
+        }
+        p += lengths[lpc];
+        cells_out.push_back(ce);
+    }
+
+    return true;
+}
+
+/**
+ * Decode the byte arrays in the DELTA_BYTE_ARRAY encoding, where each
+ * value is a prefix of the previous one followed by a suffix.
+ */
+static bool decode_delta_strings(const unsigned char *&p,
+                                 const unsigned char *end,
+                                 size_t count,
+                                 parquet_file::column_values &cv,
+                                 vector<cell_t> &cells_out)
+{
+    vector<int64_t> prefixes;
+    vector<cell_t> suffixes;
+    string value;
+
+    if (!decode_delta_binary(p, end, prefixes) || prefixes.size() < count) {
+        return false;
+    }
+
+    // The suffixes are decoded into scratch storage since each value is
+    // built from the previous one.
+    parquet_file::column_values scratch;
+
+    if (!decode_delta_length(p, end, count, scratch, suffixes)) {
+        return false;
+    }
+    cells_out.clear();
+    cells_out.reserve(count);
+    for (size_t lpc = 0; lpc < count; lpc++) {
+        const cell_t &suffix = suffixes[lpc];
+        cell_t ce;
+
+        if (prefixes[lpc] < 0 || (size_t) prefixes[lpc] > value.size()) {
+            return false;
+        }
+        value.resize(prefixes[lpc]);
+        value.append(scratch.bytes_of(suffix), suffix.c_bytes.cb_length);
+        if (!add_bytes(cv, value.data(), value.size(), ce)) {
+            return false;
+        }
+        cells_out.push_back(ce);
+    }
+
+    return true;
+}
+
+/** Decode the values of a data page in the given encoding. */
+static Result<void, string> decode_values(const parquet_file::column &col,
+                                          int32_t encoding,
+                                          const unsigned char *p,
+                                          const unsigned char *end,
+                                          size_t count,
+                                          const vector<cell_t> *dict,
+                                          parquet_file::column_values &cv,
+                                          vector<cell_t> &cells_out)
+{
+    bool ok;
+
+    switch (encoding) {
+        case ENCODING_PLAIN:
+            ok = decode_plain(col, p, end, count, cv, cells_out);
+            break;
+        case ENCODING_PLAIN_DICTIONARY:
+        case ENCODING_RLE_DICTIONARY: {
+            vector<uint32_t> indexes;
+
+            if (dict == nullptr) {
+                return Err(string("dictionary page is missing"));
+            }
+            if (count == 0) {
+                cells_out.clear();
+                return Ok();
+            }
+            if (p >= end) {
+                return Err(string("truncated dictionary indexes"));
+            }
+
+            int bit_width = *p++;
+
+            ok = decode_hybrid(p, end, bit_width, count, indexes);
+            cells_out.clear();
+            cells_out.reserve(count);
+            for (size_t lpc = 0; ok && lpc < indexes.size(); lpc++) {
+                if (indexes[lpc] >= dict->size()) {
+                    return Err(string("dictionary index is out of range"));
+                }
+                cells_out.push_back((*dict)[indexes[lpc]]);
+            }
+            break;
+        }
+        case ENCODING_RLE: {
+            vector<uint32_t> bits;
+
+            if (col.c_type != ptype_t::BOOLEAN || end - p < 4) {
+                return Err(string("unsupported RLE values"));
+            }
+            p += 4;
+            ok = decode_hybrid(p, end, 1, count, bits);
+            cells_out.clear();
+            for (auto bit : bits) {
+                cell_t ce;
+
+                ce.c_type = cell_t::INTEGER;
+                ce.c_integer = bit;
+                cells_out.push_back(ce);
+            }
+            break;
+        }
+        case ENCODING_DELTA_BINARY_PACKED: {
+            vector<int64_t> ints;
+
+            if (col.c_type != ptype_t::INT32 && col.c_type != ptype_t::INT64) {
+                return Err(string("unsupported delta values"));
+            }
+            ok = decode_delta_binary(p, end, ints) && ints.size() >= count;
+            cells_out.clear();
+            for (size_t lpc = 0; ok && lpc < count; lpc++) {
+                int64_t value = ints[lpc];
+
+                if (col.c_type == ptype_t::INT32) {
+                    value = (int32_t) value;
+                }
+                cells_out.push_back(integer_cell(col, value));
+            }
+            break;
+        }
+        case ENCODING_DELTA_LENGTH_BYTE_ARRAY:
+            ok = col.c_type == ptype_t::BYTE_ARRAY &&
+                 decode_delta_length(p, end, count, cv, cells_out);
+            break;
+        case ENCODING_DELTA_BYTE_ARRAY:
+            ok = (col.c_type == ptype_t::BYTE_ARRAY ||
+                  col.c_type == ptype_t::FIXED_LEN_BYTE_ARRAY) &&
+                 decode_delta_strings(p, end, count, cv, cells_out);
+            break;
+        case ENCODING_BYTE_STREAM_SPLIT: {
+            size_t width = plain_width(col);
+
+            if (width == 0 || col.c_type == ptype_t::INT96 ||
+                (size_t) (end - p) / width < count) {
+                return Err(string("unsupported byte stream split values"));
+            }
+
+            // Put the bytes of each value back together and decode them as
+            // if they were PLAIN.
+            vector<unsigned char> joined(count * width);
+
+            for (size_t lpc = 0; lpc < count; lpc++) {
+                for (size_t byte = 0; byte < width; byte++) {
+                    joined[lpc * width + byte] = p[byte * count + lpc];
+                }
+            }
+
+            const unsigned char *jp = joined.data();
+
+            ok = decode_plain(col, jp, jp + joined.size(), count, cv,
+                              cells_out);
+            break;
+        }
+        default:
+            return Err(fmt::format("unsupported encoding -- {}", encoding));
+    }
+
+    if (!ok || cells_out.size() < count) {
+        return Err(string("invalid page data"));
+    }
+
+    return Ok();
+}
+
+Result<parquet_file, string> parquet_file::open(int fd)
+{
+    struct stat st;
+    unsigned char tail[8];
+
+    if (fstat(fd, &st) == -1) {
+        return Err(string(strerror(errno)));
+    }
+    if (st.st_size < (off_t) (MAGIC_SIZE * 2 + 4) ||
+        !read_fully(fd, tail, sizeof(tail), st.st_size - sizeof(tail))) {
+        return Err(string("file is too small"));
+    }
+    if (memcmp(&tail[4], "PARE", MAGIC_SIZE) == 0) {
+        return Err(string("encrypted files are not supported"));
+    }
+    if (memcmp(&tail[4], MAGIC, MAGIC_SIZE) != 0) {
+        return Err(string("not a parquet file"));
+    }
+
+    uint32_t footer_len = read_le32(tail);
+
+    if (footer_len > st.st_size - (MAGIC_SIZE * 2 + 4)) {
+        return Err(string("invalid footer length"));
+    }
+
+    vector<unsigned char> footer(footer_len);
+    off_t footer_off = st.st_size - sizeof(tail) - footer_len;
+
+    if (!read_fully(fd, footer.data(), footer.size(), footer_off)) {
+        return Err(string("unable to read footer"));
+    }
+
+    compact_reader cr(footer.data(), footer.size());
+    raw_file_meta rfm;
+
+    read_file_meta(cr, rfm);
+    if (!cr.ok() || rfm.rfm_schema.empty()) {
+        return Err(string("invalid footer"));
+    }
+
+    parquet_file retval;
+    size_t leaf_count = 0;
+    // The number of children left in each of the groups being walked.
+    vector<int32_t> remaining = {rfm.rfm_schema[0].se_num_children};
+
+    retval.pf_fd = fd;
+    retval.pf_num_rows = rfm.rfm_num_rows;
+    for (size_t lpc = 1; lpc < rfm.rfm_schema.size(); lpc++) {
+        const auto &se = rfm.rfm_schema[lpc];
+
+        while (!remaining.empty() && remaining.back() == 0) {
+            remaining.pop_back();
+        }
+        if (remaining.empty()) {
+            return Err(string("invalid schema"));
+        }
+        remaining.back() -= 1;
+
+        if (se.se_num_children > 0) {
+            remaining.push_back(se.se_num_children);
+            continue;
+        }
+
+        size_t depth = remaining.size();
+
+        leaf_count += 1;
+        if (depth > 1 || se.se_repetition == REPETITION_REPEATED ||
+            se.se_type < 0 ||
+            se.se_type > (int32_t) ptype_t::FIXED_LEN_BYTE_ARRAY) {
+            log_info("parquet column is not supported: %s",
+                     se.se_name.c_str());
+            continue;
+        }
+
+        column col;
+
+        col.c_name = se.se_name;
+        col.c_type = (ptype_t) se.se_type;
+        col.c_type_length = se.se_type_length;
+        col.c_optional = se.se_repetition == REPETITION_OPTIONAL;
+        col.c_chunk_index = leaf_count - 1;
+
+        int conv = se.se_converted_type;
+        int16_t logical = se.se_logical_type;
+
+        switch (col.c_type) {
+            case ptype_t::BOOLEAN:
+            case ptype_t::FLOAT:
+            case ptype_t::DOUBLE:
+                col.c_kind = col.c_type == ptype_t::BOOLEAN ?
+                             kind_t::INTEGER : kind_t::REAL;
+                break;
+            case ptype_t::INT32:
+            case ptype_t::INT64:
+                col.c_kind = kind_t::INTEGER;
+                if (logical == LOGICAL_DECIMAL || conv == CONVERTED_DECIMAL) {
+                    col.c_kind = kind_t::REAL;
+                    col.c_scale = logical == LOGICAL_DECIMAL ?
+                                  se.se_logical_scale : se.se_scale;
+                } else if (logical == LOGICAL_DATE || conv == CONVERTED_DATE) {
+                    col.c_kind = kind_t::DATE;
+                } else if (col.c_type == ptype_t::INT64 &&
+                           (logical == LOGICAL_TIMESTAMP ||
+                            conv == CONVERTED_TIMESTAMP_MILLIS ||
+                            conv == CONVERTED_TIMESTAMP_MICROS)) {
+                    col.c_kind = kind_t::TIMESTAMP;
+                    if (logical == LOGICAL_TIMESTAMP) {
+                        col.c_time_units = se.se_logical_unit == 1 ? 1000 :
+                                           se.se_logical_unit == 3 ?
+                                           1000000000 : 1000000;
+                    } else {
+                        col.c_time_units =
+                            conv == CONVERTED_TIMESTAMP_MILLIS ?
+                            1000 : 1000000;
+                    }
+                } else if ((logical == LOGICAL_INTEGER &&
+                            !se.se_logical_signed) ||
+                           (conv >= CONVERTED_UINT_8 &&
+                            conv <= CONVERTED_UINT_64)) {
+                    col.c_unsigned = true;
+                }
+                break;
+            case ptype_t::INT96:
+                col.c_kind = kind_t::TIMESTAMP;
+                break;
+            case ptype_t::BYTE_ARRAY:
+                if (logical == LOGICAL_JSON || conv == CONVERTED_JSON) {
+                    col.c_kind = kind_t::JSON;
+                } else if (logical == LOGICAL_BSON || conv == CONVERTED_BSON ||
+                           logical == LOGICAL_DECIMAL ||
+                           conv == CONVERTED_DECIMAL) {
+                    col.c_kind = kind_t::BLOB;
+                } else {
+                    // Strings are often written without an annotation.
+                    col.c_kind = kind_t::TEXT;
+                }
+                break;
+            case ptype_t::FIXED_LEN_BYTE_ARRAY:
+                col.c_kind = kind_t::BLOB;
+                if (col.c_type_length <= 0) {
+                    log_info("parquet column has no length: %s",
+                             se.se_name.c_str());
+                    continue;
+                }
+                break;
+        }
+        if (conv == CONVERTED_INTERVAL) {
+            col.c_kind = kind_t::BLOB;
+        }
+
+        retval.pf_columns.push_back(col);
+    }
+
+    for (auto &rrg : rfm.rfm_row_groups) {
+        row_group rg;
+
+        if (rrg.rrg_chunks.size() != leaf_count) {
+            return Err(string("row group does not match the schema"));
+        }
+
+        rg.rg_num_rows = rrg.rrg_num_rows;
+        rg.rg_start = st.st_size;
+        for (auto &rc : rrg.rrg_chunks) {
+            auto &chunk = rc.rc_chunk;
+
+            if (rc.rc_external || !rc.rc_has_meta) {
+                return Err(string("column data in other files is not "
+                                  "supported"));
+            }
+            if (chunk.get_start() < (int64_t) MAGIC_SIZE ||
+                chunk.cc_total_compressed_size < 0 ||
+                chunk.get_start() + chunk.cc_total_compressed_size >
+                footer_off) {
+                return Err(string("column chunk is outside of the file"));
+            }
+            rg.rg_start = std::min(rg.rg_start, (off_t) chunk.get_start());
+            rg.rg_end = std::max(rg.rg_end,
+                                 (off_t) (chunk.get_start() +
+                                          chunk.cc_total_compressed_size));
+            rg.rg_chunks.push_back(chunk);
+        }
+        if (rg.rg_chunks.empty()) {
+            rg.rg_start = rg.rg_end = MAGIC_SIZE;
+        }
+
+        // Decide which statistics can be compared with the values as they
+        // are presented.
+        for (const auto &col : retval.pf_columns) {
+            auto &rc = rrg.rrg_chunks[col.c_chunk_index];
+            auto &stats = rg.rg_chunks[col.c_chunk_index].cc_stats;
+            bool numeric = col.c_type == ptype_t::BOOLEAN ||
+                           col.c_type == ptype_t::INT32 ||
+                           col.c_type == ptype_t::INT64 ||
+                           col.c_type == ptype_t::FLOAT ||
+                           col.c_type == ptype_t::DOUBLE;
+
+            stats.s_null_count = rc.rc_stats.rs_null_count;
+            if (col.c_kind == kind_t::BLOB || col.c_type == ptype_t::INT96 ||
+                (col.c_unsigned && col.c_type == ptype_t::INT64)) {
+                continue;
+            }
+            if (rc.rc_stats.rs_has_value) {
+                stats.s_has_min_max = true;
+                stats.s_min = rc.rc_stats.rs_min_value;
+                stats.s_max = rc.rc_stats.rs_max_value;
+            } else if (rc.rc_stats.rs_has_legacy && numeric &&
+                       !col.c_unsigned) {
+                // The old fields were compared as signed bytes, so they can
+                // only be trusted for numbers.
+                stats.s_has_min_max = true;
+                stats.s_min = rc.rc_stats.rs_legacy_min;
+                stats.s_max = rc.rc_stats.rs_legacy_max;
+            }
+        }
+
+        retval.pf_row_groups.push_back(std::move(rg));
+    }
+
+    return Ok(std::move(retval));
+}
+
+bool parquet_file::get_min_max(size_t rg, size_t col,
+                               column_values &values_out) const
+{
+    const auto &column = this->pf_columns[col];
+    const auto &stats =
+        this->pf_row_groups[rg].rg_chunks[column.c_chunk_index].cc_stats;
+
+    values_out.clear();
+    if (!stats.s_has_min_max) {
+        return false;
+    }
+
+    for (const auto *plain : {&stats.s_min, &stats.s_max}) {
+        const unsigned char *p = (const unsigned char *) plain->data();
+        cell_t ce;
+
+        switch (column.c_type) {
+            case ptype_t::BOOLEAN:
+                if (plain->size() != 1) {
+                    return false;
+                }
+                ce.c_type = cell_t::INTEGER;
+                ce.c_integer = p[0] & 1;
+                break;
+            case ptype_t::BYTE_ARRAY:
+                if (!add_bytes(values_out, p, plain->size(), ce)) {
+                    return false;
+                }
+                break;
+            default:
+                if (plain->size() != plain_width(column)) {
+                    return false;
+                }
+                ce = fixed_cell(column, p, values_out);
+                break;
+        }
+        values_out.cv_cells.push_back(ce);
+    }
+
+    return true;
+}
+
+Result<void, string> parquet_file::read_column(size_t rg,
+                                               size_t col,
+                                               column_values &values_out) const
+{
+    const auto &column = this->pf_columns[col];
+    const auto &group = this->pf_row_groups[rg];
+    const auto &chunk = group.rg_chunks[column.c_chunk_index];
+    vector<unsigned char> raw(chunk.cc_total_compressed_size);
+
+    values_out.clear();
+    if (!read_fully(this->pf_fd, raw.data(), raw.size(), chunk.get_start())) {
+        return Err(fmt::format("unable to read column -- {}",
+                               strerror(errno)));
+    }
+
+    const unsigned char *p = raw.data();
+    const unsigned char *end = p + raw.size();
+    vector<unsigned char> page;
+    vector<uint32_t> levels;
+    vector<cell_t> dict, page_values;
+    bool has_dict = false;
+    int64_t values_seen = 0;
+
+    values_out.cv_cells.reserve(group.rg_num_rows);
+    while (p < end && values_seen < chunk.cc_num_values) {
+        compact_reader cr(p, end - p);
+        page_header ph;
+
+        read_page_header(cr, ph);
+        if (!cr.ok() || ph.ph_compressed_size < 0 ||
+            ph.ph_uncompressed_size < 0 || ph.ph_num_values < 0) {
+            return Err(string("invalid page header"));
+        }
+        p = cr.position();
+        if (end - p < ph.ph_compressed_size) {
+            return Err(string("truncated page"));
+        }
+
+        const unsigned char *page_data = p;
+
+        p += ph.ph_compressed_size;
+        switch (ph.ph_type) {
+            case PAGE_DICTIONARY: {
+                if (ph.ph_encoding != ENCODING_PLAIN &&
+                    ph.ph_encoding != ENCODING_PLAIN_DICTIONARY) {
+                    return Err(string("unsupported dictionary encoding"));
+                }
+
+                auto rc = decompress(chunk.cc_codec, page_data,
+                                     ph.ph_compressed_size,
+                                     ph.ph_uncompressed_size, page);
+
+                if (rc.isErr()) {
+                    return rc;
+                }
+
+                const unsigned char *dp = page.data();
+
+                if (!decode_plain(column, dp, dp + page.size(),
+                                  ph.ph_num_values, values_out, dict)) {
+                    return Err(string("invalid dictionary page"));
+                }
+                has_dict = true;
+                break;
+            }
+            case PAGE_DATA:
+            case PAGE_DATA_V2: {
+                const unsigned char *vp, *vend;
+                size_t non_null = ph.ph_num_values;
+
+                levels.clear();
+                if (ph.ph_type == PAGE_DATA) {
+                    auto rc = decompress(chunk.cc_codec, page_data,
+                                         ph.ph_compressed_size,
+                                         ph.ph_uncompressed_size, page);
+
+                    if (rc.isErr()) {
+                        return rc;
+                    }
+                    vp = page.data();
+                    vend = vp + page.size();
+                    if (column.c_optional) {
+                        if (ph.ph_def_encoding != ENCODING_RLE ||
+                            vend - vp < 4) {
+                            return Err(string("unsupported levels"));
+                        }
+
+                        uint32_t len = read_le32(vp);
+
+                        vp += 4;
+                        if ((size_t) (vend - vp) < len) {
+                            return Err(string("truncated levels"));
+                        }
+
+                        const unsigned char *lp = vp;
+
+                        if (!decode_hybrid(lp, vp + len, 1, ph.ph_num_values,
+                                           levels)) {
+                            return Err(string("invalid levels"));
+                        }
+                        vp += len;
+                    }
+                } else {
+                    int32_t levels_len = ph.ph_rep_length + ph.ph_def_length;
+
+                    if (ph.ph_rep_length < 0 || ph.ph_def_length < 0 ||
+                        levels_len > ph.ph_compressed_size ||
+                        levels_len > ph.ph_uncompressed_size) {
+                        return Err(string("invalid page levels"));
+                    }
+                    if (column.c_optional) {
+                        const unsigned char *lp =
+                            page_data + ph.ph_rep_length;
+
+                        if (!decode_hybrid(lp, lp + ph.ph_def_length, 1,
+                                           ph.ph_num_values, levels)) {
+                            return Err(string("invalid levels"));
+                        }
+                    }
+
+                    auto rc = decompress(
+                        ph.ph_is_compressed ? chunk.cc_codec :
+                        CODEC_UNCOMPRESSED,
+                        page_data + levels_len,
+                        ph.ph_compressed_size - levels_len,
+                        ph.ph_uncompressed_size - levels_len,
+                        page);
+
+                    if (rc.isErr()) {
+                        return rc;
+                    }
+                    vp = page.data();
+                    vend = vp + page.size();
+                }
+
+                if (column.c_optional) {
+                    non_null = std::count(levels.begin(), levels.end(), 1);
+                }
+
+                auto rc = decode_values(column, ph.ph_encoding, vp, vend,
+                                        non_null,
+                                        has_dict ? &dict : nullptr,
+                                        values_out, page_values);
+
+                if (rc.isErr()) {
+                    return rc;
+                }
+
+                size_t next_value = 0;
+
+                for (int32_t lpc = 0; lpc < ph.ph_num_values; lpc++) {
+                    if (column.c_optional && levels[lpc] == 0) {
+                        values_out.cv_cells.emplace_back();
+                    } else {
+                        values_out.cv_cells.push_back(
+                            page_values[next_value++]);
+                    }
+                }
+                values_seen += ph.ph_num_values;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    if ((int64_t) values_out.cv_cells.size() != group.rg_num_rows) {
+        return Err(fmt::format("column {} has {} values instead of {}",
+                               column.c_name,
+                               values_out.cv_cells.size(),
+                               group.rg_num_rows));
+    }
+
+    return Ok();
+}
+
+string parquet_format_timestamp(int64_t micros, bool iso)
+{
+    int64_t secs = micros / 1000000;
+    int64_t frac = micros % 1000000;
+    time_t tt;
+    struct tm tm;
+    char buffer[64];
+
+    if (frac < 0) {
+        secs -= 1;
+        frac += 1000000;
+    }
+    tt = secs;
+    gmtime_r(&tt, &tm);
+    strftime(buffer, sizeof(buffer),
+             iso ? "%Y-%m-%dT%H:%M:%S" : "%Y-%m-%d %H:%M:%S", &tm);
+
+    if (iso) {
+        return fmt::format("{}.{:06d}+0000", buffer, frac);
+    }
+    return fmt::format("{}.{:03d}", buffer, frac / 1000);
+}
+
+string parquet_format_date(int64_t days)
+{
+    time_t tt = days * 86400;
+    struct tm tm;
+    char buffer[32];
+
+    gmtime_r(&tt, &tm);
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d", &tm);
+
+    return buffer;
+}
@@ -0,0 +1,225 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file parquet_reader.hh
+ */
+
+#ifndef lnav_parquet_reader_hh
+#define lnav_parquet_reader_hh
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include "base/result.h"
+
+/**
+ * A reader for Apache Parquet files that is just enough for logs: a flat
+ * schema of primitive columns, the PLAIN, dictionary, RLE and DELTA
+ * encodings, and uncompressed, snappy, gzip or, if available, zstd data.
+ * Columns inside of groups or that repeat are left out.  The metadata in
+ * the footer is read up front and the columns are decoded a row group at a
+ * time, so a reader only pays for the columns and row groups it needs.
+ */
+class parquet_file {
+public:
+    static const size_t MAGIC_SIZE = 4;
+    static const char MAGIC[MAGIC_SIZE + 1];
+
+    enum class physical_type_t {
+        BOOLEAN = 0,
+        INT32 = 1,
+        INT64 = 2,
+        INT96 = 3,
+        FLOAT = 4,
+        DOUBLE = 5,
+        BYTE_ARRAY = 6,
+        FIXED_LEN_BYTE_ARRAY = 7,
+    };
+
+    /** How the values of a column are presented. */
+    enum class value_kind_t {
+        INTEGER,
+        REAL,
+        TEXT,
+        JSON,
+        BLOB,
+        /** Microseconds since the epoch, in UTC. */
+        TIMESTAMP,
+        /** Days since the epoch. */
+        DATE,
+    };
+
+    struct column {
+        std::string c_name;
+        physical_type_t c_type{physical_type_t::BYTE_ARRAY};
+        int32_t c_type_length{0};
+        bool c_optional{false};
+        value_kind_t c_kind{value_kind_t::BLOB};
+        /** For TIMESTAMP columns stored as INT64, the units per second. */
+        int64_t c_time_units{1000000};
+        /** For DECIMAL columns, the number of digits after the point. */
+        int32_t c_scale{0};
+        bool c_unsigned{false};
+        /** The index of the column's chunk in each row group. */
+        size_t c_chunk_index{0};
+    };
+
+    struct statistics {
+        /** True if the minimum and maximum are known and can be trusted. */
+        bool s_has_min_max{false};
+        /** The PLAIN encoded minimum, without a length for byte arrays. */
+        std::string s_min;
+        std::string s_max;
+        int64_t s_null_count{-1};
+    };
+
+    struct column_chunk {
+        int32_t cc_codec{0};
+        int64_t cc_num_values{0};
+        int64_t cc_data_page_offset{0};
+        int64_t cc_dictionary_page_offset{-1};
+        int64_t cc_total_compressed_size{0};
+        statistics cc_stats;
+
+        /** @return The offset of the first page of the chunk. */
+        int64_t get_start() const {
+            if (this->cc_dictionary_page_offset > 0 &&
+                this->cc_dictionary_page_offset < this->cc_data_page_offset) {
+                return this->cc_dictionary_page_offset;
+            }
+            return this->cc_data_page_offset;
+        };
+    };
+
+    struct row_group {
+        int64_t rg_num_rows{0};
+        std::vector<column_chunk> rg_chunks;
+        /** The range of the file that holds the chunks. */
+        off_t rg_start{0};
+        off_t rg_end{0};
+    };
+
+    /** A decoded value. */
+    struct cell {
+        enum type_t {
+            NULL_VALUE,
+            INTEGER,
+            REAL,
+            /** The value is a range of the values' byte storage. */
+            BYTES,
+        };
+
+        type_t c_type{NULL_VALUE};
+        union {
+            int64_t c_integer;
+            double c_real;
+            struct {
+                uint32_t cb_offset;
+                uint32_t cb_length;
+            } c_bytes;
+        };
+
+        cell() : c_integer(0) {};
+    };
+
+    /** The decoded values of a column in a row group. */
+    struct column_values {
+        std::vector<cell> cv_cells;
+        std::vector<char> cv_bytes;
+
+        const char *bytes_of(const cell &ce) const {
+            return &this->cv_bytes[ce.c_bytes.cb_offset];
+        };
+
+        void clear() {
+            this->cv_cells.clear();
+            this->cv_bytes.clear();
+        };
+    };
+
+    /**
+     * Read the metadata of a Parquet file.
+     *
+     * @param fd The file to read, it is not owned by the returned object
+     *   and needs to stay open for as long as columns are read.
+     */
+    static Result<parquet_file, std::string> open(int fd);
+
+    const std::vector<column> &get_columns() const {
+        return this->pf_columns;
+    };
+
+    const std::vector<row_group> &get_row_groups() const {
+        return this->pf_row_groups;
+    };
+
+    int64_t get_num_rows() const {
+        return this->pf_num_rows;
+    };
+
+    /**
+     * Decode the values of a column in a row group.
+     *
+     * @param rg The index of the row group.
+     * @param col The index of the column in get_columns().
+     * @param values_out The values, one for each row in the group.
+     */
+    Result<void, std::string> read_column(size_t rg,
+                                          size_t col,
+                                          column_values &values_out) const;
+
+    /**
+     * Decode the minimum and maximum of a column chunk.
+     *
+     * @return False if the statistics are missing or cannot be used.
+     */
+    bool get_min_max(size_t rg, size_t col,
+                     column_values &values_out) const;
+
+private:
+    int pf_fd{-1};
+    int64_t pf_num_rows{0};
+    std::vector<column> pf_columns;
+    std::vector<row_group> pf_row_groups;
+};
+
+/**
+ * Format a timestamp in microseconds as "YYYY-MM-DD HH:MM:SS.mmm", like the
+ * log_time column, or with microseconds and an ISO 8601 separator and
+ * offset if iso is true.
+ */
+std::string parquet_format_timestamp(int64_t micros, bool iso = false);
+
+/** Format a number of days since the epoch as "YYYY-MM-DD". */
+std::string parquet_format_date(int64_t days);
+
+#endif
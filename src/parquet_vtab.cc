@@ -0,0 +1,593 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file parquet_vtab.cc
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "auto_mem.hh"
+#include "base/lnav_log.hh"
+#include "sql_util.hh"
+#include "parquet_reader.hh"
+#include "parquet_vtab.hh"
+
+using namespace std;
+
+#define JSON_SUBTYPE  74    /* Ascii for "J" */
+
+typedef parquet_file::value_kind_t kind_t;
+typedef parquet_file::cell cell_t;
+
+struct vtab {
+    sqlite3_vtab base;
+    int fd{-1};
+    parquet_file file;
+    /** The number of rows before each row group, for the rowids. */
+    vector<int64_t> group_rows;
+
+    vtab(int fd, parquet_file pf) : fd(fd), file(std::move(pf)) {
+        memset(&this->base, 0, sizeof(this->base));
+    };
+
+    ~vtab() {
+        close(this->fd);
+    };
+};
+
+struct vtab_cursor {
+    sqlite3_vtab_cursor base;
+    /** The row groups that could have matching rows. */
+    vector<size_t> groups;
+    size_t group_index{0};
+    int64_t row{0};
+    /** The decoded columns and the group they were decoded from. */
+    vector<parquet_file::column_values> values;
+    vector<ssize_t> decoded_group;
+};
+
+static const char *decltype_of(const parquet_file::column &col)
+{
+    switch (col.c_kind) {
+        case kind_t::INTEGER:
+            return "INTEGER";
+        case kind_t::REAL:
+            return "REAL";
+        case kind_t::BLOB:
+            return "BLOB";
+        default:
+            return "TEXT";
+    }
+}
+
+static int vt_create(sqlite3 *db,
+                     void *pAux,
+                     int argc, const char *const *argv,
+                     sqlite3_vtab **pp_vt,
+                     char **pzErr)
+{
+    if (argc != 4) {
+        *pzErr = sqlite3_mprintf(
+            "expecting a single argument with the path to a parquet file");
+        return SQLITE_ERROR;
+    }
+
+    string path = argv[3];
+
+    if (path.size() >= 2 && (path[0] == '\'' || path[0] == '"') &&
+        path.back() == path[0]) {
+        path = path.substr(1, path.size() - 2);
+    }
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1) {
+        *pzErr = sqlite3_mprintf("unable to open %s -- %s",
+                                 path.c_str(), strerror(errno));
+        return SQLITE_ERROR;
+    }
+
+    auto open_res = parquet_file::open(fd);
+
+    if (open_res.isErr()) {
+        *pzErr = sqlite3_mprintf("unable to read %s -- %s",
+                                 path.c_str(),
+                                 open_res.unwrapErr().c_str());
+        close(fd);
+        return SQLITE_ERROR;
+    }
+
+    auto p_vt = new vtab(fd, open_res.unwrap());
+    const auto &columns = p_vt->file.get_columns();
+    string create_stmt = "CREATE TABLE x (";
+    int64_t rows = 0;
+
+    for (const auto &rg : p_vt->file.get_row_groups()) {
+        p_vt->group_rows.push_back(rows);
+        rows += rg.rg_num_rows;
+    }
+    for (size_t lpc = 0; lpc < columns.size(); lpc++) {
+        auto_mem<char, sqlite3_free> ident;
+
+        ident = sql_quote_ident(columns[lpc].c_name.c_str());
+        if (lpc > 0) {
+            create_stmt.append(", ");
+        }
+        create_stmt.append(ident.in());
+        create_stmt.append(" ");
+        create_stmt.append(decltype_of(columns[lpc]));
+    }
+    if (columns.empty()) {
+        create_stmt.append("__empty__ TEXT HIDDEN");
+    }
+    create_stmt.append(")");
+
+    int rc = sqlite3_declare_vtab(db, create_stmt.c_str());
+
+    if (rc != SQLITE_OK) {
+        *pzErr = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+        delete p_vt;
+        return rc;
+    }
+
+    *pp_vt = &p_vt->base;
+
+    return SQLITE_OK;
+}
+
+static int vt_destructor(sqlite3_vtab *p_svt)
+{
+    vtab *p_vt = (vtab *) p_svt;
+
+    delete p_vt;
+
+    return SQLITE_OK;
+}
+
+static int vt_connect(sqlite3 *db, void *p_aux,
+                      int argc, const char *const *argv,
+                      sqlite3_vtab **pp_vt, char **pzErr)
+{
+    return vt_create(db, p_aux, argc, argv, pp_vt, pzErr);
+}
+
+static int vt_disconnect(sqlite3_vtab *pVtab)
+{
+    return vt_destructor(pVtab);
+}
+
+static int vt_destroy(sqlite3_vtab *p_vt)
+{
+    return vt_destructor(p_vt);
+}
+
+static int vt_open(sqlite3_vtab *p_svt, sqlite3_vtab_cursor **pp_cursor)
+{
+    vtab *p_vt = (vtab *) p_svt;
+    auto p_cur = new vtab_cursor();
+    size_t column_count = p_vt->file.get_columns().size();
+
+    p_vt->base.zErrMsg = nullptr;
+    p_cur->base.pVtab = p_svt;
+    p_cur->values.resize(column_count);
+    p_cur->decoded_group.resize(column_count, -1);
+    *pp_cursor = &p_cur->base;
+
+    return SQLITE_OK;
+}
+
+static int vt_close(sqlite3_vtab_cursor *cur)
+{
+    vtab_cursor *p_cur = (vtab_cursor *) cur;
+
+    delete p_cur;
+
+    return SQLITE_OK;
+}
+
+static int vt_eof(sqlite3_vtab_cursor *cur)
+{
+    vtab_cursor *vc = (vtab_cursor *) cur;
+
+    return vc->group_index >= vc->groups.size();
+}
+
+/** Skip over the row groups that have no rows left. */
+static void skip_empty_groups(vtab_cursor *vc)
+{
+    vtab *p_vt = (vtab *) vc->base.pVtab;
+    const auto &groups = p_vt->file.get_row_groups();
+
+    while (vc->group_index < vc->groups.size() &&
+           vc->row >= groups[vc->groups[vc->group_index]].rg_num_rows) {
+        vc->group_index += 1;
+        vc->row = 0;
+    }
+}
+
+static int vt_next(sqlite3_vtab_cursor *cur)
+{
+    vtab_cursor *vc = (vtab_cursor *) cur;
+
+    vc->row += 1;
+    skip_empty_groups(vc);
+
+    return SQLITE_OK;
+}
+
+static int vt_column(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int col)
+{
+    vtab_cursor *vc = (vtab_cursor *) cur;
+    vtab *p_vt = (vtab *) cur->pVtab;
+    const auto &columns = p_vt->file.get_columns();
+
+    if (col < 0 || (size_t) col >= columns.size()) {
+        sqlite3_result_null(ctx);
+        return SQLITE_OK;
+    }
+
+    // Columns are decoded the first time they are needed in a row group,
+    // so the ones that a query does not read are never decoded.
+    size_t group = vc->groups[vc->group_index];
+    auto &values = vc->values[col];
+
+    if (vc->decoded_group[col] != (ssize_t) group) {
+        auto rc = p_vt->file.read_column(group, col, values);
+
+        if (rc.isErr()) {
+            sqlite3_free(p_vt->base.zErrMsg);
+            p_vt->base.zErrMsg = sqlite3_mprintf(
+                "unable to decode column %s -- %s",
+                columns[col].c_name.c_str(),
+                rc.unwrapErr().c_str());
+            vc->decoded_group[col] = -1;
+            return SQLITE_ERROR;
+        }
+        vc->decoded_group[col] = group;
+    }
+
+    const auto &column = columns[col];
+    const auto &ce = values.cv_cells[vc->row];
+
+    switch (ce.c_type) {
+        case cell_t::NULL_VALUE:
+            sqlite3_result_null(ctx);
+            break;
+        case cell_t::INTEGER:
+            if (column.c_kind == kind_t::TIMESTAMP) {
+                string ts = parquet_format_timestamp(ce.c_integer);
+
+                sqlite3_result_text(ctx, ts.c_str(), ts.size(),
+                                    SQLITE_TRANSIENT);
+            } else if (column.c_kind == kind_t::DATE) {
+                string date = parquet_format_date(ce.c_integer);
+
+                sqlite3_result_text(ctx, date.c_str(), date.size(),
+                                    SQLITE_TRANSIENT);
+            } else {
+                sqlite3_result_int64(ctx, ce.c_integer);
+            }
+            break;
+        case cell_t::REAL:
+            sqlite3_result_double(ctx, ce.c_real);
+            break;
+        case cell_t::BYTES:
+            if (column.c_kind == kind_t::BLOB) {
+                sqlite3_result_blob(ctx, values.bytes_of(ce),
+                                    ce.c_bytes.cb_length, SQLITE_TRANSIENT);
+            } else {
+                sqlite3_result_text(ctx, values.bytes_of(ce),
+                                    ce.c_bytes.cb_length, SQLITE_TRANSIENT);
+                if (column.c_kind == kind_t::JSON) {
+                    sqlite3_result_subtype(ctx, JSON_SUBTYPE);
+                }
+            }
+            break;
+    }
+
+    return SQLITE_OK;
+}
+
+static int vt_rowid(sqlite3_vtab_cursor *cur, sqlite_int64 *p_rowid)
+{
+    vtab_cursor *vc = (vtab_cursor *) cur;
+    vtab *p_vt = (vtab *) cur->pVtab;
+
+    *p_rowid = p_vt->group_rows[vc->groups[vc->group_index]] + vc->row;
+
+    return SQLITE_OK;
+}
+
+/**
+ * Compare a statistic with a constraint value the way SQLite would compare
+ * the column's value.
+ *
+ * @return False if the two cannot be compared, in which case the row group
+ *   cannot be skipped.
+ */
+static bool compare_stat(const parquet_file::column &col,
+                         const parquet_file::column_values &stats,
+                         const cell_t &ce,
+                         sqlite3_value *value,
+                         int &cmp_out)
+{
+    int value_type = sqlite3_value_type(value);
+
+    switch (col.c_kind) {
+        case kind_t::INTEGER:
+        case kind_t::REAL: {
+            if (value_type != SQLITE_INTEGER && value_type != SQLITE_FLOAT) {
+                return false;
+            }
+            if (ce.c_type == cell_t::INTEGER && value_type == SQLITE_INTEGER) {
+                int64_t rhs = sqlite3_value_int64(value);
+
+                cmp_out = ce.c_integer < rhs ? -1 : ce.c_integer > rhs;
+                return true;
+            }
+
+            double lhs = ce.c_type == cell_t::INTEGER ?
+                         (double) ce.c_integer : ce.c_real;
+            double rhs = sqlite3_value_double(value);
+
+            if (isnan(lhs) || isnan(rhs)) {
+                return false;
+            }
+            cmp_out = lhs < rhs ? -1 : lhs > rhs;
+            return true;
+        }
+        case kind_t::TEXT:
+        case kind_t::JSON:
+        case kind_t::TIMESTAMP:
+        case kind_t::DATE: {
+            if (value_type != SQLITE_TEXT) {
+                return false;
+            }
+
+            string lhs;
+
+            // The statistics are rendered like the column values, which
+            // keeps the order for the timestamps and dates.
+            if (col.c_kind == kind_t::TIMESTAMP) {
+                lhs = parquet_format_timestamp(ce.c_integer);
+            } else if (col.c_kind == kind_t::DATE) {
+                lhs = parquet_format_date(ce.c_integer);
+            } else {
+                lhs.assign(stats.bytes_of(ce), ce.c_bytes.cb_length);
+            }
+
+            const char *rhs = (const char *) sqlite3_value_text(value);
+            size_t rhs_len = sqlite3_value_bytes(value);
+            int rc = memcmp(lhs.data(), rhs, std::min(lhs.size(), rhs_len));
+
+            if (rc == 0) {
+                rc = lhs.size() < rhs_len ? -1 : lhs.size() > rhs_len;
+            }
+            cmp_out = rc < 0 ? -1 : rc > 0;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+/**
+ * @return True if the statistics for the row group show that none of its
+ *   rows can satisfy the constraint.
+ */
+static bool can_skip_group(const parquet_file &pf,
+                           size_t group,
+                           const sqlite3_index_info::sqlite3_index_constraint &cons,
+                           sqlite3_value *value)
+{
+    const auto &col = pf.get_columns()[cons.iColumn];
+    const auto &rg = pf.get_row_groups()[group];
+    const auto &stats = rg.rg_chunks[col.c_chunk_index].cc_stats;
+
+    if (sqlite3_value_type(value) == SQLITE_NULL) {
+        return false;
+    }
+    // None of the comparisons are true for NULL.
+    if (stats.s_null_count == rg.rg_num_rows) {
+        return true;
+    }
+
+    parquet_file::column_values min_max;
+    int min_cmp, max_cmp;
+
+    if (!pf.get_min_max(group, cons.iColumn, min_max) ||
+        !compare_stat(col, min_max, min_max.cv_cells[0], value, min_cmp) ||
+        !compare_stat(col, min_max, min_max.cv_cells[1], value, max_cmp)) {
+        return false;
+    }
+
+    switch (cons.op) {
+        case SQLITE_INDEX_CONSTRAINT_EQ:
+            return min_cmp > 0 || max_cmp < 0;
+        case SQLITE_INDEX_CONSTRAINT_GT:
+            return max_cmp <= 0;
+        case SQLITE_INDEX_CONSTRAINT_GE:
+            return max_cmp < 0;
+        case SQLITE_INDEX_CONSTRAINT_LT:
+            return min_cmp >= 0;
+        case SQLITE_INDEX_CONSTRAINT_LE:
+            return min_cmp > 0;
+        default:
+            return false;
+    }
+}
+
+static int vt_filter(sqlite3_vtab_cursor *p_vtc,
+                     int idxNum, const char *idxStr,
+                     int argc, sqlite3_value **argv)
+{
+    vtab_cursor *vc = (vtab_cursor *) p_vtc;
+    vtab *p_vt = (vtab *) p_vtc->pVtab;
+    auto *index = (const sqlite3_index_info::sqlite3_index_constraint *)
+        idxStr;
+    size_t group_count = p_vt->file.get_row_groups().size();
+
+    vc->groups.clear();
+    vc->group_index = 0;
+    vc->row = 0;
+    for (size_t group = 0; group < group_count; group++) {
+        bool skip = false;
+
+        for (int lpc = 0; lpc < idxNum && lpc < argc && !skip; lpc++) {
+            skip = can_skip_group(p_vt->file, group, index[lpc], argv[lpc]);
+        }
+        if (!skip) {
+            vc->groups.push_back(group);
+        }
+    }
+    log_info("parquet scan of %d/%d row groups",
+             vc->groups.size(), group_count);
+    skip_empty_groups(vc);
+
+    return SQLITE_OK;
+}
+
+/**
+ * @return True if the constraint compares values with the BINARY collation,
+ *   which is the order of the statistics for text.
+ */
+static bool uses_binary_collation(sqlite3_index_info *p_info, int lpc)
+{
+#if SQLITE_VERSION_NUMBER >= 3022000
+    const char *coll = sqlite3_vtab_collation(p_info, lpc);
+
+    return coll == nullptr || strcasecmp(coll, "BINARY") == 0;
+#else
+    return false;
+#endif
+}
+
+static int vt_best_index(sqlite3_vtab *tab, sqlite3_index_info *p_info)
+{
+    vtab *p_vt = (vtab *) tab;
+    const auto &columns = p_vt->file.get_columns();
+    vector<sqlite3_index_info::sqlite3_index_constraint> indexes;
+    int argvInUse = 0;
+
+    // The constraints are only used to skip row groups, SQLite still
+    // checks them for each row, so they are not omitted.
+    for (int lpc = 0; lpc < p_info->nConstraint; lpc++) {
+        const auto &cons = p_info->aConstraint[lpc];
+
+        if (!cons.usable || cons.iColumn < 0 ||
+            (size_t) cons.iColumn >= columns.size()) {
+            continue;
+        }
+
+        switch (columns[cons.iColumn].c_kind) {
+            case kind_t::INTEGER:
+            case kind_t::REAL:
+                break;
+            case kind_t::BLOB:
+                continue;
+            default:
+                if (!uses_binary_collation(p_info, lpc)) {
+                    continue;
+                }
+                break;
+        }
+
+        switch (cons.op) {
+            case SQLITE_INDEX_CONSTRAINT_EQ:
+            case SQLITE_INDEX_CONSTRAINT_GT:
+            case SQLITE_INDEX_CONSTRAINT_GE:
+            case SQLITE_INDEX_CONSTRAINT_LT:
+            case SQLITE_INDEX_CONSTRAINT_LE:
+                argvInUse += 1;
+                indexes.push_back(cons);
+                p_info->aConstraintUsage[lpc].argvIndex = argvInUse;
+                break;
+        }
+    }
+
+    p_info->estimatedRows = std::max(p_vt->file.get_num_rows(), (int64_t) 1);
+    p_info->estimatedCost = p_info->estimatedRows;
+    if (argvInUse) {
+        p_info->estimatedCost /= 10.0;
+
+        size_t len = indexes.size() * sizeof(indexes[0]);
+        auto plan = (char *) sqlite3_malloc(len);
+
+        if (plan == nullptr) {
+            return SQLITE_NOMEM;
+        }
+        memcpy(plan, &indexes[0], len);
+        p_info->idxStr = plan;
+        p_info->needToFreeIdxStr = 1;
+    }
+    p_info->idxNum = argvInUse;
+
+    return SQLITE_OK;
+}
+
+static sqlite3_module vtab_module = {
+    0,              /* iVersion */
+    vt_create,      /* xCreate       - create a vtable */
+    vt_connect,     /* xConnect      - associate a vtable with a connection */
+    vt_best_index,  /* xBestIndex    - best index */
+    vt_disconnect,  /* xDisconnect   - disassociate a vtable with a connection */
+    vt_destroy,     /* xDestroy      - destroy a vtable */
+    vt_open,        /* xOpen         - open a cursor */
+    vt_close,       /* xClose        - close a cursor */
+    vt_filter,      /* xFilter       - configure scan constraints */
+    vt_next,        /* xNext         - advance a cursor */
+    vt_eof,         /* xEof          - inidicate end of result set*/
+    vt_column,      /* xColumn       - read data */
+    vt_rowid,       /* xRowid        - read data */
+    NULL,           /* xUpdate       - write data */
+    NULL,           /* xBegin        - begin transaction */
+    NULL,           /* xSync         - sync transaction */
+    NULL,           /* xCommit       - commit transaction */
+    NULL,           /* xRollback     - rollback transaction */
+    NULL,           /* xFindFunction - function overloading */
+};
+
+int register_parquet_vtab(sqlite3 *db)
+{
+    int rc;
+
+    rc = sqlite3_create_module(db, "parquet", &vtab_module, NULL);
+    ensure(rc == SQLITE_OK);
+
+    return rc;
+}
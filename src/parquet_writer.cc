@@ -0,0 +1,819 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file parquet_writer.cc
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef HAVE_ZSTD_H
+#include <zstd.h>
+#endif
+
+#include "base/lnav_log.hh"
+#include "parquet_writer.hh"
+
+using namespace std;
+
+enum {
+    TYPE_INT64 = 2,
+    TYPE_DOUBLE = 5,
+    TYPE_BYTE_ARRAY = 6,
+};
+
+enum {
+    REPETITION_OPTIONAL = 1,
+};
+
+enum {
+    CONVERTED_UTF8 = 0,
+};
+
+enum {
+    LOGICAL_STRING = 1,
+};
+
+enum {
+    CODEC_GZIP = 2,
+    CODEC_ZSTD = 6,
+};
+
+enum {
+    ENCODING_PLAIN = 0,
+    ENCODING_RLE = 3,
+    ENCODING_RLE_DICTIONARY = 8,
+};
+
+enum {
+    PAGE_DATA = 0,
+    PAGE_DICTIONARY = 2,
+};
+
+#ifdef HAVE_ZSTD_H
+static const int32_t PAGE_CODEC = CODEC_ZSTD;
+#else
+static const int32_t PAGE_CODEC = CODEC_GZIP;
+#endif
+
+/** The most groups of eight values in one bit-packed run. */
+static const size_t MAX_PACKED_GROUPS = 63;
+
+static void put_uleb(string &out, uint64_t value)
+{
+    do {
+        uint8_t b = value & 0x7f;
+
+        value >>= 7;
+        out.push_back(value ? (b | 0x80) : b);
+    } while (value);
+}
+
+static uint64_t zigzag(int64_t value)
+{
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static void put_le32(string &out, uint32_t value)
+{
+    for (int lpc = 0; lpc < 4; lpc++) {
+        out.push_back((value >> (8 * lpc)) & 0xff);
+    }
+}
+
+static void put_le64(string &out, uint64_t value)
+{
+    put_le32(out, value);
+    put_le32(out, value >> 32);
+}
+
+static uint64_t real_bits(double value)
+{
+    uint64_t retval;
+
+    memcpy(&retval, &value, sizeof(retval));
+    return retval;
+}
+
+/** Writer for the Thrift compact protocol. */
+class compact_writer {
+public:
+    enum {
+        CT_I32 = 5,
+        CT_I64 = 6,
+        CT_BINARY = 8,
+        CT_LIST = 9,
+        CT_STRUCT = 12,
+    };
+
+    string cw_out;
+
+    void field(int16_t id, uint8_t type) {
+        int16_t delta = id - this->cw_last.back();
+
+        if (delta > 0 && delta <= 15) {
+            this->cw_out.push_back((delta << 4) | type);
+        } else {
+            this->cw_out.push_back(type);
+            put_uleb(this->cw_out, zigzag(id));
+        }
+        this->cw_last.back() = id;
+    };
+
+    void i32(int16_t id, int32_t value) {
+        this->field(id, CT_I32);
+        this->raw_int(value);
+    };
+
+    void i64(int16_t id, int64_t value) {
+        this->field(id, CT_I64);
+        this->raw_int(value);
+    };
+
+    void binary(int16_t id, const string &value) {
+        this->field(id, CT_BINARY);
+        this->raw_binary(value);
+    };
+
+    void raw_int(int64_t value) {
+        put_uleb(this->cw_out, zigzag(value));
+    };
+
+    void raw_binary(const string &value) {
+        put_uleb(this->cw_out, value.size());
+        this->cw_out.append(value);
+    };
+
+    void begin_struct(int16_t id) {
+        this->field(id, CT_STRUCT);
+        this->cw_last.push_back(0);
+    };
+
+    /** Start a struct that is an element of a list or the top level. */
+    void begin_struct() {
+        this->cw_last.push_back(0);
+    };
+
+    void end_struct() {
+        this->cw_out.push_back(0);
+        this->cw_last.pop_back();
+    };
+
+    void list(int16_t id, uint8_t elem_type, size_t size) {
+        this->field(id, CT_LIST);
+        if (size < 15) {
+            this->cw_out.push_back((size << 4) | elem_type);
+        } else {
+            this->cw_out.push_back(0xf0 | elem_type);
+            put_uleb(this->cw_out, size);
+        }
+    };
+
+private:
+    vector<int16_t> cw_last{0};
+};
+
+/** @return The number of bits needed for values up to max_value. */
+static int bit_width(uint32_t max_value)
+{
+    int retval = 1;
+
+    while (retval < 32 && (max_value >> retval) != 0) {
+        retval += 1;
+    }
+
+    return retval;
+}
+
+/**
+ * Encode values in the RLE/bit-packing hybrid encoding.  Runs of at least
+ * eight equal values are written as a repeated value and everything in
+ * between is bit-packed in groups of eight.
+ */
+static void encode_hybrid(const vector<uint32_t> &values,
+                          int width,
+                          string &out)
+{
+    size_t byte_width = (width + 7) / 8;
+    size_t count = values.size();
+    auto run_at = [&values, count](size_t start) {
+        size_t end = start + 1;
+
+        while (end < count && values[end] == values[start]) {
+            end += 1;
+        }
+
+        return end - start;
+    };
+    size_t pos = 0;
+
+    while (pos < count) {
+        size_t run = run_at(pos);
+
+        if (run >= 8) {
+            put_uleb(out, run << 1);
+            for (size_t lpc = 0; lpc < byte_width; lpc++) {
+                out.push_back((values[pos] >> (8 * lpc)) & 0xff);
+            }
+            pos += run;
+            continue;
+        }
+
+        size_t start = pos, groups = 0;
+
+        do {
+            pos += 8;
+            groups += 1;
+        } while (pos < count && groups < MAX_PACKED_GROUPS &&
+                 run_at(pos) < 8);
+
+        size_t end = std::min(pos, count);
+
+        put_uleb(out, (groups << 1) | 1);
+
+        size_t first_byte = out.size();
+        // The last group is padded with zeros.
+        out.append(groups * width, '\0');
+        for (size_t index = start; index < end; index++) {
+            size_t bit = (index - start) * width;
+
+            for (int lpc = 0; lpc < width; lpc++, bit++) {
+                if ((values[index] >> lpc) & 1) {
+                    out[first_byte + bit / 8] |= 1 << (bit % 8);
+                }
+            }
+        }
+        pos = end;
+    }
+}
+
+static bool compress_page(const string &in, string &out)
+{
+#ifdef HAVE_ZSTD_H
+    out.resize(ZSTD_compressBound(in.size()));
+
+    size_t rc = ZSTD_compress(&out[0], out.size(), in.data(), in.size(), 3);
+
+    if (ZSTD_isError(rc)) {
+        return false;
+    }
+    out.resize(rc);
+
+    return true;
+#else
+    z_stream strm;
+
+    memset(&strm, 0, sizeof(strm));
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                     15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    out.resize(deflateBound(&strm, in.size()) + 32);
+    strm.next_in = (Bytef *) in.data();
+    strm.avail_in = in.size();
+    strm.next_out = (Bytef *) &out[0];
+    strm.avail_out = out.size();
+
+    int rc = deflate(&strm, Z_FINISH);
+
+    out.resize(out.size() - strm.avail_out);
+    deflateEnd(&strm);
+
+    return rc == Z_STREAM_END;
+#endif
+}
+
+/** Pick the type of a column the way SQLite picks a column's affinity. */
+static int type_for_decl(const char *decl_type, int value_type)
+{
+    if (decl_type != nullptr) {
+        string decl = decl_type;
+
+        transform(decl.begin(), decl.end(), decl.begin(), ::tolower);
+        if (decl.find("int") != string::npos) {
+            return SQLITE_INTEGER;
+        }
+        if (decl.find("char") != string::npos ||
+            decl.find("clob") != string::npos ||
+            decl.find("text") != string::npos) {
+            return SQLITE_TEXT;
+        }
+        if (decl.find("blob") != string::npos) {
+            return SQLITE_BLOB;
+        }
+        if (decl.find("real") != string::npos ||
+            decl.find("floa") != string::npos ||
+            decl.find("doub") != string::npos) {
+            return SQLITE_FLOAT;
+        }
+    }
+
+    // Expressions and numeric columns go by the value in the first row.
+    return value_type;
+}
+
+void parquet_writer::column_buffer::clear()
+{
+    this->cb_levels.clear();
+    this->cb_plain.clear();
+    this->cb_null_count = 0;
+    this->cb_use_dict = true;
+    this->cb_dict.clear();
+    this->cb_dict_plain.clear();
+    this->cb_indexes.clear();
+    this->cb_has_min_max = false;
+    this->cb_min_str.clear();
+    this->cb_max_str.clear();
+}
+
+parquet_writer::parquet_writer(FILE *file, size_t max_group_rows)
+    : pw_file(file), pw_max_group_rows(std::max((size_t) 1, max_group_rows))
+{
+    this->write_out("PAR1");
+}
+
+parquet_writer::~parquet_writer()
+{
+    if (this->pw_file != nullptr) {
+        fclose(this->pw_file);
+    }
+}
+
+void parquet_writer::init_columns(sqlite3_stmt *stmt)
+{
+    int ncols = sqlite3_column_count(stmt);
+
+    this->pw_columns.resize(ncols);
+    for (int lpc = 0; lpc < ncols; lpc++) {
+        auto &cb = this->pw_columns[lpc];
+        const char *name = sqlite3_column_name(stmt, lpc);
+
+        cb.cb_name = name == nullptr ? "" : name;
+        // Readers expect the column names to be unique.
+        for (int prev = 0; prev < lpc; prev++) {
+            if (this->pw_columns[prev].cb_name == cb.cb_name) {
+                cb.cb_name += "_" + to_string(lpc);
+                break;
+            }
+        }
+        switch (type_for_decl(sqlite3_column_decltype(stmt, lpc),
+                              sqlite3_column_type(stmt, lpc))) {
+            case SQLITE_INTEGER:
+                cb.cb_type = column_type_t::INT64;
+                break;
+            case SQLITE_FLOAT:
+                cb.cb_type = column_type_t::DOUBLE;
+                break;
+            case SQLITE_BLOB:
+                cb.cb_type = column_type_t::BLOB;
+                break;
+            default:
+                cb.cb_type = column_type_t::TEXT;
+                break;
+        }
+    }
+}
+
+void parquet_writer::add_bytes(column_buffer &cb, const char *data, size_t len)
+{
+    string value(data, len);
+
+    if (cb.cb_use_dict) {
+        auto iter = cb.cb_dict.find(value);
+
+        if (iter != cb.cb_dict.end()) {
+            cb.cb_indexes.push_back(iter->second);
+        } else if (cb.cb_dict.size() >= MAX_DICTIONARY_ENTRIES ||
+                   cb.cb_dict_plain.size() + len > MAX_DICTIONARY_BYTES) {
+            // Too many distinct values for a dictionary to pay off.
+            cb.cb_use_dict = false;
+            cb.cb_dict.clear();
+            cb.cb_dict_plain.clear();
+            cb.cb_indexes.clear();
+            cb.cb_indexes.shrink_to_fit();
+        } else {
+            uint32_t index = cb.cb_dict.size();
+
+            cb.cb_dict.emplace(value, index);
+            put_le32(cb.cb_dict_plain, len);
+            cb.cb_dict_plain.append(data, len);
+            cb.cb_indexes.push_back(index);
+        }
+    }
+    put_le32(cb.cb_plain, len);
+    cb.cb_plain.append(data, len);
+    this->pw_group_bytes += len + 4;
+
+    if (!cb.cb_has_min_max) {
+        cb.cb_has_min_max = true;
+        cb.cb_min_str = value;
+        cb.cb_max_str = value;
+    } else if (value < cb.cb_min_str) {
+        cb.cb_min_str = value;
+    } else if (cb.cb_max_str < value) {
+        cb.cb_max_str = value;
+    }
+}
+
+void parquet_writer::add_value(column_buffer &cb, sqlite3_stmt *stmt, int col)
+{
+    int value_type = sqlite3_column_type(stmt, col);
+
+    if (value_type == SQLITE_NULL) {
+        cb.cb_levels.push_back(0);
+        cb.cb_null_count += 1;
+        return;
+    }
+
+    switch (cb.cb_type) {
+        case column_type_t::INT64: {
+            if (value_type != SQLITE_INTEGER && value_type != SQLITE_FLOAT) {
+                break;
+            }
+
+            int64_t value = sqlite3_column_int64(stmt, col);
+
+            put_le64(cb.cb_plain, value);
+            this->pw_group_bytes += 8;
+            if (!cb.cb_has_min_max) {
+                cb.cb_has_min_max = true;
+                cb.cb_min_int = cb.cb_max_int = value;
+            } else {
+                cb.cb_min_int = std::min(cb.cb_min_int, value);
+                cb.cb_max_int = std::max(cb.cb_max_int, value);
+            }
+            cb.cb_levels.push_back(1);
+            return;
+        }
+        case column_type_t::DOUBLE: {
+            if (value_type != SQLITE_INTEGER && value_type != SQLITE_FLOAT) {
+                break;
+            }
+
+            double value = sqlite3_column_double(stmt, col);
+
+            put_le64(cb.cb_plain, real_bits(value));
+            this->pw_group_bytes += 8;
+            if (!std::isnan(value)) {
+                if (!cb.cb_has_min_max) {
+                    cb.cb_has_min_max = true;
+                    cb.cb_min_real = cb.cb_max_real = value;
+                } else {
+                    cb.cb_min_real = std::min(cb.cb_min_real, value);
+                    cb.cb_max_real = std::max(cb.cb_max_real, value);
+                }
+            }
+            cb.cb_levels.push_back(1);
+            return;
+        }
+        case column_type_t::TEXT: {
+            auto value = (const char *) sqlite3_column_text(stmt, col);
+
+            this->add_bytes(cb, value, sqlite3_column_bytes(stmt, col));
+            cb.cb_levels.push_back(1);
+            return;
+        }
+        case column_type_t::BLOB: {
+            auto value = (const char *) sqlite3_column_blob(stmt, col);
+
+            this->add_bytes(cb, value, sqlite3_column_bytes(stmt, col));
+            cb.cb_levels.push_back(1);
+            return;
+        }
+    }
+
+    // A text or blob value in a numeric column.
+    this->pw_unconverted += 1;
+    cb.cb_levels.push_back(0);
+    cb.cb_null_count += 1;
+}
+
+bool parquet_writer::write_row(sqlite3_stmt *stmt)
+{
+    if (this->pw_failed) {
+        return false;
+    }
+
+    if (this->pw_total_rows == 0) {
+        this->init_columns(stmt);
+    }
+    for (size_t lpc = 0; lpc < this->pw_columns.size(); lpc++) {
+        this->add_value(this->pw_columns[lpc], stmt, lpc);
+    }
+    this->pw_group_bytes += this->pw_columns.size();
+    this->pw_group_rows += 1;
+    this->pw_total_rows += 1;
+
+    if (this->pw_group_rows >= this->pw_max_group_rows ||
+        this->pw_group_bytes >= MAX_GROUP_BYTES) {
+        this->write_group();
+    }
+
+    return !this->pw_failed;
+}
+
+bool parquet_writer::write_out(const string &data)
+{
+    if (this->pw_failed) {
+        return false;
+    }
+    if (fwrite(data.data(), 1, data.size(), this->pw_file) != data.size()) {
+        this->pw_failed = true;
+        return false;
+    }
+    this->pw_offset += data.size();
+
+    return true;
+}
+
+bool parquet_writer::write_page(int32_t page_type,
+                                int32_t num_values,
+                                int32_t encoding,
+                                const string &body,
+                                int64_t &uncompressed_out,
+                                int64_t &compressed_out)
+{
+    if (!compress_page(body, this->pw_page)) {
+        log_error("unable to compress parquet page");
+        this->pw_failed = true;
+        return false;
+    }
+
+    compact_writer cw;
+
+    cw.begin_struct();
+    cw.i32(1, page_type);
+    cw.i32(2, body.size());
+    cw.i32(3, this->pw_page.size());
+    if (page_type == PAGE_DICTIONARY) {
+        cw.begin_struct(7);
+        cw.i32(1, num_values);
+        cw.i32(2, encoding);
+        cw.end_struct();
+    } else {
+        cw.begin_struct(5);
+        cw.i32(1, num_values);
+        cw.i32(2, encoding);
+        cw.i32(3, ENCODING_RLE);
+        cw.i32(4, ENCODING_RLE);
+        cw.end_struct();
+    }
+    cw.end_struct();
+
+    uncompressed_out += cw.cw_out.size() + body.size();
+    compressed_out += cw.cw_out.size() + this->pw_page.size();
+
+    return this->write_out(cw.cw_out) && this->write_out(this->pw_page);
+}
+
+bool parquet_writer::write_chunk(column_buffer &cb, chunk_meta &cm_out)
+{
+    size_t non_null = cb.cb_levels.size() - cb.cb_null_count;
+    bool is_bytes = cb.cb_type == column_type_t::TEXT ||
+                    cb.cb_type == column_type_t::BLOB;
+    // The dictionary is only worth it if the values repeat.
+    bool use_dict = is_bytes && cb.cb_use_dict && !cb.cb_dict.empty() &&
+                    cb.cb_dict.size() * 2 <= non_null;
+    string levels, page;
+
+    cm_out.cm_type = cb.cb_type;
+    cm_out.cm_dict = use_dict;
+    cm_out.cm_num_values = cb.cb_levels.size();
+    cm_out.cm_dict_offset = -1;
+    cm_out.cm_compressed_size = 0;
+    cm_out.cm_uncompressed_size = 0;
+    cm_out.cm_null_count = cb.cb_null_count;
+    cm_out.cm_has_min_max = cb.cb_has_min_max;
+    switch (cb.cb_type) {
+        case column_type_t::INT64:
+            put_le64(cm_out.cm_min, cb.cb_min_int);
+            put_le64(cm_out.cm_max, cb.cb_max_int);
+            break;
+        case column_type_t::DOUBLE:
+            put_le64(cm_out.cm_min, real_bits(cb.cb_min_real));
+            put_le64(cm_out.cm_max, real_bits(cb.cb_max_real));
+            break;
+        case column_type_t::TEXT:
+        case column_type_t::BLOB:
+            if (cb.cb_min_str.size() > MAX_STAT_LENGTH ||
+                cb.cb_max_str.size() > MAX_STAT_LENGTH) {
+                cm_out.cm_has_min_max = false;
+                break;
+            }
+            cm_out.cm_min = cb.cb_min_str;
+            cm_out.cm_max = cb.cb_max_str;
+            break;
+    }
+
+    encode_hybrid(cb.cb_levels, 1, levels);
+    put_le32(page, levels.size());
+    page.append(levels);
+
+    if (use_dict) {
+        int width = bit_width(cb.cb_dict.size() - 1);
+
+        cm_out.cm_dict_offset = this->pw_offset;
+        if (!this->write_page(PAGE_DICTIONARY,
+                              cb.cb_dict.size(),
+                              ENCODING_PLAIN,
+                              cb.cb_dict_plain,
+                              cm_out.cm_uncompressed_size,
+                              cm_out.cm_compressed_size)) {
+            return false;
+        }
+        page.push_back(width);
+        encode_hybrid(cb.cb_indexes, width, page);
+    } else {
+        page.append(cb.cb_plain);
+    }
+
+    cm_out.cm_data_offset = this->pw_offset;
+
+    return this->write_page(PAGE_DATA,
+                            cb.cb_levels.size(),
+                            use_dict ? ENCODING_RLE_DICTIONARY :
+                                       ENCODING_PLAIN,
+                            page,
+                            cm_out.cm_uncompressed_size,
+                            cm_out.cm_compressed_size);
+}
+
+bool parquet_writer::write_group()
+{
+    group_meta gm;
+
+    gm.gm_num_rows = this->pw_group_rows;
+    gm.gm_byte_size = 0;
+    gm.gm_chunks.resize(this->pw_columns.size());
+    for (size_t lpc = 0; lpc < this->pw_columns.size(); lpc++) {
+        auto &cb = this->pw_columns[lpc];
+
+        if (!this->write_chunk(cb, gm.gm_chunks[lpc])) {
+            return false;
+        }
+        gm.gm_byte_size += gm.gm_chunks[lpc].cm_uncompressed_size;
+        cb.clear();
+    }
+    this->pw_groups.emplace_back(std::move(gm));
+    this->pw_group_rows = 0;
+    this->pw_group_bytes = 0;
+
+    return true;
+}
+
+string parquet_writer::encode_footer() const
+{
+    compact_writer cw;
+
+    cw.begin_struct();
+    cw.i32(1, 1);
+    cw.list(2, compact_writer::CT_STRUCT, this->pw_columns.size() + 1);
+    cw.begin_struct();
+    cw.binary(4, "schema");
+    cw.i32(5, this->pw_columns.size());
+    cw.end_struct();
+    for (const auto &cb : this->pw_columns) {
+        cw.begin_struct();
+        switch (cb.cb_type) {
+            case column_type_t::INT64:
+                cw.i32(1, TYPE_INT64);
+                break;
+            case column_type_t::DOUBLE:
+                cw.i32(1, TYPE_DOUBLE);
+                break;
+            case column_type_t::TEXT:
+            case column_type_t::BLOB:
+                cw.i32(1, TYPE_BYTE_ARRAY);
+                break;
+        }
+        cw.i32(3, REPETITION_OPTIONAL);
+        cw.binary(4, cb.cb_name);
+        if (cb.cb_type == column_type_t::TEXT) {
+            cw.i32(6, CONVERTED_UTF8);
+            cw.begin_struct(10);
+            cw.begin_struct(LOGICAL_STRING);
+            cw.end_struct();
+            cw.end_struct();
+        }
+        cw.end_struct();
+    }
+    cw.i64(3, this->pw_total_rows);
+    cw.list(4, compact_writer::CT_STRUCT, this->pw_groups.size());
+    for (const auto &gm : this->pw_groups) {
+        cw.begin_struct();
+        cw.list(1, compact_writer::CT_STRUCT, gm.gm_chunks.size());
+        for (size_t lpc = 0; lpc < gm.gm_chunks.size(); lpc++) {
+            const auto &cm = gm.gm_chunks[lpc];
+
+            cw.begin_struct();
+            cw.i64(2, cm.cm_dict ? cm.cm_dict_offset : cm.cm_data_offset);
+            cw.begin_struct(3);
+            cw.i32(1, cm.cm_type == column_type_t::INT64 ? TYPE_INT64 :
+                      cm.cm_type == column_type_t::DOUBLE ? TYPE_DOUBLE :
+                                                            TYPE_BYTE_ARRAY);
+            if (cm.cm_dict) {
+                cw.list(2, compact_writer::CT_I32, 3);
+                cw.raw_int(ENCODING_PLAIN);
+                cw.raw_int(ENCODING_RLE);
+                cw.raw_int(ENCODING_RLE_DICTIONARY);
+            } else {
+                cw.list(2, compact_writer::CT_I32, 2);
+                cw.raw_int(ENCODING_PLAIN);
+                cw.raw_int(ENCODING_RLE);
+            }
+            cw.list(3, compact_writer::CT_BINARY, 1);
+            cw.raw_binary(this->pw_columns[lpc].cb_name);
+            cw.i32(4, PAGE_CODEC);
+            cw.i64(5, cm.cm_num_values);
+            cw.i64(6, cm.cm_uncompressed_size);
+            cw.i64(7, cm.cm_compressed_size);
+            cw.i64(9, cm.cm_data_offset);
+            if (cm.cm_dict) {
+                cw.i64(11, cm.cm_dict_offset);
+            }
+            cw.begin_struct(12);
+            cw.i64(3, cm.cm_null_count);
+            if (cm.cm_has_min_max) {
+                cw.binary(5, cm.cm_max);
+                cw.binary(6, cm.cm_min);
+            }
+            cw.end_struct();
+            cw.end_struct();
+            cw.end_struct();
+        }
+        cw.i64(2, gm.gm_byte_size);
+        cw.i64(3, gm.gm_num_rows);
+        cw.end_struct();
+    }
+    cw.binary(6, VCS_PACKAGE_STRING);
+    cw.end_struct();
+
+    return cw.cw_out;
+}
+
+Result<size_t, string> parquet_writer::finish()
+{
+    if (this->pw_group_rows > 0) {
+        this->write_group();
+    }
+
+    string footer = this->encode_footer();
+    string trailer;
+
+    put_le32(trailer, footer.size());
+    trailer.append("PAR1");
+    this->write_out(footer);
+    this->write_out(trailer);
+
+    int close_errno = 0;
+
+    if (fclose(this->pw_file) != 0) {
+        close_errno = errno;
+        this->pw_failed = true;
+    }
+    this->pw_file = nullptr;
+
+    if (this->pw_unconverted > 0) {
+        log_warning("parquet export: wrote %zu non-numeric values in numeric "
+                    "columns as nulls",
+                    this->pw_unconverted);
+    }
+    if (this->pw_failed) {
+        return Err(string("unable to write file -- ") +
+                   strerror(close_errno != 0 ? close_errno : errno));
+    }
+
+    return Ok(this->pw_total_rows);
+}
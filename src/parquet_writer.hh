@@ -0,0 +1,185 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file parquet_writer.hh
+ */
+
+#ifndef lnav_parquet_writer_hh
+#define lnav_parquet_writer_hh
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "base/result.h"
+
+/**
+ * Writes the rows of a query to an Apache Parquet file.  The values are
+ * collected into columns as the statement is stepped and written out a row
+ * group at a time, so the memory used is bounded by the size of a group.
+ * Text columns with few distinct values in a group, like log levels or host
+ * names, are written with a dictionary, everything else is PLAIN encoded.
+ * The pages are compressed with zstd, if it is available, or gzip.
+ */
+class parquet_writer {
+public:
+    /** The number of rows in a row group before it is written out. */
+    static const size_t MAX_GROUP_ROWS = 128 * 1024;
+    /** The amount of values, across all columns, to buffer for a group. */
+    static const size_t MAX_GROUP_BYTES = 64 * 1024 * 1024;
+    /** The limits past which a column stops building a dictionary. */
+    static const size_t MAX_DICTIONARY_ENTRIES = 64 * 1024;
+    static const size_t MAX_DICTIONARY_BYTES = 1024 * 1024;
+    /** Strings longer than this are left out of the statistics. */
+    static const size_t MAX_STAT_LENGTH = 64;
+
+    /**
+     * @param file The file to write to, which is closed by finish().
+     * @param max_group_rows The number of rows in a row group.
+     */
+    explicit parquet_writer(FILE *file,
+                            size_t max_group_rows = MAX_GROUP_ROWS);
+
+    ~parquet_writer();
+
+    /**
+     * Add the current row of the statement.  The column types are picked
+     * from the declared types of the first row's columns or, for
+     * expressions, the values in the first row.  Later values are converted
+     * with sqlite3_column_int64() or sqlite3_column_double(), except for
+     * text and blobs in a numeric column, which are written as nulls.
+     *
+     * @return False if the file could not be written.
+     */
+    bool write_row(sqlite3_stmt *stmt);
+
+    /**
+     * Write the remaining rows and the footer and close the file.
+     *
+     * @return The number of rows written or an error message.
+     */
+    Result<size_t, std::string> finish();
+
+private:
+    enum class column_type_t {
+        INT64,
+        DOUBLE,
+        TEXT,
+        BLOB,
+    };
+
+    struct column_buffer {
+        std::string cb_name;
+        column_type_t cb_type{column_type_t::TEXT};
+        /** One definition level for each row, zero if the value is null. */
+        std::vector<uint32_t> cb_levels;
+        /** The PLAIN encoding of the values that are not null. */
+        std::string cb_plain;
+        size_t cb_null_count{0};
+        /** True while the values of the group fit in a dictionary. */
+        bool cb_use_dict{true};
+        std::unordered_map<std::string, uint32_t> cb_dict;
+        /** The PLAIN encoding of the dictionary entries, in order. */
+        std::string cb_dict_plain;
+        std::vector<uint32_t> cb_indexes;
+        bool cb_has_min_max{false};
+        int64_t cb_min_int{0};
+        int64_t cb_max_int{0};
+        double cb_min_real{0.0};
+        double cb_max_real{0.0};
+        std::string cb_min_str;
+        std::string cb_max_str;
+
+        void clear();
+    };
+
+    struct chunk_meta {
+        column_type_t cm_type;
+        bool cm_dict;
+        int64_t cm_num_values;
+        int64_t cm_dict_offset;
+        int64_t cm_data_offset;
+        int64_t cm_compressed_size;
+        int64_t cm_uncompressed_size;
+        int64_t cm_null_count;
+        bool cm_has_min_max;
+        std::string cm_min;
+        std::string cm_max;
+    };
+
+    struct group_meta {
+        int64_t gm_num_rows;
+        int64_t gm_byte_size;
+        std::vector<chunk_meta> gm_chunks;
+    };
+
+    void init_columns(sqlite3_stmt *stmt);
+
+    void add_value(column_buffer &cb, sqlite3_stmt *stmt, int col);
+
+    void add_bytes(column_buffer &cb, const char *data, size_t len);
+
+    bool write_group();
+
+    bool write_chunk(column_buffer &cb, chunk_meta &cm_out);
+
+    /**
+     * Compress and write a page.  The sizes of the page, including its
+     * header, are added to uncompressed_out and compressed_out.
+     */
+    bool write_page(int32_t page_type,
+                    int32_t num_values,
+                    int32_t encoding,
+                    const std::string &body,
+                    int64_t &uncompressed_out,
+                    int64_t &compressed_out);
+
+    bool write_out(const std::string &data);
+
+    std::string encode_footer() const;
+
+    FILE *pw_file;
+    size_t pw_max_group_rows;
+    bool pw_failed{false};
+    int64_t pw_offset{0};
+    size_t pw_total_rows{0};
+    size_t pw_group_rows{0};
+    size_t pw_group_bytes{0};
+    size_t pw_unconverted{0};
+    std::vector<column_buffer> pw_columns;
+    std::vector<group_meta> pw_groups;
+    std::string pw_page;
+};
+
+#endif
@@ -31,8 +31,16 @@
 
 #include "config.h"
 
+#include <ctype.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
 #include <pcrecpp.h>
 
+#include "base/lru_cache.hh"
 #include "pcrepp.hh"
 
 using namespace std;
@@ -40,6 +48,52 @@ using namespace std;
 const int JIT_STACK_MIN_SIZE = 32 * 1024;
 const int JIT_STACK_MAX_SIZE = 512 * 1024;
 
+static atomic<size_t> JIT_STACK_SIZE{JIT_STACK_MAX_SIZE};
+static atomic<unsigned long> MATCH_LIMIT{10000};
+static atomic<unsigned long> MATCH_LIMIT_RECURSION{500};
+
+static const size_t PATTERN_CACHE_SIZE = 128;
+
+static mutex PATTERN_CACHE_MUTEX;
+
+static lru_cache<string, shared_ptr<pcrepp>> &pattern_cache()
+{
+    static lru_cache<string, shared_ptr<pcrepp>> retval(PATTERN_CACHE_SIZE);
+
+    return retval;
+}
+
+shared_ptr<pcrepp> pcrepp::cached(const string &pattern, int options)
+{
+    string key = to_string(options) + ":" + pattern;
+    lock_guard<mutex> lg(PATTERN_CACHE_MUTEX);
+    auto &cache = pattern_cache();
+    auto *existing = cache.find(key);
+
+    if (existing != nullptr) {
+        return *existing;
+    }
+
+    auto retval = make_shared<pcrepp>(pattern.c_str(), options);
+
+    cache.insert(key, retval);
+
+    return retval;
+}
+
+pcrepp::cache_stats pcrepp::get_cache_stats()
+{
+    lock_guard<mutex> lg(PATTERN_CACHE_MUTEX);
+    auto &cache = pattern_cache();
+
+    return {
+        cache.size(),
+        cache.get_hits(),
+        cache.get_misses(),
+        cache.get_evictions(),
+    };
+}
+
 pcre_context::capture_t *pcre_context::operator[](const char *name) const
 {
     capture_t *retval = NULL;
@@ -147,8 +201,10 @@ bool pcrepp::match(pcre_context &pc, pcre_input &pi, int options) const
         startoffset = pi.pi_offset;
         length      = pi.pi_length;
     }
+    pcre_extra extra;
+
     rc = pcre_exec(this->p_code,
-                   this->p_code_extra.in(),
+                   this->exec_extra(extra),
                    str,
                    length,
                    startoffset,
@@ -165,7 +221,9 @@ bool pcrepp::match(pcre_context &pc, pcre_input &pi, int options) const
                 return true;
 
             default:
-                log_error("pcre err %d", rc);
+                if (!record_limit_hit(rc, this->p_limit_hits)) {
+                    log_error("pcre err %d", rc);
+                }
                 break;
         }
     }
@@ -193,10 +251,39 @@ bool pcrepp::match(pcre_context &pc, pcre_input &pi, int options) const
     return rc > 0;
 }
 
-void pcrepp::study(void)
+bool pcrepp::record_limit_hit(int rc, std::atomic<uint32_t> &hits)
 {
+    switch (rc) {
+        case PCRE_ERROR_MATCHLIMIT:
+        case PCRE_ERROR_RECURSIONLIMIT:
+#ifdef PCRE_ERROR_JIT_STACKLIMIT
+        case PCRE_ERROR_JIT_STACKLIMIT:
+#endif
+            break;
+        default:
+            return false;
+    }
+
+    auto prev = hits.fetch_add(1, memory_order_relaxed);
+
+    if (prev + 1 == LIMIT_HITS_BUDGET) {
+        log_warning("pattern is over its match limit budget, rc=%d", rc);
+    }
+
+    return true;
+}
+
+void pcrepp::study(void) const
+{
+    static mutex STUDY_MUTEX;
+
+    lock_guard<mutex> lg(STUDY_MUTEX);
     const char *errptr;
 
+    if (this->p_studied) {
+        return;
+    }
+
     this->p_code_extra = pcre_study(this->p_code,
 #ifdef PCRE_STUDY_JIT_COMPILE
                                     PCRE_STUDY_JIT_COMPILE,
@@ -212,40 +299,103 @@ void pcrepp::study(void)
 
         extra->flags |= (PCRE_EXTRA_MATCH_LIMIT |
                          PCRE_EXTRA_MATCH_LIMIT_RECURSION);
-        extra->match_limit           = 10000;
-        extra->match_limit_recursion = 500;
+        extra->match_limit           = MATCH_LIMIT;
+        extra->match_limit_recursion = MATCH_LIMIT_RECURSION;
 #ifdef PCRE_STUDY_JIT_COMPILE
-        // pcre_assign_jit_stack(extra, NULL, jit_stack());
+        // The study data is shared by every thread that uses this pattern,
+        // so the callback hands out a stack that belongs to the caller.
+        pcre_assign_jit_stack(extra, jit_stack, nullptr);
 #endif
     }
+    this->p_studied.store(true, memory_order_release);
+}
+
+void pcrepp::load_info()
+{
     pcre_fullinfo(this->p_code,
-                  this->p_code_extra,
+                  nullptr,
                   PCRE_INFO_CAPTURECOUNT,
                   &this->p_capture_count);
     pcre_fullinfo(this->p_code,
-                  this->p_code_extra,
+                  nullptr,
                   PCRE_INFO_NAMECOUNT,
                   &this->p_named_count);
     pcre_fullinfo(this->p_code,
-                  this->p_code_extra,
+                  nullptr,
                   PCRE_INFO_NAMEENTRYSIZE,
                   &this->p_name_len);
     pcre_fullinfo(this->p_code,
-                  this->p_code_extra,
+                  nullptr,
                   PCRE_INFO_NAMETABLE,
                   &this->p_named_entries);
 }
 
+const pcre_extra *pcrepp::exec_extra(pcre_extra &buf) const
+{
+    bool studied = this->p_studied.load(memory_order_acquire);
+
+    if (!studied && this->p_match_count++ >= STUDY_AFTER_MATCHES) {
+        // Studying and JIT-compiling is expensive, so it is only done for
+        // the patterns that are actually used.
+        this->study();
+        studied = true;
+    }
+
+    if (!studied || this->p_code_extra == nullptr) {
+        memset(&buf, 0, sizeof(buf));
+        buf.flags = PCRE_EXTRA_MATCH_LIMIT | PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+    } else {
+        buf = *this->p_code_extra.in();
+    }
+    buf.match_limit = MATCH_LIMIT;
+    buf.match_limit_recursion = MATCH_LIMIT_RECURSION;
+
+    return &buf;
+}
+
+void pcrepp::set_jit_stack_size(size_t max_size)
+{
+    JIT_STACK_SIZE = std::max(max_size, (size_t) JIT_STACK_MIN_SIZE);
+}
+
+void pcrepp::set_match_limits(unsigned long match_limit,
+                              unsigned long recursion_limit)
+{
+    MATCH_LIMIT = match_limit;
+    MATCH_LIMIT_RECURSION = recursion_limit;
+}
+
 #ifdef PCRE_STUDY_JIT_COMPILE
-pcre_jit_stack *pcrepp::jit_stack(void)
+namespace {
+
+struct thread_jit_stack {
+    ~thread_jit_stack() {
+        if (tjs_stack != nullptr) {
+            pcre_jit_stack_free(tjs_stack);
+        }
+    };
+
+    pcre_jit_stack *tjs_stack{nullptr};
+    size_t tjs_size{0};
+};
+
+}
+
+pcre_jit_stack *pcrepp::jit_stack(void *)
 {
-    static pcre_jit_stack *retval = NULL;
+    static thread_local thread_jit_stack retval;
+    size_t size = JIT_STACK_SIZE;
 
-    if (retval == NULL) {
-        retval = pcre_jit_stack_alloc(JIT_STACK_MIN_SIZE, JIT_STACK_MAX_SIZE);
+    if (retval.tjs_stack != nullptr && retval.tjs_size != size) {
+        pcre_jit_stack_free(retval.tjs_stack);
+        retval.tjs_stack = nullptr;
+    }
+    if (retval.tjs_stack == nullptr) {
+        retval.tjs_stack = pcre_jit_stack_alloc(JIT_STACK_MIN_SIZE, size);
+        retval.tjs_size = size;
     }
 
-    return retval;
+    return retval.tjs_stack;
 }
 
 #else
@@ -256,3 +406,795 @@ void pcrepp::pcre_free_study(pcre_extra *extra)
     free(extra);
 }
 #endif
+
+namespace {
+
+/**
+ * What is known about the start of a piece of a regular expression.
+ */
+struct first_byte_info {
+    std::bitset<256> fbi_bytes;  /*< The bytes a match can start with. */
+    bool fbi_nullable{false};    /*< The piece can match the empty string. */
+    bool fbi_unknown{false};     /*< The piece is too complex to analyze. */
+};
+
+class first_byte_scanner {
+public:
+    explicit first_byte_scanner(const char *pattern)
+        : fbs_pattern(pattern) {
+    };
+
+    bool scan(std::bitset<256> &bits_out) {
+        first_byte_info info = this->alternation(true);
+
+        if (this->fbs_failed || this->peek() != '\0' ||
+            info.fbi_unknown || info.fbi_nullable) {
+            return false;
+        }
+
+        bits_out = info.fbi_bytes;
+        return true;
+    };
+
+private:
+    char peek(size_t ahead = 0) const {
+        for (size_t lpc = 0; lpc < ahead; lpc++) {
+            if (this->fbs_pattern[this->fbs_offset + lpc] == '\0') {
+                return '\0';
+            }
+        }
+        return this->fbs_pattern[this->fbs_offset + ahead];
+    };
+
+    unsigned char next() {
+        unsigned char retval = this->fbs_pattern[this->fbs_offset];
+
+        if (retval != '\0') {
+            this->fbs_offset += 1;
+        }
+        return retval;
+    };
+
+    static std::bitset<256> byte_range(unsigned char low, unsigned char high) {
+        std::bitset<256> retval;
+
+        for (int ch = low; ch <= high; ch++) {
+            retval.set(ch);
+        }
+        return retval;
+    };
+
+    static std::bitset<256> digits() {
+        return byte_range('0', '9');
+    };
+
+    static std::bitset<256> word_chars() {
+        return byte_range('a', 'z') | byte_range('A', 'Z') | digits() |
+               byte_range('_', '_');
+    };
+
+    static std::bitset<256> space_chars() {
+        return byte_range('\t', '\r') | byte_range(' ', ' ');
+    };
+
+    /**
+     * Handle the escape sequences that stand for a single byte or a class
+     * of bytes.  The backslash has already been consumed.
+     *
+     * @return False if the escape is not a simple class or literal.
+     */
+    bool escape_bytes(std::bitset<256> &bits_out) {
+        unsigned char ch = this->next();
+
+        switch (ch) {
+            case 'd':
+                bits_out = digits();
+                return true;
+            case 'D':
+                bits_out = ~digits();
+                return true;
+            case 'w':
+                bits_out = word_chars();
+                return true;
+            case 'W':
+                bits_out = ~word_chars();
+                return true;
+            case 's':
+                bits_out = space_chars();
+                return true;
+            case 'S':
+                bits_out = ~space_chars();
+                return true;
+            case 't':
+                bits_out.set('\t');
+                return true;
+            case 'n':
+                bits_out.set('\n');
+                return true;
+            case 'r':
+                bits_out.set('\r');
+                return true;
+            case 'f':
+                bits_out.set('\f');
+                return true;
+            case 'e':
+                bits_out.set('\x1b');
+                return true;
+            case 'a':
+                bits_out.set('\a');
+                return true;
+            case 'x': {
+                if (!isxdigit(this->peek()) || !isxdigit(this->peek(1))) {
+                    return false;
+                }
+                char hex[3] = { (char) this->next(), (char) this->next(), '\0' };
+                unsigned long value = strtoul(hex, nullptr, 16);
+
+                if (value > 0x7f) {
+                    return false;
+                }
+                bits_out.set(value);
+                return true;
+            }
+            default:
+                if (ch == '\0' || isalnum(ch)) {
+                    return false;
+                }
+                bits_out.set(ch);
+                return true;
+        }
+    };
+
+    first_byte_info char_class() {
+        first_byte_info retval;
+        bool negated = false;
+
+        if (this->peek() == '^') {
+            negated = true;
+            this->next();
+        }
+        if (this->peek() == ']') {
+            retval.fbi_bytes.set(this->next());
+        }
+        while (this->peek() != ']') {
+            std::bitset<256> bits;
+            unsigned char ch = this->next();
+
+            if (ch == '\0' || (ch == '[' && this->peek() == ':')) {
+                // POSIX classes are not handled, give up on the whole
+                // pattern instead of trying to find the end of the class.
+                retval.fbi_unknown = true;
+                this->fbs_failed = true;
+                return retval;
+            }
+            if (ch == '\\') {
+                if (!this->escape_bytes(bits) ||
+                    (this->peek() == '-' && this->peek(1) != ']')) {
+                    retval.fbi_unknown = true;
+                }
+            }
+            else if (this->peek() == '-' && this->peek(1) != ']') {
+                this->next();
+
+                unsigned char high = this->next();
+
+                if (high == '\0' || high == '\\') {
+                    retval.fbi_unknown = true;
+                    this->fbs_failed = true;
+                    return retval;
+                }
+                if (ch >= 0x80 || high >= 0x80 || high < ch) {
+                    retval.fbi_unknown = true;
+                }
+                else {
+                    bits = byte_range(ch, high);
+                }
+            }
+            else if (ch >= 0x80) {
+                // The lead byte of a multi-byte character, the continuation
+                // bytes are not the start of anything.
+                bits.set(ch);
+                while ((this->peek() & 0xc0) == 0x80) {
+                    this->next();
+                }
+            }
+            else {
+                bits.set(ch);
+            }
+            retval.fbi_bytes |= bits;
+        }
+        this->next();
+
+        if (negated) {
+            retval.fbi_bytes = ~retval.fbi_bytes;
+        }
+
+        return retval;
+    };
+
+    first_byte_info group() {
+        first_byte_info retval;
+
+        if (this->peek() == '?') {
+            this->next();
+            switch (this->peek()) {
+                case ':':
+                case '>':
+                    this->next();
+                    break;
+                case '<':
+                    if (this->peek(1) == '=' || this->peek(1) == '!') {
+                        // Lookbehinds do not consume anything.
+                        this->next();
+                        this->next();
+                        this->alternation(false);
+                        this->close_group();
+                        retval.fbi_nullable = true;
+                        return retval;
+                    }
+                    this->skip_name('>');
+                    break;
+                case 'P':
+                    this->next();
+                    if (this->peek() != '<') {
+                        // A named backreference or recursion.
+                        retval.fbi_unknown = true;
+                        retval.fbi_nullable = true;
+                        this->skip_group();
+                        return retval;
+                    }
+                    this->skip_name('>');
+                    break;
+                case '\'':
+                    this->skip_name('\'');
+                    break;
+                case '=':
+                case '!':
+                    // Lookaheads do not consume anything.
+                    this->next();
+                    this->alternation(false);
+                    this->close_group();
+                    retval.fbi_nullable = true;
+                    return retval;
+                case '#':
+                    while (this->peek() != ')' && this->peek() != '\0') {
+                        this->next();
+                    }
+                    this->close_group();
+                    retval.fbi_nullable = true;
+                    return retval;
+                default:
+                    if (this->harmless_options()) {
+                        if (this->peek() == ')') {
+                            this->next();
+                            retval.fbi_nullable = true;
+                            return retval;
+                        }
+                        this->next();
+                        break;
+                    }
+                    // Option settings, conditionals, recursion, ...  The
+                    // extended option changes how the rest of the pattern
+                    // is parsed, so give up completely in that case.
+                    for (size_t lpc = 0;
+                         this->peek(lpc) != '\0' && this->peek(lpc) != ':' &&
+                         this->peek(lpc) != ')';
+                         lpc++) {
+                        if (this->peek(lpc) == 'x') {
+                            this->fbs_failed = true;
+                        }
+                    }
+                    retval.fbi_unknown = true;
+                    retval.fbi_nullable = true;
+                    this->skip_group();
+                    return retval;
+            }
+        }
+
+        retval = this->alternation(false);
+        this->close_group();
+
+        return retval;
+    };
+
+    /**
+     * Check for an option setting that does not change what the start of a
+     * match can look like, like "(?s)".  The "(?" has been consumed.  On
+     * success, the options are consumed up to the closing paren or colon.
+     */
+    bool harmless_options() {
+        size_t lpc = 0;
+
+        while (this->peek(lpc) != '\0' && strchr("smJU-", this->peek(lpc))) {
+            lpc += 1;
+        }
+        if (lpc == 0 || (this->peek(lpc) != ')' && this->peek(lpc) != ':')) {
+            return false;
+        }
+        this->fbs_offset += lpc;
+
+        return true;
+    };
+
+    void skip_name(char terminator) {
+        this->next();
+        while (this->peek() != terminator && this->peek() != '\0') {
+            this->next();
+        }
+        this->next();
+    };
+
+    void close_group() {
+        if (this->next() != ')') {
+            this->fbs_failed = true;
+        }
+    };
+
+    void skip_group() {
+        int depth = 1;
+
+        while (depth > 0) {
+            unsigned char ch = this->next();
+
+            switch (ch) {
+                case '\0':
+                    this->fbs_failed = true;
+                    return;
+                case '\\':
+                    this->next();
+                    break;
+                case '(':
+                    depth += 1;
+                    break;
+                case ')':
+                    depth -= 1;
+                    break;
+            }
+        }
+    };
+
+    first_byte_info atom() {
+        first_byte_info retval;
+        unsigned char ch = this->next();
+
+        switch (ch) {
+            case '(':
+                return this->group();
+            case '[':
+                return this->char_class();
+            case '.':
+                retval.fbi_bytes.set();
+                return retval;
+            case '^':
+            case '$':
+                retval.fbi_nullable = true;
+                return retval;
+            case '\\':
+                switch (this->peek()) {
+                    case 'A':
+                    case 'b':
+                    case 'B':
+                    case 'G':
+                    case 'z':
+                    case 'Z':
+                        this->next();
+                        retval.fbi_nullable = true;
+                        return retval;
+                    case 'Q': {
+                        this->next();
+
+                        const char *end = strstr(
+                            &this->fbs_pattern[this->fbs_offset], "\\E");
+                        size_t len = end == nullptr ?
+                            strlen(&this->fbs_pattern[this->fbs_offset]) :
+                            end - &this->fbs_pattern[this->fbs_offset];
+
+                        if (len == 0) {
+                            retval.fbi_nullable = true;
+                        }
+                        else {
+                            retval.fbi_bytes.set(
+                                (unsigned char) this->fbs_pattern[this->fbs_offset]);
+                        }
+                        this->fbs_offset += len + (end == nullptr ? 0 : 2);
+                        return retval;
+                    }
+                }
+                if (!this->escape_bytes(retval.fbi_bytes)) {
+                    retval.fbi_unknown = true;
+                }
+                return retval;
+            default:
+                retval.fbi_bytes.set(ch);
+                if (ch >= 0x80) {
+                    while ((this->peek() & 0xc0) == 0x80) {
+                        this->next();
+                    }
+                }
+                return retval;
+        }
+    };
+
+    /**
+     * Consume any quantifier after an atom.
+     *
+     * @return True if the quantifier allows zero repetitions.
+     */
+    bool quantifier() {
+        bool retval = false;
+
+        switch (this->peek()) {
+            case '?':
+            case '*':
+                this->next();
+                retval = true;
+                break;
+            case '+':
+                this->next();
+                break;
+            case '{': {
+                size_t lpc = 1;
+
+                while (isdigit(this->peek(lpc))) {
+                    lpc += 1;
+                }
+                if (lpc == 1) {
+                    // Not a quantifier, the brace is a literal.
+                    return false;
+                }
+                if (this->peek(lpc) == ',') {
+                    lpc += 1;
+                    while (isdigit(this->peek(lpc))) {
+                        lpc += 1;
+                    }
+                }
+                if (this->peek(lpc) != '}') {
+                    return false;
+                }
+                retval = atoi(&this->fbs_pattern[this->fbs_offset + 1]) == 0;
+                this->fbs_offset += lpc + 1;
+                break;
+            }
+            default:
+                return false;
+        }
+
+        // Lazy and possessive modifiers.
+        if (this->peek() == '?' || this->peek() == '+') {
+            this->next();
+        }
+
+        return retval;
+    };
+
+    first_byte_info sequence(bool anchored) {
+        first_byte_info retval;
+        bool first = true;
+
+        retval.fbi_nullable = true;
+        while (this->peek() != '\0' && this->peek() != '|' &&
+               this->peek() != ')') {
+            if (first && anchored) {
+                if (this->peek() == '(' && this->peek(1) == '?') {
+                    size_t saved_offset = this->fbs_offset;
+
+                    this->fbs_offset += 2;
+                    if (this->harmless_options() && this->peek() == ')') {
+                        this->next();
+                        continue;
+                    }
+                    this->fbs_offset = saved_offset;
+                }
+                if (this->peek() == '^') {
+                    this->next();
+                }
+                else if (this->peek() == '\\' && this->peek(1) == 'A') {
+                    this->next();
+                    this->next();
+                }
+                else {
+                    retval.fbi_unknown = true;
+                }
+                first = false;
+                continue;
+            }
+            first = false;
+
+            first_byte_info curr = this->atom();
+
+            if (this->quantifier()) {
+                curr.fbi_nullable = true;
+            }
+            if (retval.fbi_nullable) {
+                retval.fbi_bytes |= curr.fbi_bytes;
+                retval.fbi_unknown = retval.fbi_unknown || curr.fbi_unknown;
+                retval.fbi_nullable = curr.fbi_nullable;
+            }
+        }
+        if (first && anchored) {
+            retval.fbi_unknown = true;
+        }
+
+        return retval;
+    };
+
+    first_byte_info alternation(bool anchored) {
+        first_byte_info retval = this->sequence(anchored);
+
+        while (this->peek() == '|') {
+            this->next();
+
+            first_byte_info branch = this->sequence(anchored);
+
+            retval.fbi_bytes |= branch.fbi_bytes;
+            retval.fbi_nullable = retval.fbi_nullable || branch.fbi_nullable;
+            retval.fbi_unknown = retval.fbi_unknown || branch.fbi_unknown;
+        }
+
+        return retval;
+    };
+
+    const char *fbs_pattern;
+    size_t fbs_offset{0};
+    bool fbs_failed{false};
+};
+
+/**
+ * Find the longest run of literal characters that every match of a pattern
+ * has to contain.  Like the first_byte_scanner, anything that is not
+ * understood causes the scan to fail.
+ */
+class literal_scanner {
+public:
+    explicit literal_scanner(const char *pattern)
+        : ls_pattern(pattern) {
+    };
+
+    std::string scan() {
+        bool last_was_literal = false;
+
+        while (!this->ls_failed) {
+            unsigned char ch = this->next();
+
+            switch (ch) {
+                case '\0':
+                    this->end_run();
+                    return this->ls_best;
+                case '|':
+                case ')':
+                    // Alternation means no single literal is required.
+                    return "";
+                case '(':
+                    if (this->peek() == '?' && this->peek(1) != ':') {
+                        // Option settings, like (?x), change how the rest of
+                        // the pattern is read.
+                        return "";
+                    }
+                    this->end_run();
+                    this->skip_group();
+                    last_was_literal = false;
+                    break;
+                case '[':
+                    this->end_run();
+                    this->skip_class();
+                    last_was_literal = false;
+                    break;
+                case '.':
+                case '^':
+                case '$':
+                    this->end_run();
+                    last_was_literal = false;
+                    break;
+                case '?':
+                case '*':
+                    this->optional_atom(last_was_literal);
+                    last_was_literal = false;
+                    break;
+                case '+':
+                    this->end_run();
+                    this->skip_lazy();
+                    last_was_literal = false;
+                    break;
+                case '{':
+                    if (!isdigit(this->peek())) {
+                        last_was_literal = this->literal(ch);
+                        break;
+                    }
+                    if (this->peek() == '0') {
+                        this->optional_atom(last_was_literal);
+                    }
+                    else {
+                        this->end_run();
+                    }
+                    while (this->peek() != '}' && this->peek() != '\0') {
+                        this->next();
+                    }
+                    this->next();
+                    this->skip_lazy();
+                    last_was_literal = false;
+                    break;
+                case '\\':
+                    ch = this->next();
+                    if (ch == '\0' || isdigit(ch) || strchr("QxcoNpPgk", ch)) {
+                        // Quoting, back-references and escapes with
+                        // arguments are not handled.
+                        return "";
+                    }
+                    if (isalpha(ch)) {
+                        this->end_run();
+                        last_was_literal = false;
+                    }
+                    else {
+                        last_was_literal = this->literal(ch);
+                    }
+                    break;
+                default:
+                    last_was_literal = this->literal(ch);
+                    break;
+            }
+        }
+
+        return "";
+    };
+
+private:
+    char peek(size_t ahead = 0) const {
+        for (size_t lpc = 0; lpc < ahead; lpc++) {
+            if (this->ls_pattern[this->ls_offset + lpc] == '\0') {
+                return '\0';
+            }
+        }
+        return this->ls_pattern[this->ls_offset + ahead];
+    };
+
+    unsigned char next() {
+        unsigned char retval = this->ls_pattern[this->ls_offset];
+
+        if (retval != '\0') {
+            this->ls_offset += 1;
+        }
+        return retval;
+    };
+
+    bool literal(unsigned char ch) {
+        if (ch >= 0x80) {
+            // Multi-byte characters can have other case forms.
+            this->end_run();
+            return false;
+        }
+        this->ls_run.push_back(tolower(ch));
+        return true;
+    };
+
+    void end_run() {
+        if (this->ls_run.length() > this->ls_best.length()) {
+            this->ls_best = this->ls_run;
+        }
+        this->ls_run.clear();
+    };
+
+    void optional_atom(bool last_was_literal) {
+        if (last_was_literal) {
+            this->ls_run.pop_back();
+        }
+        this->end_run();
+        this->skip_lazy();
+    };
+
+    void skip_lazy() {
+        if (this->peek() == '?' || this->peek() == '+') {
+            this->next();
+        }
+    };
+
+    void skip_class() {
+        if (this->peek() == '^') {
+            this->next();
+        }
+        if (this->peek() == ']') {
+            this->next();
+        }
+        while (this->peek() != ']') {
+            unsigned char ch = this->next();
+
+            if (ch == '\0') {
+                this->ls_failed = true;
+                return;
+            }
+            if (ch == '\\') {
+                this->next();
+            }
+        }
+        this->next();
+    };
+
+    void skip_group() {
+        int depth = 1;
+
+        while (depth > 0 && !this->ls_failed) {
+            unsigned char ch = this->next();
+
+            switch (ch) {
+                case '\0':
+                    this->ls_failed = true;
+                    return;
+                case '\\':
+                    this->next();
+                    break;
+                case '[':
+                    this->skip_class();
+                    break;
+                case '(':
+                    depth += 1;
+                    break;
+                case ')':
+                    depth -= 1;
+                    break;
+            }
+        }
+
+        // Skip a quantifier on the group, the group was not part of a run.
+        switch (this->peek()) {
+            case '?':
+            case '*':
+            case '+':
+                this->next();
+                this->skip_lazy();
+                break;
+            case '{':
+                if (isdigit(this->peek(1))) {
+                    while (this->peek() != '}' && this->peek() != '\0') {
+                        this->next();
+                    }
+                    this->next();
+                    this->skip_lazy();
+                }
+                break;
+        }
+    };
+
+    const char *ls_pattern;
+    size_t ls_offset{0};
+    bool ls_failed{false};
+    std::string ls_run;
+    std::string ls_best;
+};
+
+}
+
+bool pcrepp::anchored_first_bytes(const char *pattern,
+                                  std::bitset<256> &bits_out)
+{
+    first_byte_scanner scanner(pattern);
+
+    return scanner.scan(bits_out);
+}
+
+std::string pcrepp::required_literal(const char *pattern)
+{
+    literal_scanner scanner(pattern);
+
+    return scanner.scan();
+}
+
+bool pcrepp::literal_pattern(const char *pattern, std::string &literal_out)
+{
+    literal_out.clear();
+    for (size_t lpc = 0; pattern[lpc] != '\0'; lpc++) {
+        char ch = pattern[lpc];
+
+        if (ch == '\\') {
+            lpc += 1;
+            ch = pattern[lpc];
+            if (ch == '\0' || isalnum((unsigned char) ch)) {
+                return false;
+            }
+        }
+        else if (strchr("^$.[]|()?*+{}", ch) != nullptr) {
+            return false;
+        }
+        literal_out.push_back(ch);
+    }
+
+    return !literal_out.empty();
+}
@@ -49,6 +49,8 @@
 
 #include <string.h>
 
+#include <atomic>
+#include <bitset>
 #include <string>
 #include <memory>
 #include <utility>
@@ -368,7 +370,7 @@ public:
     pcrepp(pcre *code) : p_code(code), p_code_extra(pcre_free_study)
     {
         pcre_refcount(this->p_code, 1);
-        this->study();
+        this->load_info();
     };
 
     pcrepp(const char *pattern, int options = 0)
@@ -386,7 +388,7 @@ public:
         }
 
         pcre_refcount(this->p_code, 1);
-        this->study();
+        this->load_info();
         this->find_captures(pattern);
     };
 
@@ -405,15 +407,15 @@ public:
         }
 
         pcre_refcount(this->p_code, 1);
-        this->study();
+        this->load_info();
         this->find_captures(pattern.c_str());
     };
 
-    pcrepp(const pcrepp &other)
+    pcrepp(const pcrepp &other) : p_code_extra(pcre_free_study)
     {
         this->p_code = other.p_code;
         pcre_refcount(this->p_code, 1);
-        this->study();
+        this->load_info();
     };
 
     virtual ~pcrepp()
@@ -477,15 +479,126 @@ public:
         return this->p_capture_count;
     };
 
+    /** @return The options the pattern was compiled with. */
+    unsigned long get_options() const {
+        unsigned long retval = 0;
+
+        pcre_fullinfo(this->p_code,
+                      nullptr,
+                      PCRE_INFO_OPTIONS,
+                      &retval);
+        return retval;
+    };
+
+    /**
+     * Find the bytes that a match of the given pattern can start with.  The
+     * analysis is only done for patterns that are anchored to the start of
+     * the subject and it is conservative, anything that is not understood
+     * causes it to fail.
+     *
+     * @param pattern The regular expression to analyze.
+     * @param bits_out On success, the set of possible first bytes.
+     * @return True if the set of first bytes could be determined.
+     */
+    static bool anchored_first_bytes(const char *pattern,
+                                     std::bitset<256> &bits_out);
+
+    /**
+     * Find the longest run of literal characters that must appear in any
+     * match of the given pattern.  The run is lowercased so that it can be
+     * used to rule out subjects for case-insensitive patterns as well.
+     *
+     * @param pattern The regular expression to analyze.
+     * @return The literal or an empty string if none could be found.
+     */
+    static std::string required_literal(const char *pattern);
+
+    /**
+     * Check if a pattern can only match one fixed string.
+     *
+     * @param pattern The regular expression to analyze.
+     * @param literal_out On success, the string matched by the pattern.
+     * @return True if the pattern has no special characters, other than
+     *   escaped punctuation.
+     */
+    static bool literal_pattern(const char *pattern, std::string &literal_out);
+
+    struct cache_stats {
+        size_t cs_size;
+        size_t cs_hits;
+        size_t cs_misses;
+        size_t cs_evictions;
+    };
+
+    /**
+     * Get a compiled pattern from the cache that is shared by the SQL
+     * functions and tables.  The cache holds a fixed number of patterns and
+     * drops the least-recently used one when it is full.
+     *
+     * @param pattern The regular expression to compile.
+     * @param options The options to pass to pcre_compile().
+     * @return The compiled pattern, which stays valid after it is evicted
+     *   for as long as the caller holds on to it.
+     * @throws error If the pattern could not be compiled.
+     */
+    static std::shared_ptr<pcrepp> cached(const std::string &pattern,
+                                          int options = 0);
+
+    static cache_stats get_cache_stats();
+
+    /**
+     * Set the largest size that the JIT stack for each thread can grow to.
+     * Stacks that were already allocated are replaced the next time their
+     * thread runs a match.
+     */
+    static void set_jit_stack_size(size_t max_size);
+
+    /**
+     * Set the limits that stop runaway matches, see pcre_exec(3) for the
+     * meaning of the limits.
+     */
+    static void set_match_limits(unsigned long match_limit,
+                                 unsigned long recursion_limit);
+
     bool match(pcre_context &pc, pcre_input &pi, int options = 0) const;
 
+    /**
+     * The number of times a match can be stopped by the match limits before
+     * the pattern is considered to be over its budget.  A pattern that
+     * backtracks that much on the lines it is given should be turned off
+     * instead of being run on every line.
+     */
+    static const uint32_t LIMIT_HITS_BUDGET = 100;
+
+    /**
+     * Count a match that was stopped by one of the match limits.
+     *
+     * @param rc The return code from pcre_exec().
+     * @param hits The counter to update.
+     * @return True if the return code was for one of the limits.
+     */
+    static bool record_limit_hit(int rc, std::atomic<uint32_t> &hits);
+
+    /** @return The number of matches stopped by the match limits. */
+    uint32_t get_limit_hits() const {
+        return this->p_limit_hits.load(std::memory_order_relaxed);
+    };
+
+    /** @return True if too many matches were stopped by the match limits. */
+    bool is_over_budget() const {
+        return this->get_limit_hits() >= LIMIT_HITS_BUDGET;
+    };
+
     size_t match_partial(pcre_input &pi) const {
         size_t length = pi.pi_length;
         int rc;
 
+        pcre_extra extra;
+        const pcre_extra *extra_ptr = this->exec_extra(extra);
+
         do {
             rc = pcre_exec(this->p_code,
-                           this->p_code_extra.in(),
+                           extra_ptr,
                            pi.get_string(),
                            length,
                            pi.pi_offset,
@@ -504,19 +617,42 @@ public:
     };
 
 // #undef PCRE_STUDY_JIT_COMPILE
+    /**
+     * The number of matches to run with the interpreter before the pattern
+     * is studied and JIT-compiled.  Most of the patterns that are loaded,
+     * like those of log formats that are only checked against the first
+     * lines of a file, never get that far.
+     */
+    static const uint32_t STUDY_AFTER_MATCHES = 32;
+
+    /**
+     * Fill in a copy of the study data with the current match limits,
+     * studying the pattern if it has been used enough.
+     *
+     * @return The copy, which only holds the match limits if the pattern
+     *   has not been studied.
+     */
+    const pcre_extra *exec_extra(pcre_extra &buf) const;
+
 #ifdef PCRE_STUDY_JIT_COMPILE
-    static pcre_jit_stack *jit_stack(void);
+    static pcre_jit_stack *jit_stack(void *);
 
 #else
     static void pcre_free_study(pcre_extra *);
 #endif
 
-    void study(void);
+    void study(void) const;
+
+    void load_info();
 
     void find_captures(const char *pattern);
 
     pcre *p_code;
-    auto_mem<pcre_extra> p_code_extra;
+    /** Only valid to read once p_studied is true. */
+    mutable auto_mem<pcre_extra> p_code_extra;
+    mutable std::atomic<bool> p_studied{false};
+    mutable std::atomic<uint32_t> p_match_count{0};
+    mutable std::atomic<uint32_t> p_limit_hits{0};
     int p_capture_count;
     int p_named_count;
     int p_name_len;
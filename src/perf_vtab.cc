@@ -0,0 +1,310 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include "lnav.hh"
+#include "base/enum_util.hh"
+#include "base/lnav_log.hh"
+#include "base/perf_counter.hh"
+#include "sql_util.hh"
+#include "perf_vtab.hh"
+#include "memory_governor.hh"
+#include "vtab_module.hh"
+
+using namespace std;
+
+struct lnav_perf : public tvt_iterator_cursor<lnav_perf> {
+    static const int COLUMN_COUNT = 10;
+
+    static constexpr const char *CREATE_STMT = R"(
+-- Access lnav's performance counters through this table.
+CREATE TABLE lnav_perf (
+    stage text,         -- The stage of processing: read, scan, filter, merge, search or render.
+    filepath text,      -- The file the counters are for or NULL for the totals.
+    calls integer,      -- The number of times the stage was run.
+    lines integer,      -- The number of lines processed by the stage.
+    bytes integer,      -- The number of bytes processed by the stage.
+    total_ns integer,   -- The total time spent in the stage.
+    max_ns integer,     -- The longest time taken by a single call.
+    p50_ns integer,     -- The median time taken by a call.
+    p90_ns integer,     -- The 90th percentile of the time taken by a call.
+    p99_ns integer      -- The 99th percentile of the time taken by a call.
+);
+)";
+
+    struct vtab {
+        sqlite3_vtab base;
+
+        explicit operator sqlite3_vtab *() {
+            return &this->base;
+        };
+    };
+
+    /**
+     * Walks the totals for each stage and then the stages that are tracked
+     * for each file.
+     */
+    struct iterator {
+        using difference_type = int;
+        using value_type = perf_counter;
+        using pointer = const perf_counter *;
+        using reference = const perf_counter &;
+        using iterator_category = forward_iterator_tag;
+
+        /** The index of the file or -1 for the totals. */
+        int i_file_index;
+        int i_stage;
+
+        iterator(int file = -1, int stage = -1)
+            : i_file_index(file), i_stage(stage) {
+        };
+
+        const perf_counter *get_counter() const {
+            auto stage = perf_stage_t(this->i_stage);
+
+            if (this->i_file_index == -1) {
+                return &perf_counter_for(stage);
+            }
+
+            auto lf = lnav_data.ld_files[this->i_file_index];
+
+            return lf->get_activity().get_perf_counter(stage);
+        };
+
+        iterator &operator++() {
+            while (this->i_file_index < (int) lnav_data.ld_files.size()) {
+                this->i_stage += 1;
+                if (this->i_stage >= to_underlying(perf_stage_t::MAX)) {
+                    this->i_stage = -1;
+                    this->i_file_index += 1;
+                    continue;
+                }
+                if (this->get_counter() != nullptr) {
+                    break;
+                }
+            }
+
+            return *this;
+        };
+
+        bool operator==(const iterator &other) const {
+            return this->i_file_index == other.i_file_index &&
+                   this->i_stage == other.i_stage;
+        };
+
+        bool operator!=(const iterator &other) const {
+            return !(*this == other);
+        };
+    };
+
+    iterator begin() {
+        iterator retval;
+
+        return ++retval;
+    }
+
+    iterator end() {
+        return iterator(lnav_data.ld_files.size(), -1);
+    }
+
+    sqlite_int64 get_rowid(iterator iter) {
+        sqlite_int64 retval = iter.i_file_index + 1;
+
+        retval = retval << 8;
+        retval = retval | iter.i_stage;
+
+        return retval;
+    }
+
+    /**
+     * Computing the percentiles means walking the histogram, so the rows are
+     * produced a batch at a time instead of a column at a time.
+     */
+    int fill_batch(cursor &vc, vtab_row_batch &batch) {
+        while (!batch.full() && !vc.eof()) {
+            const perf_counter *pc = vc.iter.get_counter();
+            batch.add_row(this->get_rowid(vc.iter));
+
+            batch.set(0, perf_stage_name(perf_stage_t(vc.iter.i_stage)));
+            if (vc.iter.i_file_index != -1) {
+                auto &lf = lnav_data.ld_files[vc.iter.i_file_index];
+
+                batch.set(1, lf->get_filename());
+            }
+            batch.set(2, (int64_t) pc->get_calls());
+            batch.set(3, (int64_t) pc->get_lines());
+            batch.set(4, (int64_t) pc->get_bytes());
+            batch.set(5, (int64_t) pc->get_total_ns());
+            batch.set(6, (int64_t) pc->get_max_ns());
+            batch.set(7, (int64_t) pc->get_percentile_ns(0.50));
+            batch.set(8, (int64_t) pc->get_percentile_ns(0.90));
+            batch.set(9, (int64_t) pc->get_percentile_ns(0.99));
+
+            vc.next();
+        }
+
+        return SQLITE_OK;
+    }
+};
+
+struct lnav_memory : public tvt_iterator_cursor<lnav_memory> {
+    static constexpr const char *CREATE_STMT = R"(
+-- Access the memory usage of lnav's caches through this table.
+CREATE TABLE lnav_memory (
+    cache text,         -- The name of the cache or NULL for the whole process.
+    cost integer,       -- The relative cost of refilling the cache.
+    bytes integer,      -- The memory used by the cache or the resident size.
+    limit_bytes integer, -- The memory limit for the process.
+    sheds integer,      -- The number of times the cache was shed.
+    shed_bytes integer  -- The total number of bytes that were freed.
+);
+)";
+
+    struct vtab {
+        sqlite3_vtab base;
+
+        explicit operator sqlite3_vtab *() {
+            return &this->base;
+        };
+    };
+
+    /**
+     * Walks the row for the whole process and then the registered caches.
+     */
+    struct iterator {
+        using difference_type = int;
+        using value_type = memory_governor::cache;
+        using pointer = const memory_governor::cache *;
+        using reference = const memory_governor::cache &;
+        using iterator_category = forward_iterator_tag;
+
+        /** The index of the cache or -1 for the whole process. */
+        int i_index;
+
+        iterator(int index = -1) : i_index(index) {
+        };
+
+        iterator &operator++() {
+            this->i_index += 1;
+
+            return *this;
+        };
+
+        bool operator==(const iterator &other) const {
+            return this->i_index == other.i_index;
+        };
+
+        bool operator!=(const iterator &other) const {
+            return !(*this == other);
+        };
+    };
+
+    iterator begin() {
+        return iterator();
+    }
+
+    iterator end() {
+        return iterator(memory_governor::singleton().get_caches().size());
+    }
+
+    sqlite_int64 get_rowid(iterator iter) {
+        return iter.i_index + 1;
+    }
+
+    int get_column(const cursor &vc, sqlite3_context *ctx, int col) {
+        auto &mg = memory_governor::singleton();
+
+        if (vc.iter.i_index == -1) {
+            switch (col) {
+                case 0:
+                case 1:
+                    sqlite3_result_null(ctx);
+                    break;
+                case 2:
+                    to_sqlite(ctx, (int64_t) memory_governor::read_rss());
+                    break;
+                case 3:
+                    to_sqlite(ctx, (int64_t) mg.get_limit());
+                    break;
+                case 4:
+                    to_sqlite(ctx, (int64_t) mg.get_sheds());
+                    break;
+                case 5:
+                    to_sqlite(ctx, (int64_t) mg.get_shed_bytes());
+                    break;
+            }
+
+            return SQLITE_OK;
+        }
+
+        const auto &c = mg.get_caches()[vc.iter.i_index];
+
+        switch (col) {
+            case 0:
+                to_sqlite(ctx, c.c_name);
+                break;
+            case 1:
+                to_sqlite(ctx, (int64_t) c.c_cost);
+                break;
+            case 2:
+                to_sqlite(ctx, (int64_t) c.c_usage());
+                break;
+            case 3:
+                sqlite3_result_null(ctx);
+                break;
+            case 4:
+                to_sqlite(ctx, (int64_t) c.c_sheds);
+                break;
+            case 5:
+                to_sqlite(ctx, (int64_t) c.c_shed_bytes);
+                break;
+        }
+
+        return SQLITE_OK;
+    }
+};
+
+int register_perf_vtab(sqlite3 *db)
+{
+    static vtab_module<tvt_no_update<lnav_perf>> LNAV_PERF_MODULE;
+    static vtab_module<tvt_no_update<lnav_memory>> LNAV_MEMORY_MODULE;
+
+    int rc;
+
+    rc = LNAV_PERF_MODULE.create(db, "lnav_perf");
+
+    ensure(rc == SQLITE_OK);
+
+    rc = LNAV_MEMORY_MODULE.create(db, "lnav_memory");
+
+    ensure(rc == SQLITE_OK);
+
+    return rc;
+}
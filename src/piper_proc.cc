@@ -196,8 +196,20 @@ piper_proc::piper_proc(int pipefd, bool timestamp, int filefd)
     }
 }
 
+piper_proc::piper_proc(std::shared_ptr<pipe_source> ps)
+    : pp_child(-1), pp_pipe_source(std::move(ps))
+{
+    require(this->pp_pipe_source != nullptr);
+
+    log_perror(fcntl(this->pp_pipe_source->ps_fd, F_SETFL, O_NONBLOCK));
+}
+
 bool piper_proc::has_exited()
 {
+    if (this->pp_pipe_source != nullptr) {
+        return this->pp_pipe_source->ps_eof;
+    }
+
     if (this->pp_child > 0) {
         int rc, status;
 
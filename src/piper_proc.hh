@@ -32,9 +32,11 @@
 #ifndef __piper_proc_hh
 #define __piper_proc_hh
 
+#include <memory>
 #include <string>
 #include <sys/types.h>
 #include "auto_fd.hh"
+#include "line_buffer.hh"
 
 /**
  * Creates a subprocess that reads data from a pipe and writes it to a file so
@@ -64,6 +66,20 @@ public:
      */
     piper_proc(int pipefd, bool timestamp, int filefd);
 
+    /**
+     * Track a pipe that is read in this process by the line_buffer of the
+     * logfile that was given the pipe source.  No subprocess is created, so
+     * the data is only written once and the newest lines are indexed while
+     * they are still in memory.
+     *
+     * @param ps The pipe source shared with the logfile.
+     */
+    explicit piper_proc(std::shared_ptr<pipe_source> ps);
+
+    /**
+     * @return True if the child process has exited or, for a pipe read in
+     *   this process, all of the data has been read.
+     */
     bool has_exited();
 
     /**
@@ -82,5 +98,8 @@ private:
 
     /** The child process' pid. */
     pid_t pp_child;
+
+    /** The pipe being read in this process, if there is no child. */
+    std::shared_ptr<pipe_source> pp_pipe_source;
 };
 #endif
@@ -29,16 +29,60 @@
 
 #include "config.h"
 
+#include <algorithm>
+
 #include "view_curses.hh"
 #include "pretty_printer.hh"
 
 void pretty_printer::append_to(attr_line_t &al)
+{
+    this->format_lines(SIZE_MAX);
+
+    if (!al.empty()) {
+        al.append("\n");
+    }
+    al.append(this->get_formatted());
+}
+
+attr_line_t pretty_printer::get_formatted() const
+{
+    attr_line_t retval;
+
+    retval.get_string() = this->pp_stream.str();
+    retval.get_attrs() = this->pp_attrs;
+    if (!this->pp_done) {
+        // The attributes past the formatted text have not been shifted
+        // into place yet.
+        int len = retval.length();
+        auto &sa = retval.get_attrs();
+
+        sa.erase(remove_if(sa.begin(), sa.end(), [len](const auto &attr) {
+            return attr.sa_range.lr_start >= len;
+        }), sa.end());
+        for (auto &attr : sa) {
+            if (attr.sa_range.lr_end > len) {
+                attr.sa_range.lr_end = len;
+            }
+        }
+    }
+
+    return retval;
+}
+
+bool pretty_printer::format_lines(size_t max_lines)
 {
     pcre_context_static<30> pc;
     data_token_t dt;
 
-    this->pp_scanner->reset();
-    while (this->pp_scanner->tokenize2(pc, dt)) {
+    if (this->pp_done) {
+        return true;
+    }
+    if (!this->pp_started) {
+        this->pp_scanner->reset();
+        this->pp_started = true;
+    }
+    while (this->pp_line_count < max_lines &&
+           this->pp_scanner->tokenize2(pc, dt)) {
         element el(dt, pc);
 
         switch (dt) {
@@ -103,19 +147,16 @@ void pretty_printer::append_to(attr_line_t &al)
         }
         this->pp_values.push_back(el);
     }
+    if (this->pp_line_count >= max_lines) {
+        return false;
+    }
     while (this->pp_depth > 0) {
         this->ascend();
     }
     this->flush_values();
+    this->pp_done = true;
 
-    attr_line_t combined;
-    combined.get_string() = this->pp_stream.str();
-    combined.get_attrs() = this->pp_attrs;
-
-    if (!al.empty()) {
-        al.append("\n");
-    }
-    al.append(combined);
+    return true;
 }
 
 void pretty_printer::write_element(const pretty_printer::element &el)
@@ -161,8 +202,11 @@ void pretty_printer::write_element(const pretty_printer::element &el)
             this->pp_stream
                 << std::endl
                 << result.get_string();
+            this->pp_line_count += 1 + std::count(
+                result.get_string().begin(), result.get_string().end(), '\n');
             if (!endswith(result.get_string().c_str(), "\n")) {
                 this->pp_stream << std::endl;
+                this->pp_line_count += 1;
             }
             this->pp_stream
                 << start[el.e_capture.length() - 1]
@@ -179,6 +223,7 @@ void pretty_printer::write_element(const pretty_printer::element &el)
     this->pp_line_length += el.e_capture.length();
     if (el.e_token == DT_LINE) {
         this->pp_line_length = 0;
+        this->pp_line_count += 1;
         this->pp_body_lines.top() += 1;
     }
 }
@@ -208,6 +253,7 @@ bool pretty_printer::flush_values(bool start_on_depth)
                  el.e_token == DT_LCURLY)) {
                 if (this->pp_line_length > 0) {
                     this->pp_stream << std::endl;
+                    this->pp_line_count += 1;
                 }
                 this->pp_line_length = 0;
             }
@@ -224,11 +270,13 @@ void pretty_printer::start_new_line()
 
     if (this->pp_line_length > 0) {
         this->pp_stream << std::endl;
+        this->pp_line_count += 1;
         this->pp_line_length = 0;
     }
     has_output = this->flush_values();
     if (has_output && this->pp_line_length > 0) {
         this->pp_stream << std::endl;
+        this->pp_line_count += 1;
     }
     this->pp_line_length = 0;
     this->pp_body_lines.top() += 1;
@@ -33,6 +33,7 @@
 #include <sys/time.h>
 #include <sys/types.h>
 #include <signal.h>
+#include <string.h>
 
 #include <stack>
 #include <deque>
@@ -66,17 +67,47 @@ public:
 
         pcre_context_static<30> pc;
         data_token_t dt;
-
-        this->pp_scanner->reset();
-        while (this->pp_scanner->tokenize2(pc, dt)) {
-            if (dt == DT_XML_CLOSE_TAG) {
-                pp_is_xml = true;
+        auto &pi = this->pp_scanner->get_input();
+
+        // There can only be a closing tag if there is a "</" somewhere, so
+        // the input is only tokenized in that case.
+        if (memmem(pi.get_string(), pi.pi_length, "</", 2) != nullptr) {
+            this->pp_scanner->reset();
+            while (this->pp_scanner->tokenize2(pc, dt)) {
+                if (dt == DT_XML_CLOSE_TAG) {
+                    pp_is_xml = true;
+                    break;
+                }
             }
         }
     };
 
+    /**
+     * Format the rest of the input and append it to the given line.
+     */
     void append_to(attr_line_t &al);
 
+    /**
+     * Format more of the input, so that a large message can be formatted
+     * a piece at a time as it is viewed.
+     *
+     * @param max_lines Stop once this many lines have been written in
+     *   total, the count is approximate.
+     * @return True if all of the input has been formatted.
+     */
+    bool format_lines(size_t max_lines);
+
+    /**
+     * @return The text that has been formatted so far.  The last line can
+     *   be incomplete if format_lines() stopped in the middle.
+     */
+    attr_line_t get_formatted() const;
+
+    /** @return True if all of the input has been formatted. */
+    bool is_done() const {
+        return this->pp_done;
+    };
+
 private:
 
     void descend();
@@ -102,6 +133,10 @@ private:
     std::deque<element> pp_values{};
     int pp_shift_accum{0};
     bool pp_is_xml{false};
+    bool pp_started{false};
+    bool pp_done{false};
+    /** The number of lines that have been written to pp_stream. */
+    size_t pp_line_count{0};
 };
 
 #endif
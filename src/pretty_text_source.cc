@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file pretty_text_source.cc
+ */
+
+#include "config.h"
+
+#include "pretty_text_source.hh"
+
+pretty_text_source::segment::segment(const std::string &text,
+                                     const string_attrs_t &sa,
+                                     const attr_line_t &prefix,
+                                     bool trim_last)
+    : s_text(text),
+      s_scanner(this->s_text),
+      s_printer(&this->s_scanner, sa),
+      s_prefix(prefix),
+      s_trim_last(trim_last)
+{
+}
+
+void pretty_text_source::segment::format(size_t min_lines)
+{
+    if (this->is_done() || min_lines <= this->s_line_budget) {
+        return;
+    }
+
+    // Grow the budget geometrically so that scrolling through a huge
+    // message does not copy the formatted text too many times.
+    this->s_line_budget = std::max(min_lines, this->s_line_budget * 2);
+    this->s_printer.format_lines(this->s_line_budget);
+
+    attr_line_t formatted = this->s_printer.get_formatted();
+
+    this->s_lines.clear();
+    formatted.split_lines(this->s_lines);
+    if (this->s_trim_last && this->is_done() &&
+        !this->s_lines.empty() && this->s_lines.back().empty()) {
+        this->s_lines.pop_back();
+    }
+    if (!this->s_prefix.empty()) {
+        for (auto &line : this->s_lines) {
+            line.insert(0, this->s_prefix);
+        }
+    }
+}
+
+void pretty_text_source::add_segment(std::shared_ptr<segment> seg,
+                                     size_t min_lines)
+{
+    seg->format(min_lines);
+    this->pts_segments.emplace_back(std::move(seg));
+    this->rebuild_lines();
+}
+
+void pretty_text_source::text_scrolled(textview_curses &tc)
+{
+    size_t bottom = (size_t) (tc.get_top() + tc.get_height() * 2);
+    size_t line_start = 0;
+
+    for (auto &seg : this->pts_segments) {
+        size_t line_end = line_start + seg->get_lines().size();
+
+        if (bottom < line_start) {
+            break;
+        }
+        if (!seg->is_done() && bottom >= line_end) {
+            seg->format(seg->get_lines().size() + bottom - line_end + 1);
+            this->rebuild_lines();
+            tc.reload_data();
+            return;
+        }
+        line_start = line_end;
+    }
+}
+
+void pretty_text_source::rebuild_lines()
+{
+    this->pts_lines.clear();
+    this->pts_longest_line = 0;
+    for (auto &seg : this->pts_segments) {
+        for (auto &line : seg->get_lines()) {
+            this->pts_lines.emplace_back(line);
+            this->pts_longest_line = std::max(this->pts_longest_line,
+                                              (size_t) line.length());
+        }
+    }
+}
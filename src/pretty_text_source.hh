@@ -0,0 +1,154 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file pretty_text_source.hh
+ */
+
+#ifndef lnav_pretty_text_source_hh
+#define lnav_pretty_text_source_hh
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "attr_line.hh"
+#include "data_scanner.hh"
+#include "pretty_printer.hh"
+#include "textview_curses.hh"
+
+/**
+ * The source for the PRETTY view.  Each message is pretty-printed a piece
+ * at a time, so a huge message only has as many lines formatted as have
+ * been scrolled into view.
+ */
+class pretty_text_source : public text_sub_source {
+public:
+    /**
+     * A message that is being pretty-printed.  Segments are kept between
+     * openings of the view so that a message does not need to be formatted
+     * again.
+     */
+    class segment {
+    public:
+        /**
+         * @param text The message to format.
+         * @param sa The attributes for the message.
+         * @param prefix The text to put before each formatted line.
+         * @param trim_last True if an empty last line should be dropped.
+         */
+        segment(const std::string &text,
+                const string_attrs_t &sa,
+                const attr_line_t &prefix,
+                bool trim_last);
+
+        segment(const segment &) = delete;
+
+        /** @return True if this segment was created for the given text. */
+        bool is_for(const std::string &text, const attr_line_t &prefix) const {
+            return this->s_text == text &&
+                   this->s_prefix.get_string() == prefix.get_string();
+        };
+
+        /**
+         * Format more of the message.
+         *
+         * @param min_lines The number of lines that should be available.
+         */
+        void format(size_t min_lines);
+
+        bool is_done() const {
+            return this->s_printer.is_done();
+        };
+
+        const std::vector<attr_line_t> &get_lines() const {
+            return this->s_lines;
+        };
+
+    private:
+        std::string s_text;
+        data_scanner s_scanner;
+        pretty_printer s_printer;
+        attr_line_t s_prefix;
+        bool s_trim_last;
+        size_t s_line_budget{0};
+        std::vector<attr_line_t> s_lines;
+    };
+
+    /**
+     * Add a segment to the end of the view.
+     *
+     * @param seg The segment to add.
+     * @param min_lines The number of lines to format if the segment has not
+     *   been formatted yet.
+     */
+    void add_segment(std::shared_ptr<segment> seg, size_t min_lines);
+
+    /** @return The segments in the view. */
+    const std::vector<std::shared_ptr<segment>> &get_segments() const {
+        return this->pts_segments;
+    };
+
+    size_t text_line_count() {
+        return this->pts_lines.size();
+    };
+
+    size_t text_line_width(textview_curses &curses) {
+        return this->pts_longest_line;
+    };
+
+    void text_value_for_line(textview_curses &tc,
+                             int row,
+                             std::string &value_out,
+                             line_flags_t flags) {
+        value_out = this->pts_lines[row].get_string();
+    };
+
+    void text_attrs_for_line(textview_curses &tc, int line,
+                             string_attrs_t &value_out) {
+        value_out = this->pts_lines[line].get_attrs();
+    };
+
+    size_t text_size_for_line(textview_curses &tc, int row, line_flags_t flags) {
+        return this->pts_lines[row].length();
+    };
+
+    /**
+     * Format more of the message at the bottom of the view, if it is not
+     * done yet.
+     */
+    void text_scrolled(textview_curses &tc);
+
+private:
+    void rebuild_lines();
+
+    std::vector<std::shared_ptr<segment>> pts_segments;
+    std::vector<attr_line_t> pts_lines;
+    size_t pts_longest_line{0};
+};
+
+#endif
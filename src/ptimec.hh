@@ -46,6 +46,7 @@
 #include <cstdlib>
 #include <iomanip>
 #include <ostream>
+#include <vector>
 
 struct tm *secs2tm(time_t *tim_p, struct tm *res);
 time_t tm2sec(const struct tm *t);
@@ -1011,6 +1012,67 @@ typedef void (*ftime_func)(char *dst, off_t &off_inout, size_t len, const struct
 bool ptime_fmt(const char *fmt, struct exttm *dst, const char *str, off_t &off, ssize_t len);
 size_t ftime_fmt(char *dst, size_t len, const char *fmt, const struct exttm &tm);
 
+/**
+ * A timestamp format string that has been translated into the list of
+ * ptime_ calls needed to parse it.  Running the program gives the same
+ * result as ptime_fmt(), without interpreting the format string for every
+ * timestamp.
+ */
+class ptime_program {
+public:
+    explicit ptime_program(const char *fmt = nullptr);
+
+    const char *get_format() const {
+        return this->pp_fmt;
+    };
+
+    bool parse(struct exttm *dst, const char *str, off_t &off, ssize_t len) const;
+
+private:
+    enum op_type_t {
+        OT_FUNC,
+        OT_CHAR,
+        OT_UPTO,
+        OT_UPTO_END,
+    };
+
+    struct op {
+        op_type_t o_type;
+        ptime_func o_func;
+        char o_ch;
+    };
+
+    const char *pp_fmt;
+    std::vector<op> pp_ops;
+};
+
+/**
+ * A timestamp format string that has been translated into the list of
+ * ftime_ calls needed to write it out.  Formatting with the program gives
+ * the same result as ftime_fmt(), without interpreting the format string
+ * for every timestamp.
+ */
+class ftime_program {
+public:
+    explicit ftime_program(const char *fmt = nullptr);
+
+    bool empty() const {
+        return this->fp_ops.empty();
+    };
+
+    size_t format(char *dst, size_t len, const struct exttm &tm) const;
+
+private:
+    struct op {
+        /** The function to call or nullptr to append o_ch. */
+        void (*o_func)(char *dst, off_t &off_inout, ssize_t len,
+                       const struct exttm &tm);
+        char o_ch;
+    };
+
+    std::vector<op> fp_ops;
+};
+
 struct ptime_fmt {
     const char *pf_fmt;
     ptime_func pf_func;
@@ -106,6 +106,90 @@ bool ptime_fmt(const char *fmt, struct exttm *dst, const char *str, off_t &off,
     return true;
 }
 
+#define PROGRAM_CASE(ch, c) \
+    case ch: \
+        this->pp_ops.push_back({OT_FUNC, ptime_ ## c, 0}); \
+        lpc += 1; \
+        break
+
+ptime_program::ptime_program(const char *fmt) : pp_fmt(fmt)
+{
+    if (fmt == nullptr) {
+        return;
+    }
+
+    for (ssize_t lpc = 0; fmt[lpc]; lpc++) {
+        if (fmt[lpc] == '%') {
+            switch (fmt[lpc + 1]) {
+                case 'a':
+                case 'Z':
+                    if (fmt[lpc + 2]) {
+                        this->pp_ops.push_back({OT_UPTO, nullptr, fmt[lpc + 2]});
+                    }
+                    else {
+                        this->pp_ops.push_back({OT_UPTO_END, nullptr, 0});
+                    }
+                    lpc += 1;
+                    break;
+                PROGRAM_CASE('b', b);
+                PROGRAM_CASE('S', S);
+                PROGRAM_CASE('s', s);
+                PROGRAM_CASE('L', L);
+                PROGRAM_CASE('M', M);
+                PROGRAM_CASE('H', H);
+                PROGRAM_CASE('i', i);
+                PROGRAM_CASE('6', 6);
+                PROGRAM_CASE('I', I);
+                PROGRAM_CASE('d', d);
+                PROGRAM_CASE('e', e);
+                PROGRAM_CASE('f', f);
+                PROGRAM_CASE('k', k);
+                PROGRAM_CASE('l', l);
+                PROGRAM_CASE('m', m);
+                PROGRAM_CASE('N', N);
+                PROGRAM_CASE('p', p);
+                PROGRAM_CASE('Y', Y);
+                PROGRAM_CASE('y', y);
+                PROGRAM_CASE('z', z);
+                PROGRAM_CASE('@', at);
+            }
+        }
+        else {
+            this->pp_ops.push_back({OT_CHAR, nullptr, fmt[lpc]});
+        }
+    }
+}
+
+bool ptime_program::parse(struct exttm *dst, const char *str, off_t &off, ssize_t len) const
+{
+    for (const auto &o : this->pp_ops) {
+        switch (o.o_type) {
+            case OT_FUNC:
+                if (!o.o_func(dst, str, off, len)) {
+                    return false;
+                }
+                break;
+            case OT_CHAR:
+                if (!ptime_char(o.o_ch, str, off, len)) {
+                    return false;
+                }
+                break;
+            case OT_UPTO:
+                if (!ptime_upto(o.o_ch, str, off, len)) {
+                    return false;
+                }
+                break;
+            case OT_UPTO_END:
+                if (!ptime_upto_end(str, off, len)) {
+                    return false;
+                }
+                break;
+        }
+    }
+
+    return true;
+}
+
 #define FTIME_FMT_CASE(ch, c) \
     case ch: \
         ftime_ ## c(dst, off_inout, len, tm); \
@@ -121,6 +205,7 @@ size_t ftime_fmt(char *dst, size_t len, const char *fmt, const struct exttm &tm)
             switch (fmt[lpc + 1]) {
                 case '%':
                     ftime_char(dst, off_inout, len, '%');
+                    lpc += 1;
                     break;
                 FTIME_FMT_CASE('a', a);
                 FTIME_FMT_CASE('b', b);
@@ -155,6 +240,71 @@ size_t ftime_fmt(char *dst, size_t len, const char *fmt, const struct exttm &tm)
     return (size_t) off_inout;
 }
 
+#define FTIME_PROGRAM_CASE(ch, c) \
+    case ch: \
+        this->fp_ops.push_back({ftime_ ## c, 0}); \
+        lpc += 1; \
+        break
+
+ftime_program::ftime_program(const char *fmt)
+{
+    if (fmt == nullptr) {
+        return;
+    }
+
+    for (ssize_t lpc = 0; fmt[lpc]; lpc++) {
+        if (fmt[lpc] == '%') {
+            switch (fmt[lpc + 1]) {
+                case '%':
+                    this->fp_ops.push_back({nullptr, '%'});
+                    lpc += 1;
+                    break;
+                FTIME_PROGRAM_CASE('a', a);
+                FTIME_PROGRAM_CASE('b', b);
+                FTIME_PROGRAM_CASE('S', S);
+                FTIME_PROGRAM_CASE('s', s);
+                FTIME_PROGRAM_CASE('L', L);
+                FTIME_PROGRAM_CASE('M', M);
+                FTIME_PROGRAM_CASE('H', H);
+                FTIME_PROGRAM_CASE('i', i);
+                FTIME_PROGRAM_CASE('6', 6);
+                FTIME_PROGRAM_CASE('I', I);
+                FTIME_PROGRAM_CASE('d', d);
+                FTIME_PROGRAM_CASE('e', e);
+                FTIME_PROGRAM_CASE('f', f);
+                FTIME_PROGRAM_CASE('k', k);
+                FTIME_PROGRAM_CASE('l', l);
+                FTIME_PROGRAM_CASE('m', m);
+                FTIME_PROGRAM_CASE('N', N);
+                FTIME_PROGRAM_CASE('p', p);
+                FTIME_PROGRAM_CASE('Y', Y);
+                FTIME_PROGRAM_CASE('y', y);
+                FTIME_PROGRAM_CASE('z', z);
+            }
+        }
+        else {
+            this->fp_ops.push_back({nullptr, fmt[lpc]});
+        }
+    }
+}
+
+size_t ftime_program::format(char *dst, size_t len, const struct exttm &tm) const
+{
+    off_t off_inout = 0;
+
+    for (const auto &o : this->fp_ops) {
+        if (o.o_func != nullptr) {
+            o.o_func(dst, off_inout, len, tm);
+        } else {
+            ftime_char(dst, off_inout, len, o.o_ch);
+        }
+    }
+
+    dst[off_inout] = '\0';
+
+    return (size_t) off_inout;
+}
+
 std::ostream &operator<<(std::ostream &os, const exttm &value)
 {
     os << value.et_tm.tm_year + 1900
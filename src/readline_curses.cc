@@ -53,6 +53,8 @@
 #include <libutil.h>
 #endif
 
+#include <algorithm>
+#include <iterator>
 #include <string>
 
 #include "lnav_config.hh"
@@ -64,7 +66,6 @@
 #include "ansi_scrubber.hh"
 #include "readline_curses.hh"
 #include "spookyhash/SpookyV2.h"
-#include "fts_fuzzy_match.hh"
 
 using namespace std;
 
@@ -230,35 +231,50 @@ char *readline_context::completion_generator(const char *text, int state)
 
         matches.clear();
         if (arg_possibilities != nullptr) {
-            for (const auto &poss : (*arg_possibilities)) {
-                auto cmpfunc = (loaded_context->is_case_sensitive() ?
-                                strncmp : strncasecmp);
-                auto poss_str = poss.c_str();
-
-                // Check for an exact match and for the quoted version.
-                if (cmpfunc(text, poss_str, len) == 0 ||
-                    ((strchr(loaded_context->rc_quote_chars, poss_str[0]) !=
-                        nullptr) &&
-                     cmpfunc(text, &poss_str[1], len) == 0)) {
-                    matches.push_back(poss);
+            if (loaded_context->is_case_sensitive()) {
+                // The possibilities are sorted, so the ones that start with
+                // the text, or a quote and then the text, can be found
+                // without looking at the others.
+                vector<string> prefixes = { text };
+
+                for (const char *quote = loaded_context->rc_quote_chars;
+                     *quote;
+                     quote++) {
+                    prefixes.emplace_back(string(1, *quote) + text);
+                }
+                for (const auto &prefix : prefixes) {
+                    for (auto iter = arg_possibilities->lower_bound(prefix);
+                         iter != arg_possibilities->end() &&
+                         iter->compare(0, prefix.size(), prefix) == 0;
+                         ++iter) {
+                        matches.push_back(*iter);
+                    }
+                }
+                sort(matches.begin(), matches.end());
+                matches.erase(unique(matches.begin(), matches.end()),
+                              matches.end());
+            } else {
+                for (const auto &poss : (*arg_possibilities)) {
+                    auto poss_str = poss.c_str();
+
+                    // Check for an exact match and for the quoted version.
+                    if (strncasecmp(text, poss_str, len) == 0 ||
+                        ((strchr(loaded_context->rc_quote_chars,
+                                 poss_str[0]) != nullptr) &&
+                         strncasecmp(text, &poss_str[1], len) == 0)) {
+                        matches.push_back(poss);
+                    }
                 }
             }
 
             if (matches.empty()) {
-                vector<pair<int, string>> fuzzy_matches;
+                auto &fi = loaded_context->fuzzy_index_for(arg_possibilities);
+                auto fuzzy_matches = fi.match(text);
 
-                for (const auto &poss : (*arg_possibilities)) {
-                    string poss_str = tolower(poss);
-                    int score;
-
-                    if (fts::fuzzy_match(text, poss_str.c_str(), score) && score > 0) {
-                        log_debug("match score %d %s %s", score, text, poss.c_str());
-                        if (score <= 0) {
-                            continue;
-                        }
-                        fuzzy_matches.emplace_back(score, poss);
-                    }
-                }
+                fuzzy_matches.erase(
+                    remove_if(fuzzy_matches.begin(), fuzzy_matches.end(),
+                              [](const auto &hit) { return hit.first <= 0; }),
+                    fuzzy_matches.end());
 
                 if (!fuzzy_matches.empty()) {
                     stable_sort(begin(fuzzy_matches), end(fuzzy_matches),
@@ -1061,6 +1077,7 @@ void readline_curses::add_possibility(int context,
                    strlen(buffer) + 1) == -1) {
         perror("add_possibility: write failed");
     }
+    this->rc_sent_possibilities[context][type].insert(value);
 }
 
 void readline_curses::rem_possibility(int context,
@@ -1077,6 +1094,7 @@ void readline_curses::rem_possibility(int context,
                    strlen(buffer) + 1) == -1) {
         perror("rem_possiblity: write failed");
     }
+    this->rc_sent_possibilities[context][type].erase(value);
 }
 
 void readline_curses::clear_possibilities(int context, string type)
@@ -1091,6 +1109,27 @@ void readline_curses::clear_possibilities(int context, string type)
                    strlen(buffer) + 1) == -1) {
         perror("clear_possiblity: write failed");
     }
+    this->rc_sent_possibilities[context].erase(type);
+}
+
+void readline_curses::replace_possibilities(int context,
+                                            const string &type,
+                                            const set<string> &values)
+{
+    auto &sent = this->rc_sent_possibilities[context][type];
+    vector<string> removed;
+
+    set_difference(sent.begin(), sent.end(),
+                   values.begin(), values.end(),
+                   back_inserter(removed));
+    for (const auto &str : removed) {
+        this->rem_possibility(context, type, str);
+    }
+    for (const auto &str : values) {
+        if (sent.count(str) == 0) {
+            this->add_possibility(context, type, str);
+        }
+    }
 }
 
 void readline_curses::do_update()
@@ -42,6 +42,7 @@
 #include <sys/ioctl.h>
 
 #include <map>
+#include <memory>
 #include <set>
 #include <stack>
 #include <string>
@@ -55,6 +56,7 @@
 #include "vt52_curses.hh"
 #include "log_format.hh"
 #include "help_text_formatter.hh"
+#include "fuzzy_index.hh"
 
 struct exec_context;
 
@@ -126,17 +128,43 @@ public:
 
     void add_possibility(std::string type, std::string value)
     {
-        this->rc_possibilities[type].insert(value);
+        auto &poss = this->rc_possibilities[type];
+
+        this->rc_fuzzy_indexes.erase(&poss);
+        poss.insert(value);
     };
 
     void rem_possibility(std::string type, std::string value)
     {
-        this->rc_possibilities[type].erase(value);
+        auto &poss = this->rc_possibilities[type];
+
+        this->rc_fuzzy_indexes.erase(&poss);
+        poss.erase(value);
     };
 
     void clear_possibilities(std::string type)
     {
-        this->rc_possibilities[type].clear();
+        auto &poss = this->rc_possibilities[type];
+
+        this->rc_fuzzy_indexes.erase(&poss);
+        poss.clear();
+    };
+
+    /**
+     * @param poss One of the sets in rc_possibilities.
+     * @return The fuzzy matching index for the set, which is built when
+     *   first needed and thrown out when the set changes.
+     */
+    fuzzy_index &fuzzy_index_for(const std::set<std::string> *poss)
+    {
+        auto iter = this->rc_fuzzy_indexes.find(poss);
+
+        if (iter == this->rc_fuzzy_indexes.end()) {
+            iter = this->rc_fuzzy_indexes.emplace(
+                poss, std::make_unique<fuzzy_index>(*poss)).first;
+        }
+
+        return *iter->second;
     };
 
     bool is_case_sensitive() const
@@ -202,6 +230,8 @@ private:
     std::string   rc_name;
     HISTORY_STATE rc_history;
     std::map<std::string, std::set<std::string> >    rc_possibilities;
+    std::map<const std::set<std::string> *, std::unique_ptr<fuzzy_index>>
+        rc_fuzzy_indexes;
     std::map<std::string, std::vector<std::string> > rc_prototypes;
     bool rc_case_sensitive;
     int rc_append_character;
@@ -362,6 +392,19 @@ public:
                          const std::string &value);
     void clear_possibilities(int context, std::string type);
 
+    /**
+     * Replace the possibilities of the given type.  Only the differences
+     * from the possibilities that were already sent are passed to the
+     * readline process, so repeating the same set is cheap.
+     *
+     * @param context The context to update.
+     * @param type The type of possibility.
+     * @param values The new set of possibilities.
+     */
+    void replace_possibilities(int context,
+                               const std::string &type,
+                               const std::set<std::string> &values);
+
     const std::vector<std::string> &get_matches() const {
         return this->rc_matches;
     };
@@ -402,6 +445,12 @@ private:
     int rc_max_match_length;
     int rc_match_index{0};
     std::vector<std::string> rc_matches;
+    /**
+     * A copy of the possibilities that were sent to the readline process,
+     * indexed by context and type.
+     */
+    std::map<int, std::map<std::string, std::set<std::string>>>
+        rc_sent_possibilities;
 
     action rc_change;
     action rc_perform;
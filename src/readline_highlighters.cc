@@ -356,7 +356,7 @@ void readline_regex_highlighter(attr_line_t &al, int x)
 void readline_command_highlighter(attr_line_t &al, int x)
 {
     static const pcrepp RE_PREFIXES(
-        R"(^:(filter-in|filter-out|delete-filter|enable-filter|disable-filter|highlight|clear-highlight|create-search-table\s+[^\s]+\s+))");
+        R"(^:(filter-in|filter-out|filter-expr|delete-filter|enable-filter|disable-filter|highlight|clear-highlight|create-search-table\s+[^\s]+\s+))");
     static const pcrepp SH_PREFIXES("^:(eval|open|append-to|write-to|write-csv-to|write-json-to)");
     static const pcrepp IDENT_PREFIXES("^:(tag|untag|delete-tags)");
     static const pcrepp COLOR_PREFIXES("^:(config)");
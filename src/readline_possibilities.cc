@@ -31,7 +31,9 @@
 
 #include <pcrecpp.h>
 
+#include <set>
 #include <string>
+#include <unordered_map>
 
 #include "lnav.hh"
 #include "sql_util.hh"
@@ -40,6 +42,7 @@
 #include "yajlpp/yajlpp_def.hh"
 #include "lnav_config.hh"
 #include "sqlite-extension-func.hh"
+#include "task_pool.hh"
 
 #include "readline_possibilities.hh"
 
@@ -123,7 +126,7 @@ struct sqlite_metadata_callbacks lnav_sql_meta_callbacks = {
         handle_foreign_key_list,
 };
 
-static void add_text_possibilities(readline_curses *rlc, int context, const string &type, const std::string &str)
+static void add_text_possibilities(set<string> &poss_out, int context, const std::string &str)
 {
     static pcrecpp::RE re_escape("([.\\^$*+?()\\[\\]{}\\\\|])");
     static pcrecpp::RE re_escape_no_dot("([\\^$*+?()\\[\\]{}\\\\|])");
@@ -152,7 +155,7 @@ static void add_text_possibilities(readline_curses *rlc, int context, const stri
                 auto_mem<char, sqlite3_free> quoted_token;
 
                 quoted_token = sqlite3_mprintf("%Q", token_value.c_str());
-                rlc->add_possibility(context, type, std::string(quoted_token));
+                poss_out.insert(std::string(quoted_token));
                 break;
             }
             default: {
@@ -162,9 +165,9 @@ static void add_text_possibilities(readline_curses *rlc, int context, const stri
                     ds.get_input().get_substr(pc.all());
                 re_escape.GlobalReplace(R"(\\\1)", &token_value);
                 re_escape_no_dot.GlobalReplace(R"(\\\1)", &token_value_no_dot);
-                rlc->add_possibility(context, type, token_value);
+                poss_out.insert(token_value);
                 if (token_value != token_value_no_dot) {
-                    rlc->add_possibility(context, type, token_value_no_dot);
+                    poss_out.insert(token_value_no_dot);
                 }
                 break;
             }
@@ -172,7 +175,7 @@ static void add_text_possibilities(readline_curses *rlc, int context, const stri
 
         switch (dt) {
             case DT_QUOTED_STRING:
-                add_text_possibilities(rlc, context, type, ds.get_input().get_substr(pc[0]));
+                add_text_possibilities(poss_out, context, ds.get_input().get_substr(pc[0]));
                 break;
             default:
                 break;
@@ -180,31 +183,65 @@ static void add_text_possibilities(readline_curses *rlc, int context, const stri
     }
 }
 
-void add_view_text_possibilities(readline_curses *rlc, int context, const string &type, textview_curses *tc)
+/**
+ * Reading the clipboard means running a command, which is too slow to wait
+ * for every time a prompt is opened.  Instead, the clipboard is read in the
+ * background and the value from the last read that finished is used.
+ */
+static string find_clipboard_value()
 {
-    text_sub_source *tss = tc->get_sub_source();
+    static bool pending = false;
+    static string retval;
+
+    if (!pending) {
+        auto value = make_shared<string>();
+
+        pending = true;
+        task_pool::singleton().submit(
+            [value]() {
+                auto_mem<FILE> pfile(pclose);
+
+                pfile = open_clipboard(CT_FIND, CO_READ);
+                if (pfile.in() != nullptr) {
+                    char buffer[64];
+
+                    if (fgets(buffer, sizeof(buffer), pfile) != nullptr) {
+                        char *nl;
+
+                        buffer[sizeof(buffer) - 1] = '\0';
+                        if ((nl = strchr(buffer, '\n')) != nullptr) {
+                            *nl = '\0';
+                        }
+                        *value = buffer;
+                    }
+                }
+            },
+            [value]() {
+                retval = *value;
+                pending = false;
+            },
+            task_pool::cancel_token(),
+            task_pool::priority_t::INTERACTIVE);
+    }
 
-    rlc->clear_possibilities(context, type);
+    return retval;
+}
 
-    // XXX We might want to remove this since it can be kinda slow.
-    {
-        auto_mem<FILE> pfile(pclose);
+void add_view_text_possibilities(readline_curses *rlc, int context, const string &type, textview_curses *tc)
+{
+    /**
+     * The tokens found in the lines that were on screen the last time, so
+     * the lines that are still visible do not need to be scanned again.
+     */
+    static unordered_map<int, unordered_map<string, set<string>>> line_cache;
 
-        pfile = open_clipboard(CT_FIND, CO_READ);
-        if (pfile.in() != nullptr) {
-            char buffer[64];
+    text_sub_source *tss = tc->get_sub_source();
+    auto &prev_lines = line_cache[context];
+    unordered_map<string, set<string>> curr_lines;
+    set<string> poss;
 
-            if (fgets(buffer, sizeof(buffer), pfile) != nullptr) {
-                char *nl;
-
-                buffer[sizeof(buffer) - 1] = '\0';
-                if ((nl = strchr(buffer, '\n')) != nullptr) {
-                    *nl = '\0';
-                }
-                rlc->add_possibility(context, type, std::string(buffer));
-            }
-        }
-    }
+    poss.insert(find_clipboard_value());
+    poss.erase("");
 
     for (vis_line_t curr_line = tc->get_top();
          curr_line <= tc->get_bottom();
@@ -213,10 +250,29 @@ void add_view_text_possibilities(readline_curses *rlc, int context, const string
 
         tss->text_value_for_line(*tc, curr_line, line, text_sub_source::RF_RAW);
 
-        add_text_possibilities(rlc, context, type, line);
+        auto curr_iter = curr_lines.find(line);
+
+        if (curr_iter == curr_lines.end()) {
+            auto prev_iter = prev_lines.find(line);
+
+            if (prev_iter != prev_lines.end()) {
+                curr_iter = curr_lines.emplace(
+                    line, std::move(prev_iter->second)).first;
+            } else {
+                set<string> line_poss;
+
+                add_text_possibilities(line_poss, context, line);
+                curr_iter = curr_lines.emplace(
+                    line, std::move(line_poss)).first;
+            }
+        }
+        poss.insert(curr_iter->second.begin(), curr_iter->second.end());
     }
-    
-    rlc->add_possibility(context, type, bookmark_metadata::KNOWN_TAGS);
+    prev_lines = std::move(curr_lines);
+
+    poss.insert(bookmark_metadata::KNOWN_TAGS.begin(),
+                bookmark_metadata::KNOWN_TAGS.end());
+    rlc->replace_possibilities(context, type, poss);
 }
 
 void add_env_possibilities(int context)
@@ -83,7 +83,7 @@ CREATE TABLE regexp_capture (
 
     struct cursor {
         sqlite3_vtab_cursor base;
-        unique_ptr<pcrepp> c_pattern;
+        shared_ptr<pcrepp> c_pattern;
         pcre_context_static<30> c_context;
         unique_ptr<pcre_input> c_input;
         string c_pattern_string;
@@ -230,7 +230,7 @@ static int rcFilter(sqlite3_vtab_cursor *pVtabCursor,
     pCur->c_content = value;
 
     try {
-        pCur->c_pattern = make_unique<pcrepp>(pattern);
+        pCur->c_pattern = pcrepp::cached(pattern);
         pCur->c_pattern_string = pattern;
     } catch (const pcrepp::error &e) {
         pVtabCursor->pVtab->zErrMsg = sqlite3_mprintf(
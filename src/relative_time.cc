@@ -511,15 +511,15 @@ size_t duration2str(int64_t millis, std::string &value_out)
 
     static struct rel_interval {
         long long   length;
-        const char *format;
+        int         min_digits;
         const char *symbol;
     } intervals[] = {
-        { 1000, "%03qd%s", ""  },
-        {   60, "%qd%s",   "s" },
-        {   60, "%qd%s",   "m" },
-        {   24, "%qd%s",   "h" },
-        {    0, "%qd%s",   "d" },
-        {    0, NULL, NULL }
+        { 1000, 3, ""  },
+        {   60, 1, "s" },
+        {   60, 1, "m" },
+        {   24, 1, "h" },
+        {    0, 1, "d" },
+        {    0, 0, NULL }
     };
 
     struct rel_interval *curr_interval = intervals;
@@ -555,10 +555,22 @@ size_t duration2str(int64_t millis, std::string &value_out)
             break;
         }
 
-        snprintf(segment, sizeof(segment), curr_interval->format, amount,
-                 curr_interval->symbol);
-        retval += strlen(segment);
-        value_out.insert(in_len, segment);
+        // This is called for every line in the time-offset view, so the
+        // digits are written out directly instead of using snprintf().
+        char *seg_end = &segment[sizeof(segment)];
+        char *seg_start = seg_end;
+        int digits = 0;
+
+        if (curr_interval->symbol[0] != '\0') {
+            *(--seg_start) = curr_interval->symbol[0];
+        }
+        while (amount > 0 || digits < curr_interval->min_digits) {
+            *(--seg_start) = '0' + (amount % 10);
+            amount /= 10;
+            digits += 1;
+        }
+        retval += seg_end - seg_start;
+        value_out.insert(in_len, seg_start, seg_end - seg_start);
     }
 
     return retval;
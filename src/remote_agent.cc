@@ -0,0 +1,574 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file remote_agent.cc
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <list>
+#include <set>
+#include <vector>
+
+#include <yajl/api/yajl_tree.h>
+
+#include "base/lnav_log.hh"
+#include "auto_mem.hh"
+#include "lnav_util.hh"
+#include "pcrepp/pcrepp.hh"
+#include "line_buffer.hh"
+#include "remote_agent.hh"
+
+using namespace std;
+
+/** How long the agent waits for the file to grow before checking again. */
+static const int AGENT_POLL_MS = 250;
+
+/**
+ * The write ends of the pipes connected to the agents' stdin.  They are
+ * never written to, they are only held open so that the agents exit when
+ * this process does.
+ */
+static list<auto_fd> AGENT_INPUTS;
+
+bool is_remote_path(const char *fn)
+{
+    // URLs are not remote paths and a leading dash would be taken as an
+    // option by ssh.
+    static pcrepp remote_re("^(?!\\w+://)(?!-)(?:[\\w.-]+@)?(?!-)[\\w.-]+:/");
+
+    pcre_context_static<30> pc;
+    pcre_input pi(fn);
+
+    return remote_re.match(pc, pi);
+}
+
+/**
+ * Quote a string so that the remote shell that ssh runs the command with
+ * passes it through unchanged.
+ */
+static string shell_quote(const string &str)
+{
+    string retval = "'";
+
+    for (auto ch : str) {
+        if (ch == '\'') {
+            retval.append("'\\''");
+        } else {
+            retval.push_back(ch);
+        }
+    }
+    retval.push_back('\'');
+
+    return retval;
+}
+
+/**
+ * Run a command on another host with ssh.
+ *
+ * @param host The host to run the command on.
+ * @param command The command line for the remote shell.
+ * @param keep_alive True if the command's stdin should be held open until
+ *   this process exits, otherwise it is connected to /dev/null.
+ * @param merge_stderr True if ssh's stderr should go to the same pipe as
+ *   its stdout, otherwise it gets its own pipe.
+ */
+static Result<remote_agent_proc, std::string> start_remote_command(
+    const std::string &host,
+    const std::string &command,
+    bool keep_alive,
+    bool merge_stderr)
+{
+    const char *ssh = getenv("LNAV_SSH");
+
+    if (host.empty() || host[0] == '-') {
+        return Err(string("invalid host name -- ") + host);
+    }
+    if (ssh == nullptr || ssh[0] == '\0') {
+        ssh = "ssh";
+    }
+
+    auto_pipe in_pipe(STDIN_FILENO);
+    auto_pipe out_pipe(STDOUT_FILENO);
+    auto_pipe err_pipe(STDERR_FILENO);
+
+    if ((keep_alive && in_pipe.open() == -1) ||
+        out_pipe.open() == -1 ||
+        (!merge_stderr && err_pipe.open() == -1)) {
+        return Err(string("unable to create pipe -- ") + strerror(errno));
+    }
+
+    pid_t child_pid = fork();
+
+    in_pipe.after_fork(child_pid);
+    out_pipe.after_fork(child_pid);
+    if (!merge_stderr) {
+        err_pipe.after_fork(child_pid);
+    }
+
+    switch (child_pid) {
+        case -1:
+            return Err(string("unable to fork ssh -- ") + strerror(errno));
+        case 0: {
+            const char *args[] = {
+                ssh,
+                "-C",
+                "-o", "BatchMode=yes",
+                "--",
+                host.c_str(),
+                command.c_str(),
+                nullptr,
+            };
+
+            if (merge_stderr) {
+                // Any errors from ssh end up in the file so they can be seen.
+                dup2(STDOUT_FILENO, STDERR_FILENO);
+            }
+            execvp(args[0], (char *const *) args);
+            fprintf(stderr,
+                    "error: could not exec %s -- %s\n",
+                    args[0],
+                    strerror(errno));
+            _exit(EXIT_FAILURE);
+        }
+        default:
+            break;
+    }
+
+    log_info("started %s on %s with pid %d",
+             command.c_str(), host.c_str(), child_pid);
+
+    remote_agent_proc retval;
+
+    if (keep_alive) {
+        in_pipe.write_end().close_on_exec();
+        AGENT_INPUTS.emplace_back(std::move(in_pipe.write_end()));
+    }
+    retval.rap_output = std::move(out_pipe.read_end());
+    retval.rap_output.close_on_exec();
+    if (!merge_stderr) {
+        retval.rap_error = std::move(err_pipe.read_end());
+        retval.rap_error.close_on_exec();
+    }
+    retval.rap_child = child_pid;
+
+    return Ok(std::move(retval));
+}
+
+Result<remote_agent_proc, std::string> start_remote_agent(
+    const std::string &remote_path)
+{
+    auto colon = remote_path.find(':');
+
+    require(colon != string::npos);
+
+    return start_remote_command(
+        remote_path.substr(0, colon),
+        "lnav -A " + shell_quote(remote_path.substr(colon + 1)),
+        true,
+        true);
+}
+
+/**
+ * Read everything from a pipe until it is closed.
+ */
+static string read_all(int fd)
+{
+    string retval;
+    char buffer[16 * 1024];
+    ssize_t rc;
+
+    while ((rc = read(fd, buffer, sizeof(buffer))) != 0) {
+        if (rc == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        retval.append(buffer, rc);
+    }
+
+    return retval;
+}
+
+/**
+ * Insert the rows in a JSON array of objects, as written by ":write-json-to",
+ * into the table.
+ */
+static string insert_remote_rows(sqlite3 *db,
+                                 const string &quoted_name,
+                                 const string &host,
+                                 yajl_val rows,
+                                 vector<string> &columns)
+{
+    for (size_t row = 0; row < rows->u.array.len; row++) {
+        yajl_val obj = rows->u.array.values[row];
+
+        if (!YAJL_IS_OBJECT(obj)) {
+            return "expecting an object for each row from " + host;
+        }
+
+        for (size_t lpc = 0; lpc < obj->u.object.len; lpc++) {
+            const char *key = obj->u.object.keys[lpc];
+
+            if (find(columns.begin(), columns.end(), key) != columns.end()) {
+                continue;
+            }
+
+            auto_mem<char, sqlite3_free> quoted_col;
+
+            quoted_col = sqlite3_mprintf("\"%w\"", key);
+            string alter = "ALTER TABLE " + quoted_name +
+                           " ADD COLUMN " + quoted_col.in();
+            auto_mem<char, sqlite3_free> errmsg;
+
+            if (sqlite3_exec(db, alter.c_str(), nullptr, nullptr,
+                             errmsg.out()) != SQLITE_OK) {
+                return errmsg.in();
+            }
+            columns.emplace_back(key);
+        }
+
+        string insert = "INSERT INTO " + quoted_name + " (host";
+
+        for (size_t lpc = 0; lpc < obj->u.object.len; lpc++) {
+            auto_mem<char, sqlite3_free> quoted_col;
+
+            quoted_col = sqlite3_mprintf(", \"%w\"", obj->u.object.keys[lpc]);
+            insert += quoted_col.in();
+        }
+        insert += ") VALUES (?";
+        for (size_t lpc = 0; lpc < obj->u.object.len; lpc++) {
+            insert += ", ?";
+        }
+        insert += ")";
+
+        auto_mem<sqlite3_stmt> stmt(sqlite3_finalize);
+
+        if (sqlite3_prepare_v2(db, insert.c_str(), -1,
+                               stmt.out(), nullptr) != SQLITE_OK) {
+            return sqlite3_errmsg(db);
+        }
+
+        sqlite3_bind_text(stmt.in(), 1, host.c_str(), host.size(),
+                          SQLITE_TRANSIENT);
+        for (size_t lpc = 0; lpc < obj->u.object.len; lpc++) {
+            yajl_val val = obj->u.object.values[lpc];
+            int index = lpc + 2;
+
+            if (YAJL_IS_STRING(val)) {
+                sqlite3_bind_text(stmt.in(), index, val->u.string, -1,
+                                  SQLITE_TRANSIENT);
+            } else if (YAJL_IS_INTEGER(val)) {
+                sqlite3_bind_int64(stmt.in(), index, YAJL_GET_INTEGER(val));
+            } else if (YAJL_IS_DOUBLE(val)) {
+                sqlite3_bind_double(stmt.in(), index, YAJL_GET_DOUBLE(val));
+            } else if (YAJL_IS_TRUE(val)) {
+                sqlite3_bind_int(stmt.in(), index, 1);
+            } else if (YAJL_IS_FALSE(val)) {
+                sqlite3_bind_int(stmt.in(), index, 0);
+            } else {
+                sqlite3_bind_null(stmt.in(), index);
+            }
+        }
+
+        if (sqlite3_step(stmt.in()) != SQLITE_DONE) {
+            return sqlite3_errmsg(db);
+        }
+    }
+
+    return "";
+}
+
+std::string create_remote_query_table(sqlite3 *db,
+                                      const std::string &name,
+                                      const std::vector<std::string> &remote_paths,
+                                      const std::string &query)
+{
+    static set<string> REMOTE_TABLES;
+
+    vector<pair<string, vector<string>>> hosts;
+
+    for (const auto &remote_path : remote_paths) {
+        if (!is_remote_path(remote_path.c_str())) {
+            return "expecting a remote file of the form host:/path -- " +
+                   remote_path;
+        }
+
+        auto colon = remote_path.find(':');
+        auto host = remote_path.substr(0, colon);
+        auto iter = find_if(hosts.begin(), hosts.end(),
+                            [&host](const auto &elem) {
+                                return elem.first == host;
+                            });
+
+        if (iter == hosts.end()) {
+            hosts.emplace_back(host, vector<string>());
+            iter = hosts.end() - 1;
+        }
+        iter->second.push_back(remote_path.substr(colon + 1));
+    }
+
+    // Start the query on all of the hosts before waiting for any of them.
+    vector<remote_agent_proc> procs;
+
+    for (const auto &host_pair : hosts) {
+        string command = "lnav -n -q -c " + shell_quote(";" + query) +
+                         " -c " + shell_quote(":write-json-to -");
+
+        for (const auto &path : host_pair.second) {
+            command += " " + shell_quote(path);
+        }
+
+        auto start_result = start_remote_command(
+            host_pair.first, command, false, false);
+
+        if (start_result.isErr()) {
+            return start_result.unwrapErr();
+        }
+        procs.emplace_back(start_result.unwrap());
+    }
+
+    vector<string> outputs;
+    string errmsg;
+
+    for (size_t lpc = 0; lpc < procs.size(); lpc++) {
+        auto &proc = procs[lpc];
+        int status = 0;
+
+        outputs.emplace_back(read_all(proc.rap_output));
+
+        string err_output = read_all(proc.rap_error);
+
+        while (waitpid(proc.rap_child, &status, 0) == -1 && errno == EINTR) {
+        }
+        if (errmsg.empty() &&
+            (!WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+            errmsg = "query failed on " + hosts[lpc].first + " -- " +
+                     trim(err_output);
+        }
+    }
+
+    if (!errmsg.empty()) {
+        return errmsg;
+    }
+
+    auto_mem<char, sqlite3_free> quoted_name;
+    auto_mem<char, sqlite3_free> sql_errmsg;
+
+    quoted_name = sqlite3_mprintf("\"%w\"", name.c_str());
+
+    string create;
+
+    if (REMOTE_TABLES.count(name) > 0) {
+        create = string("DROP TABLE IF EXISTS ") + quoted_name.in() + "; ";
+    }
+    create += string("CREATE TABLE ") + quoted_name.in() + " (host TEXT)";
+    if (sqlite3_exec(db, create.c_str(), nullptr, nullptr,
+                     sql_errmsg.out()) != SQLITE_OK) {
+        return sql_errmsg.in();
+    }
+    REMOTE_TABLES.insert(name);
+
+    vector<string> columns;
+
+    sqlite3_exec(db, "BEGIN TRANSACTION", nullptr, nullptr, nullptr);
+    for (size_t lpc = 0; lpc < outputs.size() && errmsg.empty(); lpc++) {
+        const auto &host = hosts[lpc].first;
+        auto_mem<yajl_val_s> rows(yajl_tree_free);
+        char error_buffer[1024];
+
+        if (outputs[lpc].find_first_not_of(" \t\r\n") == string::npos) {
+            // No rows were found on this host.
+            continue;
+        }
+
+        rows = yajl_tree_parse(outputs[lpc].c_str(),
+                               error_buffer,
+                               sizeof(error_buffer));
+        if (!YAJL_IS_ARRAY(rows.in())) {
+            errmsg = "invalid query results from " + host + " -- " +
+                     error_buffer;
+            break;
+        }
+
+        errmsg = insert_remote_rows(db, quoted_name.in(), host, rows.in(),
+                                    columns);
+    }
+    sqlite3_exec(db, errmsg.empty() ? "COMMIT" : "ROLLBACK",
+                 nullptr, nullptr, nullptr);
+
+    return errmsg;
+}
+
+static bool write_fully(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t rc = write(fd, data, len);
+
+        if (rc == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += rc;
+        len -= rc;
+    }
+
+    return true;
+}
+
+/**
+ * @return True if the viewer has gone away and closed the agent's stdin.
+ */
+static bool viewer_closed(int timeout_ms)
+{
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+
+    if (poll(&pfd, 1, timeout_ms) <= 0) {
+        return false;
+    }
+
+    char buffer[1024];
+    ssize_t rc = read(STDIN_FILENO, buffer, sizeof(buffer));
+
+    return rc == 0 || (rc == -1 && errno != EINTR && errno != EAGAIN);
+}
+
+static int follow_file(const char *path)
+{
+    line_buffer lb;
+    file_range last_range;
+    struct stat curr_st;
+    vector<char> out;
+
+    memset(&curr_st, 0, sizeof(curr_st));
+    while (true) {
+        if (lb.get_fd() == -1) {
+            auto_fd fd;
+
+            if ((fd = open(path, O_RDONLY)) == -1 ||
+                fstat(fd, &curr_st) == -1) {
+                fprintf(stderr,
+                        "error: unable to open file: %s -- %s\n",
+                        path,
+                        strerror(errno));
+                return EXIT_FAILURE;
+            }
+            fd.close_on_exec();
+            lb.set_fd(fd);
+            last_range = file_range{};
+        }
+
+        auto load_result = lb.load_next_lines(last_range);
+
+        if (load_result.isErr()) {
+            fprintf(stderr,
+                    "error: unable to read file: %s -- %s\n",
+                    path,
+                    load_result.unwrapErr().c_str());
+            return EXIT_FAILURE;
+        }
+
+        auto lines = load_result.unwrap();
+
+        out.clear();
+        for (const auto &li : lines) {
+            if (li.li_partial) {
+                break;
+            }
+
+            auto read_result = lb.read_range(li.li_file_range);
+
+            if (read_result.isErr()) {
+                break;
+            }
+
+            auto sbr = read_result.unwrap();
+
+            // The range includes the line ending, so the lines are copied
+            // as they are.
+            out.insert(out.end(), sbr.get_data(), sbr.get_data() + sbr.length());
+            last_range = li.li_file_range;
+        }
+
+        if (!out.empty()) {
+            if (!write_fully(STDOUT_FILENO, out.data(), out.size())) {
+                return EXIT_SUCCESS;
+            }
+            if (viewer_closed(0)) {
+                return EXIT_SUCCESS;
+            }
+            continue;
+        }
+
+        if (viewer_closed(AGENT_POLL_MS)) {
+            return EXIT_SUCCESS;
+        }
+
+        // Start over if the file was rotated or truncated, the viewer just
+        // sees the new lines added to the end.
+        struct stat st;
+
+        if (stat(path, &st) == 0 &&
+            (st.st_ino != curr_st.st_ino || st.st_dev != curr_st.st_dev ||
+             st.st_size < last_range.next_offset())) {
+            log_info("%s: file was replaced, following the new one", path);
+            auto_fd none;
+
+            lb.set_fd(none);
+        }
+    }
+}
+
+int run_remote_agent(const char *path)
+{
+    signal(SIGPIPE, SIG_IGN);
+
+    try {
+        return follow_file(path);
+    } catch (const line_buffer::error &e) {
+        fprintf(stderr,
+                "error: unable to read file: %s -- %s\n",
+                path,
+                strerror(e.e_err));
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,107 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file remote_agent.hh
+ */
+
+#ifndef lnav_remote_agent_hh
+#define lnav_remote_agent_hh
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "auto_fd.hh"
+#include "base/result.h"
+
+/**
+ * @param fn The name of a file given on the command-line.
+ * @return True if the name refers to a file on another host, for example,
+ *   "host:/var/log/messages" or "user@host:/var/log/messages".
+ */
+bool is_remote_path(const char *fn);
+
+/**
+ * The agent that was started on another host to follow a file.
+ */
+struct remote_agent_proc {
+    /** The pipe that the lines of the remote file are read from. */
+    auto_fd rap_output;
+    /** The pipe for ssh's stderr, if it is not sent to rap_output. */
+    auto_fd rap_error;
+    /** The pid of the ssh process. */
+    pid_t rap_child{-1};
+};
+
+/**
+ * Start an agent for the given remote file with ssh.  The agent is the same
+ * lnav binary run as "lnav -A <path>" on the other host.  The ssh command
+ * can be changed with the LNAV_SSH environment variable.
+ *
+ * @param remote_path The "host:/path" name of the file.
+ * @return The running agent or an error message.
+ */
+Result<remote_agent_proc, std::string> start_remote_agent(
+    const std::string &remote_path);
+
+/**
+ * Run a query with the lnav on each of the hosts of the given remote files
+ * and put the combined results in a local table.  Each host only sends back
+ * the rows of its results, so a query with a GROUP BY sends partial
+ * aggregates that can be merged with another query on the table.  The
+ * table has a "host" column, followed by the columns of the results.
+ *
+ * @param db The database to create the table in.
+ * @param name The name of the table, a table previously created by this
+ *   function with the same name is replaced.
+ * @param remote_paths The "host:/path" names of the files to query, the
+ *   files on the same host are all opened by a single lnav.
+ * @param query The SQL query to run on each host.
+ * @return An empty string on success, otherwise the error message.
+ */
+std::string create_remote_query_table(sqlite3 *db,
+                                      const std::string &name,
+                                      const std::vector<std::string> &remote_paths,
+                                      const std::string &query);
+
+/**
+ * Follow a file on this host and write its complete lines to stdout, this
+ * is what runs on the other end of start_remote_agent().  Lines are only
+ * written once they end with a newline, so the viewer never sees a line
+ * change.  The agent exits when stdin is closed or stdout cannot be
+ * written to.
+ *
+ * @param path The file to follow.
+ * @return The exit status for the process.
+ */
+int run_remote_agent(const char *path);
+
+#endif
@@ -71,6 +71,8 @@ CREATE TABLE IF NOT EXISTS bookmarks (
     PRIMARY KEY (log_time, log_format, log_hash, session_time)
 );
 
+CREATE INDEX IF NOT EXISTS bookmarks_access_time ON bookmarks (access_time);
+
 CREATE TABLE IF NOT EXISTS time_offset (
     log_time datetime,
     log_format varchar(64),
@@ -148,39 +150,69 @@ int bind_values(sqlite3_stmt *stmt, Args ... args) {
     return bind_values_helper(stmt, std::make_index_sequence<sizeof...(Args)>(), args...);
 }
 
+/**
+ * The columns that identify a line in the bookmark tables.
+ */
+struct line_key {
+    struct timeval lk_time;
+    intern_string_t lk_format;
+    string lk_hash;
+};
+
+/**
+ * The keys of the lines that have been bound so far while saving.  The same
+ * lines are usually deleted and then inserted again, so this saves reading
+ * and hashing them twice.
+ */
+using line_key_cache = std::map<content_line_t, line_key>;
+
 static bool bind_line(sqlite3 *db,
                       sqlite3_stmt *stmt,
                       content_line_t cl,
-                      time_t session_time)
+                      time_t session_time,
+                      line_key_cache &cache)
 {
-    logfile_sub_source &lss = lnav_data.ld_log_source;
-    shared_ptr<logfile> lf;
+    auto cache_iter = cache.find(cl);
 
-    lf = lss.find(cl);
+    if (cache_iter == cache.end()) {
+        logfile_sub_source &lss = lnav_data.ld_log_source;
+        content_line_t file_cl = cl;
+        shared_ptr<logfile> lf;
 
-    if (lf == nullptr) {
-        return false;
-    }
+        lf = lss.find(file_cl);
 
-    sqlite3_clear_bindings(stmt);
+        if (lf == nullptr) {
+            return false;
+        }
 
-    auto line_iter = lf->begin() + cl;
-    auto read_result = lf->read_line(line_iter);
+        auto line_iter = lf->begin() + file_cl;
+        auto read_result = lf->read_line(line_iter);
 
-    if (read_result.isErr()) {
-        return false;
+        if (read_result.isErr()) {
+            return false;
+        }
+
+        auto line_hash = read_result.map([file_cl](auto sbr) {
+            return hash_bytes(sbr.get_data(), sbr.length(),
+                              &file_cl, sizeof(file_cl),
+                              nullptr);
+        }).unwrap();
+
+        cache_iter = cache.emplace(cl, line_key{
+            lf->original_line_time(line_iter),
+            lf->get_format()->get_name(),
+            std::move(line_hash),
+        }).first;
     }
 
-    auto line_hash = read_result.map([cl](auto sbr) {
-        return hash_bytes(sbr.get_data(), sbr.length(),
-                          &cl, sizeof(cl),
-                          nullptr);
-    }).unwrap();
+    const auto &lk = cache_iter->second;
+
+    sqlite3_clear_bindings(stmt);
 
     return bind_values(stmt,
-                       lf->original_line_time(line_iter),
-                       lf->get_format()->get_name(),
-                       line_hash,
+                       lk.lk_time,
+                       lk.lk_format,
+                       lk.lk_hash,
                        session_time) == SQLITE_OK;
 }
 
@@ -427,14 +459,11 @@ static void load_time_bookmarks()
          file_iter != lnav_data.ld_log_source.end();
          ++file_iter) {
         shared_ptr<logfile> lf = (*file_iter)->get_file();
-        content_line_t base_content_line;
 
         if (lf == nullptr) {
             continue;
         }
 
-        base_content_line = lss.get_file_base_content_line(file_iter);
-
         auto low_line_iter = lf->begin();
         auto high_line_iter = lf->end();
 
@@ -511,8 +540,8 @@ static void load_time_bookmarks()
                                                   nullptr);
 
                     if (line_hash == log_hash) {
-                        content_line_t line_cl = content_line_t(
-                            base_content_line + std::distance(lf->begin(), line_iter));
+                        content_line_t line_cl = lss.get_content_line(
+                            *file_iter, std::distance(lf->begin(), line_iter));
                         bool meta = false;
 
                         if (part_name != nullptr && part_name[0] != '\0') {
@@ -596,14 +625,11 @@ static void load_time_bookmarks()
          file_iter != lnav_data.ld_log_source.end();
          ++file_iter) {
         shared_ptr<logfile> lf = (*file_iter)->get_file();
-        content_line_t base_content_line;
 
         if (lf == nullptr) {
             continue;
         }
 
-        lss.find(lf->get_filename().c_str(), base_content_line);
-
         auto low_line_iter = lf->begin();
         auto high_line_iter = lf->end();
 
@@ -676,8 +702,8 @@ static void load_time_bookmarks()
                     string line_hash = hash_bytes(sbr.get_data(), sbr.length(), nullptr);
                     if (line_hash == log_hash) {
                         int file_line = std::distance(lf->begin(), line_iter);
-                        content_line_t line_cl = content_line_t(
-                            base_content_line + file_line);
+                        content_line_t line_cl = lss.get_content_line(
+                            *file_iter, file_line);
                         struct timeval offset;
 
                         offset_session_lines.push_back(line_cl);
@@ -875,8 +901,10 @@ static void yajl_writer(void *context, const char *str, size_t len)
     fwrite(str, len, 1, file);
 }
 
-static void save_user_bookmarks(
-    sqlite3 *db, sqlite3_stmt *stmt, bookmark_vector<content_line_t> &user_marks)
+static void save_user_bookmarks(sqlite3 *db,
+                                sqlite3_stmt *stmt,
+                                bookmark_vector<content_line_t> &user_marks,
+                                line_key_cache &cache)
 {
     logfile_sub_source &lss = lnav_data.ld_log_source;
     std::map<content_line_t, bookmark_metadata> &bm_meta =
@@ -889,7 +917,7 @@ static void save_user_bookmarks(
 
         meta_iter = bm_meta.find(cl);
 
-        if (!bind_line(db, stmt, cl, lnav_data.ld_session_time)) {
+        if (!bind_line(db, stmt, cl, lnav_data.ld_session_time, cache)) {
             continue;
         }
 
@@ -990,6 +1018,7 @@ static void save_time_bookmarks()
 
     logfile_sub_source &lss = lnav_data.ld_log_source;
     bookmarks<content_line_t>::type &bm = lss.get_user_bookmarks();
+    line_key_cache cache;
 
     if (sqlite3_prepare_v2(db.in(),
                            "DELETE FROM bookmarks WHERE "
@@ -1005,8 +1034,8 @@ static void save_time_bookmarks()
     }
 
     for (auto &marked_session_line : marked_session_lines) {
-        if (!bind_line(
-            db.in(), stmt.in(), marked_session_line, lnav_data.ld_session_time)) {
+        if (!bind_line(db.in(), stmt.in(), marked_session_line,
+                       lnav_data.ld_session_time, cache)) {
             continue;
         }
 
@@ -1047,12 +1076,11 @@ static void save_time_bookmarks()
             if (lf == nullptr)
                 continue;
 
-            base_content_line = lss.get_file_base_content_line(file_iter);
-            base_content_line = content_line_t(
-                base_content_line + lf->size() - 1);
+            base_content_line = lss.get_content_line(*file_iter,
+                                                     lf->size() - 1);
 
             if (!bind_line(db.in(), stmt.in(), base_content_line,
-                lnav_data.ld_session_time)) {
+                           lnav_data.ld_session_time, cache)) {
                 continue;
             }
 
@@ -1073,8 +1101,10 @@ static void save_time_bookmarks()
         }
     }
 
-    save_user_bookmarks(db.in(), stmt.in(), bm[&textview_curses::BM_USER]);
-    save_user_bookmarks(db.in(), stmt.in(), bm[&textview_curses::BM_META]);
+    save_user_bookmarks(db.in(), stmt.in(), bm[&textview_curses::BM_USER],
+                        cache);
+    save_user_bookmarks(db.in(), stmt.in(), bm[&textview_curses::BM_META],
+                        cache);
 
     if (sqlite3_prepare_v2(db.in(),
                            "DELETE FROM time_offset WHERE "
@@ -1090,8 +1120,8 @@ static void save_time_bookmarks()
     }
 
     for (auto &offset_session_line : offset_session_lines) {
-        if (!bind_line(
-            db.in(), stmt.in(), offset_session_line, lnav_data.ld_session_time)) {
+        if (!bind_line(db.in(), stmt.in(), offset_session_line,
+                       lnav_data.ld_session_time, cache)) {
             continue;
         }
 
@@ -1136,7 +1166,7 @@ static void save_time_bookmarks()
             base_content_line = lss.get_file_base_content_line(file_iter);
 
             if (!bind_line(db.in(), stmt.in(), base_content_line,
-                lnav_data.ld_session_time)) {
+                           lnav_data.ld_session_time, cache)) {
                 continue;
             }
 
@@ -1204,13 +1234,15 @@ static void save_time_bookmarks()
         sqlite3_reset(stmt.in());
     }
 
-    if (sqlite3_exec(db.in(), "COMMIT", NULL, NULL, errmsg.out()) != SQLITE_OK) {
-        log_error("unable to begin transaction -- %s\n", errmsg.in());
+    // Trim the old bookmarks in the same transaction, so the database is
+    // only synced once.
+    if (sqlite3_exec(db.in(), BOOKMARK_LRU_STMT, NULL, NULL, errmsg.out()) != SQLITE_OK) {
+        log_error("unable to delete old bookmarks -- %s\n", errmsg.in());
         return;
     }
 
-    if (sqlite3_exec(db.in(), BOOKMARK_LRU_STMT, NULL, NULL, errmsg.out()) != SQLITE_OK) {
-        log_error("unable to delete old bookmarks -- %s\n", errmsg.in());
+    if (sqlite3_exec(db.in(), "COMMIT", NULL, NULL, errmsg.out()) != SQLITE_OK) {
+        log_error("unable to begin transaction -- %s\n", errmsg.in());
         return;
     }
 }
@@ -1338,7 +1370,7 @@ void save_session()
                                 continue;
                             }
 
-                            for (auto vd : elf->elf_value_defs) {
+                            for (auto vd : *elf->elf_value_defs) {
                                 if (!vd.second->vd_user_hidden) {
                                     continue;
                                 }
@@ -1441,7 +1473,7 @@ void reset_session()
             continue;
         }
 
-        for (const auto &vd : elf->elf_value_defs) {
+        for (const auto &vd : *elf->elf_value_defs) {
             vd.second->vd_user_hidden = false;
         }
     }
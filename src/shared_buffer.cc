@@ -53,8 +53,12 @@ void shared_buffer_ref::share(shared_buffer &sb, char *data, size_t len)
 
     this->disown();
 
-    sb.add_ref(*this);
-    this->sb_owner = &sb;
+    if (sb.uses_generations()) {
+        this->sb_generation = sb.get_generation();
+    } else {
+        sb.add_ref(*this);
+        this->sb_owner = &sb;
+    }
     this->sb_data = data;
     this->sb_length = len;
 
@@ -67,16 +71,19 @@ bool shared_buffer_ref::subset(shared_buffer_ref &other, off_t offset, size_t le
 
     if (offset != -1) {
         this->sb_owner = other.sb_owner;
+        this->sb_generation = other.sb_generation;
         this->sb_length = len;
-        if (this->sb_owner == NULL) {
+        if (this->sb_owner != NULL) {
+            LIST_INSERT_HEAD(&this->sb_owner->sb_refs, this, sb_link);
+            this->sb_data = &other.sb_data[offset];
+        } else if (this->sb_generation != nullptr) {
+            this->sb_data = &other.sb_data[offset];
+        } else {
             if ((this->sb_data = (char *)malloc(this->sb_length)) == NULL) {
                 return false;
             }
 
             memcpy(this->sb_data, &other.sb_data[offset], len);
-        } else {
-            LIST_INSERT_HEAD(&this->sb_owner->sb_refs, this, sb_link);
-            this->sb_data = &other.sb_data[offset];
         }
     }
     return true;
@@ -94,6 +101,13 @@ shared_buffer_ref::shared_buffer_ref(shared_buffer_ref &&other)
         this->sb_data = other.sb_data;
         this->sb_length = other.sb_length;
         other.disown();
+    } else if (other.sb_generation != nullptr) {
+        this->sb_owner = nullptr;
+        this->sb_generation = std::move(other.sb_generation);
+        this->sb_data = other.sb_data;
+        this->sb_length = other.sb_length;
+        other.sb_data = nullptr;
+        other.sb_length = 0;
     } else {
         this->sb_owner = nullptr;
         this->sb_data = other.sb_data;
@@ -37,6 +37,8 @@
 #include <sys/types.h>
 #include <sys/queue.h>
 
+#include <functional>
+#include <memory>
 #include <string>
 
 #include "auto_mem.hh"
@@ -44,6 +46,23 @@
 
 class shared_buffer;
 
+/**
+ * A generation of the memory managed by a shared_buffer.  The refs to the
+ * generation keep it alive, so the owner can move on to new memory without
+ * the refs needing to copy their data.  The old memory is released once the
+ * last ref is dropped.
+ */
+struct shared_buffer_generation {
+    ~shared_buffer_generation() {
+        if (this->sbg_release) {
+            this->sbg_release();
+        }
+    };
+
+    /** Called to release the memory after it has been retired. */
+    std::function<void()> sbg_release;
+};
+
 struct shared_buffer_ref {
 public:
     shared_buffer_ref(char *data = nullptr, size_t len = 0)
@@ -111,7 +130,7 @@ public:
     bool subset(shared_buffer_ref &other, off_t offset, size_t len);
 
     bool take_ownership() {
-        if (this->sb_owner != nullptr && this->sb_data != nullptr) {
+        if (this->is_shared() && this->sb_data != nullptr) {
             char *new_data;
         
             if ((new_data = (char *)malloc(this->sb_length)) == nullptr) {
@@ -120,27 +139,34 @@ public:
 
             memcpy(new_data, this->sb_data, this->sb_length);
             this->sb_data = new_data;
-            LIST_REMOVE(this, sb_link);
-            this->sb_owner = nullptr;
+            if (this->sb_owner != nullptr) {
+                LIST_REMOVE(this, sb_link);
+                this->sb_owner = nullptr;
+            }
+            this->sb_generation.reset();
         }
         return true;
     };
 
     void disown() {
-        if (this->sb_owner == nullptr) {
-            if (this->sb_data != nullptr) {
-                free(this->sb_data);
-            }
-        } else {
+        if (this->sb_owner != nullptr) {
             LIST_REMOVE(this, sb_link);
+        } else if (this->sb_generation == nullptr && this->sb_data != nullptr) {
+            free(this->sb_data);
         }
         this->sb_owner = nullptr;
+        this->sb_generation.reset();
         this->sb_data = nullptr;
         this->sb_length = 0;
     };
 
     LIST_ENTRY(shared_buffer_ref) sb_link;
 private:
+    /** @return True if the data is owned by a shared_buffer. */
+    bool is_shared() const {
+        return this->sb_owner != nullptr || this->sb_generation != nullptr;
+    };
+
     void copy_ref(const shared_buffer_ref &other) {
         if (other.sb_data == nullptr) {
             this->sb_owner = nullptr;
@@ -149,6 +175,11 @@ private:
         }
         else if (other.sb_owner != nullptr) {
             this->share(*other.sb_owner, other.sb_data, other.sb_length);
+        } else if (other.sb_generation != nullptr) {
+            this->sb_owner = nullptr;
+            this->sb_generation = other.sb_generation;
+            this->sb_data = other.sb_data;
+            this->sb_length = other.sb_length;
         } else {
             this->sb_owner = nullptr;
             this->sb_data = (char *)malloc(other.sb_length);
@@ -159,13 +190,29 @@ private:
 
     auto_mem<char *> sb_backtrace;
     shared_buffer *sb_owner;
+    std::shared_ptr<shared_buffer_generation> sb_generation;
     char *sb_data;
     size_t sb_length;
 };
 
+/**
+ * Tracks the refs to a buffer so they remain valid when the buffer changes.
+ * By default, the refs are kept in a list and invalidate_refs() makes each
+ * one take a copy of its data.  An owner that can hand over its memory,
+ * like the line_buffer, can instead use generations.  In that mode, the refs
+ * hold a count on the current generation and the owner calls retire() when
+ * it wants to reuse or free the memory.  The refs keep pointing at the old
+ * memory without copying it and can be passed to other threads.
+ */
 class shared_buffer {
 public:
-    shared_buffer() {
+    enum class mode_t {
+        COPY_ON_INVALIDATE,
+        GENERATIONS,
+    };
+
+    explicit shared_buffer(mode_t mode = mode_t::COPY_ON_INVALIDATE)
+        : sb_mode(mode) {
         LIST_INIT(&this->sb_refs);
     };
 
@@ -177,6 +224,45 @@ public:
         LIST_INSERT_HEAD(&this->sb_refs, &ref, sb_link);
     };
 
+    bool uses_generations() const {
+        return this->sb_mode == mode_t::GENERATIONS;
+    };
+
+    /** @return The generation that new refs should hold, creating it if needed. */
+    const std::shared_ptr<shared_buffer_generation> &get_generation() {
+        if (this->sb_generation == nullptr) {
+            this->sb_generation = std::make_shared<shared_buffer_generation>();
+        }
+
+        return this->sb_generation;
+    };
+
+    /** @return True if there are refs to the current memory. */
+    bool has_refs() const {
+        return !LIST_EMPTY(&this->sb_refs) ||
+               (this->sb_generation != nullptr &&
+                this->sb_generation.use_count() > 1);
+    };
+
+    /**
+     * Hand over the current memory to the refs that point into it and start
+     * a new generation.
+     *
+     * @param release The function that will free the memory once the last
+     *   ref to it is dropped.  It is called right away if there are no refs.
+     */
+    void retire(std::function<void()> release) {
+        require(this->uses_generations());
+
+        if (this->sb_generation == nullptr) {
+            release();
+            return;
+        }
+
+        this->sb_generation->sbg_release = std::move(release);
+        this->sb_generation.reset();
+    };
+
     bool invalidate_refs() {
         shared_buffer_ref *ref;
         bool retval = true;
@@ -191,6 +277,10 @@ public:
     };
 
     LIST_HEAD(shared_buffer_head, shared_buffer_ref) sb_refs;
+
+private:
+    mode_t sb_mode;
+    std::shared_ptr<shared_buffer_generation> sb_generation;
 };
 
 struct tmp_shared_buffer {
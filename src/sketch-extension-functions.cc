@@ -0,0 +1,293 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file sketch-extension-functions.cc
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <string>
+
+#include "sqlite3.h"
+
+#include "base/sketches.hh"
+#include "spookyhash/SpookyV2.h"
+#include "yajlpp/yajlpp.hh"
+#include "vtab_module.hh"
+#include "sqlite-extension-func.hh"
+
+using namespace std;
+
+/**
+ * Get the sketch stored in the aggregate context, creating it on the first
+ * step.  The context only holds a pointer since sqlite does not construct
+ * or destroy the objects in it.
+ */
+template<typename T, typename... Args>
+static T *create_sketch(sqlite3_context *context, Args... args)
+{
+    auto pp = (T **) sqlite3_aggregate_context(context, sizeof(T *));
+
+    if (pp == nullptr) {
+        return nullptr;
+    }
+    if (*pp == nullptr) {
+        *pp = new T(args...);
+    }
+
+    return *pp;
+}
+
+/**
+ * @return The sketch stored in the aggregate context or nullptr if no
+ * values were added.
+ */
+template<typename T>
+static T *get_sketch(sqlite3_context *context)
+{
+    auto pp = (T **) sqlite3_aggregate_context(context, 0);
+
+    return pp == nullptr ? nullptr : *pp;
+}
+
+template<typename T>
+static void free_sketch(sqlite3_context *context)
+{
+    auto pp = (T **) sqlite3_aggregate_context(context, 0);
+
+    if (pp != nullptr) {
+        delete *pp;
+        *pp = nullptr;
+    }
+}
+
+struct percentile_state {
+    quantile_sketch ps_sketch;
+    double ps_fraction{0.5};
+};
+
+static void sql_approx_percentile_step(sqlite3_context *context,
+                                       int argc,
+                                       sqlite3_value **argv)
+{
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+        return;
+    }
+
+    auto ps = create_sketch<percentile_state>(context);
+
+    if (ps == nullptr) {
+        sqlite3_result_error_nomem(context);
+        return;
+    }
+
+    if (ps->ps_sketch.count() == 0) {
+        double fraction = sqlite3_value_double(argv[1]);
+
+        if (fraction < 0.0 || fraction > 1.0) {
+            sqlite3_result_error(
+                context,
+                "approx_percentile() fraction must be between 0 and 1", -1);
+            return;
+        }
+        ps->ps_fraction = fraction;
+    }
+    ps->ps_sketch.add(sqlite3_value_double(argv[0]));
+}
+
+static void sql_approx_percentile_final(sqlite3_context *context)
+{
+    auto ps = get_sketch<percentile_state>(context);
+
+    if (ps == nullptr || ps->ps_sketch.count() == 0) {
+        sqlite3_result_null(context);
+    } else {
+        sqlite3_result_double(context,
+                              ps->ps_sketch.quantile(ps->ps_fraction));
+    }
+    free_sketch<percentile_state>(context);
+}
+
+static void sql_approx_count_distinct_step(sqlite3_context *context,
+                                           int argc,
+                                           sqlite3_value **argv)
+{
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+        return;
+    }
+
+    auto ds = create_sketch<distinct_sketch>(context);
+
+    if (ds == nullptr) {
+        sqlite3_result_error_nomem(context);
+        return;
+    }
+    auto value = sqlite3_value_text(argv[0]);
+    auto len = sqlite3_value_bytes(argv[0]);
+
+    ds->add_hash(SpookyHash::Hash64(value, len, 0));
+}
+
+static void sql_approx_count_distinct_final(sqlite3_context *context)
+{
+    auto ds = get_sketch<distinct_sketch>(context);
+
+    sqlite3_result_int64(context, ds == nullptr ? 0 : ds->estimate());
+    free_sketch<distinct_sketch>(context);
+}
+
+/** The number of counters kept for each of the values that are returned. */
+static const size_t TOP_K_COUNTERS_PER_VALUE = 10;
+
+struct top_k_state {
+    explicit top_k_state(size_t k)
+        : tks_k(k), tks_sketch(std::max((size_t) 100,
+                                        k * TOP_K_COUNTERS_PER_VALUE)) {
+    };
+
+    size_t tks_k;
+    top_k_sketch tks_sketch;
+};
+
+static void sql_approx_top_k_step(sqlite3_context *context,
+                                  int argc,
+                                  sqlite3_value **argv)
+{
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+        return;
+    }
+
+    int64_t k = 10;
+
+    if (argc > 1) {
+        k = sqlite3_value_int64(argv[1]);
+        if (k < 1) {
+            sqlite3_result_error(
+                context, "approx_top_k() count must be positive", -1);
+            return;
+        }
+    }
+
+    auto tks = create_sketch<top_k_state>(context, (size_t) k);
+
+    if (tks == nullptr) {
+        sqlite3_result_error_nomem(context);
+        return;
+    }
+    auto value = (const char *) sqlite3_value_text(argv[0]);
+    auto len = sqlite3_value_bytes(argv[0]);
+
+    tks->tks_sketch.add(string(value, len));
+}
+
+static void sql_approx_top_k_final(sqlite3_context *context)
+{
+    auto tks = get_sketch<top_k_state>(context);
+    yajlpp_gen gen;
+
+    yajl_gen_config(gen, yajl_gen_beautify);
+    {
+        yajlpp_array arr(gen);
+
+        if (tks != nullptr) {
+            for (const auto &it : tks->tks_sketch.top(tks->tks_k)) {
+                yajlpp_map obj(gen);
+
+                obj.gen("value");
+                obj.gen(it.i_value);
+                obj.gen("count");
+                obj.gen((long long) it.i_count);
+            }
+        }
+    }
+
+    auto sf = gen.to_string_fragment();
+
+    sqlite3_result_text(context, sf.data(), sf.length(), SQLITE_TRANSIENT);
+#ifdef HAVE_SQLITE3_VALUE_SUBTYPE
+    sqlite3_result_subtype(context, JSON_SUBTYPE);
+#endif
+    free_sketch<top_k_state>(context);
+}
+
+int sketch_extension_functions(struct FuncDef **basic_funcs,
+                               struct FuncDefAgg **agg_funcs)
+{
+    static struct FuncDefAgg sketch_agg_funcs[] = {
+        {"approx_percentile", 2, 0,
+            sql_approx_percentile_step, sql_approx_percentile_final,
+            help_text("approx_percentile",
+                      "Estimate the value at a percentile using a fixed "
+                      "amount of memory.  The result is within one percent "
+                      "of the exact value.")
+                .sql_function()
+                .with_parameter({"value", "The values to compute the percentile of"})
+                .with_parameter({"fraction", "The percentile as a number between 0 and 1"})
+                .with_tags({"math"})
+                .with_example(
+                    {"SELECT approx_percentile(column1, 0.5) FROM (VALUES (1), (2), (3), (4), (100))"})
+        },
+
+        {"approx_count_distinct", 1, 0,
+            sql_approx_count_distinct_step, sql_approx_count_distinct_final,
+            help_text("approx_count_distinct",
+                      "Estimate the number of distinct values using a fixed "
+                      "amount of memory.  The typical error is about one "
+                      "percent.")
+                .sql_function()
+                .with_parameter({"value", "The values to count"})
+                .with_tags({"math"})
+                .with_example(
+                    {"SELECT approx_count_distinct(column1) FROM (VALUES ('a'), ('b'), ('a'))"})
+        },
+
+        {"approx_top_k", -1, 0,
+            sql_approx_top_k_step, sql_approx_top_k_final,
+            help_text("approx_top_k",
+                      "Estimate the most frequent values using a fixed "
+                      "amount of memory.  The result is a JSON array of "
+                      "objects with the value and its count.")
+                .sql_function()
+                .with_parameter({"value", "The values to count"})
+                .with_parameter(help_text("k", "The number of values to return, defaults to 10")
+                                    .optional())
+                .with_tags({"math"})
+                .with_example(
+                    {"SELECT approx_top_k(column1, 2) FROM (VALUES ('a'), ('b'), ('a'), ('c'), ('a'), ('b'))"})
+        },
+
+        {nullptr}
+    };
+
+    *basic_funcs = nullptr;
+    *agg_funcs = sketch_agg_funcs;
+
+    return SQLITE_OK;
+}
@@ -80,7 +80,7 @@ struct spectrogram_row {
     };
 
     ~spectrogram_row() {
-        delete this->sr_values;
+        delete[] this->sr_values;
     }
 
     struct row_bucket {
@@ -93,10 +93,25 @@ struct spectrogram_row {
     row_bucket *sr_values;
     unsigned long sr_width;
     double sr_column_size;
+    /**
+     * The values that were added to this row, kept so that the row can be
+     * bucketed again for a new width or range without asking the value
+     * source for them again.
+     */
+    std::vector<std::pair<double, bool>> sr_samples;
 
     void add_value(spectrogram_request &sr, double value, bool marked) {
+        this->sr_samples.emplace_back(value, marked);
+        this->bucket_value(sr, value, marked);
+    };
+
+    void bucket_value(spectrogram_request &sr, double value, bool marked) {
         long index = lrint((value - sr.sr_bounds.sb_min_value_out) / sr.sr_column_size);
 
+        if (index < 0 || index > (long) this->sr_width) {
+            return;
+        }
+
         this->sr_values[index].rb_counter += 1;
         if (marked) {
             this->sr_values[index].rb_marks += 1;
@@ -427,6 +442,15 @@ public:
             return;
         }
 
+        if (this->ss_cached_bounds.sb_count > 0) {
+            // Only the rows at the end can be missing the new values.
+            auto last_row_time = rounddown(this->ss_cached_bounds.sb_end_time,
+                                           this->ss_granularity);
+
+            this->ss_row_cache.erase(
+                this->ss_row_cache.lower_bound(last_row_time),
+                this->ss_row_cache.end());
+        }
         this->ss_cached_bounds = sb;
 
         if (sb.sb_count == 0) {
@@ -479,15 +503,20 @@ public:
 
         spectrogram_row &s_row = this->ss_row_cache[row_time];
 
-        if (s_row.sr_values == NULL ||
-            s_row.sr_width != width ||
-            s_row.sr_column_size != sr.sr_column_size) {
+        if (s_row.sr_values == NULL) {
             s_row.sr_width = width;
             s_row.sr_column_size = sr.sr_column_size;
-            delete s_row.sr_values;
             s_row.sr_values = new spectrogram_row::row_bucket[width + 1];
-            memset(s_row.sr_values, 0, sizeof(int) * (width + 1));
             this->ss_value_source->spectro_row(sr, s_row);
+        } else if (s_row.sr_width != width ||
+                   s_row.sr_column_size != sr.sr_column_size) {
+            s_row.sr_width = width;
+            s_row.sr_column_size = sr.sr_column_size;
+            delete[] s_row.sr_values;
+            s_row.sr_values = new spectrogram_row::row_bucket[width + 1];
+            for (const auto &sample : s_row.sr_samples) {
+                s_row.bucket_value(sr, sample.first, sample.second);
+            }
         }
 
         return s_row;
@@ -0,0 +1,635 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file sql_export.cc
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#ifdef HAVE_ZSTD_H
+#include <zstd.h>
+#endif
+
+#include "base/lnav_log.hh"
+#include "auto_mem.hh"
+#include "lnav_util.hh"
+#include "command_executor.hh"
+#include "yajlpp/json_op.hh"
+#include "vtab_module.hh"
+#include "sql_export.hh"
+
+using namespace std;
+
+/** The amount of output that is collected before it is written. */
+static const size_t EXPORT_BUFFER_SIZE = 1024 * 1024;
+
+sql_exporter *sql_exporter::se_active = nullptr;
+
+namespace {
+
+class file_sink : public export_sink {
+public:
+    explicit file_sink(FILE *file) : fs_file(file) {
+        setvbuf(this->fs_file, nullptr, _IOFBF, EXPORT_BUFFER_SIZE);
+    };
+
+    ~file_sink() override {
+        this->finish();
+    };
+
+    bool write(const char *data, size_t len) override {
+        return fwrite(data, 1, len, this->fs_file) == len;
+    };
+
+    bool finish() override {
+        if (this->fs_file == nullptr) {
+            return true;
+        }
+
+        bool retval = fclose(this->fs_file) == 0;
+
+        this->fs_file = nullptr;
+        return retval;
+    };
+
+private:
+    FILE *fs_file;
+};
+
+class gzip_sink : public export_sink {
+public:
+    explicit gzip_sink(gzFile file) : gs_file(file) {
+        gzbuffer(this->gs_file, EXPORT_BUFFER_SIZE);
+    };
+
+    ~gzip_sink() override {
+        this->finish();
+    };
+
+    bool write(const char *data, size_t len) override {
+        return gzwrite(this->gs_file, data, len) == (int) len;
+    };
+
+    bool finish() override {
+        if (this->gs_file == nullptr) {
+            return true;
+        }
+
+        bool retval = gzclose(this->gs_file) == Z_OK;
+
+        this->gs_file = nullptr;
+        return retval;
+    };
+
+private:
+    gzFile gs_file;
+};
+
+#ifdef HAVE_ZSTD_H
+class zstd_sink : public export_sink {
+public:
+    explicit zstd_sink(FILE *file)
+        : zs_file(file),
+          zs_stream(ZSTD_createCStream()),
+          zs_out(ZSTD_CStreamOutSize()) {
+        ZSTD_initCStream(this->zs_stream, 3);
+        setvbuf(this->zs_file, nullptr, _IOFBF, EXPORT_BUFFER_SIZE);
+    };
+
+    ~zstd_sink() override {
+        this->finish();
+        ZSTD_freeCStream(this->zs_stream);
+    };
+
+    bool write(const char *data, size_t len) override {
+        ZSTD_inBuffer in = {data, len, 0};
+
+        while (in.pos < in.size) {
+            ZSTD_outBuffer out = {this->zs_out.data(), this->zs_out.size(), 0};
+            auto rc = ZSTD_compressStream(this->zs_stream, &out, &in);
+
+            if (ZSTD_isError(rc) || !this->write_out(out)) {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    bool finish() override {
+        if (this->zs_file == nullptr) {
+            return true;
+        }
+
+        bool retval = true;
+        size_t remaining;
+
+        do {
+            ZSTD_outBuffer out = {this->zs_out.data(), this->zs_out.size(), 0};
+
+            remaining = ZSTD_endStream(this->zs_stream, &out);
+            if (ZSTD_isError(remaining) || !this->write_out(out)) {
+                retval = false;
+                break;
+            }
+        } while (remaining > 0);
+
+        if (fclose(this->zs_file) != 0) {
+            retval = false;
+        }
+        this->zs_file = nullptr;
+
+        return retval;
+    };
+
+private:
+    bool write_out(const ZSTD_outBuffer &out) {
+        return fwrite(out.dst, 1, out.pos, this->zs_file) == out.pos;
+    };
+
+    FILE *zs_file;
+    ZSTD_CStream *zs_stream;
+    vector<char> zs_out;
+};
+#endif
+
+bool csv_needs_quoting(const char *str, size_t len)
+{
+    for (size_t lpc = 0; lpc < len; lpc++) {
+        switch (str[lpc]) {
+            case ',':
+            case '"':
+            case '\n':
+            case '\r':
+                return true;
+        }
+    }
+
+    return false;
+}
+
+void csv_append(string &dst, const char *str, size_t len)
+{
+    if (!csv_needs_quoting(str, len)) {
+        dst.append(str, len);
+        return;
+    }
+
+    dst.push_back('"');
+    for (size_t lpc = 0; lpc < len; lpc++) {
+        if (str[lpc] == '"') {
+            dst.push_back('"');
+        }
+        dst.push_back(str[lpc]);
+    }
+    dst.push_back('"');
+}
+
+}
+
+Result<shared_ptr<sql_exporter>, string> sql_exporter::create(
+    const string &path)
+{
+    string base = path;
+    string compression;
+    format_t format;
+
+    if (endswith(base.c_str(), ".gz")) {
+        compression = "gz";
+        base.resize(base.size() - 3);
+    } else if (endswith(base.c_str(), ".zst")) {
+        compression = "zst";
+        base.resize(base.size() - 4);
+    }
+
+    if (endswith(base.c_str(), ".db") || endswith(base.c_str(), ".sqlite")) {
+        if (!compression.empty()) {
+            return Err(string("SQLite exports cannot be compressed"));
+        }
+
+        sqlite3 *db = nullptr;
+
+        // The export replaces the file, like the other formats do.
+        if (unlink(path.c_str()) == -1 && errno != ENOENT) {
+            return Err(string("unable to remove file -- ") + strerror(errno));
+        }
+        if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+            string errmsg = db == nullptr ? "out of memory" :
+                            sqlite3_errmsg(db);
+
+            sqlite3_close(db);
+            return Err("unable to open database -- " + errmsg);
+        }
+
+        return Ok(make_shared<sql_exporter>(db));
+    }
+
+    if (endswith(base.c_str(), ".parquet")) {
+        if (!compression.empty()) {
+            return Err(string("Parquet exports are already compressed"));
+        }
+
+        auto file = fopen(path.c_str(), "w");
+
+        if (file == nullptr) {
+            return Err(string("unable to open file -- ") + strerror(errno));
+        }
+
+        return Ok(make_shared<sql_exporter>(
+            make_unique<parquet_writer>(file)));
+    }
+
+    if (endswith(base.c_str(), ".csv")) {
+        format = format_t::CSV;
+    } else if (endswith(base.c_str(), ".json")) {
+        format = format_t::JSON;
+    } else if (endswith(base.c_str(), ".jsonl")) {
+        format = format_t::JSON_LINES;
+    } else {
+        return Err(string("unknown file extension, expecting .csv, .json, "
+                          ".jsonl, .db or .parquet"));
+    }
+
+    unique_ptr<export_sink> sink;
+
+    if (compression == "gz") {
+        auto gz = gzopen(path.c_str(), "wb");
+
+        if (gz == nullptr) {
+            return Err(string("unable to open file -- ") + strerror(errno));
+        }
+        sink = make_unique<gzip_sink>(gz);
+    } else if (compression == "zst") {
+#ifdef HAVE_ZSTD_H
+        auto file = fopen(path.c_str(), "w");
+
+        if (file == nullptr) {
+            return Err(string("unable to open file -- ") + strerror(errno));
+        }
+        sink = make_unique<zstd_sink>(file);
+#else
+        return Err(string("zstd support is not available"));
+#endif
+    } else {
+        auto file = fopen(path.c_str(), "w");
+
+        if (file == nullptr) {
+            return Err(string("unable to open file -- ") + strerror(errno));
+        }
+        sink = make_unique<file_sink>(file);
+    }
+
+    return Ok(make_shared<sql_exporter>(format, std::move(sink)));
+}
+
+sql_exporter::sql_exporter(format_t format, unique_ptr<export_sink> sink)
+    : se_format(format), se_sink(std::move(sink))
+{
+    if (this->se_format == format_t::JSON) {
+        yajl_gen_config(this->se_gen, yajl_gen_beautify, 1);
+        yajl_gen_array_open(this->se_gen);
+    }
+}
+
+sql_exporter::sql_exporter(sqlite3 *db)
+    : se_format(format_t::SQLITE)
+{
+    this->se_db = db;
+    // The file is being written from scratch, so there is nothing to
+    // recover if lnav stops part of the way through.
+    sqlite3_exec(db,
+                 "PRAGMA journal_mode = OFF; "
+                 "PRAGMA synchronous = OFF; "
+                 "BEGIN TRANSACTION",
+                 nullptr, nullptr, nullptr);
+}
+
+sql_exporter::sql_exporter(unique_ptr<parquet_writer> writer)
+    : se_format(format_t::PARQUET), se_parquet(std::move(writer))
+{
+}
+
+sql_exporter::~sql_exporter()
+{
+    if (se_active == this) {
+        se_active = nullptr;
+    }
+}
+
+void sql_exporter::write_header(sqlite3_stmt *stmt)
+{
+    if (this->se_format != format_t::CSV) {
+        return;
+    }
+
+    int ncols = sqlite3_column_count(stmt);
+
+    for (int lpc = 0; lpc < ncols; lpc++) {
+        const char *name = sqlite3_column_name(stmt, lpc);
+
+        if (lpc > 0) {
+            this->se_buffer.push_back(',');
+        }
+        csv_append(this->se_buffer, name, strlen(name));
+    }
+    this->se_buffer.push_back('\n');
+}
+
+void sql_exporter::write_csv_row(sqlite3_stmt *stmt)
+{
+    int ncols = sqlite3_column_count(stmt);
+
+    for (int lpc = 0; lpc < ncols; lpc++) {
+        if (lpc > 0) {
+            this->se_buffer.push_back(',');
+        }
+        if (sqlite3_column_type(stmt, lpc) == SQLITE_NULL) {
+            continue;
+        }
+
+        auto value = (const char *) sqlite3_column_text(stmt, lpc);
+        auto len = sqlite3_column_bytes(stmt, lpc);
+
+        csv_append(this->se_buffer, value, len);
+    }
+    this->se_buffer.push_back('\n');
+}
+
+void sql_exporter::write_json_row(sqlite3_stmt *stmt)
+{
+    int ncols = sqlite3_column_count(stmt);
+    yajl_gen gen = this->se_gen;
+
+    {
+        yajlpp_map obj_map(gen);
+
+        for (int lpc = 0; lpc < ncols; lpc++) {
+            sqlite3_value *raw_value = sqlite3_column_value(stmt, lpc);
+
+            obj_map.gen(sqlite3_column_name(stmt, lpc));
+            switch (sqlite3_value_type(raw_value)) {
+                case SQLITE_NULL:
+                    obj_map.gen();
+                    break;
+                case SQLITE_INTEGER:
+                case SQLITE_FLOAT: {
+                    auto value = (const char *) sqlite3_value_text(raw_value);
+
+                    yajl_gen_number(gen, value, strlen(value));
+                    break;
+                }
+                case SQLITE_TEXT: {
+                    auto value = (const char *) sqlite3_value_text(raw_value);
+                    size_t len = sqlite3_value_bytes(raw_value);
+
+                    if (sqlite3_value_subtype(raw_value) == JSON_SUBTYPE) {
+                        auto_mem<yajl_handle_t> parse_handle(yajl_free);
+                        json_ptr jp("");
+                        json_op jo(jp);
+
+                        // Embed JSON values instead of quoting them.
+                        jo.jo_ptr_callbacks = json_op::gen_callbacks;
+                        jo.jo_ptr_data = gen;
+                        parse_handle.reset(yajl_alloc(
+                            &json_op::ptr_callbacks, nullptr, &jo));
+                        if (yajl_parse(parse_handle.in(),
+                                       (const unsigned char *) value,
+                                       len) == yajl_status_ok &&
+                            yajl_complete_parse(parse_handle.in()) ==
+                            yajl_status_ok) {
+                            break;
+                        }
+                        log_error("unable to parse JSON cell: %s", value);
+                    }
+                    obj_map.gen(string(value, len));
+                    break;
+                }
+                default:
+                    obj_map.gen((const char *) sqlite3_value_text(raw_value));
+                    break;
+            }
+        }
+    }
+
+    const unsigned char *buf;
+    size_t len;
+
+    yajl_gen_get_buf(gen, &buf, &len);
+    this->se_buffer.append((const char *) buf, len);
+    yajl_gen_clear(gen);
+    if (this->se_format == format_t::JSON_LINES) {
+        this->se_buffer.push_back('\n');
+        yajl_gen_reset(gen, nullptr);
+    }
+}
+
+bool sql_exporter::create_table(sqlite3_stmt *stmt)
+{
+    int ncols = sqlite3_column_count(stmt);
+    string create_sql = "CREATE TABLE export (";
+    string insert_sql = "INSERT INTO export VALUES (";
+
+    for (int lpc = 0; lpc < ncols; lpc++) {
+        auto_mem<char> name;
+        const char *decl_type = sqlite3_column_decltype(stmt, lpc);
+
+        name = sql_quote_ident(sqlite3_column_name(stmt, lpc));
+        if (lpc > 0) {
+            create_sql.append(", ");
+            insert_sql.append(", ");
+        }
+        create_sql.append(name.in());
+        if (decl_type == nullptr) {
+            // Expressions do not have a declared type, so go by the value
+            // in the first row.
+            switch (sqlite3_column_type(stmt, lpc)) {
+                case SQLITE_INTEGER:
+                    decl_type = "INTEGER";
+                    break;
+                case SQLITE_FLOAT:
+                    decl_type = "REAL";
+                    break;
+                case SQLITE_TEXT:
+                    decl_type = "TEXT";
+                    break;
+            }
+        }
+        if (decl_type != nullptr) {
+            create_sql.append(" ");
+            create_sql.append(decl_type);
+        }
+        insert_sql.append("?");
+    }
+    create_sql.append(")");
+    insert_sql.append(")");
+
+    if (sqlite3_exec(this->se_db.in(), create_sql.c_str(),
+                     nullptr, nullptr, nullptr) != SQLITE_OK ||
+        sqlite3_prepare_v2(this->se_db.in(),
+                           insert_sql.c_str(),
+                           insert_sql.size(),
+                           this->se_insert.out(),
+                           nullptr) != SQLITE_OK) {
+        log_error("unable to create export table: %s",
+                  sqlite3_errmsg(this->se_db.in()));
+        return false;
+    }
+
+    return true;
+}
+
+void sql_exporter::write_sqlite_row(sqlite3_stmt *stmt)
+{
+    int ncols = sqlite3_column_count(stmt);
+    sqlite3_stmt *insert = this->se_insert.in();
+
+    // The values are copied as they are, so the types are kept.
+    for (int lpc = 0; lpc < ncols; lpc++) {
+        sqlite3_bind_value(insert, lpc + 1, sqlite3_column_value(stmt, lpc));
+    }
+    if (sqlite3_step(insert) != SQLITE_DONE) {
+        log_error("unable to insert export row: %s",
+                  sqlite3_errmsg(this->se_db.in()));
+        this->se_failed = true;
+    }
+    sqlite3_reset(insert);
+}
+
+int sql_exporter::write_row(sqlite3_stmt *stmt)
+{
+    if (this->se_failed) {
+        return 1;
+    }
+
+    if (!this->se_header_written) {
+        this->se_header_written = true;
+        if (this->se_format == format_t::SQLITE) {
+            if (!this->create_table(stmt)) {
+                this->se_failed = true;
+                return 1;
+            }
+        } else {
+            this->write_header(stmt);
+        }
+    }
+
+    switch (this->se_format) {
+        case format_t::CSV:
+            this->write_csv_row(stmt);
+            break;
+        case format_t::JSON:
+        case format_t::JSON_LINES:
+            this->write_json_row(stmt);
+            break;
+        case format_t::SQLITE:
+            this->write_sqlite_row(stmt);
+            if (this->se_failed) {
+                return 1;
+            }
+            break;
+        case format_t::PARQUET:
+            if (!this->se_parquet->write_row(stmt)) {
+                this->se_failed = true;
+                return 1;
+            }
+            break;
+    }
+    this->se_rows += 1;
+
+    if (this->se_buffer.size() >= EXPORT_BUFFER_SIZE) {
+        if (!this->se_sink->write(this->se_buffer.data(),
+                                  this->se_buffer.size())) {
+            this->se_failed = true;
+            return 1;
+        }
+        this->se_buffer.clear();
+    }
+
+    return 0;
+}
+
+Result<size_t, string> sql_exporter::finish()
+{
+    if (this->se_format == format_t::PARQUET) {
+        return this->se_parquet->finish();
+    }
+
+    if (this->se_format == format_t::SQLITE) {
+        this->se_insert.reset();
+        if (sqlite3_exec(this->se_db.in(), "COMMIT",
+                         nullptr, nullptr, nullptr) != SQLITE_OK) {
+            this->se_failed = true;
+        }
+        if (this->se_failed) {
+            string errmsg = sqlite3_errmsg(this->se_db.in());
+
+            this->se_db.reset();
+            return Err("unable to write database -- " + errmsg);
+        }
+        this->se_db.reset();
+
+        return Ok(this->se_rows);
+    }
+
+    if (this->se_format == format_t::JSON) {
+        const unsigned char *buf;
+        size_t len;
+
+        yajl_gen_array_close(this->se_gen);
+        yajl_gen_get_buf(this->se_gen, &buf, &len);
+        this->se_buffer.append((const char *) buf, len);
+        this->se_buffer.push_back('\n');
+    }
+
+    if (!this->se_failed &&
+        !this->se_sink->write(this->se_buffer.data(),
+                              this->se_buffer.size())) {
+        this->se_failed = true;
+    }
+    this->se_buffer.clear();
+
+    if (!this->se_sink->finish() || this->se_failed) {
+        return Err(string("unable to write file -- ") + strerror(errno));
+    }
+
+    return Ok(this->se_rows);
+}
+
+int sql_export_callback(exec_context &ec, sqlite3_stmt *stmt)
+{
+    if (!sqlite3_stmt_busy(stmt) || sql_exporter::se_active == nullptr) {
+        return 0;
+    }
+
+    return sql_exporter::se_active->write_row(stmt);
+}
@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file sql_export.hh
+ */
+
+#ifndef lnav_sql_export_hh
+#define lnav_sql_export_hh
+
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+
+#include <sqlite3.h>
+
+#include "auto_mem.hh"
+#include "base/result.h"
+#include "parquet_writer.hh"
+#include "sql_util.hh"
+#include "yajlpp/yajlpp.hh"
+
+struct exec_context;
+
+/**
+ * A destination for exported data that buffers large writes and,
+ * optionally, compresses them.
+ */
+class export_sink {
+public:
+    virtual ~export_sink() = default;
+
+    virtual bool write(const char *data, size_t len) = 0;
+
+    /** Flush any buffered data and close the destination. */
+    virtual bool finish() = 0;
+};
+
+/**
+ * Writes the rows of a query to a file as they are stepped, instead of
+ * collecting them in the DB view first, so the memory used is the same no
+ * matter how many rows there are.
+ */
+class sql_exporter {
+public:
+    enum class format_t {
+        CSV,
+        JSON,
+        JSON_LINES,
+        SQLITE,
+        PARQUET,
+    };
+
+    /**
+     * Create an exporter for the given file.  The format is picked from the
+     * extension: ".csv", ".json", ".jsonl", ".db" or ".parquet".  An extra
+     * ".gz" or ".zst" extension compresses the output of the text formats.
+     * A ".db" file is a SQLite database with the rows in a table named
+     * "export", which keeps the types of the values and can be read
+     * directly by other tools.  A ".parquet" file keeps the types as well
+     * and stores the values by column.
+     */
+    static Result<std::shared_ptr<sql_exporter>, std::string> create(
+        const std::string &path);
+
+    sql_exporter(format_t format, std::unique_ptr<export_sink> sink);
+
+    /** Create an exporter that inserts the rows into the given database. */
+    explicit sql_exporter(sqlite3 *db);
+
+    /** Create an exporter that writes the rows to a Parquet file. */
+    explicit sql_exporter(std::unique_ptr<parquet_writer> writer);
+
+    ~sql_exporter();
+
+    /** Write the current row of the statement. */
+    int write_row(sqlite3_stmt *stmt);
+
+    /**
+     * Finish writing the file.
+     *
+     * @return The number of rows written or an error message.
+     */
+    Result<size_t, std::string> finish();
+
+    size_t get_row_count() const {
+        return this->se_rows;
+    };
+
+    /**
+     * The exporter that sql_export_callback() writes to, the callback has
+     * no other way to find it.
+     */
+    static sql_exporter *se_active;
+
+private:
+    void write_header(sqlite3_stmt *stmt);
+
+    void write_csv_row(sqlite3_stmt *stmt);
+
+    void write_json_row(sqlite3_stmt *stmt);
+
+    /** Create the table for the rows and prepare the insert statement. */
+    bool create_table(sqlite3_stmt *stmt);
+
+    void write_sqlite_row(sqlite3_stmt *stmt);
+
+    format_t se_format;
+    std::unique_ptr<export_sink> se_sink;
+    bool se_header_written{false};
+    bool se_failed{false};
+    size_t se_rows{0};
+    std::string se_buffer;
+    yajlpp_gen se_gen;
+    auto_mem<sqlite3, sqlite_close_wrapper> se_db;
+    auto_mem<sqlite3_stmt> se_insert{sqlite3_finalize};
+    std::unique_ptr<parquet_writer> se_parquet;
+};
+
+/**
+ * A callback for execute_sql() that writes the rows to the active
+ * exporter.
+ */
+int sql_export_callback(exec_context &ec, sqlite3_stmt *stmt);
+
+#endif
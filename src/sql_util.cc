@@ -247,8 +247,92 @@ static int handle_db_list(void *ptr,
 struct table_list_data {
     struct sqlite_metadata_callbacks *tld_callbacks;
     db_table_map_t::iterator *        tld_iter;
+    std::map<std::string, std::string> tld_table_sql;
 };
 
+/**
+ * The rows returned by a pragma, kept so they can be fed to the callbacks
+ * again without running the pragma.
+ */
+struct cached_pragma {
+    std::vector<std::string> cp_names;
+    std::vector<std::vector<std::string>> cp_rows;
+    std::vector<std::vector<bool>> cp_nulls;
+};
+
+struct table_metadata {
+    std::string tm_sql;
+    cached_pragma tm_table_info;
+    cached_pragma tm_foreign_keys;
+};
+
+/** The metadata for tables, keyed by the DB and table name. */
+static std::map<std::pair<std::string, std::string>, table_metadata>
+    TABLE_METADATA;
+
+struct pragma_capture {
+    sqlite_exec_callback pc_callback;
+    struct sqlite_metadata_callbacks *pc_smc;
+    cached_pragma *pc_out;
+};
+
+static int capture_pragma_row(void *ptr,
+                              int ncols,
+                              char **colvalues,
+                              char **colnames)
+{
+    auto *pc = (struct pragma_capture *) ptr;
+    std::vector<std::string> row;
+    std::vector<bool> nulls;
+
+    if (pc->pc_out->cp_names.empty()) {
+        pc->pc_out->cp_names.assign(colnames, colnames + ncols);
+    }
+    for (int lpc = 0; lpc < ncols; lpc++) {
+        nulls.push_back(colvalues[lpc] == nullptr);
+        row.emplace_back(colvalues[lpc] == nullptr ? "" : colvalues[lpc]);
+    }
+    pc->pc_out->cp_rows.emplace_back(std::move(row));
+    pc->pc_out->cp_nulls.emplace_back(std::move(nulls));
+
+    return pc->pc_callback(pc->pc_smc, ncols, colvalues, colnames);
+}
+
+static int replay_pragma(const cached_pragma &cp,
+                         sqlite_exec_callback callback,
+                         struct sqlite_metadata_callbacks &smc)
+{
+    std::vector<char *> names, values;
+
+    for (const auto &name : cp.cp_names) {
+        names.push_back((char *) name.c_str());
+    }
+    for (size_t row = 0; row < cp.cp_rows.size(); row++) {
+        values.clear();
+        for (size_t col = 0; col < cp.cp_rows[row].size(); col++) {
+            values.push_back(cp.cp_nulls[row][col] ?
+                             nullptr : (char *) cp.cp_rows[row][col].c_str());
+        }
+        if (callback(&smc, values.size(), values.data(), names.data()) != 0) {
+            return SQLITE_ABORT;
+        }
+    }
+
+    return SQLITE_OK;
+}
+
+void sql_forget_table_metadata(const std::string &table_name)
+{
+    for (auto iter = TABLE_METADATA.begin(); iter != TABLE_METADATA.end();) {
+        if (iter->first.second == table_name) {
+            iter = TABLE_METADATA.erase(iter);
+        }
+        else {
+            ++iter;
+        }
+    }
+}
+
 static int handle_table_list(void *ptr,
                              int ncols,
                              char **colvalues,
@@ -257,6 +341,12 @@ static int handle_table_list(void *ptr,
     struct table_list_data *tld = (struct table_list_data *)ptr;
 
     (*tld->tld_iter)->second.push_back(colvalues[0]);
+    // Only the columns of tables are cached, views can change along with the
+    // tables they select from.
+    if (colvalues[1] != nullptr && colvalues[2] != nullptr &&
+        strcmp(colvalues[2], "table") == 0) {
+        tld->tld_table_sql[colvalues[0]] = colvalues[1];
+    }
 
     return tld->tld_callbacks->smc_table_list(tld->tld_callbacks,
                                               ncols,
@@ -295,7 +385,7 @@ int walk_sqlite_metadata(sqlite3 *db, struct sqlite_metadata_callbacks &smc)
         struct table_list_data       tld = { &smc, &iter };
         auto_mem<char, sqlite3_free> query;
 
-        query = sqlite3_mprintf("SELECT name,sql FROM %Q.sqlite_master "
+        query = sqlite3_mprintf("SELECT name,sql,type FROM %Q.sqlite_master "
                                 "WHERE type in ('table', 'view')",
                                 iter->first.c_str());
 
@@ -314,6 +404,52 @@ int walk_sqlite_metadata(sqlite3 *db, struct sqlite_metadata_callbacks &smc)
              ++table_iter) {
             auto_mem<char, sqlite3_free> table_query;
             std::string &table_name = *table_iter;
+            auto sql_iter = tld.tld_table_sql.find(table_name);
+            auto cache_key = std::make_pair(iter->first, table_name);
+            table_metadata *tm = nullptr;
+
+            if (sql_iter != tld.tld_table_sql.end()) {
+                auto cache_iter = TABLE_METADATA.find(cache_key);
+
+                if (cache_iter != TABLE_METADATA.end() &&
+                    cache_iter->second.tm_sql == sql_iter->second) {
+                    retval = replay_pragma(cache_iter->second.tm_table_info,
+                                           smc.smc_table_info,
+                                           smc);
+                    if (retval == SQLITE_OK) {
+                        retval = replay_pragma(
+                            cache_iter->second.tm_foreign_keys,
+                            smc.smc_foreign_key_list,
+                            smc);
+                    }
+                    if (retval != SQLITE_OK) {
+                        return retval;
+                    }
+                    continue;
+                }
+
+                tm = &TABLE_METADATA[cache_key];
+                *tm = table_metadata();
+                tm->tm_sql = sql_iter->second;
+            }
+
+            struct pragma_capture table_info_capture = {
+                smc.smc_table_info, &smc, tm ? &tm->tm_table_info : nullptr,
+            };
+            struct pragma_capture foreign_key_capture = {
+                smc.smc_foreign_key_list,
+                &smc,
+                tm ? &tm->tm_foreign_keys : nullptr,
+            };
+            sqlite_exec_callback table_info_cb = smc.smc_table_info;
+            sqlite_exec_callback foreign_key_cb = smc.smc_foreign_key_list;
+            void *table_info_ptr = &smc, *foreign_key_ptr = &smc;
+
+            if (tm != nullptr) {
+                table_info_cb = foreign_key_cb = capture_pragma_row;
+                table_info_ptr = &table_info_capture;
+                foreign_key_ptr = &foreign_key_capture;
+            }
 
             table_query = sqlite3_mprintf(
                 "pragma %Q.table_info(%Q)",
@@ -325,11 +461,12 @@ int walk_sqlite_metadata(sqlite3 *db, struct sqlite_metadata_callbacks &smc)
 
             retval = sqlite3_exec(db,
                                   table_query,
-                                  smc.smc_table_info,
-                                  &smc,
+                                  table_info_cb,
+                                  table_info_ptr,
                                   errmsg.out());
             if (retval != SQLITE_OK) {
                 log_error("could not get table info -- %s", errmsg.in());
+                TABLE_METADATA.erase(cache_key);
                 return retval;
             }
 
@@ -343,11 +480,12 @@ int walk_sqlite_metadata(sqlite3 *db, struct sqlite_metadata_callbacks &smc)
 
             retval = sqlite3_exec(db,
                                   table_query,
-                                  smc.smc_foreign_key_list,
-                                  &smc,
+                                  foreign_key_cb,
+                                  foreign_key_ptr,
                                   errmsg.out());
             if (retval != SQLITE_OK) {
                 log_error("could not get foreign key list -- %s", errmsg.in());
+                TABLE_METADATA.erase(cache_key);
                 return retval;
             }
         }
@@ -764,6 +902,58 @@ void sql_execute_script(sqlite3 *db,
     }
 }
 
+static size_t SCHEMA_GENERATION = 0;
+
+void sql_stmt_cache::schema_changed()
+{
+    SCHEMA_GENERATION += 1;
+}
+
+int sql_stmt_cache::prepare(sqlite3 *db,
+                            const std::string &sql,
+                            std::shared_ptr<sqlite3_stmt> &stmt_out)
+{
+    if (this->ssc_db != db ||
+        this->ssc_schema_generation != SCHEMA_GENERATION) {
+        this->ssc_cache.clear();
+        this->ssc_db = db;
+        this->ssc_schema_generation = SCHEMA_GENERATION;
+    }
+
+    auto *cached = this->ssc_cache.find(sql);
+
+    if (cached != nullptr) {
+        stmt_out = std::move(*cached);
+        this->ssc_cache.erase(sql);
+        return SQLITE_OK;
+    }
+
+    sqlite3_stmt *stmt = nullptr;
+    int retcode = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+
+    if (stmt == nullptr) {
+        stmt_out.reset();
+    } else {
+        stmt_out = std::shared_ptr<sqlite3_stmt>(stmt, sqlite3_finalize);
+    }
+
+    return retcode;
+}
+
+void sql_stmt_cache::release(const std::string &sql,
+                             std::shared_ptr<sqlite3_stmt> stmt)
+{
+    if (stmt == nullptr ||
+        sqlite3_db_handle(stmt.get()) != this->ssc_db ||
+        this->ssc_schema_generation != SCHEMA_GENERATION) {
+        return;
+    }
+
+    sqlite3_reset(stmt.get());
+    sqlite3_clear_bindings(stmt.get());
+    this->ssc_cache.insert(sql, std::move(stmt));
+}
+
 static struct {
     int sqlite_type;
     const char *collator;
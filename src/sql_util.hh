@@ -38,10 +38,12 @@
 #include <sqlite3.h>
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "attr_line.hh"
+#include "base/lru_cache.hh"
 
 extern const char *sql_keywords[122];
 extern const char *sql_function_names[];
@@ -60,8 +62,19 @@ struct sqlite_metadata_callbacks {
     db_table_map_t       smc_db_list;
 };
 
+/**
+ * Walk the databases, tables, and columns in the given DB.  The table_info
+ * and foreign_key_list results for tables are cached until the DDL for the
+ * table changes, so repeated walks do not need to query every table again.
+ */
 int walk_sqlite_metadata(sqlite3 *db, struct sqlite_metadata_callbacks &smc);
 
+/**
+ * Drop the cached metadata for a table whose columns can change without a
+ * change to its DDL, like a virtual table that is being recreated.
+ */
+void sql_forget_table_metadata(const std::string &table_name);
+
 void dump_sqlite_schema(sqlite3 *db, std::string &schema_out);
 
 void attach_sqlite_db(sqlite3 *db, const std::string &filename);
@@ -98,6 +111,57 @@ void sql_execute_script(sqlite3 *db,
                         const char *script,
                         std::vector<std::string> &errors);
 
+/**
+ * Keeps the statements that have been prepared recently so that scripts
+ * that run the same queries over and over do not have to prepare them
+ * each time.  A statement is taken out of the cache while it is in use,
+ * so a query that is run again while it is still executing gets a
+ * statement of its own.
+ */
+class sql_stmt_cache {
+public:
+    static const size_t DEFAULT_MAX_ENTRIES = 32;
+
+    explicit sql_stmt_cache(size_t max_entries = DEFAULT_MAX_ENTRIES)
+        : ssc_cache(max_entries) {
+    };
+
+    /**
+     * Note that tables were created or dropped, the statements in every
+     * cache are thrown away the next time they are used.
+     */
+    static void schema_changed();
+
+    /**
+     * Take a statement for the given SQL out of the cache or prepare a new
+     * one.
+     *
+     * @param db The database to prepare the statement for.
+     * @param sql The text of a single statement.
+     * @param stmt_out The statement, which is null if the text was empty.
+     * @return The result of sqlite3_prepare_v2() or SQLITE_OK if the
+     *   statement was in the cache.
+     */
+    int prepare(sqlite3 *db,
+                const std::string &sql,
+                std::shared_ptr<sqlite3_stmt> &stmt_out);
+
+    /**
+     * Reset a statement that was returned by prepare() and put it back in
+     * the cache.
+     */
+    void release(const std::string &sql, std::shared_ptr<sqlite3_stmt> stmt);
+
+    void clear() {
+        this->ssc_cache.clear();
+    };
+
+private:
+    lru_cache<std::string, std::shared_ptr<sqlite3_stmt>> ssc_cache;
+    sqlite3 *ssc_db{nullptr};
+    size_t ssc_schema_generation{0};
+};
+
 int guess_type_from_pcre(const std::string &pattern, const char **collator);
 
 /* XXX figure out how to do this with the template */
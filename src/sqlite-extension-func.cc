@@ -46,6 +46,7 @@ sqlite_registration_func_t sqlite_registration_funcs[] = {
     state_extension_functions,
     string_extension_functions,
     network_extension_functions,
+    sketch_extension_functions,
     fs_extension_functions,
     json_extension_functions,
     time_extension_functions,
@@ -73,6 +73,9 @@ int string_extension_functions(struct FuncDef **basic_funcs,
 int network_extension_functions(struct FuncDef **basic_funcs,
                                 struct FuncDefAgg **agg_funcs);
 
+int sketch_extension_functions(struct FuncDef **basic_funcs,
+                               struct FuncDefAgg **agg_funcs);
+
 int fs_extension_functions(struct FuncDef **basic_funcs,
                            struct FuncDefAgg **agg_funcs);
 
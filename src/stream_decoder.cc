@@ -0,0 +1,415 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file stream_decoder.cc
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <zlib.h>
+
+#ifdef HAVE_BZLIB_H
+#include <bzlib.h>
+#endif
+
+#ifdef HAVE_ZSTD_H
+#include <zstd.h>
+#endif
+
+#ifdef HAVE_LZMA_H
+#include <lzma.h>
+#endif
+
+#include <algorithm>
+#include <new>
+
+#include "base/lnav_log.hh"
+#include "stream_decoder.hh"
+
+using namespace std;
+
+static const size_t DECODE_CHUNK_SIZE = 128 * 1024;
+
+/**
+ * Grow the output vector by a chunk for the decoder to write into.
+ *
+ * @return The offset of the new chunk.
+ */
+static size_t grow_output(vector<char> &out)
+{
+    size_t retval = out.size();
+
+    out.resize(retval + DECODE_CHUNK_SIZE);
+
+    return retval;
+}
+
+class gzip_stream_decoder : public stream_decoder {
+public:
+    gzip_stream_decoder() {
+        memset(&this->gsd_stream, 0, sizeof(this->gsd_stream));
+        // Accept both gzip and zlib headers.
+        if (inflateInit2(&this->gsd_stream, 15 + 32) != Z_OK) {
+            throw bad_alloc();
+        }
+    };
+
+    ~gzip_stream_decoder() override {
+        inflateEnd(&this->gsd_stream);
+    };
+
+    const char *get_name() const override {
+        return "gzip";
+    };
+
+    bool decode(const char *in, size_t len, vector<char> &out) override {
+        this->gsd_stream.next_in = (Bytef *) in;
+        this->gsd_stream.avail_in = len;
+        do {
+            size_t off = grow_output(out);
+
+            this->gsd_stream.next_out = (Bytef *) &out[off];
+            this->gsd_stream.avail_out = DECODE_CHUNK_SIZE;
+
+            int rc = inflate(&this->gsd_stream, Z_NO_FLUSH);
+
+            out.resize(off + DECODE_CHUNK_SIZE - this->gsd_stream.avail_out);
+            if (rc == Z_STREAM_END) {
+                // Members can be concatenated, like with 'gzip -c a b'.
+                inflateReset(&this->gsd_stream);
+            } else if (rc == Z_BUF_ERROR) {
+                break;
+            } else if (rc != Z_OK) {
+                log_error("unable to inflate stream -- %s",
+                          this->gsd_stream.msg != nullptr ?
+                          this->gsd_stream.msg : "unknown error");
+                return false;
+            }
+        } while (this->gsd_stream.avail_in > 0 ||
+                 this->gsd_stream.avail_out == 0);
+
+        return true;
+    };
+
+private:
+    z_stream gsd_stream;
+};
+
+#ifdef HAVE_BZLIB_H
+class bzip2_stream_decoder : public stream_decoder {
+public:
+    bzip2_stream_decoder() {
+        this->init();
+    };
+
+    ~bzip2_stream_decoder() override {
+        BZ2_bzDecompressEnd(&this->bsd_stream);
+    };
+
+    const char *get_name() const override {
+        return "bzip2";
+    };
+
+    bool decode(const char *in, size_t len, vector<char> &out) override {
+        this->bsd_stream.next_in = (char *) in;
+        this->bsd_stream.avail_in = len;
+        do {
+            size_t off = grow_output(out);
+
+            this->bsd_stream.next_out = &out[off];
+            this->bsd_stream.avail_out = DECODE_CHUNK_SIZE;
+
+            int rc = BZ2_bzDecompress(&this->bsd_stream);
+
+            out.resize(off + DECODE_CHUNK_SIZE - this->bsd_stream.avail_out);
+            if (rc == BZ_STREAM_END) {
+                // Streams can be concatenated, like with 'pbzip2'.
+                BZ2_bzDecompressEnd(&this->bsd_stream);
+                this->init();
+            } else if (rc != BZ_OK) {
+                log_error("unable to decompress bzip2 stream -- %d", rc);
+                return false;
+            }
+        } while (this->bsd_stream.avail_in > 0 ||
+                 this->bsd_stream.avail_out == 0);
+
+        return true;
+    };
+
+private:
+    void init() {
+        memset(&this->bsd_stream, 0, sizeof(this->bsd_stream));
+        if (BZ2_bzDecompressInit(&this->bsd_stream, 0, 0) != BZ_OK) {
+            throw bad_alloc();
+        }
+    };
+
+    bz_stream bsd_stream;
+};
+#endif
+
+#ifdef HAVE_ZSTD_H
+class zstd_stream_decoder : public stream_decoder {
+public:
+    zstd_stream_decoder() {
+        this->zsd_ctx = ZSTD_createDCtx();
+        if (this->zsd_ctx == nullptr) {
+            throw bad_alloc();
+        }
+    };
+
+    ~zstd_stream_decoder() override {
+        ZSTD_freeDCtx(this->zsd_ctx);
+    };
+
+    const char *get_name() const override {
+        return "zstd";
+    };
+
+    bool decode(const char *in, size_t len, vector<char> &out) override {
+        ZSTD_inBuffer input = {in, len, 0};
+        bool full;
+
+        // Multiple frames are decoded one after the other by the context.
+        do {
+            size_t off = grow_output(out);
+            ZSTD_outBuffer output = {&out[off], DECODE_CHUNK_SIZE, 0};
+            size_t rc = ZSTD_decompressStream(this->zsd_ctx, &output, &input);
+
+            out.resize(off + output.pos);
+            if (ZSTD_isError(rc)) {
+                log_error("unable to decompress zstd stream -- %s",
+                          ZSTD_getErrorName(rc));
+                return false;
+            }
+            full = output.pos == output.size;
+        } while (input.pos < input.size || full);
+
+        return true;
+    };
+
+private:
+    ZSTD_DCtx *zsd_ctx;
+};
+#endif
+
+#ifdef HAVE_LZMA_H
+class xz_stream_decoder : public stream_decoder {
+public:
+    xz_stream_decoder() {
+        if (lzma_stream_decoder(&this->xsd_stream,
+                                UINT64_MAX,
+                                LZMA_CONCATENATED) != LZMA_OK) {
+            throw bad_alloc();
+        }
+    };
+
+    ~xz_stream_decoder() override {
+        lzma_end(&this->xsd_stream);
+    };
+
+    const char *get_name() const override {
+        return "xz";
+    };
+
+    bool decode(const char *in, size_t len, vector<char> &out) override {
+        this->xsd_stream.next_in = (const uint8_t *) in;
+        this->xsd_stream.avail_in = len;
+        do {
+            size_t off = grow_output(out);
+
+            this->xsd_stream.next_out = (uint8_t *) &out[off];
+            this->xsd_stream.avail_out = DECODE_CHUNK_SIZE;
+
+            lzma_ret rc = lzma_code(&this->xsd_stream, LZMA_RUN);
+
+            out.resize(off + DECODE_CHUNK_SIZE - this->xsd_stream.avail_out);
+            if (rc == LZMA_BUF_ERROR) {
+                break;
+            }
+            if (rc != LZMA_OK && rc != LZMA_STREAM_END) {
+                log_error("unable to decompress xz stream -- %d", rc);
+                return false;
+            }
+        } while (this->xsd_stream.avail_in > 0 ||
+                 this->xsd_stream.avail_out == 0);
+
+        return true;
+    };
+
+private:
+    lzma_stream xsd_stream = LZMA_STREAM_INIT;
+};
+#endif
+
+unique_ptr<stream_decoder> stream_decoder::create(const unsigned char *header,
+                                                  size_t len)
+{
+    if (len >= 2 && header[0] == 0x1f && header[1] == 0x8b) {
+        return unique_ptr<stream_decoder>(new gzip_stream_decoder());
+    }
+#ifdef HAVE_BZLIB_H
+    if (len >= 3 && memcmp(header, "BZh", 3) == 0) {
+        return unique_ptr<stream_decoder>(new bzip2_stream_decoder());
+    }
+#endif
+#ifdef HAVE_ZSTD_H
+    static const unsigned char ZSTD_MAGIC[] = {0x28, 0xb5, 0x2f, 0xfd};
+
+    if (len >= sizeof(ZSTD_MAGIC) &&
+        memcmp(header, ZSTD_MAGIC, sizeof(ZSTD_MAGIC)) == 0) {
+        return unique_ptr<stream_decoder>(new zstd_stream_decoder());
+    }
+#endif
+#ifdef HAVE_LZMA_H
+    static const unsigned char XZ_MAGIC[] = {0xfd, '7', 'z', 'X', 'Z', 0x00};
+
+    if (len >= sizeof(XZ_MAGIC) &&
+        memcmp(header, XZ_MAGIC, sizeof(XZ_MAGIC)) == 0) {
+        return unique_ptr<stream_decoder>(new xz_stream_decoder());
+    }
+#endif
+
+    return nullptr;
+}
+
+bool stream_decoder::could_be_header(const unsigned char *header, size_t len)
+{
+    static const struct {
+        const char *m_bytes;
+        size_t m_len;
+    } MAGICS[] = {
+        {"\x1f\x8b", 2},
+        {"BZh", 3},
+        {"\x28\xb5\x2f\xfd", 4},
+        {"\xfd" "7zXZ\x00", 6},
+    };
+
+    for (const auto &magic : MAGICS) {
+        if (memcmp(header, magic.m_bytes, std::min(len, magic.m_len)) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool stream_filter::sniff(bool force)
+{
+    // Plain text is passed on as soon as it cannot be a compressed header,
+    // so a short partial line is not held back waiting for more data.
+    if (this->sf_header.size() < stream_decoder::HEADER_SIZE && !force &&
+        stream_decoder::could_be_header(
+            (const unsigned char *) this->sf_header.data(),
+            this->sf_header.size())) {
+        return true;
+    }
+
+    this->sf_sniffed = true;
+    this->sf_decoder = stream_decoder::create(
+        (const unsigned char *) this->sf_header.data(),
+        this->sf_header.size());
+
+    vector<char> header;
+
+    header.swap(this->sf_header);
+    if (this->sf_decoder == nullptr) {
+        this->sf_output.insert(this->sf_output.end(),
+                               header.begin(), header.end());
+        return true;
+    }
+
+    log_info("decoding %s compressed stream", this->sf_decoder->get_name());
+
+    return this->sf_decoder->decode(header.data(), header.size(),
+                                    this->sf_output);
+}
+
+bool stream_filter::push(const char *data, size_t len)
+{
+    if (!this->sf_sniffed) {
+        this->sf_header.insert(this->sf_header.end(), data, data + len);
+        return this->sniff(false);
+    }
+
+    if (this->sf_decoder == nullptr) {
+        this->sf_output.insert(this->sf_output.end(), data, data + len);
+        return true;
+    }
+
+    return this->sf_decoder->decode(data, len, this->sf_output);
+}
+
+bool stream_filter::finish()
+{
+    if (this->sf_sniffed) {
+        return true;
+    }
+
+    return this->sniff(true);
+}
+
+const char *stream_filter::get_decoder_name() const
+{
+    if (this->sf_decoder == nullptr) {
+        return nullptr;
+    }
+
+    return this->sf_decoder->get_name();
+}
+
+void stream_filter::consume(size_t len)
+{
+    require(len <= this->get_size());
+
+    this->sf_output_offset += len;
+    if (this->sf_output_offset == this->sf_output.size()) {
+        this->sf_output.clear();
+        this->sf_output_offset = 0;
+    }
+}
+
+size_t stream_filter::take(char *dst, size_t size)
+{
+    size_t retval = std::min(size, this->get_size());
+
+    memcpy(dst, this->get_data(), retval);
+    this->consume(retval);
+
+    return retval;
+}
+
+void stream_filter::reset()
+{
+    this->sf_sniffed = false;
+    this->sf_header.clear();
+    this->sf_decoder.reset();
+    this->sf_output.clear();
+    this->sf_output_offset = 0;
+}
@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file stream_decoder.hh
+ */
+
+#ifndef lnav_stream_decoder_hh
+#define lnav_stream_decoder_hh
+
+#include <sys/types.h>
+
+#include <memory>
+#include <vector>
+
+/**
+ * Decoder for compressed data that arrives as a stream, like through a pipe,
+ * and cannot be read with random access.  The decoded data is meant to be
+ * spilled to a plain file, so there is no need to record seek points.
+ */
+class stream_decoder {
+public:
+    /** The number of bytes needed to recognize a compressed stream. */
+    static const size_t HEADER_SIZE = 6;
+
+    /**
+     * Create a decoder for the given stream if it is in one of the
+     * supported formats.
+     *
+     * @param header The first bytes of the stream.
+     * @param len The number of bytes in the header.
+     * @return The decoder or nullptr if the data is not compressed.
+     */
+    static std::unique_ptr<stream_decoder> create(const unsigned char *header,
+                                                  size_t len);
+
+    /**
+     * @param header The first bytes of a stream, fewer than HEADER_SIZE.
+     * @param len The number of bytes in the header.
+     * @return True if the stream could still turn out to be compressed once
+     *   more of it is read.
+     */
+    static bool could_be_header(const unsigned char *header, size_t len);
+
+    virtual ~stream_decoder() = default;
+
+    virtual const char *get_name() const = 0;
+
+    /**
+     * Decode the next chunk of the stream.
+     *
+     * @param in The compressed data.
+     * @param len The number of bytes of compressed data.
+     * @param out The vector that the decoded data is appended to.
+     * @return False if the compressed data is corrupt.
+     */
+    virtual bool decode(const char *in, size_t len, std::vector<char> &out) = 0;
+};
+
+/**
+ * Passes the data read from a stream through a stream_decoder if the start
+ * of the stream turns out to be compressed.  Otherwise, the data is passed
+ * through as-is and the caller can skip the filter by checking
+ * is_passthrough().
+ */
+class stream_filter {
+public:
+    /**
+     * Add data that was read from the stream.
+     *
+     * @return False if the compressed data is corrupt.
+     */
+    bool push(const char *data, size_t len);
+
+    /**
+     * Called when the stream has ended to flush a header that was too short
+     * to be recognized.
+     */
+    bool finish();
+
+    /** @return True if the data does not need to go through the filter. */
+    bool is_passthrough() const {
+        return this->sf_sniffed &&
+               this->sf_decoder == nullptr &&
+               this->get_size() == 0;
+    };
+
+    const char *get_decoder_name() const;
+
+    /** @return The decoded data that has not been taken yet. */
+    const char *get_data() const {
+        return this->sf_output.data() + this->sf_output_offset;
+    };
+
+    size_t get_size() const {
+        return this->sf_output.size() - this->sf_output_offset;
+    };
+
+    /** Drop the given number of bytes from the front of the output. */
+    void consume(size_t len);
+
+    /**
+     * Move decoded data into the given buffer.
+     *
+     * @return The number of bytes copied.
+     */
+    size_t take(char *dst, size_t size);
+
+    void reset();
+
+private:
+    bool sniff(bool force);
+
+    bool sf_sniffed{false};
+    std::vector<char> sf_header;
+    std::unique_ptr<stream_decoder> sf_decoder;
+    std::vector<char> sf_output;
+    size_t sf_output_offset{0};
+};
+
+#endif
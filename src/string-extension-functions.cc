@@ -15,8 +15,7 @@
 #include <sqlite3.h>
 #include <pcrecpp.h>
 
-#include <unordered_map>
-
+#include "base/lru_cache.hh"
 #include "pcrepp/pcrepp.hh"
 
 #include "yajlpp/yajlpp.hh"
@@ -39,17 +38,19 @@ typedef struct {
     shared_ptr<pcrepp> re2;
 } cache_entry;
 
+static const size_t RE_CACHE_SIZE = 128;
+
 static cache_entry *find_re(const char *re)
 {
-    static unordered_map<string, cache_entry> CACHE;
+    static lru_cache<string, cache_entry> CACHE(RE_CACHE_SIZE);
 
     string re_str = re;
-    auto iter = CACHE.find(re_str);
+    auto *existing = CACHE.find(re_str);
 
-    if (iter == CACHE.end()) {
+    if (existing == nullptr) {
         cache_entry c;
 
-        c.re2 = make_shared<pcrepp>(re_str);
+        c.re2 = pcrepp::cached(re_str, PCRE_UTF8);
         c.re = make_shared<pcrecpp::RE>(re);
         if (!c.re->error().empty()) {
             auto_mem<char> e2(sqlite3_free);
@@ -57,12 +58,12 @@ static cache_entry *find_re(const char *re)
             e2 = sqlite3_mprintf("%s: %s", re, c.re->error().c_str());
             throw pcrepp::error(e2.in(), 0);
         }
-        CACHE[re_str] = c;
+        CACHE.insert(re_str, c);
 
-        iter = CACHE.find(re_str);
+        existing = CACHE.find(re_str);
     }
 
-    return &iter->second;
+    return existing;
 }
 
 static bool regexp(const char *re, const char *str)
@@ -40,7 +40,7 @@ struct clip_command {
     const char *cc_cmd[2];
 };
 
-static clip_command *get_commands()
+static clip_command *detect_commands()
 {
     static clip_command NEOVIM_CMDS[] = {
             { { "win32yank.exe -i --crlf > /dev/null 2>&1",
@@ -110,6 +110,17 @@ static clip_command *get_commands()
     return nullptr;
 }
 
+/**
+ * Finding the commands means running a few shell commands, so it is only
+ * done once.
+ */
+static clip_command *get_commands()
+{
+    static clip_command *retval = detect_commands();
+
+    return retval;
+}
+
 /* XXX For one, this code is kinda crappy.  For two, we should probably link
  * directly with X so we don't need to have xclip installed and it'll work if
  * we're ssh'd into a box.
@@ -0,0 +1,375 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file task_pool.cc
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include <algorithm>
+
+#include "base/lnav_log.hh"
+#include "lnav_config.hh"
+#include "task_pool.hh"
+
+using namespace std;
+
+/** The index of the worker running on this thread or -1. */
+static thread_local ssize_t current_worker = -1;
+
+/** The priority of the task running on this worker. */
+static thread_local task_pool::priority_t current_priority =
+    task_pool::priority_t::BACKGROUND;
+
+constexpr size_t task_pool::PRIORITY_COUNT;
+
+task_pool &task_pool::singleton()
+{
+    static task_pool retval;
+
+    return retval;
+}
+
+task_pool::task_pool()
+{
+    for (auto &pending : this->tp_pending_by_priority) {
+        pending = 0;
+    }
+
+#ifdef __linux__
+    this->tp_notify_read = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+    if (this->tp_notify_read == -1) {
+        auto_fd fds[2];
+
+        if (auto_fd::pipe(fds) == -1) {
+            log_error("unable to create task notification pipe -- %s",
+                      strerror(errno));
+            return;
+        }
+        log_perror(fcntl(fds[0], F_SETFL, O_NONBLOCK));
+        log_perror(fcntl(fds[1], F_SETFL, O_NONBLOCK));
+        fds[0].close_on_exec();
+        fds[1].close_on_exec();
+        this->tp_notify_read = std::move(fds[0]);
+        this->tp_notify_write = std::move(fds[1]);
+    }
+}
+
+task_pool::~task_pool()
+{
+    {
+        lock_guard<mutex> lg(this->tp_idle_mutex);
+
+        this->tp_stopping = true;
+        this->tp_idle_cond.notify_all();
+    }
+    for (auto &w : this->tp_workers) {
+        w->w_thread.join();
+    }
+}
+
+void task_pool::start()
+{
+    lock_guard<mutex> lg(this->tp_start_mutex);
+
+    if (this->tp_started) {
+        return;
+    }
+
+    size_t count = lnav_config.lc_tuning_thread_pool_size;
+
+    if (count == 0) {
+        count = std::max((size_t) 1,
+                         (size_t) std::thread::hardware_concurrency());
+    }
+
+    log_info("starting %zu task pool workers", count);
+    for (size_t lpc = 0; lpc < count; lpc++) {
+        this->tp_workers.emplace_back(make_unique<worker>());
+    }
+    for (size_t lpc = 0; lpc < count; lpc++) {
+        this->tp_workers[lpc]->w_thread =
+            std::thread(&task_pool::worker_loop, this, lpc);
+    }
+    this->tp_started = true;
+}
+
+size_t task_pool::get_worker_count()
+{
+    this->start();
+
+    return this->tp_workers.size();
+}
+
+void task_pool::submit(task t, priority_t prio)
+{
+    this->start();
+
+    size_t index = current_worker != -1 ?
+                   current_worker :
+                   this->tp_next_worker++ % this->tp_workers.size();
+    auto &w = *this->tp_workers[index];
+
+    {
+        lock_guard<mutex> lg(w.w_mutex);
+
+        w.w_tasks[(size_t) prio].emplace_back(std::move(t));
+        this->tp_pending_by_priority[(size_t) prio] += 1;
+        this->tp_pending += 1;
+    }
+
+    lock_guard<mutex> lg(this->tp_idle_mutex);
+
+    this->tp_idle_cond.notify_one();
+}
+
+void task_pool::submit(task t,
+                       task on_done,
+                       cancel_token ct,
+                       priority_t prio)
+{
+    this->submit([this, t = std::move(t), on_done = std::move(on_done), ct]() {
+        if (!ct.is_cancelled()) {
+            t();
+        }
+
+        {
+            lock_guard<mutex> lg(this->tp_done_mutex);
+
+            this->tp_done.emplace_back([on_done, ct]() {
+                if (!ct.is_cancelled()) {
+                    on_done();
+                }
+            });
+        }
+        this->notify_done();
+    }, prio);
+}
+
+bool task_pool::pop_task(size_t index, task &t, priority_t &prio_out)
+{
+    for (size_t prio = 0; prio < PRIORITY_COUNT; prio++) {
+        if (this->tp_pending_by_priority[prio] == 0) {
+            continue;
+        }
+
+        {
+            auto &w = *this->tp_workers[index];
+            lock_guard<mutex> lg(w.w_mutex);
+            auto &tasks = w.w_tasks[prio];
+
+            if (!tasks.empty()) {
+                t = std::move(tasks.back());
+                tasks.pop_back();
+                this->tp_pending_by_priority[prio] -= 1;
+                this->tp_pending -= 1;
+                prio_out = (priority_t) prio;
+                return true;
+            }
+        }
+
+        for (size_t lpc = 1; lpc < this->tp_workers.size(); lpc++) {
+            auto &victim = *this->tp_workers[(index + lpc) %
+                                             this->tp_workers.size()];
+            lock_guard<mutex> lg(victim.w_mutex);
+            auto &tasks = victim.w_tasks[prio];
+
+            if (!tasks.empty()) {
+                t = std::move(tasks.front());
+                tasks.pop_front();
+                this->tp_pending_by_priority[prio] -= 1;
+                this->tp_pending -= 1;
+                prio_out = (priority_t) prio;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool task_pool::should_yield() const
+{
+    if (current_worker == -1) {
+        return false;
+    }
+
+    for (size_t prio = 0; prio < (size_t) current_priority; prio++) {
+        if (this->tp_pending_by_priority[prio] > 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void task_pool::worker_loop(size_t index)
+{
+    current_worker = index;
+
+    while (!this->tp_stopping) {
+        task t;
+        priority_t prio;
+
+        if (this->pop_task(index, t, prio)) {
+            current_priority = prio;
+            t();
+            current_priority = priority_t::BACKGROUND;
+            continue;
+        }
+
+        unique_lock<mutex> ul(this->tp_idle_mutex);
+
+        this->tp_idle_cond.wait(ul, [this]() {
+            return this->tp_stopping || this->tp_pending > 0;
+        });
+    }
+}
+
+void task_pool::parallel_for(size_t count,
+                             const std::function<void(size_t)> &work,
+                             priority_t prio)
+{
+    size_t helpers = std::min(count, this->get_worker_count());
+
+    if (helpers < 2) {
+        for (size_t lpc = 0; lpc < count; lpc++) {
+            work(lpc);
+        }
+        return;
+    }
+
+    struct state {
+        const std::function<void(size_t)> *s_work;
+        size_t s_count;
+        std::atomic<size_t> s_next{0};
+        std::mutex s_mutex;
+        std::condition_variable s_cond;
+        size_t s_done{0};
+        exception_ptr s_error;
+    };
+
+    // The helpers that start late only look at the shared state, so it
+    // outlives this call while the work function does not need to.
+    auto st = make_shared<state>();
+
+    st->s_work = &work;
+    st->s_count = count;
+
+    auto run = [st]() {
+        size_t finished = 0;
+
+        for (size_t index = st->s_next++;
+             index < st->s_count;
+             index = st->s_next++) {
+            try {
+                (*st->s_work)(index);
+            } catch (...) {
+                lock_guard<mutex> lg(st->s_mutex);
+
+                if (!st->s_error) {
+                    st->s_error = current_exception();
+                }
+            }
+            finished += 1;
+        }
+
+        if (finished > 0) {
+            lock_guard<mutex> lg(st->s_mutex);
+
+            st->s_done += finished;
+            st->s_cond.notify_all();
+        }
+    };
+
+    for (size_t lpc = 1; lpc < helpers; lpc++) {
+        this->submit(run, prio);
+    }
+    run();
+
+    unique_lock<mutex> ul(st->s_mutex);
+
+    st->s_cond.wait(ul, [&st]() { return st->s_done == st->s_count; });
+    if (st->s_error) {
+        rethrow_exception(st->s_error);
+    }
+}
+
+void task_pool::notify_done()
+{
+    int fd = this->tp_notify_write != -1 ?
+             this->tp_notify_write.get() :
+             this->tp_notify_read.get();
+    // An eventfd needs eight bytes, the pipe does not care.
+    uint64_t value = 1;
+
+    if (fd == -1) {
+        return;
+    }
+
+    // A full pipe means the main loop has yet to drain it and will see
+    // the completions anyway.
+    if (write(fd, &value, sizeof(value)) == -1 && errno != EAGAIN) {
+        log_error("unable to notify main loop of finished tasks -- %s",
+                  strerror(errno));
+    }
+}
+
+size_t task_pool::run_completions()
+{
+    vector<task> done;
+    char buffer[64];
+
+    if (this->tp_notify_read != -1) {
+        while (read(this->tp_notify_read, buffer, sizeof(buffer)) > 0) {
+        }
+    }
+
+    {
+        lock_guard<mutex> lg(this->tp_done_mutex);
+
+        done.swap(this->tp_done);
+    }
+
+    for (auto &on_done : done) {
+        on_done();
+    }
+
+    return done.size();
+}
@@ -0,0 +1,196 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file task_pool.hh
+ */
+
+#ifndef lnav_task_pool_hh
+#define lnav_task_pool_hh
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "auto_fd.hh"
+
+/**
+ * A pool of worker threads that the parallel parts of lnav share, instead
+ * of each one starting its own threads.  Each worker has its own queue of
+ * tasks and takes the newest task from it first, so the tasks submitted by
+ * a task run while its data is still in the cache.  A worker with an empty
+ * queue steals the oldest task from the other workers.
+ *
+ * Tasks are queued in one of a few priority classes and a worker always
+ * takes a task from the most urgent class that has any, so the work for the
+ * screen does not wait behind bulk indexing.  A task that is already
+ * running is not interrupted, so long-running tasks should check
+ * should_yield() every so often and stop early when it returns true.
+ *
+ * Tasks that need to report back to the UI can have a completion callback
+ * that is run on the main thread.  A descriptor that is readable when there
+ * are completions waiting is included in the main poll() loop, which then
+ * calls run_completions().
+ */
+class task_pool {
+public:
+    using task = std::function<void()>;
+
+    /** The priority classes, from the most to the least urgent. */
+    enum class priority_t : int {
+        VIEWPORT,       /*< Work for what is currently on the screen. */
+        INTERACTIVE,    /*< Work the user is waiting on, like a query. */
+        BACKGROUND,     /*< Bulk work, like indexing files. */
+
+        MAX
+    };
+
+    /**
+     * A flag that is shared between a task and whoever submitted it, so the
+     * task can be skipped if it has not started or stop early if it checks
+     * the flag.
+     */
+    class cancel_token {
+    public:
+        cancel_token()
+            : ct_cancelled(std::make_shared<std::atomic<bool>>(false)) {
+        };
+
+        void cancel() {
+            this->ct_cancelled->store(true);
+        };
+
+        bool is_cancelled() const {
+            return this->ct_cancelled->load();
+        };
+
+    private:
+        std::shared_ptr<std::atomic<bool>> ct_cancelled;
+    };
+
+    static task_pool &singleton();
+
+    ~task_pool();
+
+    /**
+     * @return The number of worker threads, the workers are started the
+     * first time this is called.
+     */
+    size_t get_worker_count();
+
+    /** Queue a task to be run on one of the workers. */
+    void submit(task t, priority_t prio = priority_t::BACKGROUND);
+
+    /**
+     * Queue a task to be run on one of the workers and then call on_done
+     * from the main thread in run_completions().  Neither is called if the
+     * token is cancelled before they run.
+     */
+    void submit(task t,
+                task on_done,
+                cancel_token ct = cancel_token(),
+                priority_t prio = priority_t::BACKGROUND);
+
+    /**
+     * Call the work function for each index in the range [0, count) and wait
+     * for them to finish.  The calling thread does some of the work too, so
+     * this can be called from a task without tying up the pool.  If a call
+     * throws, the first exception is rethrown after all of the calls are
+     * done.
+     */
+    void parallel_for(size_t count,
+                      const std::function<void(size_t)> &work,
+                      priority_t prio = priority_t::BACKGROUND);
+
+    /**
+     * @return True if this is called from a task on a worker and there are
+     * tasks in a more urgent class waiting to be run.
+     */
+    bool should_yield() const;
+
+    /**
+     * @return A descriptor that is readable when there are completion
+     * callbacks to run.
+     */
+    int get_notify_fd() const {
+        return this->tp_notify_read.get();
+    };
+
+    /**
+     * Run the completion callbacks for the tasks that have finished.  This
+     * should only be called from the main thread.
+     *
+     * @return The number of callbacks that were run.
+     */
+    size_t run_completions();
+
+private:
+    static constexpr size_t PRIORITY_COUNT = (size_t) priority_t::MAX;
+
+    struct worker {
+        std::mutex w_mutex;
+        std::deque<task> w_tasks[PRIORITY_COUNT];
+        std::thread w_thread;
+    };
+
+    task_pool();
+
+    void start();
+
+    void worker_loop(size_t index);
+
+    /**
+     * Take the most urgent task from the worker's own queues or steal one.
+     * The priority of the task is stored in prio_out.
+     */
+    bool pop_task(size_t index, task &t, priority_t &prio_out);
+
+    /** Wake up the main loop to run the completions. */
+    void notify_done();
+
+    std::mutex tp_start_mutex;
+    bool tp_started{false};
+    std::vector<std::unique_ptr<worker>> tp_workers;
+    std::atomic<size_t> tp_next_worker{0};
+    std::atomic<size_t> tp_pending{0};
+    std::atomic<size_t> tp_pending_by_priority[PRIORITY_COUNT];
+    std::atomic<bool> tp_stopping{false};
+    std::mutex tp_idle_mutex;
+    std::condition_variable tp_idle_cond;
+
+    std::mutex tp_done_mutex;
+    std::vector<task> tp_done;
+    auto_fd tp_notify_read;
+    auto_fd tp_notify_write;
+};
+
+#endif
@@ -31,8 +31,11 @@
 #define __textfile_sub_source_hh
 
 #include <list>
+#include <map>
+#include <vector>
 
 #include "logfile.hh"
+#include "logfile_sub_source.hh"
 #include "textview_curses.hh"
 #include "filter_observer.hh"
 
@@ -41,7 +44,7 @@ class textfile_sub_source
 public:
     typedef std::list<std::shared_ptr<logfile>>::iterator file_iterator;
 
-    textfile_sub_source() {
+    textfile_sub_source() : tss_files_grepper(*this) {
         this->tss_supports_filtering = true;
     };
 
@@ -172,15 +175,18 @@ public:
         this->tss_files.push_back(lf);
     };
 
-    template<class T> bool rescan_files(T &callback) {
-        file_iterator iter;
+    template<class T> bool rescan_files(
+        T &callback, logfile::deadline_t deadline = nonstd::nullopt) {
         bool retval = false;
 
         if (this->tss_view->is_paused()) {
             return retval;
         }
 
-        for (iter = this->tss_files.begin(); iter != this->tss_files.end();) {
+        std::vector<std::shared_ptr<logfile>> files;
+
+        for (auto iter = this->tss_files.begin();
+             iter != this->tss_files.end();) {
             std::shared_ptr<logfile> lf = (*iter);
 
             if (!lf->exists() || lf->is_closed()) {
@@ -190,47 +196,85 @@ public:
                 continue;
             }
 
-            try {
-                uint32_t old_size = lf->size();
-                logfile::rebuild_result_t new_text_data = lf->rebuild_index();
-
-                if (lf->get_format() != NULL) {
-                    iter = this->tss_files.erase(iter);
-                    this->detach_observer(lf);
-                    callback.promote_file(lf);
-                    continue;
-                }
+            files.push_back(lf);
+            ++iter;
+        }
 
-                switch (new_text_data) {
-                    case logfile::RR_NEW_LINES:
-                    case logfile::RR_NEW_ORDER:
-                        retval = true;
-                        break;
-                    default:
-                        break;
-                }
-                callback.scanned_file(lf);
+        // The files with new data are indexed concurrently, the same as
+        // the files in the log view.
+        std::vector<size_t> old_sizes;
+        std::vector<logfile::rebuild_result_t> results(
+            files.size(), logfile::RR_NO_NEW_LINES);
+        std::vector<char> failed(files.size(), false);
+        std::vector<size_t> concurrent;
+        std::vector<logfile *> concurrent_files;
+
+        for (size_t lpc = 0; lpc < files.size(); lpc++) {
+            auto &lf = files[lpc];
+
+            old_sizes.push_back(lf->size());
+            if (lf->has_unindexed_data()) {
+                concurrent.push_back(lpc);
+                concurrent_files.push_back(lf.get());
+                continue;
+            }
 
-                uint32_t filter_in_mask, filter_out_mask;
+            try {
+                results[lpc] = lf->rebuild_index(deadline);
+            }
+            catch (const line_buffer::error &e) {
+                failed[lpc] = true;
+            }
+        }
 
-                this->get_filters().get_enabled_mask(filter_in_mask, filter_out_mask);
-                line_filter_observer *lfo = (line_filter_observer *) lf->get_logline_observer();
-                for (uint32_t lpc = old_size; lpc < lf->size(); lpc++) {
-                    if (lfo->excluded(filter_in_mask, filter_out_mask, lpc)) {
-                        continue;
-                    }
-                    lfo->lfo_filter_state.tfs_index.push_back(lpc);
-                }
+        run_concurrently(concurrent_files, [&](size_t index) {
+            try {
+                results[concurrent[index]] =
+                    concurrent_files[index]->rebuild_index(deadline);
             }
             catch (const line_buffer::error &e) {
-                iter = this->tss_files.erase(iter);
+                failed[concurrent[index]] = true;
+            }
+        });
+
+        filter_mask_t filter_in_mask, filter_out_mask;
+
+        this->get_filters().get_enabled_mask(filter_in_mask, filter_out_mask);
+        for (size_t lpc = 0; lpc < files.size(); lpc++) {
+            std::shared_ptr<logfile> lf = files[lpc];
+
+            if (failed[lpc]) {
+                this->tss_files.remove(lf);
                 lf->close();
                 this->detach_observer(lf);
                 callback.closed_file(lf);
                 continue;
             }
 
-            ++iter;
+            if (lf->get_format() != NULL) {
+                this->tss_files.remove(lf);
+                this->detach_observer(lf);
+                callback.promote_file(lf);
+                continue;
+            }
+
+            switch (results[lpc]) {
+                case logfile::RR_NEW_LINES:
+                case logfile::RR_NEW_ORDER:
+                    retval = true;
+                    break;
+                default:
+                    break;
+            }
+            callback.scanned_file(lf);
+
+            line_filter_observer *lfo = (line_filter_observer *) lf->get_logline_observer();
+            for (uint32_t lpc2 = old_sizes[lpc]; lpc2 < lf->size(); lpc2++) {
+                if (lfo->excluded(filter_in_mask, filter_out_mask, lpc2)) {
+                    continue;
+                }
+                lfo->lfo_filter_state.tfs_index.push_back(lpc2);
+            }
         }
 
         if (retval) {
@@ -248,7 +292,7 @@ public:
         }
 
         line_filter_observer *lfo = (line_filter_observer *) lf->get_logline_observer();
-        uint32_t filter_in_mask, filter_out_mask;
+        filter_mask_t filter_in_mask, filter_out_mask;
 
         lfo->clear_deleted_filter_state();
         lf->reobserve_from(lf->begin() + lfo->get_min_count(lf->size()));
@@ -300,6 +344,159 @@ public:
         return this;
     }
 
+    /**
+     * Searches the files that are not at the front of the view, so the
+     * number of hits in each of them is known.  The lines of the files are
+     * numbered one after the other, in the order of the files when the
+     * search started.
+     */
+    class files_grepper
+        : public grep_proc_source<vis_line_t>,
+          public grep_proc_sink<vis_line_t> {
+    public:
+        explicit files_grepper(textfile_sub_source &source)
+            : tfg_source(source) {
+        };
+
+        bool grep_value_for_line(vis_line_t line, std::string &value_out) override {
+            value_out.clear();
+
+            auto iter = std::upper_bound(this->tfg_starts.begin(),
+                                         this->tfg_starts.end(),
+                                         (size_t) line);
+
+            if (iter == this->tfg_starts.begin()) {
+                return false;
+            }
+
+            size_t index = std::distance(this->tfg_starts.begin(), iter) - 1;
+            size_t file_line = line - this->tfg_starts[index];
+            auto &lf = this->tfg_files[index];
+
+            if (file_line >= this->tfg_counts[index]) {
+                // Past the last line of the last file.
+                return false;
+            }
+
+            auto lfo = (line_filter_observer *) lf->get_logline_observer();
+
+            if (lfo == nullptr ||
+                file_line >= lfo->lfo_filter_state.tfs_index.size()) {
+                return true;
+            }
+
+            auto read_result = lf->read_line(
+                lf->begin() + lfo->lfo_filter_state.tfs_index[file_line]);
+
+            if (read_result.isOk()) {
+                value_out = to_string(read_result.unwrap());
+            }
+
+            return true;
+        };
+
+        void grep_begin(grep_proc<vis_line_t> &gp, vis_line_t start, vis_line_t stop) override {
+            if (start == 0) {
+                this->snapshot();
+            }
+            this->tfg_source.tss_view->grep_begin(gp, start, stop);
+        };
+
+        void grep_end(grep_proc<vis_line_t> &gp) override {
+            this->tfg_source.tss_view->grep_end(gp);
+        };
+
+        void grep_match(grep_proc<vis_line_t> &gp,
+                        vis_line_t line,
+                        int start,
+                        int end) override {
+        };
+
+        void grep_match_end(grep_proc<vis_line_t> &gp, vis_line_t line) override {
+            auto iter = std::upper_bound(this->tfg_starts.begin(),
+                                         this->tfg_starts.end(),
+                                         (size_t) line);
+
+            if (iter == this->tfg_starts.begin()) {
+                return;
+            }
+
+            size_t index = std::distance(this->tfg_starts.begin(), iter) - 1;
+
+            this->tfg_hits[this->tfg_files[index].get()] += 1;
+        };
+
+        /** Number the lines of the files that are not at the front. */
+        void snapshot() {
+            size_t total = 0;
+
+            this->tfg_files.clear();
+            this->tfg_starts.clear();
+            this->tfg_counts.clear();
+            this->tfg_hits.clear();
+            for (auto &lf : this->tfg_source.tss_files) {
+                if (lf == this->tfg_source.tss_files.front()) {
+                    continue;
+                }
+
+                auto lfo = (line_filter_observer *) lf->get_logline_observer();
+                size_t count = lfo == nullptr ?
+                    0 : lfo->lfo_filter_state.tfs_index.size();
+
+                this->tfg_files.push_back(lf);
+                this->tfg_starts.push_back(total);
+                this->tfg_counts.push_back(count);
+                total += count;
+            }
+        };
+
+        /** @return The number of matching lines in the given file. */
+        size_t hits_for(const logfile *lf) const {
+            auto iter = this->tfg_hits.find(lf);
+
+            if (iter == this->tfg_hits.end()) {
+                return 0;
+            }
+            return iter->second;
+        };
+
+        textfile_sub_source &tfg_source;
+        std::vector<std::shared_ptr<logfile>> tfg_files;
+        std::vector<size_t> tfg_starts;
+        std::vector<size_t> tfg_counts;
+        std::map<const logfile *, size_t> tfg_hits;
+    };
+
+    nonstd::optional<std::pair<grep_proc_source<vis_line_t> *, grep_proc_sink<vis_line_t> *>>
+    get_grepper() {
+        return std::make_pair(
+            (grep_proc_source<vis_line_t> *) &this->tss_files_grepper,
+            (grep_proc_sink<vis_line_t> *) &this->tss_files_grepper
+        );
+    };
+
+    /**
+     * @return The number of lines in the given file that matched the
+     * current search, if the file is not at the front of the view.
+     */
+    size_t get_search_hits(const logfile *lf) const {
+        return this->tss_files_grepper.hits_for(lf);
+    };
+
+    std::pair<size_t, size_t> text_hidden_search_hits() const {
+        std::pair<size_t, size_t> retval{0, 0};
+
+        for (const auto &pair : this->tss_files_grepper.tfg_hits) {
+            if (pair.second == 0) {
+                continue;
+            }
+            retval.first += pair.second;
+            retval.second += 1;
+        }
+
+        return retval;
+    };
+
 private:
     void detach_observer(std::shared_ptr<logfile> lf) {
         line_filter_observer *lfo = (line_filter_observer *) lf->get_logline_observer();
@@ -308,6 +505,7 @@ private:
     };
 
     std::list<std::shared_ptr<logfile>> tss_files;
+    files_grepper tss_files_grepper;
 };
 
 #endif
@@ -51,6 +51,7 @@ text_filter::revert_to_last(logfile_filter_state &lfs, size_t rollback_size)
 
     lfs.tfs_message_matched[this->lf_index] = lfs.tfs_last_message_matched[this->lf_index];
     lfs.tfs_lines_for_message[this->lf_index] = lfs.tfs_last_lines_for_message[this->lf_index];
+    lfs.tfs_cached_count[this->lf_index] = 0;
 
     for (size_t lpc = 0; lpc < lfs.tfs_lines_for_message[this->lf_index]; lpc++) {
         if (lfs.tfs_message_matched[this->lf_index]) {
@@ -59,7 +60,7 @@ text_filter::revert_to_last(logfile_filter_state &lfs, size_t rollback_size)
         lfs.tfs_filter_count[this->lf_index] -= 1;
         size_t line_number = lfs.tfs_filter_count[this->lf_index];
 
-        lfs.tfs_mask[line_number] &= ~(((uint32_t) 1) << this->lf_index);
+        lfs.clear_mask(line_number, this->lf_index);
     }
     if (lfs.tfs_lines_for_message[this->lf_index] > 0) {
         require(lfs.tfs_lines_for_message[this->lf_index] >= rollback_size);
@@ -72,8 +73,10 @@ text_filter::revert_to_last(logfile_filter_state &lfs, size_t rollback_size)
 }
 
 void text_filter::add_line(
-        logfile_filter_state &lfs, logfile::const_iterator ll, shared_buffer_ref &line) {
-    bool match_state = this->matches(*lfs.tfs_logfile, *ll, line);
+        logfile_filter_state &lfs, logfile::const_iterator ll,
+        shared_buffer_ref &line, bool maybe_matches) {
+    bool match_state = maybe_matches &&
+                       this->matches(*lfs.tfs_logfile, ll, line);
 
     if (!ll->is_continued()) {
         this->end_of_message(lfs);
@@ -85,9 +88,7 @@ void text_filter::add_line(
 
 void text_filter::end_of_message(logfile_filter_state &lfs)
 {
-    uint32_t mask = 0;
-
-    mask = ((uint32_t) lfs.tfs_message_matched[this->lf_index] ? 1U : 0) << this->lf_index;
+    bool matched = lfs.tfs_message_matched[this->lf_index];
 
     for (size_t lpc = 0; lpc < lfs.tfs_lines_for_message[this->lf_index]; lpc++) {
         require(lfs.tfs_filter_count[this->lf_index] <=
@@ -95,7 +96,9 @@ void text_filter::end_of_message(logfile_filter_state &lfs)
 
         size_t line_number = lfs.tfs_filter_count[this->lf_index];
 
-        lfs.tfs_mask[line_number] |= mask;
+        if (matched) {
+            lfs.set_mask(line_number, this->lf_index);
+        }
         lfs.tfs_filter_count[this->lf_index] += 1;
         if (lfs.tfs_message_matched[this->lf_index]) {
             lfs.tfs_filter_hits[this->lf_index] += 1;
@@ -132,6 +135,7 @@ textview_curses::~textview_curses()
 
 void textview_curses::reload_data(void)
 {
+    this->invalidate_row_cache();
     if (this->tc_sub_source != nullptr) {
         this->tc_sub_source->text_update_marks(this->tc_bookmarks);
     }
@@ -153,15 +157,24 @@ void textview_curses::grep_begin(grep_proc<vis_line_t> &gp, vis_line_t start, vi
     this->tc_searching += 1;
     this->tc_search_action.invoke(this);
 
+    this->flush_search_marks();
+
     bookmark_vector<vis_line_t> &search_bv = this->tc_bookmarks[&BM_SEARCH];
 
-    if (start != -1) {
+    if (start != -1 && !this->tc_keep_search_marks) {
         auto pair = search_bv.equal_range(vis_line_t(start), vis_line_t(stop));
 
-        for (auto mark_iter = pair.first;
-             mark_iter != pair.second;
-             ++mark_iter) {
-            this->set_user_mark(&BM_SEARCH, *mark_iter, false);
+        if (this->tc_sub_source != nullptr && pair.first != pair.second) {
+            std::vector<vis_line_t> removed(pair.first, pair.second);
+
+            this->tc_sub_source->text_mark_batch(&BM_SEARCH, removed, false);
+        }
+        // The lines in the range are about to be searched again, so the
+        // marks are removed in one go instead of one at a time.
+        search_bv.erase(pair.first, pair.second);
+        this->invalidate_row_cache();
+        if (this->tc_sub_source != nullptr) {
+            this->tc_sub_source->text_mark_searched(start, stop, false);
         }
     }
 
@@ -170,6 +183,7 @@ void textview_curses::grep_begin(grep_proc<vis_line_t> &gp, vis_line_t start, vi
 
 void textview_curses::grep_end(grep_proc<vis_line_t> &gp)
 {
+    this->flush_search_marks();
     this->tc_searching -= 1;
     this->tc_search_action.invoke(this);
 
@@ -181,22 +195,60 @@ void textview_curses::grep_match(grep_proc<vis_line_t> &gp,
                                  int start,
                                  int end)
 {
-    this->tc_bookmarks[&BM_SEARCH].insert_once(vis_line_t(line));
-    if (this->tc_sub_source != nullptr) {
-        this->tc_sub_source->text_mark(&BM_SEARCH, line, true);
-    }
+    this->tc_pending_search_marks.push_back(line);
+    this->tc_row_cache.erase(line);
 
     if (this->get_top() <= line && line <= this->get_bottom()) {
         listview_curses::reload_data();
     }
 }
 
+void textview_curses::flush_search_marks()
+{
+    if (this->tc_pending_search_marks.empty()) {
+        return;
+    }
+
+    this->tc_bookmarks[&BM_SEARCH].insert_batch(this->tc_pending_search_marks);
+    if (this->tc_sub_source != nullptr) {
+        this->tc_sub_source->text_mark_batch(&BM_SEARCH,
+                                             this->tc_pending_search_marks,
+                                             true);
+    }
+    this->tc_pending_search_marks.clear();
+}
+
 void textview_curses::listview_value_for_rows(const listview_curses &lv,
                                               vis_line_t row,
                                               vector<attr_line_t> &rows_out)
 {
+    bool cacheable = this->tc_sub_source != nullptr &&
+                     this->tc_sub_source->text_is_row_cacheable();
+
+    if (cacheable && (this->get_left() != this->tc_row_cache_left ||
+                      this->get_width() != this->tc_row_cache_width)) {
+        // Sources can leave out the part of a long line that is past the
+        // right edge of the view, so the rows are made again when the
+        // view is scrolled sideways or resized.
+        this->tc_row_cache.clear();
+        this->tc_row_cache_left = this->get_left();
+        this->tc_row_cache_width = this->get_width();
+    }
+
     for (auto &al : rows_out) {
+        if (cacheable) {
+            auto cached = this->tc_row_cache.find(row);
+
+            if (cached != nullptr) {
+                al = *cached;
+                ++row;
+                continue;
+            }
+        }
         this->textview_value_for_row(row, al);
+        if (cacheable) {
+            this->tc_row_cache.insert(row, al);
+        }
         ++row;
     }
 }
@@ -317,17 +369,24 @@ void textview_curses::textview_value_for_row(vis_line_t row,
         format_name = sa_iter->to_string();
     }
 
-    for (auto &tc_highlight : this->tc_highlights) {
-        bool internal_hl =
-            tc_highlight.first.first == highlight_source_t::INTERNAL;
+    const auto &plan = this->plan_for(source_format, format_name);
 
-        if (tc_highlight.second.h_text_format != text_format_t::TF_UNKNOWN &&
-            source_format != tc_highlight.second.h_text_format) {
-            continue;
+    if (!plan.hp_prefilter.empty()) {
+        int scan_start = std::min(body.lr_start, orig_line.lr_start);
+
+        this->tc_highlight_found.assign(plan.hp_entries.size(), false);
+        if (scan_start < (int) str.size()) {
+            plan.hp_prefilter.scan(
+                &str[scan_start], str.size() - scan_start, [this](size_t id) {
+                    this->tc_highlight_found[id] = true;
+                });
         }
+    }
+
+    for (size_t lpc = 0; lpc < plan.hp_entries.size(); lpc++) {
+        const auto &entry = plan.hp_entries[lpc];
 
-        if (!tc_highlight.second.h_format_name.empty() &&
-            tc_highlight.second.h_format_name != format_name) {
+        if (entry.e_prefiltered && !this->tc_highlight_found[lpc]) {
             continue;
         }
 
@@ -336,8 +395,8 @@ void textview_curses::textview_value_for_row(vis_line_t row,
         // highlights should apply only to the line itself and not any of the
         // surrounding decorations that are added (for example, the file lines
         // that are inserted at the beginning of the log view).
-        int start_pos = internal_hl ? body.lr_start : orig_line.lr_start;
-        tc_highlight.second.annotate(value_out, start_pos);
+        int start_pos = entry.e_internal ? body.lr_start : orig_line.lr_start;
+        entry.e_highlighter->annotate(value_out, start_pos);
     }
 
     if (this->tc_hide_fields) {
@@ -372,13 +431,13 @@ void textview_curses::textview_value_for_row(vis_line_t row,
 
     dp.parse();
 
-    for (list<data_parser::element>::iterator iter = dp.dp_stack.begin();
+    for (data_parser::element_list_t::iterator iter = dp.dp_stack.begin();
          iter != dp.dp_stack.end();
          ++iter) {
         view_colors &vc = view_colors::singleton();
 
         if (iter->e_token == DNT_PAIR) {
-            list<data_parser::element>::iterator pair_iter;
+            data_parser::element_list_t::iterator pair_iter;
             key_map_t::iterator km_iter;
             data_token_t        value_token;
             struct line_range   lr;
@@ -421,6 +480,108 @@ void textview_curses::textview_value_for_row(vis_line_t row,
     }
 }
 
+const textview_curses::highlight_plan &
+textview_curses::plan_for(text_format_t tf, intern_string_t format_name)
+{
+    auto key = std::make_pair(tf, format_name);
+    auto iter = this->tc_highlight_plans.find(key);
+
+    if (iter != this->tc_highlight_plans.end()) {
+        return iter->second;
+    }
+
+    auto &plan = this->tc_highlight_plans[key];
+
+    for (const auto &tc_highlight : this->tc_highlights) {
+        const auto &hl = tc_highlight.second;
+
+        if (hl.h_code == nullptr) {
+            continue;
+        }
+
+        if (hl.h_text_format != text_format_t::TF_UNKNOWN &&
+            tf != hl.h_text_format) {
+            continue;
+        }
+
+        if (!hl.h_format_name.empty() && hl.h_format_name != format_name) {
+            continue;
+        }
+
+        std::string literal;
+
+        if (!hl.h_pattern.empty()) {
+            literal = pcrepp::required_literal(hl.h_pattern.c_str());
+        }
+        if (!literal.empty()) {
+            plan.hp_prefilter.add(literal, plan.hp_entries.size());
+        }
+        plan.hp_entries.push_back({
+            &hl,
+            tc_highlight.first.first == highlight_source_t::INTERNAL,
+            !literal.empty(),
+        });
+    }
+    plan.hp_prefilter.compile();
+
+    return plan;
+}
+
+/**
+ * Check if every line that matches the new search pattern would also have
+ * matched the old one, which is the case when both are plain strings and the
+ * old one is a part of the new one.  Searches are caseless, so the strings
+ * are compared that way too.
+ */
+static bool is_narrower_search(const std::string &old_regex,
+                               const std::string &new_regex)
+{
+    std::string old_literal, new_literal;
+
+    if (old_regex.empty() ||
+        !pcrepp::literal_pattern(old_regex.c_str(), old_literal) ||
+        !pcrepp::literal_pattern(new_regex.c_str(), new_literal)) {
+        return false;
+    }
+
+    for (auto &ch : old_literal) {
+        ch = tolower((unsigned char) ch);
+    }
+    for (auto &ch : new_literal) {
+        ch = tolower((unsigned char) ch);
+    }
+
+    return new_literal.find(old_literal) != std::string::npos;
+}
+
+/**
+ * Group the hits from a search into ranges of lines to search again.  Hits
+ * that are close together are put in the same range to keep the number of
+ * requests down.
+ *
+ * @return False if there are too many ranges and it would be quicker to
+ *   search everything.
+ */
+static bool search_hit_ranges(const bookmark_vector<vis_line_t> &hits,
+                              vector<pair<vis_line_t, vis_line_t>> &ranges_out)
+{
+    static const vis_line_t MAX_GAP(32);
+    static const size_t MAX_RANGES = 256;
+
+    for (const auto &line : hits) {
+        if (!ranges_out.empty() && line - ranges_out.back().second <= MAX_GAP) {
+            ranges_out.back().second = vis_line_t(line + 1);
+            continue;
+        }
+        if (ranges_out.size() == MAX_RANGES) {
+            return false;
+        }
+        ranges_out.emplace_back(line, vis_line_t(line + 1));
+    }
+
+    return true;
+}
+
 void textview_curses::execute_search(const std::string &regex_orig)
 {
     std::string regex = regex_orig;
@@ -430,11 +591,6 @@ void textview_curses::execute_search(const std::string &regex_orig)
         const char *errptr;
         int         eoff;
 
-        this->match_reset();
-
-        this->tc_search_child.reset();
-        this->tc_source_search_child.reset();
-
         log_debug("start search for: '%s'", regex.c_str());
 
         if (regex.empty()) {
@@ -458,31 +614,89 @@ void textview_curses::execute_search(const std::string &regex_orig)
             }
         }
 
-        if (code != nullptr) {
+        // While a search is being typed in, each new pattern is usually the
+        // last one with a character added.  If the last search finished, the
+        // only lines that can match are the ones that matched before.
+        vector<pair<vis_line_t, vis_line_t>> ranges;
+        bool narrowed = code != nullptr &&
+                        this->tc_search_child != nullptr &&
+                        this->tc_search_child->get_grep_proc()->is_idle() &&
+                        is_narrower_search(this->tc_last_search, regex) &&
+                        search_hit_ranges(this->tc_bookmarks[&BM_SEARCH],
+                                          ranges);
+
+        if (narrowed) {
+            log_debug("  narrowing the last search to %zu ranges",
+                      ranges.size());
+        } else {
+            this->match_reset();
+        }
+        this->invalidate_row_cache();
+        this->tc_highlight_plans.clear();
+
+        if (code == nullptr) {
+            this->tc_search_child.reset();
+            this->tc_source_search_child.reset();
+        }
+        else {
             highlighter hl(code);
 
-            hl.with_role(view_colors::VCR_SEARCH);
+            hl.with_pattern(regex).with_role(view_colors::VCR_SEARCH);
 
             textview_curses::highlight_map_t &hm = this->get_highlights();
             hm[{highlight_source_t::PREVIEW, "search"}] = hl;
 
-            unique_ptr<grep_proc<vis_line_t>> gp = make_unique<grep_proc<vis_line_t>>(code, *this);
+            if (this->tc_search_child) {
+                // Keep the grep_proc so its workers do not have to be
+                // started up again for every key that is pressed.
+                this->tc_search_child->get_grep_proc()->set_code(code, regex);
+            } else {
+                unique_ptr<grep_proc<vis_line_t>> gp = make_unique<grep_proc<vis_line_t>>(code, *this);
+
+                gp->set_sink(this);
+                gp->set_in_process(true);
+                gp->set_pattern(regex);
 
-            gp->set_sink(this);
-            gp->queue_request(this->get_top());
-            if (this->get_top() > 0) {
-                gp->queue_request(0_vl, this->get_top());
+                this->tc_search_child = std::make_unique<grep_highlighter>(
+                    gp, highlight_source_t::PREVIEW, "search", hm);
             }
-            gp->start();
 
-            this->tc_search_child = std::make_unique<grep_highlighter>(
-                gp, highlight_source_t::PREVIEW, "search", hm);
+            grep_proc<vis_line_t> *gp = this->tc_search_child->get_grep_proc();
+
+            if (narrowed) {
+                // Start with the hits that are on the screen or below it.
+                auto iter = std::find_if(
+                    ranges.begin(), ranges.end(),
+                    [this](const pair<vis_line_t, vis_line_t> &range) {
+                        return range.second > this->get_top();
+                    });
+
+                std::rotate(ranges.begin(), iter, ranges.end());
+                for (const auto &range : ranges) {
+                    gp->queue_request(range.first, range.second);
+                }
+            } else {
+                gp->queue_request(this->get_top());
+                if (this->get_top() > 0) {
+                    gp->queue_request(0_vl, this->get_top());
+                }
+            }
+            gp->start();
 
             if (this->tc_sub_source != nullptr) {
-                this->tc_sub_source->get_grepper() | [this, code] (auto pair) {
+                this->tc_sub_source->get_grepper() | [this, code, &regex] (auto pair) {
+                    if (this->tc_source_search_child) {
+                        this->tc_source_search_child->set_code(code, regex)
+                            .queue_request(0_vl)
+                            .start();
+                        return;
+                    }
+
                     shared_ptr<grep_proc<vis_line_t>> sgp = make_shared<grep_proc<vis_line_t>>(code, *pair.first);
 
                     sgp->set_sink(pair.second);
+                    sgp->set_in_process(true);
+                    sgp->set_pattern(regex);
                     sgp->queue_request(0_vl);
                     sgp->start();
 
@@ -525,7 +739,7 @@ void text_time_translator::data_reloaded(textview_curses *tc)
 
 template class bookmark_vector<vis_line_t>;
 
-bool empty_filter::matches(const logfile &lf, const logline &ll,
+bool empty_filter::matches(const logfile &lf, logfile::const_iterator ll,
                            shared_buffer_ref &line)
 {
     return false;
@@ -40,6 +40,8 @@
 #include "bookmarks.hh"
 #include "listview_curses.hh"
 #include "base/lnav_log.hh"
+#include "base/lru_cache.hh"
+#include "base/multi_literal.hh"
 #include "text_format.hh"
 #include "logfile.hh"
 #include "highlighter.hh"
@@ -49,6 +51,67 @@ class textview_curses;
 
 using vis_bookmarks = bookmarks<vis_line_t>::type;
 
+/**
+ * A set of filter indexes, stored as one bit per filter.
+ */
+struct filter_mask_t {
+    static const int WORDS = 4;
+
+    void set(size_t index) {
+        this->fm_words[index / 32] |= (1UL << (index % 32));
+    };
+
+    bool test(size_t index) const {
+        return (this->fm_words[index / 32] & (1UL << (index % 32))) != 0;
+    };
+
+    bool any() const {
+        for (auto word : this->fm_words) {
+            if (word != 0) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    filter_mask_t operator&(const filter_mask_t &rhs) const {
+        filter_mask_t retval;
+
+        for (int lpc = 0; lpc < WORDS; lpc++) {
+            retval.fm_words[lpc] = this->fm_words[lpc] & rhs.fm_words[lpc];
+        }
+        return retval;
+    };
+
+    filter_mask_t operator|(const filter_mask_t &rhs) const {
+        filter_mask_t retval;
+
+        for (int lpc = 0; lpc < WORDS; lpc++) {
+            retval.fm_words[lpc] = this->fm_words[lpc] | rhs.fm_words[lpc];
+        }
+        return retval;
+    };
+
+    filter_mask_t operator~() const {
+        filter_mask_t retval;
+
+        for (int lpc = 0; lpc < WORDS; lpc++) {
+            retval.fm_words[lpc] = ~this->fm_words[lpc];
+        }
+        return retval;
+    };
+
+    bool operator==(const filter_mask_t &rhs) const {
+        return memcmp(this->fm_words, rhs.fm_words, sizeof(this->fm_words)) == 0;
+    };
+
+    bool operator!=(const filter_mask_t &rhs) const {
+        return !(*this == rhs);
+    };
+
+    uint32_t fm_words[WORDS]{};
+};
+
 class logfile_filter_state {
 public:
     logfile_filter_state(std::shared_ptr<logfile> lf = nullptr) : tfs_logfile(
@@ -59,6 +122,7 @@ public:
         memset(this->tfs_lines_for_message, 0, sizeof(this->tfs_lines_for_message));
         memset(this->tfs_last_message_matched, 0, sizeof(this->tfs_last_message_matched));
         memset(this->tfs_last_lines_for_message, 0, sizeof(this->tfs_last_lines_for_message));
+        memset(this->tfs_cached_count, 0, sizeof(this->tfs_cached_count));
         this->tfs_mask.reserve(64 * 1024);
     };
 
@@ -70,38 +134,101 @@ public:
         memset(this->tfs_lines_for_message, 0, sizeof(this->tfs_lines_for_message));
         memset(this->tfs_last_message_matched, 0, sizeof(this->tfs_last_message_matched));
         memset(this->tfs_last_lines_for_message, 0, sizeof(this->tfs_last_lines_for_message));
+        memset(this->tfs_cached_count, 0, sizeof(this->tfs_cached_count));
         this->tfs_mask.clear();
+        this->tfs_mask_width = 1;
         this->tfs_index.clear();
     };
 
-    void clear_deleted_filter_state(uint32_t used_mask) {
+    void clear_deleted_filter_state(const filter_mask_t &used_mask) {
+        bool stale = false;
+
         for (int lpc = 0; lpc < MAX_FILTERS; lpc++) {
-            if (!(used_mask & (1L << lpc))) {
+            if (!used_mask.test(lpc)) {
+                if (this->tfs_filter_count[lpc] != 0) {
+                    stale = true;
+                }
                 this->tfs_filter_count[lpc] = 0;
                 this->tfs_filter_hits[lpc] = 0;
                 this->tfs_message_matched[lpc] = false;
                 this->tfs_lines_for_message[lpc] = 0;
                 this->tfs_last_message_matched[lpc] = false;
                 this->tfs_last_lines_for_message[lpc] = 0;
+                this->tfs_cached_count[lpc] = 0;
             }
         }
+        if (!stale) {
+            // Only slots that have been evaluated can have bits set.
+            return;
+        }
         for (size_t lpc = 0; lpc < this->tfs_mask.size(); lpc++) {
-            this->tfs_mask[lpc] &= used_mask;
+            this->tfs_mask[lpc] &= used_mask.fm_words[lpc % this->tfs_mask_width];
         }
     }
 
     void resize(size_t newsize) {
-        size_t old_mask_size = this->tfs_mask.size();
+        this->tfs_mask.resize(newsize * this->tfs_mask_width, 0);
+    };
+
+    /**
+     * @return The mask words for a line, there are tfs_mask_width of them.
+     */
+    const uint32_t *mask_for_line(size_t line_number) const {
+        return &this->tfs_mask[line_number * this->tfs_mask_width];
+    };
+
+    bool test_mask(size_t line_number, size_t index) const {
+        if (index / 32 >= this->tfs_mask_width) {
+            return false;
+        }
+
+        return (this->mask_for_line(line_number)[index / 32] &
+                (1UL << (index % 32))) != 0;
+    };
+
+    void set_mask(size_t line_number, size_t index) {
+        this->ensure_mask_width(index / 32 + 1);
+        this->tfs_mask[line_number * this->tfs_mask_width + index / 32] |=
+            (1UL << (index % 32));
+    };
+
+    void clear_mask(size_t line_number, size_t index) {
+        if (index / 32 >= this->tfs_mask_width) {
+            return;
+        }
+        this->tfs_mask[line_number * this->tfs_mask_width + index / 32] &=
+            ~(1UL << (index % 32));
+    };
 
-        this->tfs_mask.resize(newsize);
-        if (newsize > old_mask_size) {
-            memset(&this->tfs_mask[old_mask_size],
-                    0,
-                    sizeof(uint32_t) * (newsize - old_mask_size));
+    /**
+     * Widen the per-line masks so that they can hold bits for filters in
+     * the given number of words.  Files only pay for the filter slots that
+     * have been used with them.
+     */
+    void ensure_mask_width(size_t width) {
+        if (width <= this->tfs_mask_width) {
+            return;
         }
+
+        size_t line_count = this->tfs_mask.size() / this->tfs_mask_width;
+        std::vector<uint32_t> new_mask(line_count * width, 0);
+
+        for (size_t lpc = 0; lpc < line_count; lpc++) {
+            memcpy(&new_mask[lpc * width],
+                   &this->tfs_mask[lpc * this->tfs_mask_width],
+                   sizeof(uint32_t) * this->tfs_mask_width);
+        }
+        this->tfs_mask = std::move(new_mask);
+        this->tfs_mask_width = width;
+    };
+
+    /** @return The number of bytes used by the per-line filter state. */
+    size_t get_mask_memory() const {
+        return (this->tfs_mask.capacity() + this->tfs_index.capacity()) *
+               sizeof(uint32_t);
     };
 
-    const static int MAX_FILTERS = 32;
+    const static int MAX_FILTERS = filter_mask_t::WORDS * 32;
 
     std::shared_ptr<logfile> tfs_logfile;
     size_t tfs_filter_count[MAX_FILTERS];
@@ -110,6 +237,9 @@ public:
     size_t tfs_lines_for_message[MAX_FILTERS];
     bool tfs_last_message_matched[MAX_FILTERS];
     size_t tfs_last_lines_for_message[MAX_FILTERS];
+    /** The number of lines whose matches are saved in the index cache. */
+    size_t tfs_cached_count[MAX_FILTERS];
+    size_t tfs_mask_width{1};
     std::vector<uint32_t> tfs_mask;
     std::vector<uint32_t> tfs_index;
 };
@@ -146,14 +276,46 @@ public:
 
     void revert_to_last(logfile_filter_state &lfs, size_t rollback_size);
 
-    void add_line(logfile_filter_state &lfs, logfile::const_iterator ll, shared_buffer_ref &line);
+    /**
+     * @param maybe_matches False if the line is already known to not match
+     *   this filter, so there is no need to call matches().
+     */
+    void add_line(logfile_filter_state &lfs, logfile::const_iterator ll,
+                  shared_buffer_ref &line, bool maybe_matches = true);
 
     void end_of_message(logfile_filter_state &lfs);
 
-    virtual bool matches(const logfile &lf, const logline &ll, shared_buffer_ref &line) = 0;
+    virtual bool matches(const logfile &lf, logfile::const_iterator ll,
+                         shared_buffer_ref &line) = 0;
 
     virtual std::string to_command() = 0;
 
+    /**
+     * @return A lowercase string that must be in a line for the line to match
+     *   this filter or an empty string if there is no such string.
+     */
+    virtual std::string get_required_literal() {
+        return "";
+    };
+
+    /**
+     * @return A string that identifies the lines this filter matches, so
+     *   the matches for a file can be saved in the index cache, or an empty
+     *   string if they should not be saved.  The type of the filter is not
+     *   part of the key since it does not change which lines match.
+     */
+    virtual std::string get_match_cache_key() {
+        return "";
+    };
+
+    /**
+     * @return True if matching this filter has been too expensive and it
+     *   should be turned off.
+     */
+    virtual bool is_over_budget() const {
+        return false;
+    };
+
     bool operator==(const std::string &rhs) {
         return this->lf_id == rhs;
     };
@@ -173,7 +335,7 @@ public:
         : text_filter(type, "", index) {
     }
 
-    bool matches(const logfile &lf, const logline &ll,
+    bool matches(const logfile &lf, logfile::const_iterator ll,
                  shared_buffer_ref &line) override;
 
     std::string to_command() override;
@@ -204,7 +366,7 @@ public:
     }
 
     size_t next_index() {
-        bool used[32];
+        bool used[logfile_filter_state::MAX_FILTERS];
 
         memset(used, 0, sizeof(used));
         for (auto &iter : *this) {
@@ -228,12 +390,42 @@ public:
 
     void add_filter(const std::shared_ptr<text_filter> &filter) {
         this->fs_filters.push_back(filter);
+        this->rebuild_prefilter();
     };
 
     void clear_filters() {
         while (!this->fs_filters.empty()) {
             this->fs_filters.pop_back();
         }
+        this->rebuild_prefilter();
+    };
+
+    /**
+     * Find the filters that could match the given line by looking for the
+     * literal strings the filters require in a single pass over the line.
+     *
+     * @param candidates Set to the filters whose literal was found.
+     * @return False if none of the filters have a required literal.
+     */
+    bool get_candidates(const char *data, size_t len,
+                        filter_mask_t &candidates) const {
+        if (this->fs_prefilter.empty()) {
+            return false;
+        }
+
+        candidates = filter_mask_t();
+        this->fs_prefilter.scan(data, len, [&candidates](size_t index) {
+            candidates.set(index);
+        });
+
+        return true;
+    };
+
+    /**
+     * @return True if the result of get_candidates() applies to the filter.
+     */
+    bool is_prefiltered(const text_filter *tf) const {
+        return this->fs_prefiltered[tf->get_index()] == tf;
     };
 
     void set_filter_enabled(const std::shared_ptr<text_filter> &filter, bool enabled) {
@@ -270,14 +462,15 @@ public:
         }
         if (iter != this->fs_filters.end()) {
             this->fs_filters.erase(iter);
+            this->rebuild_prefilter();
             return true;
         }
 
         return false;
     };
 
-    void get_mask(uint32_t &filter_mask) {
-        filter_mask = 0;
+    void get_mask(filter_mask_t &filter_mask) {
+        filter_mask = filter_mask_t();
         for (auto &iter : *this) {
             std::shared_ptr<text_filter> tf = iter;
 
@@ -285,12 +478,10 @@ public:
                 continue;
             }
             if (tf->is_enabled()) {
-                uint32_t bit = (1UL << tf->get_index());
-
                 switch (tf->get_type()) {
                     case text_filter::EXCLUDE:
                     case text_filter::INCLUDE:
-                        filter_mask |= bit;
+                        filter_mask.set(tf->get_index());
                         break;
                     default:
                         ensure(0);
@@ -300,8 +491,8 @@ public:
         }
     }
 
-    void get_enabled_mask(uint32_t &filter_in_mask, uint32_t &filter_out_mask) {
-        filter_in_mask = filter_out_mask = 0;
+    void get_enabled_mask(filter_mask_t &filter_in_mask, filter_mask_t &filter_out_mask) {
+        filter_in_mask = filter_out_mask = filter_mask_t();
         for (auto &iter : *this) {
             std::shared_ptr<text_filter> tf = iter;
 
@@ -309,14 +500,12 @@ public:
                 continue;
             }
             if (tf->is_enabled()) {
-                uint32_t bit = (1UL << tf->get_index());
-
                 switch (tf->get_type()) {
                     case text_filter::EXCLUDE:
-                        filter_out_mask |= bit;
+                        filter_out_mask.set(tf->get_index());
                         break;
                     case text_filter::INCLUDE:
-                        filter_in_mask |= bit;
+                        filter_in_mask.set(tf->get_index());
                         break;
                     default:
                         ensure(0);
@@ -326,8 +515,38 @@ public:
         }
     };
 
+    /**
+     * @return The lowercase string that a line must contain to match the
+     *   filter with the given index or an empty string if there is none.
+     */
+    const std::string &required_literal_for(size_t index) const {
+        return this->fs_required_literals[index];
+    };
+
 private:
+    void rebuild_prefilter() {
+        this->fs_prefilter.clear();
+        memset(this->fs_prefiltered, 0, sizeof(this->fs_prefiltered));
+        for (auto &lit : this->fs_required_literals) {
+            lit.clear();
+        }
+        for (auto &tf : this->fs_filters) {
+            std::string literal = tf->get_required_literal();
+
+            if (literal.empty()) {
+                continue;
+            }
+            this->fs_prefilter.add(literal, tf->get_index());
+            this->fs_prefiltered[tf->get_index()] = tf.get();
+            this->fs_required_literals[tf->get_index()] = literal;
+        }
+        this->fs_prefilter.compile();
+    };
+
     std::vector<std::shared_ptr<text_filter>> fs_filters;
+    multi_literal_matcher fs_prefilter;
+    const text_filter *fs_prefiltered[logfile_filter_state::MAX_FILTERS]{};
+    std::string fs_required_literals[logfile_filter_state::MAX_FILTERS];
 };
 
 class text_time_translator {
@@ -413,6 +632,30 @@ public:
 
     virtual size_t text_size_for_line(textview_curses &tc, int line, line_flags_t raw = 0) = 0;
 
+    /**
+     * Get the raw values for a run of lines.  Sources that can read the
+     * values straight out of a file should override this method so that a
+     * search does not need to copy each line separately.
+     *
+     * @param tc The textview_curses object that is delegating control.
+     * @param line The first line to retrieve.
+     * @param stop_line The line to stop at (exclusive) or -1.
+     * @param max_lines The maximum number of lines to retrieve.
+     * @param chunk_out The line values are appended to this buffer.
+     * @param spans_out The offsets of each value in chunk_out are appended
+     *   to this vector.
+     * @return The number of lines retrieved or zero if text_value_for_line()
+     *   should be used instead.
+     */
+    virtual size_t text_raw_values_for_lines(textview_curses &tc,
+                                             int line,
+                                             int stop_line,
+                                             size_t max_lines,
+                                             std::string &chunk_out,
+                                             std::vector<std::pair<size_t, size_t>> &spans_out) {
+        return 0;
+    };
+
     /**
      * Inform the source that the given line has been marked/unmarked.  This
      * callback function can be used to translate between between visible line
@@ -427,6 +670,23 @@ public:
      */
     virtual void text_mark(bookmark_type_t *bm, vis_line_t line, bool added) {};
 
+    /**
+     * Inform the source that a group of lines has been marked/unmarked, like
+     * the hits from a search.  The default calls text_mark() for each line.
+     *
+     * @param bm    The type of bookmark.
+     * @param lines The lines that have been marked/unmarked.
+     * @param added True if the lines were bookmarked and false if they were
+     *   unmarked.
+     */
+    virtual void text_mark_batch(bookmark_type_t *bm,
+                                 const std::vector<vis_line_t> &lines,
+                                 bool added) {
+        for (const auto &vl : lines) {
+            this->text_mark(bm, vl, added);
+        }
+    };
+
     /**
      * Clear the bookmarks for a particular type in the text source.
      *
@@ -454,6 +714,58 @@ public:
      */
     virtual void text_update_marks(vis_bookmarks &bm) { };
 
+    /**
+     * @return True if the source keeps the search hits and the lines that
+     *   were searched across a rebuild, so that a search can be redone
+     *   without looking at every line again.  The hits are expected to be
+     *   restored by text_update_marks().
+     */
+    virtual bool text_caches_search() { return false; };
+
+    /**
+     * Record whether a range of lines has been searched with the current
+     * search.  The record is dropped when the BM_SEARCH marks are cleared.
+     *
+     * @param start The first line in the range.
+     * @param stop The line after the end of the range or -1.
+     * @param searched True if the lines were searched.
+     */
+    virtual void text_mark_searched(vis_line_t start,
+                                    vis_line_t stop,
+                                    bool searched) { };
+
+    /**
+     * @param line The line to check.
+     * @return True if the line has been searched with the current search.
+     */
+    virtual bool text_is_searched(vis_line_t line) { return false; };
+
+    /**
+     * @param line The line to check.
+     * @param literal A lowercase string to look for.
+     * @return False if the line is known not to contain the string.
+     */
+    virtual bool text_line_may_contain(vis_line_t line,
+                                       const std::string &literal) {
+        return true;
+    };
+
+    /**
+     * Called when the view is scrolled so that a source that generates its
+     * lines lazily can produce the ones that are coming into view.
+     */
+    virtual void text_scrolled(textview_curses &tc) {
+    };
+
+    /**
+     * @return True if the rendered rows only change when the view is
+     *   reloaded or its highlights, marks, or hidden fields are changed,
+     *   so they can be kept between redraws.  A source that changes its
+     *   rendering in some other way must call
+     *   textview_curses::invalidate_row_cache().
+     */
+    virtual bool text_is_row_cacheable() const { return false; };
+
     virtual std::string text_source_name(const textview_curses &tv) {
         return "";
     };
@@ -474,6 +786,48 @@ public:
         return 0;
     }
 
+    /**
+     * How far along the filter given to text_preview_filter() is and what
+     * it would do to the view.
+     */
+    struct filter_preview {
+        size_t fp_lines_done{0};
+        size_t fp_line_count{0};
+        size_t fp_hits{0};     /*< The lines in messages that matched. */
+        size_t fp_hidden{0};   /*< The visible lines it would hide. */
+        size_t fp_shown{0};    /*< The hidden lines it would show. */
+
+        bool is_done() const {
+            return this->fp_lines_done >= this->fp_line_count;
+        };
+    };
+
+    /**
+     * Start trying out a filter that is being edited, its matches are found
+     * a slice at a time by text_preview_step().  If the same filter is then
+     * added to the stack, the matches found so far are used instead of
+     * running it again.
+     *
+     * @param tf The filter to try out or nullptr to stop.
+     */
+    virtual void text_preview_filter(std::shared_ptr<text_filter> tf) {
+    };
+
+    /**
+     * Run the filter being previewed over more lines.
+     *
+     * @param deadline The time to stop by.
+     * @return True if there are still lines left.
+     */
+    virtual bool text_preview_step(logfile::deadline_t deadline) {
+        return false;
+    };
+
+    /** @return The progress of the filter being previewed, if any. */
+    virtual nonstd::optional<filter_preview> text_get_filter_preview() {
+        return nonstd::nullopt;
+    };
+
     virtual text_format_t get_text_format() const {
         return text_format_t::TF_UNKNOWN;
     };
@@ -482,6 +836,15 @@ public:
         return nonstd::nullopt;
     }
 
+    /**
+     * @return The number of lines that matched the current search in data
+     * that is not shown in the view, like the other files in the TEXT view,
+     * and the number of places, like files, that those lines are in.
+     */
+    virtual std::pair<size_t, size_t> text_hidden_search_hits() const {
+        return std::make_pair(0, 0);
+    };
+
     virtual nonstd::optional<location_history *> get_location_history() {
         return nonstd::nullopt;
     }
@@ -584,6 +947,12 @@ public:
     static bookmark_type_t BM_SEARCH;
     static bookmark_type_t BM_META;
 
+    /**
+     * The number of rendered rows kept between redraws, enough for a few
+     * screens so that scrolling back and forth does not render again.
+     */
+    static const int ROW_CACHE_SIZE = 512;
+
     static string_attr_type SA_ORIGINAL_LINE;
     static string_attr_type SA_BODY;
     static string_attr_type SA_HIDDEN;
@@ -640,6 +1009,7 @@ public:
                 this->tc_sub_source->text_mark(bm, curr_line, added);
             }
         }
+        this->invalidate_row_cache();
         this->search_range(start_line, end_line + 1_vl);
         this->search_new_data();
     };
@@ -660,6 +1030,7 @@ public:
         if (this->tc_sub_source) {
             this->tc_sub_source->text_mark(bm, vl, marked);
         }
+        this->invalidate_row_cache();
 
         this->search_range(vl, vl + 1_vl);
         this->search_new_data();
@@ -692,6 +1063,9 @@ public:
         highlighter &hl = this->tc_highlights[{highlight_source_t::PREVIEW, "search"}];
         int          prev_hit = -1, next_hit = INT_MAX;
 
+        if (!hl.h_studied) {
+            hl.study();
+        }
         for (; start < end; ++start) {
             std::vector<attr_line_t> rows(1);
             int off;
@@ -754,6 +1128,7 @@ public:
 
     void grep_end_batch(grep_proc<vis_line_t> &gp)
     {
+        this->flush_search_marks();
         if (this->tc_follow_deadline.tv_sec) {
             struct timeval now;
 
@@ -780,6 +1155,31 @@ public:
     };
     void grep_end(grep_proc<vis_line_t> &gp);
 
+    /** Add the pending search hits to the BM_SEARCH bookmarks. */
+    void flush_search_marks();
+
+    void grep_searched(grep_proc<vis_line_t> &gp,
+                       vis_line_t start,
+                       vis_line_t stop)
+    {
+        this->flush_search_marks();
+        if (this->tc_sub_source != nullptr) {
+            this->tc_sub_source->text_mark_searched(start, stop, true);
+        }
+    };
+
+    bool grep_line_is_cached(vis_line_t line)
+    {
+        return this->tc_sub_source != nullptr &&
+               this->tc_sub_source->text_is_searched(line);
+    };
+
+    bool grep_line_is_excluded(vis_line_t line, const std::string &literal)
+    {
+        return this->tc_sub_source != nullptr &&
+               !this->tc_sub_source->text_line_may_contain(line, literal);
+    };
+
     size_t listview_rows(const listview_curses &lv)
     {
         return this->tc_sub_source == nullptr ? 0 :
@@ -801,6 +1201,11 @@ public:
         return this->tc_sub_source->text_size_for_line(*this, row);
     };
 
+    bool listview_is_size_cacheable(const listview_curses &lv) const {
+        return this->tc_sub_source != nullptr &&
+               this->tc_sub_source->text_is_row_cacheable();
+    };
+
     std::string listview_source_name(const listview_curses &lv) {
         return this->tc_sub_source == nullptr ? "" :
                this->tc_sub_source->text_source_name(*this);
@@ -822,6 +1227,21 @@ public:
         return retval;
     };
 
+    size_t grep_values_for_lines(vis_line_t line,
+                                 vis_line_t stop_line,
+                                 size_t max_lines,
+                                 std::string &chunk_out,
+                                 std::vector<std::pair<size_t, size_t>> &spans_out)
+    {
+        if (this->tc_sub_source == nullptr ||
+            line >= (int)this->tc_sub_source->text_line_count()) {
+            return 0;
+        }
+
+        return this->tc_sub_source->text_raw_values_for_lines(
+            *this, line, stop_line, max_lines, chunk_out, spans_out);
+    };
+
     void grep_begin(grep_proc<vis_line_t> &gp, vis_line_t start, vis_line_t stop);
     void grep_match(grep_proc<vis_line_t> &gp,
                     vis_line_t line,
@@ -850,12 +1270,17 @@ public:
         if (this->tc_sub_source != NULL) {
             this->tc_sub_source->text_clear_marks(&BM_SEARCH);
         }
+        this->invalidate_row_cache();
     };
 
     using highlight_map_t =
         std::map<std::pair<highlight_source_t, std::string>, highlighter>;
 
-    highlight_map_t &get_highlights() { return this->tc_highlights; };
+    highlight_map_t &get_highlights() {
+        this->invalidate_row_cache();
+        this->tc_highlight_plans.clear();
+        return this->tc_highlights;
+    };
 
     const highlight_map_t &get_highlights() const { return this->tc_highlights; };
 
@@ -874,10 +1299,19 @@ public:
         bool retval = this->tc_hide_fields;
 
         this->tc_hide_fields = !this->tc_hide_fields;
+        this->invalidate_row_cache();
 
         return retval;
     };
 
+    /**
+     * Drop the rendered rows kept between redraws.
+     */
+    void invalidate_row_cache() {
+        this->tc_row_cache.clear();
+        this->invalidate_wrap_cache();
+    };
+
     void execute_search(const std::string &regex_orig);
 
     void redo_search() {
@@ -885,7 +1319,16 @@ public:
             grep_proc<vis_line_t> *gp = this->tc_search_child->get_grep_proc();
 
             gp->invalidate();
-            this->match_reset();
+            if (this->tc_sub_source != nullptr &&
+                this->tc_sub_source->text_caches_search()) {
+                // The hits for lines that were already searched are still
+                // known, so they only need to be mapped to the new visible
+                // lines and the rest of the lines searched.
+                this->tc_sub_source->text_update_marks(this->tc_bookmarks);
+                this->tc_keep_search_marks = true;
+            } else {
+                this->match_reset();
+            }
             gp->queue_request(0_vl)
               .start();
 
@@ -894,6 +1337,7 @@ public:
                     .queue_request(0_vl)
                     .start();
             }
+            this->tc_keep_search_marks = false;
         }
     };
 
@@ -945,6 +1389,7 @@ public:
             if (ttt != nullptr) {
                 ttt->scroll_invoked(this);
             }
+            this->tc_sub_source->text_scrolled(*this);
         }
 
         listview_curses::invoke_scroll();
@@ -954,6 +1399,25 @@ public:
 
 protected:
 
+    /**
+     * The highlighters that apply to lines of a particular text format and
+     * log format, along with a prefilter built from the literals that the
+     * patterns require.  A highlighter whose literal is not in a line does
+     * not need to be run against it.
+     */
+    struct highlight_plan {
+        struct entry {
+            const highlighter *e_highlighter;
+            bool e_internal;
+            bool e_prefiltered;
+        };
+
+        std::vector<entry> hp_entries;
+        multi_literal_matcher hp_prefilter;
+    };
+
+    const highlight_plan &plan_for(text_format_t tf, intern_string_t format_name);
+
     class grep_highlighter {
     public:
         grep_highlighter(std::unique_ptr<grep_proc<vis_line_t>> &gp,
@@ -986,10 +1450,23 @@ protected:
     vis_bookmarks tc_bookmarks;
 
     int tc_searching{0};
+    bool tc_keep_search_marks{false};
+    /**
+     * The search hits that have not been added to the BM_SEARCH bookmarks
+     * yet, they are added a batch at a time by flush_search_marks().
+     */
+    std::vector<vis_line_t> tc_pending_search_marks;
     struct timeval tc_follow_deadline{0, 0};
     action tc_search_action;
 
     highlight_map_t           tc_highlights;
+    lru_cache<int, attr_line_t> tc_row_cache{ROW_CACHE_SIZE};
+    /** The left and width of the view when the rows were cached. */
+    unsigned int tc_row_cache_left{0};
+    long tc_row_cache_width{0};
+    std::map<std::pair<text_format_t, intern_string_t>, highlight_plan>
+        tc_highlight_plans;
+    std::vector<bool> tc_highlight_found;
 
     vis_line_t tc_selection_start;
     vis_line_t tc_selection_last;
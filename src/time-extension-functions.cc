@@ -46,48 +46,128 @@
 
 using namespace std;
 
-static string timeslice(const char *time_in, nonstd::optional<const char *> slice_in_opt)
+/**
+ * The parsed form of a timeslice() slice argument, kept with the statement
+ * by sqlite3_set_auxdata() so that it is only parsed once.
+ */
+struct timeslice_cache {
+    const char *tc_error{nullptr};
+    int64_t tc_slice_us{0};
+};
+
+static void free_timeslice_cache(void *data)
+{
+    delete (timeslice_cache *) data;
+}
+
+static void parse_timeslice(const char *slice_in, timeslice_cache &tc_out)
 {
-    const char *slice_in = slice_in_opt.value_or("15m");
     relative_time::parse_error pe;
-    date_time_scanner dts;
     relative_time rt;
-    time_t now;
-
-    time(&now);
-    dts.set_base_time(now);
 
     if (!rt.parse(slice_in, strlen(slice_in), pe)) {
-        throw sqlite_func_error("unable to parse time slice value");
+        tc_out.tc_error = "unable to parse time slice value";
+    } else if (rt.empty()) {
+        tc_out.tc_error = "no time slice value given";
+    } else if (rt.is_absolute()) {
+        tc_out.tc_error = "absolute time slices are not valid";
+    } else {
+        tc_out.tc_slice_us = rt.to_microseconds();
+        if (tc_out.tc_slice_us <= 0) {
+            tc_out.tc_error = "no time slice value given";
+        }
     }
+}
 
-    if (rt.empty()) {
-        throw sqlite_func_error("no time slice value given");
+static void sql_timeslice(sqlite3_context *context,
+                          int argc, sqlite3_value **argv)
+{
+    if (argc < 1 || argc > 2) {
+        sqlite3_result_error(
+            context, "timeslice() expects between 1 and 2 arguments", -1);
+        return;
     }
 
-    if (rt.is_absolute()) {
-        throw sqlite_func_error("absolute time slices are not valid");
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+        sqlite3_result_null(context);
+        return;
     }
 
-    struct exttm tm;
-    struct timeval tv;
+    timeslice_cache local_tc;
+    timeslice_cache *tc = nullptr;
+
+    if (argc == 2 && sqlite3_value_type(argv[1]) != SQLITE_NULL) {
+        tc = (timeslice_cache *) sqlite3_get_auxdata(context, 1);
+        if (tc == nullptr) {
+            const char *slice_in = (const char *) sqlite3_value_text(argv[1]);
+
+            tc = new timeslice_cache();
+            parse_timeslice(slice_in, *tc);
+            sqlite3_set_auxdata(context, 1, tc, free_timeslice_cache);
+            // The cache might have been freed already if the slice is not a
+            // constant, so fetch it again.
+            tc = (timeslice_cache *) sqlite3_get_auxdata(context, 1);
+            if (tc == nullptr) {
+                parse_timeslice(slice_in, local_tc);
+                tc = &local_tc;
+            }
+        }
+    } else {
+        static timeslice_cache DEFAULT_TC;
+
+        if (DEFAULT_TC.tc_slice_us == 0) {
+            parse_timeslice("15m", DEFAULT_TC);
+        }
+        tc = &DEFAULT_TC;
+    }
 
-    if (dts.scan(time_in, strlen(time_in), NULL, &tm, tv) == NULL) {
-        throw sqlite_func_error("unable to parse time value");
+    if (tc->tc_error != nullptr) {
+        sqlite3_result_error(context, tc->tc_error, -1);
+        return;
     }
 
-    int64_t us = tv.tv_sec * 1000000LL + tv.tv_usec, remainder;
+    int64_t us;
+
+    if (sqlite3_value_type(argv[0]) == SQLITE_INTEGER) {
+        // A count of microseconds since the epoch, like the log_time_us
+        // column, which does not need to be parsed.
+        us = sqlite3_value_int64(argv[0]);
+    } else {
+        const char *time_in = (const char *) sqlite3_value_text(argv[0]);
+        date_time_scanner dts;
+        struct exttm tm;
+        struct timeval tv;
+        time_t now;
+
+        time(&now);
+        dts.set_base_time(now);
+        if (dts.scan(time_in, strlen(time_in), NULL, &tm, tv) == NULL) {
+            sqlite3_result_error(context, "unable to parse time value", -1);
+            return;
+        }
+
+        us = tv.tv_sec * 1000000LL + tv.tv_usec;
+    }
+
+    int64_t remainder = us % tc->tc_slice_us;
 
-    remainder = us % rt.to_microseconds();
     us -= remainder;
+    if (remainder < 0) {
+        us -= tc->tc_slice_us;
+    }
+
+    struct timeval tv;
+    char ts[64];
 
     tv.tv_sec = us / (1000 * 1000);
     tv.tv_usec = us % (1000 * 1000);
-
-    char ts[64];
+    if (tv.tv_usec < 0) {
+        tv.tv_sec -= 1;
+        tv.tv_usec += 1000 * 1000;
+    }
     sql_strftime(ts, sizeof(ts), tv);
 
-    return ts;
+    sqlite3_result_text(context, ts, -1, SQLITE_TRANSIENT);
 }
 
 static
@@ -119,7 +199,9 @@ int time_extension_functions(struct FuncDef **basic_funcs,
                              struct FuncDefAgg **agg_funcs)
 {
     static struct FuncDef time_funcs[] = {
-        sqlite_func_adapter<decltype(&timeslice), timeslice>::builder(
+        {
+            "timeslice", -1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, 0,
+            sql_timeslice,
             help_text("timeslice",
                       "Return the start of the slice of time that the given timestamp falls in.")
                 .sql_function()
@@ -128,7 +210,7 @@ int time_extension_functions(struct FuncDef **basic_funcs,
                 .with_tags({"datetime"})
                 .with_example({"SELECT timeslice('2017-01-01T05:05:00', '10m')"})
                 .with_example({"SELECT timeslice(log_time, '5m') AS slice, count(*) FROM lnav_example_log GROUP BY slice"})
-        ),
+        },
 
         sqlite_func_adapter<decltype(&sql_timediff), sql_timediff>::builder(
             help_text("timediff",
@@ -32,6 +32,7 @@
 
 #include <string>
 
+#include "frame_tracer.hh"
 #include "lnav_config.hh"
 #include "logfile_sub_source.hh"
 #include "statusview_curses.hh"
@@ -45,6 +46,7 @@ public:
 
     typedef enum {
         TSF_TIME,
+        TSF_FRAME_TIME,
         TSF_PARTITION_NAME,
         TSF_VIEW_NAME,
         TSF_STITCH_VIEW_FORMAT,
@@ -105,6 +107,27 @@ public:
         sf.set_value(buffer);
     };
 
+    /**
+     * Show the frame times when they are turned on in the configuration,
+     * otherwise the field takes no space.
+     */
+    void update_frame_time(const frame_tracer &ft)
+    {
+        status_field &sf = this->tss_fields[TSF_FRAME_TIME];
+
+        if (!ft.is_overlay_enabled()) {
+            sf.set_width(0);
+            sf.clear();
+            return;
+        }
+
+        sf.set_width(40);
+        sf.set_value(" frame %4.1fms p99 %4.1fms input %4.1fms",
+                     ft.get_last_frame_ns() / 1000000.0,
+                     ft.get_frame_counter().get_percentile_ns(0.99) / 1000000.0,
+                     ft.get_last_input_ns() / 1000000.0);
+    };
+
     void update_time() {
         struct timeval tv;
 
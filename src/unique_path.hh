@@ -32,8 +32,10 @@
 #ifndef LNAV_UNIQUE_PATH_HH
 #define LNAV_UNIQUE_PATH_HH
 
+#include <algorithm>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -63,6 +65,13 @@ private:
     std::string ups_unique_path;
 };
 
+/**
+ * Generates the shortest names that tell apart files with the same base
+ * name by adding the parent directories that differ.  The names of a file
+ * only depend on the other files with the same base name, so the files are
+ * kept in groups by base name and generate() only works on the groups that
+ * changed since the last call.
+ */
 class unique_path_generator {
 public:
     unique_path_generator() : upg_max_len(0) {
@@ -70,20 +79,66 @@ public:
     };
 
     void add_source(std::shared_ptr<unique_path_source> path_source) {
-        filesystem::path path = path_source->get_path();
+        std::string key = path_source->get_path().filename();
 
-        path_source->set_unique_path(path.filename());
-        path_source->set_path_prefix(path.parent_path());
-        this->upg_unique_paths[path.filename()].push_back(path_source);
+        this->upg_keys[path_source.get()] = key;
+        this->upg_groups[key].push_back(std::move(path_source));
+        this->upg_dirty.insert(key);
+    };
+
+    /**
+     * Stop generating a name for a source, the names of the other sources
+     * with the same base name are generated again by the next generate().
+     */
+    void remove_source(const std::shared_ptr<unique_path_source> &path_source) {
+        auto key_iter = this->upg_keys.find(path_source.get());
+
+        if (key_iter == this->upg_keys.end()) {
+            return;
+        }
+
+        auto group_iter = this->upg_groups.find(key_iter->second);
+        auto &group = group_iter->second;
+
+        group.erase(std::remove(group.begin(), group.end(), path_source),
+                    group.end());
+        if (group.empty()) {
+            this->upg_dirty.erase(key_iter->second);
+            this->upg_groups.erase(group_iter);
+        } else {
+            this->upg_dirty.insert(key_iter->second);
+        }
+        this->upg_keys.erase(key_iter);
     };
 
     void generate() {
+        for (const auto &key : this->upg_dirty) {
+            generate_group(this->upg_groups[key]);
+        }
+        this->upg_dirty.clear();
+    };
+
+    size_t upg_max_len;
+
+private:
+    void generate_group(
+        const std::vector<std::shared_ptr<unique_path_source>> &group) {
+        std::map<std::string, std::vector<std::shared_ptr<unique_path_source>>>
+            unique_paths;
         int loop_count = 0;
 
-        while (!this->upg_unique_paths.empty()) {
+        for (const auto &src : group) {
+            filesystem::path path = src->get_path();
+
+            src->set_unique_path(path.filename());
+            src->set_path_prefix(path.parent_path());
+            unique_paths[path.filename()].push_back(src);
+        }
+
+        while (!unique_paths.empty()) {
             std::vector<std::shared_ptr<unique_path_source>> collisions;
 
-            for (auto pair : this->upg_unique_paths) {
+            for (auto &pair : unique_paths) {
                 if (pair.second.size() == 1) {
                     if (loop_count > 0) {
                         std::shared_ptr<unique_path_source> src = pair.second[0];
@@ -129,10 +184,9 @@ public:
                 }
             }
 
-            this->upg_unique_paths.clear();
+            unique_paths.clear();
 
             for (auto &src : collisions) {
-                const auto path = src->get_path();
                 const auto unique_path = src->get_unique_path();
                 auto &prefix = src->get_path_prefix();
 
@@ -147,8 +201,7 @@ public:
                 src->set_path_prefix(parent);
 
                 if (!parent.empty()) {
-                    this->upg_unique_paths[src->get_unique_path()].push_back(
-                        src);
+                    unique_paths[src->get_unique_path()].push_back(src);
                 } else {
                     src->set_unique_path("[" + src->get_unique_path());
                 }
@@ -156,10 +209,15 @@ public:
 
             loop_count += 1;
         }
-    }
+    };
 
-    std::map<std::string, std::vector<std::shared_ptr<unique_path_source>>> upg_unique_paths;
-    size_t upg_max_len;
+    /** The sources grouped by their base name. */
+    std::map<std::string, std::vector<std::shared_ptr<unique_path_source>>>
+        upg_groups;
+    /** The base name each source was added with. */
+    std::map<const unique_path_source *, std::string> upg_keys;
+    /** The groups that have changed since the last generate(). */
+    std::set<std::string> upg_dirty;
 };
 
 #endif //LNAV_UNIQUE_PATH_HH
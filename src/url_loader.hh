@@ -36,6 +36,9 @@
 
 class url_loader : public curl_request {
 public:
+    /** Files modified more recently than this are tailed after loading. */
+    static const long FOLLOW_IF_MODIFIED_SINCE = 60 * 60;
+
     url_loader(const std::string &url) : curl_request(url), ul_resume_offset(0) {
         char piper_tmpname[PATH_MAX];
         const char *tmpdir;
@@ -123,8 +126,6 @@ public:
     };
 
 private:
-    static const long FOLLOW_IF_MODIFIED_SINCE = 60 * 60;
-
     static ssize_t write_cb(void *contents, size_t size, size_t nmemb, void *userp) {
         url_loader *ul = (url_loader *) userp;
         char *c_contents = (char *) contents;
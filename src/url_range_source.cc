@@ -0,0 +1,312 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file url_range_source.cc
+ */
+
+#include "config.h"
+
+#ifdef HAVE_LIBCURL
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "auto_fd.hh"
+#include "base/lnav_log.hh"
+#include "curl_looper.hh"
+#include "fmt/format.h"
+#include "lnav_util.hh"
+#include "url_loader.hh"
+#include "url_range_source.hh"
+
+using namespace std;
+
+const size_t url_range_source::BLOCK_SIZE;
+const off_t url_range_source::MIN_FILE_SIZE;
+
+/** Look for the header that says the server can send ranges of the file. */
+static size_t accept_ranges_cb(char *buffer,
+                               size_t size,
+                               size_t nitems,
+                               void *userp)
+{
+    static const char ACCEPT_RANGES[] = "accept-ranges:";
+
+    auto accepts = (bool *) userp;
+    size_t len = size * nitems;
+    string header(buffer, len);
+
+    if (header.size() > strlen(ACCEPT_RANGES) &&
+        strncasecmp(header.c_str(), ACCEPT_RANGES, strlen(ACCEPT_RANGES)) == 0) {
+        *accepts = strcasestr(header.c_str() + strlen(ACCEPT_RANGES),
+                              "bytes") != nullptr;
+    }
+
+    return len;
+}
+
+Result<shared_ptr<url_range_source>, string>
+url_range_source::open(const string &url)
+{
+    auto_mem<CURL> handle(curl_easy_cleanup);
+    bool accepts_ranges = false;
+
+    handle.reset(curl_easy_init());
+    if (handle == nullptr) {
+        return Err(string("unable to create a curl handle"));
+    }
+
+    curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(handle, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(handle, CURLOPT_FILETIME, 1L);
+    curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, accept_ranges_cb);
+    curl_easy_setopt(handle, CURLOPT_HEADERDATA, &accepts_ranges);
+
+    auto rc = curl_easy_perform(handle);
+
+    if (rc != CURLE_OK) {
+        return Err(string(curl_easy_strerror(rc)));
+    }
+
+    long response_code = 0;
+    curl_off_t content_length = -1;
+    long file_time = -1;
+
+    curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &response_code);
+    curl_easy_getinfo(handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T,
+                      &content_length);
+    curl_easy_getinfo(handle, CURLINFO_FILETIME, &file_time);
+    if (response_code != 200) {
+        return Err(fmt::format("unexpected response code {}", response_code));
+    }
+    if (!accepts_ranges) {
+        return Err(string("the server does not accept range requests"));
+    }
+    if (content_length < MIN_FILE_SIZE) {
+        return Err(string("the file is small enough to download"));
+    }
+    if (file_time == -1 ||
+        time(nullptr) - file_time < url_loader::FOLLOW_IF_MODIFIED_SINCE) {
+        return Err(string("the file was recently modified and is tailed"));
+    }
+
+    auto open_res = open_temp_file(system_tmpdir() / "lnav.url.XXXXXX");
+
+    if (open_res.isErr()) {
+        return Err(fmt::format("unable to create a temporary file -- {}",
+                               open_res.unwrapErr()));
+    }
+
+    auto tmp_pair = open_res.unwrap();
+    auto_fd fd(tmp_pair.second);
+
+    tmp_pair.first.remove_file();
+    if (ftruncate(fd, content_length) == -1) {
+        return Err(fmt::format("unable to size the temporary file -- {}",
+                               strerror(errno)));
+    }
+
+    shared_ptr<url_range_source> retval(new url_range_source(
+        url, std::move(handle), fd, content_length, file_time));
+    auto fetch_res = retval->fetch_range({0, (ssize_t) BLOCK_SIZE});
+
+    if (fetch_res.isErr()) {
+        return Err(fetch_res.unwrapErr());
+    }
+
+    // The compressed readers do their own reads of the file, so they cannot
+    // be given only part of it.
+    line_buffer lb;
+    auto_fd check_fd = retval->copy_fd();
+
+    lb.set_fd(check_fd);
+    if (lb.is_compressed()) {
+        return Err(string("the file is compressed"));
+    }
+
+    return Ok(retval);
+}
+
+url_range_source::url_range_source(const string &url,
+                                   auto_mem<CURL> handle,
+                                   auto_fd fd,
+                                   off_t size,
+                                   time_t mtime)
+    : urs_url(url),
+      urs_handle(std::move(handle)),
+      urs_fd(std::move(fd)),
+      urs_size(size),
+      urs_mtime(mtime),
+      urs_fetched((size + BLOCK_SIZE - 1) / BLOCK_SIZE, false)
+{
+    curl_easy_setopt(this->urs_handle, CURLOPT_NOBODY, 0L);
+    curl_easy_setopt(this->urs_handle, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(this->urs_handle, CURLOPT_HEADERFUNCTION, nullptr);
+    curl_easy_setopt(this->urs_handle, CURLOPT_HEADERDATA, nullptr);
+    curl_easy_setopt(this->urs_handle, CURLOPT_WRITEFUNCTION, write_cb);
+    curl_easy_setopt(this->urs_handle, CURLOPT_WRITEDATA, this);
+    curl_easy_setopt(this->urs_handle, CURLOPT_ERRORBUFFER,
+                     this->urs_error_buffer);
+}
+
+size_t url_range_source::get_fetched_size()
+{
+    std::lock_guard<std::mutex> lg(this->urs_mutex);
+    size_t retval = this->urs_fetched_count * BLOCK_SIZE;
+
+    if (!this->urs_fetched.empty() && this->urs_fetched.back()) {
+        // The last block is usually short.
+        retval -= this->urs_fetched.size() * BLOCK_SIZE - this->urs_size;
+    }
+
+    return retval;
+}
+
+Result<void, string> url_range_source::fetch_range(file_range fr)
+{
+    if (fr.fr_size <= 0 || fr.fr_offset >= this->urs_size) {
+        return Ok();
+    }
+
+    off_t end = std::min((off_t) fr.next_offset(), this->urs_size);
+    size_t first = fr.fr_offset / BLOCK_SIZE;
+    size_t last = (end + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    std::lock_guard<std::mutex> lg(this->urs_mutex);
+
+    // Missing blocks that are next to each other are fetched together.
+    while (first < last) {
+        if (this->urs_fetched[first]) {
+            first += 1;
+            continue;
+        }
+
+        size_t run_end = first + 1;
+
+        while (run_end < last && !this->urs_fetched[run_end]) {
+            run_end += 1;
+        }
+
+        auto res = this->fetch_blocks(first, run_end);
+
+        if (res.isErr()) {
+            return res;
+        }
+        first = run_end;
+    }
+
+    return Ok();
+}
+
+Result<void, string> url_range_source::fetch_blocks(size_t first, size_t last)
+{
+    off_t start = first * BLOCK_SIZE;
+    off_t end = std::min((off_t) (last * BLOCK_SIZE), this->urs_size);
+    auto range = fmt::format("{}-{}", start, end - 1);
+
+    log_debug("%s: fetching range %s", this->urs_url.c_str(), range.c_str());
+    this->urs_write_offset = start;
+    this->urs_write_end = end;
+    this->urs_error_buffer[0] = '\0';
+    curl_easy_setopt(this->urs_handle, CURLOPT_RANGE, range.c_str());
+
+    auto rc = curl_easy_perform(this->urs_handle);
+
+    if (rc != CURLE_OK) {
+        return Err(fmt::format("unable to fetch {} -- {}",
+                               range,
+                               this->urs_error_buffer[0] != '\0' ?
+                               this->urs_error_buffer :
+                               curl_easy_strerror(rc)));
+    }
+    if (this->urs_write_offset != end) {
+        return Err(fmt::format("short read of {}", range));
+    }
+
+    for (size_t lpc = first; lpc < last; lpc++) {
+        this->urs_fetched[lpc] = true;
+    }
+    this->urs_fetched_count += last - first;
+
+    // Writing to the file updated its modification time, put the remote one
+    // back so the logfile does not think the file was replaced.
+    struct timespec times[2] = {
+        {this->urs_mtime, 0},
+        {this->urs_mtime, 0},
+    };
+
+    log_perror(futimens(this->urs_fd, times));
+
+    return Ok();
+}
+
+size_t url_range_source::write_cb(void *contents,
+                                  size_t size,
+                                  size_t nmemb,
+                                  void *userp)
+{
+    auto urs = (url_range_source *) userp;
+    auto data = (const char *) contents;
+    size_t len = size * nmemb;
+    long response_code = 0;
+
+    // A server that ignores the range sends the whole file, which should
+    // not be written over the start of the range.
+    curl_easy_getinfo(urs->urs_handle, CURLINFO_RESPONSE_CODE, &response_code);
+    if (response_code != 206 ||
+        urs->urs_write_offset + (off_t) len > urs->urs_write_end) {
+        return 0;
+    }
+
+    size_t written = 0;
+
+    while (written < len) {
+        ssize_t rc = pwrite(urs->urs_fd,
+                            &data[written],
+                            len - written,
+                            urs->urs_write_offset);
+
+        if (rc <= 0) {
+            if (rc == -1 && errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+        written += rc;
+        urs->urs_write_offset += rc;
+    }
+
+    return len;
+}
+#endif
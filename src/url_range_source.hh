@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * @file url_range_source.hh
+ */
+
+#ifndef lnav_url_range_source_hh
+#define lnav_url_range_source_hh
+
+#ifdef HAVE_LIBCURL
+#include <time.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <curl/curl.h>
+
+#include "auto_fd.hh"
+#include "auto_mem.hh"
+#include "base/result.h"
+#include "line_buffer.hh"
+
+/**
+ * A remote file that is fetched with HTTP range requests as it is read,
+ * instead of being downloaded in full before it can be indexed.  The blocks
+ * that have been fetched are kept in a sparse, unlinked temporary file that
+ * is the same size as the remote one, so the logfile can read it like any
+ * other plain file.  The modification time of the temporary file is kept at
+ * the remote one's, so filling in blocks does not look like a change to the
+ * file.
+ */
+class url_range_source : public range_source {
+public:
+    /** The amount of the file that is fetched at a time. */
+    static const size_t BLOCK_SIZE = 1024 * 1024;
+
+    /** Smaller files are just downloaded by a url_loader. */
+    static const off_t MIN_FILE_SIZE = 16 * 1024 * 1024;
+
+    /**
+     * Check that the server can send ranges of the file at the given URL,
+     * then create the local copy and fetch the first block.  Files that are
+     * small, compressed or were modified recently, and so might be tailed,
+     * are left to url_loader.
+     *
+     * @param url The URL of the file.
+     * @return The source or the reason the file cannot be fetched in ranges.
+     */
+    static Result<std::shared_ptr<url_range_source>, std::string>
+    open(const std::string &url);
+
+    /** @return A descriptor for the local copy of the file. */
+    auto_fd copy_fd() const {
+        return this->urs_fd;
+    };
+
+    /** @return The size of the remote file. */
+    off_t get_size() const {
+        return this->urs_size;
+    };
+
+    /** @return The number of bytes that have been fetched so far. */
+    size_t get_fetched_size();
+
+    Result<void, std::string> fetch_range(file_range fr) override;
+
+private:
+    url_range_source(const std::string &url,
+                     auto_mem<CURL> handle,
+                     auto_fd fd,
+                     off_t size,
+                     time_t mtime);
+
+    /** Fetch the blocks in [first, last) with a single request. */
+    Result<void, std::string> fetch_blocks(size_t first, size_t last);
+
+    static size_t write_cb(void *contents,
+                           size_t size,
+                           size_t nmemb,
+                           void *userp);
+
+    const std::string urs_url;
+    auto_mem<CURL> urs_handle;
+    auto_fd urs_fd;
+    const off_t urs_size;
+    const time_t urs_mtime;
+    /** Held while fetching, since the handle can only do one at a time. */
+    std::mutex urs_mutex;
+    std::vector<bool> urs_fetched;  /*< The blocks in the local copy. */
+    size_t urs_fetched_count{0};
+    off_t urs_write_offset{0};      /*< Where write_cb() writes next. */
+    off_t urs_write_end{0};         /*< The end of the range being fetched. */
+    char urs_error_buffer[CURL_ERROR_SIZE];
+};
+#endif
+
+#endif
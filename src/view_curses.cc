@@ -33,6 +33,8 @@
 
 #include <cmath>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "auto_mem.hh"
 #include "base/lnav_log.hh"
@@ -266,6 +268,72 @@ struct utf_to_display_adjustment {
     };
 };
 
+static std::unordered_map<WINDOW *, vector<size_t>> &row_stamps()
+{
+    static std::unordered_map<WINDOW *, vector<size_t>> retval;
+
+    return retval;
+}
+
+static inline size_t hash_combine(size_t seed, size_t value)
+{
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+size_t view_curses::row_stamp(size_t seed,
+                              attr_line_t &al,
+                              const struct line_range &lr,
+                              view_colors::role_t base_role)
+{
+    const auto &line = al.get_string();
+    size_t retval = seed;
+
+    retval = hash_combine(retval, std::hash<string>()(line));
+    retval = hash_combine(retval, lr.lr_start);
+    retval = hash_combine(retval, lr.lr_end);
+    retval = hash_combine(retval, base_role);
+    for (const auto &attr : al.get_attrs()) {
+        retval = hash_combine(retval, (size_t) attr.sa_type);
+        retval = hash_combine(retval, attr.sa_range.lr_start);
+        retval = hash_combine(retval, attr.sa_range.lr_end);
+        retval = hash_combine(retval, (size_t) attr.sa_value.sav_int);
+    }
+
+    return retval == 0 ? 1 : retval;
+}
+
+bool view_curses::is_row_current(WINDOW *window, int y, size_t stamp)
+{
+    auto &rows = row_stamps();
+    auto iter = rows.find(window);
+
+    return iter != rows.end() &&
+           y >= 0 && y < (int) iter->second.size() &&
+           iter->second[y] == stamp;
+}
+
+void view_curses::set_row_stamp(WINDOW *window, int y, size_t stamp)
+{
+    if (y < 0) {
+        return;
+    }
+
+    auto &stamps = row_stamps()[window];
+
+    if (y >= (int) stamps.size()) {
+        if (stamp == 0) {
+            return;
+        }
+        stamps.resize(y + 1, 0);
+    }
+    stamps[y] = stamp;
+}
+
+void view_curses::invalidate_rows()
+{
+    row_stamps().clear();
+}
+
 void view_curses::mvwattrline(WINDOW *window,
                               int y,
                               int x,
@@ -283,83 +351,141 @@ void view_curses::mvwattrline(WINDOW *window,
     char *expanded_line;
     int exp_index = 0;
     int exp_offset = 0;
-    string full_line;
+    const char *full_line;
+    int full_line_len;
 
     require(lr.lr_end >= 0);
 
+    set_row_stamp(window, y, 0);
+
     line_width    = lr.length();
-    tab_count     = count(line.begin(), line.end(), '\t');
-    expanded_line = (char *)alloca(line.size() + tab_count * 8 + 1);
 
     short *fg_color = (short *) alloca(line_width * sizeof(short));
     bool has_fg = false;
     short *bg_color = (short *) alloca(line_width * sizeof(short));
     bool has_bg = false;
 
-    for (size_t lpc = 0; lpc < line.size(); lpc++) {
-        int exp_start_index = exp_index;
-        unsigned char ch = static_cast<unsigned char>(line[lpc]);
+    // Most lines are plain ASCII, those can be drawn as-is without
+    // expanding tabs or adjusting the attributes for multi-byte chars.
+    bool plain = std::none_of(line.begin(), line.end(), [](char ch) {
+        return ch == '\t' || ch == '\r' || ch == '\n' || ch == '\0' ||
+               (ch & 0x80);
+    });
 
-        switch (ch) {
-        case '\t':
-            do {
+    if (plain) {
+        full_line = line.c_str();
+        full_line_len = line.size();
+    } else {
+        tab_count     = count(line.begin(), line.end(), '\t');
+        expanded_line = (char *)alloca(line.size() + tab_count * 8 + 1);
+
+        for (size_t lpc = 0; lpc < line.size(); lpc++) {
+            int exp_start_index = exp_index;
+            unsigned char ch = static_cast<unsigned char>(line[lpc]);
+
+            switch (ch) {
+            case '\t':
+                do {
+                    expanded_line[exp_index] = ' ';
+                    exp_index += 1;
+                } while (exp_index % 8);
+                utf_adjustments.emplace_back(lpc, exp_index - exp_start_index - 1);
+                break;
+
+            case '\r':
+                /* exp_index = -1; */
+                break;
+
+            case '\n':
                 expanded_line[exp_index] = ' ';
                 exp_index += 1;
-            } while (exp_index % 8);
-            utf_adjustments.emplace_back(lpc, exp_index - exp_start_index - 1);
-            break;
-
-        case '\r':
-            /* exp_index = -1; */
-            break;
-
-        case '\n':
-            expanded_line[exp_index] = ' ';
-            exp_index += 1;
-            break;
-
-        default: {
-            int offset = 0;
-
-            expanded_line[exp_index] = line[lpc];
-            exp_index += 1;
-            if ((ch & 0xf8) == 0xf0) {
-                offset = -3;
-            } else if ((ch & 0xf0) == 0xe0) {
-                offset = -2;
-            } else if ((ch & 0xe0) == 0xc0) {
-                offset = -1;
-            }
+                break;
 
-            if (offset) {
-                exp_offset += offset;
-                utf_adjustments.emplace_back(lpc, offset);
-                for (; offset && (lpc + 1) < line.size(); lpc++, offset++) {
-                    expanded_line[exp_index] = line[lpc + 1];
-                    exp_index += 1;
+            default: {
+                int offset = 0;
+
+                expanded_line[exp_index] = line[lpc];
+                exp_index += 1;
+                if ((ch & 0xf8) == 0xf0) {
+                    offset = -3;
+                } else if ((ch & 0xf0) == 0xe0) {
+                    offset = -2;
+                } else if ((ch & 0xe0) == 0xc0) {
+                    offset = -1;
+                }
+
+                if (offset) {
+                    exp_offset += offset;
+                    utf_adjustments.emplace_back(lpc, offset);
+                    for (; offset && (lpc + 1) < line.size(); lpc++, offset++) {
+                        expanded_line[exp_index] = line[lpc + 1];
+                        exp_index += 1;
+                    }
                 }
+                break;
+            }
             }
-            break;
         }
+
+        expanded_line[exp_index] = '\0';
+        full_line = expanded_line;
+        full_line_len = strlen(expanded_line);
+    }
+
+    // The running total of the adjustments, so that mapping an attribute
+    // to the display does not have to walk all of them.
+    vector<int> adjustment_totals;
+
+    if (!utf_adjustments.empty()) {
+        adjustment_totals.resize(utf_adjustments.size() + 1, 0);
+        for (size_t lpc = 0; lpc < utf_adjustments.size(); lpc++) {
+            adjustment_totals[lpc + 1] =
+                adjustment_totals[lpc] + utf_adjustments[lpc].uda_offset;
         }
     }
 
-    expanded_line[exp_index] = '\0';
-    full_line = string(expanded_line);
+    auto to_display = [&](int origin) {
+        auto adj_iter = lower_bound(
+            utf_adjustments.begin(), utf_adjustments.end(), origin,
+            [](const utf_to_display_adjustment &adj, int off) {
+                return adj.uda_origin < off;
+            });
+
+        return origin +
+               adjustment_totals[distance(utf_adjustments.begin(), adj_iter)];
+    };
 
     view_colors &vc = view_colors::singleton();
     text_attrs = vc.attrs_for_role(base_role);
     attrs      = text_attrs;
     wmove(window, y, x);
     wattron(window, attrs);
-    if (lr.lr_start < (int)full_line.size()) {
-        waddnstr(window, &full_line.c_str()[lr.lr_start], line_width);
+    if (lr.lr_start < full_line_len) {
+        waddnstr(window, &full_line[lr.lr_start], line_width);
     }
-    if (lr.lr_end > (int)full_line.size()) {
-        whline(window, ' ', lr.lr_end - (full_line.size() + exp_offset));
+    if (lr.lr_end > full_line_len) {
+        whline(window, ' ', lr.lr_end - (full_line_len + exp_offset));
     }
     wattroff(window, attrs);
 
+    // The attributes are applied to a copy of the row that is read and
+    // written back once, instead of once for every attribute.
+    cchar_t *row_ch = (cchar_t *) alloca((line_width + 1) * sizeof(cchar_t));
+    bool row_loaded = false, row_dirty = false;
+    auto load_row = [&]() {
+        if (!row_loaded) {
+            mvwin_wchnstr(window, y, x, row_ch, line_width);
+            row_loaded = true;
+        }
+    };
+    auto flush_row = [&]() {
+        if (row_dirty) {
+            mvwadd_wchnstr(window, y, x, row_ch, line_width);
+            row_dirty = false;
+        }
+        row_loaded = false;
+    };
+
     stable_sort(sa.begin(), sa.end());
     for (iter = sa.begin(); iter != sa.end(); ++iter) {
         struct line_range attr_range = iter->sa_range;
@@ -375,17 +501,10 @@ void view_curses::mvwattrline(WINDOW *window,
             continue;
         }
 
-        for (const auto &adj : utf_adjustments) {
-            if (adj.uda_origin < iter->sa_range.lr_start) {
-                attr_range.lr_start += adj.uda_offset;
-            }
-        }
-
-        if (attr_range.lr_end != -1) {
-            for (const auto &adj : utf_adjustments) {
-                if (adj.uda_origin < iter->sa_range.lr_end) {
-                    attr_range.lr_end += adj.uda_offset;
-                }
+        if (!utf_adjustments.empty()) {
+            attr_range.lr_start = to_display(attr_range.lr_start);
+            if (attr_range.lr_end != -1) {
+                attr_range.lr_end = to_display(attr_range.lr_end);
             }
         }
 
@@ -397,6 +516,7 @@ void view_curses::mvwattrline(WINDOW *window,
         attr_range.lr_end = min(line_width, attr_range.lr_end - lr.lr_start);
 
         if (iter->sa_type == &VC_GRAPHIC) {
+            flush_row();
             for (int index = attr_range.lr_start;
                 index < attr_range.lr_end;
                 index++) {
@@ -437,33 +557,32 @@ void view_curses::mvwattrline(WINDOW *window,
             }
 
             if (attrs || color_pair > 0) {
-                int x_pos = x + attr_range.lr_start;
                 int ch_width = min(awidth, (line_width - attr_range.lr_start));
-                cchar_t row_ch[ch_width + 1];
+                cchar_t *range_ch = &row_ch[attr_range.lr_start];
 
-                mvwin_wchnstr(window, y, x_pos, row_ch, ch_width);
+                load_row();
                 for (int lpc = 0; lpc < ch_width; lpc++) {
                     bool clear_rev = false;
 
-                    if (row_ch[lpc].attr & A_REVERSE && attrs & A_REVERSE) {
+                    if (range_ch[lpc].attr & A_REVERSE && attrs & A_REVERSE) {
                         clear_rev = true;
                     }
                     if (color_pair > 0) {
-                        row_ch[lpc].attr =
-                            attrs | (row_ch[lpc].attr & ~A_COLOR);
+                        range_ch[lpc].attr =
+                            attrs | (range_ch[lpc].attr & ~A_COLOR);
 #ifdef NCURSES_EXT_COLORS
-                        row_ch[lpc].ext_color = color_pair;
+                        range_ch[lpc].ext_color = color_pair;
 #else
-                        row_ch[lpc].attr |= COLOR_PAIR(color_pair);
+                        range_ch[lpc].attr |= COLOR_PAIR(color_pair);
 #endif
                     } else {
-                        row_ch[lpc].attr |= attrs;
+                        range_ch[lpc].attr |= attrs;
                     }
                     if (clear_rev) {
-                        row_ch[lpc].attr &= ~A_REVERSE;
+                        range_ch[lpc].attr &= ~A_REVERSE;
                     }
                 }
-                mvwadd_wchnstr(window, y, x_pos, row_ch, ch_width);
+                row_dirty = true;
             }
         }
     }
@@ -477,12 +596,8 @@ void view_curses::mvwattrline(WINDOW *window,
             memset(bg_color, -1, line_width * sizeof(short));
         }
 
-        int x_pos = x + lr.lr_start;
-        int ch_width = lr.length();
-        cchar_t row_ch[ch_width + 1];
-
-        mvwin_wchnstr(window, y, x_pos, row_ch, ch_width);
-        for (int lpc = 0; lpc < ch_width; lpc++) {
+        load_row();
+        for (int lpc = 0; lpc < line_width; lpc++) {
             if (fg_color[lpc] == -1 && bg_color[lpc] == -1) {
                 continue;
             }
@@ -496,9 +611,11 @@ void view_curses::mvwattrline(WINDOW *window,
             row_ch[lpc].attr |= COLOR_PAIR(color_pair);
 #endif
         }
-        mvwadd_wchnstr(window, y, x_pos, row_ch, ch_width);
+        row_dirty = true;
     }
 #endif
+
+    flush_row();
 }
 
 attr_t view_colors::BASIC_HL_PAIRS[view_colors::BASIC_COLOR_COUNT] = {
@@ -690,6 +807,9 @@ void view_colors::init_roles(const lnav_theme &lt,
     rgb_color fg, bg;
     string err;
 
+    // The roles are about to be drawn differently.
+    view_curses::invalidate_rows();
+
     if (COLORS == 256) {
         const style_config &ident_sc = lt.lt_style_identifier;
         int ident_bg = (lnav_config.lc_ui_default_colors ? -1 : COLOR_BLACK);
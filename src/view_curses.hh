@@ -558,6 +558,32 @@ public:
                             view_colors::role_t base_role =
                                 view_colors::VCR_TEXT);
 
+    /**
+     * Compute a stamp for a row that can be compared against the stamp of
+     * what was last drawn on that row of a window, so that drawing the
+     * same content again can be skipped.
+     *
+     * @param seed A hash of the position and anything else that changes
+     *   how the row is drawn.
+     * @return The stamp, which is never zero.
+     */
+    static size_t row_stamp(size_t seed,
+                            attr_line_t &al,
+                            const struct line_range &lr,
+                            view_colors::role_t base_role);
+
+    /** @return True if the row was last drawn with the given stamp. */
+    static bool is_row_current(WINDOW *window, int y, size_t stamp);
+
+    /**
+     * Record the stamp of what was just drawn on a row.  Drawing a row
+     * with mvwattrline() resets the stamp, so this has to be called after.
+     */
+    static void set_row_stamp(WINDOW *window, int y, size_t stamp);
+
+    /** Forget the stamps of all rows, so that they are all drawn again. */
+    static void invalidate_rows();
+
 protected:
     bool vc_visible{true};
     /** Flag to indicate if a display update is needed. */
@@ -31,7 +31,7 @@
 
 #include "lnav.hh"
 #include "sql_util.hh"
-#include "pretty_printer.hh"
+#include "pretty_text_source.hh"
 #include "environ_vtab.hh"
 #include "vtab_module.hh"
 #include "shlex.hh"
@@ -70,11 +70,39 @@ static void open_pretty_view(void)
     textview_curses *pretty_tc = &lnav_data.ld_views[LNV_PRETTY];
     textview_curses *log_tc = &lnav_data.ld_views[LNV_LOG];
     textview_curses *text_tc = &lnav_data.ld_views[LNV_TEXT];
-    attr_line_t full_text;
+    // The messages that were formatted the last time the view was opened,
+    // so toggling the view on the same messages does not format them again.
+    static map<pair<const logfile *, size_t>,
+        shared_ptr<pretty_text_source::segment>> segment_cache;
+    map<pair<const logfile *, size_t>,
+        shared_ptr<pretty_text_source::segment>> used_segments;
+    size_t min_lines = std::max(100, (int) pretty_tc->get_height() * 2);
+    auto *pts = new pretty_text_source();
+
+    auto add_segment = [&](const logfile *lf,
+                           size_t line_number,
+                           const string &text,
+                           const string_attrs_t &sa,
+                           const attr_line_t &prefix,
+                           bool trim_last) {
+        auto key = make_pair(lf, line_number);
+        auto iter = segment_cache.find(key);
+        shared_ptr<pretty_text_source::segment> seg;
+
+        if (iter != segment_cache.end() && iter->second->is_for(text, prefix)) {
+            seg = iter->second;
+        } else {
+            seg = make_shared<pretty_text_source::segment>(
+                text, sa, prefix, trim_last);
+        }
+        used_segments[key] = seg;
+        pts->add_segment(seg, min_lines);
+    };
 
     delete pretty_tc->get_sub_source();
     pretty_tc->set_sub_source(nullptr);
     if (top_tc->get_inner_height() == 0) {
+        delete pts;
         pretty_tc->set_sub_source(new plain_text_source(NOTHING_MSG));
         return;
     }
@@ -106,30 +134,16 @@ static void open_pretty_view(void)
             attr_line_t orig_al = al.subline(orig_lr.lr_start, orig_lr.length());
             attr_line_t prefix_al = al.subline(0, orig_lr.lr_start);
 
-            data_scanner ds(orig_al.get_string());
-            pretty_printer pp(&ds, orig_al.get_attrs());
-            attr_line_t pretty_al;
-            vector<attr_line_t> pretty_lines;
-
             // TODO: dump more details of the line in the output.
-            pp.append_to(pretty_al);
-            pretty_al.split_lines(pretty_lines);
-
-            for (auto &pretty_line : pretty_lines) {
-                if (pretty_line.empty() && &pretty_line == &pretty_lines.back()) {
-                    break;
-                }
-                pretty_line.insert(0, prefix_al);
-                pretty_line.append("\n");
-                full_text.append(pretty_line);
-            }
+            add_segment(lf.get(),
+                        distance(lf->begin(), ll_start),
+                        orig_al.get_string(),
+                        orig_al.get_attrs(),
+                        prefix_al,
+                        true);
 
             first_line = false;
         }
-
-        if (!full_text.empty()) {
-            full_text.erase(full_text.length() - 1, 1);
-        }
     }
     else if (top_tc == text_tc) {
         shared_ptr<logfile> lf = lnav_data.ld_text_source.current_file();
@@ -139,15 +153,15 @@ static void open_pretty_view(void)
             shared_buffer_ref sbr;
 
             lf->read_full_message(ll, sbr);
-            data_scanner ds(sbr);
-            string_attrs_t sa;
-            pretty_printer pp(&ds, sa);
-
-            pp.append_to(full_text);
+            add_segment(lf.get(),
+                        (size_t) vl,
+                        string(sbr.get_data(), sbr.length()),
+                        string_attrs_t(),
+                        attr_line_t(),
+                        false);
         }
     }
-    auto *pts = new plain_text_source();
-    pts->replace_with(full_text);
+    segment_cache.swap(used_segments);
     pretty_tc->set_sub_source(pts);
     if (lnav_data.ld_last_pretty_print_top != log_tc->get_top()) {
         pretty_tc->set_top(vis_line_t(0));
@@ -393,6 +393,184 @@ struct sqlite_func_adapter<Return (*)(Args...), f> {
 extern std::string vtab_module_schemas;
 extern std::map<intern_string_t, std::string> vtab_module_ddls;
 
+/**
+ * A block of rows from a table with the values stored by column.  A table
+ * can fill a batch with many rows at once, instead of being asked for
+ * each value separately, and native code can read the batch without going
+ * through SQLite.
+ */
+class vtab_row_batch {
+public:
+    enum class value_type : uint8_t {
+        NULL_VALUE,
+        INTEGER,
+        FLOAT,
+        TEXT,
+    };
+
+    /**
+     * @param column_count The number of columns in the table.
+     * @param capacity The maximum number of rows in the batch.
+     */
+    vtab_row_batch(int column_count, size_t capacity)
+        : vrb_column_count(column_count), vrb_capacity(capacity) {
+        this->vrb_cells.resize(column_count * capacity);
+        this->vrb_rowids.reserve(capacity);
+    };
+
+    int column_count() const {
+        return this->vrb_column_count;
+    };
+
+    size_t size() const {
+        return this->vrb_rowids.size();
+    };
+
+    bool empty() const {
+        return this->vrb_rowids.empty();
+    };
+
+    bool full() const {
+        return this->vrb_rowids.size() >= this->vrb_capacity;
+    };
+
+    void clear() {
+        this->vrb_rowids.clear();
+        this->vrb_text.clear();
+    };
+
+    /**
+     * Start a new row, the values in the row are all NULL until they are
+     * set.
+     */
+    void add_row(sqlite_int64 rowid) {
+        require(!this->full());
+
+        size_t row = this->vrb_rowids.size();
+
+        this->vrb_rowids.push_back(rowid);
+        for (int col = 0; col < this->vrb_column_count; col++) {
+            this->cell_at(row, col).c_type = value_type::NULL_VALUE;
+        }
+    };
+
+    /** Set a value in the last row that was added. */
+    void set(int col, int64_t val) {
+        cell &c = this->last_cell(col);
+
+        c.c_type = value_type::INTEGER;
+        c.c_value.i = val;
+    };
+
+    void set(int col, double val) {
+        cell &c = this->last_cell(col);
+
+        c.c_type = value_type::FLOAT;
+        c.c_value.d = val;
+    };
+
+    void set(int col, const char *str, size_t len) {
+        cell &c = this->last_cell(col);
+
+        c.c_type = value_type::TEXT;
+        c.c_value.s.s_offset = this->vrb_text.size();
+        c.c_value.s.s_length = len;
+        this->vrb_text.append(str, len);
+    };
+
+    void set(int col, const std::string &str) {
+        this->set(col, str.c_str(), str.length());
+    };
+
+    /** Set a text value, a nullptr leaves the value NULL. */
+    void set(int col, const char *str) {
+        if (str != nullptr) {
+            this->set(col, str, strlen(str));
+        }
+    };
+
+    sqlite_int64 get_rowid(size_t row) const {
+        return this->vrb_rowids[row];
+    };
+
+    value_type get_type(size_t row, int col) const {
+        return this->cell_at(row, col).c_type;
+    };
+
+    int64_t get_int(size_t row, int col) const {
+        return this->cell_at(row, col).c_value.i;
+    };
+
+    double get_float(size_t row, int col) const {
+        return this->cell_at(row, col).c_value.d;
+    };
+
+    string_fragment get_text(size_t row, int col) const {
+        const cell &c = this->cell_at(row, col);
+
+        return string_fragment(this->vrb_text.c_str(),
+                               c.c_value.s.s_offset,
+                               c.c_value.s.s_offset + c.c_value.s.s_length);
+    };
+
+    /** Return a value from the batch as the result of an xColumn call. */
+    void to_sqlite(sqlite3_context *ctx, size_t row, int col) const {
+        const cell &c = this->cell_at(row, col);
+
+        switch (c.c_type) {
+            case value_type::NULL_VALUE:
+                sqlite3_result_null(ctx);
+                break;
+            case value_type::INTEGER:
+                sqlite3_result_int64(ctx, c.c_value.i);
+                break;
+            case value_type::FLOAT:
+                sqlite3_result_double(ctx, c.c_value.d);
+                break;
+            case value_type::TEXT:
+                sqlite3_result_text(ctx,
+                                    &this->vrb_text[c.c_value.s.s_offset],
+                                    c.c_value.s.s_length,
+                                    SQLITE_TRANSIENT);
+                break;
+        }
+    };
+
+private:
+    struct cell {
+        value_type c_type;
+        union {
+            int64_t i;
+            double d;
+            struct {
+                uint32_t s_offset;
+                uint32_t s_length;
+            } s;
+        } c_value;
+    };
+
+    cell &cell_at(size_t row, int col) {
+        return this->vrb_cells[col * this->vrb_capacity + row];
+    };
+
+    const cell &cell_at(size_t row, int col) const {
+        return this->vrb_cells[col * this->vrb_capacity + row];
+    };
+
+    cell &last_cell(int col) {
+        require(!this->vrb_rowids.empty());
+        require(col >= 0 && col < this->vrb_column_count);
+
+        return this->cell_at(this->vrb_rowids.size() - 1, col);
+    };
+
+    int vrb_column_count;
+    size_t vrb_capacity;
+    std::vector<cell> vrb_cells;
+    std::vector<sqlite_int64> vrb_rowids;
+    std::string vrb_text;
+};
+
 class vtab_index_constraints {
 public:
     vtab_index_constraints(const sqlite3_index_info *index_info)
@@ -652,21 +830,152 @@ struct vtab_module {
     void addUpdate(...) {
     };
 
+    /** The number of rows that are filled in at a time for batch tables. */
+    static const size_t BATCH_ROWS = 256;
+
+    /**
+     * The cursor for a table that has a fill_batch() method, which adds
+     * the rows from the cursor to a vtab_row_batch until the batch is full
+     * or there are no more rows.  The table also needs a COLUMN_COUNT.
+     */
+    struct batch_cursor {
+        explicit batch_cursor(sqlite3_vtab *vt)
+            : bc_cursor(vt), bc_batch(T::COLUMN_COUNT, BATCH_ROWS) {
+            this->base.pVtab = vt;
+            this->fill();
+        };
+
+        int fill() {
+            T handler;
+
+            this->bc_batch.clear();
+            this->bc_row = 0;
+            return handler.fill_batch(this->bc_cursor, this->bc_batch);
+        };
+
+        sqlite3_vtab_cursor base;
+        typename T::cursor bc_cursor;
+        vtab_row_batch bc_batch;
+        size_t bc_row{0};
+    };
+
+    static int tbvt_open(sqlite3_vtab *p_svt, sqlite3_vtab_cursor **pp_cursor)
+    {
+        p_svt->zErrMsg = nullptr;
+
+        *pp_cursor = (sqlite3_vtab_cursor *) new batch_cursor(p_svt);
+
+        return SQLITE_OK;
+    }
+
+    static int tbvt_next(sqlite3_vtab_cursor *cur)
+    {
+        auto *p_cur = (batch_cursor *) cur;
+
+        p_cur->bc_row += 1;
+        if (p_cur->bc_row >= p_cur->bc_batch.size() &&
+            p_cur->bc_batch.full()) {
+            return p_cur->fill();
+        }
+
+        return SQLITE_OK;
+    }
+
+    static int tbvt_eof(sqlite3_vtab_cursor *cur)
+    {
+        auto *p_cur = (batch_cursor *) cur;
+
+        return p_cur->bc_row >= p_cur->bc_batch.size();
+    }
+
+    static int tbvt_close(sqlite3_vtab_cursor *cur)
+    {
+        delete (batch_cursor *) cur;
+
+        return SQLITE_OK;
+    }
+
+    static int tbvt_rowid(sqlite3_vtab_cursor *cur, sqlite_int64 *p_rowid) {
+        auto *p_cur = (batch_cursor *) cur;
+
+        *p_rowid = p_cur->bc_batch.get_rowid(p_cur->bc_row);
+
+        return SQLITE_OK;
+    };
+
+    static int tbvt_column(sqlite3_vtab_cursor *cur, sqlite3_context *ctx, int col) {
+        auto *p_cur = (batch_cursor *) cur;
+
+        p_cur->bc_batch.to_sqlite(ctx, p_cur->bc_row, col);
+
+        return SQLITE_OK;
+    };
+
+    static int tbvt_filter(sqlite3_vtab_cursor *p_vtc,
+                           int idxNum, const char *idxStr,
+                           int argc, sqlite3_value **argv) {
+        auto *p_cur = (batch_cursor *) p_vtc;
+        int rc = p_cur->bc_cursor.reset();
+
+        if (rc != SQLITE_OK) {
+            return rc;
+        }
+
+        return p_cur->fill();
+    }
+
+    /**
+     * Read all of the rows of a table that has a fill_batch() method
+     * without going through SQLite.
+     *
+     * @param func The function to call with each batch of rows.
+     */
+    template<typename F>
+    static void for_each_batch(F func) {
+        typename T::cursor cur(nullptr);
+        vtab_row_batch batch(T::COLUMN_COUNT, BATCH_ROWS);
+        T handler;
+
+        do {
+            batch.clear();
+            handler.fill_batch(cur, batch);
+            if (!batch.empty()) {
+                func(batch);
+            }
+        } while (batch.full());
+    };
+
+    template<typename U>
+    auto addCursor(U u) -> decltype(&U::fill_batch, void()) {
+        this->vm_module.xOpen = tbvt_open;
+        this->vm_module.xNext = tbvt_next;
+        this->vm_module.xEof = tbvt_eof;
+        this->vm_module.xClose = tbvt_close;
+        this->vm_module.xRowid = tbvt_rowid;
+        this->vm_module.xFilter = tbvt_filter;
+        this->vm_module.xColumn = tbvt_column;
+    };
+
+    template<typename U>
+    void addCursor(...) {
+        this->vm_module.xOpen = tvt_open;
+        this->vm_module.xNext = tvt_next;
+        this->vm_module.xEof = tvt_eof;
+        this->vm_module.xClose = tvt_close;
+        this->vm_module.xRowid = tvt_rowid;
+        this->vm_module.xFilter = vt_filter;
+        this->vm_module.xColumn = tvt_column;
+    };
+
     vtab_module() noexcept {
         memset(&this->vm_module, 0, sizeof(this->vm_module));
         this->vm_module.iVersion = 0;
         this->vm_module.xCreate = tvt_create;
         this->vm_module.xConnect = tvt_create;
-        this->vm_module.xOpen = tvt_open;
-        this->vm_module.xNext = tvt_next;
-        this->vm_module.xEof = tvt_eof;
-        this->vm_module.xClose = tvt_close;
         this->vm_module.xDestroy = tvt_destructor;
-        this->vm_module.xRowid = tvt_rowid;
         this->vm_module.xDisconnect = tvt_destructor;
         this->vm_module.xBestIndex = vt_best_index;
-        this->vm_module.xFilter = vt_filter;
-        this->vm_module.xColumn = tvt_column;
+        this->addCursor<T>(T());
         this->addUpdate<T>(T());
     };
 
@@ -0,0 +1,784 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file json_fast_parse.cc
+ */
+
+#include "config.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "yajlpp/json_fast_parse.hh"
+
+/**
+ * Containers nested deeper than this are left to yajl so that the stack
+ * of open containers does not need to be allocated.
+ */
+static const size_t MAX_DEPTH = 128;
+
+static bool is_json_space(unsigned char ch)
+{
+    switch (ch) {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\v':
+        case '\f':
+        case '\r':
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool is_json_digit(unsigned char ch)
+{
+    return '0' <= ch && ch <= '9';
+}
+
+/**
+ * @return The offset of the first character at or after the given offset
+ *   that ends a run of plain string characters: a quote, a backslash, a
+ *   control character, or a byte that is not ASCII.
+ */
+static size_t scan_plain(const unsigned char *buf, size_t off, size_t len)
+{
+#if defined(__SSE2__)
+    const __m128i quote_vec = _mm_set1_epi8('"');
+    const __m128i backslash_vec = _mm_set1_epi8('\\');
+    const __m128i space_vec = _mm_set1_epi8(0x20);
+
+    while (off + 16 <= len) {
+        __m128i block = _mm_loadu_si128((const __m128i *) &buf[off]);
+        // The signed compare also catches the bytes with the high bit set.
+        int mask = _mm_movemask_epi8(_mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(block, quote_vec),
+                         _mm_cmpeq_epi8(block, backslash_vec)),
+            _mm_cmplt_epi8(block, space_vec)));
+
+        if (mask != 0) {
+            return off + __builtin_ctz(mask);
+        }
+        off += 16;
+    }
+#endif
+
+    while (off < len) {
+        unsigned char ch = buf[off];
+
+        if (ch == '"' || ch == '\\' || ch < 0x20 || ch >= 0x80) {
+            break;
+        }
+        off += 1;
+    }
+
+    return off;
+}
+
+/**
+ * Skip over a multi-byte UTF-8 character with the same checks that yajl
+ * does when validating strings.
+ */
+static bool skip_utf8_char(const unsigned char *buf, size_t &off, size_t len)
+{
+    unsigned char ch = buf[off];
+    size_t extra;
+
+    if ((ch >> 5) == 0x6) {
+        extra = 1;
+    } else if ((ch >> 4) == 0xe) {
+        extra = 2;
+    } else if ((ch >> 3) == 0x1e) {
+        extra = 3;
+    } else {
+        return false;
+    }
+
+    if (off + extra >= len) {
+        return false;
+    }
+    for (size_t lpc = 1; lpc <= extra; lpc++) {
+        if ((buf[off + lpc] >> 6) != 0x2) {
+            return false;
+        }
+    }
+    off += extra + 1;
+
+    return true;
+}
+
+/**
+ * Parse the string that starts at the quote at the given offset.  Strings
+ * without escapes are passed back as a pointer into the buffer, the
+ * others are unescaped into the scratch buffer.
+ */
+static bool parse_string(const unsigned char *buf,
+                         size_t &off,
+                         size_t len,
+                         std::string &scratch,
+                         const unsigned char *&str_out,
+                         size_t &len_out)
+{
+    size_t seg_start = off + 1;
+    size_t pos = seg_start;
+    bool escaped = false;
+
+    for (;;) {
+        pos = scan_plain(buf, pos, len);
+        if (pos >= len) {
+            return false;
+        }
+
+        unsigned char ch = buf[pos];
+
+        if (ch == '"') {
+            break;
+        }
+        if (ch == '\\') {
+            char unescaped;
+
+            if (pos + 1 >= len) {
+                return false;
+            }
+            switch (buf[pos + 1]) {
+                case '"':
+                case '\\':
+                case '/':
+                    unescaped = buf[pos + 1];
+                    break;
+                case 'b':
+                    unescaped = '\b';
+                    break;
+                case 'f':
+                    unescaped = '\f';
+                    break;
+                case 'n':
+                    unescaped = '\n';
+                    break;
+                case 'r':
+                    unescaped = '\r';
+                    break;
+                case 't':
+                    unescaped = '\t';
+                    break;
+                default:
+                    // Unicode escapes and errors are left to yajl.
+                    return false;
+            }
+            if (!escaped) {
+                scratch.clear();
+                escaped = true;
+            }
+            scratch.append((const char *) &buf[seg_start], pos - seg_start);
+            scratch.push_back(unescaped);
+            pos += 2;
+            seg_start = pos;
+        } else if (ch < 0x20) {
+            return false;
+        } else if (!skip_utf8_char(buf, pos, len)) {
+            return false;
+        }
+    }
+
+    if (escaped) {
+        scratch.append((const char *) &buf[seg_start], pos - seg_start);
+        str_out = (const unsigned char *) scratch.data();
+        len_out = scratch.size();
+    } else {
+        str_out = &buf[off + 1];
+        len_out = pos - off - 1;
+    }
+    off = pos + 1;
+
+    return true;
+}
+
+static bool parse_number(const unsigned char *buf,
+                         size_t &off,
+                         size_t len,
+                         bool &is_integer_out)
+{
+    size_t pos = off;
+
+    is_integer_out = true;
+
+    if (pos < len && buf[pos] == '-') {
+        pos += 1;
+    }
+    if (pos >= len) {
+        return false;
+    }
+    if (buf[pos] == '0') {
+        pos += 1;
+    } else if ('1' <= buf[pos] && buf[pos] <= '9') {
+        while (pos < len && is_json_digit(buf[pos])) {
+            pos += 1;
+        }
+    } else {
+        return false;
+    }
+
+    if (pos < len && buf[pos] == '.') {
+        size_t digits_start = pos += 1;
+
+        while (pos < len && is_json_digit(buf[pos])) {
+            pos += 1;
+        }
+        if (pos == digits_start) {
+            return false;
+        }
+        is_integer_out = false;
+    }
+
+    if (pos < len && (buf[pos] == 'e' || buf[pos] == 'E')) {
+        is_integer_out = false;
+        pos += 1;
+        if (pos < len && (buf[pos] == '+' || buf[pos] == '-')) {
+            pos += 1;
+        }
+
+        size_t digits_start = pos;
+
+        while (pos < len && is_json_digit(buf[pos])) {
+            pos += 1;
+        }
+        if (pos == digits_start) {
+            return false;
+        }
+    }
+
+    off = pos;
+
+    return true;
+}
+
+/**
+ * Convert an integer that is short enough that it cannot overflow, the
+ * longer ones are left to yajl to check.
+ */
+static bool convert_integer(const unsigned char *num,
+                            size_t len,
+                            long long &value_out)
+{
+    bool negative = num[0] == '-';
+    size_t pos = negative ? 1 : 0;
+
+    if (len - pos > 18) {
+        return false;
+    }
+
+    value_out = 0;
+    for (; pos < len; pos++) {
+        value_out = value_out * 10 + (num[pos] - '0');
+    }
+    if (negative) {
+        value_out = -value_out;
+    }
+
+    return true;
+}
+
+static bool convert_double(const unsigned char *num,
+                           size_t len,
+                           double &value_out)
+{
+    char num_copy[64];
+
+    if (len >= sizeof(num_copy)) {
+        return false;
+    }
+    memcpy(num_copy, num, len);
+    num_copy[len] = '\0';
+    value_out = strtod(num_copy, nullptr);
+
+    return value_out != HUGE_VAL && value_out != -HUGE_VAL;
+}
+
+static bool parse_literal(const unsigned char *buf,
+                          size_t &off,
+                          size_t len,
+                          const char *literal,
+                          size_t literal_len)
+{
+    if (len - off < literal_len ||
+        memcmp(&buf[off], literal, literal_len) != 0) {
+        return false;
+    }
+    off += literal_len;
+
+    return true;
+}
+
+static inline void skip_space(const unsigned char *buf,
+                              size_t &off,
+                              size_t len)
+{
+    while (off < len && is_json_space(buf[off])) {
+        off += 1;
+    }
+}
+
+/**
+ * Parse the single JSON value that starts at the given offset.  On success,
+ * the offset is moved past the value and any white space after it.
+ */
+static json_fast_status_t parse_value(const yajl_callbacks &callbacks,
+                                      void *ctx,
+                                      const unsigned char *buf,
+                                      size_t &off,
+                                      size_t len,
+                                      std::string &scratch)
+{
+    enum {
+        NEED_VALUE,
+        NEED_VALUE_OR_CLOSE,
+        NEED_KEY,
+        NEED_KEY_OR_CLOSE,
+        NEED_COLON,
+        AFTER_VALUE,
+    } state = NEED_VALUE;
+
+    char containers[MAX_DEPTH];
+    size_t depth = 0;
+    const unsigned char *str;
+    size_t str_len;
+
+#define JFS_CALL(name, ...) \
+    if (callbacks.name != nullptr && !callbacks.name(__VA_ARGS__)) { \
+        return JFS_CANCELED; \
+    }
+
+    for (;;) {
+        skip_space(buf, off, len);
+        if (state == AFTER_VALUE && depth == 0) {
+            return JFS_OK;
+        }
+        if (off >= len) {
+            return JFS_FALLBACK;
+        }
+
+        unsigned char ch = buf[off];
+
+        switch (state) {
+            case NEED_VALUE_OR_CLOSE:
+                if (ch == ']') {
+                    off += 1;
+                    depth -= 1;
+                    JFS_CALL(yajl_end_array, ctx);
+                    state = AFTER_VALUE;
+                    break;
+                }
+                // fallthrough
+            case NEED_VALUE:
+                switch (ch) {
+                    case '{':
+                    case '[':
+                        if (depth == MAX_DEPTH) {
+                            return JFS_FALLBACK;
+                        }
+                        containers[depth] = ch;
+                        depth += 1;
+                        off += 1;
+                        if (ch == '{') {
+                            JFS_CALL(yajl_start_map, ctx);
+                            state = NEED_KEY_OR_CLOSE;
+                        } else {
+                            JFS_CALL(yajl_start_array, ctx);
+                            state = NEED_VALUE_OR_CLOSE;
+                        }
+                        break;
+                    case '"':
+                        if (!parse_string(buf, off, len, scratch,
+                                          str, str_len)) {
+                            return JFS_FALLBACK;
+                        }
+                        JFS_CALL(yajl_string, ctx, str, str_len);
+                        state = AFTER_VALUE;
+                        break;
+                    case 't':
+                        if (!parse_literal(buf, off, len, "true", 4)) {
+                            return JFS_FALLBACK;
+                        }
+                        JFS_CALL(yajl_boolean, ctx, 1);
+                        state = AFTER_VALUE;
+                        break;
+                    case 'f':
+                        if (!parse_literal(buf, off, len, "false", 5)) {
+                            return JFS_FALLBACK;
+                        }
+                        JFS_CALL(yajl_boolean, ctx, 0);
+                        state = AFTER_VALUE;
+                        break;
+                    case 'n':
+                        if (!parse_literal(buf, off, len, "null", 4)) {
+                            return JFS_FALLBACK;
+                        }
+                        JFS_CALL(yajl_null, ctx);
+                        state = AFTER_VALUE;
+                        break;
+                    default: {
+                        size_t num_start = off;
+                        bool is_integer;
+
+                        if (!parse_number(buf, off, len, is_integer)) {
+                            return JFS_FALLBACK;
+                        }
+                        if (callbacks.yajl_number != nullptr) {
+                            JFS_CALL(yajl_number, ctx,
+                                     (const char *) &buf[num_start],
+                                     off - num_start);
+                        } else if (is_integer) {
+                            if (callbacks.yajl_integer != nullptr) {
+                                long long value;
+
+                                if (!convert_integer(&buf[num_start],
+                                                     off - num_start,
+                                                     value)) {
+                                    return JFS_FALLBACK;
+                                }
+                                JFS_CALL(yajl_integer, ctx, value);
+                            }
+                        } else if (callbacks.yajl_double != nullptr) {
+                            double value;
+
+                            if (!convert_double(&buf[num_start],
+                                                off - num_start,
+                                                value)) {
+                                return JFS_FALLBACK;
+                            }
+                            JFS_CALL(yajl_double, ctx, value);
+                        }
+                        state = AFTER_VALUE;
+                        break;
+                    }
+                }
+                break;
+            case NEED_KEY_OR_CLOSE:
+                if (ch == '}') {
+                    off += 1;
+                    depth -= 1;
+                    JFS_CALL(yajl_end_map, ctx);
+                    state = AFTER_VALUE;
+                    break;
+                }
+                // fallthrough
+            case NEED_KEY:
+                if (ch != '"' ||
+                    !parse_string(buf, off, len, scratch, str, str_len)) {
+                    return JFS_FALLBACK;
+                }
+                JFS_CALL(yajl_map_key, ctx, str, str_len);
+                state = NEED_COLON;
+                break;
+            case NEED_COLON:
+                if (ch != ':') {
+                    return JFS_FALLBACK;
+                }
+                off += 1;
+                state = NEED_VALUE;
+                break;
+            case AFTER_VALUE:
+                if (ch == ',') {
+                    off += 1;
+                    state = containers[depth - 1] == '{' ?
+                            NEED_KEY : NEED_VALUE;
+                } else if (ch == '}' && containers[depth - 1] == '{') {
+                    off += 1;
+                    depth -= 1;
+                    JFS_CALL(yajl_end_map, ctx);
+                } else if (ch == ']' && containers[depth - 1] == '[') {
+                    off += 1;
+                    depth -= 1;
+                    JFS_CALL(yajl_end_array, ctx);
+                } else {
+                    return JFS_FALLBACK;
+                }
+                break;
+        }
+    }
+
+#undef JFS_CALL
+}
+
+json_fast_status_t json_fast_parse(const yajl_callbacks &callbacks,
+                                   void *ctx,
+                                   const char *buffer,
+                                   size_t len)
+{
+    const auto *buf = (const unsigned char *) buffer;
+    std::string scratch;
+    size_t off = 0;
+    auto retval = parse_value(callbacks, ctx, buf, off, len, scratch);
+
+    if (retval == JFS_OK && off != len) {
+        // Trailing garbage is an error in yajl.
+        return JFS_FALLBACK;
+    }
+
+    return retval;
+}
+
+bool json_fast_path::compile(const char *ptr)
+{
+    this->jfp_components.clear();
+    if (ptr[0] == '\0') {
+        return true;
+    }
+    if (ptr[0] != '/') {
+        return false;
+    }
+
+    const char *pos = ptr + 1;
+
+    for (;;) {
+        component comp;
+        bool all_digits = true;
+
+        while (*pos != '\0' && *pos != '/') {
+            if (*pos == '~') {
+                if (pos[1] == '0') {
+                    comp.c_key.push_back('~');
+                } else if (pos[1] == '1') {
+                    comp.c_key.push_back('/');
+                } else {
+                    return false;
+                }
+                all_digits = false;
+                pos += 2;
+                continue;
+            }
+            if (!isdigit((unsigned char) *pos)) {
+                all_digits = false;
+            }
+            comp.c_key.push_back(*pos);
+            pos += 1;
+        }
+
+        if (all_digits && !comp.c_key.empty()) {
+            if (comp.c_key.size() > 9) {
+                return false;
+            }
+            comp.c_index = atoi(comp.c_key.c_str());
+        } else if (!comp.c_key.empty() &&
+                   (isdigit((unsigned char) comp.c_key[0]) ||
+                    is_json_space(comp.c_key[0]) ||
+                    comp.c_key[0] == '+' ||
+                    comp.c_key[0] == '-')) {
+            // json_ptr uses sscanf() for array indexes, so tokens that are
+            // only partly numbers are left to it.
+            return false;
+        }
+
+        this->jfp_components.emplace_back(std::move(comp));
+        if (*pos == '\0') {
+            break;
+        }
+        pos += 1;
+    }
+
+    return true;
+}
+
+/**
+ * Check the rest of the containers that were entered on the way to a value
+ * that was not in the document.
+ */
+static json_fast_status_t finish_containers(const unsigned char *buf,
+                                            size_t &off,
+                                            size_t len,
+                                            const char *containers,
+                                            size_t depth,
+                                            std::string &scratch)
+{
+    static const yajl_callbacks NO_CALLBACKS = {};
+
+    const unsigned char *str;
+    size_t str_len;
+
+    while (depth > 0) {
+        auto close = containers[depth - 1] == '{' ? '}' : ']';
+
+        skip_space(buf, off, len);
+        if (off >= len) {
+            return JFS_FALLBACK;
+        }
+        if (buf[off] == close) {
+            off += 1;
+            depth -= 1;
+            continue;
+        }
+        if (buf[off] != ',') {
+            return JFS_FALLBACK;
+        }
+        off += 1;
+        skip_space(buf, off, len);
+        if (close == '}') {
+            if (off >= len || buf[off] != '"' ||
+                !parse_string(buf, off, len, scratch, str, str_len)) {
+                return JFS_FALLBACK;
+            }
+            skip_space(buf, off, len);
+            if (off >= len || buf[off] != ':') {
+                return JFS_FALLBACK;
+            }
+            off += 1;
+        }
+        if (parse_value(NO_CALLBACKS, nullptr, buf, off, len, scratch) !=
+            JFS_OK) {
+            return JFS_FALLBACK;
+        }
+    }
+
+    skip_space(buf, off, len);
+
+    return off == len ? JFS_OK : JFS_FALLBACK;
+}
+
+json_fast_status_t json_fast_find(const json_fast_path &path,
+                                  const char *buffer,
+                                  size_t len,
+                                  const char *&value_out,
+                                  size_t &value_len_out)
+{
+    static const yajl_callbacks NO_CALLBACKS = {};
+
+    const auto *buf = (const unsigned char *) buffer;
+    char containers[MAX_DEPTH];
+    size_t depth = 0;
+    size_t off = 0;
+    std::string scratch;
+    const unsigned char *str;
+    size_t str_len;
+
+    value_out = nullptr;
+    value_len_out = 0;
+
+    skip_space(buf, off, len);
+    for (const auto &comp : path.jfp_components) {
+        if (off >= len) {
+            return JFS_FALLBACK;
+        }
+
+        auto open = buf[off];
+
+        if (open != '{' && open != '[') {
+            // The path goes through a scalar, so the target is not there.
+            if (parse_value(NO_CALLBACKS, nullptr, buf, off, len, scratch) !=
+                JFS_OK) {
+                return JFS_FALLBACK;
+            }
+            return finish_containers(buf, off, len, containers, depth,
+                                     scratch);
+        }
+        if (depth == MAX_DEPTH) {
+            return JFS_FALLBACK;
+        }
+        containers[depth] = open;
+        depth += 1;
+        off += 1;
+
+        auto close = open == '{' ? '}' : ']';
+        int32_t index = 0;
+        bool matched = false;
+
+        for (bool first = true; !matched; first = false) {
+            skip_space(buf, off, len);
+            if (off >= len) {
+                return JFS_FALLBACK;
+            }
+            if (buf[off] == close) {
+                // The container does not have the member we are after.
+                off += 1;
+                return finish_containers(buf, off, len, containers,
+                                         depth - 1, scratch);
+            }
+            if (!first) {
+                if (buf[off] != ',') {
+                    return JFS_FALLBACK;
+                }
+                off += 1;
+                skip_space(buf, off, len);
+            }
+            if (open == '{') {
+                if (off >= len || buf[off] != '"' ||
+                    !parse_string(buf, off, len, scratch, str, str_len)) {
+                    return JFS_FALLBACK;
+                }
+                skip_space(buf, off, len);
+                if (off >= len || buf[off] != ':') {
+                    return JFS_FALLBACK;
+                }
+                off += 1;
+                matched = str_len == comp.c_key.size() &&
+                          memcmp(str, comp.c_key.data(), str_len) == 0;
+            } else {
+                matched = index == comp.c_index;
+                index += 1;
+            }
+            if (matched) {
+                skip_space(buf, off, len);
+            } else if (parse_value(NO_CALLBACKS, nullptr,
+                                   buf, off, len, scratch) != JFS_OK) {
+                return JFS_FALLBACK;
+            }
+        }
+    }
+
+    size_t value_start = off;
+
+    if (parse_value(NO_CALLBACKS, nullptr, buf, off, len, scratch) !=
+        JFS_OK) {
+        return JFS_FALLBACK;
+    }
+    while (off > value_start && is_json_space(buf[off - 1])) {
+        off -= 1;
+    }
+    if (path.jfp_components.empty()) {
+        size_t end = off;
+
+        // The whole document is the target, so it has to be complete.
+        skip_space(buf, end, len);
+        if (end != len) {
+            return JFS_FALLBACK;
+        }
+    }
+
+    value_out = &buffer[value_start];
+    value_len_out = off - value_start;
+
+    return JFS_OK;
+}
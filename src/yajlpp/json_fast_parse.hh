@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file json_fast_parse.hh
+ */
+
+#ifndef lnav_json_fast_parse_hh
+#define lnav_json_fast_parse_hh
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include "yajl/api/yajl_parse.h"
+
+enum json_fast_status_t {
+    /** The buffer was parsed and all of the callbacks were made. */
+    JFS_OK,
+    /** A callback returned zero, like yajl_status_client_canceled. */
+    JFS_CANCELED,
+    /**
+     * The buffer has something that is only handled by yajl, like a
+     * "\u" escape or an error.  Any state built up by the callbacks
+     * needs to be thrown away before parsing the buffer with yajl.
+     */
+    JFS_FALLBACK,
+};
+
+/**
+ * Parse a buffer that holds a complete JSON value and make the same
+ * callbacks that yajl_parse() followed by yajl_complete_parse() would make
+ * with the default yajl options.  The parser works on the whole buffer at
+ * once and does not keep any state, so it can skip over long runs of
+ * plain characters in strings without looking at each one.  Anything the
+ * parser is not sure about is left to yajl, so its errors and unescaping
+ * rules stay the only ones.
+ *
+ * @param callbacks The callbacks to make.
+ * @param ctx The context passed to the callbacks.
+ * @param buffer The JSON text.
+ * @param len The length of the JSON text.
+ */
+json_fast_status_t json_fast_parse(const yajl_callbacks &callbacks,
+                                   void *ctx,
+                                   const char *buffer,
+                                   size_t len);
+
+/**
+ * A JSON pointer that has been split into its reference tokens so that it
+ * can be looked up in many documents without parsing it again.
+ */
+struct json_fast_path {
+    struct component {
+        /** The unescaped reference token, used for object members. */
+        std::string c_key;
+        /** The array index for the token or -1 if it is not a number. */
+        int32_t c_index{-1};
+    };
+
+    /**
+     * Split the given pointer into its components.
+     *
+     * @param ptr The JSON pointer.
+     * @return False if the pointer has syntax, like a bad escape, that
+     *   should be left to json_ptr so that its errors are reported.
+     */
+    bool compile(const char *ptr);
+
+    std::vector<component> jfp_components;
+};
+
+/**
+ * Find the value that a pointer refers to in a JSON document.  The values
+ * that are not on the path to the target are checked for errors but no
+ * callbacks are made for them and the document is not looked at once the
+ * target has been found.
+ *
+ * @param path The compiled pointer.
+ * @param buffer The JSON text.
+ * @param len The length of the JSON text.
+ * @param value_out Set to the start of the target value or nullptr if the
+ *   document is valid and does not contain the target.
+ * @param value_len_out Set to the length of the target value.
+ * @return JFS_OK or JFS_FALLBACK if the document needs to be handled by
+ *   yajl.
+ */
+json_fast_status_t json_fast_find(const json_fast_path &path,
+                                  const char *buffer,
+                                  size_t len,
+                                  const char *&value_out,
+                                  size_t &value_len_out);
+
+#endif
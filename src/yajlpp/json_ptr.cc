@@ -34,6 +34,7 @@
 #include "yajl/api/yajl_gen.h"
 
 #include "yajlpp/json_ptr.hh"
+#include "yajlpp/json_fast_parse.hh"
 
 using namespace std;
 
@@ -437,6 +438,33 @@ bool json_ptr::at_index(int32_t &depth, int32_t &index, bool primitive)
     return retval;
 }
 
+yajl_status json_ptr_walk::parse_complete(const char *buffer, ssize_t len)
+{
+    size_t values_size = this->jpw_values.size();
+    size_t keys_size = this->jpw_keys.size();
+    size_t indexes_size = this->jpw_array_indexes.size();
+    size_t max_ptr_len = this->jpw_max_ptr_len;
+
+    if (json_fast_parse(callbacks, this, buffer, len) == JFS_OK) {
+        return yajl_status_ok;
+    }
+
+    // Throw away what the fast parser found and start over with yajl.
+    this->jpw_values.erase(this->jpw_values.begin() + values_size,
+                           this->jpw_values.end());
+    this->jpw_keys.resize(keys_size);
+    this->jpw_array_indexes.resize(indexes_size);
+    this->jpw_max_ptr_len = max_ptr_len;
+
+    yajl_status retval = this->parse(buffer, len);
+
+    if (retval == yajl_status_ok) {
+        retval = this->complete_parse();
+    }
+
+    return retval;
+}
+
 std::string json_ptr_walk::current_ptr()
 {
     std::string retval;
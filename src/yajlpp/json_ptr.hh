@@ -68,6 +68,13 @@ public:
         return retval;
     };
 
+    /**
+     * Walk a buffer that holds a complete JSON value.  This is the same as
+     * calling parse() and then complete_parse(), except that the fast
+     * parser is tried first.
+     */
+    yajl_status parse_complete(const char *buffer, ssize_t len);
+
     void update_error_msg(yajl_status status, const char *buffer, ssize_t len) {
         switch (status) {
         case yajl_status_ok:
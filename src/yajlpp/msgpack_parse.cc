@@ -0,0 +1,490 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file msgpack_parse.cc
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <limits>
+
+#include "yajlpp/json_op.hh"
+#include "yajlpp/msgpack_parse.hh"
+
+/**
+ * Containers nested deeper than this are treated as an error so that the
+ * stack of open containers does not need to be allocated.
+ */
+static const size_t MAX_DEPTH = 128;
+
+/** The extension type that holds a timestamp. */
+static const int8_t TIMESTAMP_EXT_TYPE = -1;
+
+#define MPS_CALL(name, ...) \
+    if (this->mp_callbacks.name != nullptr && \
+        !this->mp_callbacks.name(__VA_ARGS__)) { \
+        return MPS_CANCELED; \
+    }
+
+bool msgpack_parser::need(size_t amount)
+{
+    if (this->mp_len - this->mp_offset < amount) {
+        this->mp_error = "value is truncated";
+        return false;
+    }
+
+    return true;
+}
+
+uint64_t msgpack_parser::read_uint(size_t width)
+{
+    uint64_t retval = 0;
+
+    for (size_t lpc = 0; lpc < width; lpc++) {
+        retval = (retval << 8) | this->mp_buffer[this->mp_offset + lpc];
+    }
+    this->mp_offset += width;
+
+    return retval;
+}
+
+msgpack_status_t msgpack_parser::read_number(int64_t value)
+{
+    if (this->mp_callbacks.yajl_number != nullptr) {
+        char buf[32];
+        int len = snprintf(buf, sizeof(buf), "%lld", (long long) value);
+
+        MPS_CALL(yajl_number, this->mp_ctx, buf, len);
+    } else {
+        MPS_CALL(yajl_integer, this->mp_ctx, value);
+    }
+
+    return MPS_OK;
+}
+
+msgpack_status_t msgpack_parser::read_number(uint64_t value)
+{
+    if (value <= (uint64_t) std::numeric_limits<long long>::max()) {
+        return this->read_number((int64_t) value);
+    }
+
+    if (this->mp_callbacks.yajl_number != nullptr) {
+        char buf[32];
+        int len = snprintf(buf, sizeof(buf), "%llu",
+                           (unsigned long long) value);
+
+        MPS_CALL(yajl_number, this->mp_ctx, buf, len);
+    } else {
+        MPS_CALL(yajl_double, this->mp_ctx, (double) value);
+    }
+
+    return MPS_OK;
+}
+
+msgpack_status_t msgpack_parser::read_number(double value)
+{
+    if (this->mp_callbacks.yajl_number != nullptr) {
+        if (!isfinite(value)) {
+            // JSON has no way to write these.
+            MPS_CALL(yajl_null, this->mp_ctx);
+        } else {
+            char buf[32];
+            int len = snprintf(buf, sizeof(buf), "%.17g", value);
+
+            MPS_CALL(yajl_number, this->mp_ctx, buf, len);
+        }
+    } else {
+        MPS_CALL(yajl_double, this->mp_ctx, value);
+    }
+
+    return MPS_OK;
+}
+
+msgpack_status_t msgpack_parser::read_ext(uint8_t type, size_t len)
+{
+    if (!this->need(len)) {
+        return MPS_ERROR;
+    }
+
+    if ((int8_t) type != TIMESTAMP_EXT_TYPE) {
+        this->mp_offset += len;
+        MPS_CALL(yajl_null, this->mp_ctx);
+        return MPS_OK;
+    }
+
+    int64_t sec;
+    uint32_t nsec;
+
+    switch (len) {
+        case 4:
+            nsec = 0;
+            sec = this->read_uint(4);
+            break;
+        case 8: {
+            uint64_t value = this->read_uint(8);
+
+            nsec = value >> 34;
+            sec = value & 0x3ffffffffULL;
+            break;
+        }
+        case 12:
+            nsec = this->read_uint(4);
+            sec = (int64_t) this->read_uint(8);
+            break;
+        default:
+            this->mp_error = "invalid timestamp length";
+            return MPS_ERROR;
+    }
+
+    time_t tsec = sec;
+    struct tm tm;
+    char buf[64];
+
+    if (nsec >= 1000000000 || gmtime_r(&tsec, &tm) == nullptr) {
+        this->mp_error = "invalid timestamp";
+        return MPS_ERROR;
+    }
+
+    int buf_len = snprintf(buf, sizeof(buf),
+                           "%04d-%02d-%02dT%02d:%02d:%02d.%06u+00:00",
+                           tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                           tm.tm_hour, tm.tm_min, tm.tm_sec,
+                           nsec / 1000);
+
+    MPS_CALL(yajl_string, this->mp_ctx, (const unsigned char *) buf, buf_len);
+
+    return MPS_OK;
+}
+
+msgpack_status_t msgpack_parser::parse(const char *buffer, size_t len)
+{
+    struct container {
+        bool c_is_map;
+        bool c_need_key;
+        uint32_t c_remaining;
+    };
+
+    container containers[MAX_DEPTH];
+    size_t depth = 0;
+    bool started = false;
+
+    this->mp_buffer = (const unsigned char *) buffer;
+    this->mp_len = len;
+    this->mp_offset = 0;
+    this->mp_value_start = 0;
+    this->mp_error.clear();
+
+    for (;;) {
+        while (depth > 0 && containers[depth - 1].c_remaining == 0) {
+            depth -= 1;
+            if (containers[depth].c_is_map) {
+                MPS_CALL(yajl_end_map, this->mp_ctx);
+            } else {
+                MPS_CALL(yajl_end_array, this->mp_ctx);
+            }
+        }
+        if (depth == 0 && started) {
+            break;
+        }
+        started = true;
+
+        bool is_key = false;
+
+        if (depth > 0) {
+            auto &cont = containers[depth - 1];
+
+            if (cont.c_need_key) {
+                is_key = true;
+                cont.c_need_key = false;
+            } else {
+                cont.c_remaining -= 1;
+                cont.c_need_key = cont.c_is_map;
+            }
+        }
+
+        if (!this->need(1)) {
+            return MPS_ERROR;
+        }
+
+        this->mp_value_start = this->mp_offset;
+
+        uint8_t type = this->mp_buffer[this->mp_offset++];
+        size_t str_len = 0;
+        bool is_str = false;
+        int64_t int_value = 0;
+        bool is_int = false;
+
+        if (type <= 0x7f) {
+            int_value = type;
+            is_int = true;
+        } else if (type >= 0xe0) {
+            int_value = (int8_t) type;
+            is_int = true;
+        } else if (type >= 0xa0 && type <= 0xbf) {
+            str_len = type & 0x1f;
+            is_str = true;
+        } else {
+            switch (type) {
+                case 0xc4:
+                case 0xd9:
+                    if (!this->need(1)) {
+                        return MPS_ERROR;
+                    }
+                    str_len = this->read_uint(1);
+                    is_str = true;
+                    break;
+                case 0xc5:
+                case 0xda:
+                    if (!this->need(2)) {
+                        return MPS_ERROR;
+                    }
+                    str_len = this->read_uint(2);
+                    is_str = true;
+                    break;
+                case 0xc6:
+                case 0xdb:
+                    if (!this->need(4)) {
+                        return MPS_ERROR;
+                    }
+                    str_len = this->read_uint(4);
+                    is_str = true;
+                    break;
+                case 0xcc:
+                case 0xcd:
+                case 0xce:
+                case 0xd0:
+                case 0xd1:
+                case 0xd2:
+                case 0xd3: {
+                    size_t width = 1U << (type & 0x3);
+
+                    if (!this->need(width)) {
+                        return MPS_ERROR;
+                    }
+
+                    uint64_t value = this->read_uint(width);
+
+                    if (type >= 0xd0) {
+                        // Sign extend from the width of the value.
+                        size_t shift = 64 - width * 8;
+
+                        int_value = (int64_t) (value << shift) >> shift;
+                    } else {
+                        int_value = value;
+                    }
+                    is_int = true;
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+
+        if (is_key) {
+            if (is_str) {
+                if (!this->need(str_len)) {
+                    return MPS_ERROR;
+                }
+                MPS_CALL(yajl_map_key, this->mp_ctx,
+                         &this->mp_buffer[this->mp_offset], str_len);
+                this->mp_offset += str_len;
+            } else if (is_int) {
+                char buf[32];
+                int buf_len = snprintf(buf, sizeof(buf), "%lld",
+                                       (long long) int_value);
+
+                MPS_CALL(yajl_map_key, this->mp_ctx,
+                         (const unsigned char *) buf, buf_len);
+            } else {
+                this->mp_error = "map key is not a string or integer";
+                return MPS_ERROR;
+            }
+            continue;
+        }
+
+        if (is_str) {
+            if (!this->need(str_len)) {
+                return MPS_ERROR;
+            }
+            MPS_CALL(yajl_string, this->mp_ctx,
+                     &this->mp_buffer[this->mp_offset], str_len);
+            this->mp_offset += str_len;
+            continue;
+        }
+        if (is_int) {
+            auto rc = this->read_number(int_value);
+
+            if (rc != MPS_OK) {
+                return rc;
+            }
+            continue;
+        }
+
+        msgpack_status_t rc = MPS_OK;
+        size_t count = 0;
+        bool is_map = false, is_container = false;
+
+        switch (type) {
+            case 0xc0:
+                MPS_CALL(yajl_null, this->mp_ctx);
+                break;
+            case 0xc2:
+            case 0xc3:
+                MPS_CALL(yajl_boolean, this->mp_ctx, type == 0xc3);
+                break;
+            case 0xca: {
+                if (!this->need(4)) {
+                    return MPS_ERROR;
+                }
+
+                uint32_t bits = this->read_uint(4);
+                float value;
+
+                memcpy(&value, &bits, sizeof(value));
+                rc = this->read_number((double) value);
+                break;
+            }
+            case 0xcb: {
+                if (!this->need(8)) {
+                    return MPS_ERROR;
+                }
+
+                uint64_t bits = this->read_uint(8);
+                double value;
+
+                memcpy(&value, &bits, sizeof(value));
+                rc = this->read_number(value);
+                break;
+            }
+            case 0xcf:
+                if (!this->need(8)) {
+                    return MPS_ERROR;
+                }
+                rc = this->read_number(this->read_uint(8));
+                break;
+            case 0xd4:
+            case 0xd5:
+            case 0xd6:
+            case 0xd7:
+            case 0xd8:
+                if (!this->need(1)) {
+                    return MPS_ERROR;
+                }
+                rc = this->read_ext(this->read_uint(1), 1U << (type - 0xd4));
+                break;
+            case 0xc7:
+            case 0xc8:
+            case 0xc9: {
+                size_t width = 1U << (type - 0xc7);
+
+                if (!this->need(width + 1)) {
+                    return MPS_ERROR;
+                }
+
+                size_t ext_len = this->read_uint(width);
+
+                rc = this->read_ext(this->read_uint(1), ext_len);
+                break;
+            }
+            case 0xdc:
+            case 0xde:
+                if (!this->need(2)) {
+                    return MPS_ERROR;
+                }
+                count = this->read_uint(2);
+                is_map = type == 0xde;
+                is_container = true;
+                break;
+            case 0xdd:
+            case 0xdf:
+                if (!this->need(4)) {
+                    return MPS_ERROR;
+                }
+                count = this->read_uint(4);
+                is_map = type == 0xdf;
+                is_container = true;
+                break;
+            default:
+                if (type >= 0x80 && type <= 0x9f) {
+                    count = type & 0x0f;
+                    is_map = type <= 0x8f;
+                    is_container = true;
+                } else {
+                    this->mp_error = "invalid type byte";
+                    return MPS_ERROR;
+                }
+                break;
+        }
+
+        if (rc != MPS_OK) {
+            return rc;
+        }
+        if (!is_container) {
+            continue;
+        }
+
+        if (depth == MAX_DEPTH) {
+            this->mp_error = "containers are nested too deeply";
+            return MPS_ERROR;
+        }
+        if (is_map) {
+            MPS_CALL(yajl_start_map, this->mp_ctx);
+        } else {
+            MPS_CALL(yajl_start_array, this->mp_ctx);
+        }
+        containers[depth].c_is_map = is_map;
+        containers[depth].c_need_key = is_map && count > 0;
+        containers[depth].c_remaining = count;
+        depth += 1;
+    }
+
+    if (this->mp_offset != this->mp_len) {
+        this->mp_error = "trailing data after value";
+        return MPS_ERROR;
+    }
+
+    return MPS_OK;
+}
+
+#undef MPS_CALL
+
+bool msgpack_to_json(yajl_gen gen, const char *buffer, size_t len)
+{
+    json_op jo(json_ptr(""));
+
+    jo.jo_ptr_data = gen;
+
+    msgpack_parser mp(json_op::gen_callbacks, &jo);
+
+    return mp.parse(buffer, len) == MPS_OK && jo.jo_ptr_error_code == 0;
+}
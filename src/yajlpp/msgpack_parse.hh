@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file msgpack_parse.hh
+ */
+
+#ifndef lnav_msgpack_parse_hh
+#define lnav_msgpack_parse_hh
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+
+#include "yajl/api/yajl_gen.h"
+#include "yajl/api/yajl_parse.h"
+
+enum msgpack_status_t {
+    /** The buffer was parsed and all of the callbacks were made. */
+    MPS_OK,
+    /** A callback returned zero, like yajl_status_client_canceled. */
+    MPS_CANCELED,
+    /** The buffer is not a single, valid MessagePack value. */
+    MPS_ERROR,
+};
+
+/**
+ * Decodes a buffer that holds a complete MessagePack value and makes the
+ * same callbacks that yajl would make for the equivalent JSON, so the
+ * handlers written for JSON can be used for binary records as well.
+ *
+ * Binary data is passed to the string callback as is, map keys that are
+ * integers are passed as their decimal text, and timestamps (extension
+ * type -1) are passed as ISO 8601 strings in UTC.  The values of other
+ * extension types are passed as nulls.  When the number callback is set,
+ * it is used for all numbers, like yajl, otherwise large unsigned integers
+ * that do not fit in a long long are passed to the double callback.
+ */
+class msgpack_parser {
+public:
+    msgpack_parser(const yajl_callbacks &callbacks, void *ctx)
+        : mp_callbacks(callbacks), mp_ctx(ctx) {
+    };
+
+    /**
+     * @param buffer The encoded value.
+     * @param len The length of the encoded value.
+     */
+    msgpack_status_t parse(const char *buffer, size_t len);
+
+    /**
+     * @return The offset of the value that the current callback is being
+     *   made for.
+     */
+    size_t get_value_start() const {
+        return this->mp_value_start;
+    };
+
+    /**
+     * @return The number of bytes that have been decoded, like
+     *   yajl_get_bytes_consumed().  For the end of a map or array, this is
+     *   the offset just past the container.
+     */
+    size_t get_bytes_consumed() const {
+        return this->mp_offset;
+    };
+
+    /** @return A description of the error if parse() returned MPS_ERROR. */
+    const std::string &get_error() const {
+        return this->mp_error;
+    };
+
+private:
+    bool need(size_t amount);
+
+    uint64_t read_uint(size_t width);
+
+    msgpack_status_t read_ext(uint8_t type, size_t len);
+
+    msgpack_status_t read_number(int64_t value);
+
+    msgpack_status_t read_number(uint64_t value);
+
+    msgpack_status_t read_number(double value);
+
+    const yajl_callbacks &mp_callbacks;
+    void *mp_ctx;
+    const unsigned char *mp_buffer{nullptr};
+    size_t mp_len{0};
+    size_t mp_offset{0};
+    size_t mp_value_start{0};
+    std::string mp_error;
+};
+
+/**
+ * Convert a MessagePack value to JSON.
+ *
+ * @param gen The generator to write the JSON to.
+ * @param buffer The encoded value.
+ * @param len The length of the encoded value.
+ * @return True if the value was converted.
+ */
+bool msgpack_to_json(yajl_gen gen, const char *buffer, size_t len);
+
+#endif
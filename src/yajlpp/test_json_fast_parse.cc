@@ -0,0 +1,295 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file test_json_fast_parse.cc
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "auto_mem.hh"
+#include "yajlpp/json_fast_parse.hh"
+
+struct event_recorder {
+    std::string er_events;
+    int er_count{0};
+    int er_cancel_at{-1};
+
+    int next() {
+        this->er_count += 1;
+        return this->er_cancel_at == -1 || this->er_count < this->er_cancel_at;
+    };
+};
+
+static int rec_null(void *ctx)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "null;";
+    return er->next();
+}
+
+static int rec_boolean(void *ctx, int val)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += val ? "true;" : "false;";
+    return er->next();
+}
+
+static int rec_integer(void *ctx, long long val)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "int:" + std::to_string(val) + ";";
+    return er->next();
+}
+
+static int rec_double(void *ctx, double val)
+{
+    auto er = (event_recorder *) ctx;
+    char buf[64];
+
+    snprintf(buf, sizeof(buf), "%.17g", val);
+    er->er_events += "double:" + std::string(buf) + ";";
+    return er->next();
+}
+
+static int rec_number(void *ctx, const char *num, size_t len)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "num:" + std::string(num, len) + ";";
+    return er->next();
+}
+
+static int rec_string(void *ctx, const unsigned char *str, size_t len)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "str:" + std::string((const char *) str, len) + ";";
+    return er->next();
+}
+
+static int rec_map_key(void *ctx, const unsigned char *str, size_t len)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "key:" + std::string((const char *) str, len) + ";";
+    return er->next();
+}
+
+static int rec_start_map(void *ctx)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "{;";
+    return er->next();
+}
+
+static int rec_end_map(void *ctx)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "};";
+    return er->next();
+}
+
+static int rec_start_array(void *ctx)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "[;";
+    return er->next();
+}
+
+static int rec_end_array(void *ctx)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "];";
+    return er->next();
+}
+
+static const yajl_callbacks NUMBER_CALLBACKS = {
+    rec_null,
+    rec_boolean,
+    nullptr,
+    nullptr,
+    rec_number,
+    rec_string,
+    rec_start_map,
+    rec_map_key,
+    rec_end_map,
+    rec_start_array,
+    rec_end_array,
+};
+
+static const yajl_callbacks CONVERTED_CALLBACKS = {
+    rec_null,
+    rec_boolean,
+    rec_integer,
+    rec_double,
+    nullptr,
+    rec_string,
+    rec_start_map,
+    rec_map_key,
+    rec_end_map,
+    rec_start_array,
+    rec_end_array,
+};
+
+/**
+ * Parse the input with both yajl and the fast parser and check that the
+ * fast parser either made the same callbacks or gave up.
+ */
+static json_fast_status_t check_same(const yajl_callbacks &callbacks,
+                                     const char *json,
+                                     int cancel_at = -1)
+{
+    event_recorder yajl_events, fast_events;
+    auto_mem<yajl_handle_t> handle(yajl_free);
+    size_t len = strlen(json);
+
+    yajl_events.er_cancel_at = cancel_at;
+    fast_events.er_cancel_at = cancel_at;
+
+    handle = yajl_alloc(&callbacks, nullptr, &yajl_events);
+    yajl_status status = yajl_parse(
+        handle.in(), (const unsigned char *) json, len);
+    if (status == yajl_status_ok) {
+        status = yajl_complete_parse(handle.in());
+    }
+
+    json_fast_status_t retval = json_fast_parse(
+        callbacks, &fast_events, json, len);
+
+    switch (retval) {
+        case JFS_OK:
+            assert(status == yajl_status_ok);
+            assert(yajl_events.er_events == fast_events.er_events);
+            break;
+        case JFS_CANCELED:
+            assert(status == yajl_status_client_canceled);
+            assert(yajl_events.er_events == fast_events.er_events);
+            break;
+        case JFS_FALLBACK:
+            break;
+    }
+
+    return retval;
+}
+
+static json_fast_status_t check_both(const char *json, int cancel_at = -1)
+{
+    json_fast_status_t retval = check_same(NUMBER_CALLBACKS, json, cancel_at);
+
+    assert(check_same(CONVERTED_CALLBACKS, json, cancel_at) == retval);
+
+    return retval;
+}
+
+int main(int argc, const char *argv[])
+{
+    static const char *VALID[] = {
+        "{}",
+        "[]",
+        " \t\n\v\f\r{ \"a\" : 1 }\n",
+        "1",
+        "-0",
+        "\"top\"",
+        "true",
+        "null",
+        "[1, -2.5, 3e10, -4E-2, 0.125, 123456789012345678]",
+        "{\"a\":{\"b\":[true,false,null]},\"c\":\"d\"}",
+        "{\"msg\":\"a string that is longer than sixteen characters\"}",
+        "{\"esc\":\"tab\\there \\\"quoted\\\" \\\\ \\/ \\b\\f\\n\\r\"}",
+        "{\"utf8\":\"caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80\"}",
+        "{\"a\":1,\"a\":2}",
+        "[[[[[]]]]]",
+    };
+
+    for (auto json : VALID) {
+        assert(check_both(json) == JFS_OK);
+    }
+
+    static const char *LEFT_TO_YAJL[] = {
+        "",
+        "   ",
+        "{\"u\":\"\\u0041\"}",
+        "{\"a\":1,}",
+        "[1,]",
+        "{\"a\" 1}",
+        "{1:2}",
+        "[01]",
+        "[1.]",
+        "[1e]",
+        "[-]",
+        "[tru]",
+        "[truex]",
+        "{} {}",
+        "{}x",
+        "\"unterminated",
+        "\"bad \\q escape\"",
+        "\"control \x01 char\"",
+        "\"bad \xc3 utf8\"",
+        "\"bad \xff utf8\"",
+        "[}",
+        "{]",
+    };
+
+    for (auto json : LEFT_TO_YAJL) {
+        assert(check_both(json) == JFS_FALLBACK);
+    }
+
+    // Numbers that might overflow are only left to yajl when they need to
+    // be converted.
+    assert(check_same(NUMBER_CALLBACKS, "[1234567890123456789]") == JFS_OK);
+    assert(check_same(CONVERTED_CALLBACKS, "[1234567890123456789]") ==
+           JFS_FALLBACK);
+    assert(check_same(NUMBER_CALLBACKS, "[1e400]") == JFS_OK);
+    assert(check_same(CONVERTED_CALLBACKS, "[1e400]") == JFS_FALLBACK);
+
+    for (int cancel_at = 1; cancel_at < 8; cancel_at++) {
+        assert(check_both("{\"a\":[1,\"b\",true],\"c\":{\"d\":null}}",
+                          cancel_at) == JFS_CANCELED);
+    }
+
+    {
+        std::string deep(200, '[');
+
+        deep.append(200, ']');
+        assert(check_both(deep.c_str()) == JFS_FALLBACK);
+    }
+}
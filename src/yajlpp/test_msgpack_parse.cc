@@ -0,0 +1,275 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file test_msgpack_parse.cc
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "auto_mem.hh"
+#include "yajlpp/yajlpp.hh"
+#include "yajlpp/msgpack_parse.hh"
+
+struct event_recorder {
+    std::string er_events;
+    int er_count{0};
+    int er_cancel_at{-1};
+
+    int next() {
+        this->er_count += 1;
+        return this->er_cancel_at == -1 || this->er_count < this->er_cancel_at;
+    };
+};
+
+static int rec_null(void *ctx)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "null;";
+    return er->next();
+}
+
+static int rec_boolean(void *ctx, int val)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += val ? "true;" : "false;";
+    return er->next();
+}
+
+static int rec_integer(void *ctx, long long val)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "int:" + std::to_string(val) + ";";
+    return er->next();
+}
+
+static int rec_double(void *ctx, double val)
+{
+    auto er = (event_recorder *) ctx;
+    char buf[64];
+
+    snprintf(buf, sizeof(buf), "%.17g", val);
+    er->er_events += "double:" + std::string(buf) + ";";
+    return er->next();
+}
+
+static int rec_string(void *ctx, const unsigned char *str, size_t len)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "str:" + std::string((const char *) str, len) + ";";
+    return er->next();
+}
+
+static int rec_map_key(void *ctx, const unsigned char *str, size_t len)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "key:" + std::string((const char *) str, len) + ";";
+    return er->next();
+}
+
+static int rec_start_map(void *ctx)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "{;";
+    return er->next();
+}
+
+static int rec_end_map(void *ctx)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "};";
+    return er->next();
+}
+
+static int rec_start_array(void *ctx)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "[;";
+    return er->next();
+}
+
+static int rec_end_array(void *ctx)
+{
+    auto er = (event_recorder *) ctx;
+
+    er->er_events += "];";
+    return er->next();
+}
+
+static const yajl_callbacks CONVERTED_CALLBACKS = {
+    rec_null,
+    rec_boolean,
+    rec_integer,
+    rec_double,
+    nullptr,
+    rec_string,
+    rec_start_map,
+    rec_map_key,
+    rec_end_map,
+    rec_start_array,
+    rec_end_array,
+};
+
+/**
+ * Decode the MessagePack value and check that the callbacks are the same
+ * as the ones yajl makes for the equivalent JSON.
+ */
+static void check_same(const std::string &msgpack, const char *json)
+{
+    event_recorder yajl_events, mp_events;
+    auto_mem<yajl_handle_t> handle(yajl_free);
+
+    handle = yajl_alloc(&CONVERTED_CALLBACKS, nullptr, &yajl_events);
+    assert(yajl_parse(handle.in(),
+                      (const unsigned char *) json,
+                      strlen(json)) == yajl_status_ok);
+    assert(yajl_complete_parse(handle.in()) == yajl_status_ok);
+
+    msgpack_parser mp(CONVERTED_CALLBACKS, &mp_events);
+
+    assert(mp.parse(msgpack.data(), msgpack.size()) == MPS_OK);
+    assert(mp.get_bytes_consumed() == msgpack.size());
+    if (yajl_events.er_events != mp_events.er_events) {
+        fprintf(stderr, "yajl: %s\n", yajl_events.er_events.c_str());
+        fprintf(stderr, "msgpack: %s\n", mp_events.er_events.c_str());
+    }
+    assert(yajl_events.er_events == mp_events.er_events);
+}
+
+static msgpack_status_t check_status(const std::string &msgpack,
+                                     int cancel_at = -1)
+{
+    event_recorder events;
+    msgpack_parser mp(CONVERTED_CALLBACKS, &events);
+
+    events.er_cancel_at = cancel_at;
+
+    auto retval = mp.parse(msgpack.data(), msgpack.size());
+
+    if (retval == MPS_ERROR) {
+        assert(!mp.get_error().empty());
+    }
+
+    return retval;
+}
+
+static std::string to_json(const std::string &msgpack)
+{
+    yajlpp_gen gen;
+
+    assert(msgpack_to_json(gen, msgpack.data(), msgpack.size()));
+
+    return gen.to_string_fragment().to_string();
+}
+
+int main(int argc, const char *argv[])
+{
+    using namespace std::string_literals;
+
+    check_same("\x80"s, "{}");
+    check_same("\x90"s, "[]");
+    check_same("\x01"s, "1");
+    check_same("\xff"s, "-1");
+    check_same("\xc0"s, "null");
+    check_same("\xc3"s, "true");
+    check_same("\xa3top"s, "\"top\"");
+    check_same("\x81\xa1" "a\x01"s, "{\"a\":1}");
+    check_same("\x93\xc2\xc3\xc0"s, "[false,true,null]");
+    check_same("\x82\xa1" "a\x81\xa1" "b\x92\x01\x02\xa1" "c\xa1" "d"s,
+               "{\"a\":{\"b\":[1,2]},\"c\":\"d\"}");
+    check_same("\x91\x91\x91\x90"s, "[[[[]]]]");
+    check_same("\x92\x80\x01"s, "[{},1]");
+
+    // Integers of each width, signed and unsigned.
+    check_same("\x96\xcc\xc8\xcd\x01\x00\xce\x00\x01\x00\x00"
+               "\xd0\x80\xd1\xff\x00\xd2\xff\xff\xff\xfe"s,
+               "[200,256,65536,-128,-256,-2]");
+    check_same("\x92\xcf\x7f\xff\xff\xff\xff\xff\xff\xff"
+               "\xd3\x80\x00\x00\x00\x00\x00\x00\x01"s,
+               "[9223372036854775807,-9223372036854775807]");
+    check_same("\x92\xca\x3f\xc0\x00\x00\xcb\xc0\x04\x00\x00\x00\x00\x00\x00"s,
+               "[1.5,-2.5]");
+
+    // The length encodings of strings and binary data.
+    check_same("\x93\xd9\x01" "a\xda\x00\x01" "b\xc4\x01" "c"s,
+               "[\"a\",\"b\",\"c\"]");
+    check_same("\xdc\x00\x01\xde\x00\x01\xa1k\xdd\x00\x00\x00\x00"s,
+               "[{\"k\":[]}]");
+
+    // Integer keys are passed as text.
+    check_same("\x81\x07\xa1v"s, "{\"7\":\"v\"}");
+
+    // Timestamps, the 32, 64 and 96-bit forms.
+    check_same("\xd6\xff\x5e\x0b\xe1\x00"s,
+               "\"2020-01-01T00:00:00.000000+00:00\"");
+    check_same("\xd7\xff\x1d\x6f\x28\x00\x5e\x0b\xe1\x00"s,
+               "\"2020-01-01T00:00:00.123456+00:00\"");
+    check_same("\xc7\x0c\xff\x00\x00\x00\x00"
+               "\x00\x00\x00\x00\x5e\x0b\xe1\x00"s,
+               "\"2020-01-01T00:00:00.000000+00:00\"");
+    // Other extension types are passed as nulls.
+    check_same("\x92\xd4\x01\x00\x01"s, "[null,1]");
+
+    assert(check_status("\x81\xa1" "a"s) == MPS_ERROR);
+    assert(check_status("\xa5" "abc"s) == MPS_ERROR);
+    assert(check_status("\xc1"s) == MPS_ERROR);
+    assert(check_status("\x81\x90\x01"s) == MPS_ERROR);
+    assert(check_status("\x01\x02"s) == MPS_ERROR);
+    assert(check_status(""s) == MPS_ERROR);
+    assert(check_status("\xd6\xff\x00"s) == MPS_ERROR);
+
+    for (int cancel_at = 1; cancel_at < 8; cancel_at++) {
+        assert(check_status("\x82\xa1" "a\x93\x01\xa1" "b\xc3\xa1" "c\x81\xa1"
+                            "d\xc0"s,
+                            cancel_at) == MPS_CANCELED);
+    }
+
+    {
+        std::string deep(200, '\x91');
+
+        deep.append(1, '\x90');
+        assert(check_status(deep) == MPS_ERROR);
+    }
+
+    assert(to_json("\x82\xa1" "a\x92\x01\xcb\x3f\xf8\x00\x00\x00\x00\x00\x00"
+                   "\xa1" "b\xc0"s) == "{\"a\":[1,1.5],\"b\":null}");
+}
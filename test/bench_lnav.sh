@@ -0,0 +1,150 @@
+#! /bin/bash
+
+# Benchmark the stages of indexing and querying logs.
+#
+# Synthetic corpora are generated for a few of the main formats and each
+# stage is timed with the driver programs and lnav itself.  The results are
+# printed as a table and written, one JSON object per line, to the file
+# named by BENCH_RESULTS.
+#
+# Usage: make bench [BENCH_LINES=<count>] [BENCH_RUNS=<count>]
+
+BENCH_LINES=${BENCH_LINES:-200000}
+BENCH_RUNS=${BENCH_RUNS:-3}
+BENCH_RESULTS=${BENCH_RESULTS:-bench-results.json}
+
+rm -f ${BENCH_RESULTS}
+
+gen_syslog() {
+    awk -v lines=$1 -v host=$2 'BEGIN {
+        for (lpc = 0; lpc < lines; lpc++) {
+            t = lpc * 2;
+            body = (lpc % 50 == 0) ? "ERROR failed to open /var/run/svc" lpc : \
+                "connection from 10.0." (lpc % 256) "." (lpc % 200) " accepted";
+            printf("Jan %2d %02d:%02d:%02d %s svc%d[%d]: %s\n",
+                   1 + int(t / 86400), int(t / 3600) % 24, int(t / 60) % 60,
+                   t % 60, host, lpc % 7, 1000 + lpc % 97, body);
+        }
+    }'
+}
+
+gen_access_log() {
+    awk -v lines=$1 'BEGIN {
+        for (lpc = 0; lpc < lines; lpc++) {
+            t = lpc;
+            status = (lpc % 50 == 0) ? 500 : 200;
+            printf("10.0.%d.%d - - [%02d/Jan/2020:%02d:%02d:%02d +0000] " \
+                   "\"GET /api/v1/item/%d?page=%d HTTP/1.1\" %d %d \"-\" " \
+                   "\"bench/1.0\"\n",
+                   lpc % 256, lpc % 200, 1 + int(t / 86400),
+                   int(t / 3600) % 24, int(t / 60) % 60, t % 60,
+                   lpc, lpc % 10, status, 100 + lpc % 5000);
+        }
+    }'
+}
+
+gen_json() {
+    awk -v lines=$1 'BEGIN {
+        for (lpc = 0; lpc < lines; lpc++) {
+            t = lpc;
+            lvl = (lpc % 50 == 0) ? "ERROR" : "INFO";
+            printf("{\"ts\": \"2020-01-%02dT%02d:%02d:%02d.%03dZ\", " \
+                   "\"lvl\": \"%s\", \"user\": \"user%d\", " \
+                   "\"msg\": \"request %d finished in %d ms\"}\n",
+                   1 + int(t / 86400), int(t / 3600) % 24, int(t / 60) % 60,
+                   t % 60, lpc % 1000, lvl, lpc % 31, lpc, lpc % 900);
+        }
+    }'
+}
+
+gen_java() {
+    awk -v lines=$1 'BEGIN {
+        lpc = 0;
+        for (msg = 0; lpc < lines; msg++) {
+            t = msg;
+            ts = sprintf("2020/01/%02d %02d:%02d:%02d",
+                         1 + int(t / 86400), int(t / 3600) % 24,
+                         int(t / 60) % 60, t % 60);
+            ts_f = sprintf("2020-01-%02d %02d:%02d:%02d,%03d",
+                           1 + int(t / 86400), int(t / 3600) % 24,
+                           int(t / 60) % 60, t % 60, msg % 1000);
+            lvl = (msg % 20 == 0) ? "ERROR" : "INFO ";
+            printf("INFO   | jvm 1    | %s | %s [Worker-%d] %s " \
+                   "com.example.bench.Task - task %d done\n",
+                   ts, ts_f, msg % 8, lvl, msg);
+            lpc += 1;
+            if (msg % 20 == 0) {
+                printf("java.lang.IllegalStateException: task %d failed\n",
+                       msg);
+                for (frame = 0; frame < 5; frame++) {
+                    printf("\tat com.example.bench.Task.step%d(Task.java:%d)\n",
+                           frame, 100 + frame);
+                }
+                lpc += 6;
+            }
+        }
+    }'
+}
+
+#
+# Time a command and record the fastest of BENCH_RUNS runs.
+#
+# Usage: bench_stage <corpus> <stage> <lines> <command> [<argument> ...]
+#
+bench_stage() {
+    local corpus=$1 stage=$2 lines=$3
+    local best="" elapsed run
+    shift 3
+
+    TIMEFORMAT=%R
+    for run in $(seq 1 ${BENCH_RUNS}); do
+        elapsed=$( { time "$@" > /dev/null 2>&1; } 2>&1 )
+        if test -z "${best}" || \
+            awk -v a=${elapsed} -v b=${best} 'BEGIN { exit !(a < b) }'; then
+            best=${elapsed}
+        fi
+    done
+
+    awk -v corpus=${corpus} -v stage=${stage} -v lines=${lines} \
+        -v secs=${best} -v results=${BENCH_RESULTS} 'BEGIN {
+        rate = secs > 0 ? lines / secs : 0;
+        printf("%-12s %-8s %10d lines %8.3fs %12.0f lines/s\n",
+               corpus, stage, lines, secs, rate);
+        printf("{\"corpus\": \"%s\", \"stage\": \"%s\", \"lines\": %d, " \
+               "\"seconds\": %.3f, \"lines_per_second\": %.0f}\n",
+               corpus, stage, lines, secs, rate) >> results;
+    }'
+}
+
+gen_syslog ${BENCH_LINES} bench-host1 > bench-syslog.0
+gen_syslog ${BENCH_LINES} bench-host2 > bench-syslog.1
+gen_access_log ${BENCH_LINES} > bench-access.log
+gen_json ${BENCH_LINES} > bench-logfile_json.json
+gen_java ${BENCH_LINES} > bench-java.log
+
+for corpus in syslog:syslog_log:bench-syslog.0 \
+              access_log:access_log:bench-access.log \
+              json:test_log:bench-logfile_json.json \
+              java:java_log:bench-java.log; do
+    name=${corpus%%:*}
+    format=${corpus#*:}
+    format=${format%%:*}
+    file=${corpus##*:}
+    lines=$(wc -l < ${file})
+
+    bench_stage ${name} read ${lines} ./drive_line_buffer ${file}
+    bench_stage ${name} scan ${lines} ./drive_logfile -f ${format} -l ${file}
+    bench_stage ${name} search ${lines} ./drive_grep_proc -t ERROR ${file}
+    bench_stage ${name} index ${lines} \
+        ${lnav} -n -q -I ${test_dir} ${file}
+    bench_stage ${name} filter ${lines} \
+        ${lnav} -n -q -I ${test_dir} -c ":filter-in ERROR" ${file}
+    bench_stage ${name} sql ${lines} \
+        ${lnav} -n -q -I ${test_dir} \
+        -c ";SELECT log_level, count(*) FROM ${format} GROUP BY log_level" \
+        ${file}
+done
+
+lines=$(cat bench-syslog.0 bench-syslog.1 | wc -l)
+bench_stage syslog merge ${lines} \
+    ${lnav} -n -q -I ${test_dir} bench-syslog.0 bench-syslog.1
@@ -0,0 +1,77 @@
+#! /bin/bash
+
+# Benchmark how quickly the UI responds to keystrokes.
+#
+# A synthetic syslog corpus is opened in lnav running under scripty and a
+# sequence of keystrokes is replayed: searching, moving between hits,
+# filtering, paging, the histogram view, and a SQL query.  For each
+# keystroke, scripty measures the time until the screen stops changing and
+# the percentiles for each step are printed and written, one JSON object
+# per line, to the file named by BENCH_UI_RESULTS.
+#
+# Usage: make bench [BENCH_LINES=<count>] [BENCH_UI_SETTLE_MS=<ms>]
+
+BENCH_LINES=${BENCH_LINES:-200000}
+BENCH_UI_SETTLE_MS=${BENCH_UI_SETTLE_MS:-50}
+BENCH_UI_RESULTS=${BENCH_UI_RESULTS:-bench-ui-results.json}
+
+rm -f ${BENCH_UI_RESULTS}
+
+gen_syslog() {
+    awk -v lines=$1 -v host=$2 'BEGIN {
+        for (lpc = 0; lpc < lines; lpc++) {
+            t = lpc * 2;
+            body = (lpc % 50 == 0) ? "ERROR failed to open /var/run/svc" lpc : \
+                "connection from 10.0." (lpc % 256) "." (lpc % 200) " accepted";
+            printf("Jan %2d %02d:%02d:%02d %s svc%d[%d]: %s\n",
+                   1 + int(t / 86400), int(t / 3600) % 24, int(t / 60) % 60,
+                   t % 60, host, lpc % 7, 1000 + lpc % 97, body);
+        }
+    }'
+}
+
+#
+# Append the commands for a step to the scripty input file.
+#
+# Usage: step <label> <repeat> <keys>
+#
+step() {
+    local label=$1 count=$2 keys=$3 hex lpc
+
+    hex=$(printf '%b' "${keys}" | od -An -tx1 | tr -d ' \n')
+    echo "mark ${label}" >> bench-ui-input
+    for lpc in $(seq 1 ${count}); do
+        echo "write ${hex}" >> bench-ui-input
+    done
+}
+
+gen_syslog ${BENCH_LINES} bench-host1 > bench-ui-syslog.0
+
+rm -f bench-ui-input
+# Give the initial indexing time to finish before measuring anything.
+step startup 1 "g"
+step search 1 "/ERROR\r"
+step next-hit 20 "n"
+step prev-hit 20 "N"
+step filter-out 1 ":filter-out accepted\r"
+step toggle-filters 10 "F"
+step page-down 20 " "
+step page-up 20 "b"
+step histogram 4 "i"
+step sql 1 ";SELECT log_procname, count(*) FROM syslog_log GROUP BY log_procname\r"
+step sql-close 1 "q"
+step quit 1 "q"
+
+./scripty -n -S ${BENCH_UI_SETTLE_MS} -r bench-ui-input \
+    -b ${BENCH_UI_RESULTS} -- \
+    ${lnav} -I ${test_dir} bench-ui-syslog.0 > /dev/null
+
+awk -F'[:,}]' 'BEGIN {
+        printf("%-16s %6s %10s %10s %10s %10s\n",
+               "step", "keys", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    }
+    {
+        gsub(/[" ]/, "", $2);
+        printf("%-16s %6d %10.3f %10.3f %10.3f %10.3f\n",
+               $2, $4, $6, $8, $10, $12);
+    }' ${BENCH_UI_RESULTS}
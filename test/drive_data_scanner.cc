@@ -148,7 +148,7 @@ int main(int argc, char *argv[])
 
                 vector<log_format *> &root_formats = log_format::get_root_formats();
                 vector<log_format *>::iterator iter;
-                vector<logline> index;
+                chunked_vector<logline> index;
 
                 if (is_log) {
                     for (iter = root_formats.begin();
@@ -47,11 +47,70 @@ using namespace std;
 class my_source : public grep_proc_source<vis_line_t> {
 
 public:
-    my_source(auto_fd &fd)
+    my_source(auto_fd &fd, bool chunked)
+        : ms_chunked(chunked)
     {
         this->ms_buffer.set_fd(fd);
     };
 
+    size_t grep_values_for_lines(vis_line_t line,
+                                 vis_line_t stop_line,
+                                 size_t max_lines,
+                                 string &chunk_out,
+                                 vector<pair<size_t, size_t>> &spans_out)
+    {
+        if (!this->ms_chunked) {
+            return 0;
+        }
+
+        try {
+            auto load_result = this->ms_buffer.load_next_lines(this->ms_range,
+                                                               max_lines);
+
+            if (load_result.isErr()) {
+                return 0;
+            }
+
+            auto lines = load_result.unwrap();
+
+            if (lines.empty()) {
+                return 0;
+            }
+
+            off_t start = lines.front().li_file_range.fr_offset;
+            auto read_result = this->ms_buffer.read_range({
+                start,
+                lines.back().li_file_range.next_offset() - start});
+
+            if (read_result.isErr()) {
+                return 0;
+            }
+
+            auto sbr = read_result.unwrap();
+            size_t base = chunk_out.size();
+
+            chunk_out.append(sbr.get_data(), sbr.length());
+            for (const auto &li : lines) {
+                size_t span_start =
+                    base + li.li_file_range.fr_offset - start;
+
+                spans_out.emplace_back(
+                    span_start, span_start + li.li_file_range.fr_size);
+            }
+            this->ms_range = lines.back().li_file_range;
+
+            return lines.size();
+        }
+        catch (line_buffer::error &e) {
+            fprintf(stderr,
+                    "error: source buffer error %d %s\n",
+                    this->ms_buffer.get_fd(),
+                    strerror(e.e_err));
+        }
+
+        return 0;
+    };
+
     bool grep_value_for_line(vis_line_t line_number, string &value_out)
     {
         bool retval = false;
@@ -84,6 +143,7 @@ public:
     };
 
 private:
+    bool ms_chunked;
     line_buffer ms_buffer;
     file_range ms_range;
 
@@ -123,30 +183,56 @@ public:
 int main(int argc, char *argv[])
 {
     int retval = EXIT_SUCCESS;
+    bool in_process = false;
+    bool chunked = false;
+    size_t worker_count = 0;
     const char *errptr;
     auto_fd fd;
     pcre *code;
-    int eoff;
+    int c, eoff;
+
+    while ((c = getopt(argc, argv, "ctw:")) != -1) {
+        switch (c) {
+            case 'c':
+                chunked = true;
+                break;
+            case 't':
+                in_process = true;
+                break;
+            case 'w':
+                worker_count = atoi(optarg);
+                break;
+            default:
+                retval = EXIT_FAILURE;
+                break;
+        }
+    }
+    argc -= optind;
+    argv += optind;
 
-    if (argc < 3) {
+    if (retval != EXIT_SUCCESS) {
+    } else if (argc < 2) {
         fprintf(stderr, "error: expecting pattern and file arguments\n");
         retval = EXIT_FAILURE;
-    } else if ((fd = open(argv[2], O_RDONLY)) == -1) {
+    } else if ((fd = open(argv[1], O_RDONLY)) == -1) {
         perror("open");
         retval = EXIT_FAILURE;
-    } else if ((code = pcre_compile(argv[1],
+    } else if ((code = pcre_compile(argv[0],
                                     PCRE_CASELESS,
                                     &errptr,
                                     &eoff,
                                     NULL)) == NULL) {
         fprintf(stderr, "error: invalid pattern -- %s\n", errptr);
     } else {
-        my_source ms(fd);
+        my_source ms(fd, chunked);
         my_sink msink;
 
         grep_proc<vis_line_t> gp(code, ms);
 
         gp.set_sink(&msink);
+        gp.set_in_process(in_process);
+        gp.set_worker_count(worker_count);
+        gp.set_pattern(argv[0]);
         gp.queue_request();
         gp.start();
 
@@ -41,6 +41,7 @@
 #include <sys/mman.h>
 
 #include <tuple>
+#include <memory>
 #include <string>
 #include <vector>
 #include <algorithm>
@@ -60,10 +61,22 @@ int main(int argc, char *argv[])
 	int offseti = 0;
 	off_t offset = 0;
 	int count = 1000;
+	bool use_mmap = false;
+	bool use_batch = false;
+	bool use_pipe = false;
 	struct stat st;
 
-	while ((c = getopt(argc, argv, "o:i:n:c:")) != -1) {
+	while ((c = getopt(argc, argv, "o:i:n:c:mbp")) != -1) {
 		switch (c) {
+			case 'm':
+				use_mmap = true;
+				break;
+			case 'p':
+				use_pipe = true;
+				break;
+			case 'b':
+				use_batch = true;
+				break;
 			case 'o':
 				if (sscanf(optarg, "%d", &offseti) != 1) {
 					fprintf(stderr,
@@ -149,8 +162,83 @@ int main(int argc, char *argv[])
 
 			int fd2 = (argc > 1) ? fd_cmp.get() : fd.get();
 			assert(fd2 >= 0);
-			lb.set_fd(fd);
-			if (index.size() == 0) {
+			lb.set_mmap_enabled(use_mmap);
+			if (use_pipe) {
+				char capture_tmpl[] = "lb-pipe.XXXXXX";
+				auto_fd capture_fd(mkstemp(capture_tmpl));
+				auto ps = make_shared<pipe_source>(fd);
+
+				assert(capture_fd != -1);
+				unlink(capture_tmpl);
+				lb.set_fd(capture_fd);
+				lb.set_pipe_source(ps);
+				while (true) {
+					bool pulled = lb.pull_pipe();
+					bool loaded = false;
+
+					while (true) {
+						auto load_result = lb.load_next_line(last_range);
+
+						if (load_result.isErr()) {
+							break;
+						}
+
+						auto li = load_result.unwrap();
+
+						if (li.li_file_range.empty() ||
+							(li.li_partial && !ps->ps_eof)) {
+							break;
+						}
+
+						auto read_result = lb.read_range(li.li_file_range);
+
+						assert(read_result.isOk());
+
+						auto sbr = read_result.unwrap();
+
+						printf("%.*s", (int) sbr.length(), sbr.get_data());
+						last_range = li.li_file_range;
+						loaded = true;
+					}
+					if (ps->ps_eof && !pulled && !loaded) {
+						break;
+					}
+				}
+			} else {
+				lb.set_fd(fd);
+			}
+			if (use_pipe) {
+			} else if (index.size() == 0 && use_batch) {
+				while (true) {
+					auto load_result = lb.load_next_lines(last_range);
+
+					if (load_result.isErr()) {
+						break;
+					}
+
+					auto lines = load_result.unwrap();
+
+					if (lines.empty()) {
+						break;
+					}
+
+					file_range batch_range{
+						lines.front().li_file_range.fr_offset,
+						lines.back().li_file_range.next_offset() -
+						lines.front().li_file_range.fr_offset,
+					};
+					auto read_result = lb.read_range(batch_range);
+
+					if (read_result.isErr()) {
+						break;
+					}
+
+					auto sbr = read_result.unwrap();
+
+					printf("%.*s", (int) sbr.length(), sbr.get_data());
+					last_range = lines.back().li_file_range;
+				}
+			} else if (index.size() == 0) {
 				while (count) {
                     auto load_result = lb.load_next_line(last_range);
 
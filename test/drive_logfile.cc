@@ -38,8 +38,10 @@
 #include <string.h>
 
 #include <algorithm>
+#include <map>
 
 #include "logfile.hh"
+#include "lnav_config.hh"
 #include "log_format.hh"
 #include "log_format_loader.hh"
 
@@ -51,6 +53,8 @@ typedef enum {
     MODE_LINE_COUNT,
     MODE_TIMES,
     MODE_LEVELS,
+    MODE_CHUNKS,
+    MODE_OPIDS,
 } dl_mode_t;
 
 time_t time(time_t *_unused)
@@ -72,6 +76,7 @@ int main(int argc, char *argv[])
     int c, retval = EXIT_SUCCESS;
     dl_mode_t mode = MODE_NONE;
     string expected_format;
+    bool sliced = false;
 
     {
         std::vector<std::string> errors;
@@ -83,8 +88,11 @@ int main(int argc, char *argv[])
         load_formats(paths, errors);
     }
 
-    while ((c = getopt(argc, argv, "ef:ltv")) != -1) {
+    while ((c = getopt(argc, argv, "cef:lostT:v")) != -1) {
         switch (c) {
+            case 'c':
+                mode = MODE_CHUNKS;
+                break;
             case 'f':
                 expected_format = optarg;
                 break;
@@ -94,6 +102,15 @@ int main(int argc, char *argv[])
             case 'l':
                 mode = MODE_LINE_COUNT;
                 break;
+            case 'o':
+                mode = MODE_OPIDS;
+                break;
+            case 's':
+                sliced = true;
+                break;
+            case 'T':
+                lnav_config.lc_tuning_index_tail_first_size = atoi(optarg);
+                break;
             case 't':
                 mode = MODE_TIMES;
                 break;
@@ -118,15 +135,34 @@ int main(int argc, char *argv[])
             stat(argv[0], &st);
             assert(strcmp(argv[0], lf.get_filename().c_str()) == 0);
 
-            lf.rebuild_index();
-            assert(!lf.is_closed());
-            lf.rebuild_index();
-            assert(!lf.is_closed());
-            lf.rebuild_index();
-            assert(!lf.is_closed());
-            assert(lf.get_activity().la_polls == 3);
-            if (lf.size() > 1) {
-                assert(lf.get_activity().la_reads == 2);
+            if (sliced) {
+                // Use a deadline that has already passed so that every call
+                // only indexes a single batch.
+                lf.rebuild_index(std::chrono::steady_clock::now());
+                if (lnav_config.lc_tuning_index_tail_first_size > 0 &&
+                    st.st_size >=
+                    2 * lnav_config.lc_tuning_index_tail_first_size) {
+                    // The end of the file should be indexed first.
+                    assert(lf.size() > 0);
+                    assert(lf.begin()->get_offset() > 0);
+                }
+                while (lf.is_indexing_incomplete()) {
+                    lf.rebuild_index(std::chrono::steady_clock::now());
+                    assert(!lf.is_closed());
+                }
+                lf.rebuild_index();
+                assert(!lf.is_indexing_incomplete());
+            } else {
+                lf.rebuild_index();
+                assert(!lf.is_closed());
+                lf.rebuild_index();
+                assert(!lf.is_closed());
+                lf.rebuild_index();
+                assert(!lf.is_closed());
+                assert(lf.get_activity().la_polls == 3);
+                if (lf.size() > 1) {
+                    assert(lf.get_activity().la_reads == 2);
+                }
             }
             if (expected_format == "") {
                 assert(lf.get_format() == NULL);
@@ -175,6 +211,51 @@ int main(int argc, char *argv[])
                                level & LEVEL__FLAGS);
                     }
                     break;
+                case MODE_CHUNKS:
+                    for (logfile::iterator iter = lf.begin();
+                         iter != lf.end(); ++iter) {
+                        if (iter->is_continued()) {
+                            continue;
+                        }
+
+                        shared_buffer_ref full;
+                        string chunked;
+
+                        lf.read_full_message(iter, full);
+                        // Use a tiny chunk size so that the lines of a
+                        // message get split up.
+                        assert(lf.read_message_chunks(
+                            iter, 8, [&chunked](const shared_buffer_ref &sbr) {
+                                chunked.append(sbr.get_data(), sbr.length());
+                                return true;
+                            }));
+                        assert(chunked == to_string(full));
+                        printf("%s\n", chunked.c_str());
+                    }
+                    break;
+                case MODE_OPIDS: {
+                    const auto &opids = lf.get_format()->get_opids();
+                    std::map<string, const opid_descriptor *> sorted;
+
+                    for (const auto &pair : opids) {
+                        sorted[pair.first] = &pair.second;
+                    }
+                    for (const auto &pair : sorted) {
+                        const auto &lines = pair.second->od_lines;
+
+                        assert(std::is_sorted(lines.begin(), lines.end()));
+                        for (auto line : lines) {
+                            assert(line < lf.size());
+                            assert(!lf.begin()[line].is_continued());
+                        }
+                        printf("%s %zu %u %u\n",
+                               pair.first.c_str(),
+                               lines.size(),
+                               lines.front(),
+                               lines.back());
+                    }
+                    break;
+                }
             }
         } catch (const logfile::error &e) {
             fprintf(stderr, "logfile error -- %s (%d)", e.e_filename.c_str(),
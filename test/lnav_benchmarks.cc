@@ -0,0 +1,260 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file lnav_benchmarks.cc
+ *
+ * Timing loops for the kernels that are run on every line of a log file.
+ * Each benchmark is run over a small, fixed set of inputs for a number of
+ * iterations and the average cost of a single call is reported.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "lnav_util.hh"
+#include "data_scanner.hh"
+#include "pcrepp/pcrepp.hh"
+#include "base/is_utf8.hh"
+
+using namespace std;
+
+static const char *SAMPLE_LINES[] = {
+    "Jun  3 07:02:37 Tim-Stacks-iMac.local sudo[2717]: stack : TTY=ttys003 ; "
+    "PWD=/Users/stack ; USER=root ; COMMAND=/bin/ls",
+    "192.168.202.254 - - [20/Jul/2009:22:59:26 +0000] \"GET /vmw/cgi/tramp "
+    "HTTP/1.0\" 200 134 \"-\" \"gPXE/0.9.7\"",
+    "2017-01-22 22:34:38,060 [main] INFO  com.example.Server - Listening on "
+    "port 8080 with key=0x6d2d9f0a uuid=5f7c8b1e-9a3d-4c21-b7a8-2e4f6d0c1a33",
+    "{\"ts\": \"2013-09-06T20:00:48.124817Z\", \"lvl\": \"TRACE\", "
+    "\"msg\": \"trace test\", \"user\": \"mailto:user@example.com\"}",
+    "\tat com.example.bench.Task.step(Task.java:104) caf\xc3\xa9 "
+    "na\xc3\xafve r\xc3\xa9sum\xc3\xa9",
+
+    nullptr
+};
+
+static const char *SAMPLE_TIMES[] = {
+    "2017-01-22 22:34:38,060",
+    "20/Jul/2009:22:59:26 +0000",
+    "Jun  3 07:02:37",
+    "2013-09-06T20:00:48.124817Z",
+    "05/18/2018 12:00:53 PM",
+
+    nullptr
+};
+
+/**
+ * Written by every benchmark so the compiler cannot throw away the work.
+ */
+static volatile size_t BENCH_SINK;
+
+struct benchmark {
+    const char *b_name;
+    size_t (*b_func)(const vector<string> &inputs);
+    bool b_times;
+};
+
+static size_t bench_pcrepp_match(const vector<string> &inputs)
+{
+    static pcrepp SYSLOG_RE(
+        "^(?<timestamp>\\w+\\s+\\d+ \\d+:\\d+:\\d+) (?<log_hostname>[^ ]+) "
+        "(?<log_procname>[^\\[:]+)(?:\\[(?<log_pid>\\d+)\\])?: "
+        "(?<body>.*)$");
+    static pcrepp WORD_RE("\\bINFO\\b|\\bERROR\\b|\\bport\\b");
+
+    pcre_context_static<30> pc;
+    size_t retval = 0;
+
+    for (const auto &str : inputs) {
+        pcre_input pi(str);
+
+        if (SYSLOG_RE.match(pc, pi)) {
+            retval += pc.get_count();
+        }
+
+        pcre_input pi2(str);
+
+        while (WORD_RE.match(pc, pi2)) {
+            retval += 1;
+        }
+    }
+
+    return retval;
+}
+
+static size_t bench_date_time_scan(const vector<string> &inputs)
+{
+    size_t retval = 0;
+
+    for (const auto &str : inputs) {
+        date_time_scanner dts;
+        struct timeval tv;
+        struct exttm tm;
+
+        // Scan twice so the cost of the locked format is included.
+        for (int lpc = 0; lpc < 2; lpc++) {
+            if (dts.scan(str.c_str(), str.size(), nullptr, &tm, tv) !=
+                nullptr) {
+                retval += tv.tv_sec;
+            }
+        }
+    }
+
+    return retval;
+}
+
+static size_t bench_tokenize2(const vector<string> &inputs)
+{
+    pcre_context_static<30> pc;
+    size_t retval = 0;
+
+    for (const auto &str : inputs) {
+        data_scanner ds(str);
+        data_token_t dt;
+
+        while (ds.tokenize2(pc, dt)) {
+            retval += dt;
+        }
+    }
+
+    return retval;
+}
+
+static size_t bench_is_utf8(const vector<string> &inputs)
+{
+    size_t retval = 0;
+
+    for (const auto &str : inputs) {
+        const char *msg;
+        int faulty_bytes;
+
+        retval += is_utf8((unsigned char *) str.c_str(), str.size(),
+                          &msg, &faulty_bytes);
+    }
+
+    return retval;
+}
+
+static struct benchmark BENCHMARKS[] = {
+    { "pcrepp::match", bench_pcrepp_match, false },
+    { "date_time_scanner::scan", bench_date_time_scan, true },
+    { "data_scanner::tokenize2", bench_tokenize2, false },
+    { "is_utf8", bench_is_utf8, false },
+};
+
+static vector<string> load_inputs(const char **samples)
+{
+    vector<string> retval;
+
+    for (int lpc = 0; samples[lpc]; lpc++) {
+        retval.emplace_back(samples[lpc]);
+    }
+
+    return retval;
+}
+
+int main(int argc, char *argv[])
+{
+    int c, retval = EXIT_SUCCESS;
+    unsigned long iterations = 100000;
+    const char *only = nullptr;
+
+    setenv("TZ", "UTC", 1);
+
+    while ((c = getopt(argc, argv, "n:")) != -1) {
+        switch (c) {
+            case 'n':
+                iterations = strtoul(optarg, nullptr, 10);
+                break;
+            default:
+                fprintf(stderr,
+                        "usage: %s [-n <iterations>] [<benchmark>]\n",
+                        argv[0]);
+                retval = EXIT_FAILURE;
+                break;
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (retval != EXIT_SUCCESS) {
+        return retval;
+    }
+    if (argc > 0) {
+        only = argv[0];
+    }
+
+    auto lines = load_inputs(SAMPLE_LINES);
+    auto times = load_inputs(SAMPLE_TIMES);
+
+    for (const auto &bench : BENCHMARKS) {
+        if (only != nullptr && strcmp(only, bench.b_name) != 0) {
+            continue;
+        }
+
+        const auto &inputs = bench.b_times ? times : lines;
+        size_t bytes = 0;
+
+        for (const auto &str : inputs) {
+            bytes += str.size();
+        }
+
+        // Warm up the caches and any lazily studied patterns.
+        for (int lpc = 0; lpc < 100; lpc++) {
+            BENCH_SINK = BENCH_SINK + bench.b_func(inputs);
+        }
+
+        auto start = chrono::steady_clock::now();
+        for (unsigned long lpc = 0; lpc < iterations; lpc++) {
+            BENCH_SINK = BENCH_SINK + bench.b_func(inputs);
+        }
+        auto end = chrono::steady_clock::now();
+
+        double elapsed_ns =
+            chrono::duration<double, nano>(end - start).count();
+        double calls = (double) iterations * inputs.size();
+
+        printf("%-24s %10.1f ns/call %10.1f MB/s\n",
+               bench.b_name,
+               elapsed_ns / calls,
+               elapsed_ns > 0 ?
+               (bytes * iterations) / (elapsed_ns / 1e9) / (1024 * 1024) :
+               0.0);
+    }
+
+    return retval;
+}
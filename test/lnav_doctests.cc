@@ -29,16 +29,31 @@
 
 #include "config.h"
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <thread>
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.hh"
 
+#include "base/chunked_vector.hh"
+#include "base/index_snapshot.hh"
+#include "base/intern_string.hh"
+#include "base/rank_select_bitmap.hh"
+#include "base/sketches.hh"
+#include "big_array.hh"
+#include "fuzzy_index.hh"
 #include "lnav_config.hh"
 #include "view_curses.hh"
 #include "relative_time.hh"
 #include "unique_path.hh"
 #include "logfile.hh"
+#include "ngram_index.hh"
+#include "pretty_printer.hh"
+#include "vtab_module.hh"
 
 using namespace std;
 
@@ -151,6 +166,43 @@ TEST_CASE("ptime_roundtrip") {
     }
 }
 
+TEST_CASE("ftime_program") {
+    const char *fmts[] = {
+        "%Y-%m-%d %H:%M:%S.%f",
+        "%a %b %e %l:%M:%S %p %Y",
+        "100%% %d/%m/%y",
+    };
+    time_t now = time(nullptr);
+
+    for (auto fmt : fmts) {
+        ftime_program prog(fmt);
+
+        // Go back and forth across days to check the cached dates.
+        for (time_t sec = now; sec < (now + (3 * 24 * 60 * 60)); sec += 3607) {
+            for (time_t curr : {sec, sec - (24 * 60 * 60)}) {
+                char fmt_result[128];
+                char prog_result[128];
+                struct exttm etm;
+                struct tm gmtm;
+
+                memset(&etm, 0, sizeof(etm));
+                secs2tm(&curr, &etm.et_tm);
+                gmtime_r(&curr, &gmtm);
+                CHECK(etm.et_tm.tm_yday == gmtm.tm_yday);
+                CHECK(etm.et_tm.tm_wday == gmtm.tm_wday);
+                etm.et_nsec = 123456789;
+                size_t fmt_size = ftime_fmt(fmt_result, sizeof(fmt_result),
+                                            fmt, etm);
+                size_t prog_size = prog.format(prog_result,
+                                               sizeof(prog_result), etm);
+
+                CHECK(string(fmt_result, fmt_size) ==
+                      string(prog_result, prog_size));
+            }
+        }
+    }
+}
+
 class my_path_source : public unique_path_source {
 public:
     my_path_source(const filesystem::path &p) : mps_path(p) {
@@ -191,4 +243,500 @@ TEST_CASE("unique_path") {
     CHECK(baz2->get_unique_path() == "[foo2]/bar");
     CHECK(log1->get_unique_path() == "[machine1]/syslog.log");
     CHECK(log2->get_unique_path() == "[machine2]/syslog.log");
+
+    auto log3 = make_shared<my_path_source>(
+        "/home/bob/downloads/machine3/var/log/syslog.log");
+
+    upg.add_source(log3);
+    upg.remove_source(bar_dupe);
+    upg.remove_source(baz2);
+    upg.generate();
+
+    CHECK(bar->get_unique_path() == "bar");
+    CHECK(baz->get_unique_path() == "baz");
+    CHECK(log3->get_unique_path() == "[machine3]/syslog.log");
+
+    upg.remove_source(log1);
+    upg.remove_source(log2);
+    upg.generate();
+
+    CHECK(log3->get_unique_path() == "syslog.log");
+}
+
+TEST_CASE("quantile_sketch") {
+    quantile_sketch qs, lower, upper;
+
+    CHECK(qs.count() == 0);
+
+    for (int lpc = 1; lpc <= 1000; lpc++) {
+        qs.add(lpc);
+        if (lpc <= 500) {
+            lower.add(lpc);
+        } else {
+            upper.add(lpc);
+        }
+    }
+
+    CHECK(qs.count() == 1000);
+    CHECK(qs.quantile(0.5) == doctest::Approx(500).epsilon(0.01));
+    CHECK(qs.quantile(0.99) == doctest::Approx(990).epsilon(0.01));
+
+    lower.merge(upper);
+    CHECK(lower.count() == 1000);
+    CHECK(lower.quantile(0.9) == doctest::Approx(900).epsilon(0.01));
+}
+
+TEST_CASE("logline_value_stats") {
+    logline_value_stats lvs, other;
+
+    for (int lpc = 1; lpc <= 100; lpc++) {
+        lvs.add_value(lpc);
+        other.add_value(lpc + 100);
+    }
+
+    lvs.merge(other);
+    CHECK(lvs.lvs_count == 200);
+    CHECK(lvs.lvs_min_value == 1);
+    CHECK(lvs.lvs_max_value == 200);
+    CHECK(lvs.quantile(0.5) == doctest::Approx(100).epsilon(0.02));
+
+    lvs.clear();
+    CHECK(lvs.lvs_count == 0);
+    CHECK(lvs.lvs_sketch.count() == 0);
+}
+
+TEST_CASE("rank_select_bitmap") {
+    rank_select_bitmap rsb;
+    std::vector<size_t> positions;
+
+    CHECK(rsb.empty());
+    for (size_t pos = 0; pos < 5000; pos += 1 + (pos % 7)) {
+        rsb.push_back(pos);
+        positions.push_back(pos);
+    }
+
+    CHECK(rsb.size() == positions.size());
+    for (size_t lpc = 0; lpc < positions.size(); lpc++) {
+        CHECK(rsb[lpc] == positions[lpc]);
+        CHECK(rsb.rank(positions[lpc]) == lpc);
+        CHECK(rsb.test(positions[lpc]));
+    }
+    CHECK(rsb.select(positions.size() / 2) == positions[positions.size() / 2]);
+    for (size_t lpc = positions.size(); lpc > 0; lpc--) {
+        CHECK(rsb[lpc - 1] == positions[lpc - 1]);
+    }
+    CHECK(std::equal(rsb.begin(), rsb.end(), positions.begin()));
+    CHECK(*std::lower_bound(rsb.begin(), rsb.end(), 1001) ==
+          *std::lower_bound(positions.begin(), positions.end(), 1001));
+
+    rsb.remove_if([](size_t pos) { return pos % 2 == 0; });
+    positions.erase(std::remove_if(positions.begin(), positions.end(),
+                                   [](size_t pos) { return pos % 2 == 0; }),
+                    positions.end());
+    CHECK(rsb.size() == positions.size());
+    CHECK(std::equal(rsb.begin(), rsb.end(), positions.begin()));
+    CHECK(rsb[positions.size() - 1] == positions.back());
+
+    rsb.truncate(2500);
+    positions.erase(std::lower_bound(positions.begin(), positions.end(), 2500),
+                    positions.end());
+    CHECK(rsb.size() == positions.size());
+    CHECK(rsb.rank(4000) == positions.size());
+    rsb.push_back(3000);
+    CHECK(rsb[positions.size()] == 3000);
+    CHECK(rsb.rank(3000) == positions.size());
+}
+
+TEST_CASE("rank_select_bitmap concurrent readers") {
+    rank_select_bitmap rsb;
+    std::vector<size_t> positions;
+
+    for (size_t pos = 0; pos < 100000; pos += 1 + (pos % 13)) {
+        rsb.push_back(pos);
+        positions.push_back(pos);
+    }
+
+    std::vector<std::thread> readers;
+    std::atomic<size_t> mismatches{0};
+
+    for (int lpc = 0; lpc < 4; lpc++) {
+        readers.emplace_back([&rsb, &positions, &mismatches, lpc]() {
+            rank_select_bitmap::select_hint hint;
+
+            // Each reader walks in a different direction and stride so the
+            // hints of the readers would clash if they were shared.
+            for (size_t index = 0; index < positions.size(); index++) {
+                size_t n = lpc % 2 == 0 ?
+                           index : positions.size() - index - 1;
+
+                if (rsb.select(n, hint) != positions[n] ||
+                    rsb.rank(positions[n]) != n) {
+                    mismatches += 1;
+                }
+            }
+        });
+    }
+    for (auto &th : readers) {
+        th.join();
+    }
+    CHECK(mismatches == 0);
+
+    // A hint from before positions were removed is not used.
+    rank_select_bitmap::select_hint hint;
+
+    CHECK(rsb.select(10, hint) == positions[10]);
+    rsb.remove_if([](size_t pos) { return pos < 20; });
+    positions.erase(positions.begin(),
+                    std::lower_bound(positions.begin(), positions.end(), 20));
+    CHECK(rsb.select(11, hint) == positions[11]);
+}
+
+TEST_CASE("big_array file-backed") {
+    big_array<uint64_t> ba;
+
+    ba.reserve(1000);
+    for (uint64_t lpc = 0; lpc < 1000; lpc++) {
+        ba.push_back(lpc * 3);
+    }
+
+    auto open_res = open_temp_file(system_tmpdir() / "lnav.ba.XXXXXX");
+
+    REQUIRE(open_res.isOk());
+
+    auto pair = open_res.unwrap();
+
+    pair.first.remove_file();
+
+    // The elements that are already there are moved into the file.
+    CHECK(ba.set_backing_file(auto_fd(pair.second)));
+    CHECK(ba.is_file_backed());
+    CHECK(ba.size() == 1000);
+    CHECK(ba[999] == 999 * 3);
+
+    size_t count = ba.ba_capacity * 4;
+
+    ba.reserve(count);
+    for (uint64_t lpc = ba.size(); lpc < count; lpc++) {
+        ba.push_back(lpc * 3);
+    }
+    CHECK(ba.is_file_backed());
+    for (uint64_t lpc = 0; lpc < count; lpc++) {
+        if (ba[lpc] != lpc * 3) {
+            FAIL("element " << lpc << " was not kept");
+        }
+    }
+
+    struct stat st;
+
+    REQUIRE(fstat(ba.ba_backing_fd, &st) == 0);
+    CHECK((size_t) st.st_size >= count * sizeof(uint64_t));
+
+    CHECK_FALSE(ba.set_backing_file(auto_fd()));
+}
+
+TEST_CASE("distinct_sketch") {
+    distinct_sketch ds, other;
+
+    for (uint64_t lpc = 0; lpc < 10000; lpc++) {
+        auto hash = std::hash<std::string>()(std::to_string(lpc));
+
+        ds.add_hash(hash);
+        ds.add_hash(hash);
+        if (lpc < 5000) {
+            other.add_hash(hash);
+        }
+    }
+
+    CHECK(ds.estimate() == doctest::Approx(10000).epsilon(0.05));
+
+    other.merge(ds);
+    CHECK(other.estimate() == doctest::Approx(10000).epsilon(0.05));
+}
+
+TEST_CASE("top_k_sketch") {
+    top_k_sketch tks(20);
+
+    for (int lpc = 0; lpc < 1000; lpc++) {
+        tks.add("noise" + std::to_string(lpc));
+        if (lpc % 4 == 0) {
+            tks.add("heavy");
+        }
+        if (lpc % 10 == 0) {
+            tks.add("medium");
+        }
+    }
+
+    auto top = tks.top(2);
+
+    REQUIRE(top.size() == 2);
+    CHECK(top[0].i_value == "heavy");
+    CHECK(top[1].i_value == "medium");
+    CHECK(top[0].i_count - top[0].i_error <= 250);
+    CHECK(top[0].i_count >= 250);
+}
+
+TEST_CASE("intern_string concurrent lookup") {
+    const int STRING_COUNT = 10000;
+    vector<vector<const intern_string *>> results(4);
+    vector<thread> workers;
+
+    for (auto &res : results) {
+        workers.emplace_back([&res]() {
+            for (int lpc = 0; lpc < STRING_COUNT; lpc++) {
+                res.push_back(intern_string::lookup(
+                    "concurrent-" + to_string(lpc)));
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    for (auto &res : results) {
+        CHECK(res == results[0]);
+    }
+    CHECK(results[0][42]->to_string() == "concurrent-42");
+    CHECK(intern_string::lookup("concurrent-42", -1) == results[0][42]);
+}
+
+TEST_CASE("ngram_index") {
+    ngram_index ni;
+    const size_t LINE_COUNT = ngram_index::LINES_PER_BLOCK * 3;
+
+    for (size_t lpc = 0; lpc < LINE_COUNT; lpc++) {
+        string line = "line " + to_string(lpc) + " of the file";
+
+        if (lpc == 300) {
+            line += " Request-ID=abc123";
+        }
+        ni.add_line(lpc, line.c_str(), line.length());
+    }
+    CHECK(ni.get_line_count() == LINE_COUNT);
+
+    auto &id_query = ni.query_for("request-id=abc123");
+
+    CHECK(ni.may_contain(id_query, 300));
+    CHECK_FALSE(ni.may_contain(id_query, 10));
+    CHECK_FALSE(ni.may_contain(id_query, 200));
+    CHECK(ni.may_contain(ni.query_for("of the"), 10));
+    CHECK(ni.may_contain(ni.query_for("ab"), 10));
+    CHECK(ni.may_contain(id_query, LINE_COUNT + 10));
+
+    ni.truncate(ngram_index::LINES_PER_BLOCK);
+    CHECK(ni.get_line_count() == ngram_index::LINES_PER_BLOCK);
+    CHECK(ni.may_contain(id_query, 300));
+}
+
+TEST_CASE("ngram_index save and load") {
+    ngram_index ni, restored;
+
+    for (size_t lpc = 0; lpc < 200; lpc++) {
+        string line = "value=" + to_string(lpc * 7919);
+
+        ni.add_line(lpc, line.c_str(), line.length());
+    }
+
+    auto_mem<FILE> tmp(fclose);
+
+    tmp = tmpfile();
+    REQUIRE(tmp != nullptr);
+    REQUIRE(ni.save(fileno(tmp)));
+    lseek(fileno(tmp), 0, SEEK_SET);
+    REQUIRE(restored.load(fileno(tmp), 200));
+    CHECK(restored.get_line_count() == 200);
+    CHECK(restored.may_contain(restored.query_for("value=7919"), 1));
+    CHECK_FALSE(restored.may_contain(restored.query_for("zzzqqq"), 1));
+
+    // A short read leaves the index empty so every line is searched.
+    CHECK_FALSE(restored.load(fileno(tmp), 200));
+    CHECK(restored.get_line_count() == 0);
+    CHECK(restored.may_contain(restored.query_for("zzzqqq"), 1));
+}
+
+TEST_CASE("fuzzy_index") {
+    set<string> cands = {
+        "access_log", "c_ip", "cs_method", "cs_uri_stem", "sc_status",
+        "syslog_log", "log_time",
+    };
+    fuzzy_index fi(cands);
+
+    auto hits = fi.match("csm");
+
+    REQUIRE(hits.size() == 2);
+    CHECK(hits[0].second == "cs_method");
+    CHECK(hits[1].second == "cs_uri_stem");
+    CHECK(hits[0].first > hits[1].first);
+
+    hits = fi.match("cs");
+    CHECK(hits.size() == 4);
+
+    // Narrowing from the previous query has to give the same answer as
+    // starting over.
+    hits = fi.match("csu");
+    REQUIRE(hits.size() == 2);
+    CHECK(hits[0].second == "cs_uri_stem");
+    CHECK(hits[1].second == "sc_status");
+
+    hits = fi.match("LOG");
+    CHECK(hits.size() == 3);
+    CHECK(fi.match("zq").empty());
+}
+
+TEST_CASE("pretty_printer format_lines") {
+    std::string json = "{";
+
+    for (int lpc = 0; lpc < 100; lpc++) {
+        if (lpc > 0) {
+            json += ", ";
+        }
+        json += "\"key" + std::to_string(lpc) + "\": [1, 2, 3]";
+    }
+    json += "}";
+
+    data_scanner full_ds(json);
+    pretty_printer full_pp(&full_ds, string_attrs_t());
+    attr_line_t full_al;
+
+    full_pp.append_to(full_al);
+
+    data_scanner ds(json);
+    pretty_printer pp(&ds, string_attrs_t());
+
+    CHECK(!pp.format_lines(10));
+    CHECK(!pp.is_done());
+
+    auto partial = pp.get_formatted().get_string();
+
+    CHECK(std::count(partial.begin(), partial.end(), '\n') >= 10);
+    CHECK(full_al.get_string().compare(0, partial.size(), partial) == 0);
+
+    CHECK(pp.format_lines(SIZE_MAX));
+    CHECK(pp.is_done());
+    CHECK(pp.get_formatted().get_string() == full_al.get_string());
+}
+
+TEST_CASE("vtab_row_batch") {
+    vtab_row_batch batch(3, 2);
+
+    CHECK(batch.empty());
+
+    batch.add_row(10);
+    batch.set(0, (int64_t) 1);
+    batch.set(1, std::string("abc"));
+    batch.set(2, 0.5);
+    batch.add_row(20);
+    batch.set(1, "def");
+    batch.set(2, (const char *) nullptr);
+
+    CHECK(batch.full());
+    CHECK(batch.size() == 2);
+    CHECK(batch.get_rowid(1) == 20);
+    CHECK(batch.get_type(0, 0) == vtab_row_batch::value_type::INTEGER);
+    CHECK(batch.get_int(0, 0) == 1);
+    CHECK(batch.get_text(0, 1).to_string() == "abc");
+    CHECK(batch.get_float(0, 2) == 0.5);
+    CHECK(batch.get_type(1, 0) == vtab_row_batch::value_type::NULL_VALUE);
+    CHECK(batch.get_text(1, 1).to_string() == "def");
+    CHECK(batch.get_type(1, 2) == vtab_row_batch::value_type::NULL_VALUE);
+
+    batch.clear();
+    CHECK(batch.empty());
+}
+
+TEST_CASE("index_snapshot") {
+    using snapshot_t = index_snapshot<uint64_t>;
+    const size_t chunk = snapshot_t::CHUNK_SIZE;
+    vector<uint64_t> index;
+
+    for (size_t lpc = 0; lpc < chunk * 2 + 10; lpc++) {
+        index.push_back(lpc * 3);
+    }
+
+    auto elem_at = [&index](size_t pos) { return index[pos]; };
+    auto s1 = snapshot_t::create(nullptr, 0, index.size(), 1, elem_at);
+
+    CHECK(s1->size() == index.size());
+    CHECK(s1->get_version() == 1);
+    CHECK((*s1)[0] == 0);
+    CHECK((*s1)[chunk + 1] == (chunk + 1) * 3);
+
+    // Only appended to, so the full chunks are shared.
+    for (size_t lpc = 0; lpc < chunk; lpc++) {
+        index.push_back(7);
+    }
+    auto s2 = snapshot_t::create(s1.get(), s1->size(), index.size(), 2,
+                                 elem_at);
+
+    CHECK(s2->size() == index.size());
+    CHECK(s2->shares_chunk(*s1, 0));
+    CHECK(s2->shares_chunk(*s1, 1));
+    CHECK(!s2->shares_chunk(*s1, 2));
+    CHECK((*s2)[index.size() - 1] == 7);
+    CHECK(s1->size() == chunk * 2 + 10);
+    CHECK((*s1)[chunk * 2 + 9] == (chunk * 2 + 9) * 3);
+
+    // A change in the second chunk means it has to be copied again.
+    index[chunk + 5] = 1;
+    auto s3 = snapshot_t::create(s2.get(), chunk + 5, index.size(), 3,
+                                 elem_at);
+
+    CHECK(s3->shares_chunk(*s2, 0));
+    CHECK(!s3->shares_chunk(*s2, 1));
+    CHECK((*s3)[chunk + 5] == 1);
+    CHECK((*s2)[chunk + 5] == (chunk + 5) * 3);
+}
+
+TEST_CASE("chunked_vector") {
+    using vec_t = chunked_vector<uint64_t, 4>;
+    const size_t chunk = vec_t::CHUNK_SIZE;
+    vec_t vec;
+
+    CHECK(vec.empty());
+    CHECK(vec.begin() == vec.end());
+
+    for (size_t lpc = 0; lpc < chunk * 3 + 1; lpc++) {
+        vec.emplace_back(lpc * 2);
+    }
+
+    uint64_t &first = vec.front();
+
+    CHECK(vec.size() == chunk * 3 + 1);
+    CHECK(vec.capacity() == chunk * 4);
+    CHECK(vec[chunk] == chunk * 2);
+    CHECK(vec.back() == chunk * 6);
+    CHECK(vec.end() - vec.begin() == (ptrdiff_t) vec.size());
+
+    auto iter = std::lower_bound(vec.begin(), vec.end(), chunk * 2 + 1);
+    vec_t::const_iterator citer = iter;
+
+    CHECK(iter - vec.begin() == (ptrdiff_t) chunk + 1);
+    CHECK(*citer == (chunk + 1) * 2);
+    CHECK(citer == iter);
+    CHECK((iter + 2)[-1] == (chunk + 2) * 2);
+
+    // Growing the vector does not move the elements.
+    for (size_t lpc = 0; lpc < chunk * 4; lpc++) {
+        vec.push_back(0);
+    }
+    CHECK(&first == &vec[0]);
+
+    while (vec.size() > chunk + 1) {
+        vec.pop_back();
+    }
+    CHECK(vec.back() == chunk * 2);
+    vec.shrink_to_fit();
+    CHECK(vec.capacity() == chunk * 2);
+
+    vec_t tail(vec.begin() + 2, vec.end());
+
+    CHECK(tail.size() == chunk - 1);
+    CHECK(tail.front() == 4);
+
+    vec = std::move(tail);
+    CHECK(vec.size() == chunk - 1);
+    CHECK(tail.empty());
+
+    vec.clear();
+    CHECK(vec.empty());
+    CHECK(vec.capacity() == 0);
 }
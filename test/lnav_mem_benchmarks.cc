@@ -0,0 +1,338 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * @file lnav_mem_benchmarks.cc
+ *
+ * Measure the memory used for each line of a log file once it has been
+ * indexed.  A corpus is generated from the samples of each of the built-in
+ * text formats, loaded into a view with a filter and some bookmarks, and
+ * the bytes per line are reported for the process as a whole and for each
+ * of the main structures.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "logfile.hh"
+#include "logfile_sub_source.hh"
+#include "log_format.hh"
+#include "log_format_loader.hh"
+#include "textview_curses.hh"
+
+using namespace std;
+
+static const char *CORPUS_NAME = "bench-memory.log";
+
+string execute_any(exec_context &ec, const string &cmdline_with_mode)
+{
+    return "";
+}
+
+void add_global_vars(exec_context &ec)
+{
+}
+
+/**
+ * @return The resident size of the process in bytes.
+ */
+static size_t get_resident_size()
+{
+    FILE *file = fopen("/proc/self/statm", "r");
+    size_t retval = 0;
+
+    if (file != nullptr) {
+        unsigned long total, resident;
+
+        if (fscanf(file, "%lu %lu", &total, &resident) == 2) {
+            retval = resident * getpagesize();
+        }
+        fclose(file);
+    } else {
+        struct rusage ru;
+
+        // Only the peak is available, which is close enough since the index
+        // is only ever grown here.
+        getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+        retval = ru.ru_maxrss;
+#else
+        retval = ru.ru_maxrss * 1024;
+#endif
+    }
+
+    return retval;
+}
+
+/**
+ * Write a corpus of about the given number of lines by repeating the
+ * samples of a format.
+ *
+ * @return The number of lines written.
+ */
+static size_t write_corpus(const external_log_format &elf, size_t lines)
+{
+    FILE *file = fopen(CORPUS_NAME, "w");
+    size_t retval = 0;
+
+    if (file == nullptr) {
+        perror("fopen");
+        exit(EXIT_FAILURE);
+    }
+
+    while (retval < lines) {
+        for (const auto &sample : *elf.elf_samples) {
+            fprintf(file, "%s\n", sample.s_line.c_str());
+            retval += 1 + count(sample.s_line.begin(),
+                                sample.s_line.end(),
+                                '\n');
+        }
+    }
+    fclose(file);
+
+    return retval;
+}
+
+struct memory_report {
+    size_t mr_lines{0};
+    size_t mr_resident{0};
+    size_t mr_lf_index{0};
+    size_t mr_tfs_mask{0};
+    size_t mr_lss_index{0};
+    size_t mr_lss_filtered_index{0};
+    size_t mr_bookmarks{0};
+    size_t mr_caches{0};
+};
+
+static memory_report measure_corpus(const string &format_name)
+{
+    memory_report retval;
+    size_t start_resident = get_resident_size();
+
+    logfile_open_options default_loo;
+    auto lf = make_shared<logfile>(CORPUS_NAME, default_loo);
+    textview_curses tc;
+    logfile_sub_source lss;
+
+    lf->rebuild_index();
+    if (lf->get_format() == nullptr ||
+        lf->get_format()->get_name().to_string() != format_name) {
+        fprintf(stderr,
+                "warning: %s corpus was detected as %s\n",
+                format_name.c_str(),
+                lf->get_format() == nullptr ?
+                "plain text" :
+                lf->get_format()->get_name().get());
+    }
+
+    lss.insert_file(lf);
+    tc.set_sub_source(&lss);
+    lss.rebuild_index();
+
+    auto &fs = lss.get_filters();
+    const char *errptr;
+    int eoff;
+    auto code = pcre_compile("ERROR", 0, &errptr, &eoff, nullptr);
+
+    fs.add_filter(make_shared<pcre_filter>(
+        text_filter::EXCLUDE, "ERROR", fs.next_index(), code));
+    lss.text_filters_changed();
+
+    for (vis_line_t vl = 0_vl; vl < vis_line_t(lss.text_line_count());
+         vl += 100_vl) {
+        lss.set_user_mark(&textview_curses::BM_USER, lss.at(vl));
+    }
+    tc.reload_data();
+
+    retval.mr_lines = lf->size();
+    retval.mr_resident = max(get_resident_size(), start_resident) -
+                         start_resident;
+    retval.mr_lf_index = lf->get_index_memory();
+    retval.mr_tfs_mask = lss.get_filter_mask_memory();
+    retval.mr_lss_index = lss.get_index_memory();
+    retval.mr_lss_filtered_index = lss.get_filtered_index_memory();
+    retval.mr_bookmarks = lss.get_bookmark_memory();
+    for (const auto &pair : tc.get_bookmarks()) {
+        retval.mr_bookmarks += pair.second.capacity() * sizeof(vis_line_t);
+    }
+    retval.mr_caches = lss.get_cache_memory() +
+                       lf->get_search_index_memory();
+    if (lf->get_format() != nullptr) {
+        retval.mr_caches += lf->get_format()->get_cache_memory();
+    }
+
+    return retval;
+}
+
+static void print_report(FILE *results,
+                         const string &format_name,
+                         const memory_report &mr)
+{
+    double lines = mr.mr_lines > 0 ? mr.mr_lines : 1;
+
+    printf("%-20s %8zu lines %8.1f B/line  index %6.1f  mask %5.1f  "
+           "lss %5.1f  filtered %5.1f  marks %5.1f  caches %5.1f\n",
+           format_name.c_str(),
+           mr.mr_lines,
+           mr.mr_resident / lines,
+           mr.mr_lf_index / lines,
+           mr.mr_tfs_mask / lines,
+           mr.mr_lss_index / lines,
+           mr.mr_lss_filtered_index / lines,
+           mr.mr_bookmarks / lines,
+           mr.mr_caches / lines);
+    if (results != nullptr) {
+        fprintf(results,
+                "{\"format\": \"%s\", \"lines\": %zu, "
+                "\"resident\": %zu, \"lf_index\": %zu, "
+                "\"tfs_mask\": %zu, \"lss_index\": %zu, "
+                "\"lss_filtered_index\": %zu, \"bookmarks\": %zu, "
+                "\"caches\": %zu}\n",
+                format_name.c_str(),
+                mr.mr_lines,
+                mr.mr_resident,
+                mr.mr_lf_index,
+                mr.mr_tfs_mask,
+                mr.mr_lss_index,
+                mr.mr_lss_filtered_index,
+                mr.mr_bookmarks,
+                mr.mr_caches);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int c, retval = EXIT_SUCCESS;
+    size_t lines = 200000;
+    const char *results_path = nullptr;
+
+    setenv("TZ", "UTC", 1);
+
+    while ((c = getopt(argc, argv, "n:o:")) != -1) {
+        switch (c) {
+            case 'n':
+                lines = strtoul(optarg, nullptr, 10);
+                break;
+            case 'o':
+                results_path = optarg;
+                break;
+            default:
+                fprintf(stderr,
+                        "usage: %s [-n <lines>] [-o <results>] [<format> ...]\n",
+                        argv[0]);
+                retval = EXIT_FAILURE;
+                break;
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (retval != EXIT_SUCCESS) {
+        return retval;
+    }
+
+    {
+        std::vector<std::string> errors;
+        vector<filesystem::path> paths;
+
+        load_formats(paths, errors);
+    }
+
+    FILE *results = nullptr;
+
+    if (results_path != nullptr &&
+        (results = fopen(results_path, "w")) == nullptr) {
+        perror("fopen");
+        return EXIT_FAILURE;
+    }
+
+    for (auto fmt : log_format::get_root_formats()) {
+        auto elf = dynamic_cast<external_log_format *>(fmt);
+        string format_name = fmt->get_name().to_string();
+
+        if (elf == nullptr || elf->elf_samples->empty()) {
+            continue;
+        }
+        if (argc > 0 &&
+            find_if(argv, argv + argc, [&format_name](const char *arg) {
+                return format_name == arg;
+            }) == argv + argc) {
+            continue;
+        }
+
+        write_corpus(*elf, lines);
+
+        // Each corpus is measured in a fresh process so that the memory
+        // freed by the last one does not hide the cost of this one.
+        fflush(stdout);
+        if (results != nullptr) {
+            fflush(results);
+        }
+
+        pid_t child = fork();
+
+        if (child == -1) {
+            perror("fork");
+            retval = EXIT_FAILURE;
+            break;
+        }
+        if (child == 0) {
+            print_report(results, format_name, measure_corpus(format_name));
+            fflush(stdout);
+            if (results != nullptr) {
+                fflush(results);
+            }
+            _exit(EXIT_SUCCESS);
+        }
+
+        int status;
+
+        waitpid(child, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            fprintf(stderr, "error: %s corpus failed\n", format_name.c_str());
+            retval = EXIT_FAILURE;
+        }
+    }
+
+    if (results != nullptr) {
+        fclose(results);
+    }
+    unlink(CORPUS_NAME);
+
+    return retval;
+}
@@ -70,7 +70,10 @@
 #include <libutil.h>
 #endif
 
+#include <map>
 #include <queue>
+#include <string>
+#include <vector>
 #include <algorithm>
 
 #include "auto_fd.hh"
@@ -309,6 +312,7 @@ private:
 typedef enum {
     CT_SLEEP,
     CT_WRITE,
+    CT_MARK,
 } command_type_t;
 
 struct command {
@@ -318,6 +322,97 @@ struct command {
     } c_arg;
 };
 
+static long timeval_to_us(const struct timeval &tv)
+{
+    return tv.tv_sec * 1000000L + tv.tv_usec;
+}
+
+/**
+ * Measures the time between each write to the child and when its output
+ * settles down, grouped by the label given with the "mark" command.
+ */
+class latency_recorder {
+public:
+    void start(const struct timeval &now)
+    {
+        this->finish();
+        this->lr_write_time = now;
+        this->lr_last_output = now;
+        this->lr_measuring = true;
+    };
+
+    void output(const struct timeval &now)
+    {
+        if (this->lr_measuring) {
+            this->lr_last_output = now;
+        }
+    };
+
+    /**
+     * @return True if there has been no output for the settle time since
+     *   the last write.
+     */
+    bool is_settled(const struct timeval &now, long settle_us) const
+    {
+        if (!this->lr_measuring) {
+            return true;
+        }
+
+        return timeval_to_us(now) - timeval_to_us(this->lr_last_output) >=
+               settle_us;
+    };
+
+    void finish()
+    {
+        if (!this->lr_measuring) {
+            return;
+        }
+
+        this->lr_measuring = false;
+        this->lr_samples[this->lr_label].push_back(
+            timeval_to_us(this->lr_last_output) -
+            timeval_to_us(this->lr_write_time));
+    };
+
+    /**
+     * Write the percentiles for each label, one JSON object per line.
+     */
+    void report(FILE *dst)
+    {
+        this->finish();
+        for (auto &pair : this->lr_samples) {
+            auto &samples = pair.second;
+
+            sort(samples.begin(), samples.end());
+
+            auto pct = [&samples](double fraction) {
+                size_t index = (size_t) (fraction * (samples.size() - 1));
+
+                return samples[index] / 1000.0;
+            };
+
+            fprintf(dst,
+                    "{\"step\": \"%s\", \"keys\": %zu, "
+                    "\"p50_ms\": %.3f, \"p90_ms\": %.3f, "
+                    "\"p99_ms\": %.3f, \"max_ms\": %.3f}\n",
+                    pair.first.c_str(),
+                    samples.size(),
+                    pct(0.50),
+                    pct(0.90),
+                    pct(0.99),
+                    samples.back() / 1000.0);
+        }
+    };
+
+    std::string lr_label{"default"};
+
+private:
+    bool lr_measuring{false};
+    struct timeval lr_write_time;
+    struct timeval lr_last_output;
+    std::map<std::string, std::vector<long>> lr_samples;
+};
+
 static struct {
     const char *sd_program_name;
     sig_atomic_t sd_looping;
@@ -333,6 +428,9 @@ static struct {
     queue<struct command> sd_replay;
 
     bool sd_user_step;
+
+    const char *sd_bench_name;
+    long sd_settle_us;
 } scripty_data;
 
 static void sigchld(int sig)
@@ -347,7 +445,7 @@ static void sigpass(int sig)
 static void usage(void)
 {
     const char *usage_msg =
-        "usage: %s [-h] [-t to_child] [-f from_child] -- <cmd>\n"
+        "usage: %s [-h] [-t to_child] [-f from_child] [-b bench] -- <cmd>\n"
         "\n"
         "Recorder for TTY I/O from a child process."
         "\n"
@@ -364,13 +462,22 @@ static void usage(void)
         "             process.\n"
         "  -e <file>  The file containing the expected output from the child\n"
         "             process.\n"
+        "  -b <file>  The file where the latency of each write in the replayed\n"
+        "             input is reported.  The latency is the time until the\n"
+        "             child's output has settled, the writes are grouped by\n"
+        "             the 'mark <label>' commands in the input.\n"
+        "  -S <ms>    How long the child's output has to be idle before it is\n"
+        "             considered settled, the default is 10.\n"
         "\n"
         "Examples:\n"
         "  To record a session for playback later:\n"
         "    $ scripty -t input.0 -f output.0 -- myCursesApp\n"
         "\n"
         "  To replay the recorded session:\n"
-        "    $ scripty -r input.0 -- myCursesApp\n";
+        "    $ scripty -r input.0 -- myCursesApp\n"
+        "\n"
+        "  To measure how quickly the app responds to the recorded input:\n"
+        "    $ scripty -n -r input.0 -b latency.json -- myCursesApp\n";
 
     fprintf(stderr, usage_msg, scripty_data.sd_program_name);
 }
@@ -381,11 +488,13 @@ int main(int argc, char *argv[])
     expect_handler ex_handler;
     bool passout = true, passin = false;
     FILE *file;
+    latency_recorder latency;
 
     scripty_data.sd_program_name = argv[0];
     scripty_data.sd_looping = true;
+    scripty_data.sd_settle_us = 10 * 1000;
 
-    while ((c = getopt(argc, argv, "ht:f:r:e:nsi")) != -1) {
+    while ((c = getopt(argc, argv, "ht:f:r:e:nsib:S:")) != -1) {
         switch (c) {
             case 'h':
                 usage();
@@ -457,6 +566,11 @@ int main(int argc, char *argv[])
                                 cmd.c_type = CT_WRITE;
                                 cmd.c_arg.b = hex2bits(sp);
                                 scripty_data.sd_replay.push(cmd);
+                            } else if (strcmp(line, "mark") == 0) {
+                                cmd.c_type = CT_MARK;
+                                sp[strcspn(sp, "\r\n")] = '\0';
+                                cmd.c_arg.b = strdup(sp);
+                                scripty_data.sd_replay.push(cmd);
                             } else {
                                 fprintf(stderr,
                                         "error: unknown command -- %s\n",
@@ -475,6 +589,12 @@ int main(int argc, char *argv[])
             case 'i':
                 passin = true;
                 break;
+            case 'b':
+                scripty_data.sd_bench_name = optarg;
+                break;
+            case 'S':
+                scripty_data.sd_settle_us = atol(optarg) * 1000;
+                break;
             default:
                 retval = EXIT_FAILURE;
                 break;
@@ -576,8 +696,13 @@ int main(int argc, char *argv[])
                                 break;
                         }
                     }
+                    struct timeval idle_now;
+
+                    gettimeofday(&idle_now, NULL);
                     if (!scripty_data.sd_replay.empty() && got_expected &&
-                        (!scripty_data.sd_user_step || got_user_step)) {
+                        (!scripty_data.sd_user_step || got_user_step) &&
+                        latency.is_settled(idle_now,
+                                           scripty_data.sd_settle_us)) {
                         struct command cmd = scripty_data.sd_replay.front();
                         int len;
 
@@ -591,11 +716,19 @@ int main(int argc, char *argv[])
                                 break;
                             case CT_WRITE:
                                 len = *((int *) cmd.c_arg.b);
+                                if (scripty_data.sd_bench_name != NULL) {
+                                    latency.start(idle_now);
+                                }
                                 log_perror(write(ct.get_fd(),
                                                  cmd.c_arg.b + sizeof(int),
                                                  len));
                                 delete[] cmd.c_arg.b;
                                 break;
+                            case CT_MARK:
+                                latency.finish();
+                                latency.lr_label = cmd.c_arg.b;
+                                free(cmd.c_arg.b);
+                                break;
                         }
                         got_user_step = false;
                         got_expected = false;
@@ -669,6 +802,7 @@ int main(int argc, char *argv[])
                                 out_len = 0;
                             }
                         } else {
+                            latency.output(now);
                             if (passout)
                                 log_perror(write(STDOUT_FILENO, buffer, rc));
                             if (scripty_data.sd_from_child != NULL) {
@@ -702,6 +836,21 @@ int main(int argc, char *argv[])
         }
 
         retval = ct.wait_for_child() || retval;
+
+        if (scripty_data.sd_bench_name != NULL) {
+            FILE *bench_file = fopen(scripty_data.sd_bench_name, "w");
+
+            if (bench_file == NULL) {
+                fprintf(stderr,
+                        "error: unable to open %s -- %s\n",
+                        scripty_data.sd_bench_name,
+                        strerror(errno));
+                retval = EXIT_FAILURE;
+            } else {
+                latency.report(bench_file);
+                fclose(bench_file);
+            }
+        }
     }
 
     if (scripty_data.sd_to_child != NULL) {
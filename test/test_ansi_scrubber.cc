@@ -68,4 +68,21 @@ int main(int argc, char *argv[])
     assert(sa[1].sa_range.lr_end == 12);
     assert(sa[1].sa_type == &view_curses::VC_STYLE);
     assert(sa[1].sa_value.sav_int == vc.ansi_color_pair(3, 0));
+
+    // Removing a sequence can join the pieces of another one.
+    sa.clear();
+    str_cp = "a\x1b[1\x1b[4mm\x1b[b";
+    scrub_ansi_string(str_cp, sa);
+    assert(str_cp == "a");
+    assert(sa.size() == 2);
+    assert(sa[0].sa_range.lr_start == 4);
+    assert(sa[0].sa_range.lr_end == 1);
+    assert(sa[1].sa_range.lr_start == 1);
+
+    sa.clear();
+    str_cp = "a\x1b[3Cb\x1b\x1b[x";
+    str_cp.push_back('\0');
+    scrub_ansi_string(str_cp, sa);
+    assert(str_cp == "a   b\x1b ");
+    assert(sa.empty());
 }
@@ -111,6 +111,45 @@ int main(int argc, char *argv[])
       last_line = vis_line_t(lpc);
     }
   }
+
+  {
+    bookmark_vector<vis_line_t> bv_batch;
+    std::vector<vis_line_t> lines;
+
+    for (lpc = 0; lpc < 1000; lpc++) {
+      lines.push_back(vis_line_t(random() % LINE_COUNT));
+    }
+    bv_cp = bv;
+    for (auto vl : lines) {
+      bv_cp.insert_once(vl);
+    }
+    bv_batch = bv;
+    bv_batch.insert_batch(lines);
+    assert(bv_batch.size() == bv_cp.size());
+    assert(equal(bv_batch.begin(), bv_batch.end(), bv_cp.begin()));
+
+    lines.clear();
+    lines.push_back(vis_line_t(LINE_COUNT + 2));
+    lines.push_back(vis_line_t(LINE_COUNT + 1));
+    lines.push_back(vis_line_t(LINE_COUNT + 2));
+    bv_batch.insert_batch(lines);
+    assert(bv_batch.size() == bv_cp.size() + 2);
+    assert(bv_batch.back() == LINE_COUNT + 2);
+
+    assert(bv_batch.count_range(vis_line_t(LINE_COUNT),
+                                vis_line_t(-1)) == 2);
+    assert(bv_batch.count_range(vis_line_t(LINE_COUNT + 1),
+                                vis_line_t(LINE_COUNT + 1)) == 1);
+    assert(bv_batch.count_range(vis_line_t(0), vis_line_t(-1)) ==
+           bv_batch.size());
+
+    bv_batch.erase_range(vis_line_t(LINE_COUNT), vis_line_t(-1));
+    assert(bv_batch.size() == bv_cp.size());
+    bv_batch.erase_range(vis_line_t(0), vis_line_t(LINE_COUNT / 2));
+    assert(bv_batch.count_range(vis_line_t(0),
+                                vis_line_t(LINE_COUNT / 2)) == 0);
+    assert(bv_batch.next(vis_line_t(0)) > LINE_COUNT / 2);
+  }
   
   return retval;
 }
@@ -36,6 +36,14 @@ check_output "filter-in vmk is not working" <<EOF
 192.168.202.254 - - [20/Jul/2009:22:59:29 +0000] "GET /vmw/vSphere/default/vmkernel.gz HTTP/1.0" 200 78929 "-" "gPXE/0.9.7"
 EOF
 
+run_test ${lnav_test} -n \
+    -c ":filter-expr :sc_status = 404" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "filter-expr is not working" <<EOF
+192.168.202.254 - - [20/Jul/2009:22:59:29 +0000] "GET /vmw/vSphere/default/vmkboot.gz HTTP/1.0" 404 46210 "-" "gPXE/0.9.7"
+EOF
+
 run_test ${lnav_test} -n \
     -c ":switch-to-view help" \
     ${test_dir}/logfile_access_log.0
@@ -580,6 +588,63 @@ check_output "write-json-to is not working" <<EOF
 EOF
 
 
+run_test ${lnav_test} -n \
+    -c ":export-to export-test.csv SELECT c_ip, sc_bytes, cs_uri_query FROM access_log" \
+    -c ":export-to export-test.jsonl.gz SELECT log_line, sc_status FROM access_log" \
+    ${test_dir}/logfile_access_log.0
+
+run_test cat export-test.csv
+
+check_output "export-to csv is not working" <<EOF
+c_ip,sc_bytes,cs_uri_query
+192.168.202.254,134,
+192.168.202.254,46210,
+192.168.202.254,78929,
+EOF
+
+run_test gzip -dc export-test.jsonl.gz
+
+check_output "export-to jsonl is not working" <<EOF
+{"log_line":0,"sc_status":200}
+{"log_line":1,"sc_status":404}
+{"log_line":2,"sc_status":200}
+EOF
+
+run_test ${lnav_test} -n \
+    -c ":export-to export-test.db SELECT log_line, c_ip, sc_bytes FROM access_log" \
+    ${test_dir}/logfile_access_log.0
+
+run_test ${lnav_test} -n \
+    -c ";SELECT log_line, typeof(sc_bytes) AS bytes_type, sc_bytes FROM export" \
+    -c ":write-csv-to -" \
+    export-test.db
+
+check_output "export-to db is not working" <<EOF
+log_line,bytes_type,sc_bytes
+0,integer,134
+1,integer,46210
+2,integer,78929
+EOF
+
+run_test ${lnav_test} -n \
+    -c ":export-to export-test.parquet SELECT log_line, c_ip, sc_bytes FROM access_log" \
+    ${test_dir}/logfile_access_log.0
+
+run_test ${lnav_test} -n \
+    -c ";CREATE VIRTUAL TABLE exported USING parquet('export-test.parquet')" \
+    -c ";SELECT log_line, c_ip, typeof(sc_bytes) AS bytes_type, sc_bytes FROM exported" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "export-to parquet is not working" <<EOF
+log_line,c_ip,bytes_type,sc_bytes
+0,192.168.202.254,integer,134
+1,192.168.202.254,integer,46210
+2,192.168.202.254,integer,78929
+EOF
+
+rm -f export-test.csv export-test.jsonl.gz export-test.db export-test.parquet
+
 # By setting the LNAVSECURE mode before executing the command, we will disable
 # the access to the write-json-to command and the output would just be the
 # actual display of select query rather than json output.
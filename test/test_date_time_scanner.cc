@@ -140,4 +140,91 @@ int main(int argc, char *argv[])
         assert(rc);
         assert(tm2sec(&tm.et_tm) == 1428721664);
     }
+
+    {
+        const char *custom_fmts[] = {
+            "%Y/%m/%d %H:%M:%S",
+            "%d-%b-%Y %H:%M:%S %Z",
+            NULL,
+        };
+        const char *times[] = {
+            "2015/04/11 03:07:44",
+            "11-Apr-2015 03:07:44 UTC",
+            "2015/04/11 03:07:44.123",
+        };
+        date_time_scanner dts;
+
+        for (const auto time_str : times) {
+            struct timeval tv;
+            struct exttm tm;
+
+            printf("Checking custom time: %s\n", time_str);
+            assert(dts.scan(time_str, strlen(time_str), custom_fmts,
+                            &tm, tv) != NULL);
+            assert(tv.tv_sec == 1428721664);
+            dts.unlock();
+        }
+
+        for (int lpc = 0; custom_fmts[lpc]; lpc++) {
+            ptime_program prog(custom_fmts[lpc]);
+
+            for (const auto time_str : times) {
+                struct exttm tm1, tm2;
+                off_t off1 = 0, off2 = 0;
+
+                memset(&tm1, 0, sizeof(tm1));
+                memset(&tm2, 0, sizeof(tm2));
+                bool rc1 = ptime_fmt(custom_fmts[lpc], &tm1, time_str, off1,
+                                     strlen(time_str));
+                bool rc2 = prog.parse(&tm2, time_str, off2, strlen(time_str));
+                assert(rc1 == rc2);
+                assert(off1 == off2);
+                assert(!rc1 || tm2sec(&tm1.et_tm) == tm2sec(&tm2.et_tm));
+            }
+        }
+    }
+
+    {
+        const char *times[] = {
+            "2015-04-11 03:07:44.123 first",
+            "2015-04-11 03:07:44.456 second",
+            "2015-04-11 03:07:45.001 third",
+            "2015-04-11 03:07:45,002 fourth",
+            "2015-04-11 03:07:45 fifth",
+        };
+        const time_t secs[] = {
+            1428721664, 1428721664, 1428721665, 1428721665, 1428721665,
+        };
+        const suseconds_t usecs[] = {
+            123000, 456000, 1000, 2000, 0,
+        };
+        date_time_scanner dts;
+
+        for (size_t lpc = 0; lpc < 5; lpc++) {
+            struct timeval tv;
+            struct exttm tm;
+
+            memset(&tv, 0, sizeof(tv));
+            printf("Checking repeated second: %s\n", times[lpc]);
+            assert(dts.scan(times[lpc], strlen(times[lpc]), NULL,
+                            &tm, tv) != NULL);
+            assert(tv.tv_sec == secs[lpc]);
+            assert(tv.tv_usec == usecs[lpc]);
+        }
+    }
+
+    {
+        const char *epoch_fmts[] = {
+            "%s",
+            NULL,
+        };
+        date_time_scanner dts;
+        struct timeval tv;
+        struct exttm tm;
+
+        assert(dts.scan("1428721664", 10, epoch_fmts, &tm, tv) != NULL);
+        assert(tv.tv_sec == 1428721664);
+        assert(dts.scan("14287216640", 11, epoch_fmts, &tm, tv) != NULL);
+        assert(tv.tv_sec == 14287216640);
+    }
 }
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <string>
+
+#include "db_row_store.hh"
+
+static const char *NULL_STR = "<NULL>";
+
+static std::string cell_value(size_t row, size_t col)
+{
+    std::string retval = std::to_string(row) + ":" + std::to_string(col);
+
+    if (row % 100 == 7) {
+        // Some cells big enough to get their own chunk.
+        retval.append(32 * 1024, 'x');
+    }
+
+    return retval;
+}
+
+int main(int argc, char *argv[])
+{
+    int retval = EXIT_SUCCESS;
+    db_row_store drs(NULL_STR);
+    const size_t ROWS = db_row_store::PAGE_ROWS * 10 + 3;
+
+    assert(drs.empty());
+
+    for (size_t row = 0; row < ROWS; row++) {
+        drs.start_row();
+        for (size_t col = 0; col < 3; col++) {
+            if (col == 1 && row % 2 == 0) {
+                assert(drs.push_cell(nullptr, 0) == NULL_STR);
+                continue;
+            }
+
+            auto value = cell_value(row, col);
+            const char *cell = drs.push_cell(value.c_str(), value.size());
+
+            assert(value == cell);
+            assert(drs.back().back() == cell);
+        }
+    }
+
+    assert(drs.size() == ROWS);
+
+    // Backwards and jumping around, so pages are evicted and read back.
+    for (size_t row = ROWS; row > 0; row--) {
+        const auto &cells = drs[row - 1];
+
+        assert(cells.size() == 3);
+        for (size_t col = 0; col < 3; col++) {
+            if (col == 1 && (row - 1) % 2 == 0) {
+                assert(cells[col] == NULL_STR);
+            }
+            else {
+                assert(cell_value(row - 1, col) == cells[col]);
+            }
+        }
+    }
+    for (size_t row = 0; row < ROWS; row += 997) {
+        assert(cell_value(row, 0) == drs[row][0]);
+        assert(cell_value(ROWS - 1 - row, 2) == drs[ROWS - 1 - row][2]);
+    }
+
+    drs.clear();
+    assert(drs.empty());
+
+    drs.start_row();
+    drs.push_cell("abc", 3);
+    assert(drs.size() == 1);
+    assert(strcmp(drs[0][0], "abc") == 0);
+
+    return retval;
+}
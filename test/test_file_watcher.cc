@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <algorithm>
+
+#include "auto_fd.hh"
+#include "file_watcher.hh"
+
+int main(int argc, char *argv[])
+{
+    int retval = EXIT_SUCCESS;
+    file_watcher fw;
+
+    if (fw.get_fd() == -1) {
+        // Change notifications are not supported on this system.
+        return retval;
+    }
+
+    char path[] = "file_watcher.XXXXXX";
+    auto_fd fd(mkstemp(path));
+
+    assert(fd != -1);
+
+    int wd = fw.watch(path);
+
+    assert(wd != -1);
+    assert(fw.read_events().empty());
+
+    assert(write(fd, "hello\n", 6) == 6);
+
+    struct pollfd pfd = { fw.get_fd(), POLLIN, 0 };
+
+    assert(poll(&pfd, 1, 5000) == 1);
+
+    auto changed = fw.read_events();
+
+    assert(std::find(changed.begin(), changed.end(), wd) != changed.end());
+    assert(fw.read_events().empty());
+
+    fw.unwatch(wd);
+    unlink(path);
+
+    return retval;
+}
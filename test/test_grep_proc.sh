@@ -48,3 +48,51 @@ EOF
 
 check_output "grep_proc didn't capture matches?" <<EOF
 EOF
+
+run_test ./drive_grep_proc -t '\w+.' gp.dat
+
+check_output "threaded grep_proc didn't find multiple matches?" <<EOF
+0:0:6
+0:7:13
+1:0:8
+1:9:15
+EOF
+
+run_test ./drive_grep_proc -t '(\w+), World' gp.dat
+
+check_error_output "threaded grep_proc didn't capture matches?" <<EOF
+0(0:5)Hello
+1(0:7)Goodbye
+EOF
+
+check_output "threaded grep_proc didn't find the capture matches?" <<EOF
+0:0:12
+1:0:14
+EOF
+
+seq 1 50000 > gp-seq.dat
+./drive_grep_proc '7' gp-seq.dat > gp-seq.out
+
+run_test ./drive_grep_proc -t -w 4 '7' gp-seq.dat
+
+check_output "threaded grep_proc matches are out of order?" < gp-seq.out
+
+./drive_grep_proc 'world' gp.dat > gp-literal.out
+
+run_test ./drive_grep_proc -t 'world' gp.dat
+
+check_output "threaded literal search doesn't match pcre?" < gp-literal.out
+
+./drive_grep_proc '00' gp-seq.dat > gp-seq-literal.out
+
+run_test ./drive_grep_proc -t -w 2 '00' gp-seq.dat
+
+check_output "threaded literal search missed lines?" < gp-seq-literal.out
+
+run_test ./drive_grep_proc -t -c -w 4 '7' gp-seq.dat
+
+check_output "chunked grep_proc matches don't match per-line values?" < gp-seq.out
+
+run_test ./drive_grep_proc -t -c -w 2 '00' gp-seq.dat
+
+check_output "chunked literal search doesn't match per-line values?" < gp-seq-literal.out
@@ -154,6 +154,28 @@ log_line,log_part,log_time,log_idle_msecs,log_level,log_mark,log_comment,log_tag
 EOF
 
 
+run_test ${lnav_test} -n \
+    -I ${test_dir} \
+    -c ";select log_line, user from test_log where user = 'steve@example.com'" \
+    -c ':write-csv-to -' \
+    ${test_dir}/logfile_json.json
+
+check_output "indexed field lookup is not working" <<EOF
+log_line,user
+4,steve@example.com
+EOF
+
+
+run_test ${lnav_test} -n \
+    -I ${test_dir} \
+    -c ";select log_line, user from test_log where user = 'nobody@example.com'" \
+    -c ':write-csv-to -' \
+    ${test_dir}/logfile_json.json
+
+check_output "indexed field lookup found a missing value?" <<EOF
+EOF
+
+
 run_test ${lnav_test} -n \
     -I ${test_dir} \
     -c ';select * from test_log' \
@@ -57,6 +57,41 @@ check_output "Random reads don't match input?" <<EOF
 All done
 EOF
 
+run_test ./drive_line_buffer -m "${top_srcdir}/src/line_buffer.hh"
+
+check_output "Mapped line buffer output doesn't match input?" < \
+    "${top_srcdir}/src/line_buffer.hh"
+
+run_test ./drive_line_buffer -m -i lb.index -n 10 lb-2.dat
+
+check_output "Random reads of a mapped file don't match input?" <<EOF
+All done
+EOF
+
+run_test ./drive_line_buffer -b lb-2.dat
+
+check_output "Batched line buffer output doesn't match input?" < lb-2.dat
+
+run_test ./drive_line_buffer -b -m lb-2.dat
+
+check_output "Batched mapped line buffer output doesn't match input?" < lb-2.dat
+
+run_test ./drive_line_buffer -b < lb-2.dat
+
+check_output "Batched line buffer output doesn't match input from pipe?" < lb-2.dat
+
+run_test ./drive_line_buffer -p < lb-2.dat
+
+check_output "Line buffer fed by a pipe source doesn't match input?" < lb-2.dat
+
+gzip -c lb-2.dat | run_test ./drive_line_buffer
+
+check_output "Line buffer does not decode a gzipped pipe?" < lb-2.dat
+
+gzip -c lb-2.dat | run_test ./drive_line_buffer -p
+
+check_output "Pipe source does not decode a gzipped pipe?" < lb-2.dat
+
 gzip -c ${test_dir}/logfile_access_log.1 > lb-double.gz
 gzip -c ${test_dir}/logfile_access_log.1 >> lb-double.gz
 run_test ${lnav_test} -n lb-double.gz
@@ -75,4 +110,39 @@ run_test ./drive_line_buffer -i lb-3.index -n 10 lb-3.gz lb-3.dat
 
 check_output "Random gzipped reads don't match input" <<EOF
 All done
-EOF
\ No newline at end of file
+EOF
+
+cat lb-3.dat lb-2.dat > lb-4.dat
+grep -b '$' lb-4.dat | cut -f 1 -d : > lb-4.index
+
+if [ "$BZIP2_SUPPORT" -eq 1 ] && [ x"$BZIP2_CMD" != x"" ] ; then
+    $BZIP2_CMD -z -c -1 lb-3.dat > lb-3.bz2
+    $BZIP2_CMD -z -c -1 lb-2.dat >> lb-3.bz2
+
+    run_test ./drive_line_buffer -i lb-4.index -n 10 lb-3.bz2 lb-4.dat
+
+    check_output "Random bzip2 reads don't match input" <<EOF
+All done
+EOF
+fi
+
+if [ "$ZSTD_SUPPORT" -eq 1 ] && [ x"$ZSTD_CMD" != x"" ] ; then
+    $ZSTD_CMD -q -c lb-3.dat > lb-3.zst
+    $ZSTD_CMD -q -c lb-2.dat >> lb-3.zst
+
+    run_test ./drive_line_buffer -i lb-4.index -n 10 lb-3.zst lb-4.dat
+
+    check_output "Random zstd reads don't match input" <<EOF
+All done
+EOF
+fi
+
+if [ "$XZ_SUPPORT" -eq 1 ] && [ x"$XZ_CMD" != x"" ] ; then
+    $XZ_CMD -T 2 --block-size=1MiB -c lb-4.dat > lb-4.xz
+
+    run_test ./drive_line_buffer -i lb-4.index -n 10 lb-4.xz lb-4.dat
+
+    check_output "Random xz reads don't match input" <<EOF
+All done
+EOF
+fi
@@ -31,9 +31,14 @@
 
 #include <stdio.h>
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
 #include "auto_fd.hh"
 #include "line_buffer.hh"
 
@@ -43,6 +48,37 @@ static const char *TEST_DATA =
     "Hello, World!\n"
     "Goodbye, World!\n";
 
+/**
+ * Fills in a sparse copy of TEST_DATA and records the ranges asked for.
+ */
+class test_range_source : public range_source {
+public:
+    test_range_source(int fd) : trs_fd(fd) {};
+
+    Result<void, std::string> fetch_range(file_range fr) override {
+        size_t len = strlen(TEST_DATA);
+
+        this->trs_ranges.push_back(fr);
+        if (fr.fr_offset >= (off_t) len) {
+            return Ok();
+        }
+
+        size_t end = std::min(len, (size_t) fr.next_offset());
+
+        if (pwrite(this->trs_fd,
+                   &TEST_DATA[fr.fr_offset],
+                   end - fr.fr_offset,
+                   fr.fr_offset) == -1) {
+            return Err(std::string(strerror(errno)));
+        }
+
+        return Ok();
+    };
+
+    int trs_fd;
+    std::vector<file_range> trs_ranges;
+};
+
 static void single_line(const char *data)
 {
     line_buffer lb;
@@ -78,7 +114,7 @@ int main(int argc, char *argv[])
 
         auto fd = auto_fd(mkstemp(fn_template));
         remove(fn_template);
-        auto lb = line_buffer();
+        line_buffer lb;
 
         write(fd, TEST_DATA, strlen(TEST_DATA));
         lseek(fd, SEEK_SET, 0);
@@ -153,5 +189,177 @@ int main(int argc, char *argv[])
 
     }
 
+    {
+        char fn_template[] = "test_line_buffer.XXXXXX";
+
+        auto fd = auto_fd(mkstemp(fn_template));
+        remove(fn_template);
+        line_buffer lb;
+
+        write(fd, TEST_DATA, strlen(TEST_DATA));
+        lseek(fd, SEEK_SET, 0);
+
+        lb.set_fd(fd);
+
+        auto result = lb.read_range({7, 5});
+        auto sbr = result.unwrap();
+
+        assert(lb.get_buffer_memory() > 0);
+        assert(lb.release_buffer() > 0);
+        assert(lb.get_buffer_memory() == 0);
+        // The ref keeps the retired buffer alive.
+        assert(string(sbr.get_data(), sbr.length()) == "World");
+
+        auto result2 = lb.read_range({7, 5});
+        auto sbr2 = result2.unwrap();
+
+        assert(string(sbr2.get_data(), sbr2.length()) == "World");
+        assert(lb.get_buffer_memory() > 0);
+
+        line_buffer::enforce_buffer_budget(0);
+        assert(lb.get_buffer_memory() == 0);
+
+        auto result3 = lb.read_range({0, 5});
+
+        assert(string(result3.unwrap().get_data(), 5) == "Hello");
+    }
+
+    {
+        char fn_template[] = "test_line_buffer.XXXXXX";
+
+        auto fd = auto_fd(mkstemp(fn_template));
+        remove(fn_template);
+        shared_buffer_ref sbr;
+
+        write(fd, TEST_DATA, strlen(TEST_DATA));
+        lseek(fd, SEEK_SET, 0);
+
+        {
+            line_buffer lb;
+
+            lb.set_fd(fd);
+            sbr = lb.read_range({0, 5}).unwrap();
+
+            auto data = sbr.get_data();
+
+            // Reading a range outside of the cached data should not change
+            // the memory that the ref points to.
+            lb.clear();
+            lb.read_range({7, 5});
+            assert(sbr.get_data() == data);
+        }
+
+        // The ref outlives the line_buffer without taking a copy.
+        assert(string(sbr.get_data(), sbr.length()) == "Hello");
+    }
+
+    {
+        char fn_template[] = "test_line_buffer.XXXXXX";
+
+        auto fd = auto_fd(mkstemp(fn_template));
+        line_buffer lb;
+
+        write(fd, TEST_DATA, strlen(TEST_DATA));
+        lseek(fd, SEEK_SET, 0);
+
+        lb.set_fd(fd);
+        lb.set_reopen_path(fn_template);
+
+        assert(line_buffer::enforce_fd_limit(0) > 0);
+        assert(lb.is_fd_closed());
+        assert(lb.get_fd() == -1);
+
+        auto result = lb.read_range({7, 5});
+
+        assert(string(result.unwrap().get_data(), 5) == "World");
+        assert(!lb.is_fd_closed());
+
+        assert(lb.close_fd());
+        {
+            char fn_template2[] = "test_line_buffer.XXXXXX";
+            auto_fd fd2 = mkstemp(fn_template2);
+
+            write(fd2, TEST_DATA, strlen(TEST_DATA));
+            rename(fn_template2, fn_template);
+        }
+
+        // A different file with the same name should not be read.
+        lb.release_buffer();
+        assert(!lb.ensure_fd_open());
+        assert(lb.read_range({7, 5}).isErr());
+        remove(fn_template);
+    }
+
+    {
+        char fn_template[] = "test_line_buffer.XXXXXX";
+
+        auto fd = auto_fd(mkstemp(fn_template));
+        remove(fn_template);
+        line_buffer lb;
+
+        // The copy starts out as the right size, but with nothing in it.
+        assert(ftruncate(fd, strlen(TEST_DATA)) == 0);
+
+        auto trs = std::make_shared<test_range_source>(fd.get());
+
+        lb.set_fd(fd);
+        lb.set_range_source(trs);
+        assert(lb.has_range_source());
+
+        auto li = lb.load_next_line({0}).unwrap();
+
+        assert(!trs->trs_ranges.empty());
+        assert(trs->trs_ranges.front().fr_offset == 0);
+        assert(li.li_file_range.fr_size == 14);
+
+        auto sbr = lb.read_range({7, 5}).unwrap();
+
+        assert(string(sbr.get_data(), sbr.length()) == "World");
+
+        auto start = lb.find_line_start(20).unwrap();
+
+        assert(start == 14);
+    }
+
+    {
+        static const char RECORDS[] =
+            "\x00\x00\x00\x08\x81\xa3msg\xa2" "a\n"
+            "\x00\x00\x00\x07\x81\xa3msg\xa1" "b"
+            "\x00\x00\x00\x0a\x81\xa3m";
+        char fn_template[] = "test_line_buffer.XXXXXX";
+
+        auto fd = auto_fd(mkstemp(fn_template));
+        remove(fn_template);
+        line_buffer lb;
+
+        write(fd, RECORDS, sizeof(RECORDS) - 1);
+        lseek(fd, SEEK_SET, 0);
+
+        lb.set_fd(fd);
+
+        // The line feed in the first record does not end it.
+        auto li = lb.load_next_line({0}).unwrap();
+
+        assert(lb.is_length_prefixed());
+        assert(li.li_file_range.fr_offset == 0);
+        assert(li.li_file_range.fr_size == 12);
+        assert(!li.li_partial);
+
+        auto sbr = lb.read_range(li.li_file_range).unwrap();
+
+        assert(sbr.get_data()[11] == '\n');
+
+        li = lb.load_next_line(li.li_file_range).unwrap();
+        assert(li.li_file_range.fr_offset == 12);
+        assert(li.li_file_range.fr_size == 11);
+        assert(!li.li_partial);
+
+        li = lb.load_next_line(li.li_file_range).unwrap();
+        assert(li.li_file_range.fr_offset == 23);
+        assert(li.li_partial);
+
+        assert(lb.find_line_start(20).unwrap() == 0);
+    }
+
     return retval;
 }
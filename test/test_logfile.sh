@@ -65,6 +65,47 @@ run_test ./drive_logfile ${srcdir}/logfile_empty.0
 
 on_error_fail_with "Didn't handle empty log?"
 
+run_test ./drive_logfile -c -f generic_log ${srcdir}/logfile_multiline.0
+
+check_output "Reading a message in chunks doesn't match the full message?" <<EOF
+2009-07-20 22:59:27,672:DEBUG:Hello, World!
+  How are you today?
+2009-07-20 22:59:30,221:ERROR:Goodbye, World!
+EOF
+
+seq 1 200000 | sed -e 's/^/line number /' > logfile_sliced.0
+run_test ./drive_logfile -s -l logfile_sliced.0
+
+check_output "Indexing in slices lost lines?" <<EOF
+200000
+EOF
+
+run_test ./drive_logfile -s -T 100000 -e logfile_sliced.0
+
+check_output "Indexing the tail first changed the lines?" < logfile_sliced.0
+
+awk 'BEGIN {
+    for (i = 0; i < 30000; i++) {
+        printf("Nov  3 %02d:%02d:%02d veridian worker[%d]: request %d\n",
+               9 + int(i / 3600), int(i / 60) % 60, i % 60, 100 + i % 3, i);
+    }
+}' > logfile_opids.0
+run_test ./drive_logfile -o -f syslog_log logfile_opids.0
+
+check_output "The opid index does not have the right lines?" <<EOF
+100 10000 0 29997
+101 10000 1 29998
+102 10000 2 29999
+EOF
+
+run_test ./drive_logfile -s -T 100000 -o -f syslog_log logfile_opids.0
+
+check_output "Indexing the tail first changed the opid index?" <<EOF
+100 10000 0 29997
+101 10000 1 29998
+102 10000 2 29999
+EOF
+
 cp ${srcdir}/logfile_syslog.0 logfile_syslog.0
 touch -t 200711030923 logfile_syslog.0
 run_test ./drive_logfile -t -f syslog_log logfile_syslog.0
@@ -109,6 +150,30 @@ Dec 03 09:23:38 2006 -- 000
 Jan 03 09:47:02 2007 -- 000
 EOF
 
+(cd ${srcdir} && tar cf - logfile_access_log.0) > logfile_access_log.tar
+
+run_test ${lnav_test} -n \
+    -c ";SELECT count(*) AS total FROM access_log WHERE log_path LIKE '%.tar/logfile_access_log.0'" \
+    -c ":write-csv-to -" \
+    logfile_access_log.tar
+
+check_output "tar archive members are not opened?" <<EOF
+total
+3
+EOF
+
+gzip -c logfile_access_log.tar > logfile_access_log.tar.gz
+
+run_test ${lnav_test} -n \
+    -c ";SELECT count(*) AS total FROM access_log WHERE log_path LIKE '%.tar.gz/logfile_access_log.0'" \
+    -c ":write-csv-to -" \
+    logfile_access_log.tar.gz
+
+check_output "gzipped tar archive members are not opened?" <<EOF
+total
+3
+EOF
+
 if [ "$BZIP2_SUPPORT"  -eq 1 ] && [ x"$BZIP2_CMD" != x"" ] ; then
     $BZIP2_CMD -z -c "${srcdir}/logfile_syslog.1" > logfile_syslog.1.bz2
 
@@ -337,6 +402,13 @@ check_output "piping to stdin is not working?" <<EOF
 2013-06-06T19:13:20.123  ---- END-OF-STDIN ----
 EOF
 
+echo "Hi" | gzip -c | run_test ${lnav_test} -d /tmp/lnav.err -nt -w logfile_stdin.log
+
+check_output "piping gzipped data to stdin is not working?" <<EOF
+2013-06-06T19:13:20.123  Hi
+2013-06-06T19:13:20.123  ---- END-OF-STDIN ----
+EOF
+
 run_test ${lnav_test} -C ${srcdir}/logfile_bad_syslog.0
 
 sed -i "" -e "s|/.*/logfile_bad_syslog.0|logfile_bad_syslog.0|g" `test_err_filename`
@@ -410,3 +482,11 @@ EOF
 # 192.168.202.254 - - [20/Jul/2009:22:59:29 +0000] "GET /vmw/vSphere/default/vmkboot.gz HTTP/1.0" 404 46210 "-" "gPXE/0.9.7"
 # 192.168.202.254 - - [20/Jul/2009:22:59:29 +0000] "GET /vmw/vSphere/default/vmkernel.gz HTTP/1.0" 200 78929 "-" "gPXE/0.9.7"
 # EOF
+
+printf 'complete line 1\ncomplete line 2\npartial line' > logfile_agent.0
+run_test ${lnav_test} -A logfile_agent.0 < /dev/null
+
+check_output "the agent did not send just the complete lines?" <<EOF
+complete line 1
+complete line 2
+EOF
@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <set>
+
+#include "base/multi_literal.hh"
+
+static std::set<size_t> scan(const multi_literal_matcher &mlm, const char *str)
+{
+    std::set<size_t> retval;
+
+    mlm.scan(str, strlen(str), [&retval](size_t id) {
+        retval.insert(id);
+    });
+
+    return retval;
+}
+
+int main(int argc, char *argv[])
+{
+    {
+        multi_literal_matcher mlm;
+
+        assert(mlm.empty());
+        assert(scan(mlm, "hello, world").empty());
+    }
+
+    {
+        multi_literal_matcher mlm;
+
+        mlm.add("he", 0);
+        mlm.add("she", 1);
+        mlm.add("his", 2);
+        mlm.add("hers", 3);
+        mlm.compile();
+
+        assert(!mlm.empty());
+        assert((scan(mlm, "ushers") == std::set<size_t>{0, 1, 3}));
+        assert((scan(mlm, "this") == std::set<size_t>{2}));
+        assert((scan(mlm, "SHE SAID") == std::set<size_t>{0, 1}));
+        assert(scan(mlm, "abc").empty());
+        assert(scan(mlm, "").empty());
+    }
+
+    {
+        multi_literal_matcher mlm;
+
+        mlm.add("error", 5);
+        mlm.add("connection reset", 70);
+        mlm.compile();
+
+        assert((scan(mlm, "I/O ERROR: Connection Reset by peer") ==
+                std::set<size_t>{5, 70}));
+        assert((scan(mlm, "connection resets") == std::set<size_t>{70}));
+        assert(scan(mlm, "connection refused").empty());
+
+        mlm.clear();
+        assert(mlm.empty());
+        assert(scan(mlm, "error").empty());
+    }
+
+    return EXIT_SUCCESS;
+}
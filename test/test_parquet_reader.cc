@@ -0,0 +1,952 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "frame_indexed.hh"
+#include "parquet_reader.hh"
+#include "parquet_vtab.hh"
+
+using namespace std;
+
+static const int64_t BASE_MILLIS = 1600000000000LL;
+static const int GROUP_ROWS[] = {4, 3};
+
+static bool level_is_null(int row)
+{
+    return row % 3 == 2;
+}
+
+static const char *level_of(int row)
+{
+    return row % 2 == 0 ? "info" : "error";
+}
+
+static bool count_is_null(int row)
+{
+    return row == 1;
+}
+
+static uint64_t zigzag(int64_t value)
+{
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static void put_uleb(string &out, uint64_t value)
+{
+    do {
+        uint8_t b = value & 0x7f;
+
+        value >>= 7;
+        out.push_back(value ? (b | 0x80) : b);
+    } while (value);
+}
+
+static void put_le32(string &out, uint32_t value)
+{
+    for (int lpc = 0; lpc < 4; lpc++) {
+        out.push_back((value >> (8 * lpc)) & 0xff);
+    }
+}
+
+static void put_le64(string &out, uint64_t value)
+{
+    put_le32(out, value);
+    put_le32(out, value >> 32);
+}
+
+static string bit_pack(const vector<uint64_t> &values, int width)
+{
+    string retval((values.size() * width + 7) / 8, '\0');
+    size_t bit = 0;
+
+    for (auto value : values) {
+        for (int lpc = 0; lpc < width; lpc++, bit++) {
+            if ((value >> lpc) & 1) {
+                retval[bit / 8] |= 1 << (bit % 8);
+            }
+        }
+    }
+
+    return retval;
+}
+
+/** Writer for the Thrift compact protocol. */
+class compact_writer {
+public:
+    string cw_out;
+
+    void field(int16_t id, uint8_t type) {
+        int16_t delta = id - this->cw_last.back();
+
+        if (delta > 0 && delta <= 15) {
+            this->cw_out.push_back((delta << 4) | type);
+        } else {
+            this->cw_out.push_back(type);
+            put_uleb(this->cw_out, zigzag(id));
+        }
+        this->cw_last.back() = id;
+    };
+
+    void i32(int16_t id, int32_t value) {
+        this->field(id, 5);
+        put_uleb(this->cw_out, zigzag(value));
+    };
+
+    void i64(int16_t id, int64_t value) {
+        this->field(id, 6);
+        put_uleb(this->cw_out, zigzag(value));
+    };
+
+    void boolean(int16_t id, bool value) {
+        this->field(id, value ? 1 : 2);
+    };
+
+    void binary(int16_t id, const string &value) {
+        this->field(id, 8);
+        this->raw_binary(value);
+    };
+
+    void raw_binary(const string &value) {
+        put_uleb(this->cw_out, value.size());
+        this->cw_out.append(value);
+    };
+
+    void begin_struct(int16_t id) {
+        this->field(id, 12);
+        this->cw_last.push_back(0);
+    };
+
+    void begin_struct() {
+        this->cw_last.push_back(0);
+    };
+
+    void end_struct() {
+        this->cw_out.push_back(0);
+        this->cw_last.pop_back();
+    };
+
+    void list(int16_t id, uint8_t elem_type, size_t size) {
+        this->field(id, 9);
+        if (size < 15) {
+            this->cw_out.push_back((size << 4) | elem_type);
+        } else {
+            this->cw_out.push_back(0xf0 | elem_type);
+            put_uleb(this->cw_out, size);
+        }
+    };
+
+private:
+    vector<int16_t> cw_last{0};
+};
+
+/** A greedy snappy compressor that uses literals and two byte copies. */
+static string snappy_compress(const string &in)
+{
+    string out;
+    size_t pos = 0, lit_start = 0;
+    auto flush_literal = [&](size_t end) {
+        while (lit_start < end) {
+            size_t len = std::min(end - lit_start, (size_t) 60);
+
+            out.push_back((len - 1) << 2);
+            out.append(in, lit_start, len);
+            lit_start += len;
+        }
+    };
+
+    put_uleb(out, in.size());
+    while (pos < in.size()) {
+        size_t best_len = 0, best_off = 0;
+
+        for (size_t off = 1; off <= pos && off <= 64; off++) {
+            size_t len = 0;
+
+            while (pos + len < in.size() && len < 64 &&
+                   in[pos + len] == in[pos + len - off]) {
+                len += 1;
+            }
+            if (len > best_len) {
+                best_len = len;
+                best_off = off;
+            }
+        }
+        if (best_len >= 4) {
+            flush_literal(pos);
+            out.push_back(((best_len - 1) << 2) | 2);
+            out.push_back(best_off & 0xff);
+            out.push_back(best_off >> 8);
+            pos += best_len;
+            lit_start = pos;
+        } else {
+            pos += 1;
+        }
+    }
+    flush_literal(in.size());
+
+    return out;
+}
+
+static string gzip_compress(const string &in)
+{
+    z_stream strm;
+    string out(in.size() + 128, '\0');
+
+    memset(&strm, 0, sizeof(strm));
+    assert(deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                        15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    strm.next_in = (Bytef *) in.data();
+    strm.avail_in = in.size();
+    strm.next_out = (Bytef *) &out[0];
+    strm.avail_out = out.size();
+    assert(deflate(&strm, Z_FINISH) == Z_STREAM_END);
+    out.resize(out.size() - strm.avail_out);
+    deflateEnd(&strm);
+
+    return out;
+}
+
+static string compress(int32_t codec, const string &in)
+{
+    switch (codec) {
+        case 1:
+            return snappy_compress(in);
+        case 2:
+            return gzip_compress(in);
+        default:
+            return in;
+    }
+}
+
+static string delta_binary(const vector<int64_t> &values)
+{
+    const size_t BLOCK_SIZE = 128, MINIBLOCKS = 4;
+    const size_t PER_MINIBLOCK = BLOCK_SIZE / MINIBLOCKS;
+    string out;
+
+    put_uleb(out, BLOCK_SIZE);
+    put_uleb(out, MINIBLOCKS);
+    put_uleb(out, values.size());
+    put_uleb(out, zigzag(values[0]));
+    for (size_t start = 1; start < values.size(); start += BLOCK_SIZE) {
+        vector<int64_t> deltas;
+
+        for (size_t lpc = start;
+             lpc < std::min(start + BLOCK_SIZE, values.size());
+             lpc++) {
+            deltas.push_back(values[lpc] - values[lpc - 1]);
+        }
+
+        int64_t min_delta = *min_element(deltas.begin(), deltas.end());
+        string widths, data;
+
+        put_uleb(out, zigzag(min_delta));
+        for (size_t mb = 0; mb < MINIBLOCKS; mb++) {
+            vector<uint64_t> adjusted(PER_MINIBLOCK, 0);
+            int width = 0;
+
+            for (size_t lpc = 0; lpc < PER_MINIBLOCK; lpc++) {
+                size_t index = mb * PER_MINIBLOCK + lpc;
+
+                if (index < deltas.size()) {
+                    adjusted[lpc] = deltas[index] - min_delta;
+                    while (width < 64 && (adjusted[lpc] >> width) != 0) {
+                        width += 1;
+                    }
+                }
+            }
+            widths.push_back(width);
+            if (mb * PER_MINIBLOCK < deltas.size()) {
+                data.append(bit_pack(adjusted, width));
+            }
+        }
+        out.append(widths);
+        out.append(data);
+    }
+
+    return out;
+}
+
+/** Encode the levels as RLE runs. */
+static string rle_levels(const vector<int> &levels)
+{
+    string out;
+
+    for (size_t start = 0; start < levels.size(); ) {
+        size_t end = start;
+
+        while (end < levels.size() && levels[end] == levels[start]) {
+            end += 1;
+        }
+        put_uleb(out, (end - start) << 1);
+        out.push_back(levels[start]);
+        start = end;
+    }
+
+    return out;
+}
+
+/** Encode values as bit-packed groups. */
+static string bit_packed_run(vector<uint64_t> values, int width)
+{
+    string out;
+    size_t groups = (values.size() + 7) / 8;
+
+    values.resize(groups * 8, 0);
+    put_uleb(out, (groups << 1) | 1);
+    out.append(bit_pack(values, width));
+
+    return out;
+}
+
+static string page_header(int32_t page_type,
+                          const string &body,
+                          const string &compressed,
+                          int32_t num_values,
+                          int32_t encoding,
+                          int32_t num_nulls = 0,
+                          int32_t def_len = 0)
+{
+    compact_writer cw;
+
+    cw.i32(1, page_type);
+    cw.i32(2, body.size());
+    cw.i32(3, compressed.size());
+    switch (page_type) {
+        case 0:
+            cw.begin_struct(5);
+            cw.i32(1, num_values);
+            cw.i32(2, encoding);
+            cw.i32(3, 3);
+            cw.i32(4, 3);
+            cw.end_struct();
+            break;
+        case 2:
+            cw.begin_struct(7);
+            cw.i32(1, num_values);
+            cw.i32(2, encoding);
+            cw.end_struct();
+            break;
+        case 3:
+            cw.begin_struct(8);
+            cw.i32(1, num_values);
+            cw.i32(2, num_nulls);
+            cw.i32(3, num_values);
+            cw.i32(4, encoding);
+            cw.i32(5, def_len);
+            cw.i32(6, 0);
+            cw.boolean(7, true);
+            cw.end_struct();
+            break;
+    }
+    cw.end_struct();
+
+    return cw.cw_out;
+}
+
+static string data_page_v1(int32_t codec,
+                           int32_t encoding,
+                           int32_t num_values,
+                           const string &levels,
+                           const string &values)
+{
+    string body;
+
+    if (!levels.empty()) {
+        put_le32(body, levels.size());
+        body.append(levels);
+    }
+    body.append(values);
+
+    string compressed = compress(codec, body);
+
+    return page_header(0, body, compressed, num_values, encoding) + compressed;
+}
+
+static string data_page_v2(int32_t codec,
+                           int32_t encoding,
+                           int32_t num_values,
+                           int32_t num_nulls,
+                           const string &levels,
+                           const string &values)
+{
+    string compressed = compress(codec, values);
+    string body = levels + values;
+
+    return page_header(3, body, levels + compressed, num_values, encoding,
+                       num_nulls, levels.size()) +
+           levels + compressed;
+}
+
+struct chunk_data {
+    int32_t cd_type{0};
+    int32_t cd_codec{0};
+    string cd_pages;
+    size_t cd_data_offset{0};
+    bool cd_has_dict{false};
+    bool cd_has_stats{false};
+    string cd_min;
+    string cd_max;
+    int64_t cd_null_count{-1};
+};
+
+static string time_plain(int row, int64_t &millis_out)
+{
+    string retval;
+
+    millis_out = BASE_MILLIS + row * 1500;
+    put_le64(retval, millis_out);
+
+    return retval;
+}
+
+static chunk_data time_chunk(int first, int rows)
+{
+    chunk_data retval;
+    string values;
+    int64_t millis;
+
+    retval.cd_type = 2;
+    for (int row = first; row < first + rows; row++) {
+        values.append(time_plain(row, millis));
+    }
+    retval.cd_pages = data_page_v1(0, 0, rows, "", values);
+    retval.cd_has_stats = true;
+    retval.cd_min = time_plain(first, millis);
+    retval.cd_max = time_plain(first + rows - 1, millis);
+    retval.cd_null_count = 0;
+
+    return retval;
+}
+
+static chunk_data level_chunk(int first, int rows)
+{
+    chunk_data retval;
+    string dict;
+    vector<int> levels;
+    vector<uint64_t> indexes;
+
+    retval.cd_type = 6;
+    retval.cd_codec = 1;
+    for (const char *level : {"info", "error"}) {
+        put_le32(dict, strlen(level));
+        dict.append(level);
+    }
+
+    string compressed = compress(1, dict);
+
+    retval.cd_pages = page_header(2, dict, compressed, 2, 0) + compressed;
+    retval.cd_data_offset = retval.cd_pages.size();
+    retval.cd_has_dict = true;
+    for (int row = first; row < first + rows; row++) {
+        levels.push_back(!level_is_null(row));
+        if (!level_is_null(row)) {
+            indexes.push_back(row % 2);
+        }
+    }
+
+    string values(1, (char) 1);
+
+    values.append(bit_packed_run(indexes, 1));
+    retval.cd_pages.append(
+        data_page_v1(1, 8, rows, rle_levels(levels), values));
+
+    return retval;
+}
+
+static string message_of(int row)
+{
+    return "message number " + to_string(row);
+}
+
+static chunk_data message_chunk(int first, int rows)
+{
+    chunk_data retval;
+    string values;
+
+    retval.cd_type = 6;
+    retval.cd_codec = 1;
+    for (int row = first; row < first + rows; row++) {
+        string msg = message_of(row);
+
+        put_le32(values, msg.size());
+        values.append(msg);
+    }
+    retval.cd_pages = data_page_v2(1, 0, rows, 0, "", values);
+    retval.cd_has_stats = true;
+    retval.cd_min = message_of(first);
+    retval.cd_max = message_of(first + rows - 1);
+
+    return retval;
+}
+
+static string host_of(int row)
+{
+    return row % 2 == 0 ? "web 1" : "db";
+}
+
+static chunk_data host_chunk(int first, int rows)
+{
+    chunk_data retval;
+    vector<int64_t> prefixes, lengths;
+    string suffixes, prev;
+
+    retval.cd_type = 6;
+    for (int row = first; row < first + rows; row++) {
+        string host = host_of(row);
+        size_t prefix = 0;
+
+        while (prefix < prev.size() && prefix < host.size() &&
+               prev[prefix] == host[prefix]) {
+            prefix += 1;
+        }
+        prefixes.push_back(prefix);
+        lengths.push_back(host.size() - prefix);
+        suffixes.append(host, prefix, string::npos);
+        prev = host;
+    }
+    retval.cd_pages = data_page_v1(
+        0, 7, rows, "",
+        delta_binary(prefixes) + delta_binary(lengths) + suffixes);
+
+    return retval;
+}
+
+static chunk_data count_chunk(int first, int rows)
+{
+    chunk_data retval;
+    vector<int64_t> values;
+    vector<int> levels;
+
+    retval.cd_type = 1;
+    retval.cd_codec = 2;
+    for (int row = first; row < first + rows; row++) {
+        levels.push_back(!count_is_null(row));
+        if (!count_is_null(row)) {
+            values.push_back(row * 10 - 3);
+        }
+    }
+    retval.cd_pages = data_page_v2(
+        2, 5, rows, rows - values.size(), rle_levels(levels),
+        delta_binary(values));
+
+    return retval;
+}
+
+static chunk_data ratio_chunk(int first, int rows)
+{
+    chunk_data retval;
+    string values(rows * 8, '\0');
+
+    retval.cd_type = 5;
+    for (int row = first; row < first + rows; row++) {
+        double value = row + 0.5;
+        unsigned char bytes[8];
+
+        memcpy(bytes, &value, sizeof(bytes));
+        for (int byte = 0; byte < 8; byte++) {
+            values[byte * rows + (row - first)] = bytes[byte];
+        }
+    }
+    retval.cd_pages = data_page_v1(0, 9, rows, "", values);
+
+    return retval;
+}
+
+static void write_schema(compact_writer &cw)
+{
+    cw.list(2, 12, 9);
+
+    cw.begin_struct();
+    cw.binary(4, "schema");
+    cw.i32(5, 7);
+    cw.end_struct();
+
+    cw.begin_struct();
+    cw.i32(1, 2);
+    cw.i32(3, 0);
+    cw.binary(4, "time");
+    cw.begin_struct(10);
+    cw.begin_struct(8);
+    cw.boolean(1, true);
+    cw.begin_struct(2);
+    cw.begin_struct(1);
+    cw.end_struct();
+    cw.end_struct();
+    cw.end_struct();
+    cw.end_struct();
+    cw.end_struct();
+
+    cw.begin_struct();
+    cw.i32(1, 6);
+    cw.i32(3, 1);
+    cw.binary(4, "level");
+    cw.i32(6, 0);
+    cw.end_struct();
+
+    cw.begin_struct();
+    cw.i32(1, 6);
+    cw.i32(3, 0);
+    cw.binary(4, "message");
+    cw.begin_struct(10);
+    cw.begin_struct(1);
+    cw.end_struct();
+    cw.end_struct();
+    cw.end_struct();
+
+    cw.begin_struct();
+    cw.i32(1, 6);
+    cw.i32(3, 0);
+    cw.binary(4, "host");
+    cw.end_struct();
+
+    // A group, which is left out of the columns.
+    cw.begin_struct();
+    cw.i32(3, 1);
+    cw.binary(4, "extra");
+    cw.i32(5, 1);
+    cw.end_struct();
+
+    cw.begin_struct();
+    cw.i32(1, 1);
+    cw.i32(3, 1);
+    cw.binary(4, "a");
+    cw.end_struct();
+
+    cw.begin_struct();
+    cw.i32(1, 1);
+    cw.i32(3, 1);
+    cw.binary(4, "count");
+    cw.end_struct();
+
+    cw.begin_struct();
+    cw.i32(1, 5);
+    cw.i32(3, 0);
+    cw.binary(4, "ratio");
+    cw.end_struct();
+}
+
+/**
+ * Write the test file.
+ *
+ * @param corrupt If true, the message column in the first row group is
+ *   replaced with garbage so that decoding it fails.
+ */
+static void write_file(const char *path, bool corrupt)
+{
+    string data = "PAR1";
+    compact_writer cw;
+    int first = 0;
+
+    cw.i32(1, 1);
+    write_schema(cw);
+    cw.i64(3, GROUP_ROWS[0] + GROUP_ROWS[1]);
+    cw.list(4, 12, 2);
+    for (int rows : GROUP_ROWS) {
+        vector<chunk_data> chunks = {
+            time_chunk(first, rows),
+            level_chunk(first, rows),
+            message_chunk(first, rows),
+            host_chunk(first, rows),
+            chunk_data(),
+            count_chunk(first, rows),
+            ratio_chunk(first, rows),
+        };
+
+        chunks[4].cd_type = 1;
+        if (corrupt && first == 0) {
+            chunks[2].cd_pages.assign(chunks[2].cd_pages.size(), '\xff');
+        }
+
+        cw.begin_struct();
+        cw.list(1, 12, chunks.size());
+        for (const auto &cd : chunks) {
+            size_t start = data.size();
+
+            data.append(cd.cd_pages);
+
+            cw.begin_struct();
+            cw.i64(2, start);
+            cw.begin_struct(3);
+            cw.i32(1, cd.cd_type);
+            cw.list(2, 5, 1);
+            put_uleb(cw.cw_out, zigzag(0));
+            cw.list(3, 8, 1);
+            cw.raw_binary("col");
+            cw.i32(4, cd.cd_codec);
+            cw.i64(5, rows);
+            cw.i64(6, cd.cd_pages.size());
+            cw.i64(7, cd.cd_pages.size());
+            cw.i64(9, start + cd.cd_data_offset);
+            if (cd.cd_has_dict) {
+                cw.i64(11, start);
+            }
+            if (cd.cd_has_stats) {
+                cw.begin_struct(12);
+                if (cd.cd_null_count >= 0) {
+                    cw.i64(3, cd.cd_null_count);
+                }
+                cw.binary(5, cd.cd_max);
+                cw.binary(6, cd.cd_min);
+                cw.end_struct();
+            }
+            cw.end_struct();
+            cw.end_struct();
+        }
+        cw.i64(2, 0);
+        cw.i64(3, rows);
+        cw.end_struct();
+        first += rows;
+    }
+    cw.binary(6, "test_parquet_reader");
+    cw.end_struct();
+
+    data.append(cw.cw_out);
+    put_le32(data, cw.cw_out.size());
+    data.append("PAR1");
+
+    FILE *file = fopen(path, "w");
+
+    assert(file != nullptr);
+    assert(fwrite(data.data(), 1, data.size(), file) == data.size());
+    fclose(file);
+}
+
+static string expected_line(int row)
+{
+    char time[64];
+    string retval;
+
+    snprintf(time, sizeof(time), "2020-09-13T12:26:%02d.%03d000+0000",
+             40 + (row * 1500) / 1000, (row * 1500) % 1000);
+    retval = time;
+    if (!level_is_null(row)) {
+        retval += " ";
+        retval += level_of(row);
+    }
+    retval += " " + message_of(row);
+    if (host_of(row).find(' ') != string::npos) {
+        retval += " host=\"" + host_of(row) + "\"";
+    } else {
+        retval += " host=" + host_of(row);
+    }
+    if (!count_is_null(row)) {
+        retval += " count=" + to_string(row * 10 - 3);
+    }
+    retval += " ratio=" + to_string(row) + ".5\n";
+
+    return retval;
+}
+
+/**
+ * Run a query and join the values in the first column of the results.
+ *
+ * @return False if the query failed.
+ */
+static bool query(sqlite3 *db, const char *sql, string &result_out)
+{
+    sqlite3_stmt *stmt;
+    int rc;
+
+    result_out.clear();
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        fprintf(stderr, "prepare failed: %s\n", sqlite3_errmsg(db));
+        return false;
+    }
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char *value = (const char *) sqlite3_column_text(stmt, 0);
+
+        if (!result_out.empty()) {
+            result_out += ",";
+        }
+        result_out += value == nullptr ? "<NULL>" : value;
+    }
+    sqlite3_finalize(stmt);
+
+    return rc == SQLITE_DONE;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = "test_parquet_reader.parquet";
+    const char *corrupt_path = "test_parquet_reader.corrupt.parquet";
+    const int ROWS = GROUP_ROWS[0] + GROUP_ROWS[1];
+    string expected;
+
+    setenv("TZ", "UTC", 1);
+    write_file(path, false);
+    write_file(corrupt_path, true);
+    for (int row = 0; row < ROWS; row++) {
+        expected += expected_line(row);
+    }
+
+    {
+        int fd = open(path, O_RDONLY);
+
+        assert(fd != -1);
+
+        auto open_res = parquet_file::open(fd);
+
+        assert(open_res.isOk());
+
+        auto pf = open_res.unwrap();
+        const auto &columns = pf.get_columns();
+
+        assert(pf.get_num_rows() == ROWS);
+        assert(pf.get_row_groups().size() == 2);
+        assert(columns.size() == 6);
+        assert(columns[0].c_name == "time");
+        assert(columns[0].c_kind == parquet_file::value_kind_t::TIMESTAMP);
+        assert(columns[1].c_kind == parquet_file::value_kind_t::TEXT);
+        assert(columns[1].c_optional);
+        assert(columns[4].c_name == "count");
+        assert(columns[4].c_chunk_index == 5);
+        assert(columns[5].c_kind == parquet_file::value_kind_t::REAL);
+
+        parquet_file::column_values cv;
+
+        assert(pf.read_column(1, 0, cv).isOk());
+        assert(cv.cv_cells.size() == 3);
+        assert(cv.cv_cells[0].c_integer == (BASE_MILLIS + 4 * 1500) * 1000);
+        assert(parquet_format_timestamp(cv.cv_cells[1].c_integer) ==
+               "2020-09-13 12:26:47.500");
+
+        assert(pf.read_column(0, 4, cv).isOk());
+        assert(cv.cv_cells[0].c_integer == -3);
+        assert(cv.cv_cells[1].c_type == parquet_file::cell::NULL_VALUE);
+        assert(cv.cv_cells[3].c_integer == 27);
+
+        assert(pf.get_min_max(1, 0, cv));
+        assert(cv.cv_cells[0].c_integer == (BASE_MILLIS + 4 * 1500) * 1000);
+        assert(cv.cv_cells[1].c_integer == (BASE_MILLIS + 6 * 1500) * 1000);
+        assert(pf.get_min_max(0, 2, cv));
+        assert(string(cv.bytes_of(cv.cv_cells[1]),
+                      cv.cv_cells[1].c_bytes.cb_length) ==
+               "message number 3");
+        assert(!pf.get_min_max(0, 3, cv));
+
+        close(fd);
+    }
+
+    {
+        int fd = open(path, O_RDONLY);
+        unsigned char header[8];
+
+        assert(fd != -1);
+        assert(pread(fd, header, sizeof(header), 0) == sizeof(header));
+
+        auto fi = frame_indexed::create(fd, header, sizeof(header));
+        string actual;
+        char buffer[7];
+        int rc;
+
+        assert(fi != nullptr);
+        while ((rc = fi->read(buffer, actual.size(), sizeof(buffer))) > 0) {
+            actual.append(buffer, rc);
+        }
+        assert(rc == 0);
+        if (actual != expected) {
+            fprintf(stderr, "expected:\n%s\nactual:\n%s\n",
+                    expected.c_str(), actual.c_str());
+            return EXIT_FAILURE;
+        }
+        assert(fi->get_frames().size() == 2);
+
+        // Go back to a line in the second row group and then the first.
+        size_t off = expected.find("message number 5");
+        string line(32, '\0');
+
+        assert(fi->read(&line[0], off, line.size()) == (int) line.size());
+        assert(line == expected.substr(off, line.size()));
+        assert(fi->read(&line[0], 0, line.size()) == (int) line.size());
+        assert(line == expected.substr(0, line.size()));
+
+        close(fd);
+    }
+
+    {
+        sqlite3 *db;
+        string result;
+
+        assert(sqlite3_open(":memory:", &db) == SQLITE_OK);
+        register_parquet_vtab(db);
+
+        assert(query(db,
+                     "CREATE VIRTUAL TABLE p USING "
+                     "parquet('test_parquet_reader.parquet')",
+                     result));
+        assert(query(db,
+                     "SELECT count(*) FROM p "
+                     "WHERE time >= '2020-09-13 12:26:46.000'",
+                     result));
+        assert(result == "3");
+        assert(query(db, "SELECT count FROM p WHERE level = 'error'", result));
+        assert(result == "<NULL>,27");
+        assert(query(db, "SELECT time FROM p WHERE rowid = 1", result));
+        assert(result == "2020-09-13 12:26:41.500");
+        assert(query(db, "SELECT host FROM p WHERE ratio > 5", result));
+        assert(result == "db,web 1");
+
+        // The first row group cannot be decoded, so these only work if its
+        // statistics are used to skip it or its messages are not read.
+        assert(query(db,
+                     "CREATE VIRTUAL TABLE c USING "
+                     "parquet('test_parquet_reader.corrupt.parquet')",
+                     result));
+        assert(query(db,
+                     "SELECT message FROM c "
+                     "WHERE time > '2020-09-13 12:26:48'",
+                     result));
+        assert(result == "message number 6");
+        assert(query(db, "SELECT count(level) FROM c", result));
+        assert(result == "5");
+        assert(!query(db, "SELECT count(message) FROM c", result));
+
+        sqlite3_close(db);
+    }
+
+    unlink(path);
+    unlink(corrupt_path);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+/**
+ * Copyright (c) 2020, Timothy Stack
+ *
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * * Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * * Neither the name of Timothy Stack nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ''AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <sqlite3.h>
+
+#include "parquet_reader.hh"
+#include "parquet_writer.hh"
+
+using namespace std;
+
+static const int ROWS = 1000;
+static const size_t GROUP_ROWS = 400;
+
+static const char *LEVELS[] = {"info", "warning", "error"};
+
+static string bytes_of(const parquet_file::column_values &cv, size_t row)
+{
+    const auto &ce = cv.cv_cells[row];
+
+    return string(cv.bytes_of(ce), ce.c_bytes.cb_length);
+}
+
+static void write_file(const char *path)
+{
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+
+    assert(sqlite3_open(":memory:", &db) == SQLITE_OK);
+    assert(sqlite3_exec(db,
+                        "CREATE TABLE logs ("
+                        "  log_line INTEGER,"
+                        "  log_level TEXT,"
+                        "  log_body TEXT,"
+                        "  duration REAL,"
+                        "  sc_bytes INTEGER)",
+                        nullptr, nullptr, nullptr) == SQLITE_OK);
+    assert(sqlite3_prepare_v2(db,
+                              "INSERT INTO logs VALUES (?, ?, ?, ?, ?)",
+                              -1, &stmt, nullptr) == SQLITE_OK);
+    for (int row = 0; row < ROWS; row++) {
+        string body = "message number " + to_string(row);
+
+        sqlite3_bind_int64(stmt, 1, row);
+        sqlite3_bind_text(stmt, 2, LEVELS[row % 3], -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 3, body.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_double(stmt, 4, row / 4.0);
+        if (row % 10 == 3) {
+            sqlite3_bind_null(stmt, 5);
+        } else if (row == 7) {
+            sqlite3_bind_text(stmt, 5, "unknown", -1, SQLITE_STATIC);
+        } else {
+            sqlite3_bind_int64(stmt, 5, (int64_t) row * 1000000000LL);
+        }
+        assert(sqlite3_step(stmt) == SQLITE_DONE);
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    FILE *file = fopen(path, "w");
+
+    assert(file != nullptr);
+
+    parquet_writer pw(file, GROUP_ROWS);
+
+    assert(sqlite3_prepare_v2(db,
+                              "SELECT log_line, log_level, log_body, "
+                              "  duration, sc_bytes, log_line * 2 AS dbl "
+                              "FROM logs ORDER BY log_line",
+                              -1, &stmt, nullptr) == SQLITE_OK);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        assert(pw.write_row(stmt));
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+
+    auto finish_res = pw.finish();
+
+    assert(finish_res.isOk());
+    assert(finish_res.unwrap() == ROWS);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = "test_parquet_writer.parquet";
+
+    write_file(path);
+
+    int fd = open(path, O_RDONLY);
+
+    assert(fd != -1);
+
+    auto open_res = parquet_file::open(fd);
+
+    assert(open_res.isOk());
+
+    auto pf = open_res.unwrap();
+    const auto &columns = pf.get_columns();
+    const auto &groups = pf.get_row_groups();
+
+    assert(pf.get_num_rows() == ROWS);
+    assert(groups.size() == 3);
+    assert(groups[2].rg_num_rows == ROWS - 2 * GROUP_ROWS);
+    assert(columns.size() == 6);
+    assert(columns[0].c_name == "log_line");
+    assert(columns[0].c_kind == parquet_file::value_kind_t::INTEGER);
+    assert(columns[1].c_kind == parquet_file::value_kind_t::TEXT);
+    assert(columns[3].c_kind == parquet_file::value_kind_t::REAL);
+    assert(columns[5].c_name == "dbl");
+    assert(columns[5].c_kind == parquet_file::value_kind_t::INTEGER);
+
+    // The levels repeat, so they get a dictionary, the bodies do not.
+    assert(groups[0].rg_chunks[1].cc_dictionary_page_offset > 0);
+    assert(groups[0].rg_chunks[2].cc_dictionary_page_offset == -1);
+    assert(groups[0].rg_chunks[0].cc_dictionary_page_offset == -1);
+
+    parquet_file::column_values cv;
+    int row = 0;
+
+    for (size_t rg = 0; rg < groups.size(); rg++) {
+        parquet_file::column_values levels, bodies, durations, sizes;
+
+        assert(pf.read_column(rg, 0, cv).isOk());
+        assert(pf.read_column(rg, 1, levels).isOk());
+        assert(pf.read_column(rg, 2, bodies).isOk());
+        assert(pf.read_column(rg, 3, durations).isOk());
+        assert(pf.read_column(rg, 4, sizes).isOk());
+        assert(cv.cv_cells.size() == (size_t) groups[rg].rg_num_rows);
+        for (size_t lpc = 0; lpc < cv.cv_cells.size(); lpc++, row++) {
+            assert(cv.cv_cells[lpc].c_integer == row);
+            assert(bytes_of(levels, lpc) == LEVELS[row % 3]);
+            assert(bytes_of(bodies, lpc) ==
+                   "message number " + to_string(row));
+            assert(durations.cv_cells[lpc].c_real == row / 4.0);
+            if (row % 10 == 3 || row == 7) {
+                assert(sizes.cv_cells[lpc].c_type ==
+                       parquet_file::cell::NULL_VALUE);
+            } else {
+                assert(sizes.cv_cells[lpc].c_integer ==
+                       (int64_t) row * 1000000000LL);
+            }
+        }
+    }
+    assert(row == ROWS);
+
+    assert(pf.get_min_max(1, 0, cv));
+    assert(cv.cv_cells[0].c_integer == (int64_t) GROUP_ROWS);
+    assert(cv.cv_cells[1].c_integer == (int64_t) GROUP_ROWS * 2 - 1);
+    assert(pf.get_min_max(0, 1, cv));
+    assert(bytes_of(cv, 0) == "error");
+    assert(bytes_of(cv, 1) == "warning");
+    assert(pf.get_min_max(2, 3, cv));
+    assert(cv.cv_cells[1].c_real == (ROWS - 1) / 4.0);
+
+    close(fd);
+    unlink(path);
+
+    return 0;
+}
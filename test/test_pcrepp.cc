@@ -173,5 +173,119 @@ int main(int argc, char *argv[])
         assert(re.captures()[0].c_end == 11);
     }
 
+    {
+        auto before = pcrepp::get_cache_stats();
+        auto re1 = pcrepp::cached("(cache)d");
+        auto re2 = pcrepp::cached("(cache)d");
+        auto re3 = pcrepp::cached("(cache)d", PCRE_CASELESS);
+        auto after = pcrepp::get_cache_stats();
+        pcre_input pi("CACHED");
+
+        assert(re1 == re2);
+        assert(re1 != re3);
+        assert(!re1->match(context, pi));
+        assert(re3->match(context, pi));
+        assert(after.cs_hits == before.cs_hits + 1);
+        assert(after.cs_misses == before.cs_misses + 2);
+
+        try {
+            pcrepp::cached("(cached");
+            assert(false);
+        } catch (const pcrepp::error &e) {
+        }
+        assert(pcrepp::get_cache_stats().cs_size == after.cs_size);
+    }
+
+    {
+        pcrepp re("(a+)+c");
+        pcre_input pi("aaaaaaaaaaaaaaaaaaaaaaaac");
+
+        assert(re.match(context, pi));
+        pcrepp::set_match_limits(2, 2);
+        pi.reset("aaaaaaaaaaaaaaaaaaaaaaaac");
+        assert(!re.match(context, pi));
+        pcrepp::set_match_limits(10000, 500);
+        pi.reset("aaaaaaaaaaaaaaaaaaaaaaaac");
+        assert(re.match(context, pi));
+    }
+
+    {
+        pcrepp re("(\\w+)=(\\d+)");
+        pcre_input pi("");
+
+        // The results have to be the same before and after the pattern is
+        // studied.
+        for (uint32_t lpc = 0; lpc < pcrepp::STUDY_AFTER_MATCHES * 2; lpc++) {
+            pi.reset("abc=123");
+            assert(re.match(context, pi));
+            assert(pi.get_substr(context.begin()) == "abc");
+            assert(pi.get_substr(context.begin() + 1) == "123");
+        }
+
+        pcrepp copy(re);
+
+        pi.reset("def=456");
+        assert(copy.match(context, pi));
+        assert(pi.get_substr(context.begin()) == "def");
+        assert(copy.get_capture_count() == 2);
+    }
+
+    {
+        std::bitset<256> bits;
+
+        assert(pcrepp::anchored_first_bytes("^abc", bits));
+        assert(bits.count() == 1 && bits.test('a'));
+
+        assert(pcrepp::anchored_first_bytes("^(?<ts>\\d{4})?- ", bits));
+        assert(bits.count() == 11 && bits.test('0') && bits.test('-'));
+
+        assert(pcrepp::anchored_first_bytes("^\\s*\\[|^foo", bits));
+        assert(bits.test(' ') && bits.test('[') && bits.test('f'));
+        assert(!bits.test('a'));
+
+        assert(pcrepp::anchored_first_bytes("(?s)^[^a-z]", bits));
+        assert(!bits.test('m') && bits.test('M'));
+
+        assert(!pcrepp::anchored_first_bytes("abc", bits));
+        assert(!pcrepp::anchored_first_bytes("^a|b", bits));
+        assert(!pcrepp::anchored_first_bytes("^a*", bits));
+        assert(!pcrepp::anchored_first_bytes("^(?i)abc", bits));
+        assert(!pcrepp::anchored_first_bytes("^[[:alpha:]]", bits));
+    }
+
+    {
+        assert(pcrepp::required_literal("Connection Reset") ==
+               "connection reset");
+        assert(pcrepp::required_literal("^\\d+ ERROR: (foo|bar)") ==
+               " error: ");
+        assert(pcrepp::required_literal("timeouts? after") == "timeout");
+        assert(pcrepp::required_literal("ab{0,2}cdef") == "cdef");
+        assert(pcrepp::required_literal("ab{2}c") == "ab");
+        assert(pcrepp::required_literal("x[abc)]+yz") == "yz");
+        assert(pcrepp::required_literal("file\\.txt") == "file.txt");
+        assert(pcrepp::required_literal("a.*b") == "a");
+
+        assert(pcrepp::required_literal("foo|bar").empty());
+        assert(pcrepp::required_literal("(?x) a b c").empty());
+        assert(pcrepp::required_literal("\\Qa.b\\E").empty());
+        assert(pcrepp::required_literal("\\x41BC").empty());
+        assert(pcrepp::required_literal(".*").empty());
+    }
+
+    {
+        std::string literal;
+
+        assert(pcrepp::literal_pattern("req-1234", literal));
+        assert(literal == "req-1234");
+        assert(pcrepp::literal_pattern("host\\.example\\.com", literal));
+        assert(literal == "host.example.com");
+
+        assert(!pcrepp::literal_pattern("", literal));
+        assert(!pcrepp::literal_pattern("a.b", literal));
+        assert(!pcrepp::literal_pattern("\\d+", literal));
+        assert(!pcrepp::literal_pattern("foo|bar", literal));
+        assert(!pcrepp::literal_pattern("ab\\", literal));
+    }
+
     return retval;
 }
@@ -14,6 +14,66 @@ logfile_access_log.0,access_log,3,0
 logfile_access_log.1,access_log,1,0
 EOF
 
+run_test ${lnav_test} -n \
+    -c ";SELECT basename(filepath),lines,errors,warnings FROM lnav_file" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_multiline.0 \
+    ${test_dir}/logfile_generic.0
+
+check_output "lnav_file level counts are not working?" <<EOF
+basename(filepath),lines,errors,warnings
+logfile_multiline.0,3,1,0
+logfile_generic.0,2,0,1
+EOF
+
+run_test ${lnav_test} -n \
+    -c ";SELECT bytes_indexed,compression_ratio,syncpoint_memory,index_memory > 0 AS has_index FROM lnav_file" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "lnav_file index accounting is not working?" <<EOF
+bytes_indexed,compression_ratio,syncpoint_memory,has_index
+351,1.0,0,1
+EOF
+
+run_test ${lnav_test} -n \
+    -c ";SELECT stage,basename(filepath),lines FROM lnav_perf WHERE filepath IS NOT NULL AND stage != 'filter'" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "lnav_perf file counters are not working?" <<EOF
+stage,basename(filepath),lines
+read,logfile_access_log.0,3
+scan,logfile_access_log.0,3
+EOF
+
+run_test ${lnav_test} -n \
+    -c ";SELECT stage FROM lnav_perf WHERE filepath IS NULL" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "lnav_perf totals are not working?" <<EOF
+stage
+read
+scan
+filter
+merge
+search
+render
+EOF
+
+run_test ${lnav_test} -n \
+    -c ";SELECT cache, cost, bytes > 0 AS used FROM lnav_memory" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "lnav_memory is not working?" <<EOF
+cache,cost,used
+,,1
+line-buffers,1,1
+json-lines,2,0
+EOF
+
 run_test ${lnav_test} -n \
     -c ";UPDATE lnav_file SET time_offset = 60 * 1000" \
     ${test_dir}/logfile_access_log.0 \
@@ -141,6 +201,46 @@ log_line,log_part,log_time,log_idle_msecs,log_level,log_mark,log_comment,log_tag
 118,<NULL>,2011-11-03 00:19:49.337,18,error,0,<NULL>,<NULL>,[],1320279589.337053,CBHHuR1xFnm5C5CQBc,192.168.2.76,52074,74.125.225.76,80,1,GET,i4.ytimg.com,/vi/gDbg_GeuiSY/hqdefault.jpg,<NULL>,1.1,Mozilla/5.0 (Macintosh; Intel Mac OS X 10.6; rv:7.0.1) Gecko/20100101 Firefox/7.0.1,0,893,404,Not Found,<NULL>,<NULL>,,<NULL>,<NULL>,<NULL>,<NULL>,<NULL>,<NULL>,F2GiAw3j1m22R2yIg2,<NULL>,image/jpeg
 EOF
 
+run_test ${lnav_test} -n \
+    -c ";SELECT sc_bytes FROM access_log WHERE sc_status = 404" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "projected columns are not extracted?" <<EOF
+sc_bytes
+46210
+EOF
+
+run_test ${lnav_test} -n \
+    -c ";SELECT log_line, c_ip FROM access_log WHERE sc_bytes > 1000" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_access_log.0
+
+check_output "projected columns are not extracted?" <<EOF
+log_line,c_ip
+1,192.168.202.254
+2,192.168.202.254
+EOF
+
+for i in `seq 1 10000`; do
+    echo "192.168.202.254 - - [20/Jul/2009:22:59:26 +0000] \"GET /vmw/cgi/tramp HTTP/1.0\" 200 134 \"-\" \"gPXE/0.9.7\""
+    echo "10.0.0.$((i % 4)) - - [20/Jul/2009:22:59:29 +0000] \"GET /vmw/vSphere/default/vmkboot.gz HTTP/1.0\" 404 $i \"-\" \"gPXE/0.9.7\""
+done > sql-big-access.log
+
+run_test ${lnav_test} -n \
+    -c ";SELECT c_ip, count(*), sum(sc_bytes) FROM access_log GROUP BY c_ip" \
+    -c ":write-csv-to -" \
+    sql-big-access.log
+
+check_output "aggregate over a large scan is wrong?" <<EOF
+c_ip,count(*),sum(sc_bytes)
+10.0.0.0,2500,12505000
+10.0.0.1,2500,12497500
+10.0.0.2,2500,12500000
+10.0.0.3,2500,12502500
+192.168.202.254,10000,1340000
+EOF
+
 run_test ${lnav_test} -n \
     -c ';select log_time from access_log where log_line > 100000' \
     -c ':switch-to-view db' \
@@ -398,6 +498,92 @@ log_line,log_part,log_time,log_idle_msecs,log_level,log_mark,log_comment,log_tag
 EOF
 
 
+run_test ${lnav_test} -n \
+    -c ";select log_line from syslog_log where log_time <= '2013-11-03 09:23:38.000'" \
+    -c ':write-csv-to -' \
+    ${test_dir}/logfile_syslog.0
+
+check_output "log_time upper bound is wrong" <<EOF
+log_line
+0
+1
+2
+EOF
+
+
+run_test ${lnav_test} -n \
+    -c ";select log_line from syslog_log where log_time < '2013-11-03 09:47:02.000'" \
+    -c ':write-csv-to -' \
+    ${test_dir}/logfile_syslog.0
+
+check_output "log_time exclusive upper bound is wrong" <<EOF
+log_line
+0
+1
+2
+EOF
+
+
+run_test ${lnav_test} -n \
+    -c ";select log_line from syslog_log where log_time > '2013-11-03 09:23:38.000'" \
+    -c ':write-csv-to -' \
+    ${test_dir}/logfile_syslog.0
+
+check_output "log_time exclusive lower bound is wrong" <<EOF
+log_line
+3
+EOF
+
+
+run_test ${lnav_test} -n \
+    -c ";select log_line from syslog_log where log_time between '2013-11-03 09:23:38.000' and '2013-11-03 09:47:02.000' and log_line > 0" \
+    -c ':write-csv-to -' \
+    ${test_dir}/logfile_syslog.0
+
+check_output "log_time range is wrong" <<EOF
+log_line
+1
+2
+3
+EOF
+
+
+run_test ${lnav_test} -n \
+    -c ";select log_line from syslog_log where log_level = 'ERROR'" \
+    -c ':write-csv-to -' \
+    ${test_dir}/logfile_syslog.0
+
+check_output "log_level constraint is wrong" <<EOF
+log_line
+0
+2
+EOF
+
+
+run_test ${lnav_test} -n \
+    -c ";select log_line from syslog_log where log_level in ('info', 'error') and log_line > 0 order by log_line" \
+    -c ':write-csv-to -' \
+    ${test_dir}/logfile_syslog.0
+
+check_output "log_level IN constraint is wrong" <<EOF
+log_line
+1
+2
+3
+EOF
+
+
+run_test ${lnav_test} -n \
+    -c ";select count(*) as total from syslog_log where log_path = (select log_path from syslog_log limit 1)" \
+    -c ':write-csv-to -' \
+    ${test_dir}/logfile_syslog.0
+
+check_output "log_path constraint is wrong" <<EOF
+total
+4
+EOF
+
+
 run_test ${lnav_test} -n \
     -c ':filter-in sudo' \
     -c ";select * from logline" \
@@ -707,6 +893,8 @@ CREATE VIEW lnav_view_filters_and_stats AS
 CREATE VIRTUAL TABLE lnav_file USING lnav_file_impl();
 CREATE VIRTUAL TABLE regexp_capture USING regexp_capture_impl();
 CREATE VIRTUAL TABLE fstat USING fstat_impl();
+CREATE VIRTUAL TABLE lnav_perf USING lnav_perf_impl();
+CREATE VIRTUAL TABLE lnav_memory USING lnav_memory_impl();
 CREATE TABLE http_status_codes (
     status integer PRIMARY KEY,
     message text,
@@ -1015,6 +1203,17 @@ run_test ${lnav_test} -n \
 check_output "able to select a continued line?" <<EOF
 EOF
 
+run_test ${lnav_test} -n \
+    -c ";select timeslice(log_time_us, '1s') = timeslice(log_time, '1s') as same from generic_log where log_time_us > 0" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_multiline.0
+
+check_output "log_time_us does not match log_time?" <<EOF
+same
+1
+1
+EOF
+
 
 run_test ${lnav_test} -n \
     -c ":create-search-table search_test1 (\w+), world!" \
@@ -1039,6 +1238,19 @@ log_msg_instance,col_0
 1,Goodbye
 EOF
 
+run_test ${lnav_test} -n \
+    -c ":create-search-table search_test1 (\w+), World!" \
+    -c ";select log_msg_instance, col_0 from search_test1" \
+    -c ";select log_msg_instance, col_0 from search_test1" \
+    -c ":write-csv-to -" \
+    ${test_dir}/logfile_multiline.0
+
+check_output "search table results are wrong when run again?" <<EOF
+log_msg_instance,col_0
+0,Hello
+1,Goodbye
+EOF
+
 run_test ${lnav_test} -n \
     -c ":create-search-table search_test1 (?<word>\w+), World!" \
     -c ";select word, typeof(word) from search_test1" \
@@ -1089,6 +1301,31 @@ check_error_output "able to create table with a bad regex?" <<EOF
 error: missing )
 EOF
 
+cp ${test_dir}/logfile_multiline.0 logfile_append.0
+chmod ug+w logfile_append.0
+
+run_test ${lnav_test} -n \
+    -c ":create-materialized-view level_counts SELECT log_level, count(*) AS total FROM generic_log WHERE log_line >= \$log_line_start GROUP BY log_level" \
+    -c ":shexec echo '2009-07-20 22:59:31,221:ERROR:Goodbye again, World!' >> logfile_append.0" \
+    -c ":rebuild" \
+    -c ";SELECT log_level, sum(total) FROM level_counts GROUP BY log_level" \
+    -c ":write-csv-to -" \
+    logfile_append.0
+
+check_output "materialized view is not updated?" <<EOF
+log_level,sum(total)
+debug,1
+error,2
+EOF
+
+run_test ${lnav_test} -n \
+    -c ":delete-materialized-view level_counts" \
+    ${test_dir}/logfile_multiline.0
+
+check_error_output "able to delete unknown materialized view?" <<EOF
+error: unknown materialized view -- level_counts
+EOF
+
 NULL_GRAPH_SELECT_1=$(cat <<EOF
 ;SELECT value FROM (
               SELECT 10 as value
@@ -1118,3 +1355,14 @@ content
 1.0
 1.0
 EOF
+
+fstat_count=$(ls -d ${test_dir}/logfile_* | wc -l)
+run_test ${lnav_test} -n \
+    -c ";SELECT count(*) AS cnt, count(DISTINCT st_ino) AS inodes FROM fstat('${test_dir}/logfile_*')" \
+    -c ':write-csv-to -' \
+    ${test_dir}/logfile_access_log.0
+
+check_output "fstat does not return every file?" <<EOF
+cnt,inodes
+$((fstat_count)),$((fstat_count))
+EOF
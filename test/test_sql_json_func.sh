@@ -116,6 +116,42 @@ Row 0:
   Column jget('[null, true, 20, 30, 40]', '/0/foo'): (null)
 EOF
 
+run_test ./drive_sql "select jget('{\"a\": {\"b\": [1, \"two\"]}, \"c\": ', '/a/b/1')"
+
+check_error_output "jget looked past the value" <<EOF
+EOF
+
+check_output "jget looked past the value" <<EOF
+Row 0:
+  Column jget('{"a": {"b": [1, "two"]}, "c": ', '/a/b/1'): two
+EOF
+
+run_test ./drive_sql "select jget('{\"ab\": 1, \"abc\": {\"x\": [1, true]}}', '/abc')"
+
+check_error_output "" <<EOF
+EOF
+
+check_output "jget of an object does not work" <<EOF
+Row 0:
+  Column jget('{"ab": 1, "abc": {"x": [1, true]}}', '/abc'): {"x":[1,true]}
+EOF
+
+run_test ./drive_sql <<EOF
+select jget(column1, '/a/b', 'none') as b from (values ('{"a": {"b": 1}}'), ('{"a": {"c": 2}}'), ('{"a": {"b": "three"}}'))
+EOF
+
+check_error_output "" <<EOF
+EOF
+
+check_output "jget over several rows does not work" <<EOF
+Row 0:
+  Column          b: 1
+Row 1:
+  Column          b: none
+Row 2:
+  Column          b: three
+EOF
+
 
 run_test ./drive_sql "select json_group_object(key) from (select 1 as key)"
 
@@ -75,3 +75,17 @@ check_output "timeslice day" <<EOF
 Row 0:
   Column timediff('foo', 'yesterday'): (null)
 EOF
+
+run_test ./drive_sql "select timeslice(1438948860123456, '5m')"
+
+check_output "timeslice integer" <<EOF
+Row 0:
+  Column timeslice(1438948860123456, '5m'): 2015-08-07 12:00:00.000
+EOF
+
+run_test ./drive_sql "select timeslice(1438948860123456)"
+
+check_output "timeslice integer default" <<EOF
+Row 0:
+  Column timeslice(1438948860123456): 2015-08-07 12:00:00.000
+EOF